@@ -38,6 +38,10 @@
 #define AC_SSE42        0x1000  /* x86: SSE4.2 instructions (Intel) */
 #define AC_SSE4A        0x2000  /* x86: SSE4a instructions (AMD) */
 #define AC_SSE5         0x4000  /* x86: SSE5 instructions (AMD) */
+#define AC_AVX2         0x8000  /* x86: AVX2 instructions */
+#define AC_VECTOR      0x10000  /* any CPU: compiler vector extensions
+                                 * (SSE2/NEON/AltiVec, as the compiler
+                                 * sees fit) */
 
 #define AC_NONE         0       /* No acceleration (vanilla C functions) */
 #define AC_ALL          (~0)    /* All available acceleration */
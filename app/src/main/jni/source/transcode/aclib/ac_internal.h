@@ -19,6 +19,24 @@
 # define UNLIKELY(x) (x)
 #endif
 
+/* Can the generic vector routines in img_vector.c be used?  They need
+ * __builtin_shufflevector (Clang, GCC 12 and later), a little-endian CPU,
+ * and a target with a SIMD unit for the compiler to use. */
+#if (defined(__clang__) || (defined(__GNUC__) && __GNUC__ >= 12)) \
+ && defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__ \
+ && (defined(__SSE2__) || defined(__ARM_NEON) || defined(__ARM_NEON__) \
+     || defined(__ALTIVEC__))
+# define HAVE_VECTOR_EXT
+#endif
+
+/* Can the AVX2 routines in img_avx2.c be compiled?  They use intrinsics
+ * in functions with the "avx2" target attribute, so the rest of the
+ * library needs no special compiler options. */
+#if (defined(ARCH_X86) || defined(ARCH_X86_64)) \
+ && (defined(__clang__) || (defined(__GNUC__) && __GNUC__ >= 5))
+# define HAVE_AVX2_INTRINSICS
+#endif
+
 /* Are _all_ of the given acceleration flags (`test') available? */
 #define HAS_ACCEL(accel,test) (((accel) & (test)) == (test))
 
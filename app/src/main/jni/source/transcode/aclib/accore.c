@@ -45,11 +45,16 @@ int ac_init(int accel)
 
 int ac_cpuinfo(void)
 {
+    int accel = 0;
+
 #if defined(ARCH_X86) || defined(ARCH_X86_64)
-    return cpuinfo_x86();
-#else
-    return 0;
+    accel |= cpuinfo_x86();
 #endif
+#ifdef HAVE_VECTOR_EXT
+    /* The generic vector routines run on whatever the compiler targets */
+    accel |= AC_VECTOR;
+#endif
+    return accel;
 }
 
 /*************************************************************************/
@@ -78,7 +83,9 @@ const char *ac_flagstotext(int accel)
     static char retbuf[1000];
     if (!accel)
         return "none";
-    snprintf(retbuf, sizeof(retbuf), "%s%s%s%s%s%s%s%s%s%s%s%s%s%s",
+    snprintf(retbuf, sizeof(retbuf), "%s%s%s%s%s%s%s%s%s%s%s%s%s%s%s%s",
+             accel & AC_VECTOR                ? " vector"   : "",
+             accel & AC_AVX2                  ? " avx2"     : "",
              accel & AC_SSE5                  ? " sse5"     : "",
              accel & AC_SSE4A                 ? " sse4a"    : "",
              accel & AC_SSE42                 ? " sse42"    : "",
@@ -107,7 +114,6 @@ int ac_parseflags(const char *text, int *accel)
     int parsed = 1, done = 0;
     if (!text || !accel)
         return 0;
-#if defined(ARCH_X86) || defined(ARCH_X86_64)
     *accel = 0;
 
     while (parsed && !done) {
@@ -126,6 +132,9 @@ int ac_parseflags(const char *text, int *accel)
 //fprintf(stderr, "(%s) buf=[%s]\n", __func__, buf);
         if (strcasecmp(buf, "C") == 0)  // dummy for "no accel"
             *accel |= 0;
+        else if (strcasecmp(buf, "vector"  ) == 0)
+            *accel |= AC_VECTOR;
+#if defined(ARCH_X86) || defined(ARCH_X86_64)
 #ifdef ARCH_X86
         else if (strcasecmp(buf, "asm"     ) == 0)
             *accel |= AC_IA32ASM;
@@ -158,11 +167,13 @@ int ac_parseflags(const char *text, int *accel)
             *accel |= AC_SSE4A;
         else if (strcasecmp(buf, "sse5"    ) == 0)
             *accel |= AC_SSE5;
+        else if (strcasecmp(buf, "avx2"    ) == 0)
+            *accel |= AC_AVX2;
+#endif  /* ARCH_X86 || ARCH_X86_64 */
         else
             parsed = 0;
         text = comma + 1;
     }
-#endif
     return parsed;
 }
 
@@ -201,6 +212,18 @@ int ac_parseflags(const char *text, int *accel)
         : "=a" (ret_a), "=S" (ret_b), "=c" (ret_c), "=d" (ret_d)        \
         : "a" (func))
 
+/* Same as CPUID, but also sets ECX = subfunc (for function 7 and up). */
+#define CPUID_SUB(func,subfunc,ret_a,ret_b,ret_c,ret_d)                 \
+    asm("mov "EBX", "ESI"; cpuid; xchg "EBX", "ESI                      \
+        : "=a" (ret_a), "=S" (ret_b), "=c" (ret_c), "=d" (ret_d)        \
+        : "a" (func), "c" (subfunc))
+
+/* Macro to read extended control register 0 (the OS-enabled register
+ * state) into ret_a (low word) and ret_d (high word).  The opcode is
+ * spelled out for the benefit of assemblers that don't know XGETBV. */
+#define XGETBV0(ret_a,ret_d)                                            \
+    asm(".byte 0x0F,0x01,0xD0" : "=a" (ret_a), "=d" (ret_d) : "c" (0))
+
 /* Various CPUID flags.  The second word of the macro name indicates the
  * function (1: function 1, X1: function 0x80000001) and register (D: EDX)
  * to which the value belongs. */
@@ -212,6 +235,9 @@ int ac_parseflags(const char *text, int *accel)
 #define CPUID_1C_SSSE3          (1UL<< 9)
 #define CPUID_1C_SSE41          (1UL<<19)
 #define CPUID_1C_SSE42          (1UL<<20)
+#define CPUID_1C_OSXSAVE        (1UL<<27)
+#define CPUID_1C_AVX            (1UL<<28)
+#define CPUID_7B_AVX2           (1UL<< 5)  /* function 7, subfunction 0 */
 #define CPUID_X1D_AMD_MMXEXT    (1UL<<22)  /* AMD only */
 #define CPUID_X1D_AMD_3DNOW     (1UL<<31)  /* AMD only */
 #define CPUID_X1D_AMD_3DNOWEXT  (1UL<<30)  /* AMD only */
@@ -219,6 +245,9 @@ int ac_parseflags(const char *text, int *accel)
 #define CPUID_X1C_AMD_SSE4A     (1UL<< 6)  /* AMD only */
 #define CPUID_X1C_AMD_SSE5      (1UL<<11)  /* AMD only */
 
+/* XCR0 bits which must be set for the OS to save YMM registers */
+#define XCR0_SSE_AVX            (3UL<< 1)
+
 static int cpuinfo_x86(void)
 {
     uint32_t eax, ebx, ecx, edx;
@@ -227,7 +256,8 @@ static int cpuinfo_x86(void)
         char string[13];
         struct { uint32_t ebx, edx, ecx; } regs;
     } cpu_vendor;  /* 12-byte CPU vendor string + trailing null */
-    uint32_t cpuid_1D, cpuid_1C, cpuid_X1C, cpuid_X1D;
+    uint32_t cpuid_1D, cpuid_1C, cpuid_7B, cpuid_X1C, cpuid_X1D;
+    uint32_t xcr0_lo, xcr0_hi;
     int accel;
 
     /* First see if the CPUID instruction is even available.  We try to
@@ -257,9 +287,11 @@ static int cpuinfo_x86(void)
     CPUID(0x80000000, cpuid_ext_max, ebx, ecx, edx);
 
     /* Read available features */
-    cpuid_1D = cpuid_1C = cpuid_X1C = cpuid_X1D = 0;
+    cpuid_1D = cpuid_1C = cpuid_7B = cpuid_X1C = cpuid_X1D = 0;
     if (cpuid_max >= 1)
         CPUID(1, eax, ebx, cpuid_1C, cpuid_1D);
+    if (cpuid_max >= 7)
+        CPUID_SUB(7, 0, eax, cpuid_7B, ecx, edx);
     if (cpuid_ext_max >= 0x80000001)
         CPUID(0x80000001, eax, ebx, cpuid_X1C, cpuid_X1D);
 
@@ -285,6 +317,15 @@ static int cpuinfo_x86(void)
         accel |= AC_SSE41;
     if (cpuid_1C & CPUID_1C_SSE42)
         accel |= AC_SSE42;
+    /* AVX2 is only usable if the OS saves the YMM registers for us */
+    if ((cpuid_1C & (CPUID_1C_OSXSAVE | CPUID_1C_AVX))
+                 == (CPUID_1C_OSXSAVE | CPUID_1C_AVX)
+     && (cpuid_7B & CPUID_7B_AVX2)
+    ) {
+        XGETBV0(xcr0_lo, xcr0_hi);
+        if ((xcr0_lo & XCR0_SSE_AVX) == XCR0_SSE_AVX)
+            accel |= AC_AVX2;
+    }
     if (strcmp(cpu_vendor.string, "AuthenticAMD") == 0) {
         if (cpuid_X1D & CPUID_X1D_AMD_MMXEXT)
             accel |= AC_MMXEXT;
@@ -0,0 +1,682 @@
+/*
+ * img_avx2.c - image format conversion routines using AVX2 instructions
+ *
+ * This file is part of transcode, a video stream processing tool.
+ * transcode is free software, distributable under the terms of the GNU
+ * General Public License (version 2 or later).  See the file COPYING
+ * for details.
+ */
+
+#include "ac.h"
+#include "ac_internal.h"
+#include "imgconvert.h"
+#include "img_internal.h"
+
+/*************************************************************************/
+/*************************************************************************/
+
+/* These routines handle 32 pixels per loop iteration, twice as many as
+ * the SSE2 ones.  Rather than requiring the whole library to be compiled
+ * with -mavx2, they are written with compiler intrinsics in functions
+ * carrying the "avx2" target attribute, and are only registered when
+ * ac_cpuinfo() reports AVX2 support.
+ *
+ * Most AVX2 instructions operate on the two 128-bit halves ("lanes") of a
+ * register separately.  All routines keep pixels 0-15 in the low lane
+ * and pixels 16-31 in the high lane, so that the in-lane pack/unpack
+ * instructions undo each other; the few cross-lane fixups needed for
+ * loads and stores are noted where they occur.
+ *
+ * YUV->RGB uses the same 16-bit fixed-point math as the SSE2 routines in
+ * img_yuv_rgb.c; everything else is exact, matching the C routines. */
+
+#ifdef HAVE_AVX2_INTRINSICS
+
+#include <immintrin.h>
+
+#define AVX2 __attribute__((target("avx2")))
+
+/*************************************************************************/
+
+/* Byte shuffle tables for packed 24-bit pixels.  Each table converts the
+ * three 16-byte inputs a, b, c (one lane of each of three registers) to
+ * three 16-byte outputs; mask[k][j] is the PSHUFB mask selecting the
+ * bytes of output k from input j, where output byte n (0-47, counting
+ * across all three outputs) comes from input byte f(n).  Unused bytes
+ * have the high bit set, so PSHUFB zeroes them. */
+
+#define PICK(f,k,j,i)                                                   \
+    ((f(16*(k)+(i)) >= 16*(j) && f(16*(k)+(i)) < 16*(j)+16)             \
+     ? f(16*(k)+(i)) - 16*(j) : 0x80)
+#define PICKROW(f,k,j) {                                                \
+    PICK(f,k,j,0),  PICK(f,k,j,1),  PICK(f,k,j,2),  PICK(f,k,j,3),      \
+    PICK(f,k,j,4),  PICK(f,k,j,5),  PICK(f,k,j,6),  PICK(f,k,j,7),      \
+    PICK(f,k,j,8),  PICK(f,k,j,9),  PICK(f,k,j,10), PICK(f,k,j,11),     \
+    PICK(f,k,j,12), PICK(f,k,j,13), PICK(f,k,j,14), PICK(f,k,j,15) }
+#define PICKTABLE(f) {                                                  \
+    { PICKROW(f,0,0), PICKROW(f,0,1), PICKROW(f,0,2) },                 \
+    { PICKROW(f,1,0), PICKROW(f,1,1), PICKROW(f,1,2) },                 \
+    { PICKROW(f,2,0), PICKROW(f,2,1), PICKROW(f,2,2) } }
+
+/* RGB24 -> separate R, G, B */
+#define UNPACK3(n)  (3*((n)%16) + (n)/16)
+/* separate R, G, B -> RGB24 */
+#define PACK3(n)    ((n)%3*16 + (n)/3)
+/* RGB24 <-> BGR24 */
+#define SWAP3(n)    ((n) - (n)%3 + 2 - (n)%3)
+/* gray -> RGB24 (only input 0 is used) */
+#define GRAY3(n)    ((n)/3)
+
+static const uint8_t unpack3_mask[3][3][16] = PICKTABLE(UNPACK3);
+static const uint8_t pack3_mask[3][3][16]   = PICKTABLE(PACK3);
+static const uint8_t swap3_mask[3][3][16]   = PICKTABLE(SWAP3);
+static const uint8_t gray3_mask[3][3][16]   = PICKTABLE(GRAY3);
+
+/*************************************************************************/
+
+/* Common helpers */
+
+/* Broadcast a 16-byte table to both lanes */
+static inline AVX2 __m256i bcast(const uint8_t *table)
+{
+    return _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i *)table));
+}
+
+/* Shuffle bytes from a, b, c to three outputs according to `mask' */
+static inline AVX2 void shuffle3(__m256i a, __m256i b, __m256i c,
+                                 const uint8_t mask[3][3][16], __m256i *out)
+{
+    int k;
+    for (k = 0; k < 3; k++) {
+        out[k] = _mm256_or_si256(
+            _mm256_or_si256(_mm256_shuffle_epi8(a, bcast(mask[k][0])),
+                            _mm256_shuffle_epi8(b, bcast(mask[k][1]))),
+            _mm256_shuffle_epi8(c, bcast(mask[k][2])));
+    }
+}
+
+/* Load 32 packed 24-bit pixels: the low lanes get pixels 0-15 (bytes
+ * 0-47), the high lanes get pixels 16-31 (bytes 48-95) */
+static inline AVX2 void load_packed3(const uint8_t *src, __m256i *in)
+{
+    int j;
+    for (j = 0; j < 3; j++) {
+        in[j] = _mm256_inserti128_si256(
+            _mm256_castsi128_si256(_mm_loadu_si128((const __m128i *)(src + 16*j))),
+            _mm_loadu_si128((const __m128i *)(src + 48 + 16*j)), 1);
+    }
+}
+
+/* Store 32 packed 24-bit pixels in the layout produced by load_packed3() */
+static inline AVX2 void store_packed3(uint8_t *dest, const __m256i *out)
+{
+    _mm256_storeu_si256((__m256i *)dest,
+                        _mm256_permute2x128_si256(out[0], out[1], 0x20));
+    _mm256_storeu_si256((__m256i *)(dest+32),
+                        _mm256_permute2x128_si256(out[2], out[0], 0x30));
+    _mm256_storeu_si256((__m256i *)(dest+64),
+                        _mm256_permute2x128_si256(out[1], out[2], 0x31));
+}
+
+/* Compute (c1*x + c2*y + c3*z + 32768) >> 16 for 32 pixels of unsigned
+ * bytes, with exact 32-bit intermediates.  The constants are given as
+ * two pairs of 16-bit values, (c1,c2a) and (c2b,c3) with c2 = c2a+c2b, to
+ * suit PMADDWD.  The results are saturated to 0..255, or to -128..127 if
+ * `is_signed' is nonzero. */
+static inline AVX2 __m256i madd3(__m256i x, __m256i y, __m256i z,
+                                 int c1, int c2a, int c2b, int c3,
+                                 int is_signed)
+{
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i k1 = _mm256_set1_epi32((c1 & 0xFFFF) | (unsigned)c2a << 16);
+    const __m256i k2 = _mm256_set1_epi32((c2b & 0xFFFF) | (unsigned)c3 << 16);
+    const __m256i round = _mm256_set1_epi32(32768);
+    __m256i x16[2], y16[2], z16[2], res16[2];
+    int h;
+
+    x16[0] = _mm256_unpacklo_epi8(x, zero);
+    x16[1] = _mm256_unpackhi_epi8(x, zero);
+    y16[0] = _mm256_unpacklo_epi8(y, zero);
+    y16[1] = _mm256_unpackhi_epi8(y, zero);
+    z16[0] = _mm256_unpacklo_epi8(z, zero);
+    z16[1] = _mm256_unpackhi_epi8(z, zero);
+    for (h = 0; h < 2; h++) {
+        __m256i lo, hi;
+        lo = _mm256_add_epi32(
+            _mm256_madd_epi16(_mm256_unpacklo_epi16(x16[h], y16[h]), k1),
+            _mm256_madd_epi16(_mm256_unpacklo_epi16(y16[h], z16[h]), k2));
+        hi = _mm256_add_epi32(
+            _mm256_madd_epi16(_mm256_unpackhi_epi16(x16[h], y16[h]), k1),
+            _mm256_madd_epi16(_mm256_unpackhi_epi16(y16[h], z16[h]), k2));
+        lo = _mm256_srai_epi32(_mm256_add_epi32(lo, round), 16);
+        hi = _mm256_srai_epi32(_mm256_add_epi32(hi, round), 16);
+        res16[h] = _mm256_packs_epi32(lo, hi);
+    }
+    if (is_signed)
+        return _mm256_packs_epi16(res16[0], res16[1]);
+    else
+        return _mm256_packus_epi16(res16[0], res16[1]);
+}
+
+/* Pack the even (odd == 0) or odd (odd != 0) bytes of 32 values to 16
+ * bytes */
+static inline AVX2 __m128i pick_alternate(__m256i v, int odd)
+{
+    if (odd) {
+        v = _mm256_srli_epi16(v, 8);
+    } else {
+        v = _mm256_and_si256(v, _mm256_set1_epi16(0x00FF));
+    }
+    v = _mm256_permute4x64_epi64(_mm256_packus_epi16(v, v), 0xD8);
+    return _mm256_castsi256_si128(v);
+}
+
+/* Convert 32 Y values to grayscale: (clamp(Y,16,235)-16) * 255/219 */
+static inline AVX2 __m256i y_to_gray(__m256i y)
+{
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i mul = _mm256_set1_epi16(9539);  // (n<<3)*9539>>16 == n*255/219
+    __m256i lo, hi;
+
+    y = _mm256_min_epu8(_mm256_subs_epu8(y, _mm256_set1_epi8(16)),
+                        _mm256_set1_epi8((char)219));
+    lo = _mm256_slli_epi16(_mm256_unpacklo_epi8(y, zero), 3);
+    hi = _mm256_slli_epi16(_mm256_unpackhi_epi8(y, zero), 3);
+    return _mm256_packus_epi16(_mm256_mulhi_epu16(lo, mul),
+                               _mm256_mulhi_epu16(hi, mul));
+}
+
+/*************************************************************************/
+/*************************************************************************/
+
+/* YUV420P->RGB24/BGR24 */
+
+static inline AVX2 void yuv420p_rgb_avx2(uint8_t **src, uint8_t **dest,
+                                         int width, int height, int bgr)
+{
+    const __m256i bias_y   = _mm256_set1_epi16(16);
+    const __m256i bias_uv  = _mm256_set1_epi16(128);
+    const __m256i k_y      = _mm256_set1_epi16(0x2543);
+    const __m256i k_rv     = _mm256_set1_epi16(0x3313);
+    const __m256i k_gu     = _mm256_set1_epi16((short)0xF377);
+    const __m256i k_gv     = _mm256_set1_epi16((short)0xE5FC);
+    const __m256i k_bu     = _mm256_set1_epi16(0x408D);
+    const __m256i rounding = _mm256_set1_epi16(8);
+    const __m256i evenmask = _mm256_set1_epi16(0x00FF);
+    int x, y;
+
+    for (y = 0; y < height; y++) {
+        const uint8_t *sy = src[0] + y*width;
+        const uint8_t *su = src[1] + (y/2)*(width/2);
+        const uint8_t *sv = src[2] + (y/2)*(width/2);
+        uint8_t *d = dest[0] + y*width*3;
+
+        for (x = 0; x+32 <= width; x += 32) {
+            __m256i Y, Ye, Yo, U, V, r, g, b, re, ge, be, ro, go, bo;
+            __m256i out[3];
+
+            /* Load and bias; Ye/Yo hold the even/odd pixels, which share
+             * the chroma values in U and V (with cvtepu8_epi16, chroma
+             * 0-7 land in the low lane, matching pixels 0-15) */
+            Y = _mm256_loadu_si256((const __m256i *)(sy+x));
+            U = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i *)(su+x/2)));
+            V = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i *)(sv+x/2)));
+            Ye = _mm256_and_si256(Y, evenmask);
+            Yo = _mm256_srli_epi16(Y, 8);
+            Ye = _mm256_slli_epi16(_mm256_sub_epi16(Ye, bias_y), 7);
+            Yo = _mm256_slli_epi16(_mm256_sub_epi16(Yo, bias_y), 7);
+            U  = _mm256_slli_epi16(_mm256_sub_epi16(U, bias_uv), 7);
+            V  = _mm256_slli_epi16(_mm256_sub_epi16(V, bias_uv), 7);
+
+            /* Multiply by constants, add and shift back to integers */
+            Ye = _mm256_add_epi16(_mm256_mulhi_epi16(Ye, k_y), rounding);
+            Yo = _mm256_add_epi16(_mm256_mulhi_epi16(Yo, k_y), rounding);
+            r = _mm256_mulhi_epi16(V, k_rv);
+            g = _mm256_add_epi16(_mm256_mulhi_epi16(U, k_gu),
+                                 _mm256_mulhi_epi16(V, k_gv));
+            b = _mm256_mulhi_epi16(U, k_bu);
+            re = _mm256_srai_epi16(_mm256_add_epi16(Ye, r), 4);
+            ge = _mm256_srai_epi16(_mm256_add_epi16(Ye, g), 4);
+            be = _mm256_srai_epi16(_mm256_add_epi16(Ye, b), 4);
+            ro = _mm256_srai_epi16(_mm256_add_epi16(Yo, r), 4);
+            go = _mm256_srai_epi16(_mm256_add_epi16(Yo, g), 4);
+            bo = _mm256_srai_epi16(_mm256_add_epi16(Yo, b), 4);
+
+            /* Saturate, pack to bytes and reinterleave even/odd pixels */
+            r = _mm256_unpacklo_epi8(_mm256_packus_epi16(re, re),
+                                     _mm256_packus_epi16(ro, ro));
+            g = _mm256_unpacklo_epi8(_mm256_packus_epi16(ge, ge),
+                                     _mm256_packus_epi16(go, go));
+            b = _mm256_unpacklo_epi8(_mm256_packus_epi16(be, be),
+                                     _mm256_packus_epi16(bo, bo));
+            if (bgr) {
+                shuffle3(b, g, r, pack3_mask, out);
+            } else {
+                shuffle3(r, g, b, pack3_mask, out);
+            }
+            store_packed3(d + x*3, out);
+        }
+
+        for (; x < width; x++) {
+            int cY = 76309 * (sy[x] - 16), U = su[x/2] - 128, V = sv[x/2] - 128;
+            int R = (cY + 104597*V + 32768) >> 16;
+            int G = (cY - 25675*U - 53279*V + 32768) >> 16;
+            int B = (cY + 132201*U + 32768) >> 16;
+            d[x*3+(bgr?2:0)] = R<0 ? 0 : R>255 ? 255 : R;
+            d[x*3+1]         = G<0 ? 0 : G>255 ? 255 : G;
+            d[x*3+(bgr?0:2)] = B<0 ? 0 : B>255 ? 255 : B;
+        }
+    }
+}
+
+static AVX2 int yuv420p_rgb24_avx2(uint8_t **src, uint8_t **dest,
+                                   int width, int height)
+{
+    yuv420p_rgb_avx2(src, dest, width, height, 0);
+    return 1;
+}
+
+static AVX2 int yuv420p_bgr24_avx2(uint8_t **src, uint8_t **dest,
+                                   int width, int height)
+{
+    yuv420p_rgb_avx2(src, dest, width, height, 1);
+    return 1;
+}
+
+/*************************************************************************/
+
+/* RGB24/BGR24->YUV420P.  As in the C version, U is taken from the even
+ * pixels of even rows and V from the odd pixels of odd rows. */
+
+static inline AVX2 void rgb_yuv420p_avx2(uint8_t **src, uint8_t **dest,
+                                         int width, int height, int bgr)
+{
+    const int rofs = bgr ? 2 : 0, bofs = bgr ? 0 : 2;
+    int x, y;
+
+    for (y = 0; y < height; y++) {
+        const uint8_t *s = src[0] + y*width*3;
+        uint8_t *dy = dest[0] + y*width;
+        uint8_t *duv = dest[y%2 ? 2 : 1] + (y/2)*(width/2);
+
+        for (x = 0; x+32 <= width; x += 32) {
+            __m256i in[3], rgb[3], r, g, b, v;
+
+            load_packed3(s + x*3, in);
+            shuffle3(in[0], in[1], in[2], unpack3_mask, rgb);
+            r = rgb[bgr ? 2 : 0];
+            g = rgb[1];
+            b = rgb[bgr ? 0 : 2];
+            v = _mm256_add_epi8(madd3(r, g, b, 16829, 16520, 16519, 6416, 0),
+                                _mm256_set1_epi8(16));
+            _mm256_storeu_si256((__m256i *)(dy+x), v);
+            if (y%2 == 0) {
+                v = madd3(r, g, b, -9714, -19070, 0, 28784, 1);
+                v = _mm256_add_epi8(v, _mm256_set1_epi8((char)128));
+                _mm_storeu_si128((__m128i *)(duv+x/2), pick_alternate(v, 0));
+            } else {
+                v = madd3(r, g, b, 28784, -24103, 0, -4681, 1);
+                v = _mm256_add_epi8(v, _mm256_set1_epi8((char)128));
+                _mm_storeu_si128((__m128i *)(duv+x/2), pick_alternate(v, 1));
+            }
+        }
+
+        for (; x < width; x++) {
+            int r = s[x*3+rofs], g = s[x*3+1], b = s[x*3+bofs];
+            dy[x] = ((16829*r + 33039*g + 6416*b + 32768) >> 16) + 16;
+            if (y%2 == 0 && x%2 == 0)
+                duv[x/2] = ((-9714*r - 19070*g + 28784*b + 32768) >> 16) + 128;
+            else if (y%2 == 1 && x%2 == 1)
+                duv[x/2] = ((28784*r - 24103*g - 4681*b + 32768) >> 16) + 128;
+        }
+    }
+}
+
+static AVX2 int rgb24_yuv420p_avx2(uint8_t **src, uint8_t **dest,
+                                   int width, int height)
+{
+    rgb_yuv420p_avx2(src, dest, width, height, 0);
+    return 1;
+}
+
+static AVX2 int bgr24_yuv420p_avx2(uint8_t **src, uint8_t **dest,
+                                   int width, int height)
+{
+    rgb_yuv420p_avx2(src, dest, width, height, 1);
+    return 1;
+}
+
+/*************************************************************************/
+
+/* RGB24<->BGR24 */
+
+static AVX2 int rgb24_bgr24_avx2(uint8_t **src, uint8_t **dest,
+                                 int width, int height)
+{
+    const uint8_t *s = src[0];
+    uint8_t *d = dest[0];
+    int i;
+
+    for (i = 0; i+32 <= width*height; i += 32) {
+        __m256i in[3], out[3];
+        load_packed3(s + i*3, in);
+        shuffle3(in[0], in[1], in[2], swap3_mask, out);
+        store_packed3(d + i*3, out);
+    }
+    for (; i < width*height; i++) {
+        uint8_t t = s[i*3];
+        d[i*3  ] = s[i*3+2];
+        d[i*3+1] = s[i*3+1];
+        d[i*3+2] = t;
+    }
+    return 1;
+}
+
+/*************************************************************************/
+
+/* YUY2->YUV420P; the chroma of each pair of rows is averaged */
+
+static AVX2 int yuy2_yuv420p_avx2(uint8_t **src, uint8_t **dest,
+                                  int width, int height)
+{
+    const __m256i evenmask = _mm256_set1_epi16(0x00FF);
+    const int w2 = width & ~1;
+    int x, y;
+
+    for (y = 0; y < (height & ~1); y++) {
+        const uint8_t *s = src[0] + y*width*2;
+        uint8_t *dy = dest[0] + y*width;
+        uint8_t *du = dest[1] + (y/2)*(width/2);
+        uint8_t *dv = dest[2] + (y/2)*(width/2);
+
+        for (x = 0; x+32 <= w2; x += 32) {
+            __m256i a, b, Y, UV;
+            __m128i U, V;
+
+            /* PACKUSWB packs within lanes, leaving the quadwords in
+             * 0,2,1,3 order; VPERMQ with 0xD8 puts them back */
+            a = _mm256_loadu_si256((const __m256i *)(s + x*2));
+            b = _mm256_loadu_si256((const __m256i *)(s + x*2 + 32));
+            Y = _mm256_packus_epi16(_mm256_and_si256(a, evenmask),
+                                    _mm256_and_si256(b, evenmask));
+            Y = _mm256_permute4x64_epi64(Y, 0xD8);
+            _mm256_storeu_si256((__m256i *)(dy+x), Y);
+            UV = _mm256_packus_epi16(_mm256_srli_epi16(a, 8),
+                                     _mm256_srli_epi16(b, 8));
+            UV = _mm256_permute4x64_epi64(UV, 0xD8);
+            UV = _mm256_packus_epi16(_mm256_and_si256(UV, evenmask),
+                                     _mm256_srli_epi16(UV, 8));
+            UV = _mm256_permute4x64_epi64(UV, 0xD8);
+            U = _mm256_castsi256_si128(UV);
+            V = _mm256_extracti128_si256(UV, 1);
+            if (y%2 == 1) {
+                U = _mm_avg_epu8(U, _mm_loadu_si128((const __m128i *)(du+x/2)));
+                V = _mm_avg_epu8(V, _mm_loadu_si128((const __m128i *)(dv+x/2)));
+            }
+            _mm_storeu_si128((__m128i *)(du+x/2), U);
+            _mm_storeu_si128((__m128i *)(dv+x/2), V);
+        }
+
+        for (; x < w2; x += 2) {
+            dy[x  ] = s[x*2  ];
+            dy[x+1] = s[x*2+2];
+            if (y%2 == 0) {
+                du[x/2] = s[x*2+1];
+                dv[x/2] = s[x*2+3];
+            } else {
+                du[x/2] = (du[x/2] + s[x*2+1] + 1) / 2;
+                dv[x/2] = (dv[x/2] + s[x*2+3] + 1) / 2;
+            }
+        }
+    }
+    return 1;
+}
+
+/* YUV420P->YUY2 */
+
+static AVX2 int yuv420p_yuy2_avx2(uint8_t **src, uint8_t **dest,
+                                  int width, int height)
+{
+    const int w2 = width & ~1;
+    int x, y;
+
+    for (y = 0; y < (height & ~1); y++) {
+        const uint8_t *sy = src[0] + y*width;
+        const uint8_t *su = src[1] + (y/2)*(width/2);
+        const uint8_t *sv = src[2] + (y/2)*(width/2);
+        uint8_t *d = dest[0] + y*width*2;
+
+        for (x = 0; x+32 <= w2; x += 32) {
+            __m256i Y, UV, lo, hi;
+            __m128i U, V;
+
+            Y = _mm256_loadu_si256((const __m256i *)(sy+x));
+            U = _mm_loadu_si128((const __m128i *)(su+x/2));
+            V = _mm_loadu_si128((const __m128i *)(sv+x/2));
+            UV = _mm256_inserti128_si256(
+                _mm256_castsi128_si256(_mm_unpacklo_epi8(U, V)),
+                _mm_unpackhi_epi8(U, V), 1);
+            lo = _mm256_unpacklo_epi8(Y, UV);  // pixels 0-7, 16-23
+            hi = _mm256_unpackhi_epi8(Y, UV);  // pixels 8-15, 24-31
+            _mm256_storeu_si256((__m256i *)(d + x*2),
+                                _mm256_permute2x128_si256(lo, hi, 0x20));
+            _mm256_storeu_si256((__m256i *)(d + x*2 + 32),
+                                _mm256_permute2x128_si256(lo, hi, 0x31));
+        }
+
+        for (; x < w2; x += 2) {
+            d[x*2  ] = sy[x];
+            d[x*2+1] = su[x/2];
+            d[x*2+2] = sy[x+1];
+            d[x*2+3] = sv[x/2];
+        }
+    }
+    return 1;
+}
+
+/*************************************************************************/
+
+/* YUV->GRAY8 */
+
+static AVX2 int yuvp_gray8_avx2(uint8_t **src, uint8_t **dest,
+                                int width, int height)
+{
+    const uint8_t *s = src[0];
+    uint8_t *d = dest[0];
+    int i;
+
+    for (i = 0; i+32 <= width*height; i += 32) {
+        __m256i v = _mm256_loadu_si256((const __m256i *)(s+i));
+        _mm256_storeu_si256((__m256i *)(d+i), y_to_gray(v));
+    }
+    for (; i < width*height; i++)
+        d[i] = s[i]<=16 ? 0 : s[i]>=235 ? 255 : (s[i]-16)*255/219;
+    return 1;
+}
+
+/* Packed YUV->GRAY8; `ofs' is 0 for YUY2/YVYU, 1 for UYVY */
+static inline AVX2 void packed_gray8_avx2(uint8_t **src, uint8_t **dest,
+                                          int width, int height, int ofs)
+{
+    const __m256i evenmask = _mm256_set1_epi16(0x00FF);
+    const uint8_t *s = src[0];
+    uint8_t *d = dest[0];
+    int i;
+
+    for (i = 0; i+32 <= width*height; i += 32) {
+        __m256i a = _mm256_loadu_si256((const __m256i *)(s + i*2));
+        __m256i b = _mm256_loadu_si256((const __m256i *)(s + i*2 + 32));
+        if (ofs) {
+            a = _mm256_srli_epi16(a, 8);
+            b = _mm256_srli_epi16(b, 8);
+        } else {
+            a = _mm256_and_si256(a, evenmask);
+            b = _mm256_and_si256(b, evenmask);
+        }
+        a = _mm256_permute4x64_epi64(_mm256_packus_epi16(a, b), 0xD8);
+        _mm256_storeu_si256((__m256i *)(d+i), y_to_gray(a));
+    }
+    for (; i < width*height; i++) {
+        int Y = s[i*2+ofs];
+        d[i] = Y<=16 ? 0 : Y>=235 ? 255 : (Y-16)*255/219;
+    }
+}
+
+static AVX2 int yuy2_gray8_avx2(uint8_t **src, uint8_t **dest,
+                                int width, int height)
+{
+    packed_gray8_avx2(src, dest, width, height, 0);
+    return 1;
+}
+
+static AVX2 int uyvy_gray8_avx2(uint8_t **src, uint8_t **dest,
+                                int width, int height)
+{
+    packed_gray8_avx2(src, dest, width, height, 1);
+    return 1;
+}
+
+/* GRAY8->Y8: 16 + g*219/255 */
+
+static AVX2 int gray8_y8_avx2(uint8_t **src, uint8_t **dest,
+                              int width, int height)
+{
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i mul = _mm256_set1_epi16(14071);  // (g<<2)*14071>>16 == g*219/255
+    const __m256i sixteen = _mm256_set1_epi8(16);
+    const uint8_t *s = src[0];
+    uint8_t *d = dest[0];
+    int i;
+
+    for (i = 0; i+32 <= width*height; i += 32) {
+        __m256i v = _mm256_loadu_si256((const __m256i *)(s+i));
+        __m256i lo = _mm256_slli_epi16(_mm256_unpacklo_epi8(v, zero), 2);
+        __m256i hi = _mm256_slli_epi16(_mm256_unpackhi_epi8(v, zero), 2);
+        v = _mm256_packus_epi16(_mm256_mulhi_epu16(lo, mul),
+                                _mm256_mulhi_epu16(hi, mul));
+        _mm256_storeu_si256((__m256i *)(d+i), _mm256_add_epi8(v, sixteen));
+    }
+    for (; i < width*height; i++)
+        d[i] = 16 + s[i]*219/255;
+    return 1;
+}
+
+/*************************************************************************/
+
+/* RGB24/BGR24->GRAY8 */
+
+static inline AVX2 void rgb_gray8_avx2(uint8_t **src, uint8_t **dest,
+                                       int width, int height, int bgr)
+{
+    const int rofs = bgr ? 2 : 0, bofs = bgr ? 0 : 2;
+    const uint8_t *s = src[0];
+    uint8_t *d = dest[0];
+    int i;
+
+    for (i = 0; i+32 <= width*height; i += 32) {
+        __m256i in[3], rgb[3];
+        load_packed3(s + i*3, in);
+        shuffle3(in[0], in[1], in[2], unpack3_mask, rgb);
+        _mm256_storeu_si256((__m256i *)(d+i),
+                            madd3(rgb[rofs], rgb[1], rgb[bofs],
+                                  19595, 19235, 19235, 7471, 0));
+    }
+    for (; i < width*height; i++) {
+        int r = s[i*3+rofs], g = s[i*3+1], b = s[i*3+bofs];
+        d[i] = (19595*r + 38470*g + 7471*b + 32768) >> 16;
+    }
+}
+
+static AVX2 int rgb24_gray8_avx2(uint8_t **src, uint8_t **dest,
+                                 int width, int height)
+{
+    rgb_gray8_avx2(src, dest, width, height, 0);
+    return 1;
+}
+
+static AVX2 int bgr24_gray8_avx2(uint8_t **src, uint8_t **dest,
+                                 int width, int height)
+{
+    rgb_gray8_avx2(src, dest, width, height, 1);
+    return 1;
+}
+
+/* GRAY8->RGB24/BGR24 */
+
+static AVX2 int gray8_rgb24_avx2(uint8_t **src, uint8_t **dest,
+                                 int width, int height)
+{
+    const uint8_t *s = src[0];
+    uint8_t *d = dest[0];
+    int i;
+
+    for (i = 0; i+32 <= width*height; i += 32) {
+        __m256i v, out[3];
+        int k;
+        v = _mm256_inserti128_si256(
+            _mm256_castsi128_si256(_mm_loadu_si128((const __m128i *)(s+i))),
+            _mm_loadu_si128((const __m128i *)(s+i+16)), 1);
+        for (k = 0; k < 3; k++)
+            out[k] = _mm256_shuffle_epi8(v, bcast(gray3_mask[k][0]));
+        store_packed3(d + i*3, out);
+    }
+    for (; i < width*height; i++) {
+        d[i*3  ] = s[i];
+        d[i*3+1] = s[i];
+        d[i*3+2] = s[i];
+    }
+    return 1;
+}
+
+#endif  /* HAVE_AVX2_INTRINSICS */
+
+/*************************************************************************/
+/*************************************************************************/
+
+/* Initialization */
+
+int ac_imgconvert_init_avx2(int accel)
+{
+#ifdef HAVE_AVX2_INTRINSICS
+    if (HAS_ACCEL(accel, AC_AVX2)) {
+        if (!register_conversion(IMG_YUV420P, IMG_RGB24,   yuv420p_rgb24_avx2)
+         || !register_conversion(IMG_YUV420P, IMG_BGR24,   yuv420p_bgr24_avx2)
+         || !register_conversion(IMG_RGB24,   IMG_YUV420P, rgb24_yuv420p_avx2)
+         || !register_conversion(IMG_BGR24,   IMG_YUV420P, bgr24_yuv420p_avx2)
+         || !register_conversion(IMG_RGB24,   IMG_BGR24,   rgb24_bgr24_avx2)
+         || !register_conversion(IMG_BGR24,   IMG_RGB24,   rgb24_bgr24_avx2)
+         || !register_conversion(IMG_YUY2,    IMG_YUV420P, yuy2_yuv420p_avx2)
+         || !register_conversion(IMG_YUV420P, IMG_YUY2,    yuv420p_yuy2_avx2)
+
+         || !register_conversion(IMG_YUV420P, IMG_GRAY8,   yuvp_gray8_avx2)
+         || !register_conversion(IMG_YUV411P, IMG_GRAY8,   yuvp_gray8_avx2)
+         || !register_conversion(IMG_YUV422P, IMG_GRAY8,   yuvp_gray8_avx2)
+         || !register_conversion(IMG_YUV444P, IMG_GRAY8,   yuvp_gray8_avx2)
+         || !register_conversion(IMG_Y8,      IMG_GRAY8,   yuvp_gray8_avx2)
+         || !register_conversion(IMG_YUY2,    IMG_GRAY8,   yuy2_gray8_avx2)
+         || !register_conversion(IMG_YVYU,    IMG_GRAY8,   yuy2_gray8_avx2)
+         || !register_conversion(IMG_UYVY,    IMG_GRAY8,   uyvy_gray8_avx2)
+         || !register_conversion(IMG_GRAY8,   IMG_Y8,      gray8_y8_avx2)
+         || !register_conversion(IMG_RGB24,   IMG_GRAY8,   rgb24_gray8_avx2)
+         || !register_conversion(IMG_BGR24,   IMG_GRAY8,   bgr24_gray8_avx2)
+         || !register_conversion(IMG_GRAY8,   IMG_RGB24,   gray8_rgb24_avx2)
+         || !register_conversion(IMG_GRAY8,   IMG_BGR24,   gray8_rgb24_avx2)
+        ) {
+            return 0;
+        }
+    }
+#endif
+    return 1;
+}
+
+/*************************************************************************/
+
+/*
+ * Local variables:
+ *   c-file-style: "stroustrup"
+ *   c-file-offsets: ((case-label . *) (statement-case-intro . *))
+ *   indent-tabs-mode: nil
+ * End:
+ *
+ * vim: expandtab shiftwidth=4:
+ */
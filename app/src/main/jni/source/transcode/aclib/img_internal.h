@@ -26,6 +26,8 @@ extern int ac_imgconvert_init_yuv_packed(int accel);
 extern int ac_imgconvert_init_yuv_mixed(int accel);
 extern int ac_imgconvert_init_yuv_rgb(int accel);
 extern int ac_imgconvert_init_rgb_packed(int accel);
+extern int ac_imgconvert_init_vector(int accel);
+extern int ac_imgconvert_init_avx2(int accel);
 
 #endif  /* ACLIB_IMG_INTERNAL_H */
 
@@ -0,0 +1,680 @@
+/*
+ * img_vector.c - image format conversion routines using compiler vector
+ *                extensions
+ *
+ * This file is part of transcode, a video stream processing tool.
+ * transcode is free software, distributable under the terms of the GNU
+ * General Public License (version 2 or later).  See the file COPYING
+ * for details.
+ */
+
+#include "ac.h"
+#include "ac_internal.h"
+#include "imgconvert.h"
+#include "img_internal.h"
+
+#include <string.h>
+
+/*************************************************************************/
+/*************************************************************************/
+
+/* The routines in this file are written with the GCC/Clang vector
+ * extensions instead of assembly, so that the same source compiles to
+ * NEON on ARM, AltiVec on PowerPC, and so on; they are the only
+ * accelerated conversions on CPUs other than x86.  Vectors are 16 bytes
+ * wide, the size of a register on all of those units, and each loop
+ * iteration handles 16 pixels; the pixels left over at the end of a row
+ * are converted one at a time.
+ *
+ * All arithmetic is done in 32 bits with the same constants as the C
+ * versions in img_yuv_rgb.c and img_rgb_packed.c, so the results are the
+ * same as those of the C routines (except for YUV->RGB, where the C
+ * routines use lookup tables which may be off by one).
+ *
+ * ac_imgconvert_init_vector() only registers these routines when SSE2 is
+ * not in use: plain SSE2 has no general byte shuffle, so on x86 these
+ * routines are often no faster than C and are compiled only so that they
+ * can be tested ("test-imgconvert -C vector"). */
+
+#ifdef HAVE_VECTOR_EXT
+
+/*************************************************************************/
+
+typedef uint8_t  vu8  __attribute__((vector_size(16)));
+typedef int32_t  vs32 __attribute__((vector_size(16)));
+typedef uint32_t vu32 __attribute__((vector_size(16)));
+
+/* YUV<->RGB coefficients (see img_yuv_rgb.c) */
+enum {
+    COEF_Y  =  76309,
+    COEF_RV = 104597,
+    COEF_GU = -25675,
+    COEF_GV = -53279,
+    COEF_BU = 132201,
+};
+
+/* Y<->grayscale scaling as multiply-and-shift, exact for all inputs:
+ *     (n*255/219) == (n*Y_GRAY_MUL) >> Y_GRAY_SHIFT   for 0 <= n <= 219
+ *     (n*219/255) == (n*GRAY_Y_MUL) >> GRAY_Y_SHIFT   for 0 <= n <= 255 */
+#define Y_GRAY_MUL    9539
+#define Y_GRAY_SHIFT  13
+#define GRAY_Y_MUL    14071
+#define GRAY_Y_SHIFT  14
+
+/*************************************************************************/
+
+/* Shuffle helpers.  SHUF(a,b,f) returns a vector whose lane i is lane f(i)
+ * of the 32-lane concatenation a:b; SEL48(a,b,c,f) does the same for the
+ * 48-lane concatenation a:b:c.  Indices for lanes whose value does not
+ * matter are given as 0. */
+
+#define SEQ16(f)   f(0), f(1), f(2),  f(3),  f(4),  f(5),  f(6),  f(7), \
+                   f(8), f(9), f(10), f(11), f(12), f(13), f(14), f(15)
+#define SEQ16A(f,g) f(g,0),  f(g,1),  f(g,2),  f(g,3),  \
+                    f(g,4),  f(g,5),  f(g,6),  f(g,7),  \
+                    f(g,8),  f(g,9),  f(g,10), f(g,11), \
+                    f(g,12), f(g,13), f(g,14), f(g,15)
+
+#define SHUF(a,b,f)  __builtin_shufflevector((a), (b), SEQ16(f))
+
+#define SEL_LO(g,i)  ((g(i)) < 32 ? (g(i)) : 0)
+#define SEL_HI(g,i)  ((g(i)) < 32 ? (i) : (g(i)) - 16)
+#define SEL48(a,b,c,g) __builtin_shufflevector(                         \
+    __builtin_shufflevector((a), (b), SEQ16A(SEL_LO,g)), (c),           \
+    SEQ16A(SEL_HI,g))
+
+/* Index functions */
+#define DUP(i)     ((i)/2)                              /* a0 a0 a1 a1 ... */
+#define ZIP(i)     ((i)%2 ? 16+(i)/2 : (i)/2)           /* a0 b0 a1 b1 ... */
+#define ZIPH(i)    ((i)%2 ? 24+(i)/2 : 8+(i)/2)         /* a8 b8 a9 b9 ... */
+#define EVEN(i)    (2*(i))                              /* a0 a2 ... b14 */
+#define ODD(i)     (2*(i)+1)                            /* a1 a3 ... b15 */
+#define QUAD1(i)   ((i) < 8 ? 4*(i)+1 : 0)              /* a1 a5 ... b13 */
+#define QUAD3(i)   ((i) < 8 ? 4*(i)+3 : 0)              /* a3 a7 ... b15 */
+#define HALF0(i)   ((i) < 8 ? 2*(i) : 0)                /* a0 a2 ... a14 */
+#define HALF1(i)   ((i) < 8 ? 2*(i)+1 : 0)              /* a1 a3 ... a15 */
+/* 48-lane index functions */
+#define CHAN0(i)   (3*(i))                              /* R of RGB */
+#define CHAN1(i)   (3*(i)+1)                            /* G of RGB */
+#define CHAN2(i)   (3*(i)+2)                            /* B of RGB */
+#define PIX3(n)    ((n)%3*16 + (n)/3)                   /* interleave */
+#define PIX3_0(i)  PIX3(i)
+#define PIX3_1(i)  PIX3((i)+16)
+#define PIX3_2(i)  PIX3((i)+32)
+#define SWAP3(n)   ((n) - (n)%3 + 2 - (n)%3)            /* RGB<->BGR */
+#define SWAP3_0(i) SWAP3(i)
+#define SWAP3_1(i) SWAP3((i)+16)
+#define SWAP3_2(i) SWAP3((i)+32)
+
+/* Zero-extend the 16 bytes of `v' to 32 bits in w[0..3], with byte 4*k+j
+ * of `v' going to lane k of w[j].  The pixels end up out of order, but as
+ * the arithmetic is done per pixel that does not matter, and NARROW4 puts
+ * them back in order; this way only shifts and masks are needed, which
+ * every vector unit does well (unlike arbitrary byte shuffles).  Like the
+ * casts in SHUF users, this relies on a little-endian CPU. */
+#define WIDEN4(w,v) do {                                                \
+    const vu32 t__ = (vu32)(v);                                         \
+    (w)[0] = (vs32)(t__ & 255);                                         \
+    (w)[1] = (vs32)((t__ >> 8) & 255);                                  \
+    (w)[2] = (vs32)((t__ >> 16) & 255);                                 \
+    (w)[3] = (vs32)(t__ >> 24);                                         \
+} while (0)
+
+/* Pack the 32-bit values (0-255) in w[0..3] back to bytes */
+#define NARROW4(w)                                                      \
+    ((vu8)((vu32)(w)[0] | (vu32)(w)[1] << 8                             \
+           | (vu32)(w)[2] << 16 | (vu32)(w)[3] << 24))
+
+/* Saturate 32-bit lanes to 0..255 */
+#define CLAMP255(v)  ((((v) & ~((v) >> 31)) | ((255 - (v)) >> 31)) & 255)
+
+/*************************************************************************/
+
+/* Per-pixel arithmetic on four pixels at a time */
+
+static inline void yuv2rgb_vec(vs32 Y, vs32 U, vs32 V,
+                               vs32 *r, vs32 *g, vs32 *b)
+{
+    Y = (Y - 16) * COEF_Y;
+    U -= 128;
+    V -= 128;
+    *r = (Y + COEF_RV*V + 32768) >> 16;
+    *g = (Y + COEF_GU*U + COEF_GV*V + 32768) >> 16;
+    *b = (Y + COEF_BU*U + 32768) >> 16;
+    *r = CLAMP255(*r);
+    *g = CLAMP255(*g);
+    *b = CLAMP255(*b);
+}
+
+static inline vs32 rgb2y_vec(vs32 r, vs32 g, vs32 b)
+{
+    return ((16829*r + 33039*g + 6416*b + 32768) >> 16) + 16;
+}
+
+static inline vs32 rgb2u_vec(vs32 r, vs32 g, vs32 b)
+{
+    return ((-9714*r - 19070*g + 28784*b + 32768) >> 16) + 128;
+}
+
+static inline vs32 rgb2v_vec(vs32 r, vs32 g, vs32 b)
+{
+    return ((28784*r - 24103*g - 4681*b + 32768) >> 16) + 128;
+}
+
+static inline vs32 rgb2gray_vec(vs32 r, vs32 g, vs32 b)
+{
+    return (19595*r + 38470*g + 7471*b + 32768) >> 16;
+}
+
+static inline vs32 y2gray_vec(vs32 n)
+{
+    vs32 m;
+    n -= 16;
+    n &= ~(n >> 31);                    /* max(n, 0) */
+    m = (219 - n) >> 31;
+    n = (n & ~m) | (219 & m);           /* min(n, 219) */
+    return (n * Y_GRAY_MUL) >> Y_GRAY_SHIFT;
+}
+
+/*************************************************************************/
+
+/* Scalar helper for the pixels left over at the end of a row */
+
+static void yuv2rgb_pixel(int Y, int U, int V, uint8_t *dest, int bgr)
+{
+    int r, g, b;
+
+    Y = COEF_Y * (Y - 16);
+    U -= 128;
+    V -= 128;
+    r = (Y + COEF_RV*V + 32768) >> 16;
+    g = (Y + COEF_GU*U + COEF_GV*V + 32768) >> 16;
+    b = (Y + COEF_BU*U + 32768) >> 16;
+    dest[bgr ? 2 : 0] = r<0 ? 0 : r>255 ? 255 : r;
+    dest[1]           = g<0 ? 0 : g>255 ? 255 : g;
+    dest[bgr ? 0 : 2] = b<0 ? 0 : b>255 ? 255 : b;
+}
+
+/*************************************************************************/
+
+/* YUV420P->RGB24 (bgr == 0) or BGR24 (bgr != 0) */
+
+static int yuv420p_rgb(uint8_t **src, uint8_t **dest, int width, int height,
+                       int bgr)
+{
+    int x, y;
+
+    for (y = 0; y < height; y++) {
+        const uint8_t *sy = src[0] + y*width;
+        const uint8_t *su = src[1] + (y/2)*(width/2);
+        const uint8_t *sv = src[2] + (y/2)*(width/2);
+        uint8_t *d = dest[0] + y*width*3;
+
+        for (x = 0; x+16 <= width; x += 16) {
+            vu8 y8, u8 = {0}, v8 = {0}, r8, g8, b8, out[3];
+            vs32 Y[4], U[4], V[4], r[4], g[4], b[4];
+
+            memcpy(&y8, sy+x, 16);
+            memcpy(&u8, su+x/2, 8);
+            memcpy(&v8, sv+x/2, 8);
+            u8 = SHUF(u8, u8, DUP);
+            v8 = SHUF(v8, v8, DUP);
+            WIDEN4(Y, y8);
+            WIDEN4(U, u8);
+            WIDEN4(V, v8);
+            yuv2rgb_vec(Y[0], U[0], V[0], &r[0], &g[0], &b[0]);
+            yuv2rgb_vec(Y[1], U[1], V[1], &r[1], &g[1], &b[1]);
+            yuv2rgb_vec(Y[2], U[2], V[2], &r[2], &g[2], &b[2]);
+            yuv2rgb_vec(Y[3], U[3], V[3], &r[3], &g[3], &b[3]);
+            r8 = NARROW4(r);
+            g8 = NARROW4(g);
+            b8 = NARROW4(b);
+            if (bgr) {
+                vu8 t = r8;
+                r8 = b8;
+                b8 = t;
+            }
+            out[0] = SEL48(r8, g8, b8, PIX3_0);
+            out[1] = SEL48(r8, g8, b8, PIX3_1);
+            out[2] = SEL48(r8, g8, b8, PIX3_2);
+            memcpy(d + x*3, out, 48);
+        }
+        for (; x < width; x++)
+            yuv2rgb_pixel(sy[x], su[x/2], sv[x/2], d + x*3, bgr);
+    }
+    return 1;
+}
+
+static int yuv420p_rgb24_vector(uint8_t **src, uint8_t **dest,
+                                int width, int height)
+{
+    return yuv420p_rgb(src, dest, width, height, 0);
+}
+
+static int yuv420p_bgr24_vector(uint8_t **src, uint8_t **dest,
+                                int width, int height)
+{
+    return yuv420p_rgb(src, dest, width, height, 1);
+}
+
+/*************************************************************************/
+
+/* RGB24 (bgr == 0) or BGR24 (bgr != 0) ->YUV420P.  As in the C version,
+ * U is taken from the even pixels of even rows and V from the odd pixels
+ * of odd rows. */
+
+static int rgb_yuv420p(uint8_t **src, uint8_t **dest, int width, int height,
+                       int bgr)
+{
+    const int rofs = bgr ? 2 : 0, bofs = bgr ? 0 : 2;
+    int x, y;
+
+    for (y = 0; y < height; y++) {
+        const uint8_t *s = src[0] + y*width*3;
+        uint8_t *dy = dest[0] + y*width;
+        uint8_t *duv = dest[y%2 ? 2 : 1] + (y/2)*(width/2);
+
+        for (x = 0; x+16 <= width; x += 16) {
+            vu8 in[3], r8, g8, b8, c8;
+            vs32 r[4], g[4], b[4], c[4];
+
+            memcpy(in, s + x*3, 48);
+            r8 = SEL48(in[0], in[1], in[2], CHAN0);
+            g8 = SEL48(in[0], in[1], in[2], CHAN1);
+            b8 = SEL48(in[0], in[1], in[2], CHAN2);
+            if (bgr) {
+                vu8 t = r8;
+                r8 = b8;
+                b8 = t;
+            }
+            WIDEN4(r, r8);
+            WIDEN4(g, g8);
+            WIDEN4(b, b8);
+            c[0] = rgb2y_vec(r[0], g[0], b[0]);
+            c[1] = rgb2y_vec(r[1], g[1], b[1]);
+            c[2] = rgb2y_vec(r[2], g[2], b[2]);
+            c[3] = rgb2y_vec(r[3], g[3], b[3]);
+            c8 = NARROW4(c);
+            memcpy(dy+x, &c8, 16);
+            if (y%2 == 0) {
+                c[0] = rgb2u_vec(r[0], g[0], b[0]);
+                c[1] = rgb2u_vec(r[1], g[1], b[1]);
+                c[2] = rgb2u_vec(r[2], g[2], b[2]);
+                c[3] = rgb2u_vec(r[3], g[3], b[3]);
+                c8 = NARROW4(c);
+                c8 = SHUF(c8, c8, HALF0);
+            } else {
+                c[0] = rgb2v_vec(r[0], g[0], b[0]);
+                c[1] = rgb2v_vec(r[1], g[1], b[1]);
+                c[2] = rgb2v_vec(r[2], g[2], b[2]);
+                c[3] = rgb2v_vec(r[3], g[3], b[3]);
+                c8 = NARROW4(c);
+                c8 = SHUF(c8, c8, HALF1);
+            }
+            memcpy(duv + x/2, &c8, 8);
+        }
+        for (; x < width; x++) {
+            int r = s[x*3+rofs], g = s[x*3+1], b = s[x*3+bofs];
+            dy[x] = ((16829*r + 33039*g + 6416*b + 32768) >> 16) + 16;
+            if (y%2 == 0 && x%2 == 0)
+                duv[x/2] = ((-9714*r - 19070*g + 28784*b + 32768) >> 16) + 128;
+            else if (y%2 == 1 && x%2 == 1)
+                duv[x/2] = ((28784*r - 24103*g - 4681*b + 32768) >> 16) + 128;
+        }
+    }
+    return 1;
+}
+
+static int rgb24_yuv420p_vector(uint8_t **src, uint8_t **dest,
+                                int width, int height)
+{
+    return rgb_yuv420p(src, dest, width, height, 0);
+}
+
+static int bgr24_yuv420p_vector(uint8_t **src, uint8_t **dest,
+                                int width, int height)
+{
+    return rgb_yuv420p(src, dest, width, height, 1);
+}
+
+/*************************************************************************/
+
+/* RGB24<->BGR24 (the same operation in both directions) */
+
+static int rgb24_bgr24_vector(uint8_t **src, uint8_t **dest,
+                              int width, int height)
+{
+    const uint8_t *s = src[0];
+    uint8_t *d = dest[0];
+    int i;
+
+    for (i = 0; i+16 <= width*height; i += 16) {
+        vu8 in[3], out[3];
+        memcpy(in, s + i*3, 48);
+        out[0] = SEL48(in[0], in[1], in[2], SWAP3_0);
+        out[1] = SEL48(in[0], in[1], in[2], SWAP3_1);
+        out[2] = SEL48(in[0], in[1], in[2], SWAP3_2);
+        memcpy(d + i*3, out, 48);
+    }
+    for (; i < width*height; i++) {
+        uint8_t t = s[i*3];
+        d[i*3  ] = s[i*3+2];
+        d[i*3+1] = s[i*3+1];
+        d[i*3+2] = t;
+    }
+    return 1;
+}
+
+/*************************************************************************/
+
+/* YUY2->YUV420P; the chroma of each pair of rows is averaged */
+
+static int yuy2_yuv420p_vector(uint8_t **src, uint8_t **dest,
+                               int width, int height)
+{
+    const int w2 = width & ~1;
+    int x, y;
+
+    for (y = 0; y < (height & ~1); y++) {
+        const uint8_t *s = src[0] + y*width*2;
+        uint8_t *dy = dest[0] + y*width;
+        uint8_t *du = dest[1] + (y/2)*(width/2);
+        uint8_t *dv = dest[2] + (y/2)*(width/2);
+
+        for (x = 0; x+16 <= w2; x += 16) {
+            vu8 in[2], y8, u8, v8;
+
+            memcpy(in, s + x*2, 32);
+            y8 = SHUF(in[0], in[1], EVEN);
+            u8 = SHUF(in[0], in[1], QUAD1);
+            v8 = SHUF(in[0], in[1], QUAD3);
+            memcpy(dy+x, &y8, 16);
+            if (y%2 == 1) {
+                /* (a+b+1)/2 without overflowing 8 bits */
+                vu8 pu = {0}, pv = {0};
+                memcpy(&pu, du + x/2, 8);
+                memcpy(&pv, dv + x/2, 8);
+                u8 = (u8 | pu) - ((u8 ^ pu) >> 1);
+                v8 = (v8 | pv) - ((v8 ^ pv) >> 1);
+            }
+            memcpy(du + x/2, &u8, 8);
+            memcpy(dv + x/2, &v8, 8);
+        }
+        for (; x < w2; x += 2) {
+            dy[x  ] = s[x*2  ];
+            dy[x+1] = s[x*2+2];
+            if (y%2 == 0) {
+                du[x/2] = s[x*2+1];
+                dv[x/2] = s[x*2+3];
+            } else {
+                du[x/2] = (du[x/2] + s[x*2+1] + 1) / 2;
+                dv[x/2] = (dv[x/2] + s[x*2+3] + 1) / 2;
+            }
+        }
+    }
+    return 1;
+}
+
+/* YUV420P->YUY2 */
+
+static int yuv420p_yuy2_vector(uint8_t **src, uint8_t **dest,
+                               int width, int height)
+{
+    const int w2 = width & ~1;
+    int x, y;
+
+    for (y = 0; y < (height & ~1); y++) {
+        const uint8_t *sy = src[0] + y*width;
+        const uint8_t *su = src[1] + (y/2)*(width/2);
+        const uint8_t *sv = src[2] + (y/2)*(width/2);
+        uint8_t *d = dest[0] + y*width*2;
+
+        for (x = 0; x+16 <= w2; x += 16) {
+            vu8 y8, u8 = {0}, v8 = {0}, uv, out[2];
+
+            memcpy(&y8, sy+x, 16);
+            memcpy(&u8, su + x/2, 8);
+            memcpy(&v8, sv + x/2, 8);
+            uv = SHUF(u8, v8, ZIP);
+            out[0] = SHUF(y8, uv, ZIP);
+            out[1] = SHUF(y8, uv, ZIPH);
+            memcpy(d + x*2, out, 32);
+        }
+        for (; x < w2; x += 2) {
+            d[x*2  ] = sy[x];
+            d[x*2+1] = su[x/2];
+            d[x*2+2] = sy[x+1];
+            d[x*2+3] = sv[x/2];
+        }
+    }
+    return 1;
+}
+
+/*************************************************************************/
+
+/* YUV->GRAY8: convert 16 Y values to grayscale */
+
+static inline vu8 y8_to_gray(vu8 y8)
+{
+    vs32 n[4];
+
+    WIDEN4(n, y8);
+    n[0] = y2gray_vec(n[0]);
+    n[1] = y2gray_vec(n[1]);
+    n[2] = y2gray_vec(n[2]);
+    n[3] = y2gray_vec(n[3]);
+    return NARROW4(n);
+}
+
+static int y2gray(int Y)
+{
+    return Y <= 16 ? 0 : Y >= 235 ? 255 : (Y-16) * 255 / 219;
+}
+
+static int yuvp_gray8_vector(uint8_t **src, uint8_t **dest,
+                             int width, int height)
+{
+    const uint8_t *s = src[0];
+    uint8_t *d = dest[0];
+    int i;
+
+    for (i = 0; i+16 <= width*height; i += 16) {
+        vu8 v;
+        memcpy(&v, s+i, 16);
+        v = y8_to_gray(v);
+        memcpy(d+i, &v, 16);
+    }
+    for (; i < width*height; i++)
+        d[i] = y2gray(s[i]);
+    return 1;
+}
+
+/* `ofs' is 0 for YUY2/YVYU, 1 for UYVY */
+static int packed_gray8(uint8_t **src, uint8_t **dest, int width, int height,
+                        int ofs)
+{
+    const uint8_t *s = src[0];
+    uint8_t *d = dest[0];
+    int i;
+
+    for (i = 0; i+16 <= width*height; i += 16) {
+        vu8 in[2], v;
+        memcpy(in, s + i*2, 32);
+        v = ofs ? SHUF(in[0], in[1], ODD) : SHUF(in[0], in[1], EVEN);
+        v = y8_to_gray(v);
+        memcpy(d+i, &v, 16);
+    }
+    for (; i < width*height; i++)
+        d[i] = y2gray(s[i*2+ofs]);
+    return 1;
+}
+
+static int yuy2_gray8_vector(uint8_t **src, uint8_t **dest,
+                             int width, int height)
+{
+    return packed_gray8(src, dest, width, height, 0);
+}
+
+static int uyvy_gray8_vector(uint8_t **src, uint8_t **dest,
+                             int width, int height)
+{
+    return packed_gray8(src, dest, width, height, 1);
+}
+
+/* GRAY8->Y8 */
+
+static int gray8_y8_vector(uint8_t **src, uint8_t **dest,
+                           int width, int height)
+{
+    const uint8_t *s = src[0];
+    uint8_t *d = dest[0];
+    int i;
+
+    for (i = 0; i+16 <= width*height; i += 16) {
+        vu8 v;
+        vs32 n[4];
+        memcpy(&v, s+i, 16);
+        WIDEN4(n, v);
+        n[0] = ((n[0] * GRAY_Y_MUL) >> GRAY_Y_SHIFT) + 16;
+        n[1] = ((n[1] * GRAY_Y_MUL) >> GRAY_Y_SHIFT) + 16;
+        n[2] = ((n[2] * GRAY_Y_MUL) >> GRAY_Y_SHIFT) + 16;
+        n[3] = ((n[3] * GRAY_Y_MUL) >> GRAY_Y_SHIFT) + 16;
+        v = NARROW4(n);
+        memcpy(d+i, &v, 16);
+    }
+    for (; i < width*height; i++)
+        d[i] = 16 + s[i]*219/255;
+    return 1;
+}
+
+/*************************************************************************/
+
+/* RGB24 (bgr == 0) or BGR24 (bgr != 0) ->GRAY8 */
+
+static int rgb_gray8(uint8_t **src, uint8_t **dest, int width, int height,
+                     int bgr)
+{
+    const int rofs = bgr ? 2 : 0, bofs = bgr ? 0 : 2;
+    const uint8_t *s = src[0];
+    uint8_t *d = dest[0];
+    int i;
+
+    for (i = 0; i+16 <= width*height; i += 16) {
+        vu8 in[3], r8, g8, b8;
+        vs32 r[4], g[4], b[4];
+
+        memcpy(in, s + i*3, 48);
+        r8 = SEL48(in[0], in[1], in[2], CHAN0);
+        g8 = SEL48(in[0], in[1], in[2], CHAN1);
+        b8 = SEL48(in[0], in[1], in[2], CHAN2);
+        if (bgr) {
+            vu8 t = r8;
+            r8 = b8;
+            b8 = t;
+        }
+        WIDEN4(r, r8);
+        WIDEN4(g, g8);
+        WIDEN4(b, b8);
+        r[0] = rgb2gray_vec(r[0], g[0], b[0]);
+        r[1] = rgb2gray_vec(r[1], g[1], b[1]);
+        r[2] = rgb2gray_vec(r[2], g[2], b[2]);
+        r[3] = rgb2gray_vec(r[3], g[3], b[3]);
+        r8 = NARROW4(r);
+        memcpy(d+i, &r8, 16);
+    }
+    for (; i < width*height; i++) {
+        int r = s[i*3+rofs], g = s[i*3+1], b = s[i*3+bofs];
+        d[i] = (19595*r + 38470*g + 7471*b + 32768) >> 16;
+    }
+    return 1;
+}
+
+static int rgb24_gray8_vector(uint8_t **src, uint8_t **dest,
+                              int width, int height)
+{
+    return rgb_gray8(src, dest, width, height, 0);
+}
+
+static int bgr24_gray8_vector(uint8_t **src, uint8_t **dest,
+                              int width, int height)
+{
+    return rgb_gray8(src, dest, width, height, 1);
+}
+
+/* GRAY8->RGB24/BGR24 */
+
+static int gray8_rgb24_vector(uint8_t **src, uint8_t **dest,
+                              int width, int height)
+{
+    const uint8_t *s = src[0];
+    uint8_t *d = dest[0];
+    int i;
+
+    for (i = 0; i+16 <= width*height; i += 16) {
+        vu8 v, out[3];
+        memcpy(&v, s+i, 16);
+        out[0] = SEL48(v, v, v, PIX3_0);
+        out[1] = SEL48(v, v, v, PIX3_1);
+        out[2] = SEL48(v, v, v, PIX3_2);
+        memcpy(d + i*3, out, 48);
+    }
+    for (; i < width*height; i++) {
+        d[i*3  ] = s[i];
+        d[i*3+1] = s[i];
+        d[i*3+2] = s[i];
+    }
+    return 1;
+}
+
+#endif  /* HAVE_VECTOR_EXT */
+
+/*************************************************************************/
+/*************************************************************************/
+
+/* Initialization */
+
+int ac_imgconvert_init_vector(int accel)
+{
+#ifdef HAVE_VECTOR_EXT
+    if (HAS_ACCEL(accel, AC_VECTOR) && !(accel & AC_SSE2)) {
+        if (!register_conversion(IMG_YUV420P, IMG_RGB24,   yuv420p_rgb24_vector)
+         || !register_conversion(IMG_YUV420P, IMG_BGR24,   yuv420p_bgr24_vector)
+         || !register_conversion(IMG_RGB24,   IMG_YUV420P, rgb24_yuv420p_vector)
+         || !register_conversion(IMG_BGR24,   IMG_YUV420P, bgr24_yuv420p_vector)
+         || !register_conversion(IMG_RGB24,   IMG_BGR24,   rgb24_bgr24_vector)
+         || !register_conversion(IMG_BGR24,   IMG_RGB24,   rgb24_bgr24_vector)
+         || !register_conversion(IMG_YUY2,    IMG_YUV420P, yuy2_yuv420p_vector)
+         || !register_conversion(IMG_YUV420P, IMG_YUY2,    yuv420p_yuy2_vector)
+
+         || !register_conversion(IMG_YUV420P, IMG_GRAY8,   yuvp_gray8_vector)
+         || !register_conversion(IMG_YUV411P, IMG_GRAY8,   yuvp_gray8_vector)
+         || !register_conversion(IMG_YUV422P, IMG_GRAY8,   yuvp_gray8_vector)
+         || !register_conversion(IMG_YUV444P, IMG_GRAY8,   yuvp_gray8_vector)
+         || !register_conversion(IMG_Y8,      IMG_GRAY8,   yuvp_gray8_vector)
+         || !register_conversion(IMG_YUY2,    IMG_GRAY8,   yuy2_gray8_vector)
+         || !register_conversion(IMG_YVYU,    IMG_GRAY8,   yuy2_gray8_vector)
+         || !register_conversion(IMG_UYVY,    IMG_GRAY8,   uyvy_gray8_vector)
+         || !register_conversion(IMG_GRAY8,   IMG_Y8,      gray8_y8_vector)
+         || !register_conversion(IMG_RGB24,   IMG_GRAY8,   rgb24_gray8_vector)
+         || !register_conversion(IMG_BGR24,   IMG_GRAY8,   bgr24_gray8_vector)
+         || !register_conversion(IMG_GRAY8,   IMG_RGB24,   gray8_rgb24_vector)
+         || !register_conversion(IMG_GRAY8,   IMG_BGR24,   gray8_rgb24_vector)
+        ) {
+            return 0;
+        }
+    }
+#endif
+    return 1;
+}
+
+/*************************************************************************/
+
+/*
+ * Local variables:
+ *   c-file-style: "stroustrup"
+ *   c-file-offsets: ((case-label . *) (statement-case-intro . *))
+ *   indent-tabs-mode: nil
+ * End:
+ *
+ * vim: expandtab shiftwidth=4:
+ */
@@ -75,6 +75,8 @@ int ac_imgconvert_init(int accel)
      || !ac_imgconvert_init_yuv_mixed(accel)
      || !ac_imgconvert_init_yuv_rgb(accel)
      || !ac_imgconvert_init_rgb_packed(accel)
+     || !ac_imgconvert_init_vector(accel)
+     || !ac_imgconvert_init_avx2(accel)
     ) {
         fprintf(stderr, "ac_imgconvert_init() failed");
         return 0;
@@ -3,11 +3,14 @@ LOCAL_PATH :=$(call my-dir)
 #转码 avilib
 
 #源文件
-MY_AVILIB_SRC_FILES := avilib.c platform_posix.c
+MY_AVILIB_SRC_FILES := avilib.c platform_posix.c platform_copy.c
 
 #包含导出路径
 MY_AVILIB_C_INCLUDES := $(LOCAL_PATH)
 
+#没有config.h, 手动启用mmap
+MY_AVILIB_CFLAGS := -DHAVE_MMAP
+
 #avilib静态
 include $(CLEAR_VARS)
 
@@ -17,6 +20,8 @@ LOCAL_MODULE := avilib_static
 #源文件
 LOCAL_SRC_FILES := $(MY_AVILIB_SRC_FILES)
 
+LOCAL_CFLAGS += $(MY_AVILIB_CFLAGS)
+
 #包含导出路径
 LOCAL_EXPORT_C_INCLUDES := $(MY_AVILIB_C_INCLUDES)
 
@@ -32,6 +37,8 @@ LOCAL_MODULE := avilib_shared
 #源文件
 LOCAL_SRC_FILES := $(MY_AVILIB_SRC_FILES)
 
+LOCAL_CFLAGS += $(MY_AVILIB_CFLAGS)
+
 #包含导出路径
 LOCAL_EXPORT_C_INCLUDES := $(MY_AVILIB_C_INCLUDES)
 
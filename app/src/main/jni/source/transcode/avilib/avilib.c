@@ -34,6 +34,7 @@
 #endif
 
 #include <unistd.h>
+#include <pthread.h>
 
 #include "avilib.h"
 #include "platform.h"
@@ -46,6 +47,14 @@ enum {
     MAX_INFO_STRLEN  = 64,               /* XXX: ???                   */
     FRAME_RATE_SCALE = 1000000,          /* XXX: ???                   */
     HEADERBYTES      = 2048,             /* bytes for the header       */
+    MMAP_WINDOW      = (256*1024*1024),  /* mapping size on 32bit hosts */
+    MMAP_READAHEAD   = 16,               /* frames hinted ahead of use */
+    BATCH_MAX_GAP    = (64*1024),        /* skip at most this much data */
+    BATCH_MAX_READ   = (4*1024*1024),    /* to make one read of this size */
+    PREFETCH_MIN     = 2,                /* frames kept by the read-ahead */
+    WRITER_BUFSIZE   = (4*1024*1024),    /* write-behind buffer size */
+    WRITER_BUFFERS   = 4,                /* and number of buffers */
+    COPY_MAX_RANGE   = (64*1024*1024),   /* largest range copy at once */
 };
 
 /* AVI_MAX_LEN: The maximum length of an AVI file, we stay a bit below
@@ -59,14 +68,32 @@ enum {
 
 static int avi_parse_input_file(avi_t *AVI, int getIndex);
 static int avi_parse_index_from_file(avi_t *AVI, const char *filename);
+static int avi_read_index_cache(avi_t *AVI, FILE *fd, const char *filename);
 static int avi_update_header(avi_t *AVI);
+static void avi_prefetch_seek(avi_prefetch_t *pf, long frame);
+static int avi_copy_flush(avi_t *AVI);
+static off_t avi_file_size(avi_t *AVI);
 
 
 
 /*************************************************************************/
 
-/* The following variable indicates the kind of error */
-static long AVI_errno = 0;
+/* Thread local storage, where the compiler knows about it */
+#ifdef __GNUC__
+#define THREAD_LOCAL __thread
+#else
+#define THREAD_LOCAL
+#endif
+
+/* The following variable indicates the kind of error. Every handle also
+   records its own last error (see AVI_get_error), which is what threads
+   sharing a handle should look at. */
+static THREAD_LOCAL long AVI_errno = 0;
+
+#define AVI_SET_ERROR(x) do { \
+   AVI->avi_errno = (x); \
+   AVI_errno = (x); \
+} while (0)
 
 
 /*************************************************************************/
@@ -137,6 +164,179 @@ static int avi_sampsize(avi_t *AVI, int j)
    return s;
 }
 
+/*************************************************************************/
+/* write-behind thread                                                   */
+
+/*
+ * With write-behind enabled, chunks are copied into large buffers which a
+ * thread writes out (with positional writes) while the caller goes on.
+ * The caller blocks only when all buffers wait for the disk. Write errors
+ * show up at the next chunk, or at the latest in AVI_close.
+ * Buffers head .. head+queued-1 belong to the thread, the one after them
+ * is being filled.
+ */
+
+typedef struct {
+    char  *data;
+    long   len;
+    off_t  pos;                 /* file offset of data[0] */
+} avi_wbuf_t;
+
+struct avi_writer_ {
+    pthread_t       thread;
+    pthread_mutex_t lock;
+    pthread_cond_t  cond;       /* buffer queued, written, or stop */
+    int             running;
+    int             failed;     /* a write failed, errno in err */
+    int             err;
+
+    avi_wbuf_t     *bufs;
+    int             nbufs;
+    long            bufsize;
+    int             head;
+    int             queued;
+    long            backlog;    /* bytes queued */
+};
+
+static void *avi_writer_thread(void *arg)
+{
+    avi_t *AVI = arg;
+    avi_writer_t *wr = AVI->writer;
+    avi_wbuf_t *buf = NULL;
+    ssize_t n;
+
+    pthread_mutex_lock(&wr->lock);
+    while (wr->running || wr->queued > 0) {
+        if (wr->queued == 0) {
+            pthread_cond_wait(&wr->cond, &wr->lock);
+            continue;
+        }
+        buf = &wr->bufs[wr->head];
+        pthread_mutex_unlock(&wr->lock);
+
+        n = plat_pwrite(AVI->fdes, buf->data, buf->len, buf->pos);
+
+        pthread_mutex_lock(&wr->lock);
+        if (n != buf->len && !wr->failed) {
+            wr->failed = 1;
+            wr->err    = errno;
+        }
+        wr->backlog -= buf->len;
+        buf->len = 0;
+        wr->head = (wr->head + 1) % wr->nbufs;
+        wr->queued--;
+        pthread_cond_broadcast(&wr->cond);
+    }
+    pthread_mutex_unlock(&wr->lock);
+    return NULL;
+}
+
+/* hand the buffer being filled to the thread; lock held */
+static void avi_writer_submit(avi_writer_t *wr)
+{
+    avi_wbuf_t *buf = &wr->bufs[(wr->head + wr->queued) % wr->nbufs];
+
+    if (buf->len == 0)
+        return;
+    wr->backlog += buf->len;
+    wr->queued++;
+    pthread_cond_broadcast(&wr->cond);
+
+    /* backpressure: wait for a free buffer */
+    while (wr->queued == wr->nbufs)
+        pthread_cond_wait(&wr->cond, &wr->lock);
+}
+
+/*
+ * append `len' bytes, which go to file offset `pos', to the buffers.
+ * Returns -1 if an earlier write failed.
+ */
+static int avi_writer_append(avi_t *AVI, off_t pos, const char *data, long len)
+{
+    avi_writer_t *wr = AVI->writer;
+    avi_wbuf_t *buf = NULL;
+    long n;
+    int failed;
+
+    pthread_mutex_lock(&wr->lock);
+    /* a buffer holds one stretch of the file; data going elsewhere
+       (after a range copied by other means) starts a new one */
+    buf = &wr->bufs[(wr->head + wr->queued) % wr->nbufs];
+    if (buf->len > 0 && buf->pos + buf->len != pos)
+        avi_writer_submit(wr);
+    while (len > 0 && !wr->failed) {
+        buf = &wr->bufs[(wr->head + wr->queued) % wr->nbufs];
+        if (buf->len == 0)
+            buf->pos = pos;
+        n = wr->bufsize - buf->len;
+        if (n > len)
+            n = len;
+        memcpy(buf->data + buf->len, data, n);
+        buf->len += n;
+        data     += n;
+        pos      += n;
+        len      -= n;
+        if (buf->len == wr->bufsize)
+            avi_writer_submit(wr);
+    }
+    failed = wr->failed;
+    if (failed)
+        errno = wr->err;
+    pthread_mutex_unlock(&wr->lock);
+    return (failed) ?-1 :0;
+}
+
+/*
+ * wait until everything is on disk and put the file offset at the end
+ * of the data, for the code seeking around at close time.
+ */
+static int avi_writer_flush(avi_t *AVI)
+{
+    avi_writer_t *wr = AVI->writer;
+    int failed;
+
+    if (wr == NULL)
+        return 0;
+
+    pthread_mutex_lock(&wr->lock);
+    avi_writer_submit(wr);
+    while (wr->queued > 0)
+        pthread_cond_wait(&wr->cond, &wr->lock);
+    failed = wr->failed;
+    if (failed)
+        errno = wr->err;
+    pthread_mutex_unlock(&wr->lock);
+
+    plat_seek(AVI->fdes, AVI->pos, SEEK_SET);
+    return (failed) ?-1 :0;
+}
+
+static int avi_writer_stop(avi_t *AVI)
+{
+    avi_writer_t *wr = AVI->writer;
+    int i, ret;
+
+    if (wr == NULL)
+        return 0;
+
+    ret = avi_writer_flush(AVI);
+
+    pthread_mutex_lock(&wr->lock);
+    wr->running = 0;
+    pthread_cond_broadcast(&wr->cond);
+    pthread_mutex_unlock(&wr->lock);
+    pthread_join(wr->thread, NULL);
+
+    AVI->writer = NULL;
+    for (i = 0; i < wr->nbufs; i++)
+        plat_free(wr->bufs[i].data);
+    pthread_cond_destroy(&wr->cond);
+    pthread_mutex_destroy(&wr->lock);
+    plat_free(wr->bufs);
+    plat_free(wr);
+    return ret;
+}
+
 /* Add a chunk (=tag and data) to the AVI file,
    returns -1 on write error, 0 on success */
 
@@ -152,6 +352,22 @@ static int avi_add_chunk(avi_t *AVI, const unsigned char *tag,
    memcpy(c,tag,4);
    long2str(c+4,length);
 
+   /* a pending range copy goes first */
+   if (avi_copy_flush(AVI) < 0)
+      return -1;
+
+   if (AVI->writer != NULL) {
+      if (avi_writer_append(AVI, AVI->pos, (char *)c, 8) < 0 ||
+          avi_writer_append(AVI, AVI->pos + 8, (char *)data, length) < 0 ||
+          avi_writer_append(AVI, AVI->pos + 8 + length, &p, length&1) < 0)
+      {
+         AVI_SET_ERROR(AVI_ERR_WRITE);
+         return -1;
+      }
+      AVI->pos += 8 + PAD_EVEN(length);
+      return 0;
+   }
+
    /* Output tag, length and data, restore previous position
       if the write fails */
 
@@ -160,7 +376,7 @@ static int avi_add_chunk(avi_t *AVI, const unsigned char *tag,
        plat_write(AVI->fdes,&p,length&1) != (length&1)) // if len is uneven, write a pad byte
    {
       plat_seek(AVI->fdes,AVI->pos,SEEK_SET);
-      AVI_errno = AVI_ERR_WRITE;
+      AVI_SET_ERROR(AVI_ERR_WRITE);
       return -1;
    }
 
@@ -236,7 +452,7 @@ static int avi_init_super_index(avi_t *AVI, const unsigned char *idxtag,
 
     avisuperindex_chunk *sil = plat_zalloc(sizeof(avisuperindex_chunk));
     if (sil == NULL) {
-        AVI_errno = AVI_ERR_NO_MEM;
+        AVI_SET_ERROR(AVI_ERR_NO_MEM);
         return -1;
     }
     memcpy(sil->fcc, "indx", 4);
@@ -251,13 +467,13 @@ static int avi_init_super_index(avi_t *AVI, const unsigned char *idxtag,
     // NR_IXNN_CHUNKS == allow 32 indices which means 32 GB files -- arbitrary
     sil->aIndex = plat_zalloc(sil->wLongsPerEntry * NR_IXNN_CHUNKS * sizeof(uint32_t));
     if (!sil->aIndex) {
-        AVI_errno = AVI_ERR_NO_MEM;
+        AVI_SET_ERROR(AVI_ERR_NO_MEM);
         return -1;
     }
 
     sil->stdindex = plat_zalloc(NR_IXNN_CHUNKS * sizeof(avistdindex_chunk *));
     if (!sil->stdindex) {
-        AVI_errno = AVI_ERR_NO_MEM;
+        AVI_SET_ERROR(AVI_ERR_NO_MEM);
         return -1;
     }
     for (k = 0; k < NR_IXNN_CHUNKS; k++) {
@@ -293,7 +509,7 @@ static int avi_add_std_index(avi_t *AVI, const unsigned char *idxtag,
     stdil->aIndex = plat_zalloc(stdil->dwSize * sizeof(uint32_t) * stdil->wLongsPerEntry);
 
     if (!stdil->aIndex) {
-        AVI_errno = AVI_ERR_NO_MEM;
+        AVI_SET_ERROR(AVI_ERR_NO_MEM);
         return -1;
     }
     return 0;
@@ -308,10 +524,17 @@ static int avi_add_odml_index_entry_core(avi_t *AVI, long flags, off_t pos,
     si->nEntriesInUse++;
     cur_chunk_idx = si->nEntriesInUse-1;
 
-    // need to fetch more memory
+    // need to fetch more memory, grow by half to keep reallocs rare
     if (cur_chunk_idx >= si->dwSize) {
-        si->dwSize += 4096;
-        si->aIndex = plat_realloc( si->aIndex, si->dwSize * sizeof(uint32_t) * si->wLongsPerEntry);
+        uint32_t size = si->dwSize + ((si->dwSize > 8192) ?si->dwSize/2 :4096);
+        void *ptr = plat_realloc(si->aIndex, size * sizeof(uint32_t) * si->wLongsPerEntry);
+        if (ptr == NULL) {
+            si->nEntriesInUse--;
+            AVI_SET_ERROR(AVI_ERR_NO_MEM);
+            return -1;
+        }
+        si->aIndex = ptr;
+        si->dwSize = size;
     }
 
     if (len>AVI->max_len)
@@ -491,16 +714,18 @@ static int avi_add_odml_index_entry(avi_t *AVI, const unsigned char *tag,
 
 
     if (video) {
-	avi_add_odml_index_entry_core(AVI, flags, AVI->pos, len,
-		AVI->video_superindex->stdindex[ AVI->video_superindex->nEntriesInUse-1 ]);
+	if (avi_add_odml_index_entry_core(AVI, flags, AVI->pos, len,
+		AVI->video_superindex->stdindex[ AVI->video_superindex->nEntriesInUse-1 ]) < 0)
+	    return -1;
 
 	AVI->total_frames++;
     } // video
 
     if (audio) {
-	avi_add_odml_index_entry_core(AVI, flags, AVI->pos, len,
+	if (avi_add_odml_index_entry_core(AVI, flags, AVI->pos, len,
 		AVI->track[AVI->aptr].audio_superindex->stdindex[
-		        AVI->track[AVI->aptr].audio_superindex->nEntriesInUse-1 ]);
+		        AVI->track[AVI->aptr].audio_superindex->nEntriesInUse-1 ]) < 0)
+	    return -1;
     }
 
 
@@ -515,13 +740,16 @@ static int avi_add_index_entry(avi_t *AVI, const unsigned char *tag, long flags,
    void *ptr;
 
    if(AVI->n_idx>=AVI->max_idx) {
-     ptr = plat_realloc((void *)AVI->idx,(AVI->max_idx+4096)*16);
+     /* grow by half, see also AVI_reserve_index */
+     long max_idx = AVI->max_idx + ((AVI->max_idx > 8192) ?AVI->max_idx/2 :4096);
+
+     ptr = plat_realloc((void *)AVI->idx,max_idx*16);
 
      if(ptr == 0) {
-       AVI_errno = AVI_ERR_NO_MEM;
+       AVI_SET_ERROR(AVI_ERR_NO_MEM);
        return -1;
      }
-     AVI->max_idx += 4096;
+     AVI->max_idx = max_idx;
      AVI->idx = (unsigned char((*)[16]) ) ptr;
    }
 
@@ -928,7 +1156,7 @@ int avi_update_header(avi_t *AVI)
         plat_write(AVI->fdes,(char *)AVI_header,HEADERBYTES)!=HEADERBYTES ||
 	plat_seek(AVI->fdes,AVI->pos,SEEK_SET)<0)
      {
-       AVI_errno = AVI_ERR_CLOSE;
+       AVI_SET_ERROR(AVI_ERR_CLOSE);
        return -1;
      }
 
@@ -1111,6 +1339,11 @@ static int avi_close_output_file(avi_t *AVI)
 //   time_t calptr;
 #endif
 
+   /* Chunks still to be copied */
+   idxerror = 0;
+   if (avi_copy_flush(AVI) < 0 || AVI->copy_failed)
+      idxerror = 1;
+
    /* Calculate length of movi list */
 
    // dump the rest of the index
@@ -1158,7 +1391,6 @@ static int avi_close_output_file(avi_t *AVI)
       try to write the header correctly (so that the file still may be
       readable in the most cases */
 
-   idxerror = 0;
    hasIndex = 1;
    if (!AVI->is_opendml) {
        //   fprintf(stderr, "pos=%lu, index_len=%ld             \n", AVI->pos, AVI->n_idx*16);
@@ -1168,7 +1400,7 @@ static int avi_close_output_file(avi_t *AVI)
 
        if(ret) {
 	   idxerror = 1;
-	   AVI_errno = AVI_ERR_WRITE_INDEX;
+	   AVI_SET_ERROR(AVI_ERR_WRITE_INDEX);
        }
    }
 
@@ -1605,11 +1837,12 @@ static int avi_close_output_file(avi_t *AVI)
    /* Output the header, truncate the file to the number of bytes
       actually written, report an error if someting goes wrong */
 
-   if ( plat_seek(AVI->fdes,0,SEEK_SET)<0 ||
+   if ( avi_writer_flush(AVI)<0 ||
+        plat_seek(AVI->fdes,0,SEEK_SET)<0 ||
         plat_write(AVI->fdes,(char *)AVI_header,HEADERBYTES)!=HEADERBYTES ||
         plat_ftruncate(AVI->fdes,AVI->pos)<0 )
    {
-      AVI_errno = AVI_ERR_CLOSE;
+      AVI_SET_ERROR(AVI_ERR_CLOSE);
       return -1;
    }
 
@@ -1642,6 +1875,18 @@ static int avi_close_output_file(avi_t *AVI)
    return 0;
 }
 
+/* add the index entries for a chunk going to AVI->pos */
+static int avi_add_chunk_index(avi_t *AVI, const unsigned char *tag,
+                               long flags, unsigned long length)
+{
+   int n = 0;
+
+   if (!AVI->is_opendml) n = avi_add_index_entry(AVI,tag,flags,AVI->pos,length);
+   n += avi_add_odml_index_entry(AVI,tag,flags,AVI->pos,length);
+
+   return (n) ?-1 :0;
+}
+
 /*
    AVI_write_data:
    Add video or audio data to the file;
@@ -1667,7 +1912,7 @@ static int plat_write_data(avi_t *AVI, const char *data, unsigned long length,
    /* Check for maximum file length */
 
    if ( (AVI->pos + 8 + length + 8 + (AVI->n_idx+1)*16) > AVI_MAX_LEN ) {
-     AVI_errno = AVI_ERR_SIZELIM;
+     AVI_SET_ERROR(AVI_ERR_SIZELIM);
      return -1;
    }
 #endif
@@ -1677,13 +1922,10 @@ static int plat_write_data(avi_t *AVI, const char *data, unsigned long length,
    //set tag for current audio track
    snprintf((char *)astr, sizeof(astr), "0%1dwb", (int)(AVI->aptr+1));
 
-   if(audio) {
-     if (!AVI->is_opendml) n = avi_add_index_entry(AVI,astr,0x10,AVI->pos,length);
-     n += avi_add_odml_index_entry(AVI,astr,0x10,AVI->pos,length);
-   } else {
-     if (!AVI->is_opendml) n = avi_add_index_entry(AVI,(unsigned char *)"00db",((keyframe)?0x10:0x0),AVI->pos,length);
-     n += avi_add_odml_index_entry(AVI,(unsigned char *)"00db",((keyframe)?0x10:0x0),AVI->pos,length);
-   }
+   if(audio)
+     n = avi_add_chunk_index(AVI,astr,0x10,length);
+   else
+     n = avi_add_chunk_index(AVI,(unsigned char *)"00db",((keyframe)?0x10:0x0),length);
 
    if(n) return -1;
 
@@ -1703,7 +1945,7 @@ int AVI_write_frame(avi_t *AVI, const char *data, long bytes, int keyframe)
 {
   off_t pos;
 
-  if(AVI->mode==AVI_MODE_READ) { AVI_errno = AVI_ERR_NOT_PERM; return -1; }
+  if(AVI->mode==AVI_MODE_READ) { AVI_SET_ERROR(AVI_ERR_NOT_PERM); return -1; }
 
   pos = AVI->pos;
 
@@ -1717,7 +1959,7 @@ int AVI_write_frame(avi_t *AVI, const char *data, long bytes, int keyframe)
 
 int AVI_write_audio(avi_t *AVI, const char *data, long bytes)
 {
-   if(AVI->mode==AVI_MODE_READ) { AVI_errno = AVI_ERR_NOT_PERM; return -1; }
+   if(AVI->mode==AVI_MODE_READ) { AVI_SET_ERROR(AVI_ERR_NOT_PERM); return -1; }
 
    if( plat_write_data(AVI,data,bytes,1,0) ) return -1;
    AVI->track[AVI->aptr].audio_bytes += bytes;
@@ -1725,6 +1967,108 @@ int AVI_write_audio(avi_t *AVI, const char *data, long bytes)
    return 0;
 }
 
+/*
+ * AVI_enable_write_behind: from now on, let a thread write the data out
+ * of `buffers' buffers of `bufsize' bytes (0 for the defaults), so the
+ * caller doesn't wait for the disk. AVI_write_frame and AVI_write_audio
+ * only block when all buffers are full; write errors are reported by a
+ * later write or by AVI_close. Returns 0 on success, -1 on error.
+ */
+int AVI_enable_write_behind(avi_t *AVI, long bufsize, int buffers)
+{
+   avi_writer_t *wr = NULL;
+   int i;
+
+   if(AVI->mode==AVI_MODE_READ) { AVI_SET_ERROR(AVI_ERR_NOT_PERM); return -1; }
+
+   if (AVI->writer != NULL)
+      return 0;
+   if (bufsize <= 0)
+      bufsize = WRITER_BUFSIZE;
+   if (buffers < 2)
+      buffers = WRITER_BUFFERS;
+
+   wr = plat_zalloc(sizeof(avi_writer_t));
+   if (wr != NULL)
+      wr->bufs = plat_zalloc(buffers * sizeof(avi_wbuf_t));
+   if (wr == NULL || wr->bufs == NULL) {
+      plat_free(wr);
+      AVI_SET_ERROR(AVI_ERR_NO_MEM);
+      return -1;
+   }
+   wr->nbufs   = buffers;
+   wr->bufsize = bufsize;
+   for (i = 0; i < buffers; i++) {
+      wr->bufs[i].data = plat_malloc(bufsize);
+      if (wr->bufs[i].data == NULL) {
+         while (i-- > 0)
+            plat_free(wr->bufs[i].data);
+         plat_free(wr->bufs);
+         plat_free(wr);
+         AVI_SET_ERROR(AVI_ERR_NO_MEM);
+         return -1;
+      }
+   }
+   wr->running = 1;
+   pthread_mutex_init(&wr->lock, NULL);
+   pthread_cond_init(&wr->cond, NULL);
+
+   AVI->writer = wr;
+   if (pthread_create(&wr->thread, NULL, avi_writer_thread, AVI) != 0) {
+      AVI->writer = NULL;
+      pthread_cond_destroy(&wr->cond);
+      pthread_mutex_destroy(&wr->lock);
+      for (i = 0; i < buffers; i++)
+         plat_free(wr->bufs[i].data);
+      plat_free(wr->bufs);
+      plat_free(wr);
+      AVI_SET_ERROR(AVI_ERR_NO_MEM);
+      return -1;
+   }
+   return 0;
+}
+
+/*
+ * AVI_write_backlog: bytes accepted but not yet written to disk. A caller
+ * seeing this grow can slow down before the writes start to block.
+ */
+long AVI_write_backlog(avi_t *AVI)
+{
+   avi_writer_t *wr = AVI->writer;
+   long n;
+
+   if (wr == NULL)
+      return 0;
+   pthread_mutex_lock(&wr->lock);
+   n = wr->backlog + wr->bufs[(wr->head + wr->queued) % wr->nbufs].len;
+   pthread_mutex_unlock(&wr->lock);
+   return n;
+}
+
+/*
+ * AVI_reserve_index: make room in the index for `frames' video frames
+ * (and one audio chunk per frame and track), so writing them never has
+ * to grow it.
+ */
+int AVI_reserve_index(avi_t *AVI, long frames)
+{
+   long entries = frames * (1 + AVI->anum);
+   void *ptr = NULL;
+
+   if(AVI->mode==AVI_MODE_READ) { AVI_SET_ERROR(AVI_ERR_NOT_PERM); return -1; }
+
+   if (entries <= AVI->max_idx)
+      return 0;
+   ptr = plat_realloc((void *)AVI->idx, entries*16);
+   if (ptr == NULL) {
+      AVI_SET_ERROR(AVI_ERR_NO_MEM);
+      return -1;
+   }
+   AVI->idx = (unsigned char((*)[16]) ) ptr;
+   AVI->max_idx = entries;
+   return 0;
+}
+
 
 long AVI_bytes_remain(avi_t *AVI)
 {
@@ -1781,6 +2125,120 @@ int  AVI_get_comment_fd(avi_t *AVI)
  *                                                                 *
  *******************************************************************/
 
+static void avi_mmap_release(avi_mmap_t *map)
+{
+    if (map->base != NULL) {
+        plat_munmap(map->base, map->len);
+        map->base  = NULL;
+        map->start = 0;
+        map->len   = 0;
+    }
+}
+
+/*
+ * return a pointer to `len' bytes of file data at offset `pos', moving
+ * the mapped window `map' if needed, or NULL if the data can't be mapped
+ * (caller must read it instead). 64bit hosts map the whole file once,
+ * the others slide a MMAP_WINDOW sized window over it.
+ * Video and audio have their own window, so a video reader and an audio
+ * reader never move each other's mapping.
+ */
+static const uint8_t *avi_mmap_data(avi_t *AVI, avi_mmap_t *map,
+                                    off_t pos, long len)
+{
+    off_t start = 0, want = AVI->file_size;
+
+    if (map->failed || pos < 0 || len < 0 || pos + len > AVI->file_size)
+        return NULL;
+
+    if (map->base != NULL
+     && pos >= map->start
+     && pos + len <= map->start + (off_t)map->len
+    ) {
+        return map->base + (pos - map->start);
+    }
+
+    avi_mmap_release(map);
+
+    if (sizeof(void *) < 8) {
+        start = pos - pos % (off_t)plat_page_size();
+        want  = MMAP_WINDOW;
+        if (want < pos + len - start)
+            want = pos + len - start;
+        if (start + want > AVI->file_size)
+            want = AVI->file_size - start;
+    }
+
+    map->base = plat_mmap(AVI->fdes, start, (size_t)want);
+    if (map->base == NULL) {
+        /* don't retry on every frame, plain reads from now on */
+        map->failed = 1;
+        return NULL;
+    }
+    map->start = start;
+    map->len   = (size_t)want;
+
+    return map->base + (pos - start);
+}
+
+/*
+ * hint the kernel about the video frames following `frame' (and so about
+ * the audio interleaved with them). The hint is renewed every
+ * MMAP_READAHEAD frames and restarted when the access pattern jumps
+ * out of the hinted range. Never moves the mapped window.
+ */
+static void avi_mmap_readahead(avi_t *AVI, long frame)
+{
+    avi_mmap_t *map = &AVI->video_map;
+    long mid  = frame + MMAP_READAHEAD;
+    long last = frame + 2 * MMAP_READAHEAD;
+    off_t from, to, win_end;
+
+    if (map->base == NULL || frame < 0 || frame >= AVI->video_frames)
+        return;
+    if (mid >= AVI->video_frames)
+        mid = AVI->video_frames - 1;
+    if (last >= AVI->video_frames)
+        last = AVI->video_frames - 1;
+
+    from = AVI->video_index[frame].pos;
+    if (from < AVI->ra_start || from > AVI->ra_end) {
+        AVI->ra_start = from;
+        AVI->ra_end   = from;
+    }
+    if (AVI->video_index[mid].pos + AVI->video_index[mid].len <= AVI->ra_end)
+        return; /* still enough hinted ahead */
+
+    from    = AVI->ra_end;
+    to      = AVI->video_index[last].pos + AVI->video_index[last].len;
+    win_end = map->start + (off_t)map->len;
+    if (from < map->start || from >= win_end)
+        return;
+    if (to > win_end)
+        to = win_end;
+
+    plat_prefetch(map->base + (from - map->start), (size_t)(to - from));
+    AVI->ra_end = to;
+}
+
+/*
+ * read `len' bytes at file offset `pos' into `buf', straight out of the
+ * mapping `map' if there is one, with a positional read otherwise; the
+ * shared file offset is never used. Returns the number of bytes read.
+ */
+static long avi_read_at(avi_t *AVI, avi_mmap_t *map,
+                        off_t pos, char *buf, long len)
+{
+    if (AVI->use_mmap) {
+        const uint8_t *data = avi_mmap_data(AVI, map, pos, len);
+        if (data != NULL) {
+            memcpy(buf, data, len);
+            return len;
+        }
+    }
+    return plat_pread(AVI->fdes, buf, len, pos);
+}
+
 int AVI_close(avi_t *AVI)
 {
     int j, k, ret = 0;
@@ -1790,6 +2248,10 @@ int AVI_close(avi_t *AVI)
 
     if (AVI->mode == AVI_MODE_WRITE) {
         ret = avi_close_output_file(AVI);
+        if (avi_writer_stop(AVI) < 0 && ret == 0) {
+            AVI_SET_ERROR(AVI_ERR_CLOSE);
+            ret = -1;
+        }
     }
 
     /* Even if there happened an error, we first clean up */
@@ -1798,6 +2260,16 @@ int AVI_close(avi_t *AVI)
         plat_close(AVI->comment_fd);
     AVI->comment_fd = -1;
 
+    /* an output may still want to copy from here */
+    if (AVI->copy_dest != NULL)
+        avi_copy_flush(AVI->copy_dest);
+
+    AVI_disable_prefetch(AVI);
+    avi_mmap_release(&AVI->video_map);
+    avi_mmap_release(&AVI->audio_map);
+    if (AVI->peek_buf)
+        plat_free(AVI->peek_buf);
+
     plat_close(AVI->fdes);
 
     if (AVI->idx)
@@ -1909,6 +2381,305 @@ avi_t *AVI_open_fd(int fd, int getIndex)
    return AVI_open_indexfd(fd, getIndex, NULL);
 }
 
+/*
+ * switch an input handle to memory mapped reads. Returns -1 if the file
+ * can't be mapped; the handle keeps working through plain reads anyway.
+ */
+int AVI_enable_mmap(avi_t *AVI)
+{
+   off_t cur;
+
+   if(AVI->mode==AVI_MODE_WRITE) { AVI_SET_ERROR(AVI_ERR_NOT_PERM); return -1; }
+
+   cur = plat_seek(AVI->fdes, 0, SEEK_CUR);
+   AVI->file_size = plat_seek(AVI->fdes, 0, SEEK_END);
+   plat_seek(AVI->fdes, cur, SEEK_SET);
+
+   if (AVI->file_size <= 0) return -1;
+
+   AVI->use_mmap = 1;
+   AVI->ra_start = AVI->ra_end = 0;
+   if (avi_mmap_data(AVI, &AVI->video_map, AVI->movi_start, 0) == NULL) return -1;
+   return 0;
+}
+
+avi_t *AVI_open_input_file_mmap(const char *filename, int getIndex)
+{
+   avi_t *AVI = AVI_open_input_file(filename, getIndex);
+
+   if (AVI != NULL) AVI_enable_mmap(AVI);
+   return AVI;
+}
+
+/*
+ * Binary index cache. Much smaller than an aviindex text file and read
+ * with a single read, so reopening a big file costs next to nothing.
+ * All numbers are little endian:
+ *
+ *   "AVIIDXB\n"      magic (AVI_INDEX_CACHE_MAGIC)
+ *   8                size of the AVI file the index belongs to
+ *   4                video entries
+ *   4                audio tracks, then 4 entries for each of them
+ *   8                position of the first chunk, for video and each track
+ *   8 per entry      4 distance to the previous chunk of the stream,
+ *                    4 length; for video bit 31 is set for non keyframes,
+ *                    as in the OpenDML standard index
+ *
+ * Video first, then the audio tracks in order.
+ */
+
+#define AVI_INDEX_CACHE_MAGIC   "AVIIDXB\n"
+
+static void avi_put_ullong(unsigned char *dst, uint64_t n)
+{
+   long2str(dst,   (int32_t)(n & 0xffffffffULL));
+   long2str(dst+4, (int32_t)(n >> 32));
+}
+
+static off_t avi_file_size(avi_t *AVI)
+{
+   off_t cur  = plat_seek(AVI->fdes, 0, SEEK_CUR);
+   off_t size = plat_seek(AVI->fdes, 0, SEEK_END);
+
+   plat_seek(AVI->fdes, cur, SEEK_SET);
+   return size;
+}
+
+/* position delta to the previous chunk, -1 if it doesn't fit in 32bit */
+static int64_t avi_index_delta(off_t pos, off_t prev)
+{
+   if (pos < prev || pos - prev > (off_t)0xffffffffULL)
+      return -1;
+   return pos - prev;
+}
+
+/*
+ * AVI_write_index_cache: store the index of `AVI' in `filename', to be
+ * given to AVI_open_input_indexfile (or AVI_open_input_file_cached)
+ * later. Returns 0 on success, -1 on error.
+ */
+int AVI_write_index_cache(avi_t *AVI, const char *filename)
+{
+   unsigned char *buf = NULL, *p = NULL;
+   long i, size;
+   off_t prev;
+   int j, fd, ret = 0;
+
+   if(AVI->mode==AVI_MODE_WRITE) { AVI_SET_ERROR(AVI_ERR_NOT_PERM); return -1; }
+   if(!AVI->video_index)         { AVI_SET_ERROR(AVI_ERR_NO_IDX);   return -1; }
+
+   size = 8 + 8 + 4 + 4 + 8 + 8 * AVI->video_frames;
+   for (j = 0; j < AVI->anum; j++)
+      size += 4 + 8 + 8 * AVI->track[j].audio_chunks;
+
+   buf = plat_malloc(size);
+   if (buf == NULL) { AVI_SET_ERROR(AVI_ERR_NO_MEM); return -1; }
+
+   p = buf;
+   memcpy(p, AVI_INDEX_CACHE_MAGIC, 8);                 p += 8;
+   avi_put_ullong(p, avi_file_size(AVI));               p += 8;
+   long2str(p, AVI->video_frames);                      p += 4;
+   long2str(p, AVI->anum);                              p += 4;
+   for (j = 0; j < AVI->anum; j++) {
+      long2str(p, AVI->track[j].audio_chunks);          p += 4;
+   }
+   avi_put_ullong(p, (AVI->video_frames > 0) ?AVI->video_index[0].pos :0);
+   p += 8;
+   for (j = 0; j < AVI->anum; j++) {
+      avi_put_ullong(p, (AVI->track[j].audio_chunks > 0)
+                          ?AVI->track[j].audio_index[0].pos :0);
+      p += 8;
+   }
+
+   prev = (AVI->video_frames > 0) ?AVI->video_index[0].pos :0;
+   for (i = 0; i < AVI->video_frames && ret == 0; i++) {
+      const video_index_entry *e = &AVI->video_index[i];
+      int64_t delta = avi_index_delta(e->pos, prev);
+      if (delta < 0 || e->len > 0x7fffffff) {
+         ret = -1;
+         break;
+      }
+      long2str(p,   (int32_t)delta);
+      long2str(p+4, (int32_t)(e->len | ((e->key == 0x10) ?0 :0x80000000)));
+      p += 8;
+      prev = e->pos;
+   }
+   for (j = 0; j < AVI->anum && ret == 0; j++) {
+      const audio_index_entry *e = AVI->track[j].audio_index;
+      prev = (AVI->track[j].audio_chunks > 0) ?e[0].pos :0;
+      for (i = 0; i < AVI->track[j].audio_chunks; i++) {
+         int64_t delta = avi_index_delta(e[i].pos, prev);
+         if (delta < 0 || e[i].len > 0x7fffffff) {
+            ret = -1;
+            break;
+         }
+         long2str(p,   (int32_t)delta);
+         long2str(p+4, (int32_t)e[i].len);
+         p += 8;
+         prev = e[i].pos;
+      }
+   }
+   if (ret < 0) {
+      plat_log_send(PLAT_LOG_WARNING, __FILE__,
+                    "%s: chunks out of order, index can't be cached", filename);
+      plat_free(buf);
+      AVI_SET_ERROR(AVI_ERR_WRITE_INDEX);
+      return -1;
+   }
+
+   fd = plat_open(filename, O_WRONLY|O_CREAT|O_TRUNC, 0644);
+   if (fd < 0) {
+      plat_free(buf);
+      AVI_SET_ERROR(AVI_ERR_WRITE_INDEX);
+      return -1;
+   }
+   if (plat_write(fd, buf, size) != size) {
+      AVI_SET_ERROR(AVI_ERR_WRITE_INDEX);
+      ret = -1;
+   }
+   if (plat_close(fd) != 0 && ret == 0) {
+      AVI_SET_ERROR(AVI_ERR_WRITE_INDEX);
+      ret = -1;
+   }
+   if (ret < 0)
+      unlink(filename);
+   plat_free(buf);
+   return ret;
+}
+
+/*
+ * read a cache written by AVI_write_index_cache, `fd' is positioned right
+ * after the magic. Refuses caches not matching the file. On error no
+ * index is left behind.
+ */
+static int avi_read_index_cache(avi_t *AVI, FILE *fd, const char *filename)
+{
+   unsigned char hdr[8 + 4 + 4 + (4 + 8) * AVI_MAX_TRACKS + 8];
+   unsigned char *buf = NULL, *p = NULL;
+   long i, nvi, nai[AVI_MAX_TRACKS];
+   int64_t entries, avail;
+   struct stat st;
+   off_t pos;
+   int j, err = AVI_ERR_NO_IDX;
+
+   if (fread(hdr, 8 + 4 + 4, 1, fd) != 1)
+      goto broken;
+   if ((off_t)str2ullong(hdr) != avi_file_size(AVI)) {
+      plat_log_send(PLAT_LOG_INFO, __FILE__,
+                    "%s: index cache doesn't match the file", filename);
+      AVI_SET_ERROR(AVI_ERR_NO_IDX);
+      return -1;
+   }
+   nvi = str2ulong(hdr + 8);
+   if (nvi == 0 || str2ulong(hdr + 12) != (uint32_t)AVI->anum)
+      goto broken;
+   if (fread(hdr, (4 + 8) * AVI->anum + 8, 1, fd) != 1)
+      goto broken;
+
+   /* every entry takes 8 bytes: the counts must fit into what is left
+    * of the cache file, or it's damaged and we'd allocate garbage */
+   avail = ftell(fd);
+   if (avail < 0 || fstat(fileno(fd), &st) != 0)
+      goto broken;
+   avail = ((int64_t)st.st_size - avail) / 8;
+   entries = nvi;
+   for (j = 0; j < AVI->anum; j++) {
+      nai[j] = str2ulong(hdr + 4 * j);
+      entries += nai[j];
+   }
+   if (entries > avail)
+      goto broken;
+
+   buf = plat_malloc(8 * entries);
+   AVI->video_index = plat_malloc(nvi * sizeof(video_index_entry));
+   if (buf == NULL || AVI->video_index == NULL) {
+      err = AVI_ERR_NO_MEM;
+      goto failed;
+   }
+   if (fread(buf, 8, entries, fd) != (size_t)entries)
+      goto broken;
+
+   p   = buf;
+   pos = (off_t)str2ullong(hdr + 4 * AVI->anum);
+   for (i = 0; i < nvi; i++) {
+      uint32_t len = str2ulong(p + 4);
+      pos += str2ulong(p);
+      AVI->video_index[i].pos = pos;
+      AVI->video_index[i].len = len & 0x7fffffff;
+      AVI->video_index[i].key = (len & 0x80000000) ?0 :0x10;
+      p += 8;
+   }
+   AVI->video_frames = nvi;
+
+   for (j = 0; j < AVI->anum; j++) {
+      track_t *track = &AVI->track[j];
+      off_t tot = 0;
+
+      track->audio_chunks = nai[j];
+      if (nai[j] == 0)
+         continue;
+      track->audio_index = plat_malloc(nai[j] * sizeof(audio_index_entry));
+      if (track->audio_index == NULL) {
+         err = AVI_ERR_NO_MEM;
+         goto failed;
+      }
+      pos = (off_t)str2ullong(hdr + 4 * AVI->anum + 8 * (j + 1));
+      for (i = 0; i < nai[j]; i++) {
+         pos += str2ulong(p);
+         track->audio_index[i].pos = pos;
+         track->audio_index[i].len = str2ulong(p + 4);
+         track->audio_index[i].tot = tot;
+         tot += track->audio_index[i].len;
+         p += 8;
+      }
+      track->audio_bytes = tot;
+   }
+
+   plat_free(buf);
+   return 0;
+
+broken:
+   plat_log_send(PLAT_LOG_WARNING, __FILE__, "%s: broken index cache", filename);
+failed:
+   /* don't leave a half built index behind */
+   plat_free(buf);
+   plat_free(AVI->video_index);
+   AVI->video_index  = NULL;
+   AVI->video_frames = 0;
+   for (j = 0; j < AVI->anum; j++) {
+      plat_free(AVI->track[j].audio_index);
+      AVI->track[j].audio_index  = NULL;
+      AVI->track[j].audio_chunks = 0;
+      AVI->track[j].audio_bytes  = 0;
+   }
+   AVI_SET_ERROR(err);
+   return -1;
+}
+
+/*
+ * AVI_open_input_file_cached: open `filename' using the index cache
+ * `cachefile' if it is there and up to date; otherwise read the index
+ * from the file as usual and (re)write the cache for the next time.
+ */
+avi_t *AVI_open_input_file_cached(const char *filename, const char *cachefile)
+{
+   avi_t *AVI = NULL;
+
+   if (access(cachefile, R_OK) == 0) {
+      AVI = AVI_open_input_indexfile(filename, 0, cachefile);
+      if (AVI != NULL)
+         return AVI;
+   }
+
+   AVI = AVI_open_input_file(filename, 1);
+   if (AVI != NULL && AVI_write_index_cache(AVI, cachefile) < 0) {
+      plat_log_send(PLAT_LOG_WARNING, __FILE__,
+                    "can't write index cache %s: %s",
+                    cachefile, AVI_error_string(AVI_get_error(AVI)));
+   }
+   return AVI;
+}
+
 // transcode-0.6.8
 // reads a file generated by aviindex and builds the index out of it.
 
@@ -1940,13 +2711,25 @@ int avi_parse_index_from_file(avi_t *AVI, const char *filename)
 	AVI->track[j].audio_chunks = 0;
     }
 
-    if (!(fd = fopen(filename, "r"))) { perror ("avi_parse_index_from_file: fopen"); return -1; }
+    if (!(fd = fopen(filename, "r"))) {
+	perror ("avi_parse_index_from_file: fopen");
+	AVI_errno = AVI_ERR_NO_IDX;
+	return -1;
+    }
 
     // read header
     fgets(data, 100, fd);
 
+    if (strncmp(data, AVI_INDEX_CACHE_MAGIC, 8) == 0) {
+	int ret = avi_read_index_cache(AVI, fd, filename);
+	fclose(fd);
+	return ret;
+    }
+
     if ( strncasecmp(data, "AVIIDX1", 7) != 0) {
     plat_log_send(PLAT_LOG_ERROR, __FILE__, "%s: Not an AVI index file", filename);
+	fclose(fd);
+	AVI_errno = AVI_ERR_NO_IDX;
 	return -1;
     }
 
@@ -1969,14 +2752,15 @@ int avi_parse_index_from_file(avi_t *AVI, const char *filename)
     AVI->video_frames = vid_chunks;
     for(j=0; j<AVI->anum; ++j) AVI->track[j].audio_chunks = aud_chunks[j];
 
-    if(AVI->video_frames==0) ERR_EXIT(AVI_ERR_NO_VIDS);
+    /* the caller cleans up, AVI must stay valid */
+    if(AVI->video_frames==0) { fclose(fd); AVI_errno = AVI_ERR_NO_VIDS; return -1; }
     AVI->video_index = plat_malloc(vid_chunks*sizeof(video_index_entry));
-    if(AVI->video_index==0) ERR_EXIT(AVI_ERR_NO_MEM);
+    if(AVI->video_index==0) { fclose(fd); AVI_errno = AVI_ERR_NO_MEM; return -1; }
 
     for(j=0; j<AVI->anum; ++j) {
 	if(AVI->track[j].audio_chunks) {
 	    AVI->track[j].audio_index = plat_malloc(aud_chunks[j]*sizeof(audio_index_entry));
-	    if(AVI->track[j].audio_index==0) ERR_EXIT(AVI_ERR_NO_MEM);
+	    if(AVI->track[j].audio_index==0) { fclose(fd); AVI_errno = AVI_ERR_NO_MEM; return -1; }
 	}
     }
 
@@ -2424,6 +3208,7 @@ static int avi_parse_input_file(avi_t *AVI, int getIndex)
        int ret;
 
        ret = avi_parse_index_from_file(AVI, AVI->index_file);
+       if (ret < 0) ERR_EXIT((AVI_errno) ?AVI_errno :AVI_ERR_NO_IDX);
 
        /* Reposition the file */
 
@@ -2723,7 +3508,7 @@ multiple_riff:
 	     AVI->track[j].audio_index = plat_realloc( AVI->track[j].audio_index, (aud_chunks+1)*sizeof(audio_index_entry));
 	     if (!AVI->track[j].audio_index) {
          plat_log_send(PLAT_LOG_ERROR, __FILE__, "Internal error -- no mem");
-		 AVI_errno = AVI_ERR_NO_MEM;
+		 AVI_SET_ERROR(AVI_ERR_NO_MEM);
 		 return -1;
 	     }
 	 }
@@ -2953,8 +3738,8 @@ long  AVI_video_codecf_offset(avi_t *AVI)
 
 long AVI_frame_size(avi_t *AVI, long frame)
 {
-   if(AVI->mode==AVI_MODE_WRITE) { AVI_errno = AVI_ERR_NOT_PERM; return -1; }
-   if(!AVI->video_index)         { AVI_errno = AVI_ERR_NO_IDX;   return -1; }
+   if(AVI->mode==AVI_MODE_WRITE) { AVI_SET_ERROR(AVI_ERR_NOT_PERM); return -1; }
+   if(!AVI->video_index)         { AVI_SET_ERROR(AVI_ERR_NO_IDX);   return -1; }
 
    if(frame < 0 || frame >= AVI->video_frames) return 0;
    return(AVI->video_index[frame].len);
@@ -2962,8 +3747,8 @@ long AVI_frame_size(avi_t *AVI, long frame)
 
 long AVI_audio_size(avi_t *AVI, long frame)
 {
-  if(AVI->mode==AVI_MODE_WRITE) { AVI_errno = AVI_ERR_NOT_PERM; return -1; }
-  if(!AVI->track[AVI->aptr].audio_index)         { AVI_errno = AVI_ERR_NO_IDX;   return -1; }
+  if(AVI->mode==AVI_MODE_WRITE) { AVI_SET_ERROR(AVI_ERR_NOT_PERM); return -1; }
+  if(!AVI->track[AVI->aptr].audio_index)         { AVI_SET_ERROR(AVI_ERR_NO_IDX);   return -1; }
 
   if(frame < 0 || frame >= AVI->track[AVI->aptr].audio_chunks) return -1;
   return(AVI->track[AVI->aptr].audio_index[frame].len);
@@ -2971,8 +3756,8 @@ long AVI_audio_size(avi_t *AVI, long frame)
 
 long AVI_get_video_position(avi_t *AVI, long frame)
 {
-   if(AVI->mode==AVI_MODE_WRITE) { AVI_errno = AVI_ERR_NOT_PERM; return -1; }
-   if(!AVI->video_index)         { AVI_errno = AVI_ERR_NO_IDX;   return -1; }
+   if(AVI->mode==AVI_MODE_WRITE) { AVI_SET_ERROR(AVI_ERR_NOT_PERM); return -1; }
+   if(!AVI->video_index)         { AVI_SET_ERROR(AVI_ERR_NO_IDX);   return -1; }
 
    if(frame < 0 || frame >= AVI->video_frames) return 0;
    return(AVI->video_index[frame].pos);
@@ -2981,64 +3766,88 @@ long AVI_get_video_position(avi_t *AVI, long frame)
 
 int AVI_seek_start(avi_t *AVI)
 {
-   if(AVI->mode==AVI_MODE_WRITE) { AVI_errno = AVI_ERR_NOT_PERM; return -1; }
+   if(AVI->mode==AVI_MODE_WRITE) { AVI_SET_ERROR(AVI_ERR_NOT_PERM); return -1; }
 
    plat_seek(AVI->fdes,AVI->movi_start,SEEK_SET);
    AVI->video_pos = 0;
+   if (AVI->prefetch != NULL) avi_prefetch_seek(AVI->prefetch, 0);
    return 0;
 }
 
 int AVI_set_video_position(avi_t *AVI, long frame)
 {
-   if(AVI->mode==AVI_MODE_WRITE) { AVI_errno = AVI_ERR_NOT_PERM; return -1; }
-   if(!AVI->video_index)         { AVI_errno = AVI_ERR_NO_IDX;   return -1; }
+   if(AVI->mode==AVI_MODE_WRITE) { AVI_SET_ERROR(AVI_ERR_NOT_PERM); return -1; }
+   if(!AVI->video_index)         { AVI_SET_ERROR(AVI_ERR_NO_IDX);   return -1; }
 
    if (frame < 0 ) frame = 0;
    AVI->video_pos = frame;
+   if (AVI->prefetch != NULL) avi_prefetch_seek(AVI->prefetch, frame);
    return 0;
 }
 
 int AVI_set_audio_bitrate(avi_t *AVI, long bitrate)
 {
-   if(AVI->mode==AVI_MODE_READ) { AVI_errno = AVI_ERR_NOT_PERM; return -1; }
+   if(AVI->mode==AVI_MODE_READ) { AVI_SET_ERROR(AVI_ERR_NOT_PERM); return -1; }
 
    AVI->track[AVI->aptr].mp3rate = bitrate;
    return 0;
 }
 
 
-long AVI_read_video(avi_t *AVI, char *vidbuf, long bytes, int *keyframe)
+/*
+ * make the per-handle scratch buffer at least `n' bytes large. It backs
+ * AVI_peek_frame and AVI_read_frames when the file is not mapped.
+ */
+static char *avi_scratch(avi_t *AVI, long n)
+{
+   if (AVI->peek_buf == NULL || AVI->peek_size < n) {
+      char *buf = plat_realloc(AVI->peek_buf, (n > 0) ?n :1);
+      if (buf == NULL) { AVI_SET_ERROR(AVI_ERR_NO_MEM); return NULL; }
+      AVI->peek_buf  = buf;
+      AVI->peek_size = n;
+   }
+   return AVI->peek_buf;
+}
+
+/*
+ * AVI_read_video_at: like AVI_read_video, but reads frame `frame' and
+ * neither uses nor changes the current video position.
+ */
+long AVI_read_video_at(avi_t *AVI, long frame, char *vidbuf, long bytes,
+                       int *keyframe)
 {
    long n;
 
-   if(AVI->mode==AVI_MODE_WRITE) { AVI_errno = AVI_ERR_NOT_PERM; return -1; }
-   if(!AVI->video_index)         { AVI_errno = AVI_ERR_NO_IDX;   return -1; }
+   if(AVI->mode==AVI_MODE_WRITE) { AVI_SET_ERROR(AVI_ERR_NOT_PERM); return -1; }
+   if(!AVI->video_index)         { AVI_SET_ERROR(AVI_ERR_NO_IDX);   return -1; }
 
-   if(AVI->video_pos < 0 || AVI->video_pos >= AVI->video_frames) return -1;
-   n = AVI->video_index[AVI->video_pos].len;
+   if(frame < 0 || frame >= AVI->video_frames) return -1;
+   n = AVI->video_index[frame].len;
 
    if (bytes != -1 && bytes < n) {
-     AVI_errno = AVI_ERR_NO_BUFSIZE;
+     AVI_SET_ERROR(AVI_ERR_NO_BUFSIZE);
      return -1;
    }
 
-   *keyframe = (AVI->video_index[AVI->video_pos].key==0x10) ? 1:0;
+   *keyframe = (AVI->video_index[frame].key==0x10) ? 1:0;
 
-   if (vidbuf == NULL) {
-     AVI->video_pos++;
-     return n;
-   }
-
-   plat_seek(AVI->fdes, AVI->video_index[AVI->video_pos].pos, SEEK_SET);
+   if (vidbuf == NULL) return n;
 
-   if (plat_read(AVI->fdes,vidbuf,n) != n)
+   if (avi_read_at(AVI, &AVI->video_map, AVI->video_index[frame].pos, vidbuf, n) != n)
    {
-      AVI_errno = AVI_ERR_READ;
+      AVI_SET_ERROR(AVI_ERR_READ);
       return -1;
    }
+   if (AVI->use_mmap) avi_mmap_readahead(AVI, frame);
 
-   AVI->video_pos++;
+   return n;
+}
 
+long AVI_read_video(avi_t *AVI, char *vidbuf, long bytes, int *keyframe)
+{
+   long n = AVI_read_video_at(AVI, AVI->video_pos, vidbuf, bytes, keyframe);
+
+   if (n >= 0) AVI->video_pos++;
    return n;
 }
 
@@ -3047,20 +3856,386 @@ long AVI_read_frame(avi_t *AVI, char *vidbuf, int *keyframe)
    return AVI_read_video(AVI, vidbuf, -1, keyframe);
 }
 
+/*
+ * AVI_read_frames: read `count' video frames starting with `first' into
+ * vidbufs[0..count-1]. On entry sizes[i] is the size of vidbufs[i] (-1 if
+ * unknown), on return the length of frame first+i; a NULL vidbufs[i] only
+ * queries the length. keyflags may be NULL.
+ * Frames which are close together in the file (just chunk headers or a
+ * bit of audio in between) are fetched with one large read and split up
+ * afterwards, so a batch usually costs a handful of reads instead of one
+ * per frame. Like AVI_read_video_at, the current video position is neither
+ * used nor changed.
+ * Returns the number of frames read, which is less than `count' at the end
+ * of the stream, or -1 on error.
+ */
+long AVI_read_frames(avi_t *AVI, long first, long count, char **vidbufs,
+                     long *sizes, int *keyflags)
+{
+   const video_index_entry *idx = NULL;
+   long i, j, k;
+   off_t start, end, max_read = BATCH_MAX_READ;
+   char *buf = NULL;
+
+   if(AVI->mode==AVI_MODE_WRITE) { AVI_SET_ERROR(AVI_ERR_NOT_PERM); return -1; }
+   if(!AVI->video_index)         { AVI_SET_ERROR(AVI_ERR_NO_IDX);   return -1; }
+
+   if(first < 0 || count < 0 || vidbufs == NULL || sizes == NULL) return -1;
+   if(first >= AVI->video_frames) return 0;
+   if(count > AVI->video_frames - first) count = AVI->video_frames - first;
+
+   idx = AVI->video_index + first;
+
+   /* through a mapping each frame is a memcpy, nothing to coalesce */
+   if (AVI->use_mmap && !AVI->video_map.failed) max_read = 0;
+
+   /* check all buffers before reading anything */
+   for (i = 0; i < count; i++) {
+      if (sizes[i] != -1 && vidbufs[i] != NULL && sizes[i] < idx[i].len) {
+         AVI_SET_ERROR(AVI_ERR_NO_BUFSIZE);
+         return -1;
+      }
+   }
+
+   for (i = 0; i < count; i = j) {
+      start = idx[i].pos;
+      end   = idx[i].pos + idx[i].len;
+
+      for (j = i + 1; j < count; j++) {
+         if (idx[j].pos < end
+          || idx[j].pos - end > BATCH_MAX_GAP
+          || idx[j].pos + idx[j].len - start > max_read)
+            break;
+         end = idx[j].pos + idx[j].len;
+      }
+
+      if (j == i + 1) {
+         /* single frame: straight into the caller's buffer */
+         if (vidbufs[i] != NULL
+          && avi_read_at(AVI, &AVI->video_map, start, vidbufs[i], idx[i].len) != idx[i].len) {
+            AVI_SET_ERROR(AVI_ERR_READ);
+            return -1;
+         }
+         continue;
+      }
+
+      buf = avi_scratch(AVI, end - start);
+      if (buf == NULL)
+         return -1;
+      if (plat_pread(AVI->fdes, buf, end - start, start) != end - start) {
+         AVI_SET_ERROR(AVI_ERR_READ);
+         return -1;
+      }
+      for (k = i; k < j; k++) {
+         if (vidbufs[k] != NULL)
+            memcpy(vidbufs[k], buf + (idx[k].pos - start), idx[k].len);
+      }
+   }
+
+   for (i = 0; i < count; i++) {
+      sizes[i] = idx[i].len;
+      if (keyflags != NULL)
+         keyflags[i] = (idx[i].key==0x10) ? 1:0;
+   }
+   if (AVI->use_mmap && count > 0) avi_mmap_readahead(AVI, first + count - 1);
+
+   return count;
+}
+
+/*
+ * AVI_peek_frame: access video frame `frame' without copying it. For
+ * mmap'ed handles (see AVI_enable_mmap) `*data' points into the mapping,
+ * otherwise into a per-handle buffer; either way it stays valid only until
+ * the next read, peek or AVI_close on this handle. Does not change the
+ * current video position. Returns 0 on success, -1 on error.
+ */
+int AVI_peek_frame(avi_t *AVI, long frame, const char **data, long *len,
+                   int *keyframe)
+{
+   const uint8_t *p = NULL;
+   long n;
+
+   if(AVI->mode==AVI_MODE_WRITE) { AVI_SET_ERROR(AVI_ERR_NOT_PERM); return -1; }
+   if(!AVI->video_index)         { AVI_SET_ERROR(AVI_ERR_NO_IDX);   return -1; }
+
+   if(frame < 0 || frame >= AVI->video_frames || data == NULL) return -1;
+   n = AVI->video_index[frame].len;
+
+   if (AVI->use_mmap) {
+      p = avi_mmap_data(AVI, &AVI->video_map, AVI->video_index[frame].pos, n);
+      if (p != NULL) avi_mmap_readahead(AVI, frame);
+   }
+
+   if (p == NULL) {
+      char *buf = avi_scratch(AVI, n);
+      if (buf == NULL) return -1;
+      if (plat_pread(AVI->fdes, buf, n, AVI->video_index[frame].pos) != n) {
+         AVI_SET_ERROR(AVI_ERR_READ);
+         return -1;
+      }
+      p = (const uint8_t *)buf;
+   }
+
+   *data = (const char *)p;
+   if (len != NULL)
+      *len = n;
+   if (keyframe != NULL)
+      *keyframe = (AVI->video_index[frame].key==0x10) ? 1:0;
+   return 0;
+}
+
+
+/*************************************************************************/
+/* read-ahead thread                                                     */
+
+/*
+ * The read-ahead keeps the `nslots' frames following (or, when playing
+ * backwards, preceding) the next expected frame in memory. Frame f always
+ * lives in slot f % nslots, so after a seek every frame still inside the
+ * new window stays where it is and only the rest gets read again.
+ * The thread reads through its own mapping (or pread), so the caller's
+ * video_map is never moved under its feet.
+ */
+
+typedef struct {
+    long  frame;                /* frame held by the slot, -1 if none */
+    char *buf;
+    long  size;                 /* allocated size of buf */
+    long  len;                  /* frame length, -1 if the read failed */
+    int   key;
+} avi_prefetch_slot_t;
+
+struct avi_prefetch_ {
+    pthread_t       thread;
+    pthread_mutex_t lock;
+    pthread_cond_t  wakeup;     /* new demand or stop request */
+    int             running;
+
+    avi_prefetch_slot_t *slots;
+    int             nslots;
+
+    long            want;       /* next frame the caller will ask for */
+    long            last;       /* last frame handed out */
+    int             dir;        /* 1 forward, -1 backwards */
+
+    avi_mmap_t      map;        /* the thread's own window */
+};
+
+/* next frame in the window that is missing, -1 if none; lock held */
+static long avi_prefetch_next(avi_t *AVI, avi_prefetch_t *pf)
+{
+    long i, f;
+
+    for (i = 0; i < pf->nslots; i++) {
+        f = pf->want + i * pf->dir;
+        if (f < 0 || f >= AVI->video_frames)
+            break;
+        if (pf->slots[f % pf->nslots].frame != f)
+            return f;
+    }
+    return -1;
+}
+
+static void *avi_prefetch_thread(void *arg)
+{
+    avi_t *AVI = arg;
+    avi_prefetch_t *pf = AVI->prefetch;
+    avi_prefetch_slot_t *slot = NULL;
+    long f, len;
+    int ok;
+
+    pthread_mutex_lock(&pf->lock);
+    while (pf->running) {
+        f = avi_prefetch_next(AVI, pf);
+        if (f < 0) {
+            pthread_cond_wait(&pf->wakeup, &pf->lock);
+            continue;
+        }
+        /* the caller won't touch a slot not holding its frame */
+        slot = &pf->slots[f % pf->nslots];
+        slot->frame = -1;
+        pthread_mutex_unlock(&pf->lock);
+
+        len = AVI->video_index[f].len;
+        ok  = 1;
+        if (slot->size < len) {
+            char *buf = plat_realloc(slot->buf, len);
+            if (buf == NULL) {
+                ok = 0;
+            } else {
+                slot->buf  = buf;
+                slot->size = len;
+            }
+        }
+        if (ok && avi_read_at(AVI, &pf->map, AVI->video_index[f].pos,
+                              slot->buf, len) != len) {
+            ok = 0;
+        }
+
+        pthread_mutex_lock(&pf->lock);
+        slot->frame = f;
+        slot->len   = (ok) ?len :-1;
+        slot->key   = (AVI->video_index[f].key==0x10) ? 1:0;
+    }
+    pthread_mutex_unlock(&pf->lock);
+    return NULL;
+}
+
+/* move the window to `frame', keeping the direction */
+static void avi_prefetch_seek(avi_prefetch_t *pf, long frame)
+{
+    pthread_mutex_lock(&pf->lock);
+    pf->want = frame;
+    pthread_cond_signal(&pf->wakeup);
+    pthread_mutex_unlock(&pf->lock);
+}
+
+/*
+ * AVI_enable_prefetch: start a thread reading ahead up to `frames' video
+ * frames from the current position, to be fetched with AVI_try_read_frame.
+ * Seeking with AVI_set_video_position moves the window, and reading
+ * backwards turns it around. Returns 0 on success, -1 on error.
+ */
+int AVI_enable_prefetch(avi_t *AVI, int frames)
+{
+   avi_prefetch_t *pf = NULL;
+
+   if(AVI->mode==AVI_MODE_WRITE) { AVI_SET_ERROR(AVI_ERR_NOT_PERM); return -1; }
+   if(!AVI->video_index)         { AVI_SET_ERROR(AVI_ERR_NO_IDX);   return -1; }
+
+   if (AVI->prefetch != NULL)
+      return 0;
+   if (frames < PREFETCH_MIN)
+      frames = PREFETCH_MIN;
+
+   pf = plat_zalloc(sizeof(avi_prefetch_t));
+   if (pf != NULL)
+      pf->slots = plat_zalloc(frames * sizeof(avi_prefetch_slot_t));
+   if (pf == NULL || pf->slots == NULL) {
+      plat_free(pf);
+      AVI_SET_ERROR(AVI_ERR_NO_MEM);
+      return -1;
+   }
+   pf->nslots  = frames;
+   for (frames = 0; frames < pf->nslots; frames++)
+      pf->slots[frames].frame = -1;
+   pf->want    = AVI->video_pos;
+   pf->last    = AVI->video_pos - 1;
+   pf->dir     = 1;
+   pf->running = 1;
+   pthread_mutex_init(&pf->lock, NULL);
+   pthread_cond_init(&pf->wakeup, NULL);
+
+   AVI->prefetch = pf;
+   if (pthread_create(&pf->thread, NULL, avi_prefetch_thread, AVI) != 0) {
+      AVI->prefetch = NULL;
+      pthread_cond_destroy(&pf->wakeup);
+      pthread_mutex_destroy(&pf->lock);
+      plat_free(pf->slots);
+      plat_free(pf);
+      AVI_SET_ERROR(AVI_ERR_NO_MEM);
+      return -1;
+   }
+   return 0;
+}
+
+void AVI_disable_prefetch(avi_t *AVI)
+{
+   avi_prefetch_t *pf = AVI->prefetch;
+   int i;
+
+   if (pf == NULL)
+      return;
+
+   pthread_mutex_lock(&pf->lock);
+   pf->running = 0;
+   pthread_cond_signal(&pf->wakeup);
+   pthread_mutex_unlock(&pf->lock);
+   pthread_join(pf->thread, NULL);
+
+   AVI->prefetch = NULL;
+   for (i = 0; i < pf->nslots; i++) {
+      if (pf->slots[i].buf)
+         plat_free(pf->slots[i].buf);
+   }
+   avi_mmap_release(&pf->map);
+   pthread_cond_destroy(&pf->wakeup);
+   pthread_mutex_destroy(&pf->lock);
+   plat_free(pf->slots);
+   plat_free(pf);
+}
+
+/*
+ * AVI_try_read_frame: like AVI_read_frame, but never waits for the disk.
+ * If the read-ahead doesn't have the frame yet, returns -1 with the handle
+ * error set to AVI_ERR_NOT_READY; try again later. At the end of the
+ * stream the handle error is cleared instead. Without read-ahead
+ * (see AVI_enable_prefetch) this is the same as AVI_read_frame.
+ */
+long AVI_try_read_frame(avi_t *AVI, char *vidbuf, int *keyframe)
+{
+   avi_prefetch_t *pf = AVI->prefetch;
+   avi_prefetch_slot_t *slot = NULL;
+   long f = AVI->video_pos, n = -1;
+   int err = AVI_ERR_NOT_READY;
+
+   if (pf == NULL)
+      return AVI_read_frame(AVI, vidbuf, keyframe);
+
+   if(f < 0 || f >= AVI->video_frames) {
+      /* end of stream, not worth another try */
+      AVI->avi_errno = 0;
+      return -1;
+   }
+
+   pthread_mutex_lock(&pf->lock);
+   slot = &pf->slots[f % pf->nslots];
+   if (slot->frame == f && slot->len >= 0) {
+      n = slot->len;
+      if (vidbuf != NULL)
+         memcpy(vidbuf, slot->buf, n);
+      *keyframe = slot->key;
+
+      /* keep reading in the direction the caller is going */
+      if (f < pf->last)
+         pf->dir = -1;
+      else if (f > pf->last)
+         pf->dir = 1;
+      pf->last = f;
+      pf->want = f + pf->dir;
+   } else if (slot->frame == f) {
+      /* report the failed read once, the next call tries again */
+      err = AVI_ERR_READ;
+      slot->frame = -1;
+      pf->want = f;
+   } else {
+      pf->want = f;
+   }
+   pthread_cond_signal(&pf->wakeup);
+   pthread_mutex_unlock(&pf->lock);
+
+   if (n < 0) {
+      AVI_SET_ERROR(err);
+      return -1;
+   }
+   AVI->video_pos++;
+   return n;
+}
+
 
 long AVI_get_audio_position_index(avi_t *AVI)
 {
-   if(AVI->mode==AVI_MODE_WRITE) { AVI_errno = AVI_ERR_NOT_PERM; return -1; }
-   if(!AVI->track[AVI->aptr].audio_index) { AVI_errno = AVI_ERR_NO_IDX;   return -1; }
+   if(AVI->mode==AVI_MODE_WRITE) { AVI_SET_ERROR(AVI_ERR_NOT_PERM); return -1; }
+   if(!AVI->track[AVI->aptr].audio_index) { AVI_SET_ERROR(AVI_ERR_NO_IDX);   return -1; }
 
    return (AVI->track[AVI->aptr].audio_posc);
 }
 
 int AVI_set_audio_position_index(avi_t *AVI, long indexpos)
 {
-   if(AVI->mode==AVI_MODE_WRITE) { AVI_errno = AVI_ERR_NOT_PERM; return -1; }
-   if(!AVI->track[AVI->aptr].audio_index)         { AVI_errno = AVI_ERR_NO_IDX;   return -1; }
-   if(indexpos > AVI->track[AVI->aptr].audio_chunks)     { AVI_errno = AVI_ERR_NO_IDX;   return -1; }
+   if(AVI->mode==AVI_MODE_WRITE) { AVI_SET_ERROR(AVI_ERR_NOT_PERM); return -1; }
+   if(!AVI->track[AVI->aptr].audio_index)         { AVI_SET_ERROR(AVI_ERR_NO_IDX);   return -1; }
+   if(indexpos > AVI->track[AVI->aptr].audio_chunks)     { AVI_SET_ERROR(AVI_ERR_NO_IDX);   return -1; }
 
    AVI->track[AVI->aptr].audio_posc = indexpos;
    AVI->track[AVI->aptr].audio_posb = 0;
@@ -3073,8 +4248,8 @@ int AVI_set_audio_position(avi_t *AVI, long byte)
 {
    long n0, n1, n;
 
-   if(AVI->mode==AVI_MODE_WRITE) { AVI_errno = AVI_ERR_NOT_PERM; return -1; }
-   if(!AVI->track[AVI->aptr].audio_index)         { AVI_errno = AVI_ERR_NO_IDX;   return -1; }
+   if(AVI->mode==AVI_MODE_WRITE) { AVI_SET_ERROR(AVI_ERR_NOT_PERM); return -1; }
+   if(!AVI->track[AVI->aptr].audio_index)         { AVI_SET_ERROR(AVI_ERR_NO_IDX);   return -1; }
 
    if(byte < 0) byte = 0;
 
@@ -3103,15 +4278,14 @@ long AVI_read_audio(avi_t *AVI, char *audbuf, long bytes)
    long nr, left, todo;
    off_t pos;
 
-   if(AVI->mode==AVI_MODE_WRITE) { AVI_errno = AVI_ERR_NOT_PERM; return -1; }
-   if(!AVI->track[AVI->aptr].audio_index)         { AVI_errno = AVI_ERR_NO_IDX;   return -1; }
+   if(AVI->mode==AVI_MODE_WRITE) { AVI_SET_ERROR(AVI_ERR_NOT_PERM); return -1; }
+   if(!AVI->track[AVI->aptr].audio_index)         { AVI_SET_ERROR(AVI_ERR_NO_IDX);   return -1; }
 
    nr = 0; /* total number of bytes read */
 
    if (bytes==0) {
      AVI->track[AVI->aptr].audio_posc++;
      AVI->track[AVI->aptr].audio_posb = 0;
-      plat_seek(AVI->fdes, 0LL, SEEK_CUR);
    }
    while(bytes>0)
    {
@@ -3129,12 +4303,11 @@ long AVI_read_audio(avi_t *AVI, char *audbuf, long bytes)
       else
          todo = left;
       pos = AVI->track[AVI->aptr].audio_index[AVI->track[AVI->aptr].audio_posc].pos + AVI->track[AVI->aptr].audio_posb;
-      plat_seek(AVI->fdes, pos, SEEK_SET);
-      if ( (ret = plat_read(AVI->fdes,audbuf+nr,todo)) != todo)
+      if ( (ret = avi_read_at(AVI, &AVI->audio_map, pos, audbuf+nr, todo)) != todo)
       {
 	    plat_log_send(PLAT_LOG_DEBUG, __FILE__, "XXX pos = %lld, ret = %lld, todo = %ld",
                      (long long)pos, (long long)ret, todo);
-         AVI_errno = AVI_ERR_READ;
+         AVI_SET_ERROR(AVI_ERR_READ);
          return -1;
       }
       bytes -= todo;
@@ -3150,8 +4323,8 @@ long AVI_read_audio_chunk(avi_t *AVI, char *audbuf)
    long left;
    off_t pos;
 
-   if(AVI->mode==AVI_MODE_WRITE) { AVI_errno = AVI_ERR_NOT_PERM; return -1; }
-   if(!AVI->track[AVI->aptr].audio_index)         { AVI_errno = AVI_ERR_NO_IDX;   return -1; }
+   if(AVI->mode==AVI_MODE_WRITE) { AVI_SET_ERROR(AVI_ERR_NOT_PERM); return -1; }
+   if(!AVI->track[AVI->aptr].audio_index)         { AVI_SET_ERROR(AVI_ERR_NO_IDX);   return -1; }
 
    if (AVI->track[AVI->aptr].audio_posc+1>AVI->track[AVI->aptr].audio_chunks) return -1;
 
@@ -3166,10 +4339,9 @@ long AVI_read_audio_chunk(avi_t *AVI, char *audbuf)
    }
 
    pos = AVI->track[AVI->aptr].audio_index[AVI->track[AVI->aptr].audio_posc].pos + AVI->track[AVI->aptr].audio_posb;
-   plat_seek(AVI->fdes, pos, SEEK_SET);
-   if (plat_read(AVI->fdes,audbuf,left) != left)
+   if (avi_read_at(AVI, &AVI->audio_map, pos, audbuf, left) != left)
    {
-      AVI_errno = AVI_ERR_READ;
+      AVI_SET_ERROR(AVI_ERR_READ);
       return -1;
    }
    AVI->track[AVI->aptr].audio_posc++;
@@ -3178,6 +4350,247 @@ long AVI_read_audio_chunk(avi_t *AVI, char *audbuf)
    return left;
 }
 
+/*
+ * AVI_read_audio_chunk_at: read the whole audio chunk `chunk' of track
+ * `track' into `audbuf' (of `bytes' size, -1 if unknown). Neither uses
+ * nor changes the current audio track or position.
+ */
+long AVI_read_audio_chunk_at(avi_t *AVI, int track, long chunk,
+                             char *audbuf, long bytes)
+{
+   track_t *trk;
+   long n;
+
+   if(AVI->mode==AVI_MODE_WRITE) { AVI_SET_ERROR(AVI_ERR_NOT_PERM); return -1; }
+   if(track < 0 || track >= AVI->anum) return -1;
+
+   trk = &AVI->track[track];
+   if(!trk->audio_index)         { AVI_SET_ERROR(AVI_ERR_NO_IDX);   return -1; }
+   if(chunk < 0 || chunk >= trk->audio_chunks) return -1;
+
+   n = trk->audio_index[chunk].len;
+   if (bytes != -1 && bytes < n) {
+      AVI_SET_ERROR(AVI_ERR_NO_BUFSIZE);
+      return -1;
+   }
+   if (audbuf == NULL) return n;
+
+   if (avi_read_at(AVI, &AVI->audio_map, trk->audio_index[chunk].pos, audbuf, n) != n)
+   {
+      AVI_SET_ERROR(AVI_ERR_READ);
+      return -1;
+   }
+   return n;
+}
+
+/*******************************************************************
+ *                                                                 *
+ *    Copying chunks from one AVI file to another                  *
+ *                                                                 *
+ *******************************************************************/
+
+/*
+ * The copy functions never read the payload of a chunk: they index it
+ * in the output as AVI_write_frame/AVI_write_audio would, and note the
+ * input range it comes from. Chunks following each other in the input
+ * and in the output (the usual case when remuxing) are gathered into one
+ * range, taking the input chunk headers along when they read exactly
+ * like the ones we would write; the range is copied by plat_copy_range
+ * when something else has to go to the output (a header of ours, an
+ * index chunk, a range from another file), when it grows too large, and
+ * at the latest when one of the two files is closed.
+ */
+
+/* copy the pending range of `AVI', if any */
+static int avi_copy_flush(avi_t *AVI)
+{
+   avi_t *in = AVI->copy_src;
+   ssize_t n;
+
+   if (in == NULL)
+      return 0;
+
+   AVI->copy_src = NULL;
+   in->copy_dest = NULL;
+
+   n = plat_copy_range(in->fdes, AVI->copy_from,
+                       AVI->fdes, AVI->copy_to, (size_t)AVI->copy_len);
+   if (AVI->writer == NULL)
+      plat_seek(AVI->fdes, AVI->pos, SEEK_SET);
+
+   if (n != AVI->copy_len) {
+      AVI->copy_failed = 1;
+      AVI_SET_ERROR(AVI_ERR_WRITE);
+      return -1;
+   }
+   return 0;
+}
+
+/* does the input chunk of `len' bytes at `from' have the header `hdr'? */
+static int avi_copy_same_header(avi_t *in, avi_mmap_t *map, off_t from,
+                                const unsigned char *hdr)
+{
+   const uint8_t *p = NULL;
+   unsigned char c[8];
+
+   if (from < 8)
+      return 0;
+   if (in->use_mmap)
+      p = avi_mmap_data(in, map, from - 8, 8);
+   if (p == NULL) {
+      if (plat_pread(in->fdes, c, 8, from - 8) != 8)
+         return 0;
+      p = c;
+   }
+   return memcmp(p, hdr, 8) == 0;
+}
+
+/*
+ * add a chunk `tag' with the `len' bytes at `from' in `in' to the output,
+ * the index entries have to be there already.
+ */
+static int avi_copy_chunk(avi_t *AVI, avi_t *in, avi_mmap_t *map,
+                          const unsigned char *tag, off_t from, long len,
+                          int whole)
+{
+   unsigned char c[8];
+   off_t src = from, dst = AVI->pos + 8, n = PAD_EVEN(len);
+
+   memcpy(c, tag, 4);
+   long2str(c+4, len);
+
+   if (in->file_size <= 0)
+      in->file_size = avi_file_size(in);
+   if (from + n > in->file_size) {
+      /* no pad byte in a truncated input; the hole left reads as 0 */
+      n = len;
+   }
+
+   if (whole && avi_copy_same_header(in, map, from, c)) {
+      src -= 8;
+      dst -= 8;
+      n   += 8;
+   }
+
+   if (AVI->copy_src == in
+    && src == AVI->copy_from + AVI->copy_len
+    && dst == AVI->copy_to + AVI->copy_len
+    && AVI->copy_len + n <= COPY_MAX_RANGE
+   ) {
+      AVI->copy_len += n;
+   } else {
+      if (avi_copy_flush(AVI) < 0)
+         return -1;
+      if (in->copy_dest != NULL && avi_copy_flush(in->copy_dest) < 0)
+         return -1;
+
+      if (dst != AVI->pos) {
+         if (AVI->writer != NULL) {
+            if (avi_writer_append(AVI, AVI->pos, (char *)c, 8) < 0) {
+               AVI_SET_ERROR(AVI_ERR_WRITE);
+               return -1;
+            }
+         } else if (plat_pwrite(AVI->fdes, c, 8, AVI->pos) != 8) {
+            AVI_SET_ERROR(AVI_ERR_WRITE);
+            return -1;
+         }
+      }
+      AVI->copy_src  = in;
+      AVI->copy_from = src;
+      AVI->copy_to   = dst;
+      AVI->copy_len  = n;
+      in->copy_dest  = AVI;
+   }
+
+   AVI->pos += 8 + PAD_EVEN(len);
+   return 0;
+}
+
+/*
+ * AVI_copy_frame: add video frame `frame' of `in' to `AVI', like
+ * AVI_write_frame does with data read by AVI_read_frame, but without
+ * passing the data through memory. The video position of `in' is
+ * neither used nor changed. Returns 0 on success, -1 on error.
+ */
+int AVI_copy_frame(avi_t *AVI, avi_t *in, long frame)
+{
+   const video_index_entry *ix = NULL;
+   off_t pos;
+   long len;
+
+   if(AVI->mode==AVI_MODE_READ) { AVI_SET_ERROR(AVI_ERR_NOT_PERM); return -1; }
+   if(in->mode==AVI_MODE_WRITE) { AVI_SET_ERROR(AVI_ERR_NOT_PERM); return -1; }
+   if(!in->video_index)         { AVI_SET_ERROR(AVI_ERR_NO_IDX);   return -1; }
+   if(frame < 0 || frame >= in->video_frames) return -1;
+   if(AVI->copy_failed)         { AVI_SET_ERROR(AVI_ERR_WRITE);    return -1; }
+
+   ix  = &in->video_index[frame];
+   len = ix->len;
+
+   if (avi_add_chunk_index(AVI, (unsigned char *)"00db",
+                           (ix->key == 0x10) ?0x10 :0x0, len)) return -1;
+
+   pos = AVI->pos;
+   if (avi_copy_chunk(AVI, in, &in->video_map, (unsigned char *)"00db",
+                      ix->pos, len, 1) < 0)
+      return -1;
+
+   AVI->last_pos = pos;
+   AVI->last_len = len;
+   AVI->video_frames++;
+   return 0;
+}
+
+/*
+ * AVI_copy_audio_chunk: add the rest of the current audio chunk of the
+ * current track of `in' to the current track of the output, like
+ * AVI_write_audio does with data read by AVI_read_audio_chunk.
+ * Returns the number of bytes copied, -1 on error or at the end.
+ */
+long AVI_copy_audio_chunk(avi_t *AVI, avi_t *in)
+{
+   track_t *trk = NULL;
+   unsigned char astr[5];
+   long left;
+   off_t pos;
+
+   if(AVI->mode==AVI_MODE_READ) { AVI_SET_ERROR(AVI_ERR_NOT_PERM); return -1; }
+   if(in->mode==AVI_MODE_WRITE) { AVI_SET_ERROR(AVI_ERR_NOT_PERM); return -1; }
+   if(AVI->copy_failed)         { AVI_SET_ERROR(AVI_ERR_WRITE);    return -1; }
+
+   trk = &in->track[in->aptr];
+   if(!trk->audio_index)         { AVI_SET_ERROR(AVI_ERR_NO_IDX);   return -1; }
+   if (trk->audio_posc+1>trk->audio_chunks) return -1;
+
+   left = trk->audio_index[trk->audio_posc].len - trk->audio_posb;
+   pos  = trk->audio_index[trk->audio_posc].pos + trk->audio_posb;
+
+   snprintf((char *)astr, sizeof(astr), "0%1dwb", (int)(AVI->aptr+1));
+   if (avi_add_chunk_index(AVI, astr, 0x10, left)) return -1;
+   if (avi_copy_chunk(AVI, in, &in->audio_map, astr, pos, left,
+                      trk->audio_posb == 0) < 0)
+      return -1;
+
+   trk->audio_posc++;
+   trk->audio_posb = 0;
+
+   AVI->track[AVI->aptr].audio_bytes += left;
+   AVI->track[AVI->aptr].audio_chunks++;
+   return left;
+}
+
+/*
+ * AVI_copy_flush: copy now whatever the copy functions gathered for
+ * `AVI'. Not needed before AVI_close. Returns 0 on success, -1 if this
+ * or an earlier copy failed.
+ */
+int AVI_copy_flush(avi_t *AVI)
+{
+   if (avi_copy_flush(AVI) < 0 || AVI->copy_failed)
+      return -1;
+   return 0;
+}
+
 /* AVI_print_error: Print most recent error (similar to perror) */
 
 static const char *avi_errors[] =
@@ -3197,7 +4610,8 @@ static const char *avi_errors[] =
   /* 12 */ "avilib - AVI file has no video data",
   /* 13 */ "avilib - operation needs an index",
   /* 14 */ "avilib - destination buffer is too small",
-  /* 15 */ "avilib - Unkown Error"
+  /* 15 */ "avilib - frame not read ahead yet",
+  /* 16 */ "avilib - Unkown Error"
 };
 static int num_avi_errors = sizeof(avi_errors)/sizeof(char*);
 
@@ -3220,7 +4634,7 @@ void AVI_print_error(const char *str)
 
 const char *AVI_strerror(void)
 {
-    static char error_string[4096];
+    static THREAD_LOCAL char error_string[4096];
     int aerrno = (AVI_errno>=0 && AVI_errno<num_avi_errors) ?AVI_errno :num_avi_errors-1;
 
     if (AVI_errno == AVI_ERR_OPEN
@@ -3234,6 +4648,18 @@ const char *AVI_strerror(void)
     return avi_errors[aerrno];
 }
 
+int AVI_get_error(avi_t *AVI)
+{
+    return AVI->avi_errno;
+}
+
+const char *AVI_error_string(int aerrno)
+{
+    if (aerrno < 0 || aerrno >= num_avi_errors)
+        aerrno = num_avi_errors-1;
+    return avi_errors[aerrno];
+}
+
 uint64_t AVI_max_size(void)
 {
     return((uint64_t)AVI_MAX_LEN);
@@ -50,9 +50,9 @@ enum {
 
 typedef struct
 {
-  off_t key;
-  off_t pos;
-  off_t len;
+  off_t    pos;
+  uint32_t len;             /* chunks are 32bit sized */
+  uint32_t key;             /* 0x10 for keyframes */
 } video_index_entry;
 
 typedef struct
@@ -149,6 +149,20 @@ typedef struct track_s
 
 } track_t;
 
+typedef struct
+{
+  uint8_t *base;            /* currently mapped window of the file */
+  off_t    start;           /* file offset of base */
+  size_t   len;             /* length of the mapped window */
+  int      failed;          /* can't map, use plain reads */
+} avi_mmap_t;
+
+/* background read-ahead, see AVI_enable_prefetch */
+typedef struct avi_prefetch_ avi_prefetch_t;
+
+/* background writer, see AVI_enable_write_behind */
+typedef struct avi_writer_ avi_writer_t;
+
 typedef struct
 {
   uint32_t  bi_size;
@@ -200,7 +214,7 @@ typedef struct __attribute__((__packed__))
   char     sz_name[64];
 } alAVISTREAMINFO;
 
-typedef struct
+typedef struct avi_s
 {
 
   long   fdes;              /* File descriptor of AVI file */
@@ -250,6 +264,30 @@ typedef struct
 
   void*     extradata;
   unsigned long extradata_size;
+
+  long   avi_errno;         /* last error on this handle */
+
+  /* memory mapped read access (see AVI_enable_mmap) */
+  int      use_mmap;        /* read through the mappings when set */
+  off_t    file_size;
+  avi_mmap_t video_map;     /* used by the video functions */
+  avi_mmap_t audio_map;     /* used by the audio functions */
+  off_t    ra_start;        /* range already hinted for readahead */
+  off_t    ra_end;
+  char    *peek_buf;        /* peek/batch read storage when not mapped */
+  long     peek_size;
+
+  avi_prefetch_t *prefetch; /* read-ahead thread, if enabled */
+  avi_writer_t   *writer;   /* write-behind thread, if enabled */
+
+  /* range copies (see AVI_copy_frame): on an output handle, the file
+     range gathered so far, on an input handle the output it goes to */
+  struct avi_s *copy_src;   /* input handle of the range, NULL if none */
+  off_t    copy_from;       /* input offset of the range */
+  off_t    copy_to;         /* output offset of the range */
+  off_t    copy_len;
+  int      copy_failed;     /* a range copy failed */
+  struct avi_s *copy_dest;  /* output with a range from here pending */
 } avi_t;
 
 #define AVI_MODE_WRITE  0
@@ -299,6 +337,8 @@ typedef struct
                                       performed that needs an index */
 #define AVI_ERR_NO_BUFSIZE  14     /* Given buffer is not large enough
                                       to hold the requested data */
+#define AVI_ERR_NOT_READY   15     /* The read-ahead thread hasn't read
+                                      the requested frame yet */
 
 /* Possible Audio formats */
 
@@ -328,6 +368,9 @@ void AVI_set_audio(avi_t *AVI, int channels, long rate, int bits, int format,
                    long mp3rate);
 int  AVI_write_frame(avi_t *AVI, const char *data, long bytes, int keyframe);
 int  AVI_write_audio(avi_t *AVI, const char *data, long bytes);
+int  AVI_enable_write_behind(avi_t *AVI, long bufsize, int buffers);
+long AVI_write_backlog(avi_t *AVI);
+int  AVI_reserve_index(avi_t *AVI, long frames);
 long AVI_bytes_remain(avi_t *AVI);
 int  AVI_close(avi_t *AVI);
 long AVI_bytes_written(avi_t *AVI);
@@ -337,6 +380,8 @@ avi_t *AVI_open_input_indexfile(const char *filename, int getIndex,
                 const char *indexfile);
 avi_t *AVI_open_fd(int fd, int getIndex);
 avi_t *AVI_open_indexfd(int fd, int getIndex, const char *indexfile);
+avi_t *AVI_open_input_file_mmap(const char *filename, int getIndex);
+int  AVI_enable_mmap(avi_t *AVI);
 
 long AVI_audio_mp3rate(avi_t *AVI);
 long AVI_audio_padrate(avi_t *AVI);
@@ -363,6 +408,23 @@ int  AVI_set_video_position(avi_t *AVI, long frame);
 long AVI_get_video_position(avi_t *AVI, long frame);
 long AVI_read_frame(avi_t *AVI, char *vidbuf, int *keyframe);
 long AVI_read_video(avi_t *AVI, char *vidbuf, long bytes, int *keyframe);
+long AVI_read_video_at(avi_t *AVI, long frame, char *vidbuf, long bytes,
+                       int *keyframe);
+int  AVI_peek_frame(avi_t *AVI, long frame, const char **data, long *len,
+                    int *keyframe);
+long AVI_read_frames(avi_t *AVI, long first, long count, char **vidbufs,
+                     long *sizes, int *keyflags);
+
+int  AVI_write_index_cache(avi_t *AVI, const char *filename);
+avi_t *AVI_open_input_file_cached(const char *filename, const char *cachefile);
+
+int  AVI_copy_frame(avi_t *AVI, avi_t *in, long frame);
+long AVI_copy_audio_chunk(avi_t *AVI, avi_t *in);
+int  AVI_copy_flush(avi_t *AVI);
+
+int  AVI_enable_prefetch(avi_t *AVI, int frames);
+void AVI_disable_prefetch(avi_t *AVI);
+long AVI_try_read_frame(avi_t *AVI, char *vidbuf, int *keyframe);
 
 int  AVI_set_audio_position(avi_t *AVI, long byte);
 int  AVI_set_audio_bitrate(avi_t *AVI, long bitrate);
@@ -372,6 +434,8 @@ int  AVI_set_audio_position_index(avi_t *AVI, long indexpos);
 
 long AVI_read_audio(avi_t *AVI, char *audbuf, long bytes);
 long AVI_read_audio_chunk(avi_t *AVI, char *audbuf);
+long AVI_read_audio_chunk_at(avi_t *AVI, int track, long chunk,
+                             char *audbuf, long bytes);
 
 long AVI_audio_codech_offset(avi_t *AVI);
 long AVI_audio_codecf_offset(avi_t *AVI);
@@ -380,6 +444,8 @@ long AVI_video_codecf_offset(avi_t *AVI);
 
 void AVI_print_error(const char *str);
 const char *AVI_strerror(void);
+int  AVI_get_error(avi_t *AVI);
+const char *AVI_error_string(int aerrno);
 
 int AVI_scan(const char *name);
 int AVI_dump(const char *name, int mode);
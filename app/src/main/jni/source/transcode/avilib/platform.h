@@ -47,8 +47,38 @@ int plat_open(const char *pathname, int flags, int mode);
 int plat_close(int fd);
 ssize_t plat_read(int fd, void *buf, size_t count);
 ssize_t plat_write(int fd, const void *buf, size_t count);
+/* positional read, doesn't use nor move the file offset */
+ssize_t plat_pread(int fd, void *buf, size_t count, int64_t offset);
+/* positional write, same for writing */
+ssize_t plat_pwrite(int fd, const void *buf, size_t count, int64_t offset);
 int64_t plat_seek(int fd, int64_t offset, int whence);
 int plat_ftruncate(int fd, int64_t length);
+/*
+ * copy `count' bytes at `off_in' in fd_in to `off_out' in fd_out, inside
+ * the kernel where possible, with a buffered copy otherwise. The file
+ * offset of fd_in is not used nor moved; the one of fd_out may be moved.
+ * Returns the number of bytes copied, less than `count' on error or at
+ * the end of fd_in.
+ */
+ssize_t plat_copy_range(int fd_in, int64_t off_in,
+                        int fd_out, int64_t off_out, size_t count);
+/* enable (default) or disable the in-kernel copies; mostly for testing */
+void plat_copy_range_set_kernel(int enable);
+
+/*************************************************************************/
+/* memory mapped (read-only) file access                                 */
+/*************************************************************************/
+
+/*
+ * plat_mmap returns NULL if mapping is unsupported on this platform or
+ * failed for any reason; callers must then fall back to plat_read.
+ * `offset' must be a multiple of plat_page_size().
+ */
+void *plat_mmap(int fd, int64_t offset, size_t length);
+int plat_munmap(void *addr, size_t length);
+/* hint that [addr, addr+length) will be read soon; advisory only */
+int plat_prefetch(void *addr, size_t length);
+size_t plat_page_size(void);
 
 /*************************************************************************/
 /* libc-like memory handling                                             */
@@ -0,0 +1,123 @@
+/*
+ * platform_copy.c -- range copies between files, shared by all platforms.
+ * (C) 2007-2010 - Francesco Romani <fromani -at- gmail -dot- com>
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty.  In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ */
+
+#include "platform.h"
+
+#include <errno.h>
+
+/* kernel copies need real file descriptors, so not with IBP */
+#if defined(__linux__) && !defined(HAVE_IBP)
+#include <sys/syscall.h>
+#include <sys/sendfile.h>
+#define PLAT_HAVE_SENDFILE
+#if defined(SYS_copy_file_range)
+#define PLAT_HAVE_COPY_FILE_RANGE
+#endif
+#endif
+
+
+/*************************************************************************/
+/* Range copies stay in the kernel when it lets us.                      */
+/*************************************************************************/
+
+#define COPY_BUFSIZE    (1 << 20)
+
+static int use_kernel_copy = 1;
+
+void plat_copy_range_set_kernel(int enable)
+{
+    use_kernel_copy = enable;
+}
+
+/* the last resort: plain positional reads and writes */
+static ssize_t copy_range_buffered(int fd_in, int64_t off_in,
+                                   int fd_out, int64_t off_out, size_t count)
+{
+    char *buf = plat_malloc((count < COPY_BUFSIZE) ?count :COPY_BUFSIZE);
+    ssize_t n = 0, r = 0;
+
+    if (buf == NULL)
+        return -1;
+    while (r < count) {
+        n = (count - r < COPY_BUFSIZE) ?count - r :COPY_BUFSIZE;
+        n = plat_pread(fd_in, buf, n, off_in + r);
+        if (n <= 0 || plat_pwrite(fd_out, buf, n, off_out + r) != n)
+            break;
+        r += n;
+    }
+    plat_free(buf);
+    return r;
+}
+
+ssize_t plat_copy_range(int fd_in, int64_t off_in,
+                        int fd_out, int64_t off_out, size_t count)
+{
+    ssize_t n = 0, r = 0;
+
+#ifdef PLAT_HAVE_COPY_FILE_RANGE
+    /* fails with EXDEV across file systems on older kernels, so that
+       is only given up for this call */
+    static int no_copy_file_range = 0;
+
+    while (use_kernel_copy && !no_copy_file_range && r < count) {
+        int64_t src = off_in + r, dst = off_out + r;
+        n = syscall(SYS_copy_file_range, fd_in, &src, fd_out, &dst,
+                    count - r, 0);
+        if (n == 0)
+            return r;
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+            if (errno == ENOSYS)
+                no_copy_file_range = 1;
+            break;
+        }
+        r += n;
+    }
+#endif
+#ifdef PLAT_HAVE_SENDFILE
+    /* sendfile writes at the output file offset */
+    if (use_kernel_copy && r < count
+     && lseek(fd_out, off_out + r, SEEK_SET) >= 0) {
+        while (r < count) {
+            off_t src = off_in + r;
+            n = sendfile(fd_out, fd_in, &src, count - r);
+            if (n == 0)
+                return r;
+            if (n < 0) {
+                if (errno == EINTR)
+                    continue;
+                break;
+            }
+            r += n;
+        }
+    }
+#endif
+    if (r < count) {
+        n = copy_range_buffered(fd_in, off_in + r, fd_out, off_out + r,
+                                count - r);
+        if (n > 0)
+            r += n;
+    }
+    return (r > 0 || count == 0) ?r :-1;
+}
+
+// EOF
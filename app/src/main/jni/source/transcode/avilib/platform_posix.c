@@ -25,6 +25,10 @@
 #include <stdarg.h>
 #include <errno.h>
 
+#ifdef HAVE_MMAP
+#include <sys/mman.h>
+#endif
+
 
 /*************************************************************************/
 /* I/O is straightforward.                                               */
@@ -48,7 +52,7 @@ ssize_t plat_read(int fd, void *buf, size_t count)
     ssize_t n = 0, r = 0;
 
     while (r < count) {
-        n = read(fd, buf + r, count - r);
+        n = read(fd, (char *)buf + r, count - r);
         if (n == 0)
 	        break;
         if (n < 0) {
@@ -63,6 +67,50 @@ ssize_t plat_read(int fd, void *buf, size_t count)
    return r;
 }
 
+/* 
+ * automatically restart after a recoverable interruption
+ */
+ssize_t plat_pread(int fd, void *buf, size_t count, int64_t offset)
+{
+    ssize_t n = 0, r = 0;
+
+    while (r < count) {
+        n = pread(fd, (char *)buf + r, count - r, offset + r);
+        if (n == 0)
+            break;
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+            else
+                break;
+        }
+
+        r += n;
+    }
+    return r;
+}
+
+/* 
+ * automatically restart after a recoverable interruption
+ */
+ssize_t plat_pwrite(int fd, const void *buf, size_t count, int64_t offset)
+{
+    ssize_t n = 0, r = 0;
+
+    while (r < count) {
+        n = pwrite(fd, (const char *)buf + r, count - r, offset + r);
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+            else
+                break;
+        }
+
+        r += n;
+    }
+    return r;
+}
+
 /* 
  * automatically restart after a recoverable interruption
  */
@@ -71,7 +119,7 @@ ssize_t plat_write(int fd, const void *buf, size_t count)
     ssize_t n = 0, r = 0;
 
     while (r < count) {
-        n = write(fd, buf + r, count - r);
+        n = write(fd, (const char *)buf + r, count - r);
         if (n < 0)
             return n;
 
@@ -91,6 +139,58 @@ int plat_ftruncate(int fd, int64_t length)
     return ftruncate(fd, length);
 }
 
+/*************************************************************************/
+/* mmap is available almost everywhere, madvise is just a hint.          */
+/*************************************************************************/
+
+#ifdef HAVE_MMAP
+
+void *plat_mmap(int fd, int64_t offset, size_t length)
+{
+    void *addr = mmap(NULL, length, PROT_READ, MAP_SHARED, fd, offset);
+    return (addr == MAP_FAILED) ?NULL :addr;
+}
+
+int plat_munmap(void *addr, size_t length)
+{
+    return munmap(addr, length);
+}
+
+int plat_prefetch(void *addr, size_t length)
+{
+    /* madvise() wants a page aligned start address */
+    uintptr_t mask = (uintptr_t)plat_page_size() - 1;
+    uintptr_t start = (uintptr_t)addr & ~mask;
+
+    return madvise((void *)start, length + ((uintptr_t)addr - start),
+                   MADV_WILLNEED);
+}
+
+#else /* not HAVE_MMAP */
+
+void *plat_mmap(int fd, int64_t offset, size_t length)
+{
+    return NULL;
+}
+
+int plat_munmap(void *addr, size_t length)
+{
+    return -1;
+}
+
+int plat_prefetch(void *addr, size_t length)
+{
+    return 0;
+}
+
+#endif /* HAVE_MMAP */
+
+size_t plat_page_size(void)
+{
+    long size = sysconf(_SC_PAGESIZE);
+    return (size > 0) ?size :4096;
+}
+
 
 
 /*************************************************************************/
@@ -28,6 +28,10 @@
 #include <stdarg.h>
 #include <errno.h>
 
+#if defined(HAVE_MMAP) && !defined(HAVE_IBP)
+#include <sys/mman.h>
+#endif
+
 
 int plat_open(const char *pathname, int flags, int mode)
 {
@@ -44,11 +48,69 @@ ssize_t plat_read(int fd, void *buf, size_t count)
     return tc_pread(fd, buf, count);
 }
 
+#ifdef HAVE_IBP
+/* no positional I/O through xio, this one is NOT thread safe */
+ssize_t plat_pread(int fd, void *buf, size_t count, int64_t offset)
+{
+    if (xio_lseek(fd, offset, SEEK_SET) < 0)
+        return -1;
+    return tc_pread(fd, buf, count);
+}
+#else /* not HAVE_IBP */
+ssize_t plat_pread(int fd, void *buf, size_t count, int64_t offset)
+{
+    ssize_t n = 0, r = 0;
+
+    while (r < count) {
+        n = pread(fd, (uint8_t *)buf + r, count - r, offset + r);
+        if (n == 0)
+            break;
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+            else
+                break;
+        }
+
+        r += n;
+    }
+    return r;
+}
+#endif /* HAVE_IBP */
+
 ssize_t plat_write(int fd, const void *buf, size_t count)
 {
     return tc_pwrite(fd, buf, count);
 }
 
+#ifdef HAVE_IBP
+/* as plat_pread, NOT thread safe */
+ssize_t plat_pwrite(int fd, const void *buf, size_t count, int64_t offset)
+{
+    if (xio_lseek(fd, offset, SEEK_SET) < 0)
+        return -1;
+    return tc_pwrite(fd, buf, count);
+}
+#else /* not HAVE_IBP */
+ssize_t plat_pwrite(int fd, const void *buf, size_t count, int64_t offset)
+{
+    ssize_t n = 0, r = 0;
+
+    while (r < count) {
+        n = pwrite(fd, (const uint8_t *)buf + r, count - r, offset + r);
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+            else
+                break;
+        }
+
+        r += n;
+    }
+    return r;
+}
+#endif /* HAVE_IBP */
+
 int64_t plat_seek(int fd, int64_t offset, int whence)
 {
     return xio_lseek(fd, offset, whence);
@@ -59,6 +121,54 @@ int plat_ftruncate(int fd, int64_t length)
     return xio_ftruncate(fd, length);
 }
 
+/* xio descriptors do not need to be real file descriptors */
+#if defined(HAVE_MMAP) && !defined(HAVE_IBP)
+
+void *plat_mmap(int fd, int64_t offset, size_t length)
+{
+    void *addr = mmap(NULL, length, PROT_READ, MAP_SHARED, fd, offset);
+    return (addr == MAP_FAILED) ?NULL :addr;
+}
+
+int plat_munmap(void *addr, size_t length)
+{
+    return munmap(addr, length);
+}
+
+int plat_prefetch(void *addr, size_t length)
+{
+    uintptr_t mask = (uintptr_t)plat_page_size() - 1;
+    uintptr_t start = (uintptr_t)addr & ~mask;
+
+    return madvise((void *)start, length + ((uintptr_t)addr - start),
+                   MADV_WILLNEED);
+}
+
+#else /* no mmap or xio */
+
+void *plat_mmap(int fd, int64_t offset, size_t length)
+{
+    return NULL;
+}
+
+int plat_munmap(void *addr, size_t length)
+{
+    return -1;
+}
+
+int plat_prefetch(void *addr, size_t length)
+{
+    return 0;
+}
+
+#endif
+
+size_t plat_page_size(void)
+{
+    long size = sysconf(_SC_PAGESIZE);
+    return (size > 0) ?size :4096;
+}
+
 
 
 void *_plat_malloc(const char *file, int line, size_t size)
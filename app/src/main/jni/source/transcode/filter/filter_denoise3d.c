@@ -20,14 +20,21 @@
 */
 
 #define MOD_NAME    "filter_denoise3d.so"
-#define MOD_VERSION "v1.0.6 (2003-12-20)"
+#define MOD_VERSION "v1.1.0 (2026-10-17)"
 #define MOD_CAP     "High speed 3D Denoiser"
 #define MOD_AUTHOR  "Daniel Moreno, A'rpi"
 
+#define MOD_FEATURES \
+    TC_MODULE_FEATURE_FILTER|TC_MODULE_FEATURE_VIDEO
+/* temporal filter: keeps the previous frame */
+#define MOD_FLAGS \
+    TC_MODULE_FLAG_RECONFIGURABLE
+
 #include "transcode.h"
 #include "filter.h"
 #include "libtc/libtc.h"
 #include "libtc/optstr.h"
+#include "libtc/tcmodule-plugin.h"
 
 #include <math.h>
 
@@ -43,6 +50,7 @@
 				added arbitrary layout support
 				denoising U&V (colour) planes now actually works
 	1.0.6	EMS	fixed annoying typo
+	1.1.0		converted to the module interface; per-instance state
 */
 
 #define MAX_PLANES 3
@@ -100,12 +108,9 @@ typedef struct
 	int				enable_luma;
 	int				enable_chroma;
 
+	char			conf_str[TC_BUF_MIN];
 } dn3d_private_data_t;
 
-/* FIXME: this uses the filter ID as an index--the ID can grow
- * arbitrarily large, so this needs to be fixed */
-static dn3d_private_data_t dn3d_private_data[100];
-
 static const dn3d_layout_t dn3d_layout[] =
 {
 	{ CODEC_YUV,    dn3d_yuv420p, dn3d_planar, {{ dn3d_luma, dn3d_off_y420,  1, 1, 1 }, { dn3d_chroma, dn3d_off_u420,  1, 2, 2 }, { dn3d_chroma, dn3d_off_v420,  1, 2, 2 }}},
@@ -199,9 +204,7 @@ static void PrecalcCoefs(int * ct, double dist25)
 	}
 }
 
-static void help_optstr(void)
-{
-    tc_log_info(MOD_NAME, "(%s) help\n"
+static const char denoise3d_help[] = ""
 "* Overview\n"
 "  This filter aims to reduce image noise producing\n"
 "  smooth images and making still images really still\n"
@@ -211,259 +214,405 @@ static void help_optstr(void)
 "   chroma:          spatial chroma strength (%f)\n"
 "   luma_strength:   temporal luma strength (%f)\n"
 "   chroma_strength: temporal chroma strength (%f)\n"
-"   pre:             run as a pre filter (0)\n"
-		, MOD_CAP,
+"   pre:             run as a pre filter (0)\n";
+
+static void help_optstr(void)
+{
+    tc_log_info(MOD_NAME, "(%s) help", MOD_CAP);
+    tc_log_info(MOD_NAME, denoise3d_help,
 		DEFAULT_LUMA_SPATIAL,
 		DEFAULT_CHROMA_SPATIAL,
 		DEFAULT_LUMA_TEMPORAL,
 		DEFAULT_CHROMA_TEMPORAL);
 }
 
-int tc_filter(frame_list_t *vframe_, char * options)
+/*************************************************************************/
+
+/* Module interface routines and data. */
+
+/*************************************************************************/
+
+/**
+ * denoise3d_init:  Initialize this instance of the module.  See
+ * tcmodule-data.h for function details.
+ */
+
+static int denoise3d_init(TCModuleInstance *self, uint32_t features)
 {
-	vframe_list_t *vframe = (vframe_list_t *)vframe_;
-	int instance;
-	int tag = vframe->tag;
-	dn3d_private_data_t * pd;
+    dn3d_private_data_t *pd = NULL;
 
-	if(tag & TC_AUDIO)
-		return(0);
+    TC_MODULE_SELF_CHECK(self, "init");
+    TC_MODULE_INIT_CHECK(self, MOD_FEATURES, features);
 
-	instance	= vframe->filter_id;
-	pd			= &dn3d_private_data[instance];
+    pd = tc_zalloc(sizeof(dn3d_private_data_t));
+    if (pd == NULL) {
+        tc_log_error(MOD_NAME, "init: out of memory!");
+        return TC_ERROR;
+    }
+    self->userdata = pd;
 
-	if(tag & TC_FILTER_GET_CONFIG)
-	{
-		char buf[128];
-		optstr_filter_desc(options, MOD_NAME, MOD_CAP, MOD_VERSION, MOD_AUTHOR, "VYMOE", "2");
+    if (verbose) {
+        tc_log_info(MOD_NAME, "%s %s #%d", MOD_VERSION, MOD_CAP, self->id);
+    }
+    return TC_OK;
+}
 
-		tc_snprintf(buf, 128, "%f", DEFAULT_LUMA_SPATIAL);
-		optstr_param(options, "luma", "spatial luma strength", "%f", buf, "0.0", "100.0" );
+/*************************************************************************/
 
-		tc_snprintf(buf, 128, "%f", DEFAULT_CHROMA_SPATIAL);
-		optstr_param(options, "chroma", "spatial chroma strength", "%f", buf, "0.0", "100.0" );
+/**
+ * denoise3d_fini:  Clean up after this instance of the module.  See
+ * tcmodule-data.h for function details.
+ */
 
-		tc_snprintf(buf, 128, "%f", DEFAULT_LUMA_TEMPORAL);
-		optstr_param(options, "luma_strength", "temporal luma strength", "%f", buf, "0.0", "100.0" );
+TC_MODULE_GENERIC_FINI(denoise3d)
 
-		tc_snprintf(buf, 128, "%f", DEFAULT_CHROMA_TEMPORAL);
-		optstr_param(options, "chroma_strength", "temporal chroma strength", "%f", buf, "0.0", "100.0" );
+/*************************************************************************/
 
-		tc_snprintf(buf, 128, "%d", dn3d_private_data[instance].prefilter);
-		optstr_param(options, "pre", "run as a pre filter", "%d", buf, "0", "1" );
-	}
+/**
+ * denoise3d_stop:  Reset this instance of the module, dropping the
+ * saved frame.  See tcmodule-data.h for function details.
+ */
 
-	if(tag & TC_FILTER_INIT)
-	{
-		int format_index, plane_index, found;
-		const dn3d_layout_t * lp;
-		size_t size;
-
-		if(!(pd->vob = tc_get_vob()))
-			return(TC_IMPORT_ERROR);
-
-		pd->parameter.luma_spatial		= 0;
-		pd->parameter.luma_temporal		= 0;
-		pd->parameter.chroma_spatial	= 0;
-		pd->parameter.chroma_temporal	= 0;
-
-		if(!options)
-		{
-			tc_log_error(MOD_NAME, "options not set!");
-			return(TC_IMPORT_ERROR);
-		}
-
-		if(optstr_lookup(options, "help"))
-		{
-			help_optstr();
-			return(TC_IMPORT_ERROR);
-	  	}
-
-		optstr_get(options, "luma",				"%lf",	&pd->parameter.luma_spatial);
-		optstr_get(options, "luma_strength",	"%lf",	&pd->parameter.luma_temporal);
-		optstr_get(options, "chroma",			"%lf",	&pd->parameter.chroma_spatial);
-		optstr_get(options, "chroma_strength",	"%lf",	&pd->parameter.chroma_temporal);
-		optstr_get(options, "pre",				"%d",	&dn3d_private_data[instance].prefilter);
-
-		if((pd->parameter.luma_spatial < 0) || (pd->parameter.luma_temporal < 0))
-			pd->enable_luma = 0;
-		else
-		{
-			pd->enable_luma = 1;
-
-			if(pd->parameter.luma_spatial == 0)
-			{
-				if(pd->parameter.luma_temporal == 0)
-				{
-					pd->parameter.luma_spatial	= DEFAULT_LUMA_SPATIAL;
-					pd->parameter.luma_temporal	= DEFAULT_LUMA_TEMPORAL;
-				}
-				else
-				{
-					pd->parameter.luma_spatial = pd->parameter.luma_temporal * 3 / 2;
-				}
-			}
-			else
-			{
-				if(pd->parameter.luma_temporal == 0)
-				{
-					pd->parameter.luma_temporal = pd->parameter.luma_spatial * 2 / 3;
-				}
-			}
-		}
-
-		if((pd->parameter.chroma_spatial < 0) || (pd->parameter.chroma_temporal < 0))
-			pd->enable_chroma = 0;
-		else
-		{
-			pd->enable_chroma = 1;
-
-			if(pd->parameter.chroma_spatial == 0)
-			{
-				if(pd->parameter.chroma_temporal == 0)
-				{
-					pd->parameter.chroma_spatial	= DEFAULT_CHROMA_SPATIAL;
-					pd->parameter.chroma_temporal	= DEFAULT_CHROMA_TEMPORAL;
-				}
-				else
-				{
-					pd->parameter.chroma_spatial = pd->parameter.chroma_temporal * 3 / 2;
-				}
-			}
-			else
-			{
-				if(pd->parameter.chroma_temporal == 0)
-				{
-					pd->parameter.chroma_temporal = pd->parameter.chroma_spatial * 2 / 3;
-				}
-			}
-		}
-
-		for(format_index = 0, found = 0; format_index < (sizeof(dn3d_layout) / sizeof(*dn3d_layout)); format_index++)
-		{
-			if(pd->vob->im_v_codec == dn3d_layout[format_index].tc_fmt)
-			{
-				found = 1;
-				break;
-			}
-		}
-
-		if(!found)
-		{
-			tc_log_error(MOD_NAME, "This filter is only capable of YUV, YUV422 and RGB mode");
-	  		return(TC_IMPORT_ERROR);
-		}
-
-		lp = &dn3d_layout[format_index];
-		pd->layout_data = *lp;
-
-		for(plane_index = 0; plane_index < MAX_PLANES; plane_index++)
-		{
-			if((pd->layout_data.layout[plane_index].plane_type == dn3d_luma) && !pd->enable_luma)
-				pd->layout_data.layout[plane_index].plane_type = dn3d_disabled;
-
-			if((pd->layout_data.layout[plane_index].plane_type == dn3d_chroma) && !pd->enable_chroma)
-				pd->layout_data.layout[plane_index].plane_type = dn3d_disabled;
-		}
-
-		size = pd->vob->im_v_width * MAX_PLANES * sizeof(char) * 2;
-
-		pd->lineant = tc_zalloc(size);
-		if(pd->lineant == NULL)
-			tc_log_error(MOD_NAME, "Malloc failed");
-
-		size *= pd->vob->im_v_height * 2;
-
-		pd->previous = tc_zalloc(size);
-		if(pd->previous == NULL)
-			tc_log_error(MOD_NAME, "Malloc failed");
-
-		PrecalcCoefs(pd->coefficients[0], pd->parameter.luma_spatial);
-		PrecalcCoefs(pd->coefficients[1], pd->parameter.luma_temporal);
-		PrecalcCoefs(pd->coefficients[2], pd->parameter.chroma_spatial);
-		PrecalcCoefs(pd->coefficients[3], pd->parameter.chroma_temporal);
-
-		if(verbose)
-		{
-			tc_log_info(MOD_NAME, "%s %s #%d", MOD_VERSION, MOD_CAP, instance);
-			tc_log_info(MOD_NAME, "Settings luma (spatial): %.2f "
-                                  "luma_strength (temporal): %.2f "
-                                  "chroma (spatial): %.2f "
-                                  "chroma_strength (temporal): %.2f",
-				        pd->parameter.luma_spatial,
-        				pd->parameter.luma_temporal,
-		        		pd->parameter.chroma_spatial,
-				        pd->parameter.chroma_temporal);
-			tc_log_info(MOD_NAME, "luma enabled: %s, chroma enabled: %s",
-		                pd->enable_luma ? "yes" : "no",
-                        pd->enable_chroma ? "yes" : "no");
-		}
-	}
+static int denoise3d_stop(TCModuleInstance *self)
+{
+    dn3d_private_data_t *pd = NULL;
 
-	if(((tag & TC_PRE_M_PROCESS  && pd->prefilter) || (tag & TC_POST_M_PROCESS && !pd->prefilter)) &&
-		!(vframe->attributes & TC_FRAME_IS_SKIPPED))
-	{
-		int plane_index, coef[2];
-		int offset = 0;
-		const dn3d_single_layout_t * lp;
-
-		for(plane_index = 0; plane_index < MAX_PLANES; plane_index++)
-		{
-			lp = &pd->layout_data.layout[plane_index];
-
-			if(lp->plane_type != dn3d_disabled)
-			{
-				// if(plane_index != 2) // debug
-				//	continue;
-
-				coef[0] = (lp->plane_type == dn3d_luma) ? 0 : 2;
-				coef[1] = coef[0] + 1;
-
-				switch(lp->offset)
-				{
-					case(dn3d_off_r):		offset = 0; break;
-					case(dn3d_off_g):		offset = 1; break;
-					case(dn3d_off_b):		offset = 2; break;
-
-					case(dn3d_off_y420):	offset = vframe->v_width * vframe->v_height * 0 / 4; break;
-					case(dn3d_off_u420):	offset = vframe->v_width * vframe->v_height * 4 / 4; break;
-					case(dn3d_off_v420):	offset = vframe->v_width * vframe->v_height * 5 / 4; break;
-
-					case(dn3d_off_y422):	offset = vframe->v_width * vframe->v_height * 0 / 2; break;
-					case(dn3d_off_u422):	offset = vframe->v_width * vframe->v_height * 2 / 2; break;
-					case(dn3d_off_v422):	offset = vframe->v_width * vframe->v_height * 3 / 2; break;
-
-				}
-
-				deNoise(vframe->video_buf,			// frame
-					pd->previous,					// previous (saved) frame
-					pd->lineant,					// line buffer
-					vframe->v_width / lp->scale_x,	// width (pixels)
-					vframe->v_height / lp->scale_y,	// height (pixels) // debug
-					pd->coefficients[coef[0]],		// horizontal (spatial) strength
-					pd->coefficients[coef[0]],		// vertical (spatial) strength
-					pd->coefficients[coef[1]],		// temporal strength
-					offset,							// offset in bytes of first relevant pixel in frame
-					lp->skip						// skip this amount of bytes between two pixels
-				);
-			}
-		}
-	}
+    TC_MODULE_SELF_CHECK(self, "stop");
 
-	if(tag & TC_FILTER_CLOSE)
-	{
-		if(pd->previous)
-		{
-			free(pd->previous);
-			pd->previous = 0;
-		}
-
-		if(pd->lineant)
-		{
-			free(pd->lineant);
-			pd->lineant = 0;
-		}
-	}
+    pd = self->userdata;
+
+    tc_free(pd->previous);
+    pd->previous = NULL;
+    tc_free(pd->lineant);
+    pd->lineant = NULL;
+    return TC_OK;
+}
+
+/*************************************************************************/
+
+/* fill in the defaults for a strength pair; returns 0 if disabled */
+static int denoise3d_strengths(double *spatial, double *temporal,
+                               double def_spatial, double def_temporal)
+{
+    if (*spatial < 0 || *temporal < 0) {
+        return 0;
+    }
+    if (*spatial == 0) {
+        if (*temporal == 0) {
+            *spatial  = def_spatial;
+            *temporal = def_temporal;
+        } else {
+            *spatial = *temporal * 3 / 2;
+        }
+    } else if (*temporal == 0) {
+        *temporal = *spatial * 2 / 3;
+    }
+    return 1;
+}
+
+/**
+ * denoise3d_configure:  Configure this instance of the module.  See
+ * tcmodule-data.h for function details.
+ */
+
+static int denoise3d_configure(TCModuleInstance *self,
+                               const char *options, vob_t *vob)
+{
+    dn3d_private_data_t *pd = NULL;
+    int format_index, plane_index, found;
+    size_t size;
+
+    TC_MODULE_SELF_CHECK(self, "configure");
+    TC_MODULE_SELF_CHECK(vob, "configure");
+
+    pd = self->userdata;
+    pd->vob = vob;
+
+    pd->parameter.luma_spatial    = 0;
+    pd->parameter.luma_temporal   = 0;
+    pd->parameter.chroma_spatial  = 0;
+    pd->parameter.chroma_temporal = 0;
+
+    if (!options) {
+        tc_log_error(MOD_NAME, "options not set!");
+        return TC_ERROR;
+    }
+    if (optstr_lookup(options, "help")) {
+        help_optstr();
+        return TC_ERROR;
+    }
+
+    optstr_get(options, "luma",            "%lf", &pd->parameter.luma_spatial);
+    optstr_get(options, "luma_strength",   "%lf", &pd->parameter.luma_temporal);
+    optstr_get(options, "chroma",          "%lf", &pd->parameter.chroma_spatial);
+    optstr_get(options, "chroma_strength", "%lf", &pd->parameter.chroma_temporal);
+    optstr_get(options, "pre",             "%d",  &pd->prefilter);
+
+    pd->enable_luma = denoise3d_strengths(&pd->parameter.luma_spatial,
+                                          &pd->parameter.luma_temporal,
+                                          DEFAULT_LUMA_SPATIAL,
+                                          DEFAULT_LUMA_TEMPORAL);
+    pd->enable_chroma = denoise3d_strengths(&pd->parameter.chroma_spatial,
+                                            &pd->parameter.chroma_temporal,
+                                            DEFAULT_CHROMA_SPATIAL,
+                                            DEFAULT_CHROMA_TEMPORAL);
+
+    for (format_index = 0, found = 0;
+         format_index < (sizeof(dn3d_layout) / sizeof(*dn3d_layout));
+         format_index++) {
+        if (vob->im_v_codec == dn3d_layout[format_index].tc_fmt) {
+            found = 1;
+            break;
+        }
+    }
+    if (!found) {
+        tc_log_error(MOD_NAME, "This filter is only capable of YUV, YUV422 and RGB mode");
+        return TC_ERROR;
+    }
+
+    pd->layout_data = dn3d_layout[format_index];
+
+    for (plane_index = 0; plane_index < MAX_PLANES; plane_index++) {
+        dn3d_single_layout_t *lp = &pd->layout_data.layout[plane_index];
+
+        if ((lp->plane_type == dn3d_luma && !pd->enable_luma)
+         || (lp->plane_type == dn3d_chroma && !pd->enable_chroma)) {
+            lp->plane_type = dn3d_disabled;
+        }
+    }
+
+    denoise3d_stop(self);
+
+    size = vob->im_v_width * MAX_PLANES * sizeof(char) * 2;
+    pd->lineant = tc_zalloc(size);
+    size *= vob->im_v_height * 2;
+    pd->previous = tc_zalloc(size);
+    if (pd->lineant == NULL || pd->previous == NULL) {
+        tc_log_error(MOD_NAME, "Malloc failed");
+        return TC_ERROR;
+    }
+
+    PrecalcCoefs(pd->coefficients[0], pd->parameter.luma_spatial);
+    PrecalcCoefs(pd->coefficients[1], pd->parameter.luma_temporal);
+    PrecalcCoefs(pd->coefficients[2], pd->parameter.chroma_spatial);
+    PrecalcCoefs(pd->coefficients[3], pd->parameter.chroma_temporal);
+
+    if (verbose) {
+        tc_log_info(MOD_NAME, "Settings luma (spatial): %.2f "
+                              "luma_strength (temporal): %.2f "
+                              "chroma (spatial): %.2f "
+                              "chroma_strength (temporal): %.2f",
+                    pd->parameter.luma_spatial,
+                    pd->parameter.luma_temporal,
+                    pd->parameter.chroma_spatial,
+                    pd->parameter.chroma_temporal);
+        tc_log_info(MOD_NAME, "luma enabled: %s, chroma enabled: %s",
+                    pd->enable_luma ? "yes" : "no",
+                    pd->enable_chroma ? "yes" : "no");
+    }
+    return TC_OK;
+}
+
+/*************************************************************************/
+
+/**
+ * denoise3d_inspect:  Return the value of an option in this instance of
+ * the module.  See tcmodule-data.h for function details.
+ */
+
+static int denoise3d_inspect(TCModuleInstance *self,
+                             const char *param, const char **value)
+{
+    dn3d_private_data_t *pd = NULL;
 
-	return(0);
+    TC_MODULE_SELF_CHECK(self, "inspect");
+    TC_MODULE_SELF_CHECK(param, "inspect");
+    TC_MODULE_SELF_CHECK(value, "inspect");
+
+    pd = self->userdata;
+
+    if (optstr_lookup(param, "help")) {
+        *value = denoise3d_help;
+    }
+    if (optstr_lookup(param, "luma")) {
+        tc_snprintf(pd->conf_str, sizeof(pd->conf_str),
+                    "luma=%f", pd->parameter.luma_spatial);
+        *value = pd->conf_str;
+    }
+    if (optstr_lookup(param, "chroma")) {
+        tc_snprintf(pd->conf_str, sizeof(pd->conf_str),
+                    "chroma=%f", pd->parameter.chroma_spatial);
+        *value = pd->conf_str;
+    }
+    if (optstr_lookup(param, "luma_strength")) {
+        tc_snprintf(pd->conf_str, sizeof(pd->conf_str),
+                    "luma_strength=%f", pd->parameter.luma_temporal);
+        *value = pd->conf_str;
+    }
+    if (optstr_lookup(param, "chroma_strength")) {
+        tc_snprintf(pd->conf_str, sizeof(pd->conf_str),
+                    "chroma_strength=%f", pd->parameter.chroma_temporal);
+        *value = pd->conf_str;
+    }
+    if (optstr_lookup(param, "pre")) {
+        tc_snprintf(pd->conf_str, sizeof(pd->conf_str),
+                    "pre=%i", pd->prefilter);
+        *value = pd->conf_str;
+    }
+    return TC_OK;
+}
+
+/*************************************************************************/
+
+/**
+ * denoise3d_filter_video:  denoise every enabled plane of the frame
+ * against the saved previous frame.  See tcmodule-data.h for function
+ * details.
+ */
+
+static int denoise3d_filter_video(TCModuleInstance *self,
+                                  vframe_list_t *vframe)
+{
+    dn3d_private_data_t *pd = NULL;
+    const dn3d_single_layout_t *lp = NULL;
+    int plane_index, coef[2];
+    int offset = 0;
+
+    TC_MODULE_SELF_CHECK(self, "filter");
+    TC_MODULE_SELF_CHECK(vframe, "filter");
+
+    pd = self->userdata;
+
+    for (plane_index = 0; plane_index < MAX_PLANES; plane_index++) {
+        lp = &pd->layout_data.layout[plane_index];
+
+        if (lp->plane_type == dn3d_disabled)
+            continue;
+
+        coef[0] = (lp->plane_type == dn3d_luma) ? 0 : 2;
+        coef[1] = coef[0] + 1;
+
+        switch (lp->offset) {
+          case dn3d_off_r:    offset = 0; break;
+          case dn3d_off_g:    offset = 1; break;
+          case dn3d_off_b:    offset = 2; break;
+
+          case dn3d_off_y420: offset = vframe->v_width * vframe->v_height * 0 / 4; break;
+          case dn3d_off_u420: offset = vframe->v_width * vframe->v_height * 4 / 4; break;
+          case dn3d_off_v420: offset = vframe->v_width * vframe->v_height * 5 / 4; break;
+
+          case dn3d_off_y422: offset = vframe->v_width * vframe->v_height * 0 / 2; break;
+          case dn3d_off_u422: offset = vframe->v_width * vframe->v_height * 2 / 2; break;
+          case dn3d_off_v422: offset = vframe->v_width * vframe->v_height * 3 / 2; break;
+        }
+
+        deNoise(vframe->video_buf,              // frame
+                pd->previous,                   // previous (saved) frame
+                pd->lineant,                    // line buffer
+                vframe->v_width / lp->scale_x,  // width (pixels)
+                vframe->v_height / lp->scale_y, // height (pixels)
+                pd->coefficients[coef[0]],      // horizontal (spatial) strength
+                pd->coefficients[coef[0]],      // vertical (spatial) strength
+                pd->coefficients[coef[1]],      // temporal strength
+                offset,                         // offset in bytes of first relevant pixel in frame
+                lp->skip);                      // skip this amount of bytes between two pixels
+    }
+    return TC_OK;
+}
+
+/*************************************************************************/
+
+static const TCCodecID denoise3d_codecs_in[] = {
+    TC_CODEC_YUV420P, TC_CODEC_YUV422P, TC_CODEC_RGB, TC_CODEC_ERROR
+};
+static const TCCodecID denoise3d_codecs_out[] = {
+    TC_CODEC_YUV420P, TC_CODEC_YUV422P, TC_CODEC_RGB, TC_CODEC_ERROR
+};
+TC_MODULE_FILTER_FORMATS(denoise3d);
+
+TC_MODULE_INFO(denoise3d);
+
+static const TCModuleClass denoise3d_class = {
+    TC_MODULE_CLASS_HEAD(denoise3d),
+
+    .init         = denoise3d_init,
+    .fini         = denoise3d_fini,
+    .configure    = denoise3d_configure,
+    .stop         = denoise3d_stop,
+    .inspect      = denoise3d_inspect,
+
+    .filter_video = denoise3d_filter_video,
+};
+
+TC_MODULE_ENTRY_POINT(denoise3d)
+
+/*************************************************************************/
+
+static int denoise3d_get_config(TCModuleInstance *self, char *options)
+{
+    dn3d_private_data_t *pd = NULL;
+    char buf[128];
+
+    TC_MODULE_SELF_CHECK(self, "get_config");
+
+    pd = self->userdata;
+
+    optstr_filter_desc(options, MOD_NAME, MOD_CAP, MOD_VERSION,
+                       MOD_AUTHOR, "VYMOE", "2");
+
+    tc_snprintf(buf, sizeof(buf), "%f", DEFAULT_LUMA_SPATIAL);
+    optstr_param(options, "luma", "spatial luma strength",
+                 "%f", buf, "0.0", "100.0");
+
+    tc_snprintf(buf, sizeof(buf), "%f", DEFAULT_CHROMA_SPATIAL);
+    optstr_param(options, "chroma", "spatial chroma strength",
+                 "%f", buf, "0.0", "100.0");
+
+    tc_snprintf(buf, sizeof(buf), "%f", DEFAULT_LUMA_TEMPORAL);
+    optstr_param(options, "luma_strength", "temporal luma strength",
+                 "%f", buf, "0.0", "100.0");
+
+    tc_snprintf(buf, sizeof(buf), "%f", DEFAULT_CHROMA_TEMPORAL);
+    optstr_param(options, "chroma_strength", "temporal chroma strength",
+                 "%f", buf, "0.0", "100.0");
+
+    tc_snprintf(buf, sizeof(buf), "%d", (pd) ?pd->prefilter :0);
+    optstr_param(options, "pre", "run as a pre filter",
+                 "%d", buf, "0", "1");
+
+    return TC_OK;
 }
+
+static int denoise3d_process(TCModuleInstance *self, frame_list_t *frame)
+{
+    dn3d_private_data_t *pd = NULL;
+
+    TC_MODULE_SELF_CHECK(self, "process");
+
+    pd = self->userdata;
+
+    if ((frame->tag & TC_VIDEO) && !(frame->attributes & TC_FRAME_IS_SKIPPED)
+       && (((frame->tag & TC_POST_M_PROCESS) && !pd->prefilter)
+         || ((frame->tag & TC_PRE_M_PROCESS) && pd->prefilter))) {
+        return denoise3d_filter_video(self, (vframe_list_t*)frame);
+    }
+    return TC_OK;
+}
+
+/*************************************************************************/
+
+/* Old-fashioned module interface. */
+
+TC_FILTER_OLDINTERFACE_M(denoise3d)
+
+/*************************************************************************/
+
+/*
+ * Local variables:
+ *   c-file-style: "stroustrup"
+ *   c-file-offsets: ((case-label . *) (statement-case-intro . *))
+ *   indent-tabs-mode: nil
+ * End:
+ *
+ * vim: expandtab shiftwidth=4:
+ */
@@ -171,6 +171,7 @@ static int filter_fields_get_config(char *options) {
 }
 
 static int filter_fields_init(char *options) {
+  const TCFrameSpecs *specs = NULL;
   int help_shown = 0;
 
   vob = tc_get_vob();
@@ -178,16 +179,17 @@ static int filter_fields_init(char *options) {
 
   if (verbose) tc_log_info(MOD_NAME, "%s %s", MOD_VERSION, MOD_CAP);
 
-  buffer = tc_malloc(SIZE_RGB_FRAME);
+  // Frames are at most as large as the core framebuffers.  Some of the data
+  // in buffer may get used for half of the first frame (when shifting) so
+  // make sure it's blank to start with.
+  specs = tc_framebuffer_get_specs();
+  buffer = tc_zalloc(tc_video_frame_size(specs->width, specs->height,
+                                         specs->format));
   if (!buffer) {
     tc_log_error(MOD_NAME, "Unable to allocate memory.  Aborting.");
     return -1;
   }
 
-  // Some of the data in buffer may get used for half of the first frame (when
-  // shifting) so make sure it's blank to start with.
-  memset(buffer, 0, SIZE_RGB_FRAME);
-
   if(options != NULL) {
     if (optstr_lookup (options, "flip") != NULL)
       field_ops |= FIELD_OP_FLIP;
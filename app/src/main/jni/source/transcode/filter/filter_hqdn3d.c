@@ -18,14 +18,21 @@
 */
 
 #define MOD_NAME    "filter_hqdn3d.so"
-#define MOD_VERSION "v1.0.2 (2003-08-15)"
+#define MOD_VERSION "v1.1.0 (2026-10-17)"
 #define MOD_CAP     "High Quality 3D Denoiser"
 #define MOD_AUTHOR  "Daniel Moreno, A'rpi"
 
+#define MOD_FEATURES \
+    TC_MODULE_FEATURE_FILTER|TC_MODULE_FEATURE_VIDEO
+/* temporal filter: frames one at a time, in order */
+#define MOD_FLAGS \
+    TC_MODULE_FLAG_RECONFIGURABLE
+
 #include "transcode.h"
 #include "filter.h"
 #include "libtc/libtc.h"
 #include "libtc/optstr.h"
+#include "libtc/tcmodule-plugin.h"
 
 #include <math.h>
 
@@ -40,6 +47,11 @@ typedef struct vf_priv_s {
         unsigned int *Line;
 	unsigned short *Frame[3];
 	int pre;
+	int width, height;
+
+	uint8_t *buffer;
+	double luma, chroma, luma_strength, chroma_strength;
+	char conf_str[TC_BUF_MIN];
 } MyFilterData;
 
 
@@ -131,203 +143,378 @@ static void PrecalcCoefs(int *Ct, double Dist25)
     }
 }
 
+static const char hqdn3d_help[] = ""
+    "Overview:\n"
+    "    This filter aims to reduce image noise producing\n"
+    "    smooth images and making still images really still\n"
+    "    (This should enhance compressibility).\n"
+    "Options:\n"
+    "    luma             spatial luma strength (%f)\n"
+    "    chroma           spatial chroma strength (%f)\n"
+    "    luma_strength    temporal luma strength (%f)\n"
+    "    chroma_strength  temporal chroma strength (%f)\n"
+    "    pre              run as a pre filter (0)\n"
+    "    help             print this help message\n";
+
 static void help_optstr(void)
 {
-    tc_log_info(MOD_NAME, "(%s) help\n"
-"* Overview\n"
-"  This filter aims to reduce image noise producing\n"
-"  smooth images and making still images really still\n"
-"  (This should enhance compressibility).\n"
-"* Options\n"
-"             luma : spatial luma strength (%f)\n"
-"           chroma : spatial chroma strength (%f)\n"
-"    luma_strength : temporal luma strength (%f)\n"
-"  chroma_strength : temporal chroma strength (%f)\n"
-"              pre : run as a pre filter (0)\n"
-		, MOD_CAP,
-		PARAM1_DEFAULT,
-		PARAM2_DEFAULT,
-		PARAM3_DEFAULT,
-		PARAM3_DEFAULT*PARAM2_DEFAULT/PARAM1_DEFAULT);
+    tc_log_info(MOD_NAME, "(%s) help", MOD_CAP);
+    tc_log_info(MOD_NAME, hqdn3d_help,
+                PARAM1_DEFAULT,
+                PARAM2_DEFAULT,
+                PARAM3_DEFAULT,
+                PARAM3_DEFAULT*PARAM2_DEFAULT/PARAM1_DEFAULT);
+}
+
+/*************************************************************************/
+
+/* Module interface routines and data. */
+
+/*************************************************************************/
+
+/**
+ * hqdn3d_init:  Initialize this instance of the module.  See
+ * tcmodule-data.h for function details.
+ */
+
+static int hqdn3d_init(TCModuleInstance *self, uint32_t features)
+{
+    MyFilterData *pd = NULL;
+
+    TC_MODULE_SELF_CHECK(self, "init");
+    TC_MODULE_INIT_CHECK(self, MOD_FEATURES, features);
+
+    pd = tc_zalloc(sizeof(MyFilterData));
+    if (pd == NULL) {
+        tc_log_error(MOD_NAME, "init: out of memory!");
+        return TC_ERROR;
+    }
+    self->userdata = pd;
+
+    if (verbose) {
+        tc_log_info(MOD_NAME, "%s %s #%d", MOD_VERSION, MOD_CAP, self->id);
+    }
+    return TC_OK;
+}
+
+/*************************************************************************/
+
+/**
+ * hqdn3d_fini:  Clean up after this instance of the module.  See
+ * tcmodule-data.h for function details.
+ */
+
+TC_MODULE_GENERIC_FINI(hqdn3d)
+
+/*************************************************************************/
+
+/**
+ * hqdn3d_stop:  Reset this instance of the module, dropping the
+ * temporal state.  See tcmodule-data.h for function details.
+ */
+
+static int hqdn3d_stop(TCModuleInstance *self)
+{
+    MyFilterData *pd = NULL;
+    int i = 0;
+
+    TC_MODULE_SELF_CHECK(self, "stop");
+
+    pd = self->userdata;
+
+    tc_free(pd->buffer);
+    pd->buffer = NULL;
+    tc_free(pd->Line);
+    pd->Line = NULL;
+    for (i = 0; i < 3; i++) {
+        tc_free(pd->Frame[i]);
+        pd->Frame[i] = NULL;
+    }
+    return TC_OK;
 }
 
-// main filter routine
-int tc_filter(frame_list_t *ptr_, char *options)
+/*************************************************************************/
+
+/**
+ * hqdn3d_configure:  Configure this instance of the module.  See
+ * tcmodule-data.h for function details.
+ */
+
+static int hqdn3d_configure(TCModuleInstance *self,
+                            const char *options, vob_t *vob)
 {
-  vframe_list_t *ptr = (vframe_list_t *)ptr_;
-  static vob_t *vob=NULL;
-  /* FIXME: these use the filter ID as an index--the ID can grow
-   * arbitrarily large, so this needs to be fixed */
-  static MyFilterData *mfd[100];
-  static char *buffer[100];
-  int instance = ptr->filter_id;
+    MyFilterData *pd = NULL;
+    double LumSpac, LumTmp, ChromSpac, ChromTmp;
+    double Param1 = 0.0, Param2 = 0.0, Param3 = 0.0, Param4 = 0.0;
+
+    TC_MODULE_SELF_CHECK(self, "configure");
+    TC_MODULE_SELF_CHECK(vob, "configure");
 
+    pd = self->userdata;
 
-  if(ptr->tag & TC_AUDIO)
-      return 0;
+    if (vob->im_v_codec == CODEC_RGB) {
+        tc_log_error(MOD_NAME, "This filter is only capable of YUV mode");
+        return TC_ERROR;
+    }
 
-  if(ptr->tag & TC_FILTER_GET_CONFIG) {
+    hqdn3d_stop(self);
 
-      char buf[128];
-      optstr_filter_desc (options, MOD_NAME, MOD_CAP, MOD_VERSION, MOD_AUTHOR, "VYMOE", "2");
+    // defaults
 
-      tc_snprintf(buf, 128, "%f", PARAM1_DEFAULT);
-      optstr_param (options, "luma", "spatial luma strength", "%f", buf, "0.0", "100.0" );
+    LumSpac = PARAM1_DEFAULT;
+    LumTmp = PARAM3_DEFAULT;
 
-      tc_snprintf(buf, 128, "%f", PARAM2_DEFAULT);
-      optstr_param (options, "chroma", "spatial chroma strength", "%f", buf, "0.0", "100.0" );
+    ChromSpac = PARAM2_DEFAULT;
+    ChromTmp = LumTmp * ChromSpac / LumSpac;
 
-      tc_snprintf(buf, 128, "%f", PARAM3_DEFAULT);
-      optstr_param (options, "luma_strength", "temporal luma strength", "%f", buf, "0.0", "100.0" );
+    pd->pre = 0;
 
-      tc_snprintf(buf, 128, "%f", PARAM3_DEFAULT*PARAM2_DEFAULT/PARAM1_DEFAULT);
-      optstr_param (options, "chroma_strength", "temporal chroma strength", "%f", buf, "0.0", "100.0" );
-      tc_snprintf(buf, 128, "%d", mfd[instance]->pre);
-      optstr_param (options, "pre", "run as a pre filter", "%d", buf, "0", "1" );
+    if (options) {
+        if (optstr_lookup(options, "help")) {
+            help_optstr();
+        }
 
-      return 0;
-  }
+        optstr_get(options, "luma",            "%lf", &Param1);
+        optstr_get(options, "luma_strength",   "%lf", &Param3);
+        optstr_get(options, "chroma",          "%lf", &Param2);
+        optstr_get(options, "chroma_strength", "%lf", &Param4);
+        optstr_get(options, "pre",             "%d",  &pd->pre);
 
-  if(ptr->tag & TC_FILTER_INIT) {
+        // recalculate only the needed params
 
-      double LumSpac, LumTmp, ChromSpac, ChromTmp;
-      double Param1=0.0, Param2=0.0, Param3=0.0, Param4=0.0;
+        if (Param1 != 0.0) {
+            LumSpac = Param1;
+            LumTmp = PARAM3_DEFAULT * Param1 / PARAM1_DEFAULT;
 
-      if((vob = tc_get_vob())==NULL) return(-1);
+            ChromSpac = PARAM2_DEFAULT * Param1 / PARAM1_DEFAULT;
+            ChromTmp = LumTmp * ChromSpac / LumSpac;
+        }
+        if (Param2 != 0.0) {
+            ChromSpac = Param2;
+            ChromTmp = LumTmp * ChromSpac / LumSpac;
+        }
+        if (Param3 != 0.0) {
+            LumTmp = Param3;
+            ChromTmp = LumTmp * ChromSpac / LumSpac;
+        }
+        if (Param4 != 0.0) {
+            ChromTmp = Param4;
+        }
+    }
 
-      if (vob->im_v_codec == CODEC_RGB) {
-	  tc_log_error(MOD_NAME, "This filter is only capable of YUV mode");
-	  return -1;
-      }
+    pd->width  = (pd->pre) ?vob->im_v_width  :vob->ex_v_width;
+    pd->height = (pd->pre) ?vob->im_v_height :vob->ex_v_height;
+    pd->Line = tc_zalloc(pd->width * sizeof(int));
+    pd->buffer = tc_zalloc(tc_video_frame_size(pd->width, pd->height,
+                                               TC_CODEC_YUV420P));
+    if (!pd->Line || !pd->buffer) {
+        tc_log_error(MOD_NAME, "Malloc failed");
+        return TC_ERROR;
+    }
 
-      mfd[instance] = tc_zalloc(sizeof(MyFilterData));
+    PrecalcCoefs(pd->Coefs[0], LumSpac);
+    PrecalcCoefs(pd->Coefs[1], LumTmp);
+    PrecalcCoefs(pd->Coefs[2], ChromSpac);
+    PrecalcCoefs(pd->Coefs[3], ChromTmp);
 
-      if (mfd[instance]) {
-	  mfd[instance]->Line = tc_zalloc(TC_MAX_V_FRAME_WIDTH*sizeof(int));
-      }
+    pd->luma            = LumSpac;
+    pd->chroma          = ChromSpac;
+    pd->luma_strength   = LumTmp;
+    pd->chroma_strength = ChromTmp;
 
-      buffer[instance] = tc_zalloc(SIZE_RGB_FRAME);
+    if (verbose) {
+        tc_log_info(MOD_NAME, "Settings luma=%.2f chroma=%.2f"
+                              " luma_strength=%.2f chroma_strength=%.2f",
+                    LumSpac, ChromSpac, LumTmp, ChromTmp);
+    }
+    return TC_OK;
+}
 
-      if (!mfd[instance] || !mfd[instance]->Line || !buffer[instance]) {
-	  tc_log_error(MOD_NAME, "Malloc failed");
-	  return -1;
-      }
+/*************************************************************************/
 
+/**
+ * hqdn3d_inspect:  Return the value of an option in this instance of
+ * the module.  See tcmodule-data.h for function details.
+ */
 
-      // defaults
+static int hqdn3d_inspect(TCModuleInstance *self,
+                          const char *param, const char **value)
+{
+    MyFilterData *pd = NULL;
 
-      LumSpac = PARAM1_DEFAULT;
-      LumTmp = PARAM3_DEFAULT;
+    TC_MODULE_SELF_CHECK(self, "inspect");
+    TC_MODULE_SELF_CHECK(param, "inspect");
+    TC_MODULE_SELF_CHECK(value, "inspect");
 
-      ChromSpac = PARAM2_DEFAULT;
-      ChromTmp = LumTmp * ChromSpac / LumSpac;
+    pd = self->userdata;
 
-      if (options) {
+    if (optstr_lookup(param, "help")) {
+        *value = hqdn3d_help;
+    }
+    if (optstr_lookup(param, "luma")) {
+        tc_snprintf(pd->conf_str, sizeof(pd->conf_str),
+                    "luma=%f", pd->luma);
+        *value = pd->conf_str;
+    }
+    if (optstr_lookup(param, "chroma")) {
+        tc_snprintf(pd->conf_str, sizeof(pd->conf_str),
+                    "chroma=%f", pd->chroma);
+        *value = pd->conf_str;
+    }
+    if (optstr_lookup(param, "luma_strength")) {
+        tc_snprintf(pd->conf_str, sizeof(pd->conf_str),
+                    "luma_strength=%f", pd->luma_strength);
+        *value = pd->conf_str;
+    }
+    if (optstr_lookup(param, "chroma_strength")) {
+        tc_snprintf(pd->conf_str, sizeof(pd->conf_str),
+                    "chroma_strength=%f", pd->chroma_strength);
+        *value = pd->conf_str;
+    }
+    if (optstr_lookup(param, "pre")) {
+        tc_snprintf(pd->conf_str, sizeof(pd->conf_str),
+                    "pre=%i", pd->pre);
+        *value = pd->conf_str;
+    }
+    return TC_OK;
+}
 
-	  if (optstr_lookup (options, "help")) {
-	      help_optstr();
-	  }
+/*************************************************************************/
 
-	  optstr_get (options, "luma",           "%lf",    &Param1);
-	  optstr_get (options, "luma_strength",  "%lf",    &Param3);
-	  optstr_get (options, "chroma",         "%lf",    &Param2);
-	  optstr_get (options, "chroma_strength","%lf",    &Param4);
-	  optstr_get (options, "pre", "%d",    &mfd[instance]->pre);
+/**
+ * hqdn3d_filter_video:  denoise each plane of the frame against the
+ * previous ones.  See tcmodule-data.h for function details.
+ */
 
-	  // recalculate only the needed params
+static int hqdn3d_filter_video(TCModuleInstance *self,
+                               vframe_list_t *frame)
+{
+    MyFilterData *pd = NULL;
+    int w = 0, h = 0;
+
+    TC_MODULE_SELF_CHECK(self, "filter");
+    TC_MODULE_SELF_CHECK(frame, "filter");
+
+    pd = self->userdata;
+    w = frame->v_width;
+    h = frame->v_height;
+    if (w > pd->width || h > pd->height) {
+        tc_log_error(MOD_NAME, "frame larger than configured (%ix%i > %ix%i)",
+                     w, h, pd->width, pd->height);
+        return TC_ERROR;
+    }
 
-	  if (Param1!=0.0) {
+    ac_memcpy(pd->buffer, frame->video_buf, w*h + 2*(w>>1)*(h>>1));
 
-	      LumSpac = Param1;
-	      LumTmp = PARAM3_DEFAULT * Param1 / PARAM1_DEFAULT;
+    deNoise(pd->buffer, frame->video_buf,
+            pd->Line, &pd->Frame[0], w, h, w, w,
+            pd->Coefs[0], pd->Coefs[0], pd->Coefs[1]);
 
-	      ChromSpac = PARAM2_DEFAULT * Param1 / PARAM1_DEFAULT;
-	      ChromTmp = LumTmp * ChromSpac / LumSpac;
-	  }
-	  if (Param2!=0.0) {
+    deNoise(pd->buffer + w*h, frame->video_buf + w*h,
+            pd->Line, &pd->Frame[1], w>>1, h>>1, w>>1, w>>1,
+            pd->Coefs[2], pd->Coefs[2], pd->Coefs[3]);
 
-	      ChromSpac = Param2;
-	      ChromTmp = LumTmp * ChromSpac / LumSpac;
-	  }
-	  if (Param3!=0.0) {
+    deNoise(pd->buffer + 5*w*h/4, frame->video_buf + 5*w*h/4,
+            pd->Line, &pd->Frame[2], w>>1, h>>1, w>>1, w>>1,
+            pd->Coefs[2], pd->Coefs[2], pd->Coefs[3]);
 
-	      LumTmp = Param3;
-	      ChromTmp = LumTmp * ChromSpac / LumSpac;
+    return TC_OK;
+}
 
-	  }
-	  if (Param4!=0.0) {
+/*************************************************************************/
 
-	      ChromTmp = Param4;
-	  }
+static const TCCodecID hqdn3d_codecs_in[] = {
+    TC_CODEC_YUV420P, TC_CODEC_ERROR
+};
+static const TCCodecID hqdn3d_codecs_out[] = {
+    TC_CODEC_YUV420P, TC_CODEC_ERROR
+};
+TC_MODULE_FILTER_FORMATS(hqdn3d);
 
-      }
+TC_MODULE_INFO(hqdn3d);
 
-      PrecalcCoefs(mfd[instance]->Coefs[0], LumSpac);
-      PrecalcCoefs(mfd[instance]->Coefs[1], LumTmp);
-      PrecalcCoefs(mfd[instance]->Coefs[2], ChromSpac);
-      PrecalcCoefs(mfd[instance]->Coefs[3], ChromTmp);
+static const TCModuleClass hqdn3d_class = {
+    TC_MODULE_CLASS_HEAD(hqdn3d),
 
+    .init         = hqdn3d_init,
+    .fini         = hqdn3d_fini,
+    .configure    = hqdn3d_configure,
+    .stop         = hqdn3d_stop,
+    .inspect      = hqdn3d_inspect,
 
-      if(verbose) {
-	  tc_log_info(MOD_NAME, "%s %s #%d", MOD_VERSION, MOD_CAP, instance);
-	  tc_log_info(MOD_NAME, "Settings luma=%.2f chroma=%.2f luma_strength=%.2f chroma_strength=%.2f",
-		  LumSpac, ChromSpac, LumTmp, ChromTmp);
-      }
-      return 0;
-  }
+    .filter_video = hqdn3d_filter_video,
+};
 
+TC_MODULE_ENTRY_POINT(hqdn3d)
 
+/*************************************************************************/
 
-  //----------------------------------
-  //
-  // filter close
-  //
-  //----------------------------------
+static int hqdn3d_get_config(TCModuleInstance *self, char *options)
+{
+    MyFilterData *pd = NULL;
+    char buf[128];
 
+    TC_MODULE_SELF_CHECK(self, "get_config");
 
-  if(ptr->tag & TC_FILTER_CLOSE) {
+    pd = self->userdata;
 
-      if (buffer[instance]) {free(buffer[instance]); buffer[instance]=NULL;}
-      if (mfd[instance]) {
-	  if(mfd[instance]->Line){free(mfd[instance]->Line);mfd[instance]->Line=NULL;}
-	  if(mfd[instance]->Frame[0]){free(mfd[instance]->Frame[0]);mfd[instance]->Frame[0]=NULL;}
-	  if(mfd[instance]->Frame[1]){free(mfd[instance]->Frame[1]);mfd[instance]->Frame[1]=NULL;}
-	  if(mfd[instance]->Frame[2]){free(mfd[instance]->Frame[2]);mfd[instance]->Frame[2]=NULL;}
-	  free(mfd[instance]);
-      }
-      mfd[instance]=NULL;
+    optstr_filter_desc(options, MOD_NAME, MOD_CAP, MOD_VERSION,
+                       MOD_AUTHOR, "VYMOE", "2");
 
-      return(0);
+    tc_snprintf(buf, sizeof(buf), "%f", PARAM1_DEFAULT);
+    optstr_param(options, "luma", "spatial luma strength",
+                 "%f", buf, "0.0", "100.0");
 
-  } /* filter close */
+    tc_snprintf(buf, sizeof(buf), "%f", PARAM2_DEFAULT);
+    optstr_param(options, "chroma", "spatial chroma strength",
+                 "%f", buf, "0.0", "100.0");
 
-  //actually do the filter
+    tc_snprintf(buf, sizeof(buf), "%f", PARAM3_DEFAULT);
+    optstr_param(options, "luma_strength", "temporal luma strength",
+                 "%f", buf, "0.0", "100.0");
 
-  if(((ptr->tag & TC_PRE_M_PROCESS  && mfd[instance]->pre) ||
-	  (ptr->tag & TC_POST_M_PROCESS && !mfd[instance]->pre)) &&
-	  !(ptr->attributes & TC_FRAME_IS_SKIPPED)) {
+    tc_snprintf(buf, sizeof(buf), "%f",
+                PARAM3_DEFAULT*PARAM2_DEFAULT/PARAM1_DEFAULT);
+    optstr_param(options, "chroma_strength", "temporal chroma strength",
+                 "%f", buf, "0.0", "100.0");
 
-      ac_memcpy (buffer[instance], ptr->video_buf, ptr->video_size);
+    tc_snprintf(buf, sizeof(buf), "%d", (pd) ?pd->pre :0);
+    optstr_param(options, "pre", "run as a pre filter",
+                 "%d", buf, "0", "1");
 
-      deNoise(buffer[instance],                                  ptr->video_buf,
-	      mfd[instance]->Line, &mfd[instance]->Frame[0], ptr->v_width, ptr->v_height,
-	      ptr->v_width,  ptr->v_width,
-	      mfd[instance]->Coefs[0], mfd[instance]->Coefs[0], mfd[instance]->Coefs[1]);
+    return TC_OK;
+}
 
-      deNoise(buffer[instance] + ptr->v_width*ptr->v_height,     ptr->video_buf + ptr->v_width*ptr->v_height,
-	      mfd[instance]->Line, &mfd[instance]->Frame[1], ptr->v_width>>1, ptr->v_height>>1,
-	      ptr->v_width>>1,  ptr->v_width>>1,
-	      mfd[instance]->Coefs[2], mfd[instance]->Coefs[2], mfd[instance]->Coefs[3]);
+static int hqdn3d_process(TCModuleInstance *self, frame_list_t *frame)
+{
+    MyFilterData *pd = NULL;
 
-      deNoise(buffer[instance] + 5*ptr->v_width*ptr->v_height/4, ptr->video_buf + 5*ptr->v_width*ptr->v_height/4,
-	      mfd[instance]->Line, &mfd[instance]->Frame[2], ptr->v_width>>1, ptr->v_height>>1,
-	      ptr->v_width>>1,  ptr->v_width>>1,
-	      mfd[instance]->Coefs[2], mfd[instance]->Coefs[2], mfd[instance]->Coefs[3]);
+    TC_MODULE_SELF_CHECK(self, "process");
 
-  }
-  return 0;
+    pd = self->userdata;
 
+    if ((frame->tag & TC_VIDEO) && !(frame->attributes & TC_FRAME_IS_SKIPPED)
+       && (((frame->tag & TC_POST_M_PROCESS) && !pd->pre)
+         || ((frame->tag & TC_PRE_M_PROCESS) && pd->pre))) {
+        return hqdn3d_filter_video(self, (vframe_list_t*)frame);
+    }
+    return TC_OK;
 }
 
+/*************************************************************************/
 
-//===========================================================================//
+/* Old-fashioned module interface. */
+
+TC_FILTER_OLDINTERFACE_M(hqdn3d)
+
+/*************************************************************************/
+
+/*
+ * Local variables:
+ *   c-file-style: "stroustrup"
+ *   c-file-offsets: ((case-label . *) (statement-case-intro . *))
+ *   indent-tabs-mode: nil
+ * End:
+ *
+ * vim: expandtab shiftwidth=4:
+ */
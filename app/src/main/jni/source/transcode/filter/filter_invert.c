@@ -70,7 +70,7 @@ int tc_filter(frame_list_t *ptr_, char *options)
 
   if(ptr->tag & TC_FILTER_GET_CONFIG) {
       char buf[128];
-      optstr_filter_desc (options, MOD_NAME, MOD_CAP, MOD_VERSION, MOD_AUTHOR, "VRY4O", "1");
+      optstr_filter_desc (options, MOD_NAME, MOD_CAP, MOD_VERSION, MOD_AUTHOR, "VRY4OP", "1");
 
       tc_snprintf(buf, 128, "%u-%u/%d", mfd->start, mfd->end, mfd->step);
       optstr_param (options, "range", "apply filter to [start-end]/step frames",
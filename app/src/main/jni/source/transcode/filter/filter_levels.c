@@ -25,7 +25,7 @@
 #define MOD_FEATURES \
     TC_MODULE_FEATURE_FILTER|TC_MODULE_FEATURE_VIDEO
 #define MOD_FLAGS \
-    TC_MODULE_FLAG_RECONFIGURABLE
+    TC_MODULE_FLAG_RECONFIGURABLE|TC_MODULE_FLAG_STATELESS
 
 #include "transcode.h"
 #include "filter.h"
@@ -296,7 +296,7 @@ static int levels_get_config(TCModuleInstance *self, char *options)
 
     /* use optstr_param to do introspection */
     optstr_filter_desc(options, MOD_NAME, MOD_CAP, MOD_VERSION,
-                       MOD_AUTHOR, "VYMEO", "1");
+                       MOD_AUTHOR, "VYMEOP", "1");
 
     tc_snprintf(buf, sizeof(buf), "%d-%d", DEFAULT_IN_BLACK,
                 DEFAULT_IN_WHITE );
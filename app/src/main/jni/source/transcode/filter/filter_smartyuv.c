@@ -21,14 +21,21 @@
 */
 
 #define MOD_NAME    "filter_smartyuv.so"
-#define MOD_VERSION "0.1.6 (2007-05-31)"
+#define MOD_VERSION "0.2.0 (2026-10-17)"
 #define MOD_CAP     "Motion-adaptive deinterlacing"
 #define MOD_AUTHOR  "Tilmann Bitterberg"
 
+#define MOD_FEATURES \
+    TC_MODULE_FEATURE_FILTER|TC_MODULE_FEATURE_VIDEO
+/* temporal filter: compares against the previous frame */
+#define MOD_FLAGS \
+    TC_MODULE_FLAG_RECONFIGURABLE
+
 #include "transcode.h"
 #include "filter.h"
 #include "libtc/libtc.h"
 #include "libtc/optstr.h"
+#include "libtc/tcmodule-plugin.h"
 
 //#undef HAVE_ASM_MMX
 //#undef CAN_COMPILE_C_ALTIVEC
@@ -48,9 +55,6 @@
 
 #define rdtscll(val) __asm__ __volatile__("rdtsc" : "=A" (val))
 
-
-static vob_t *vob  = NULL;
-
 ///////////////////////////////////////////////////////////////////////////
 
 // this value is "hardcoded" in the optimized code for speed reasons
@@ -98,11 +102,6 @@ count: 1-256
 stride: -32000 - 320000
 */
 
-static void smartyuv_core (char *_src, char *_dst, char *_prev, int _width, int _height,
-                           int _srcpitch, int _dstpitch,
-                           unsigned char *_moving, unsigned char *_fmoving,
-                           yuv_clamp_fn clamp_f, int _threshold );
-
 typedef struct MyFilterData {
     char            *buf;
     char            *prevFrame;
@@ -123,13 +122,11 @@ typedef struct MyFilterData {
     int             Blend;
     int             doChroma;
     int             verbose;
+    int             counter;    // luma planes seen so far
+    char            conf_str[TC_BUF_MIN];
 } MyFilterData;
 
-static MyFilterData *mfd = NULL;
-
-static void help_optstr(void)
-{
-   tc_log_info (MOD_NAME, "(%s) help\n"
+static const char smartyuv_help[] = ""
 "* Overview\n"
 "   This filter is basically a rewrite of the\n"
 "   smartdeinter filter by Donald Graft (without advanced processing\n"
@@ -160,8 +157,12 @@ static void help_optstr(void)
 "       'highq' High-Quality processing (motion Map denoising) (0=off 1=on) [1]\n"
 "       'Blend' Blend the frames for deinterlacing (0=off 1=on) [1]\n"
 "    'doChroma' Enable chroma processing (slower but more accurate) (0=off 1=on) [1]\n"
-"     'verbose' Verbose mode (0=off 1=on) [1]\n"
-		, MOD_CAP);
+"     'verbose' Verbose mode (0=off 1=on) [1]\n";
+
+static void help_optstr(void)
+{
+   tc_log_info (MOD_NAME, "(%s) help", MOD_CAP);
+   tc_log_info (MOD_NAME, "%s", smartyuv_help);
 }
 
 static void Erode_Dilate (uint8_t *_moving, uint8_t *_fmoving, int width, int height)
@@ -328,7 +329,8 @@ static void inline Blendline_c (uint8_t *dst, uint8_t *src, uint8_t *srcminus, u
 // this works fine on OSX too
 #define ABS_u8(a) (((a)^((a)>>7))-((a)>>7))
 
-static void smartyuv_core (char *_src, char *_dst, char *_prev, int _width, int _height,
+static void smartyuv_core (MyFilterData *mfd,
+                           char *_src, char *_dst, char *_prev, int _width, int _height,
                            int _srcpitch, int _dstpitch,
                            unsigned char *_moving, unsigned char *_fmoving,
                            yuv_clamp_fn clamp_f, int _threshold )
@@ -355,7 +357,6 @@ static void smartyuv_core (char *_src, char *_dst, char *_prev, int _width, int
 	int 			rp, rn, rpp, rnn, R;
 	unsigned char		fiMotion;
 	int			cubic = mfd->cubic;
-	static int 		counter=0;
 #ifdef HAVE_ASM_MMX
 	const int		can_use_mmx = !(w%8); // width must a multiple of 8
 #endif
@@ -788,10 +789,10 @@ static void smartyuv_core (char *_src, char *_dst, char *_prev, int _width, int
 		else scenechange = 0;
 
 		if (scenechange && mfd->verbose)
-		    tc_log_info(MOD_NAME, "Scenechange at %6d (%6ld moving pixels)", counter, count);
+		    tc_log_info(MOD_NAME, "Scenechange at %6d (%6ld moving pixels)", mfd->counter, count);
 		/*
 		tc_log_msg(MOD_NAME, "Frame (%04d) count (%8ld) sc (%d) calc (%02ld)",
-				counter, count, scenechange, (100 * count) / (h * w));
+				mfd->counter, count, scenechange, (100 * count) / (h * w));
 				*/
 
 
@@ -1013,7 +1014,7 @@ static void smartyuv_core (char *_src, char *_dst, char *_prev, int _width, int
 	    ac_memcpy(dst, src, w);
 
 	    if (clamp_f == clamp_Y)
-		counter++;
+		mfd->counter++;
 
 	    return;
 
@@ -1197,296 +1198,447 @@ static void smartyuv_core (char *_src, char *_dst, char *_prev, int _width, int
 	// The last line gets a free ride.
 	ac_memcpy(dst, src, w);
 	if (clamp_f == clamp_Y)
-	    counter++;
+	    mfd->counter++;
 
 	return;
 }
 
-int tc_filter(frame_list_t *ptr_, char *options)
+/*************************************************************************/
+
+/* Module interface routines and data. */
+
+/*************************************************************************/
+
+/* fill in the default settings */
+static void smartyuv_defaults(MyFilterData *mfd)
+{
+    mfd->motionOnly     = 0;
+    mfd->threshold      = LUMA_THRESHOLD;
+    mfd->chromathres    = CHROMA_THRESHOLD;
+    mfd->scenethreshold = SCENE_THRESHOLD;
+    mfd->diffmode       = FRAME_ONLY;
+    mfd->highq          = 1;
+    mfd->cubic          = 1;
+    mfd->doChroma       = 1;
+    mfd->Blend          = 1;
+    mfd->verbose        = 0;
+}
+
+/**
+ * smartyuv_init:  Initialize this instance of the module.  See
+ * tcmodule-data.h for function details.
+ */
+
+static int smartyuv_init(TCModuleInstance *self, uint32_t features)
 {
-  vframe_list_t *ptr = (vframe_list_t *)ptr_;
+    MyFilterData *mfd = NULL;
+
+    TC_MODULE_SELF_CHECK(self, "init");
+    TC_MODULE_INIT_CHECK(self, MOD_FEATURES, features);
+
+    mfd = tc_zalloc(sizeof(MyFilterData));
+    if (mfd == NULL) {
+        tc_log_error(MOD_NAME, "No memory!");
+        return TC_ERROR;
+    }
+    smartyuv_defaults(mfd);
+    self->userdata = mfd;
 
-  //----------------------------------
-  //
-  // filter init
-  //
-  //----------------------------------
+    if (verbose) {
+        tc_log_info(MOD_NAME,
+#ifdef HAVE_ASM_MMX
+                    "(MMX) "
+#endif
+#ifdef CAN_COMPILE_C_ALTIVEC
+                    "(ALTIVEC) "
+#endif
+                    "%s %s", MOD_VERSION, MOD_CAP);
+    }
+    return TC_OK;
+}
 
+/*************************************************************************/
 
-  if(ptr->tag & TC_FILTER_INIT) {
+/**
+ * smartyuv_fini:  Clean up after this instance of the module.  See
+ * tcmodule-data.h for function details.
+ */
 
-	unsigned int width, height;
-	int msize;
+TC_MODULE_GENERIC_FINI(smartyuv)
 
-	if((vob = tc_get_vob())==NULL) return(-1);
+/*************************************************************************/
 
+/**
+ * smartyuv_stop:  Reset this instance of the module, dropping the
+ * previous frame and the motion maps.  See tcmodule-data.h for function
+ * details.
+ */
 
-	mfd = tc_zalloc(sizeof(MyFilterData));
+static int smartyuv_stop(TCModuleInstance *self)
+{
+    MyFilterData *mfd = NULL;
 
-	if (!mfd) {
-		tc_log_error(MOD_NAME, "No memory!");
-	        return (-1);
-	}
+    TC_MODULE_SELF_CHECK(self, "stop");
 
-	width  = vob->im_v_width;
-	height = vob->im_v_height;
-
-	/* default values */
-	mfd->motionOnly     = 0;
-	mfd->threshold      = LUMA_THRESHOLD;
-	mfd->chromathres    = CHROMA_THRESHOLD;
-	mfd->scenethreshold = SCENE_THRESHOLD;
-	mfd->diffmode       = FRAME_ONLY;
-	mfd->codec          = vob->im_v_codec;
-	mfd->highq          = 1;
-	mfd->cubic          = 1;
-	mfd->doChroma       = 1;
-	mfd->Blend          = 1;
-	mfd->verbose        = 0;
-
-	if (mfd->codec != CODEC_YUV) {
-	    tc_log_error (MOD_NAME, "This filter is only capable of YUV mode");
-	    return -1;
-	}
+    mfd = self->userdata;
 
-	if (options != NULL) {
+    tc_buffree(mfd->buf);
+    mfd->buf = NULL;
+    tc_buffree(mfd->prevFrame);
+    mfd->prevFrame = NULL;
 
-	  if(verbose) tc_log_info(MOD_NAME, "options=%s", options);
+    tc_buffree(mfd->movingY);
+    mfd->movingY = NULL;
+    tc_buffree(mfd->movingU);
+    mfd->movingU = NULL;
+    tc_buffree(mfd->movingV);
+    mfd->movingV = NULL;
 
-	  optstr_get (options, "motionOnly",     "%d",  &mfd->motionOnly     );
-	  optstr_get (options, "threshold",      "%d",  &mfd->threshold      );
-	  optstr_get (options, "chromathres",    "%d",  &mfd->chromathres    );
-	  optstr_get (options, "Blend",          "%d",  &mfd->Blend          );
-	  optstr_get (options, "scenethres",     "%d",  &mfd->scenethreshold );
-	  optstr_get (options, "highq",          "%d",  &mfd->highq          );
-	  optstr_get (options, "cubic",          "%d",  &mfd->cubic          );
-	  optstr_get (options, "diffmode",       "%d",  &mfd->diffmode       );
-	  optstr_get (options, "doChroma",       "%d",  &mfd->doChroma       );
-	  optstr_get (options, "verbose",        "%d",  &mfd->verbose        );
+    tc_buffree(mfd->fmovingY);
+    mfd->fmovingY = NULL;
+    tc_buffree(mfd->fmovingU);
+    mfd->fmovingU = NULL;
+    tc_buffree(mfd->fmovingV);
+    mfd->fmovingV = NULL;
 
-	  if (optstr_lookup (options, "help") != NULL) {
-		  help_optstr();
-	  }
-	}
+    mfd->counter = 0;
+    return TC_OK;
+}
 
-	if (verbose > 1) {
-
-	  tc_log_info (MOD_NAME, " Smart YUV Deinterlacer Test Filter Settings (%dx%d):", width, height);
-	  tc_log_info (MOD_NAME, "        motionOnly = %d", mfd->motionOnly);
-	  tc_log_info (MOD_NAME, "          diffmode = %d", mfd->diffmode);
-	  tc_log_info (MOD_NAME, "         threshold = %d", mfd->threshold);
-	  tc_log_info (MOD_NAME, "       chromathres = %d", mfd->chromathres);
-	  tc_log_info (MOD_NAME, "        scenethres = %d", mfd->scenethreshold);
-	  tc_log_info (MOD_NAME, "             cubic = %d", mfd->cubic);
-	  tc_log_info (MOD_NAME, "             highq = %d", mfd->highq);
-	  tc_log_info (MOD_NAME, "             Blend = %d", mfd->Blend);
-	  tc_log_info (MOD_NAME, "          doChroma = %d", mfd->doChroma);
-	  tc_log_info (MOD_NAME, "           verbose = %d", mfd->verbose);
-	}
+/*************************************************************************/
 
-	/* fetch memory */
+/**
+ * smartyuv_configure:  Configure this instance of the module.  See
+ * tcmodule-data.h for function details.
+ */
 
-	mfd->buf =  tc_bufalloc (width*height*3);
-	mfd->prevFrame =  tc_bufalloc (width*height*3);
+static int smartyuv_configure(TCModuleInstance *self,
+                              const char *options, vob_t *vob)
+{
+    MyFilterData *mfd = NULL;
+    unsigned int width, height;
+    int msize;
 
-	msize = width*height + 4*(width+PAD) + PAD*height;
-	mfd->movingY = (unsigned char *) tc_bufalloc(sizeof(unsigned char)*msize);
-	mfd->fmovingY = (unsigned char *) tc_bufalloc(sizeof(unsigned char)*msize);
+    TC_MODULE_SELF_CHECK(self, "configure");
+    TC_MODULE_SELF_CHECK(vob, "configure");
 
-	msize = width*height/4 + 4*(width+PAD) + PAD*height;
-	mfd->movingU  = (unsigned char *) tc_bufalloc(sizeof(unsigned char)*msize);
-	mfd->movingV  = (unsigned char *) tc_bufalloc(sizeof(unsigned char)*msize);
-	mfd->fmovingU = (unsigned char *) tc_bufalloc(sizeof(unsigned char)*msize);
-	mfd->fmovingV = (unsigned char *) tc_bufalloc(sizeof(unsigned char)*msize);
+    mfd = self->userdata;
 
-	if ( !mfd->movingY || !mfd->movingU || !mfd->movingV || !mfd->fmovingY ||
-	      !mfd->fmovingU || !mfd->fmovingV || !mfd->buf || !mfd->prevFrame) {
-	    tc_log_msg(MOD_NAME, "Memory allocation error");
-	    return -1;
-	}
+    width  = vob->im_v_width;
+    height = vob->im_v_height;
 
-	memset(mfd->prevFrame, BLACK_BYTE_Y, width*height);
-	memset(mfd->prevFrame+width*height, BLACK_BYTE_UV, width*height/2);
-
-	memset(mfd->buf, BLACK_BYTE_Y, width*height);
-	memset(mfd->buf+width*height, BLACK_BYTE_UV, width*height/2);
-
-	msize = width*height + 4*(width+PAD) + PAD*height;
-	memset(mfd->movingY,  0, msize);
-	memset(mfd->fmovingY, 0, msize);
-
-	msize = width*height/4 + 4*(width+PAD) + PAD*height;
-	memset(mfd->movingU,  0, msize);
-	memset(mfd->movingV,  0, msize);
-	memset(mfd->fmovingU, 0, msize);
-	memset(mfd->fmovingV, 0, msize);
-
-	// Optimisation
-	// For the motion maps a little bit more than the needed memory is
-	// allocated. This is done, because than we don't have to use
-	// conditional borders int the erode and dilate routines. 2 extra lines
-	// on top and bottom and 2 pixels left and right for each line.
-	// This is also the reason for the w+4's all over the place.
-	//
-	// This gives an speedup factor in erode+denoise of about 3.
-	//
-	// A lot of brain went into the optimisations, here are some numbers of
-	// the separate steps. Note, to get these numbers I used the rdtsc
-	// instruction to read the CPU cycle counter in seperate programms:
-	// o  Motion map creation
-	//      orig: 26.283.387 Cycles
-	//       now:  8.991.686 Cycles
-	//       mmx:  5.062.952
-	// o  Erode+dilate
-	//      orig: 55.847.077
-	//       now: 21.764.997
-	//  Erodemmx: 18.765.878
-	// o  Blending
-	//      orig: 8.162.287
-	//       now: 5.384.433
-	//       mmx: 4.569.875
-	//   new mmx: 3.656.537
-	// o  Cubic interpolation
-	//      orig: 7.487.338
-	//       now: 6.684.908
-	//      more: 3.554.580
-	//
-	// Overall improvement in transcode:
-	// 11.57 -> 22.78 frames per second for the test clip.
-	//
-
-	// filter init ok.
-
-	if(verbose) tc_log_info(MOD_NAME,
-#ifdef HAVE_ASM_MMX
-		"(MMX) "
-#endif
-#ifdef CAN_COMPILE_C_ALTIVEC
-		"(ALTIVEC) "
-#endif
-		"%s %s", MOD_VERSION, MOD_CAP);
+    smartyuv_defaults(mfd);
+    mfd->codec = vob->im_v_codec;
+
+    if (mfd->codec != CODEC_YUV) {
+        tc_log_error(MOD_NAME, "This filter is only capable of YUV mode");
+        return TC_ERROR;
+    }
 
-	return 0;
+    if (options != NULL) {
+        if (verbose)
+            tc_log_info(MOD_NAME, "options=%s", options);
+
+        optstr_get(options, "motionOnly",  "%d", &mfd->motionOnly    );
+        optstr_get(options, "threshold",   "%d", &mfd->threshold     );
+        optstr_get(options, "chromathres", "%d", &mfd->chromathres   );
+        optstr_get(options, "Blend",       "%d", &mfd->Blend         );
+        optstr_get(options, "scenethres",  "%d", &mfd->scenethreshold);
+        optstr_get(options, "highq",       "%d", &mfd->highq         );
+        optstr_get(options, "cubic",       "%d", &mfd->cubic         );
+        optstr_get(options, "diffmode",    "%d", &mfd->diffmode      );
+        optstr_get(options, "doChroma",    "%d", &mfd->doChroma      );
+        optstr_get(options, "verbose",     "%d", &mfd->verbose       );
+
+        if (optstr_lookup(options, "help") != NULL) {
+            help_optstr();
+        }
+    }
 
-  } /* TC_FILTER_INIT */
+    if (verbose > 1) {
+        tc_log_info(MOD_NAME, " Smart YUV Deinterlacer Test Filter Settings (%dx%d):", width, height);
+        tc_log_info(MOD_NAME, "        motionOnly = %d", mfd->motionOnly);
+        tc_log_info(MOD_NAME, "          diffmode = %d", mfd->diffmode);
+        tc_log_info(MOD_NAME, "         threshold = %d", mfd->threshold);
+        tc_log_info(MOD_NAME, "       chromathres = %d", mfd->chromathres);
+        tc_log_info(MOD_NAME, "        scenethres = %d", mfd->scenethreshold);
+        tc_log_info(MOD_NAME, "             cubic = %d", mfd->cubic);
+        tc_log_info(MOD_NAME, "             highq = %d", mfd->highq);
+        tc_log_info(MOD_NAME, "             Blend = %d", mfd->Blend);
+        tc_log_info(MOD_NAME, "          doChroma = %d", mfd->doChroma);
+        tc_log_info(MOD_NAME, "           verbose = %d", mfd->verbose);
+    }
 
+    /* fetch memory */
 
-  if(ptr->tag & TC_FILTER_GET_CONFIG) {
-      char buf[255];
-      optstr_filter_desc (options, MOD_NAME, MOD_CAP, MOD_VERSION, MOD_AUTHOR, "VYE", "1");
+    smartyuv_stop(self);
 
-      tc_snprintf (buf, sizeof(buf), "%d", mfd->motionOnly);
-      optstr_param (options, "motionOnly", "Show motion areas only, blacking out static areas" ,"%d", buf, "0", "1");
-      tc_snprintf (buf, sizeof(buf), "%d", mfd->diffmode);
-      optstr_param (options, "diffmode", "Motion Detection (0=frame, 1=field, 2=both)", "%d", buf, "0", "2" );
-      tc_snprintf (buf, sizeof(buf), "%d", mfd->threshold);
-      optstr_param (options, "threshold", "Motion Threshold (luma)", "%d", buf, "0", "255" );
-      tc_snprintf (buf, sizeof(buf), "%d", mfd->chromathres);
-      optstr_param (options, "chromathres", "Motion Threshold (chroma)", "%d", buf, "0", "255" );
-      tc_snprintf (buf, sizeof(buf), "%d", mfd->scenethreshold);
-      optstr_param (options, "scenethres", "Threshold for detecting scenechanges", "%d", buf, "0", "255" );
-      tc_snprintf (buf, sizeof(buf), "%d", mfd->highq);
-      optstr_param (options, "highq", "High-Quality processing (motion Map denoising)", "%d", buf, "0", "1" );
-      tc_snprintf (buf, sizeof(buf), "%d", mfd->cubic);
-      optstr_param (options, "cubic", "Do cubic interpolation", "%d", buf, "0", "1" );
-      tc_snprintf (buf, sizeof(buf), "%d", mfd->Blend);
-      optstr_param (options, "Blend", "Blend the frames for deinterlacing", "%d", buf, "0", "1" );
-      tc_snprintf (buf, sizeof(buf), "%d", mfd->doChroma);
-      optstr_param (options, "doChroma", "Enable chroma processing (slower but more accurate)", "%d", buf, "0", "1" );
-      tc_snprintf (buf, sizeof(buf), "%d", mfd->verbose);
-      optstr_param (options, "verbose", "Verbose mode", "%d", buf, "0", "1" );
+    mfd->buf       = tc_bufalloc(width*height*3);
+    mfd->prevFrame = tc_bufalloc(width*height*3);
 
-      return (0);
-  }
+    msize = width*height + 4*(width+PAD) + PAD*height;
+    mfd->movingY  = tc_bufalloc(sizeof(unsigned char)*msize);
+    mfd->fmovingY = tc_bufalloc(sizeof(unsigned char)*msize);
 
-  if(ptr->tag & TC_FILTER_CLOSE) {
+    msize = width*height/4 + 4*(width+PAD) + PAD*height;
+    mfd->movingU  = tc_bufalloc(sizeof(unsigned char)*msize);
+    mfd->movingV  = tc_bufalloc(sizeof(unsigned char)*msize);
+    mfd->fmovingU = tc_bufalloc(sizeof(unsigned char)*msize);
+    mfd->fmovingV = tc_bufalloc(sizeof(unsigned char)*msize);
 
-	if (!mfd)
-		return 0;
+    if (!mfd->movingY || !mfd->movingU || !mfd->movingV || !mfd->fmovingY
+     || !mfd->fmovingU || !mfd->fmovingV || !mfd->buf || !mfd->prevFrame) {
+        tc_log_error(MOD_NAME, "Memory allocation error");
+        return TC_ERROR;
+    }
 
-	tc_buffree (mfd->buf);
-	mfd->buf = NULL;
+    memset(mfd->prevFrame, BLACK_BYTE_Y, width*height);
+    memset(mfd->prevFrame+width*height, BLACK_BYTE_UV, width*height/2);
+
+    memset(mfd->buf, BLACK_BYTE_Y, width*height);
+    memset(mfd->buf+width*height, BLACK_BYTE_UV, width*height/2);
+
+    msize = width*height + 4*(width+PAD) + PAD*height;
+    memset(mfd->movingY,  0, msize);
+    memset(mfd->fmovingY, 0, msize);
+
+    msize = width*height/4 + 4*(width+PAD) + PAD*height;
+    memset(mfd->movingU,  0, msize);
+    memset(mfd->movingV,  0, msize);
+    memset(mfd->fmovingU, 0, msize);
+    memset(mfd->fmovingV, 0, msize);
+
+    // Optimisation
+    // For the motion maps a little bit more than the needed memory is
+    // allocated. This is done, because than we don't have to use
+    // conditional borders int the erode and dilate routines. 2 extra lines
+    // on top and bottom and 2 pixels left and right for each line.
+    // This is also the reason for the w+4's all over the place.
+    //
+    // This gives an speedup factor in erode+denoise of about 3.
+    //
+    // A lot of brain went into the optimisations, here are some numbers of
+    // the separate steps. Note, to get these numbers I used the rdtsc
+    // instruction to read the CPU cycle counter in seperate programms:
+    // o  Motion map creation
+    //      orig: 26.283.387 Cycles
+    //       now:  8.991.686 Cycles
+    //       mmx:  5.062.952
+    // o  Erode+dilate
+    //      orig: 55.847.077
+    //       now: 21.764.997
+    //  Erodemmx: 18.765.878
+    // o  Blending
+    //      orig: 8.162.287
+    //       now: 5.384.433
+    //       mmx: 4.569.875
+    //   new mmx: 3.656.537
+    // o  Cubic interpolation
+    //      orig: 7.487.338
+    //       now: 6.684.908
+    //      more: 3.554.580
+    //
+    // Overall improvement in transcode:
+    // 11.57 -> 22.78 frames per second for the test clip.
+    //
+
+    return TC_OK;
+}
 
-	tc_buffree (mfd->prevFrame);
-	mfd->prevFrame = NULL;
+/*************************************************************************/
 
-	tc_buffree (mfd->movingY);
-	mfd->movingY = NULL;
-	tc_buffree (mfd->movingU);
-	mfd->movingU = NULL;
-	tc_buffree (mfd->movingV);
-	mfd->movingV = NULL;
+/**
+ * smartyuv_inspect:  Return the value of an option in this instance of
+ * the module.  See tcmodule-data.h for function details.
+ */
 
-	tc_buffree (mfd->fmovingY);
-	mfd->fmovingY = NULL;
-	tc_buffree (mfd->fmovingU);
-	mfd->fmovingU = NULL;
-	tc_buffree (mfd->fmovingV);
-	mfd->fmovingV = NULL;
+static int smartyuv_inspect(TCModuleInstance *self,
+                            const char *param, const char **value)
+{
+    MyFilterData *mfd = NULL;
 
-	if (mfd)
-		free(mfd);
+    TC_MODULE_SELF_CHECK(self, "inspect");
+    TC_MODULE_SELF_CHECK(param, "inspect");
+    TC_MODULE_SELF_CHECK(value, "inspect");
 
-	return 0;
+    mfd = self->userdata;
 
-  } /* TC_FILTER_CLOSE */
+#define INSPECT_PARAM(NAME, FIELD) do { \
+    if (optstr_lookup(param, NAME)) { \
+        tc_snprintf(mfd->conf_str, sizeof(mfd->conf_str), \
+                    NAME "=%i", mfd->FIELD); \
+        *value = mfd->conf_str; \
+    } \
+} while (0)
 
-///////////////////////////////////////////////////////////////////////////
+    if (optstr_lookup(param, "help")) {
+        *value = smartyuv_help;
+    }
+    INSPECT_PARAM("motionOnly",  motionOnly);
+    INSPECT_PARAM("diffmode",    diffmode);
+    INSPECT_PARAM("threshold",   threshold);
+    INSPECT_PARAM("chromathres", chromathres);
+    INSPECT_PARAM("scenethres",  scenethreshold);
+    INSPECT_PARAM("highq",       highq);
+    INSPECT_PARAM("cubic",       cubic);
+    INSPECT_PARAM("Blend",       Blend);
+    INSPECT_PARAM("doChroma",    doChroma);
+    INSPECT_PARAM("verbose",     verbose);
+
+#undef INSPECT_PARAM
+
+    return TC_OK;
+}
+
+/*************************************************************************/
+
+/**
+ * smartyuv_filter_video:  deinterlace the moving areas of the frame.
+ * See tcmodule-data.h for function details.
+ */
+
+static int smartyuv_filter_video(TCModuleInstance *self,
+                                 vframe_list_t *ptr)
+{
+    MyFilterData *mfd = NULL;
+    int U, V, w2, h2, msize, off;
+
+    TC_MODULE_SELF_CHECK(self, "filter");
+    TC_MODULE_SELF_CHECK(ptr, "filter");
+
+    mfd = self->userdata;
+
+    U  = ptr->v_width*ptr->v_height;
+    V  = ptr->v_width*ptr->v_height*5/4;
+    w2 = ptr->v_width/2;
+    h2 = ptr->v_height/2;
+    msize = ptr->v_width*ptr->v_height + 4*(ptr->v_width+PAD) + PAD*ptr->v_height;
+    off = 2*(ptr->v_width+PAD)+PAD/2;
+
+    memset(mfd->movingY,  0, msize);
+    memset(mfd->fmovingY, 0, msize);
+
+    smartyuv_core(mfd, ptr->video_buf, mfd->buf, mfd->prevFrame,
+                  ptr->v_width, ptr->v_height, ptr->v_width, ptr->v_width,
+                  mfd->movingY+off, mfd->fmovingY+off, clamp_Y, mfd->threshold);
+
+    if (mfd->doChroma) {
+        msize = ptr->v_width*ptr->v_height/4 + 4*(ptr->v_width+PAD) + PAD*ptr->v_height;
+        off = 2*(ptr->v_width/2+PAD)+PAD/2;
+
+        memset(mfd->movingU,  0, msize);
+        memset(mfd->fmovingU, 0, msize);
+        memset(mfd->movingV,  0, msize);
+        memset(mfd->fmovingV, 0, msize);
+
+        smartyuv_core(mfd, ptr->video_buf+U, mfd->buf+U, mfd->prevFrame+U,
+                      w2, h2, w2, w2,
+                      mfd->movingU+off, mfd->fmovingU+off, clamp_UV, mfd->chromathres);
+
+        smartyuv_core(mfd, ptr->video_buf+V, mfd->buf+V, mfd->prevFrame+V,
+                      w2, h2, w2, w2,
+                      mfd->movingV+off, mfd->fmovingV+off, clamp_UV, mfd->chromathres);
+    } else {
+        //pass through
+        ac_memcpy(mfd->buf+U, ptr->video_buf+U, ptr->v_width*ptr->v_height/2);
+    }
+
+    ac_memcpy(ptr->video_buf, mfd->buf, ptr->video_size);
+    return TC_OK;
+}
+
+/*************************************************************************/
+
+static const TCCodecID smartyuv_codecs_in[] = {
+    TC_CODEC_YUV420P, TC_CODEC_ERROR
+};
+static const TCCodecID smartyuv_codecs_out[] = {
+    TC_CODEC_YUV420P, TC_CODEC_ERROR
+};
+TC_MODULE_FILTER_FORMATS(smartyuv);
+
+TC_MODULE_INFO(smartyuv);
 
-  //if(ptr->tag & TC_PRE_S_PROCESS && ptr->tag & TC_VIDEO && !(ptr->attributes & TC_FRAME_IS_SKIPPED)) {
-  if(ptr->tag & TC_PRE_M_PROCESS && ptr->tag & TC_VIDEO && !(ptr->attributes & TC_FRAME_IS_SKIPPED)) {
-
-	  int U  = ptr->v_width*ptr->v_height;
-	  int V  = ptr->v_width*ptr->v_height*5/4;
-	  int w2 = ptr->v_width/2;
-	  int h2 = ptr->v_height/2;
-	  int msize = ptr->v_width*ptr->v_height + 4*(ptr->v_width+PAD) + PAD*ptr->v_height;
-	  int off = 2*(ptr->v_width+PAD)+PAD/2;
-
-	  memset(mfd->movingY,  0, msize);
-	  memset(mfd->fmovingY, 0, msize);
-	  /*
-	  */
-
-
-	  smartyuv_core(ptr->video_buf, mfd->buf, mfd->prevFrame,
-		        ptr->v_width, ptr->v_height, ptr->v_width, ptr->v_width,
-		        mfd->movingY+off, mfd->fmovingY+off, clamp_Y, mfd->threshold);
-
-
-	  if (mfd->doChroma) {
-	      msize = ptr->v_width*ptr->v_height/4 + 4*(ptr->v_width+PAD) + PAD*ptr->v_height;
-	      off = 2*(ptr->v_width/2+PAD)+PAD/2;
-
-	      memset(mfd->movingU,  0, msize);
-	      memset(mfd->fmovingU, 0, msize);
-	      memset(mfd->movingV,  0, msize);
-	      memset(mfd->fmovingV, 0, msize);
-	      /*
-	      */
-
-	      smartyuv_core(ptr->video_buf+U, mfd->buf+U, mfd->prevFrame+U,
-			  w2, h2, w2, w2,
-			  mfd->movingU+off, mfd->fmovingU+off, clamp_UV, mfd->chromathres);
-
-	      smartyuv_core(ptr->video_buf+V, mfd->buf+V, mfd->prevFrame+V,
-			  w2, h2, w2, w2,
-			  mfd->movingV+off, mfd->fmovingV+off, clamp_UV, mfd->chromathres);
-	  } else {
-	      //pass through
-	      ac_memcpy(mfd->buf+U, ptr->video_buf+U, ptr->v_width*ptr->v_height/2);
-	      //memset(mfd->buf+U, BLACK_BYTE_UV, ptr->v_width*ptr->v_height/2);
-	  }
-
-	  /*
-	  memset(mfd->buf, BLACK_BYTE_Y, ptr->v_width*ptr->v_height);
-	  memset(mfd->buf+U, BLACK_BYTE_UV, ptr->v_width*ptr->v_height/2);
-			  */
-
-	  ac_memcpy (ptr->video_buf, mfd->buf, ptr->video_size);
-
-	  return 0;
-  }
-  return 0;
+static const TCModuleClass smartyuv_class = {
+    TC_MODULE_CLASS_HEAD(smartyuv),
+
+    .init         = smartyuv_init,
+    .fini         = smartyuv_fini,
+    .configure    = smartyuv_configure,
+    .stop         = smartyuv_stop,
+    .inspect      = smartyuv_inspect,
+
+    .filter_video = smartyuv_filter_video,
+};
+
+TC_MODULE_ENTRY_POINT(smartyuv)
+
+/*************************************************************************/
+
+static int smartyuv_get_config(TCModuleInstance *self, char *options)
+{
+    MyFilterData defaults, *mfd = NULL;
+    char buf[255];
+
+    TC_MODULE_SELF_CHECK(self, "get_config");
+
+    mfd = self->userdata;
+    if (!mfd) {
+        smartyuv_defaults(&defaults);
+        mfd = &defaults;
+    }
+
+    optstr_filter_desc(options, MOD_NAME, MOD_CAP, MOD_VERSION, MOD_AUTHOR, "VYE", "1");
+
+    tc_snprintf(buf, sizeof(buf), "%d", mfd->motionOnly);
+    optstr_param(options, "motionOnly", "Show motion areas only, blacking out static areas" ,"%d", buf, "0", "1");
+    tc_snprintf(buf, sizeof(buf), "%d", mfd->diffmode);
+    optstr_param(options, "diffmode", "Motion Detection (0=frame, 1=field, 2=both)", "%d", buf, "0", "2" );
+    tc_snprintf(buf, sizeof(buf), "%d", mfd->threshold);
+    optstr_param(options, "threshold", "Motion Threshold (luma)", "%d", buf, "0", "255" );
+    tc_snprintf(buf, sizeof(buf), "%d", mfd->chromathres);
+    optstr_param(options, "chromathres", "Motion Threshold (chroma)", "%d", buf, "0", "255" );
+    tc_snprintf(buf, sizeof(buf), "%d", mfd->scenethreshold);
+    optstr_param(options, "scenethres", "Threshold for detecting scenechanges", "%d", buf, "0", "255" );
+    tc_snprintf(buf, sizeof(buf), "%d", mfd->highq);
+    optstr_param(options, "highq", "High-Quality processing (motion Map denoising)", "%d", buf, "0", "1" );
+    tc_snprintf(buf, sizeof(buf), "%d", mfd->cubic);
+    optstr_param(options, "cubic", "Do cubic interpolation", "%d", buf, "0", "1" );
+    tc_snprintf(buf, sizeof(buf), "%d", mfd->Blend);
+    optstr_param(options, "Blend", "Blend the frames for deinterlacing", "%d", buf, "0", "1" );
+    tc_snprintf(buf, sizeof(buf), "%d", mfd->doChroma);
+    optstr_param(options, "doChroma", "Enable chroma processing (slower but more accurate)", "%d", buf, "0", "1" );
+    tc_snprintf(buf, sizeof(buf), "%d", mfd->verbose);
+    optstr_param(options, "verbose", "Verbose mode", "%d", buf, "0", "1" );
+
+    return TC_OK;
 }
 
+static int smartyuv_process(TCModuleInstance *self, frame_list_t *frame)
+{
+    TC_MODULE_SELF_CHECK(self, "process");
+
+    if ((frame->tag & TC_PRE_M_PROCESS) && (frame->tag & TC_VIDEO)
+     && !(frame->attributes & TC_FRAME_IS_SKIPPED)) {
+        return smartyuv_filter_video(self, (vframe_list_t*)frame);
+    }
+    return TC_OK;
+}
+
+/*************************************************************************/
+
+/* Old-fashioned module interface. */
+
+TC_FILTER_OLDINTERFACE_M(smartyuv)
+
+/*************************************************************************/
+
+/*
+ * Local variables:
+ *   c-file-style: "stroustrup"
+ *   c-file-offsets: ((case-label . *) (statement-case-intro . *))
+ *   indent-tabs-mode: nil
+ * End:
+ *
+ * vim: expandtab shiftwidth=4:
+ */
@@ -161,6 +161,7 @@ int tc_filter(frame_list_t *ptr_, char *options)
   //----------------------------------
 
   if(ptr->tag & TC_FILTER_INIT) {
+    const TCFrameSpecs *specs = NULL;
 
     if((vob = tc_get_vob())==NULL) return(-1);
 
@@ -182,9 +183,12 @@ int tc_filter(frame_list_t *ptr_, char *options)
 	optstr_get (options, "range",  "%d", &range[instance]);
     }
 
-    tbuf[instance] = tc_malloc(SIZE_RGB_FRAME);
+    /* frames are at most as large as the core framebuffers */
+    specs = tc_framebuffer_get_specs();
+    tbuf[instance] = tc_zalloc(tc_video_frame_size(specs->width, specs->height,
+                                                   specs->format));
+    if (tbuf[instance] == NULL) return(-1);
     if (strength[instance]> 0.9) strength[instance] = 0.9;
-    memset(tbuf[instance], 0, SIZE_RGB_FRAME);
 
     if (vob->im_v_codec == CODEC_RGB) {
 	if (verbose) tc_log_error(MOD_NAME, "only capable of YUV mode");
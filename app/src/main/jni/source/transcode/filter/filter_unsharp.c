@@ -18,16 +18,23 @@
 */
 
 #define MOD_NAME      "filter_unsharp.so"
-#define MOD_VERSION   "v1.0.1 (2003-10-27)"
+#define MOD_VERSION   "v1.1.0 (2026-10-17)"
 #define MOD_CAP       "unsharp mask & gaussian blur"
 #define MOD_AUTHOR    "Rmi Guyomarch"
 
+#define MOD_FEATURES \
+    TC_MODULE_FEATURE_FILTER|TC_MODULE_FEATURE_VIDEO
+#define MOD_FLAGS \
+    TC_MODULE_FLAG_RECONFIGURABLE|TC_MODULE_FLAG_STATELESS
+
 #include "transcode.h"
 #include "filter.h"
 #include "libtc/libtc.h"
 #include "libtc/optstr.h"
+#include "libtc/tcmodule-plugin.h"
 
 #include <math.h>
+#include <pthread.h>
 
 //===========================================================================//
 
@@ -40,10 +47,24 @@ typedef struct FilterParam {
     uint32_t *SC[MAX_MATRIX_SIZE-1];
 } FilterParam;
 
+// scratch space for one frame: the frame threads may run this
+// filter on several frames at once, each one takes its own
+typedef struct work_s {
+    FilterParam lumaParam;
+    FilterParam chromaParam;
+    char *buffer;
+    struct work_s *next;
+} MyFilterWork;
+
 typedef struct vf_priv_s {
     FilterParam lumaParam;
     FilterParam chromaParam;
     int pre;
+    int width;
+    int height;
+    pthread_mutex_t lock;
+    MyFilterWork *works; // unused scratch spaces
+    char conf_str[TC_BUF_MIN];
 } MyFilterData;
 
 
@@ -117,9 +138,72 @@ static void unsharp( uint8_t *dst, uint8_t *src, int dstStride, int srcStride, i
 
 //===========================================================================//
 
-static void help_optstr(void)
-{
-    tc_log_info (MOD_NAME, "(%s) help\n"
+static void free_param( FilterParam *fp ) {
+    unsigned int z;
+
+    for( z=0; z<sizeof(fp->SC)/sizeof(fp->SC[0]); z++ ) {
+	tc_buffree(fp->SC[z]);
+	fp->SC[z] = NULL;
+    }
+}
+
+static int alloc_param( FilterParam *fp, const FilterParam *model, int width ) {
+    int z, stepsX = model->msizeX/2, stepsY = model->msizeY/2;
+
+    *fp = *model;
+    memset( fp->SC, 0, sizeof( fp->SC ) );
+    for( z=0; z<2*stepsY; z++ ) {
+	fp->SC[z] = tc_bufalloc(sizeof(*(fp->SC[z])) * (width+2*stepsX));
+	if( !fp->SC[z] ) {
+	    free_param( fp );
+	    return -1;
+	}
+    }
+    return 0;
+}
+
+static void del_work( MyFilterWork *work ) {
+    free_param( &work->lumaParam );
+    free_param( &work->chromaParam );
+    free( work->buffer );
+    free( work );
+}
+
+static MyFilterWork *get_work( MyFilterData *mfd ) {
+    MyFilterWork *work;
+
+    pthread_mutex_lock( &mfd->lock );
+    work = mfd->works;
+    if( work )
+	mfd->works = work->next;
+    pthread_mutex_unlock( &mfd->lock );
+    if( work )
+	return work;
+
+    work = tc_zalloc( sizeof(MyFilterWork) );
+    if( !work )
+	return NULL;
+    work->buffer = tc_zalloc(tc_video_frame_size(mfd->width, mfd->height,
+                                                 TC_CODEC_YUV420P));
+    if( !work->buffer
+     || alloc_param( &work->lumaParam, &mfd->lumaParam, mfd->width ) < 0
+     || alloc_param( &work->chromaParam, &mfd->chromaParam, mfd->width ) < 0 ) {
+	del_work( work );
+	return NULL;
+    }
+    return work;
+}
+
+static void put_work( MyFilterData *mfd, MyFilterWork *work ) {
+    pthread_mutex_lock( &mfd->lock );
+    work->next = mfd->works;
+    mfd->works = work;
+    pthread_mutex_unlock( &mfd->lock );
+}
+
+//===========================================================================//
+
+static const char unsharp_help[] = ""
 "* Overview\n"
 "  This filter blurs or sharpens an image depending on\n"
 "  the sign of \"amount\". You can either set amount for\n"
@@ -142,8 +226,12 @@ static void help_optstr(void)
 "         chroma : Chroma (un)sharpness amount (%02.2f)\n"
 "    luma_matrix : Luma search matrix size (%dx%d)\n"
 "  chroma_matrix : Chroma search matrix size (%dx%d)\n"
-"              pre : run as a pre filter (0)\n"
-		 , MOD_CAP,
+"              pre : run as a pre filter (0)\n";
+
+static void help_optstr(void)
+{
+    tc_log_info(MOD_NAME, "(%s) help", MOD_CAP);
+    tc_log_info(MOD_NAME, unsharp_help,
 		 0.0,
 		 0, 0,
 		 0.0,
@@ -152,191 +240,362 @@ static void help_optstr(void)
 		 0, 0);
 }
 
-//===========================================================================//
+/*************************************************************************/
 
-int tc_filter(frame_list_t *ptr_, char *options)
-{
-  vframe_list_t *ptr = (vframe_list_t *)ptr_;
-  static vob_t *vob=NULL;
-  static MyFilterData *mfd=NULL;
-  static char *buffer;
+/* Module interface routines and data. */
 
-  if(ptr->tag & TC_AUDIO) return 0;
+/*************************************************************************/
 
-  if(ptr->tag & TC_FILTER_GET_CONFIG) {
+/**
+ * unsharp_init:  Initialize this instance of the module.  See
+ * tcmodule-data.h for function details.
+ */
 
-      optstr_filter_desc (options, MOD_NAME, MOD_CAP, MOD_VERSION, MOD_AUTHOR, "VYO", "1");
+static int unsharp_init(TCModuleInstance *self, uint32_t features)
+{
+    MyFilterData *mfd = NULL;
 
-      optstr_param (options, "amount", "Luma and chroma (un)sharpness amount", "%f", "0.0", "-2.0", "2.0" );
-      optstr_param (options, "matrix", "Luma and chroma search matrix size", "%dx%d", "0x0",
-	      "3", "63", "3", "63");
+    TC_MODULE_SELF_CHECK(self, "init");
+    TC_MODULE_INIT_CHECK(self, MOD_FEATURES, features);
 
-      optstr_param (options, "luma", "Luma (un)sharpness amount", "%f", "0.0", "-2.0", "2.0" );
+    mfd = tc_zalloc(sizeof(MyFilterData));
+    if (mfd == NULL) {
+        tc_log_error(MOD_NAME, "init: out of memory!");
+        return TC_ERROR;
+    }
+    pthread_mutex_init(&mfd->lock, NULL);
+    self->userdata = mfd;
 
-      optstr_param (options, "chroma", "Chroma (un)sharpness amount", "%f", "0.0", "-2.0", "2.0" );
+    if (verbose) {
+        tc_log_info(MOD_NAME, "%s %s", MOD_VERSION, MOD_CAP);
+    }
+    return TC_OK;
+}
 
-      optstr_param (options, "luma_matrix", "Luma search matrix size", "%dx%d", "0x0",
-	      "3", "63", "3", "63");
+/*************************************************************************/
 
-      optstr_param (options, "chroma_matrix", "Chroma search matrix size", "%dx%d", "0x0",
-	      "3", "63", "3", "63");
+/**
+ * unsharp_stop:  Reset this instance of the module, releasing the
+ * scratch spaces.  See tcmodule-data.h for function details.
+ */
 
-      optstr_param (options, "pre", "run as a pre filter", "%d", "0", "0", "1" );
+static int unsharp_stop(TCModuleInstance *self)
+{
+    MyFilterData *mfd = NULL;
+    MyFilterWork *work = NULL;
 
-      return 0;
-  }
+    TC_MODULE_SELF_CHECK(self, "stop");
 
-  //----------------------------------
-  //
-  // filter init
-  //
-  //----------------------------------
+    mfd = self->userdata;
 
+    while ((work = mfd->works) != NULL) {
+        mfd->works = work->next;
+        del_work(work);
+    }
+    return TC_OK;
+}
 
-  if(ptr->tag & TC_FILTER_INIT) {
+/*************************************************************************/
 
-    int width, height;
-    int z, stepsX, stepsY;
-    FilterParam *fp;
-    char *effect;
-    double amount=0.0;
-    int msizeX=0, msizeY=0;
+/**
+ * unsharp_fini:  Clean up after this instance of the module.  See
+ * tcmodule-data.h for function details.
+ */
 
-    if((vob = tc_get_vob())==NULL) return(-1);
+static int unsharp_fini(TCModuleInstance *self)
+{
+    MyFilterData *mfd = NULL;
 
-    if (vob->im_v_codec != CODEC_YUV) {
-	tc_log_error(MOD_NAME, "This filter is only capable of YUV mode");
-	return -1;
-    }
+    TC_MODULE_SELF_CHECK(self, "fini");
 
-    mfd   = tc_zalloc( sizeof(MyFilterData) );
-    buffer = tc_zalloc(SIZE_RGB_FRAME);
+    mfd = self->userdata;
 
-    // GET OPTIONS
-    if (options) {
+    unsharp_stop(self);
+    pthread_mutex_destroy(&mfd->lock);
+    tc_free(mfd);
+    self->userdata = NULL;
+    return TC_OK;
+}
 
-	// l7x5:0.8:c3x3:-0.2
+/*************************************************************************/
 
-	if (optstr_lookup (options, "help")) {
-	    help_optstr();
-	}
+/**
+ * unsharp_configure:  Configure this instance of the module.  See
+ * tcmodule-data.h for function details.
+ */
 
-	optstr_get (options, "amount",         "%lf",   &amount);
-	optstr_get (options, "matrix",         "%dx%d", &msizeX, &msizeY);
-	optstr_get (options, "luma",           "%lf",   &mfd->lumaParam.amount);
-	optstr_get (options, "luma_matrix",    "%dx%d", &mfd->lumaParam.msizeX, &mfd->lumaParam.msizeY);
-	optstr_get (options, "chroma",         "%lf",   &mfd->chromaParam.amount);
-	optstr_get (options, "chroma_matrix",  "%dx%d", &mfd->chromaParam.msizeX, &mfd->chromaParam.msizeY);
-	optstr_get (options, "pre",            "%d",    &mfd->pre);
+static int unsharp_configure(TCModuleInstance *self,
+                             const char *options, vob_t *vob)
+{
+    MyFilterData *mfd = NULL;
+    FilterParam *fp = NULL;
+    MyFilterWork *work = NULL;
+    const char *effect = NULL;
+    double amount = 0.0;
+    int msizeX = 0, msizeY = 0;
 
-	if (amount!=0.0 && msizeX && msizeY) {
+    TC_MODULE_SELF_CHECK(self, "configure");
+    TC_MODULE_SELF_CHECK(vob, "configure");
 
-	    msizeX = 1 | TC_CLAMP(msizeX, MIN_MATRIX_SIZE, MAX_MATRIX_SIZE);
-	    msizeY = 1 | TC_CLAMP(msizeY, MIN_MATRIX_SIZE, MAX_MATRIX_SIZE);
-	    mfd->lumaParam.msizeX = msizeX;
-	    mfd->lumaParam.msizeY = msizeY;
-	    mfd->chromaParam.msizeX = msizeX;
-	    mfd->chromaParam.msizeY = msizeY;
+    mfd = self->userdata;
 
-	    mfd->lumaParam.amount = mfd->chromaParam.amount = amount;
+    if (vob->im_v_codec != CODEC_YUV) {
+        tc_log_error(MOD_NAME, "This filter is only capable of YUV mode");
+        return TC_ERROR;
+    }
 
-	} else {
+    /* the scratch spaces are sized after the old settings */
+    unsharp_stop(self);
+    memset(&mfd->lumaParam, 0, sizeof(mfd->lumaParam));
+    memset(&mfd->chromaParam, 0, sizeof(mfd->chromaParam));
+    mfd->pre = 0;
 
-	    // min/max & odd
-	    mfd->lumaParam.msizeX   = 1 | TC_CLAMP(mfd->lumaParam.msizeX, MIN_MATRIX_SIZE, MAX_MATRIX_SIZE);
-	    mfd->lumaParam.msizeY   = 1 | TC_CLAMP(mfd->lumaParam.msizeY, MIN_MATRIX_SIZE, MAX_MATRIX_SIZE);
-	    mfd->chromaParam.msizeX = 1 | TC_CLAMP(mfd->chromaParam.msizeX, MIN_MATRIX_SIZE, MAX_MATRIX_SIZE);
-	    mfd->chromaParam.msizeY = 1 | TC_CLAMP(mfd->chromaParam.msizeY, MIN_MATRIX_SIZE, MAX_MATRIX_SIZE);
-	}
-    }
+    // GET OPTIONS
+    if (options) {
+
+        // l7x5:0.8:c3x3:-0.2
+
+        if (optstr_lookup(options, "help")) {
+            help_optstr();
+        }
 
-    if (mfd->pre) {
-	width  = vob->im_v_width;
-	height = vob->im_v_height;
-    } else {
-	width  = vob->ex_v_width;
-	height = vob->ex_v_height;
+        optstr_get(options, "amount",        "%lf",   &amount);
+        optstr_get(options, "matrix",        "%dx%d", &msizeX, &msizeY);
+        optstr_get(options, "luma",          "%lf",   &mfd->lumaParam.amount);
+        optstr_get(options, "luma_matrix",   "%dx%d", &mfd->lumaParam.msizeX, &mfd->lumaParam.msizeY);
+        optstr_get(options, "chroma",        "%lf",   &mfd->chromaParam.amount);
+        optstr_get(options, "chroma_matrix", "%dx%d", &mfd->chromaParam.msizeX, &mfd->chromaParam.msizeY);
+        optstr_get(options, "pre",           "%d",    &mfd->pre);
+
+        if (amount != 0.0 && msizeX && msizeY) {
+            msizeX = 1 | TC_CLAMP(msizeX, MIN_MATRIX_SIZE, MAX_MATRIX_SIZE);
+            msizeY = 1 | TC_CLAMP(msizeY, MIN_MATRIX_SIZE, MAX_MATRIX_SIZE);
+            mfd->lumaParam.msizeX = msizeX;
+            mfd->lumaParam.msizeY = msizeY;
+            mfd->chromaParam.msizeX = msizeX;
+            mfd->chromaParam.msizeY = msizeY;
+
+            mfd->lumaParam.amount = mfd->chromaParam.amount = amount;
+        } else {
+            // min/max & odd
+            mfd->lumaParam.msizeX   = 1 | TC_CLAMP(mfd->lumaParam.msizeX, MIN_MATRIX_SIZE, MAX_MATRIX_SIZE);
+            mfd->lumaParam.msizeY   = 1 | TC_CLAMP(mfd->lumaParam.msizeY, MIN_MATRIX_SIZE, MAX_MATRIX_SIZE);
+            mfd->chromaParam.msizeX = 1 | TC_CLAMP(mfd->chromaParam.msizeX, MIN_MATRIX_SIZE, MAX_MATRIX_SIZE);
+            mfd->chromaParam.msizeY = 1 | TC_CLAMP(mfd->chromaParam.msizeY, MIN_MATRIX_SIZE, MAX_MATRIX_SIZE);
+        }
     }
 
-    // allocate buffers
+    mfd->width  = (mfd->pre) ?vob->im_v_width  :vob->ex_v_width;
+    mfd->height = (mfd->pre) ?vob->im_v_height :vob->ex_v_height;
 
     fp = &mfd->lumaParam;
     effect = fp->amount == 0 ? "don't touch" : fp->amount < 0 ? "blur" : "sharpen";
     tc_log_info(MOD_NAME, "unsharp: %dx%d:%0.2f (%s luma)",
-                    fp->msizeX, fp->msizeY, fp->amount, effect );
-    memset( fp->SC, 0, sizeof( fp->SC ) );
-    stepsX = fp->msizeX/2;
-    stepsY = fp->msizeY/2;
-    for( z=0; z<2*stepsY; z++ )
-        {
-	fp->SC[z] = tc_bufalloc(sizeof(*(fp->SC[z])) * (width+2*stepsX));
-        }
+                fp->msizeX, fp->msizeY, fp->amount, effect);
 
     fp = &mfd->chromaParam;
     effect = fp->amount == 0 ? "don't touch" : fp->amount < 0 ? "blur" : "sharpen";
     tc_log_info(MOD_NAME, "unsharp: %dx%d:%0.2f (%s chroma)",
-                    fp->msizeX, fp->msizeY, fp->amount, effect );
-    memset( fp->SC, 0, sizeof( fp->SC ) );
-    stepsX = fp->msizeX/2;
-    stepsY = fp->msizeY/2;
-    for( z=0; z<2*stepsY; z++ )
-        {
-	fp->SC[z] = tc_bufalloc(sizeof(*(fp->SC[z])) * (width+2*stepsX));
-        }
+                fp->msizeX, fp->msizeY, fp->amount, effect);
+
+    // allocate buffers for the first frame, more come on demand
+    work = get_work(mfd);
+    if (!work) {
+        tc_log_error(MOD_NAME, "out of memory");
+        return TC_ERROR;
+    }
+    put_work(mfd, work);
+    return TC_OK;
+}
 
+/*************************************************************************/
 
-    if(verbose) tc_log_info(MOD_NAME, "%s %s", MOD_VERSION, MOD_CAP);
-    return 0;
-  }
+/**
+ * unsharp_inspect:  Return the value of an option in this instance of
+ * the module.  See tcmodule-data.h for function details.
+ */
+
+static int unsharp_inspect(TCModuleInstance *self,
+                           const char *param, const char **value)
+{
+    MyFilterData *mfd = NULL;
+
+    TC_MODULE_SELF_CHECK(self, "inspect");
+    TC_MODULE_SELF_CHECK(param, "inspect");
+    TC_MODULE_SELF_CHECK(value, "inspect");
+
+    mfd = self->userdata;
+
+    if (optstr_lookup(param, "help")) {
+        *value = unsharp_help;
+    }
+    if (optstr_lookup(param, "luma")) {
+        tc_snprintf(mfd->conf_str, sizeof(mfd->conf_str),
+                    "luma=%f", mfd->lumaParam.amount);
+        *value = mfd->conf_str;
+    }
+    if (optstr_lookup(param, "chroma")) {
+        tc_snprintf(mfd->conf_str, sizeof(mfd->conf_str),
+                    "chroma=%f", mfd->chromaParam.amount);
+        *value = mfd->conf_str;
+    }
+    if (optstr_lookup(param, "luma_matrix")) {
+        tc_snprintf(mfd->conf_str, sizeof(mfd->conf_str),
+                    "luma_matrix=%ix%i",
+                    mfd->lumaParam.msizeX, mfd->lumaParam.msizeY);
+        *value = mfd->conf_str;
+    }
+    if (optstr_lookup(param, "chroma_matrix")) {
+        tc_snprintf(mfd->conf_str, sizeof(mfd->conf_str),
+                    "chroma_matrix=%ix%i",
+                    mfd->chromaParam.msizeX, mfd->chromaParam.msizeY);
+        *value = mfd->conf_str;
+    }
+    if (optstr_lookup(param, "pre")) {
+        tc_snprintf(mfd->conf_str, sizeof(mfd->conf_str),
+                    "pre=%i", mfd->pre);
+        *value = mfd->conf_str;
+    }
+    return TC_OK;
+}
+
+/*************************************************************************/
+
+/**
+ * unsharp_filter_video:  sharpen or blur the frame.  Several frames may
+ * be in here at once, each one using its own scratch space.  See
+ * tcmodule-data.h for function details.
+ */
+
+static int unsharp_filter_video(TCModuleInstance *self,
+                                vframe_list_t *ptr)
+{
+    MyFilterData *mfd = NULL;
+    MyFilterWork *work = NULL;
+    int off = 0, h2 = 0, w2 = 0;
+    char *buffer = NULL;
+
+    TC_MODULE_SELF_CHECK(self, "filter");
+    TC_MODULE_SELF_CHECK(ptr, "filter");
+
+    mfd = self->userdata;
+
+    if (!mfd->lumaParam.msizeX && !mfd->chromaParam.msizeX) {
+        return TC_OK; // nothing to do
+    }
+
+    if (ptr->v_width > mfd->width || ptr->v_height > mfd->height) {
+        tc_log_error(MOD_NAME, "frame larger than configured (%ix%i > %ix%i)",
+                     ptr->v_width, ptr->v_height, mfd->width, mfd->height);
+        return TC_ERROR;
+    }
+
+    off = ptr->v_width * ptr->v_height;
+    h2  = ptr->v_height >> 1;
+    w2  = ptr->v_width >> 1;
+
+    work = get_work(mfd);
+    if (!work) {
+        tc_log_error(MOD_NAME, "out of memory");
+        return TC_ERROR;
+    }
+    buffer = work->buffer;
 
+    ac_memcpy(buffer, ptr->video_buf, off + 2*w2*h2);
 
-  if (ptr->tag & TC_FILTER_CLOSE) {
-      unsigned int z;
-      FilterParam *fp;
+    unsharp(ptr->video_buf, buffer, ptr->v_width, ptr->v_width, ptr->v_width, ptr->v_height, &work->lumaParam);
 
-      if( !mfd ) return -1;
+    unsharp(ptr->video_buf+off, buffer+off, w2, w2, w2, h2, &work->chromaParam);
 
-      fp = &mfd->lumaParam;
-      for( z=0; z<sizeof(fp->SC)/sizeof(fp->SC[0]); z++ ) {
-          tc_buffree(fp->SC[z]);
-	  fp->SC[z] = NULL;
-      }
-      fp = &mfd->chromaParam;
-      for( z=0; z<sizeof(fp->SC)/sizeof(fp->SC[0]); z++ ) {
-          tc_buffree(fp->SC[z]);
-	  fp->SC[z] = NULL;
-      }
+    unsharp(ptr->video_buf+5*off/4, buffer+5*off/4, w2, w2, w2, h2, &work->chromaParam);
 
-      free( mfd );
-      mfd = NULL;
-      return 0;
-  }
+    put_work(mfd, work);
+    return TC_OK;
+}
 
+/*************************************************************************/
 
-  if( mfd && !mfd->lumaParam.msizeX && !mfd->chromaParam.msizeX ) {
-      return 0; // nothing to do
-  }
+static const TCCodecID unsharp_codecs_in[] = {
+    TC_CODEC_YUV420P, TC_CODEC_ERROR
+};
+static const TCCodecID unsharp_codecs_out[] = {
+    TC_CODEC_YUV420P, TC_CODEC_ERROR
+};
+TC_MODULE_FILTER_FORMATS(unsharp);
 
+TC_MODULE_INFO(unsharp);
 
-  if(((ptr->tag & TC_PRE_M_PROCESS  && mfd->pre) ||
-	  (ptr->tag & TC_POST_M_PROCESS && !mfd->pre)) &&
-	  !(ptr->attributes & TC_FRAME_IS_SKIPPED)) {
+static const TCModuleClass unsharp_class = {
+    TC_MODULE_CLASS_HEAD(unsharp),
 
-      int off = ptr->v_width * ptr->v_height;
-      int h2  = ptr->v_height>>1, w2 = ptr->v_width>>1;
+    .init         = unsharp_init,
+    .fini         = unsharp_fini,
+    .configure    = unsharp_configure,
+    .stop         = unsharp_stop,
+    .inspect      = unsharp_inspect,
 
-      ac_memcpy (buffer, ptr->video_buf, ptr->video_size);
+    .filter_video = unsharp_filter_video,
+};
 
-      unsharp( ptr->video_buf, buffer, ptr->v_width, ptr->v_width, ptr->v_width,   ptr->v_height,   &mfd->lumaParam );
+TC_MODULE_ENTRY_POINT(unsharp)
 
-      unsharp( ptr->video_buf+off, buffer+off, w2, w2, w2, h2, &mfd->chromaParam );
+/*************************************************************************/
 
-      unsharp( ptr->video_buf+5*off/4, buffer+5*off/4, w2, w2, w2, h2, &mfd->chromaParam );
+static int unsharp_get_config(TCModuleInstance *self, char *options)
+{
+    TC_MODULE_SELF_CHECK(self, "get_config");
+
+    optstr_filter_desc(options, MOD_NAME, MOD_CAP, MOD_VERSION,
+                       MOD_AUTHOR, "VYOP", "1");
+
+    optstr_param(options, "amount", "Luma and chroma (un)sharpness amount",
+                 "%f", "0.0", "-2.0", "2.0");
+    optstr_param(options, "matrix", "Luma and chroma search matrix size",
+                 "%dx%d", "0x0", "3", "63", "3", "63");
+    optstr_param(options, "luma", "Luma (un)sharpness amount",
+                 "%f", "0.0", "-2.0", "2.0");
+    optstr_param(options, "chroma", "Chroma (un)sharpness amount",
+                 "%f", "0.0", "-2.0", "2.0");
+    optstr_param(options, "luma_matrix", "Luma search matrix size",
+                 "%dx%d", "0x0", "3", "63", "3", "63");
+    optstr_param(options, "chroma_matrix", "Chroma search matrix size",
+                 "%dx%d", "0x0", "3", "63", "3", "63");
+    optstr_param(options, "pre", "run as a pre filter",
+                 "%d", "0", "0", "1");
+
+    return TC_OK;
+}
 
-      return 0;
-  }
+static int unsharp_process(TCModuleInstance *self, frame_list_t *frame)
+{
+    MyFilterData *mfd = NULL;
 
-  return 0;
+    TC_MODULE_SELF_CHECK(self, "process");
 
-} // tc_filter
+    mfd = self->userdata;
 
+    if ((frame->tag & TC_VIDEO) && !(frame->attributes & TC_FRAME_IS_SKIPPED)
+       && (((frame->tag & TC_POST_M_PROCESS) && !mfd->pre)
+         || ((frame->tag & TC_PRE_M_PROCESS) && mfd->pre))) {
+        return unsharp_filter_video(self, (vframe_list_t*)frame);
+    }
+    return TC_OK;
+}
+
+/*************************************************************************/
+
+/* Old-fashioned module interface. */
+
+TC_FILTER_OLDINTERFACE_M(unsharp)
+
+/*************************************************************************/
+
+/*
+ * Local variables:
+ *   c-file-style: "stroustrup"
+ *   c-file-offsets: ((case-label . *) (statement-case-intro . *))
+ *   indent-tabs-mode: nil
+ * End:
+ *
+ * vim: expandtab shiftwidth=4:
+ */
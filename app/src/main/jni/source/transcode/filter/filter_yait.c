@@ -267,6 +267,7 @@ static int
 yait_init( char *opt )
 	{
 	static vob_t *vob;
+	const TCFrameSpecs *specs;
 	char buf[256], *fn;
 	const char *p;
 	int n;
@@ -367,16 +368,16 @@ yait_init( char *opt )
 		vob->ex_fps = NTSC_FILM;
 		}
 
-	Fbuf = tc_malloc( SIZE_RGB_FRAME );
+	/* holds a whole frame buffer (see ptr->video_size) */
+	specs = tc_framebuffer_get_specs();
+	Fbuf = tc_zalloc( tc_video_frame_size(specs->width, specs->height, specs->format) );
 	if( !Fbuf )
 		{
-		perror( "tc_malloc" );
+		perror( "tc_zalloc" );
 		tc_log_error( MOD_NAME, "cannot allocate frame buffer" );
 		return( -1 );
 		}
 
-	memset( Fbuf, 0, SIZE_RGB_FRAME );
-
 	Fn = -1;
 
 	return( 0 );
@@ -22,18 +22,21 @@
  *
  * Typical call:
  * transcode -J transform -i inp.mpeg -y xdiv,tcaud inp_stab.avi
+ * or in a single pass (without running stabilize before):
+ * transcode -J transform=lookahead=15 -i inp.mpeg -y xdiv,tcaud inp_stab.avi
 */
 
 #define MOD_NAME    "filter_transform.so"
-#define MOD_VERSION "v0.80 (2011-11-13)"
+#define MOD_VERSION "v0.82 (2026-10-17)"
 #define MOD_CAP     "transforms each frame according to transformations\n\
- given in an input file (e.g. translation, rotate) see also filter stabilize"
+ given in an input file (e.g. translation, rotate) see also filter stabilize\n\
+ or found by its own motion detection (single-pass mode)"
 #define MOD_AUTHOR  "Georg Martius"
 
 #define MOD_FEATURES \
     TC_MODULE_FEATURE_FILTER|TC_MODULE_FEATURE_VIDEO
 #define MOD_FLAGS \
-    TC_MODULE_FLAG_RECONFIGURABLE
+    TC_MODULE_FLAG_RECONFIGURABLE | TC_MODULE_FLAG_DELAY
   
 #include "transcode.h"
 #include "filter.h"
@@ -42,13 +45,38 @@
 #include "libtc/optstr.h"
 #include "libtc/tccodecs.h"
 #include "libtc/tcmodule-plugin.h"
+#include "libtc/tcworkers.h"
 #include "transform.h"
+#include "motiondetect.h"
 
 #include <math.h>
 #include <libgen.h>
+#include <unistd.h>
+
+#ifdef HAVE_ASM_SSE2
+/* use SSE2 for the bi-linear and bi-cubic warping kernels */
+#define USE_SSE2_WARP
+#include <emmintrin.h>
+#endif
 
 #define DEFAULT_TRANS_FILE_NAME     "transforms.dat"
 
+/* upper limit of the lookahead option; single-pass mode keeps
+ * lookahead+1 frames in memory */
+#define LOOKAHEAD_MAX 100
+
+/* source coordinates in the warping engine are fixed point numbers
+ * with WARP_SHIFT fractional bits */
+#define WARP_SHIFT 16
+#define WARP_ONE   (1 << WARP_SHIFT)
+/* interpolation weights have WARP_WBITS bits, such that a weighted sum
+ * of two pixels still fits into a signed 16 bit value */
+#define WARP_WBITS 7
+#define WARP_W     (1 << WARP_WBITS)
+/* maximal number of threads and minimal number of rows per thread */
+#define WARP_MAX_THREADS 16
+#define WARP_MIN_ROWS    16
+
 #define PIXEL(img, x, y, w, h, def) ((x) < 0 || (y) < 0) ? def       \
     : (((x) >=w || (y) >= h) ? def : img[(x) + (y) * w]) 
 #define PIX(img, x, y, w, h) (img[(x) + (y) * w]) 
@@ -56,10 +84,36 @@
 #define PIXELN(img, x, y, w, h, N,channel , def) ((x) < 0 || (y) < 0) ? def  \
     : (((x) >=w || (y) >= h) ? def : img[((x) + (y) * w)*N + channel]) 
 
-typedef struct {
+/* one image plane to be warped, see warpRows */
+typedef struct _warp_plane {
+    const unsigned char* src;
+    int sw, sh;           // source dimension (row length is sw*bpp)
+    unsigned char* dst;
+    int dw, dh;           // destination dimension
+    int bpp;              // bytes per pixel: 1 (YUV planes) or 3 (RGB)
+    /* source position of the destination pixel x,y:
+     *   x_s = x0 + x*xx + y*xy,  y_s = y0 + x*yx + y*yy
+     */
+    double x0, y0, xx, xy, yx, yy;
+    int translate;        // 1: only shift by tx,ty (no interpolation)
+    int tx, ty;
+    unsigned char def;    // background color if we crop
+} WarpPlane;
+
+typedef struct _transform_data TransformData;
+
+/* one warp job: the planes are split into the same horizontal slices */
+typedef struct _warp_job {
+    TransformData* td;
+    const WarpPlane* planes;
+    int nplanes;
+} WarpJob;
+
+struct _transform_data {
     size_t framesize_src;  // size of frame buffer in bytes (src)
     size_t framesize_dest; // size of frame buffer in bytes (dest)
-    unsigned char* src;  // copy of the current frame buffer
+    unsigned char* src;  // current frame (the copy or the frame buffer)
+    unsigned char* srccopy; // copy of the current frame buffer
     unsigned char* dest; // pointer to the current frame buffer (to overwrite)
 
     vob_t* vob;          // pointer to information structure
@@ -91,11 +145,33 @@ typedef struct {
     int interpoltype; // type of interpolation: 0->Zero,1->Lin,2->BiLin,3->Sqr
     double sharpen;   // amount of sharpening
 
+    int threads;      // number of threads used for warping
+
+    /* single-pass mode: number of frames the motion detection runs ahead
+     * of the transformation (0: read the transforms from the input file)
+     */
+    int lookahead;
+    StabData md;          // motion detection (see motiondetect.h)
+    unsigned char* frames; // the last lookahead+1 frames (ring)
+    Transform* ahead;     // their relative transforms (ring of 2*lookahead+2)
+    int frames_in;        // number of frames analysed so far
+    /* state of the sliding average, see preprocess_transforms */
+    Transform s_sum;
+    Transform avg2;
+    Transform last;       // absolute transform of the last frame
+
+    /* bi-cubic weights for each fractional position (WARP_WBITS bits) */
+    short bicub_weights[WARP_W][4];
+
+    /* slice threads (see runWarp), also used by the motion detection;
+     * NULL for just the calling thread */
+    TCWorkers* workers;
+
     char input[TC_BUF_LINE];
     FILE* f;
 
     char conf_str[TC_BUF_MIN];
-} TransformData;
+};
 
 static const char* interpoltypes[5] = {"No (0)", "Linear (1)", "Bi-Linear (2)", 
                                        "Quadratic (3)", "Bi-Cubic (4)"};
@@ -125,6 +201,14 @@ static const char transform_help[] = ""
     "                3: quadratic 4: bi-cubic\n"
     "    'sharpen'   amount of sharpening: 0: no sharpening (def: 0.8)\n"
     "                uses filter unsharp with 5x5 matrix\n"
+    "    'threads'   number of threads (def: number of CPUs)\n"
+    "    'lookahead' single-pass mode: the frames are analysed here and\n"
+    "                the transformation runs this many frames behind\n"
+    "                (>= smoothing). The output is 'lookahead' frames\n"
+    "                shorter, optzoom is not available\n"
+    "                (def: 0 off, max: 100)\n"
+    "    'shakiness', 'accuracy', 'stepsize', 'mincontrast'\n"
+    "                motion detection in single-pass mode, see stabilize\n"
     "    'help'      print this help message\n";
 
 /* forward deklarations, please look below for documentation*/
@@ -143,10 +227,17 @@ void interpolateZero(unsigned char *rv, float x, float y,
 void interpolateN(unsigned char *rv, float x, float y, 
                   unsigned char* img, int width, int height, 
                   unsigned char N, unsigned char channel, unsigned char def);
-int transformRGB(TransformData* td);
-int transformYUV(TransformData* td);
+void initBiCubWeights(TransformData* td);
+void warpRows(TransformData* td, const WarpPlane* p, int y0, int y1);
+void runWarp(TransformData* td, WarpPlane* planes, int nplanes);
+int startWarpThreads(TransformData* td);
+void stopWarpThreads(TransformData* td);
+int transformRGB(TransformData* td, Transform t);
+int transformYUV(TransformData* td, Transform t);
 int read_input_file(TransformData* td);
 int preprocess_transforms(TransformData* td);
+Transform lookahead_transform(TransformData* td, int i);
+int lookahead_frame(TransformData* td, vframe_list_t* frame);
 
 
 /** 
@@ -340,107 +431,440 @@ void interpolateN(unsigned char *rv, float x, float y,
 }
 
 
+/*************************************************************************/
+
+/* Warping engine: every destination row is walked with incrementally
+ * stepped fixed point source coordinates. The part of the row whose
+ * source neighbourhood lies completely inside the image is done by
+ * a kernel without any range checks; only the pixels near and outside
+ * the border use the interpolate functions above.
+ */
+
+/**
+ * initBiCubWeights: calculates the weights of bicub_kernel for all
+ *  fractional positions with WARP_WBITS bits (they sum up to WARP_W).
+ */
+void initBiCubWeights(TransformData* td)
+{
+    int i, k;
+    for (i = 0; i < WARP_W; i++) {
+        double t = (double)i / WARP_W;
+        double w[4];
+        int sum = 0;
+        w[0] = (-t + 2*t*t - t*t*t) / 2;
+        w[1] = (2 - 5*t*t + 3*t*t*t) / 2;
+        w[2] = (t + 4*t*t - 3*t*t*t) / 2;
+        w[3] = (-t*t + t*t*t) / 2;
+        for (k = 0; k < 4; k++) {
+            td->bicub_weights[i][k] = (short)floor(w[k] * WARP_W + 0.5);
+            sum += td->bicub_weights[i][k];
+        }
+        // put the rounding error on the larger of the inner weights
+        td->bicub_weights[i][i < WARP_W/2 ? 1 : 2] += WARP_W - sum;
+    }
+}
+
+/* floor(a/b) for b > 0 */
+static int64_t warp_floordiv(int64_t a, int64_t b)
+{
+    return a >= 0 ? a / b : -((-a + b - 1) / b);
+}
+
+/**
+ * warpSpan: finds the positions x in [0,n) with lo <= c + x*dc < hi.
+ *  As c + x*dc is linear in x they form an interval [*a,*b)
+ *  (which is empty if *a >= *b).
+ */
+static void warpSpan(int64_t c, int64_t dc, int64_t lo, int64_t hi, int n,
+                     int* a, int* b)
+{
+    int64_t first, last;
+    if (dc == 0) {
+        *a = 0;
+        *b = (c >= lo && c < hi) ? n : 0;
+        return;
+    }
+    if (dc < 0) { // mirror: lo <= c + x*dc < hi <=> 1-hi <= -c - x*dc < 1-lo
+        int64_t tmp = lo;
+        lo = 1 - hi;
+        hi = 1 - tmp;
+        c  = -c;
+        dc = -dc;
+    }
+    first = -warp_floordiv(c - lo, dc);       // ceil((lo - c) / dc)
+    last  = -warp_floordiv(c - hi, dc);       // ceil((hi - c) / dc)
+    *a = (int)TC_CLAMP(first, 0, n);
+    *b = (int)TC_CLAMP(last, 0, n);
+}
+
+/** warpZero: nearest neighbor kernel for the inner part of a row */
+static void warpZero(unsigned char* d, const unsigned char* s, int stride,
+                     int32_t X, int32_t Y, int32_t dX, int32_t dY, int n)
+{
+    int x;
+    X += WARP_ONE/2;
+    Y += WARP_ONE/2;
+    for (x = 0; x < n; x++, X += dX, Y += dY)
+        d[x] = s[(Y >> WARP_SHIFT) * stride + (X >> WARP_SHIFT)];
+}
+
+/** warpBiLin: bi-linear kernel for the inner part of a row */
+static void warpBiLin(unsigned char* d, const unsigned char* s, int stride,
+                      int32_t X, int32_t Y, int32_t dX, int32_t dY, int n)
+{
+    int x = 0;
+#ifdef USE_SSE2_WARP
+    /* 4 pixels at a time: the two pixels of each row are weighted
+     * with one madd, the two rows with a second one */
+    const __m128i round = _mm_set1_epi32(1 << (2*WARP_WBITS - 1));
+    for (; x + 4 <= n; x += 4) {
+        int32_t top[4], bot[4], wx[4], wy[4];
+        int k;
+        for (k = 0; k < 4; k++, X += dX, Y += dY) {
+            const unsigned char* p = s + (Y >> WARP_SHIFT) * stride
+                + (X >> WARP_SHIFT);
+            int fx = (X >> (WARP_SHIFT - WARP_WBITS)) & (WARP_W - 1);
+            int fy = (Y >> (WARP_SHIFT - WARP_WBITS)) & (WARP_W - 1);
+            top[k] = p[0] | (p[1] << 16);
+            bot[k] = p[stride] | (p[stride + 1] << 16);
+            wx[k]  = (WARP_W - fx) | (fx << 16);
+            wy[k]  = (WARP_W - fy) | (fy << 16);
+        }
+        __m128i xmmwx = _mm_loadu_si128((const __m128i*)wx);
+        __m128i xmmt  = _mm_madd_epi16(_mm_loadu_si128((const __m128i*)top),
+                                       xmmwx);
+        __m128i xmmb  = _mm_madd_epi16(_mm_loadu_si128((const __m128i*)bot),
+                                       xmmwx);
+        __m128i xmmv  = _mm_madd_epi16(_mm_or_si128(xmmt,
+                                                    _mm_slli_epi32(xmmb, 16)),
+                                       _mm_loadu_si128((const __m128i*)wy));
+        xmmv = _mm_srli_epi32(_mm_add_epi32(xmmv, round), 2*WARP_WBITS);
+        xmmv = _mm_packs_epi32(xmmv, xmmv);
+        xmmv = _mm_packus_epi16(xmmv, xmmv);
+        int32_t v = _mm_cvtsi128_si32(xmmv);
+        memcpy(d + x, &v, 4);
+    }
+#endif
+    for (; x < n; x++, X += dX, Y += dY) {
+        const unsigned char* p = s + (Y >> WARP_SHIFT) * stride
+            + (X >> WARP_SHIFT);
+        int fx = (X >> (WARP_SHIFT - WARP_WBITS)) & (WARP_W - 1);
+        int fy = (Y >> (WARP_SHIFT - WARP_WBITS)) & (WARP_W - 1);
+        int top = p[0] * (WARP_W - fx) + p[1] * fx;
+        int bot = p[stride] * (WARP_W - fx) + p[stride + 1] * fx;
+        d[x] = (top * (WARP_W - fy) + bot * fy
+                + (1 << (2*WARP_WBITS - 1))) >> (2*WARP_WBITS);
+    }
+}
+
+/** warpBiLinN: bi-linear kernel for the inner part of a row
+ *  of an N channel image */
+static void warpBiLinN(unsigned char* d, const unsigned char* s, int stride,
+                       int32_t X, int32_t Y, int32_t dX, int32_t dY, int n,
+                       int N)
+{
+    int x, c;
+    for (x = 0; x < n; x++, X += dX, Y += dY, d += N) {
+        const unsigned char* p = s + (Y >> WARP_SHIFT) * stride
+            + (X >> WARP_SHIFT) * N;
+        int fx = (X >> (WARP_SHIFT - WARP_WBITS)) & (WARP_W - 1);
+        int fy = (Y >> (WARP_SHIFT - WARP_WBITS)) & (WARP_W - 1);
+        for (c = 0; c < N; c++) {
+            int top = p[c] * (WARP_W - fx) + p[c + N] * fx;
+            int bot = p[stride + c] * (WARP_W - fx) + p[stride + c + N] * fx;
+            d[c] = (top * (WARP_W - fy) + bot * fy
+                    + (1 << (2*WARP_WBITS - 1))) >> (2*WARP_WBITS);
+        }
+    }
+}
+
+/** warpBiCub: bi-cubic kernel (4x4 pixels) for the inner part of a row */
+static void warpBiCub(unsigned char* d, const unsigned char* s, int stride,
+                      short (*w)[4],
+                      int32_t X, int32_t Y, int32_t dX, int32_t dY, int n)
+{
+    int x;
+#ifdef USE_SSE2_WARP
+    const __m128i zero  = _mm_setzero_si128();
+    const __m128i round = _mm_set1_epi32(WARP_W/2);
+#endif
+    for (x = 0; x < n; x++, X += dX, Y += dY) {
+        const unsigned char* p = s + ((Y >> WARP_SHIFT) - 1) * stride
+            + (X >> WARP_SHIFT) - 1;
+        const short* wx = w[(X >> (WARP_SHIFT - WARP_WBITS)) & (WARP_W - 1)];
+        const short* wy = w[(Y >> (WARP_SHIFT - WARP_WBITS)) & (WARP_W - 1)];
+#ifdef USE_SSE2_WARP
+        /* the 4 rows are weighted horizontally with two madds,
+         * the 4 row values vertically with a third one */
+        int32_t r0, r1, r2, r3;
+        memcpy(&r0, p, 4);
+        memcpy(&r1, p + stride, 4);
+        memcpy(&r2, p + 2*stride, 4);
+        memcpy(&r3, p + 3*stride, 4);
+        __m128i rows  = _mm_setr_epi32(r0, r1, r2, r3);
+        __m128i xmmwx = _mm_loadl_epi64((const __m128i*)wx);
+        __m128i xmmwy = _mm_loadl_epi64((const __m128i*)wy);
+        xmmwx = _mm_unpacklo_epi64(xmmwx, xmmwx);
+        __m128i s01 = _mm_madd_epi16(_mm_unpacklo_epi8(rows, zero), xmmwx);
+        __m128i s23 = _mm_madd_epi16(_mm_unpackhi_epi8(rows, zero), xmmwx);
+        __m128 ev = _mm_shuffle_ps(_mm_castsi128_ps(s01), _mm_castsi128_ps(s23),
+                                   _MM_SHUFFLE(2, 0, 2, 0));
+        __m128 od = _mm_shuffle_ps(_mm_castsi128_ps(s01), _mm_castsi128_ps(s23),
+                                   _MM_SHUFFLE(3, 1, 3, 1));
+        __m128i h = _mm_add_epi32(_mm_castps_si128(ev), _mm_castps_si128(od));
+        h = _mm_srai_epi32(_mm_add_epi32(h, round), WARP_WBITS);
+        h = _mm_madd_epi16(_mm_packs_epi32(h, h), xmmwy);
+        h = _mm_add_epi32(h, _mm_srli_si128(h, 4));
+        h = _mm_srai_epi32(_mm_add_epi32(h, round), WARP_WBITS);
+        h = _mm_packs_epi32(h, h);
+        d[x] = (unsigned char)_mm_cvtsi128_si32(_mm_packus_epi16(h, h));
+#else
+        int r, v = 0;
+        for (r = 0; r < 4; r++, p += stride) {
+            int h = p[0]*wx[0] + p[1]*wx[1] + p[2]*wx[2] + p[3]*wx[3];
+            v += ((h + WARP_W/2) >> WARP_WBITS) * wy[r];
+        }
+        v = (v + WARP_W/2) >> WARP_WBITS;
+        d[x] = v < 0 ? 0 : (v > 255 ? 255 : v);
+#endif
+    }
+}
+
+/** warpBorder: warps the pixels [x0,x1) of a row with the interpolate
+ *  functions that take care of the image border */
+static void warpBorder(TransformData* td, const WarpPlane* p, unsigned char* d,
+                       int64_t X, int64_t Y, int32_t dX, int32_t dY,
+                       int x0, int x1)
+{
+    int x, z;
+    unsigned char* img = (unsigned char*)p->src;
+    X += x0 * (int64_t)dX;
+    Y += x0 * (int64_t)dY;
+    for (x = x0; x < x1; x++, X += dX, Y += dY) {
+        float x_s = (float)X / WARP_ONE;
+        float y_s = (float)Y / WARP_ONE;
+        unsigned char* dest = d + x * p->bpp;
+        if (p->bpp == 1) {
+            interpolate(dest, x_s, y_s, img, p->sw, p->sh,
+                        td->crop ? p->def : *dest);
+        } else {
+            for (z = 0; z < p->bpp; z++) {
+                interpolateN(dest + z, x_s, y_s, img, p->sw, p->sh,
+                             p->bpp, z, td->crop ? p->def : dest[z]);
+            }
+        }
+    }
+}
+
+/**
+ * warpRows: applies the transformation of the plane to the rows [y0,y1)
+ *  of the destination.
+ */
+void warpRows(TransformData* td, const WarpPlane* p, int y0, int y1)
+{
+    int bpp = p->bpp;
+    int y;
+
+    if (p->translate) {
+        /* no rotation, no zooming, just translation
+         * (also no interpolation, since no size change) */
+        int x0 = TC_MAX(0, p->tx);
+        int x1 = TC_MIN(p->dw, p->sw + p->tx);
+        for (y = y0; y < y1; y++) {
+            unsigned char* d = p->dst + y * p->dw * bpp;
+            int sy = y - p->ty;
+            if (sy < 0 || sy >= p->sh || x1 <= x0) {
+                if (td->crop)
+                    memset(d, p->def, p->dw * bpp);
+                continue;
+            }
+            if (td->crop) {
+                memset(d, p->def, x0 * bpp);
+                memset(d + x1 * bpp, p->def, (p->dw - x1) * bpp);
+            }
+            memcpy(d + x0 * bpp, p->src + (sy * p->sw + x0 - p->tx) * bpp,
+                   (x1 - x0) * bpp);
+        }
+        return;
+    }
+
+    /* the inner part of a row: the source neighbourhood needed by the
+     * kernel is inside the image (the same test the interpolate
+     * functions do); lo is the margin left/top, hi right/bottom */
+    int lo = 0, hi = 1, fast = 1;
+    if (bpp == 1) {
+        switch (td->interpoltype) {
+          case 0:  lo = 0; hi = 0; break;
+          case 2:  lo = 0; hi = 1; break;
+          case 4:  lo = 1; hi = 2; break;
+          default: fast = 0; // the other ones are done pixel by pixel
+        }
+    }
+    int32_t dX = (int32_t)floor(p->xx * WARP_ONE + 0.5);
+    int32_t dY = (int32_t)floor(p->yx * WARP_ONE + 0.5);
+    int64_t half = td->interpoltype == 0 && bpp == 1 ? WARP_ONE/2 : 0;
+    for (y = y0; y < y1; y++) {
+        unsigned char* d = p->dst + y * p->dw * bpp;
+        int64_t X = (int64_t)floor((p->x0 + y * p->xy) * WARP_ONE + 0.5);
+        int64_t Y = (int64_t)floor((p->y0 + y * p->yy) * WARP_ONE + 0.5);
+        int a = 0, b = 0, a2, b2;
+        if (fast) {
+            warpSpan(X + half, dX, (int64_t)lo * WARP_ONE,
+                     (int64_t)(p->sw - hi) * WARP_ONE, p->dw, &a, &b);
+            warpSpan(Y + half, dY, (int64_t)lo * WARP_ONE,
+                     (int64_t)(p->sh - hi) * WARP_ONE, p->dw, &a2, &b2);
+            a = TC_MAX(a, a2);
+            b = TC_MAX(a, TC_MIN(b, b2));
+        }
+        warpBorder(td, p, d, X, Y, dX, dY, 0, a);
+        if (b > a) {
+            int32_t Xa = (int32_t)(X + a * (int64_t)dX);
+            int32_t Ya = (int32_t)(Y + a * (int64_t)dY);
+            int stride = p->sw * bpp;
+            if (bpp != 1)
+                warpBiLinN(d + a * bpp, p->src, stride, Xa, Ya, dX, dY,
+                           b - a, bpp);
+            else if (td->interpoltype == 0)
+                warpZero(d + a, p->src, stride, Xa, Ya, dX, dY, b - a);
+            else if (td->interpoltype == 2)
+                warpBiLin(d + a, p->src, stride, Xa, Ya, dX, dY, b - a);
+            else
+                warpBiCub(d + a, p->src, stride, td->bicub_weights,
+                          Xa, Ya, dX, dY, b - a);
+        }
+        warpBorder(td, p, d, X, Y, dX, dY, b, p->dw);
+    }
+}
+
+/**
+ * warpSlice: warps slice `slice' of `nslices' of all planes of the job.
+ */
+static void warpSlice(void* arg, int slice, int nslices)
+{
+    const WarpJob* job = arg;
+    int i;
+    for (i = 0; i < job->nplanes; i++) {
+        const WarpPlane* p = &job->planes[i];
+        warpRows(job->td, p, (int)((long)p->dh * slice / nslices),
+                 (int)((long)p->dh * (slice + 1) / nslices));
+    }
+}
+
+/**
+ * startWarpThreads: starts the pool of threads-1 slice threads (the
+ *  caller works as well). Returns 0 on failure.
+ */
+int startWarpThreads(TransformData* td)
+{
+    if (td->threads < 2)
+        return 1;
+    td->workers = tc_workers_new(td->threads);
+    if (!td->workers) {
+        tc_log_error(MOD_NAME, "cannot start slice threads");
+        return 0;
+    }
+    if (tc_workers_threads(td->workers) < td->threads)
+        tc_log_warn(MOD_NAME, "started only %i of %i threads",
+                    tc_workers_threads(td->workers), td->threads);
+    return 1;
+}
+
+void stopWarpThreads(TransformData* td)
+{
+    tc_workers_del(td->workers);
+    td->workers = NULL;
+}
+
+/**
+ * runWarp: warps the given planes, split into horizontal slices
+ *  on the slice threads and the calling thread.
+ */
+void runWarp(TransformData* td, WarpPlane* planes, int nplanes)
+{
+    int nslices = TC_MIN(tc_workers_threads(td->workers),
+                         planes[0].dh / WARP_MIN_ROWS);
+    WarpJob job;
+
+    job.td      = td;
+    job.planes  = planes;
+    job.nplanes = nplanes;
+    tc_workers_run(td->workers, warpSlice, &job, TC_MAX(1, nslices));
+}
+
 /** 
- * transformRGB: applies current transformation to frame
+ * transformRGB: applies the given transformation to frame
  * Parameters:
  *         td: private data structure of this filter
+ *          t: transformation
  * Return value: 
  *         0 for failture, 1 for success
  * Preconditions:
  *  The frame must be in RGB format
  */
-int transformRGB(TransformData* td)
+int transformRGB(TransformData* td, Transform t)
 {
-    Transform t;
-    int x = 0, y = 0, z = 0;
-    unsigned char *D_1, *D_2;
-    t = td->trans[td->current_trans];
-  
-    D_1  = td->src;  
-    D_2  = td->dest;  
+    WarpPlane p;
+
     float c_s_x = td->width_src/2.0;
     float c_s_y = td->height_src/2.0;
     float c_d_x = td->width_dest/2.0;
     float c_d_y = td->height_dest/2.0;    
 
+    float z = 1.0-t.zoom/100;
+    float zcos_a = z*cos(-t.alpha); // scaled cos
+    float zsin_a = z*sin(-t.alpha); // scaled sin
+
     /* for each pixel in the destination image we calc the source
      * coordinate and make an interpolation: 
      *      p_d = c_d + M(p_s - c_s) + t 
      * where p are the points, c the center coordinate, 
      *  _s source and _d destination, 
-     *  t the translation, and M the rotation matrix
+     *  t the translation, and M the rotation and scaling matrix
      *      p_s = M^{-1}(p_d - c_d - t) + c_s
      */
     /* All 3 channels */
-    if (fabs(t.alpha) > td->rotation_threshhold) {
-        for (x = 0; x < td->width_dest; x++) {
-            for (y = 0; y < td->height_dest; y++) {
-                float x_d1 = (x - c_d_x);
-                float y_d1 = (y - c_d_y);
-                float x_s  =  cos(-t.alpha) * x_d1 
-                    + sin(-t.alpha) * y_d1 + c_s_x -t.x;
-                float y_s  = -sin(-t.alpha) * x_d1 
-                    + cos(-t.alpha) * y_d1 + c_s_y -t.y;                
-                for (z = 0; z < 3; z++) { // iterate over colors 
-                    unsigned char* dest = &D_2[(x + y * td->width_dest)*3+z];
-                    interpolateN(dest, x_s, y_s, D_1, 
-                                 td->width_src, td->height_src, 
-                                 3, z, td->crop ? 16 : *dest);
-                }
-            }
-        }
-     }else { 
-        /* no rotation, just translation 
-         *(also no interpolation, since no size change (so far) 
-         */
-        int round_tx = myround(t.x);
-        int round_ty = myround(t.y);
-        for (x = 0; x < td->width_dest; x++) {
-            for (y = 0; y < td->height_dest; y++) {
-                for (z = 0; z < 3; z++) { // iterate over colors
-                    short p = PIXELN(D_1, x - round_tx, y - round_ty, 
-                                     td->width_src, td->height_src, 3, z, -1);
-                    if (p == -1) {
-                        if (td->crop == 1)
-                            D_2[(x + y * td->width_dest)*3+z] = 16;
-                    } else {
-                        D_2[(x + y * td->width_dest)*3+z] = (unsigned char)p;
-                    }
-                }
-            }
-        }
-    }
+    p.src = td->src;
+    p.sw  = td->width_src;
+    p.sh  = td->height_src;
+    p.dst = td->dest;
+    p.dw  = td->width_dest;
+    p.dh  = td->height_dest;
+    p.bpp = 3;
+    p.xx  =  zcos_a;
+    p.xy  =  zsin_a;
+    p.yx  = -zsin_a;
+    p.yy  =  zcos_a;
+    p.x0  = -zcos_a * c_d_x - zsin_a * c_d_y + c_s_x - t.x;
+    p.y0  =  zsin_a * c_d_x - zcos_a * c_d_y + c_s_y - t.y;
+    p.translate = !(fabs(t.alpha) > td->rotation_threshhold || t.zoom != 0);
+    p.tx  = myround(t.x);
+    p.ty  = myround(t.y);
+    p.def = 16;
+    runWarp(td, &p, 1);
     return 1;
 }
 
 /** 
- * transformYUV: applies current transformation to frame
+ * transformYUV: applies the given transformation to frame
  *
  * Parameters:
  *         td: private data structure of this filter
+ *          t: transformation
  * Return value: 
  *         0 for failture, 1 for success
  * Preconditions:
  *  The frame must be in YUV format
  */
-int transformYUV(TransformData* td)
+int transformYUV(TransformData* td, Transform t)
 {
-    Transform t;
-    int x = 0, y = 0;
-    unsigned char *Y_1, *Y_2, *Cb_1, *Cb_2, *Cr_1, *Cr_2;
-    t = td->trans[td->current_trans];
-  
-    Y_1  = td->src;  
-    Y_2  = td->dest;  
-    Cb_1 = td->src + td->width_src * td->height_src;
-    Cb_2 = td->dest + td->width_dest * td->height_dest;
-    Cr_1 = td->src + 5*td->width_src * td->height_src/4;
-    Cr_2 = td->dest + 5*td->width_dest * td->height_dest/4;
+    WarpPlane p[3];
+    int i;
+
     float c_s_x = td->width_src/2.0;
     float c_s_y = td->height_src/2.0;
     float c_d_x = td->width_dest/2.0;
     float c_d_y = td->height_dest/2.0;    
-    
+
     float z = 1.0-t.zoom/100;
     float zcos_a = z*cos(-t.alpha); // scaled cos
     float zsin_a = z*sin(-t.alpha); // scaled sin
@@ -453,85 +877,46 @@ int transformYUV(TransformData* td)
      *  t the translation, and M the rotation and scaling matrix
      *      p_s = M^{-1}(p_d - c_d - t) + c_s
      */
-    /* Luminance channel */
-    if (fabs(t.alpha) > td->rotation_threshhold || t.zoom != 0) {
-        for (x = 0; x < td->width_dest; x++) {
-            for (y = 0; y < td->height_dest; y++) {
-                float x_d1 = (x - c_d_x);
-                float y_d1 = (y - c_d_y);
-                float x_s  =  zcos_a * x_d1 
-                    + zsin_a * y_d1 + c_s_x -t.x;
-                float y_s  = -zsin_a * x_d1 
-                    + zcos_a * y_d1 + c_s_y -t.y;
-                unsigned char* dest = &Y_2[x + y * td->width_dest];
-                interpolate(dest, x_s, y_s, Y_1, 
-                            td->width_src, td->height_src, 
-                            td->crop ? 16 : *dest);
-            }
-        }
-     }else { 
-        /* no rotation, no zooming, just translation 
-         *(also no interpolation, since no size change) 
-         */
-        int round_tx = myround(t.x);
-        int round_ty = myround(t.y);
-        for (x = 0; x < td->width_dest; x++) {
-            for (y = 0; y < td->height_dest; y++) {
-                short p = PIXEL(Y_1, x - round_tx, y - round_ty, 
-                                td->width_src, td->height_src, -1);
-                if (p == -1) {
-                    if (td->crop == 1)
-                        Y_2[x + y * td->width_dest] = 16;
-                } else {
-                    Y_2[x + y * td->width_dest] = (unsigned char)p;
-                }
-            }
-        }
-    }
+    int translate = !(fabs(t.alpha) > td->rotation_threshhold || t.zoom != 0);
 
-    /* Color channels */
-    int ws2 = td->width_src/2;
-    int wd2 = td->width_dest/2;
-    int hs2 = td->height_src/2;
-    int hd2 = td->height_dest/2;
-    if (fabs(t.alpha) > td->rotation_threshhold || t.zoom != 0) {
-        for (x = 0; x < wd2; x++) {
-            for (y = 0; y < hd2; y++) {
-                float x_d1 = x - (c_d_x)/2;
-                float y_d1 = y - (c_d_y)/2;
-                float x_s  =  zcos_a * x_d1 
-                    + zsin_a * y_d1 + (c_s_x -t.x)/2;
-                float y_s  = -zsin_a * x_d1 
-                    + zcos_a * y_d1 + (c_s_y -t.y)/2;
-                unsigned char* dest = &Cr_2[x + y * wd2];
-                interpolate(dest, x_s, y_s, Cr_1, ws2, hs2, 
-                            td->crop ? 128 : *dest);
-                dest = &Cb_2[x + y * wd2];
-                interpolate(dest, x_s, y_s, Cb_1, ws2, hs2, 
-                            td->crop ? 128 : *dest);      	
-            }
-        }
-    } else { // no rotation, no zoom, no interpolation, just translation 
-        int round_tx2 = myround(t.x/2.0);
-        int round_ty2 = myround(t.y/2.0);        
-        for (x = 0; x < wd2; x++) {
-            for (y = 0; y < hd2; y++) {
-                short cr = PIXEL(Cr_1, x - round_tx2, y - round_ty2, 
-                                 wd2, hd2, -1);
-                short cb = PIXEL(Cb_1, x - round_tx2, y - round_ty2, 
-                                 wd2, hd2, -1);
-                if (cr == -1) {
-                    if (td->crop==1) { 
-                        Cr_2[x + y * wd2] = 128;
-                        Cb_2[x + y * wd2] = 128;
-                    }
-                } else {
-                    Cr_2[x + y * wd2] = (unsigned char)cr;
-                    Cb_2[x + y * wd2] = (unsigned char)cb;
-                }
-            }
-        }
+    /* Luminance channel */
+    p[0].src = td->src;
+    p[0].sw  = td->width_src;
+    p[0].sh  = td->height_src;
+    p[0].dst = td->dest;
+    p[0].dw  = td->width_dest;
+    p[0].dh  = td->height_dest;
+    p[0].x0  = -zcos_a * c_d_x - zsin_a * c_d_y + c_s_x - t.x;
+    p[0].y0  =  zsin_a * c_d_x - zcos_a * c_d_y + c_s_y - t.y;
+    p[0].tx  = myround(t.x);
+    p[0].ty  = myround(t.y);
+    p[0].def = 16;
+
+    /* Color channels: half the size, Cb plane follows Y, Cr follows Cb */
+    p[1].src = td->src + td->width_src * td->height_src;
+    p[1].sw  = td->width_src/2;
+    p[1].sh  = td->height_src/2;
+    p[1].dst = td->dest + td->width_dest * td->height_dest;
+    p[1].dw  = td->width_dest/2;
+    p[1].dh  = td->height_dest/2;
+    p[1].x0  = -zcos_a * c_d_x/2 - zsin_a * c_d_y/2 + (c_s_x - t.x)/2;
+    p[1].y0  =  zsin_a * c_d_x/2 - zcos_a * c_d_y/2 + (c_s_y - t.y)/2;
+    p[1].tx  = myround(t.x/2.0);
+    p[1].ty  = myround(t.y/2.0);
+    p[1].def = 128;
+    p[2] = p[1];
+    p[2].src = td->src + 5*td->width_src * td->height_src/4;
+    p[2].dst = td->dest + 5*td->width_dest * td->height_dest/4;
+
+    for (i = 0; i < 3; i++) {
+        p[i].bpp = 1;
+        p[i].xx  =  zcos_a;
+        p[i].xy  =  zsin_a;
+        p[i].yx  = -zsin_a;
+        p[i].yy  =  zcos_a;
+        p[i].translate = translate;
     }
+    runWarp(td, p, 3);
     return 1;
 }
 
@@ -739,6 +1124,119 @@ int preprocess_transforms(TransformData* td)
     return 1;
 }
 
+/**
+ * lookahead_transform: single-pass version of preprocess_transforms.
+ *  Calculates the transformation of frame i from the relative transforms
+ *  in the ring td->ahead, which has to contain those of the frames
+ *  i - smoothing - 1 to i + smoothing. Must be called for each frame
+ *  in order. The result is the same as of preprocess_transforms
+ *  (without optzoom) as long as there are enough frames after i.
+ *
+ * Parameters:
+ *            td: tranform private data structure
+ *             i: number of the frame
+ * Return value:
+ *     the absolute transformation to apply to frame i
+ */
+Transform lookahead_transform(TransformData* td, int i)
+{
+    int n = 2 * td->lookahead + 2;
+    Transform null = null_transform();
+    Transform t = td->ahead[i % n];
+    int k;
+
+    if (td->smoothing > 0) {
+        int s = td->smoothing * 2 + 1;
+        double tau = 1.0/(3 * s);
+        Transform avg;
+        if (i == 0) {
+            // same initialisation as in preprocess_transforms
+            td->s_sum = null;
+            td->avg2  = null;
+            for (k = 0; k < td->smoothing; k++)
+                td->s_sum = add_transforms(&td->s_sum, &td->ahead[k]);
+        }
+        Transform* old = ((i - td->smoothing - 1) < 0)
+            ? &null : &td->ahead[(i - td->smoothing - 1) % n];
+        td->s_sum = sub_transforms(&td->s_sum, old);
+        td->s_sum = add_transforms(&td->s_sum,
+                                   &td->ahead[(i + td->smoothing) % n]);
+        avg = mult_transform(&td->s_sum, 1.0/s);
+
+        t = sub_transforms(&t, &avg);
+        td->avg2 = add_transforms_(mult_transform(&td->avg2, 1 - tau),
+                                   mult_transform(&t, tau));
+        t = sub_transforms(&t, &td->avg2);
+    }
+    if (td->invert)
+        t = mult_transform(&t, -1);
+    /* relative to absolute */
+    if (i > 0)
+        t = add_transforms(&t, &td->last);
+    td->last = t;
+
+    if (td->maxshift != -1) {
+        t.x = TC_CLAMP(t.x, -td->maxshift, td->maxshift);
+        t.y = TC_CLAMP(t.y, -td->maxshift, td->maxshift);
+    }
+    if (td->maxangle != - 1.0)
+        t.alpha = TC_CLAMP(t.alpha, -td->maxangle, td->maxangle);
+    t.zoom += td->zoom;
+    return t;
+}
+
+/**
+ * lookahead_frame: single-pass mode. Analyses the given frame and keeps
+ *  a copy of it. The frame is then replaced by the one 'lookahead' frames
+ *  before, transformed with lookahead_transform. While the ring fills up
+ *  the frames are skipped, so the last 'lookahead' frames of the stream
+ *  never come out.
+ *
+ * Parameters:
+ *            td: tranform private data structure
+ *         frame: current frame
+ * Return value:
+ *     TC_OK or TC_ERROR
+ */
+int lookahead_frame(TransformData* td, vframe_list_t* frame)
+{
+    int slots = td->lookahead + 1;
+    Transform t;
+    int i;
+
+    if (!motionDetection(&td->md, frame->video_buf, &t))
+        return TC_ERROR;
+    td->ahead[td->frames_in % (2 * td->lookahead + 2)] = t;
+    memcpy(td->frames + (td->frames_in % slots) * td->framesize_src,
+           frame->video_buf, td->framesize_src);
+    td->frames_in++;
+    if (td->frames_in <= td->lookahead) {
+        frame->attributes |= TC_FRAME_IS_SKIPPED;
+        return TC_OK;
+    }
+
+    i = td->current_trans++;
+    t = lookahead_transform(td, i);
+    td->src = td->frames + (i % slots) * td->framesize_src;
+    if (td->crop == 0) {
+        if (i == 0) // the first frame is the initial background
+            memcpy(td->dest, td->src, td->framesize_src);
+    } else {
+        td->dest = frame->video_buf;
+    }
+    if (td->vob->im_v_codec == CODEC_RGB) {
+        transformRGB(td, t);
+    } else if (td->vob->im_v_codec == CODEC_YUV) {
+        transformYUV(td, t);
+    } else {
+        tc_log_error(MOD_NAME, "unsupported Codec: %i\n", td->vob->im_v_codec);
+        return TC_ERROR;
+    }
+    if (td->crop == 0)
+        memcpy(frame->video_buf, td->dest, td->framesize_src);
+    return TC_OK;
+}
+
 /**
  * transform_init:  Initialize this instance of the module.  See
  * tcmodule-data.h for function details.
@@ -788,8 +1286,8 @@ static int transform_configure(TCModuleInstance *self,
      *  MAX_PLANES * sizeof(char) * 2 * td->vob->im_v_height * 2;    
      */
     td->framesize_src = td->vob->im_v_size;    
-    td->src = tc_malloc(td->framesize_src); /* FIXME */
-    if (td->src == NULL) {
+    td->srccopy = tc_malloc(td->framesize_src); /* FIXME */
+    if (td->srccopy == NULL) {
         tc_log_error(MOD_NAME, "tc_malloc failed\n");
         return TC_ERROR;
     }
@@ -833,17 +1331,45 @@ static int transform_configure(TCModuleInstance *self,
     td->optzoom = 1;
     td->interpoltype = 2; // bi-linear
     td->sharpen = 0.8;
+    td->threads = sysconf(_SC_NPROCESSORS_ONLN);
+    td->lookahead = 0;
+    td->frames_in = 0;
+
+    /* motion detection of the single-pass mode, defaults as in stabilize */
+    td->md.modname    = MOD_NAME;
+    td->md.vob        = td->vob;
+    td->md.width      = td->width_src;
+    td->md.height     = td->height_src;
+    td->md.framesize  = td->framesize_src;
+    td->md.stepsize   = 4;
+    td->md.allowmax   = 0;
+    td->md.algo       = 1;
+    td->md.accuracy   = 4;
+    td->md.shakiness  = 4;
+    td->md.show       = 0;
+    td->md.contrast_threshold = 0.3;
+    td->md.maxanglevariation  = 1;
   
     if (options != NULL) {
         optstr_get(options, "input", "%[^:]", (char*)&td->input);
+        optstr_get(options, "lookahead", "%d", &td->lookahead);
+    }
+    if (td->lookahead > LOOKAHEAD_MAX) {
+        tc_log_error(MOD_NAME, "lookahead %d is too large (max: %d)",
+                     td->lookahead, LOOKAHEAD_MAX);
+        td->lookahead = 0; /* nothing of single-pass mode to clean up */
+        return TC_ERROR;
     }
-    td->f = fopen(td->input, "r");
-    if (td->f == NULL) {
-        tc_log_error(MOD_NAME, "cannot open input file %s!\n", td->input);
-        /* return (-1); when called using tcmodinfo this will fail */ 
-    } else if (!read_input_file(td)) { /* read input file */
-        tc_log_info(MOD_NAME, "error parsing input file %s!\n", td->input);
-        // return (-1);      
+    td->lookahead = TC_MAX(0, td->lookahead);
+    if (td->lookahead == 0) {
+        td->f = fopen(td->input, "r");
+        if (td->f == NULL) {
+            tc_log_error(MOD_NAME, "cannot open input file %s!\n", td->input);
+            /* return (-1); when called using tcmodinfo this will fail */ 
+        } else if (!read_input_file(td)) { /* read input file */
+            tc_log_info(MOD_NAME, "error parsing input file %s!\n", td->input);
+            // return (-1);      
+        }
     }
 
     /* process remaining options */
@@ -863,8 +1389,28 @@ static int transform_configure(TCModuleInstance *self,
         optstr_get(options, "optzoom"  , "%d", &td->optzoom);
         optstr_get(options, "interpol" , "%d", &td->interpoltype);
         optstr_get(options, "sharpen"  , "%lf",&td->sharpen);
+        optstr_get(options, "threads"  , "%d", &td->threads);
+        optstr_get(options, "shakiness", "%d", &td->md.shakiness);
+        optstr_get(options, "accuracy" , "%d", &td->md.accuracy);
+        optstr_get(options, "stepsize" , "%d", &td->md.stepsize);
+        optstr_get(options, "mincontrast", "%lf", &td->md.contrast_threshold);
     }
     td->interpoltype = TC_MIN(td->interpoltype,4);
+    td->threads = TC_MIN(WARP_MAX_THREADS, TC_MAX(1, td->threads));
+    if (td->lookahead > 0) {
+        /* the transforms come from the motion detection */
+        td->relative = 1;
+        if (td->smoothing > td->lookahead) {
+            tc_log_info(MOD_NAME, "smoothing is limited by lookahead"
+                        " - set to %d", td->lookahead);
+            td->smoothing = td->lookahead;
+        }
+        if (td->optzoom) {
+            tc_log_info(MOD_NAME, "optzoom needs all transforms in advance"
+                        " - use zoom in single-pass mode");
+            td->optzoom = 0;
+        }
+    }
     if (verbose) {
         tc_log_info(MOD_NAME, "Image Transformation/Stabilization Settings:");
         tc_log_info(MOD_NAME, "    input     = %s", td->input);
@@ -883,6 +1429,8 @@ static int transform_configure(TCModuleInstance *self,
         tc_log_info(MOD_NAME, "    interpol  = %s", 
                     interpoltypes[td->interpoltype]);
         tc_log_info(MOD_NAME, "    sharpen   = %f", td->sharpen);
+        tc_log_info(MOD_NAME, "    threads   = %d", td->threads);
+        tc_log_info(MOD_NAME, "    lookahead = %d", td->lookahead);
     }
   
     if (td->maxshift > td->width_dest/2
@@ -890,7 +1438,23 @@ static int transform_configure(TCModuleInstance *self,
     if (td->maxshift > td->height_dest/2)
         td->maxshift = td->height_dest/2;
   
-    if (!preprocess_transforms(td)) {
+    if (!startWarpThreads(td)) {
+        return TC_ERROR;
+    }
+    if (td->lookahead > 0) {
+        /* the field search shares the slice threads */
+        td->md.threads = td->threads;
+        td->md.workers = td->workers;
+        if (!initMotionDetect(&td->md)) {
+            return TC_ERROR;
+        }
+        td->frames = tc_malloc(td->framesize_src * (td->lookahead + 1));
+        td->ahead  = tc_malloc(sizeof(Transform) * (2 * td->lookahead + 2));
+        if (td->frames == NULL || td->ahead == NULL) {
+            tc_log_error(MOD_NAME, "tc_malloc failed\n");
+            return TC_ERROR;
+        }
+    } else if (!preprocess_transforms(td)) {
         tc_log_error(MOD_NAME, "error while preprocessing transforms!");
         return TC_ERROR;            
     }  
@@ -913,6 +1477,7 @@ static int transform_configure(TCModuleInstance *self,
       case 4:  interpolate = &interpolateBiCub; break;
       default: interpolate = &interpolateBiLin;
     }
+    initBiCubWeights(td);
 
     /* Is this the right point to add the filter? Seems to be the case.*/
     if (td->sharpen > 0) {
@@ -943,14 +1508,23 @@ static int transform_filter_video(TCModuleInstance *self,
     TC_MODULE_SELF_CHECK(frame, "filter_video");
   
     td = self->userdata;
+
+    if (td->lookahead > 0) {
+        if (frame->attributes & TC_FRAME_IS_SKIPPED)
+            return TC_OK;
+        return lookahead_frame(td, frame);
+    }
             
-    memcpy(td->src, frame->video_buf, td->framesize_src);
     if (td->crop == 0) { 
         if(frame->id == 0) {
             // if we keep borders, save first frame into the background buffer (dest)
             memcpy(td->dest, frame->video_buf, td->framesize_src);
         }
+        // dest is a buffer of its own, so we can read the frame directly
+        td->src = frame->video_buf;
     }else{ // otherwise we directly operate on the framebuffer
+        memcpy(td->srccopy, frame->video_buf, td->framesize_src);
+        td->src  = td->srccopy;
         td->dest = frame->video_buf;
     }
     if (td->current_trans >= td->trans_len) {        
@@ -961,9 +1535,9 @@ static int transform_filter_video(TCModuleInstance *self,
     }
   
     if (td->vob->im_v_codec == CODEC_RGB) {
-        transformRGB(td);
+        transformRGB(td, td->trans[td->current_trans]);
     } else if (td->vob->im_v_codec == CODEC_YUV) {
-        transformYUV(td);
+        transformYUV(td, td->trans[td->current_trans]);
     } else {
         tc_log_error(MOD_NAME, "unsupported Codec: %i\n", td->vob->im_v_codec);
         return TC_ERROR;
@@ -1002,10 +1576,26 @@ static int transform_stop(TCModuleInstance *self)
     TransformData *td = NULL;
     TC_MODULE_SELF_CHECK(self, "stop");
     td = self->userdata;
-    if (td->src) {
-        tc_free(td->src);
-        td->src = NULL;
+    if (td->lookahead > 0) {
+        if (td->frames_in > td->lookahead)
+            tc_log_info(MOD_NAME, "single-pass mode: the last %d frames"
+                        " are dropped", td->lookahead);
+        cleanupMotionDetect(&td->md);
+    }
+    stopWarpThreads(td);
+    if (td->frames) {
+        tc_free(td->frames);
+        td->frames = NULL;
+    }
+    if (td->ahead) {
+        tc_free(td->ahead);
+        td->ahead = NULL;
+    }
+    if (td->srccopy) {
+        tc_free(td->srccopy);
+        td->srccopy = NULL;
     }
+    td->src = NULL;
     if (td->trans) {
         tc_free(td->trans);
         td->trans = NULL;
@@ -1052,6 +1642,8 @@ static int transform_inspect(TCModuleInstance *self,
     CHECKPARAM("optzoom",  "optzoom=%i",   td->optzoom);
     CHECKPARAM("zoom",     "zoom=%f",      td->zoom);
     CHECKPARAM("sharpen",  "sharpen=%f",   td->sharpen);
+    CHECKPARAM("threads",  "threads=%d",   td->threads);
+    CHECKPARAM("lookahead","lookahead=%d", td->lookahead);
         
     return TC_OK;
 };
@@ -1111,7 +1703,6 @@ TC_FILTER_OLDINTERFACE(transform)
 /*
   TODO:
   - add also linear interapolation
-  - check for optimization, e.g. mmx stuff
 */
 
 /*
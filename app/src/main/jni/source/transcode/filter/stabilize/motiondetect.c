@@ -0,0 +1,1078 @@
+/*
+ *  motiondetect.c
+ *
+ *  Copyright (C) Georg Martius - 2007 -- 2011
+ *   georg dot martius at web dot de
+ *   initial author
+ *
+ *  Copyright (C) Alexey Osipov - July 2011
+ *   simba at lerlan dot ru
+ *   speed optimizations including SSE2 code
+ *
+ *  This file is part of transcode, a video stream processing tool
+ *
+ *  transcode is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2, or (at your option)
+ *  any later version.
+ *
+ *  transcode is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with GNU Make; see the file COPYING.  If not, write to
+ *  the Free Software Foundation, 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ */
+
+#include "transcode.h"
+#include "libtc/libtc.h"
+#include "libtc/tclist.h"
+#include "libtc/tccodecs.h"
+#include "motiondetect.h"
+
+#include <math.h>
+#include <unistd.h>
+
+/* if defined we are very verbose and generate files to analyse
+ * this is really just for debugging and development */
+// #define STABVERBOSE
+
+// #ifdef HAVE_SSE2 does not work, even though AC_SUBST(SIMD_FLAGS) is included
+#ifdef HAVE_ASM_SSE2
+/* use SSE2 (psadbw) for compareSubImg */
+#define USE_SSE2_CMP
+
+/* use SSE2 for contrastSubImg (only YUV version)
+ * may be used without USE_SSE */
+#define USE_SSE2_YUV_CONTRAST
+#include <emmintrin.h>
+
+#endif
+
+#define MAXLONG ((unsigned long int)(-1))
+
+#ifdef USE_SSE2_YUV_CONTRAST
+double contrastSubImgYUVSSE(unsigned char* const I, const Field* field, int width, int height);
+#endif
+
+/** initialise measurement fields on the frame.
+    The size of the fields and the maxshift is used to
+    calculate an optimal distribution in the frame.
+*/
+int initFields(StabData* sd)
+{
+    int size = sd->field_size;
+    int rows = TC_MAX(3,(sd->height - sd->maxshift*2)/size-1);
+    int cols = TC_MAX(3,(sd->width  - sd->maxshift*2)/size-1);
+    // make sure that the remaining rows have the same length
+    sd->field_num  = rows*cols;
+    sd->field_rows = rows;
+    // tc_log_msg(sd->modname, "field setup: rows: %i cols: %i Total: %i fields",
+    //            rows, cols, sd->field_num);
+
+    if (!(sd->fields = tc_malloc(sizeof(Field) * sd->field_num))) {
+        tc_log_error(sd->modname, "malloc failed!\n");
+        return 0;
+    } else {
+        int i, j;
+        // the border is the amount by which the field centers
+        // have to be away from the image boundary
+        // (stepsize is added in case shift is increased through stepsize)
+        int border   = size/2 + sd->maxshift + sd->stepsize;
+        int step_x   = (sd->width  - 2*border)/TC_MAX(cols-1,1);
+        int step_y   = (sd->height - 2*border) / TC_MAX(rows-1,1);
+        for (j = 0; j < rows; j++) {
+            for (i = 0; i < cols; i++) {
+                int idx = j*cols+i;
+                sd->fields[idx].x = border + i*step_x;
+                sd->fields[idx].y = border + j*step_y;
+                sd->fields[idx].size = size;
+            }
+        }
+    }
+    return 1;
+}
+
+
+/** initialise the luma pyramids used by the field search.
+    The coarse search runs on the smallest level, so the number of
+    levels is chosen to match stepsize, as long as the fields keep
+    a reasonable size there.
+*/
+int initPyramid(StabData* sd)
+{
+    int l;
+    sd->pyr_width[0]  = sd->width;
+    sd->pyr_height[0] = sd->height;
+    sd->pyr_levels = 0;
+    while (sd->pyr_levels < PYR_MAX_LEVELS
+           && (2 << sd->pyr_levels) <= sd->stepsize
+           && (sd->field_size >> (sd->pyr_levels + 1)) >= PYR_MIN_FIELD) {
+        sd->pyr_levels++;
+    }
+    for (l = 1; l <= sd->pyr_levels; l++) {
+        sd->pyr_width[l]  = sd->pyr_width[l-1] / 2;
+        sd->pyr_height[l] = sd->pyr_height[l-1] / 2;
+        sd->pyr_curr[l] = tc_malloc(sd->pyr_width[l] * sd->pyr_height[l]);
+        sd->pyr_prev[l] = tc_malloc(sd->pyr_width[l] * sd->pyr_height[l]);
+        if (!sd->pyr_curr[l] || !sd->pyr_prev[l]) {
+            tc_log_error(sd->modname, "malloc failed!\n");
+            freePyramid(sd);
+            return 0;
+        }
+    }
+    // the coarse search covers maxshift (rounded to the coarse grid)
+    // and every refinement can add one pixel of its level
+    sd->pyr_reach = ((sd->maxshift >> sd->pyr_levels) << sd->pyr_levels)
+        + (1 << sd->pyr_levels) - 1;
+    return 1;
+}
+
+void freePyramid(StabData* sd)
+{
+    int l;
+    for (l = 1; l <= PYR_MAX_LEVELS; l++) {
+        if (sd->pyr_curr[l])
+            tc_free(sd->pyr_curr[l]);
+        if (sd->pyr_prev[l])
+            tc_free(sd->pyr_prev[l]);
+        sd->pyr_curr[l] = NULL;
+        sd->pyr_prev[l] = NULL;
+    }
+    sd->pyr_levels = 0;
+}
+
+/** downsamples an image by 2 in each direction (2x2 box filter) */
+void halveImage(const unsigned char* src, int srcwidth,
+                unsigned char* dst, int width, int height)
+{
+    int i, j;
+    for (j = 0; j < height; j++) {
+        const unsigned char* p = src + 2 * j * srcwidth;
+        for (i = 0; i < width; i++, p += 2) {
+            *dst++ = (p[0] + p[1] + p[srcwidth] + p[srcwidth + 1] + 2) >> 2;
+        }
+    }
+}
+
+/** calculates the pyramid levels of the given frame into pyr_curr.
+    For YUV the first level is made from the luminance,
+    for RGB from the sum of all channels.
+*/
+void buildPyramid(StabData* sd, unsigned char* frame)
+{
+    int l, i, j;
+    if (sd->pyr_levels < 1)
+        return;
+    if (sd->vob->im_v_codec == CODEC_RGB) {
+        int stride = sd->width * 3;
+        unsigned char* dst = sd->pyr_curr[1];
+        for (j = 0; j < sd->pyr_height[1]; j++) {
+            const unsigned char* p = frame + 2 * j * stride;
+            const unsigned char* q = p + stride;
+            for (i = 0; i < sd->pyr_width[1]; i++, p += 6, q += 6) {
+                *dst++ = (p[0] + p[1] + p[2] + p[3] + p[4] + p[5]
+                          + q[0] + q[1] + q[2] + q[3] + q[4] + q[5] + 6) / 12;
+            }
+        }
+    } else {
+        halveImage(frame, sd->width, sd->pyr_curr[1],
+                   sd->pyr_width[1], sd->pyr_height[1]);
+    }
+    for (l = 2; l <= sd->pyr_levels; l++) {
+        halveImage(sd->pyr_curr[l-1], sd->pyr_width[l-1], sd->pyr_curr[l],
+                   sd->pyr_width[l], sd->pyr_height[l]);
+    }
+}
+
+/** the pyramid of the current frame becomes the one of the previous frame */
+void swapPyramids(StabData* sd)
+{
+    int l;
+    for (l = 1; l <= sd->pyr_levels; l++) {
+        unsigned char* tmp = sd->pyr_prev[l];
+        sd->pyr_prev[l] = sd->pyr_curr[l];
+        sd->pyr_curr[l] = tmp;
+    }
+}
+
+/** checks whether the field shifted by d_x, d_y lies completely
+    within an image of the given size */
+int fieldInside(const Field* field, int width, int height, int d_x, int d_y)
+{
+    int s2 = field->size / 2;
+    return field->x - s2 + d_x >= 0 && field->y - s2 + d_y >= 0
+        && field->x - s2 + d_x + field->size <= width
+        && field->y - s2 + d_y + field->size <= height;
+}
+
+/**
+   compares the two given images and returns the average absolute difference
+   \param d_x shift in x direction
+   \param d_y shift in y direction
+*/
+unsigned long int compareImg(unsigned char* I1, unsigned char* I2,
+                  int width, int height,  int bytesPerPixel, int d_x, int d_y, unsigned long int treshold)
+{
+    int i, j;
+    unsigned char* p1 = NULL;
+    unsigned char* p2 = NULL;
+    unsigned long int sum = 0;
+    int effectWidth = width - abs(d_x);
+    int effectHeight = height - abs(d_y);
+
+/*   DEBUGGING code to export single frames */
+/*   char buffer[100]; */
+/*   sprintf(buffer, "pic_%02ix%02i_1.ppm", d_x, d_y); */
+/*   FILE *pic1 = fopen(buffer, "w"); */
+/*   sprintf(buffer, "pic_%02ix%02i_2.ppm", d_x, d_y); */
+/*   FILE *pic2 = fopen(buffer, "w"); */
+/*   fprintf(pic1, "P6\n%i %i\n255\n", effectWidth, effectHeight); */
+/*   fprintf(pic2, "P6\n%i %i\n255\n", effectWidth, effectHeight); */
+
+    for (i = 0; i < effectHeight; i++) {
+        p1 = I1;
+        p2 = I2;
+        if (d_y > 0 ){
+            p1 += (i + d_y) * width * bytesPerPixel;
+            p2 += i * width * bytesPerPixel;
+        } else {
+            p1 += i * width * bytesPerPixel;
+            p2 += (i - d_y) * width * bytesPerPixel;
+        }
+        if (d_x > 0) {
+            p1 += d_x * bytesPerPixel;
+        } else {
+            p2 -= d_x * bytesPerPixel;
+        }
+        // TODO: use some mmx or sse stuff here
+        for (j = 0; j < effectWidth * bytesPerPixel; j++) {
+            /* debugging code continued */
+            /* fwrite(p1,1,1,pic1);fwrite(p1,1,1,pic1);fwrite(p1,1,1,pic1);
+               fwrite(p2,1,1,pic2);fwrite(p2,1,1,pic2);fwrite(p2,1,1,pic2);
+             */
+            sum += abs((int)*p1 - (int)*p2);
+            p1++;
+            p2++;
+        }
+        if (sum > treshold)
+            break;
+    }
+    /*  fclose(pic1);
+        fclose(pic2);
+     */
+    return sum;
+}
+
+/**
+   compares a small part of two given images
+   and returns the average absolute difference.
+   Field center, size and shift have to be choosen,
+   so that no clipping is required
+
+   \param field Field specifies position(center) and size of subimage
+   \param d_x shift in x direction
+   \param d_y shift in y direction
+   \param threshold minimum difference so far (can stop summing up if exceeded)
+*/
+unsigned long int compareSubImg(unsigned char* const I1, unsigned char* const I2,
+                                const Field* field, int width, int height,
+                                int bytesPerPixel, int d_x, int d_y,
+                                unsigned long int threshold)
+{
+    int k, j;
+    unsigned char* p1 = NULL;
+    unsigned char* p2 = NULL;
+    int s2 = field->size / 2;
+    int rowlen = field->size * bytesPerPixel;
+    unsigned long int sum = 0;
+
+    p1 = I1 + ((field->x - s2) + (field->y - s2) * width) * bytesPerPixel;
+    p2 = I2 + ((field->x - s2 + d_x) + (field->y - s2 + d_y) * width)
+        * bytesPerPixel;
+    for (j = 0; j < field->size; j++) {
+        k = 0;
+#ifdef USE_SSE2_CMP
+        {
+            // psadbw sums up 8 absolute differences at once,
+            // RGB rows are just compared as a sequence of bytes
+            __m128i xmmsum = _mm_setzero_si128();
+            for (; k + 16 <= rowlen; k += 16) {
+                __m128i xmm0 = _mm_loadu_si128((__m128i const*)(p1 + k));
+                __m128i xmm1 = _mm_loadu_si128((__m128i const*)(p2 + k));
+                xmmsum = _mm_add_epi64(xmmsum, _mm_sad_epu8(xmm0, xmm1));
+            }
+            if (k + 8 <= rowlen) {
+                __m128i xmm0 = _mm_loadl_epi64((__m128i const*)(p1 + k));
+                __m128i xmm1 = _mm_loadl_epi64((__m128i const*)(p2 + k));
+                xmmsum = _mm_add_epi64(xmmsum, _mm_sad_epu8(xmm0, xmm1));
+                k += 8;
+            }
+            xmmsum = _mm_add_epi64(xmmsum, _mm_srli_si128(xmmsum, 8));
+            sum += (unsigned int)_mm_cvtsi128_si32(xmmsum);
+        }
+#endif
+        for (; k < rowlen; k++)
+            sum += abs((int) p1[k] - (int) p2[k]);
+        if (sum > threshold) // no need to calculate any longer: worse than the best match
+            break;
+        p1 += width * bytesPerPixel;
+        p2 += width * bytesPerPixel;
+    }
+    return sum;
+}
+
+/** \see contrastSubImg called with bytesPerPixel=1*/
+double contrastSubImgYUV(StabData* sd, const Field* field){
+#ifdef USE_SSE2_YUV_CONTRAST
+    return contrastSubImgYUVSSE(sd->curr,field,sd->width,sd->height);
+#else
+    return contrastSubImg(sd->curr,field,sd->width,sd->height,1);
+#endif
+}
+
+/**
+    \see contrastSubImg three times called with bytesPerPixel=3
+    for all channels
+ */
+double contrastSubImgRGB(StabData* sd, const Field* field){
+    unsigned char* const I = sd->curr;
+    return (  contrastSubImg(I,  field,sd->width,sd->height,3)
+            + contrastSubImg(I+1,field,sd->width,sd->height,3)
+            + contrastSubImg(I+2,field,sd->width,sd->height,3))/3;
+}
+
+
+#ifdef USE_SSE2_YUV_CONTRAST
+/**
+    \see contrastSubImg using SSE2 optimization, YUV only
+ */
+double contrastSubImgYUVSSE(unsigned char* const I, const Field* field,
+                     int width, int height)
+{
+    int k, j;
+    unsigned char* p = NULL;
+    int s2 = field->size / 2;
+
+    static unsigned char full[16] = {0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF};
+
+    p = I + ((field->x - s2) + (field->y - s2)*width);
+
+    __m128i mmin, mmax;
+
+    mmin = _mm_loadu_si128((__m128i const*)full);
+    mmax = _mm_setzero_si128();
+
+    for (j = 0; j < field->size; j++){
+        for (k = 0; k < field->size; k += 16) {
+            __m128i xmm0;
+            xmm0 = _mm_loadu_si128((__m128i const*)p);
+            mmin = _mm_min_epu8(mmin, xmm0);
+            mmax = _mm_max_epu8(mmax, xmm0);
+            p += 16;
+        }
+        p += (width - field->size);
+    }
+
+    __m128i xmm1;
+    xmm1 = _mm_srli_si128(mmin, 8);
+    mmin = _mm_min_epu8(mmin, xmm1);
+    xmm1 = _mm_srli_si128(mmin, 4);
+    mmin = _mm_min_epu8(mmin, xmm1);
+    xmm1 = _mm_srli_si128(mmin, 2);
+    mmin = _mm_min_epu8(mmin, xmm1);
+    xmm1 = _mm_srli_si128(mmin, 1);
+    mmin = _mm_min_epu8(mmin, xmm1);
+    unsigned char mini = (unsigned char)_mm_extract_epi16(mmin, 0);
+
+    xmm1 = _mm_srli_si128(mmax, 8);
+    mmax = _mm_max_epu8(mmax, xmm1);
+    xmm1 = _mm_srli_si128(mmax, 4);
+    mmax = _mm_max_epu8(mmax, xmm1);
+    xmm1 = _mm_srli_si128(mmax, 2);
+    mmax = _mm_max_epu8(mmax, xmm1);
+    xmm1 = _mm_srli_si128(mmax, 1);
+    mmax = _mm_max_epu8(mmax, xmm1);
+    unsigned char maxi = (unsigned char)_mm_extract_epi16(mmax, 0);
+
+    return (maxi-mini)/(maxi+mini+0.1); // +0.1 to avoid division by 0
+}
+#endif
+
+/**
+   calculates Michelson-contrast in the given small part of the given image
+
+   \param I pointer to framebuffer
+   \param field Field specifies position(center) and size of subimage
+   \param width width of frame
+   \param height height of frame
+   \param bytesPerPixel calc contrast for only for first channel
+*/
+double contrastSubImg(unsigned char* const I, const Field* field,
+                     int width, int height, int bytesPerPixel)
+{
+    int k, j;
+    unsigned char* p = NULL;
+    int s2 = field->size / 2;
+    unsigned char mini = 255;
+    unsigned char maxi = 0;
+
+    p = I + ((field->x - s2) + (field->y - s2)*width)*bytesPerPixel;
+
+    for (j = 0; j < field->size; j++){
+        for (k = 0; k < field->size * bytesPerPixel; k++) {
+            mini = (mini < *p) ? mini : *p;
+            maxi = (maxi > *p) ? maxi : *p;
+            p += bytesPerPixel;
+        }
+        p += (width - field->size) * bytesPerPixel;
+    }
+    return (maxi-mini)/(maxi+mini+0.1); // +0.1 to avoid division by 0
+}
+
+/** tries to register current frame onto previous frame.
+    This is the most simple algorithm:
+    shift images to all possible positions and calc summed error
+    Shift with minimal error is selected.
+*/
+Transform calcShiftRGBSimple(StabData* sd)
+{
+    int x = 0, y = 0;
+    int i, j;
+    unsigned long int minerror = MAXLONG;
+    for (i = -sd->maxshift; i <= sd->maxshift; i++) {
+        for (j = -sd->maxshift; j <= sd->maxshift; j++) {
+            unsigned long int error = compareImg(sd->curr, sd->prev,
+                                      sd->width, sd->height, 3, i, j, minerror);
+            if (error < minerror) {
+                minerror = error;
+                x = i;
+                y = j;
+           }
+        }
+    }
+    return new_transform(x, y, 0, 0, 0);
+}
+
+
+/** tries to register current frame onto previous frame.
+    (only the luminance is used)
+    This is the most simple algorithm:
+    shift images to all possible positions and calc summed error
+    Shift with minimal error is selected.
+*/
+Transform calcShiftYUVSimple(StabData* sd)
+{
+    int x = 0, y = 0;
+    int i, j;
+    unsigned char *Y_c, *Y_p;// , *Cb, *Cr;
+#ifdef STABVERBOSE
+    FILE *f = NULL;
+    char buffer[32];
+    tc_snprintf(buffer, sizeof(buffer), "f%04i.dat", sd->t);
+    f = fopen(buffer, "w");
+    fprintf(f, "# splot \"%s\"\n", buffer);
+#endif
+
+    // we only use the luminance part of the image
+    Y_c  = sd->curr;
+    //  Cb_c = sd->curr + sd->width*sd->height;
+    //Cr_c = sd->curr + 5*sd->width*sd->height/4;
+    Y_p  = sd->prev;
+    //Cb_p = sd->prev + sd->width*sd->height;
+    //Cr_p = sd->prev + 5*sd->width*sd->height/4;
+
+    unsigned long int minerror = MAXLONG;
+    for (i = -sd->maxshift; i <= sd->maxshift; i++) {
+        for (j = -sd->maxshift; j <= sd->maxshift; j++) {
+            unsigned long int error = compareImg(Y_c, Y_p,
+                                      sd->width, sd->height, 1, i, j, minerror);
+#ifdef STABVERBOSE
+            fprintf(f, "%i %i %f\n", i, j, error);
+#endif
+            if (error < minerror) {
+                minerror = error;
+                x = i;
+                y = j;
+            }
+        }
+    }
+#ifdef STABVERBOSE
+    fclose(f);
+    tc_log_msg(sd->modname, "Minerror: %f\n", minerror);
+#endif
+    return new_transform(x, y, 0, 0, 0);
+}
+
+
+
+/* calculates rotation angle for the given transform and
+ * field with respect to the given center-point
+ */
+double calcAngle(StabData* sd, Field* field, Transform* t,
+                 int center_x, int center_y)
+{
+    // we better ignore fields that are to close to the rotation center
+    if (abs(field->x - center_x) + abs(field->y - center_y) < sd->maxshift) {
+        return 0;
+    } else {
+        // double r = sqrt(field->x*field->x + field->y*field->y);
+        double a1 = atan2(field->y - center_y, field->x - center_x);
+        double a2 = atan2(field->y - center_y + t->y,
+                          field->x - center_x + t->x);
+        double diff = a2 - a1;
+        return (diff>M_PI) ? diff - 2*M_PI
+            : ( (diff<-M_PI) ? diff + 2*M_PI : diff);
+    }
+}
+
+
+/* calculates the optimal transformation for one field using the pyramids
+ *   (coarse to fine): all shifts within maxshift are checked on the
+ *   smallest level, then the best match is refined by +-1 pixel on each
+ *   finer level down to the frame itself. Only the last step uses the
+ *   bytesPerPixel channels of the frame, the other levels are luminance.
+ */
+Transform calcFieldTransPyramid(StabData* sd, const Field* field,
+                                int fieldnum, int bytesPerPixel)
+{
+    int tx = 0;
+    int ty = 0;
+    int range = sd->maxshift >> sd->pyr_levels;
+    int l, i, j;
+
+#ifdef STABVERBOSE
+    FILE *f = NULL;
+    char buffer[32];
+    tc_snprintf(buffer, sizeof(buffer), "f%04i_%02i.dat", sd->t, fieldnum);
+    f = fopen(buffer, "w");
+    fprintf(f, "# splot \"%s\"\n", buffer);
+#endif
+
+    for (l = sd->pyr_levels; l >= 0; l--) {
+        uint8_t *I_c = l ? sd->pyr_curr[l] : sd->curr;
+        uint8_t *I_p = l ? sd->pyr_prev[l] : sd->prev;
+        int bpp = l ? 1 : bytesPerPixel;
+        int w = sd->pyr_width[l], h = sd->pyr_height[l];
+        unsigned long int minerror = MAXLONG;
+        Field fl;
+        int cx, cy;
+
+        fl.x    = field->x >> l;
+        fl.y    = field->y >> l;
+        fl.size = field->size >> l;
+        if (l < sd->pyr_levels) { // refine the match of the coarser level
+            tx *= 2;
+            ty *= 2;
+            range = 1;
+        }
+        // check the center first: it wins if there is no better match
+        cx = tx;
+        cy = ty;
+        if (fieldInside(&fl, w, h, cx, cy))
+            minerror = compareSubImg(I_c, I_p, &fl, w, h, bpp, cx, cy, MAXLONG);
+        for (i = cx - range; i <= cx + range; i++) {
+            for (j = cy - range; j <= cy + range; j++) {
+                if ((i == cx && j == cy) || !fieldInside(&fl, w, h, i, j))
+                    continue;
+                unsigned long int error = compareSubImg(I_c, I_p, &fl, w, h,
+                                                        bpp, i, j, minerror);
+#ifdef STABVERBOSE
+                fprintf(f, "%i %i %i %lu\n", l, i << l, j << l, error);
+#endif
+                if (error < minerror) {
+                    minerror = error;
+                    tx = i;
+                    ty = j;
+                }
+            }
+        }
+    }
+
+#ifdef STABVERBOSE
+    fclose(f);
+#endif
+
+    // a match at the border of the search area is not trustworthy
+    if (!sd->allowmax && abs(tx) >= sd->pyr_reach) {
+#ifdef STABVERBOSE
+        tc_log_msg(sd->modname, "maximal x shift ");
+#endif
+        tx = 0;
+    }
+    if (!sd->allowmax && abs(ty) >= sd->pyr_reach) {
+#ifdef STABVERBOSE
+        tc_log_msg(sd->modname, "maximal y shift ");
+#endif
+        ty = 0;
+    }
+    Transform t = null_transform();
+    t.x = tx;
+    t.y = ty;
+    return t;
+}
+
+/* calculates the optimal transformation for one field in YUV frames
+ * (only luminance)
+ */
+Transform calcFieldTransYUV(StabData* sd, const Field* field, int fieldnum)
+{
+    return calcFieldTransPyramid(sd, field, fieldnum, 1);
+}
+
+/* calculates the optimal transformation for one field in RGB
+ *   slower than the YUV version because it uses all three color channels
+ *   (in the final refinement on the full resolution frame)
+ */
+Transform calcFieldTransRGB(StabData* sd, const Field* field, int fieldnum)
+{
+    return calcFieldTransPyramid(sd, field, fieldnum, 3);
+}
+
+/** starts the pool of worker threads, threads-1 besides the caller,
+    unless the caller of initMotionDetect gave one.
+    Returns 0 if no thread could be started at all.
+*/
+int startWorkers(StabData* sd)
+{
+    if (sd->workers || sd->threads < 2)
+        return 1;
+    sd->workers = tc_workers_new(sd->threads);
+    if (!sd->workers) {
+        tc_log_error(sd->modname, "cannot start worker threads");
+        return 0;
+    }
+    sd->own_workers = 1;
+    if (tc_workers_threads(sd->workers) < sd->threads)
+        tc_log_warn(sd->modname, "started only %i of %i threads",
+                    tc_workers_threads(sd->workers), sd->threads);
+    return 1;
+}
+
+void stopWorkers(StabData* sd)
+{
+    if (sd->own_workers)
+        tc_workers_del(sd->workers);
+    sd->workers     = NULL;
+    sd->own_workers = 0;
+}
+
+/* one field search job, see calcFieldsParallel */
+typedef struct _field_job {
+    StabData* sd;
+    calcFieldTransFunc func;
+    const int* fields;  // field indices
+    Transform* ts;      // results, one for each index
+} FieldJob;
+
+static void fieldItem(void* arg, int n, int count)
+{
+    FieldJob* job = arg;
+    int idx = job->fields[n];
+    job->ts[n] = job->func(job->sd, &job->sd->fields[idx], idx);
+}
+
+/* calculates the transformations of the given fields (indices into
+ * sd->fields) on the worker threads and the calling thread.
+ * The fields are independent, so the result does not depend on
+ * the number of threads.
+ */
+void calcFieldsParallel(StabData* sd, calcFieldTransFunc fieldfunc,
+                        const int* fields, Transform* ts, int num)
+{
+    FieldJob job;
+    job.sd     = sd;
+    job.func   = fieldfunc;
+    job.fields = fields;
+    job.ts     = ts;
+    tc_workers_run(sd->workers, fieldItem, &job, num);
+}
+
+/* compares contrast_idx structures respect to the contrast
+   (for sort function)
+*/
+int cmp_contrast_idx(const void *ci1, const void* ci2)
+{
+    double a = ((contrast_idx*)ci1)->contrast;
+    double b = ((contrast_idx*)ci2)->contrast;
+    return a < b ? 1 : ( a > b ? -1 : 0 );
+}
+
+/* select only the best 'maxfields' fields
+   first calc contrasts then select from each part of the
+   frame a some fields
+*/
+TCList* selectfields(StabData* sd, contrastSubImgFunc contrastfunc){
+    int i,j;
+    TCList* goodflds = tc_list_new(0);
+    contrast_idx *ci = tc_malloc(sizeof(contrast_idx) * sd->field_num);
+
+    // we split all fields into row+1 segments and take from each segment
+    // the best fields
+    int numsegms = (sd->field_rows+1);
+    int segmlen = sd->field_num/(sd->field_rows+1)+1;
+    // split the frame list into rows+1 segments
+    contrast_idx *ci_segms = tc_malloc(sizeof(contrast_idx) * sd->field_num);
+    int remaining   = 0;
+    // calculate contrast for each field
+    for (i = 0; i < sd->field_num; i++) {
+        ci[i].contrast = contrastfunc(sd, &sd->fields[i]);
+        ci[i].index=i;
+        if(ci[i].contrast < sd->contrast_threshold) ci[i].contrast = 0;
+        // else printf("%i %lf\n", ci[i].index, ci[i].contrast);
+    }
+
+    memcpy(ci_segms, ci, sizeof(contrast_idx) * sd->field_num);
+    // get best fields from each segment
+    for(i=0; i<numsegms; i++){
+        int startindex = segmlen*i;
+        int endindex   = segmlen*(i+1);
+        endindex       = endindex > sd->field_num ? sd->field_num : endindex;
+        //printf("Segment: %i: %i-%i\n", i, startindex, endindex);
+
+        // sort within segment
+        qsort(ci_segms+startindex, endindex-startindex,
+              sizeof(contrast_idx), cmp_contrast_idx);
+        // take maxfields/numsegms
+        for(j=0; j<sd->maxfields/numsegms; j++){
+            if(startindex+j >= endindex) continue;
+            // printf("%i %lf\n", ci_segms[startindex+j].index,
+            //                    ci_segms[startindex+j].contrast);
+            if(ci_segms[startindex+j].contrast > 0){
+                tc_list_append_dup(goodflds, &ci[ci_segms[startindex+j].index],
+                                   sizeof(contrast_idx));
+                // don't consider them in the later selection process
+                ci_segms[startindex+j].contrast=0;
+            }
+        }
+    }
+    // check whether enough fields are selected
+    // printf("Phase2: %i\n", tc_list_size(goodflds));
+    remaining = sd->maxfields - tc_list_size(goodflds);
+    if(remaining > 0){
+        // take the remaining from the leftovers
+        qsort(ci_segms, sd->field_num,
+              sizeof(contrast_idx), cmp_contrast_idx);
+        for(j=0; j < remaining; j++){
+            if(ci_segms[j].contrast > 0){
+                tc_list_append_dup(goodflds, &ci_segms[j], sizeof(contrast_idx));
+            }
+        }
+    }
+    // printf("Ende: %i\n", tc_list_size(goodflds));
+    tc_free(ci);
+    tc_free(ci_segms);
+    return goodflds;
+}
+
+
+
+/* tries to register current frame onto previous frame.
+ *   Algorithm:
+ *   check all fields for vertical and horizontal transformation
+ *   use minimal difference of all possible positions
+ *   discards fields with low contrast
+ *   select maxfields field according to their contrast
+ *   calculate shift as cleaned mean of all remaining fields
+ *   calculate rotation angle of each field in respect to center of fields
+ *   after shift removal
+ *   calculate rotation angle as cleaned mean of all angles
+ *   compensate for possibly off-center rotation
+*/
+Transform calcTransFields(StabData* sd, calcFieldTransFunc fieldfunc,
+                          contrastSubImgFunc contrastfunc)
+{
+    Transform* ts  = tc_malloc(sizeof(Transform) * sd->field_num);
+    Field** fs     = tc_malloc(sizeof(Field*) * sd->field_num);
+    double *angles = tc_malloc(sizeof(double) * sd->field_num);
+    int i, index=0, num_trans;
+    Transform t;
+#ifdef STABVERBOSE
+    FILE *file = NULL;
+    char buffer[32];
+    tc_snprintf(buffer, sizeof(buffer), "k%04i.dat", sd->t);
+    file = fopen(buffer, "w");
+    fprintf(file, "# plot \"%s\" w l, \"\" every 2:1:0\n", buffer);
+#endif
+
+    TCList* goodflds = selectfields(sd, contrastfunc);
+    int* fldidx = tc_malloc(sizeof(int) * sd->field_num);
+    int num_flds = 0;
+
+    contrast_idx* f;
+    while((f = (contrast_idx*)tc_list_pop(goodflds,0)) != 0){
+        fldidx[num_flds++] = f->index;
+        tc_free(f);
+    }
+    tc_list_del(goodflds, 1);
+
+    // use all "good" fields and calculate optimal match to previous frame
+    Transform* fldts = tc_malloc(sizeof(Transform) * sd->field_num);
+    calcFieldsParallel(sd, fieldfunc, fldidx, fldts, num_flds);
+    for (index = 0, i = 0; i < num_flds; i++) {
+        int k = fldidx[i];
+        t = fldts[i]; // e.g. calcFieldTransYUV
+#ifdef STABVERBOSE
+        fprintf(file, "%i %i\n%f %f %i\n \n\n", sd->fields[k].x, sd->fields[k].y,
+                sd->fields[k].x + t.x, sd->fields[k].y + t.y, t.extra);
+#endif
+        if (t.extra != -1){ // ignore if extra == -1 (unused at the moment)
+            ts[index] = t;
+            fs[index] = sd->fields+k;
+            index++;
+        }
+    }
+    tc_free(fldidx);
+    tc_free(fldts);
+
+    t = null_transform();
+    num_trans = index; // amount of transforms we actually have
+    if (num_trans < 1) {
+        tc_log_warn(sd->modname, "too low contrast! No field remains.\n \
+                    (no translations are detected in frame %i)", sd->t);
+        tc_free(ts);
+        tc_free(fs);
+        tc_free(angles);
+        return t;
+    }
+
+    int center_x = 0;
+    int center_y = 0;
+    // calc center point of all remaining fields
+    for (i = 0; i < num_trans; i++) {
+        center_x += fs[i]->x;
+        center_y += fs[i]->y;
+    }
+    center_x /= num_trans;
+    center_y /= num_trans;
+
+    if (sd->show){ // draw fields and transforms into frame.
+        // this has to be done one after another to handle possible overlap
+        if (sd->show > 1) {
+            for (i = 0; i < num_trans; i++)
+                drawFieldScanArea(sd, fs[i], &ts[i]);
+        }
+        for (i = 0; i < num_trans; i++)
+            drawField(sd, fs[i], &ts[i]);
+        for (i = 0; i < num_trans; i++)
+            drawFieldTrans(sd, fs[i], &ts[i]);
+    }
+    /* median over all transforms
+       t= median_xy_transform(ts, sd->field_num);*/
+    // cleaned mean
+    t = cleanmean_xy_transform(ts, num_trans);
+
+    // substract avg
+    for (i = 0; i < num_trans; i++) {
+        ts[i] = sub_transforms(&ts[i], &t);
+    }
+    // figure out angle
+    if (sd->field_num < 6) {
+        // the angle calculation is inaccurate for 5 and less fields
+        t.alpha = 0;
+    } else {
+        for (i = 0; i < num_trans; i++) {
+            angles[i] = calcAngle(sd, fs[i], &ts[i], center_x, center_y);
+        }
+        double min,max;
+        t.alpha = -cleanmean(angles, num_trans, &min, &max);
+        if(max-min>sd->maxanglevariation){
+            t.alpha=0;
+            tc_log_info(sd->modname, "too large variation in angle(%f)\n",
+                        max-min);
+        }
+    }
+    // compensate for off-center rotation
+    double p_x = (center_x - sd->width/2);
+    double p_y = (center_y - sd->height/2);
+    t.x += (cos(t.alpha)-1)*p_x  - sin(t.alpha)*p_y;
+    t.y += sin(t.alpha)*p_x  + (cos(t.alpha)-1)*p_y;
+
+#ifdef STABVERBOSE
+    fclose(file);
+#endif
+    tc_free(ts);
+    tc_free(fs);
+    tc_free(angles);
+    return t;
+}
+
+/** draws the field scanning area */
+void drawFieldScanArea(StabData* sd, const Field* field, const Transform* t){
+    if(!sd->vob->im_v_codec == CODEC_YUV)
+        return;
+    drawBox(sd->curr, sd->width, sd->height, 1, field->x, field->y,
+            field->size+2*sd->maxshift, field->size+2*sd->maxshift, 80);
+}
+
+/** draws the field */
+void drawField(StabData* sd, const Field* field, const Transform* t){
+    if(!sd->vob->im_v_codec == CODEC_YUV)
+        return;
+    drawBox(sd->curr, sd->width, sd->height, 1, field->x, field->y,
+            field->size, field->size, t->extra == -1 ? 100 : 40);
+}
+
+/** draws the transform data of this field */
+void drawFieldTrans(StabData* sd, const Field* field, const Transform* t){
+    if(!sd->vob->im_v_codec == CODEC_YUV)
+        return;
+    drawBox(sd->curr, sd->width, sd->height, 1,
+            field->x, field->y, 5, 5, 128);     // draw center
+    drawBox(sd->curr, sd->width, sd->height, 1,
+            field->x + t->x, field->y + t->y, 8, 8, 250); // draw translation
+}
+
+/**
+ * draws a box at the given position x,y (center) in the given color
+   (the same for all channels)
+ */
+void drawBox(unsigned char* I, int width, int height, int bytesPerPixel,
+             int x, int y, int sizex, int sizey, unsigned char color){
+
+    unsigned char* p = NULL;
+    int j,k;
+    p = I + ((x - sizex/2) + (y - sizey/2)*width)*bytesPerPixel;
+    for (j = 0; j < sizey; j++){
+        for (k = 0; k < sizex * bytesPerPixel; k++) {
+            *p = color;
+            p++;
+        }
+        p += (width - sizex) * bytesPerPixel;
+    }
+}
+
+
+/** clamps the options and sets up the measurement fields, the pyramids
+    and the worker threads according to them.
+*/
+int initMotionDetect(StabData* sd)
+{
+    sd->shakiness = TC_MIN(10,TC_MAX(1,sd->shakiness));
+    sd->accuracy  = TC_MIN(15,TC_MAX(1,sd->accuracy));
+    sd->threads   = TC_MIN(STAB_MAX_THREADS,TC_MAX(1,sd->threads));
+    if(sd->accuracy < sd->shakiness/2){
+        tc_log_info(sd->modname, "accuracy should not be lower than shakiness/2 - fixed");
+        sd->accuracy = sd->shakiness/2;
+    }
+    if (sd->accuracy > 9 && sd->stepsize > 4) {
+        tc_log_info(sd->modname, "for high accuracy use lower stepsize - set to 4 now");
+        sd->stepsize = 4;
+    }
+
+    sd->prev = tc_zalloc(sd->framesize);
+    if (!sd->prev) {
+        tc_log_error(sd->modname, "malloc failed");
+        return 0;
+    }
+    sd->currcopy = 0;
+    if (sd->show)
+        sd->currcopy = tc_zalloc(sd->framesize);
+    sd->hasSeenOneFrame = 0;
+    sd->t = 0;
+
+    // shift: shakiness 1: height/40; 10: height/4 
+    int minDimension = TC_MIN(sd->width, sd->height);
+    sd->maxshift = TC_MAX(4, (minDimension * sd->shakiness)/40);
+    // size: shakiness 1: height/40; 10: height/6 (clipped) 
+    sd->field_size
+        = TC_MAX(4, TC_MIN(minDimension/6, (minDimension * sd->shakiness)/40));
+
+#if defined(USE_SSE2_CMP) || defined(USE_SSE2_YUV_CONTRAST)
+    //must be multiple of 16 pixels for SSE2
+    sd->field_size   = (sd->field_size / 16 + 1) * 16; 
+#endif
+    tc_log_info(sd->modname, "Fieldsize: %i, Maximal translation: %i pixel",
+                sd->field_size, sd->maxshift);
+    if (sd->algo==1) {
+        // initialize measurement fields. field_num is set here.
+        if (!initFields(sd)) {
+            return 0;
+        }
+        sd->maxfields = (sd->accuracy) * sd->field_num / 15;
+        tc_log_info(sd->modname, "Number of used measurement fields: %i out of %i",
+                    sd->maxfields, sd->field_num);
+        if (!initPyramid(sd) || !startWorkers(sd)) {
+            return 0;
+        }
+        tc_log_info(sd->modname, "Pyramid levels: %i, worker threads: %i",
+                    sd->pyr_levels, tc_workers_threads(sd->workers) - 1);
+    }
+    
+#ifdef USE_SSE2_CMP
+    tc_log_info(sd->modname, "use SSE2 optimizations");   
+#endif
+    return 1;
+}
+
+void cleanupMotionDetect(StabData* sd)
+{
+    stopWorkers(sd);
+    freePyramid(sd);
+    if (sd->fields) {
+        tc_free(sd->fields);
+        sd->fields = NULL;
+    }
+    if (sd->prev) {
+        tc_free(sd->prev);
+        sd->prev = NULL;
+    }
+    if (sd->currcopy) {
+        tc_free(sd->currcopy);
+        sd->currcopy = NULL;
+    }
+}
+
+int motionDetection(StabData* sd, unsigned char* frame, Transform* trans)
+{
+    *trans = null_transform();
+    if(sd->show)  // save the buffer to restore at the end for prev
+        memcpy(sd->currcopy, frame, sd->framesize);
+    if (sd->algo == 1)
+        buildPyramid(sd, frame);
+
+    if (sd->hasSeenOneFrame) {
+        sd->curr = frame;
+        if (sd->vob->im_v_codec == CODEC_RGB) {
+            if (sd->algo == 0)
+                *trans = calcShiftRGBSimple(sd);
+            else if (sd->algo == 1)
+                *trans = calcTransFields(sd, calcFieldTransRGB,
+                                         contrastSubImgRGB);
+        } else if (sd->vob->im_v_codec == CODEC_YUV) {
+            if (sd->algo == 0)
+                *trans = calcShiftYUVSimple(sd);
+            else if (sd->algo == 1)
+                *trans = calcTransFields(sd, calcFieldTransYUV,
+                                         contrastSubImgYUV);
+        } else {
+            tc_log_warn(sd->modname, "unsupported Codec: %i\n",
+                        sd->vob->im_v_codec);
+            return 0;
+        }
+    } else {
+        sd->hasSeenOneFrame = 1;
+    }
+
+    if(!sd->show) { // copy current frame to prev for next frame comparison
+        memcpy(sd->prev, frame, sd->framesize);
+    } else { // use the copy because we changed the original frame
+        memcpy(sd->prev, sd->currcopy, sd->framesize);
+    }
+    swapPyramids(sd);
+    sd->t++;
+    return 1;
+}
+
+/*
+ * Local variables:
+ *   c-file-style: "stroustrup"
+ *   c-file-offsets: ((case-label . *) (statement-case-intro . *))
+ *   indent-tabs-mode: nil
+ * End:
+ *
+ * vim: expandtab shiftwidth=4:
+ */
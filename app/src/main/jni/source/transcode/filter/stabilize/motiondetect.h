@@ -0,0 +1,190 @@
+/*
+ *  motiondetect.h
+ *
+ *  Copyright (C) Georg Martius - 2007 -- 2011
+ *   georg dot martius at web dot de
+ *
+ *  This file is part of transcode, a video stream processing tool
+ *
+ *  transcode is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2, or (at your option)
+ *  any later version.
+ *
+ *  transcode is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with GNU Make; see the file COPYING.  If not, write to
+ *  the Free Software Foundation, 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ */
+#ifndef __MOTIONDETECT_H
+#define __MOTIONDETECT_H
+
+/* the motion detection of filter stabilize: finds the transformation
+ * (translation, rotation) between subsequent frames.
+ * It is also used by filter transform in single-pass mode.
+ */
+
+#include "transcode.h"
+#include "libtc/tclist.h"
+#include "libtc/tcworkers.h"
+#include "transform.h"
+
+/* maximal number of downsampled levels used by the pyramid search */
+#define PYR_MAX_LEVELS 4
+/* a field must be at least this large on the coarsest level */
+#define PYR_MIN_FIELD  8
+/* maximal number of worker threads for the field search */
+#define STAB_MAX_THREADS 16
+
+typedef struct _field {
+    int x;     // middle position x
+    int y;     // middle position y
+    int size;  // size of field
+} Field;
+
+// structure that contains the contrast and the index of a field
+typedef struct _contrast_idx {
+    double contrast;
+    int index;
+} contrast_idx;
+
+typedef struct _stab_data StabData;
+
+/* type for a function that calculates the transformation of a certain field
+ */
+typedef Transform (*calcFieldTransFunc)(StabData*, const Field*, int);
+
+/* private data structure of the motion detection */
+struct _stab_data {
+    const char* modname; // module name used for the log messages
+
+    size_t framesize;  // size of frame buffer in bytes (prev)
+    unsigned char* curr; // current frame buffer (only pointer)
+    unsigned char* currcopy; // copy of the current frame needed for drawing
+    unsigned char* prev; // frame buffer for last frame (copied)
+    short hasSeenOneFrame; // true if we have a valid previous frame
+
+    vob_t* vob;  // pointer to information structure
+    int width, height;
+
+    Field* fields;
+
+    /* luma pyramids of the current and the previous frame:
+     * level l is the frame downsampled by 2^l (level 0 is the frame itself)
+     */
+    int pyr_levels; // number of downsampled levels (0: no pyramid)
+    int pyr_width[PYR_MAX_LEVELS+1];
+    int pyr_height[PYR_MAX_LEVELS+1];
+    unsigned char* pyr_curr[PYR_MAX_LEVELS+1];
+    unsigned char* pyr_prev[PYR_MAX_LEVELS+1];
+    int pyr_reach;  // largest shift the pyramid search can find
+
+    /* worker threads for the field search (see calcFieldsParallel);
+     * a pool set before initMotionDetect is used instead of a new one */
+    TCWorkers* workers;
+    int own_workers;    // 1: the pool was started by startWorkers
+
+    /* Options */
+    /* maximum number of pixels we expect the shift of subsequent frames */
+    int maxshift;
+    int stepsize; // stepsize of field transformation detection
+    int allowmax; // 1 if maximal shift is allowed
+    int algo;     // algorithm to use
+    int field_num;  // number of measurement fields
+    int maxfields;  // maximum number of fields used (selected by contrast)
+    int field_size; // size    = min(sd->width, sd->height)/10;
+    int field_rows; // number of rows
+    /* if 1 and 2 then the fields and transforms are shown in the frames */
+    int show;
+    /* measurement fields with lower contrast are discarded */
+    double contrast_threshold;
+    /* maximal difference in angles of fields */
+    double maxanglevariation;
+    /* meta parameter for maxshift and fieldsize between 1 and 10 */
+    int shakiness;
+    int accuracy;   // meta parameter for number of fields between 1 and 10
+    int threads;    // number of threads used for the field search
+
+    int t;      // number of the current frame
+};
+
+/* type for a function that calculates the contrast of a certain field
+ */
+typedef double (*contrastSubImgFunc)(StabData* sd, const Field* field);
+
+/* the owner sets modname, vob, width, height, framesize and the options
+ * (see filter_stabilize.c for the defaults) and calls initMotionDetect.
+ * Returns 0 on failure.
+ */
+int initMotionDetect(StabData* sd);
+/* frees everything allocated by initMotionDetect */
+void cleanupMotionDetect(StabData* sd);
+/* calculates the transformation of the given frame with respect to the
+ * previous one (the null transform for the first frame) and remembers
+ * the frame for the next call.
+ * Returns 0 if the codec is not supported.
+ */
+int motionDetection(StabData* sd, unsigned char* frame, Transform* trans);
+
+int initFields(StabData* sd);
+unsigned long int compareImg(unsigned char* I1, unsigned char* I2,
+                             int width, int height,  int bytesPerPixel, 
+                             int d_x, int d_y, unsigned long int threshold);
+unsigned long int compareSubImg(unsigned char* const I1, unsigned char* const I2,
+                                const Field* field, int width, int height, 
+                                int bytesPerPixel,int d_x,int d_y, 
+                                unsigned long int threshold);
+int initPyramid(StabData* sd);
+void freePyramid(StabData* sd);
+void halveImage(const unsigned char* src, int srcwidth,
+                unsigned char* dst, int width, int height);
+void buildPyramid(StabData* sd, unsigned char* frame);
+void swapPyramids(StabData* sd);
+int fieldInside(const Field* field, int width, int height, int d_x, int d_y);
+int startWorkers(StabData* sd);
+void stopWorkers(StabData* sd);
+double contrastSubImgYUV(StabData* sd, const Field* field);
+double contrastSubImgRGB(StabData* sd, const Field* field);
+double contrastSubImg(unsigned char* const I, const Field* field,
+                      int width, int height, int bytesPerPixel);
+int cmp_contrast_idx(const void *ci1, const void* ci2);
+TCList* selectfields(StabData* sd, contrastSubImgFunc contrastfunc);
+
+Transform calcShiftRGBSimple(StabData* sd);
+Transform calcShiftYUVSimple(StabData* sd);
+double calcAngle(StabData* sd, Field* field, Transform* t,
+                 int center_x, int center_y);
+Transform calcFieldTransYUV(StabData* sd, const Field* field,
+                            int fieldnum);
+Transform calcFieldTransRGB(StabData* sd, const Field* field,
+                            int fieldnum);
+Transform calcFieldTransPyramid(StabData* sd, const Field* field,
+                                int fieldnum, int bytesPerPixel);
+void calcFieldsParallel(StabData* sd, calcFieldTransFunc fieldfunc,
+                        const int* fields, Transform* ts, int num);
+Transform calcTransFields(StabData* sd, calcFieldTransFunc fieldfunc,
+                          contrastSubImgFunc contrastfunc);
+
+
+void drawFieldScanArea(StabData* sd, const Field* field, const Transform* t);
+void drawField(StabData* sd, const Field* field, const Transform* t);
+void drawFieldTrans(StabData* sd, const Field* field, const Transform* t);
+void drawBox(unsigned char* I, int width, int height, int bytesPerPixel,
+             int x, int y, int sizex, int sizey, unsigned char color);
+
+#endif
+
+/*
+ * Local variables:
+ *   c-file-style: "stroustrup"
+ *   c-file-offsets: ((case-label . *) (statement-case-intro . *))
+ *   indent-tabs-mode: nil
+ * End:
+ *
+ * vim: expandtab shiftwidth=4:
+ */
@@ -30,6 +30,7 @@
 #include "clone.h"
 #include "seqinfo.h"  /* for sync_type_t */
 #include "ivtc.h"
+#include "tcpipeline.h"
 
 #include "frame_info.h"
 
@@ -310,7 +311,7 @@ void clone_close()
 	sfd=0;
     }
 
-    if (pfd) pclose(pfd);
+    if (pfd) tc_pipeline_close(pfd);
     pfd = NULL;
 }
 
@@ -45,12 +45,12 @@ static int (*p_a52_decore)(decode_t *decode);
 static void *handle;
 static char module[TC_BUF_MAX];
 
-static int a52_do_init(char *path) {
+static int a52_do_init(char *path, int verbose_flag) {
     const char *error;
 
     tc_snprintf(module, sizeof(module), "%s/%s", path, MODULE);
 
-    if(verbose & TC_DEBUG)
+    if(verbose_flag & TC_DEBUG)
 	tc_log_msg(__FILE__, "loading external module %s", module);
 
     // try transcode's module directory
@@ -84,10 +84,8 @@ static int a52_do_init(char *path) {
 
 void decode_a52(decode_t *decode)
 {
-  verbose = decode->verbose;
-
   //load the codec
-  if(a52_do_init(mod_path)<0) {
+  if(a52_do_init(mod_path, decode->verbose)<0) {
     tc_log_error(__FILE__, "failed to init ATSC A-52 stream decoder");
     import_exit(1);
   }
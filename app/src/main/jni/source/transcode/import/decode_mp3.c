@@ -69,7 +69,7 @@ static void decode_mpaudio(decode_t *decode, int format)
 
     if (format != MP2_AUDIO_ID && format != MP3_AUDIO_ID) {
         tc_log_error(__FILE__, "wrong mpeg audio format: 0x%x", format);
-        exit(1);
+        import_exit(1);
     }
 
     verbose = decode->verbose;
@@ -79,15 +79,15 @@ static void decode_mpaudio(decode_t *decode, int format)
     mp3data = tc_zalloc(sizeof(mp3data_struct));
     if (mp3data == NULL) {
         tc_log_error(__FILE__, "out of memory");
-        exit(1);
+        import_exit(1);
     }
 
     if (lame_decode_init() < 0) {
         tc_log_error(__FILE__, "failed to init decoder");
-        exit(1);
+        import_exit(1);
     }
 
-    in_file = fdopen(decode->fd_in, "r");
+    in_file = fdopen(dup(decode->fd_in), "r");
 
     if (format == MP3_AUDIO_ID) {
         int c = 0;
@@ -153,6 +153,8 @@ static void decode_mpaudio(decode_t *decode, int format)
         }
     }
 
+    fclose(in_file);
+    tc_free(mp3data);
     import_exit(0);
 
 #else  // HAVE_LAME
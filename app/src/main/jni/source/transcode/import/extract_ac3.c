@@ -70,6 +70,17 @@ static unsigned int read_tc_time_stamp(const char *s)
 static uint8_t *buffer = NULL;
 static FILE *in_file, *out_file;
 
+/* Close the streams opened on the pipeline descriptors; also run when
+ * import_exit() ends an in-process pipeline stage (see tcpipeline.c). */
+static void close_streams(void *unused)
+{
+    if (in_file)
+	fclose(in_file);
+    if (out_file)
+	fclose(out_file);
+    in_file = out_file = NULL;
+}
+
 static unsigned int track_code=0, vdr_work_around=0;
 
 static int get_pts=0;
@@ -77,7 +88,7 @@ static int get_pts=0;
 static subtitle_header_t subtitle_header;
 static char *subtitle_header_str="SUBTITLE";
 
-static void pes_ac3_loop (void)
+static void pes_ac3_loop (int verbose_flag)
 {
     static int mpeg1_skip_table[16] = {
 	     1, 0xffff,      5,     10, 0xffff, 0xffff, 0xffff, 0xffff,
@@ -112,7 +123,7 @@ static void pes_ac3_loop (void)
 
 	// check for valid start code
 	if (buf[0] || buf[1] || (buf[2] != 0x01)) {
-	  if (complain_loudly && (verbose & TC_DEBUG)) {
+	  if (complain_loudly && (verbose_flag & TC_DEBUG)) {
 	    tc_log_warn(__FILE__, "missing start code at %#lx",
 			ftell (in_file) - (end - buf));
 	    if ((buf[0] == 0) && (buf[1] == 0) && (buf[2] == 0))
@@ -123,7 +134,7 @@ static void pes_ac3_loop (void)
 	  continue;
 	}// check for valid start code
 
-	if(verbose & TC_STATS)
+	if(verbose_flag & TC_STATS)
 	  tc_log_msg(__FILE__, "packet code 0x%x", buf[3]);
 
 	switch (buf[3]) {
@@ -221,7 +232,7 @@ static void pes_ac3_loop (void)
 	    tmp1 += mpeg1_skip_table [*tmp1 >> 4];
 	  }
 
-	  if(verbose & TC_STATS)
+	  if(verbose_flag & TC_STATS)
 	    tc_log_msg(__FILE__, "track code 0x%x", *tmp1);
 
 	  if(vdr_work_around) {
@@ -258,23 +269,23 @@ static void pes_ac3_loop (void)
 		subtitle_header.header_length = sizeof(subtitle_header_t);
 		subtitle_header.payload_length=tmp2-tmp1;
 
-		if(verbose & TC_STATS)
+		if(verbose_flag & TC_STATS)
 		  tc_log_msg(__FILE__, "subtitle=0x%x size=%4d lpts=%d rpts=%f rptsfromvid=%f",
 			     track_code, subtitle_header.payload_length,
 			     subtitle_header.lpts, subtitle_header.rpts,
 			     abs_rpts);
 
-		if(tc_pwrite(STDOUT_FILENO, (uint8_t*) subtitle_header_str, strlen(subtitle_header_str))<0) {
+		if(tc_pwrite(fileno(out_file), (uint8_t*) subtitle_header_str, strlen(subtitle_header_str))<0) {
 		    tc_log_error(__FILE__, "error writing subtitle: %s",
 				 strerror(errno));
 		    import_exit(1);
 		}
-		if(tc_pwrite(STDOUT_FILENO, (uint8_t*) &subtitle_header, sizeof(subtitle_header_t))<0) {
+		if(tc_pwrite(fileno(out_file), (uint8_t*) &subtitle_header, sizeof(subtitle_header_t))<0) {
 		    tc_log_error(__FILE__, "error writing subtitle: %s",
 				 strerror(errno));
 		    import_exit(1);
 		}
-		if(tc_pwrite(STDOUT_FILENO, tmp1, tmp2-tmp1)<0) {
+		if(tc_pwrite(fileno(out_file), tmp1, tmp2-tmp1)<0) {
 		    tc_log_error(__FILE__, "error writing subtitle: %s",
 				 strerror(errno));
 		    import_exit(1);
@@ -331,10 +342,8 @@ static void pes_ac3_loop (void)
 
 
 
-FILE *fd;
-
 #define MAX_BUF 4096
-char audio[MAX_BUF];
+static char audio[MAX_BUF];
 
 
 /* from ac3scan.c */
@@ -478,30 +487,29 @@ void extract_ac3(info_t *ipipe)
 
     long frames, bytes, padding, n;
 
-    verbose = ipipe->verbose;
-
     buffer = tc_malloc (BUFFER_SIZE);
 
     switch(ipipe->magic) {
 
     case TC_MAGIC_VDR:
 
-      in_file = fdopen(ipipe->fd_in, "r");
-      out_file = fdopen(ipipe->fd_out, "w");
+      in_file = fdopen(dup(ipipe->fd_in), "r");
+      out_file = fdopen(dup(ipipe->fd_out), "w");
+      pthread_cleanup_push(close_streams, NULL);
 
       vdr_work_around=1;
 
-      pes_ac3_loop();
+      pes_ac3_loop(ipipe->verbose);
 
-      fclose(in_file);
-      fclose(out_file);
+      pthread_cleanup_pop(1);
 
       break;
 
     case TC_MAGIC_VOB:
 
-      in_file = fdopen(ipipe->fd_in, "r");
-      out_file = fdopen(ipipe->fd_out, "w");
+      in_file = fdopen(dup(ipipe->fd_in), "r");
+      out_file = fdopen(dup(ipipe->fd_out), "w");
+      pthread_cleanup_push(close_streams, NULL);
 
 
       if(ipipe->codec==TC_CODEC_PS1) {
@@ -524,10 +532,9 @@ void extract_ac3(info_t *ipipe)
 	  track_code = ipipe->track + 0x80;
       }
 
-      pes_ac3_loop();
+      pes_ac3_loop(ipipe->verbose);
 
-      fclose(in_file);
-      fclose(out_file);
+      pthread_cleanup_pop(1);
 
       break;
 
@@ -35,6 +35,16 @@
 static uint8_t buffer[BUFFER_SIZE];
 static FILE *in_file, *out_file;
 
+/* cleanup handler for the streams, see extract_ac3.c */
+static void close_streams(void *unused)
+{
+    if (in_file)
+	fclose(in_file);
+    if (out_file)
+	fclose(out_file);
+    in_file = out_file = NULL;
+}
+
 static int demux_track=0xc0;
 
 static void ps_loop (void)
@@ -186,7 +196,7 @@ static void ps_loop (void)
     } while (end == buffer + BUFFER_SIZE);
 }
 
-static int mp3scan(int infd, int outfd)
+static int mp3scan(int infd, int outfd, int verbose_flag)
 {
 
   int j=0, i=0, s=0;
@@ -230,7 +240,7 @@ static int mp3scan(int infd, int outfd)
 
   i=i-2;
 
-  if(verbose & TC_DEBUG)
+  if(verbose_flag & TC_DEBUG)
     tc_log_msg(__FILE__, "found sync frame at offset %d (%d)", i, j);
 
   // dump the rest
@@ -243,7 +253,7 @@ static int mp3scan(int infd, int outfd)
 }
 
 #define MAX_BUF 4096
-char audio[MAX_BUF];
+static char audio[MAX_BUF];
 
 /* ------------------------------------------------------------
  *
@@ -267,21 +277,20 @@ void extract_mp3(info_t *ipipe)
     off_t bytes;
     //off_t fpos;
 
-    verbose = ipipe->verbose;
 
     switch(ipipe->magic) {
 
     case TC_MAGIC_VOB:
 
-	in_file = fdopen(ipipe->fd_in, "r");
-	out_file = fdopen(ipipe->fd_out, "w");
+	in_file = fdopen(dup(ipipe->fd_in), "r");
+	out_file = fdopen(dup(ipipe->fd_out), "w");
+	pthread_cleanup_push(close_streams, NULL);
 
 	demux_track = 0xc0 + ipipe->track;
 
 	ps_loop();
 
-	fclose(in_file);
-	fclose(out_file);
+	pthread_cleanup_pop(1);
 
 	break;
 
@@ -342,7 +351,7 @@ void extract_mp3(info_t *ipipe)
 			filetype(TC_MAGIC_RAW));
 
 
-	error=mp3scan(ipipe->fd_in, ipipe->fd_out);
+	error=mp3scan(ipipe->fd_in, ipipe->fd_out, ipipe->verbose);
 
      break;
     }
@@ -34,6 +34,16 @@
 static uint8_t buffer[BUFFER_SIZE];
 static FILE *in_file, *out_file;
 
+/* cleanup handler for the streams, see extract_ac3.c */
+static void close_streams(void *unused)
+{
+    if (in_file)
+	fclose(in_file);
+    if (out_file)
+	fclose(out_file);
+    in_file = out_file = NULL;
+}
+
 
 static void ps_loop (void)
 {
@@ -180,19 +190,17 @@ void extract_mpeg2(info_t *ipipe)
 
     int error=0;
 
-    verbose = ipipe->verbose;
-
     switch(ipipe->magic) {
 
     case TC_MAGIC_VOB:
 
-      in_file = fdopen(ipipe->fd_in, "r");
-      out_file = fdopen(ipipe->fd_out, "w");
+      in_file = fdopen(dup(ipipe->fd_in), "r");
+      out_file = fdopen(dup(ipipe->fd_out), "w");
+      pthread_cleanup_push(close_streams, NULL);
 
       ps_loop();
 
-      fclose(in_file);
-      fclose(out_file);
+      pthread_cleanup_pop(1);
 
       break;
 
@@ -33,16 +33,26 @@
 #include "tc.h"
 
 #define MAX_BUF 4096
-char audio[MAX_BUF];
+static char audio[MAX_BUF];
 
 #define BUFFER_SIZE 262144
 static uint8_t buffer[BUFFER_SIZE];
 static FILE *in_file, *out_file;
 
+/* cleanup handler for the streams, see extract_ac3.c */
+static void close_streams(void *unused)
+{
+    if (in_file)
+	fclose(in_file);
+    if (out_file)
+	fclose(out_file);
+    in_file = out_file = NULL;
+}
+
 static unsigned int track_code;
 
 
-static void pes_lpcm_loop (void)
+static void pes_lpcm_loop (int verbose_flag)
 {
     static int mpeg1_skip_table[16] = {
 	     1, 0xffff,      5,     10, 0xffff, 0xffff, 0xffff, 0xffff,
@@ -81,7 +91,7 @@ static void pes_lpcm_loop (void)
 
 	// check for valid start code
 	if (buf[0] || buf[1] || (buf[2] != 0x01)) {
-	  if (complain_loudly && (verbose & TC_DEBUG)) {
+	  if (complain_loudly && (verbose_flag & TC_DEBUG)) {
 	    tc_log_warn(__FILE__, "missing start code at %#lx",
 			ftell (in_file) - (end - buf));
 	    if ((buf[0] == 0) && (buf[1] == 0) && (buf[2] == 0))
@@ -92,7 +102,7 @@ static void pes_lpcm_loop (void)
 	  continue;
 	}// check for valid start code
 
-	if(verbose & TC_STATS)
+	if(verbose_flag & TC_STATS)
 	  tc_log_msg(__FILE__, "packet code 0x%x", buf[3]);
 
 	switch (buf[3]) {
@@ -138,7 +148,7 @@ static void pes_lpcm_loop (void)
 	    tmp1 += mpeg1_skip_table [*tmp1 >> 4];
 	  }
 
-	  if(verbose & TC_STATS)
+	  if(verbose_flag & TC_STATS)
 	    tc_log_msg(__FILE__, "track code 0x%x", *tmp1);
 
 	  if (*tmp1 == track_code) {
@@ -356,14 +366,14 @@ void extract_pcm(info_t *ipipe)
 
   case TC_MAGIC_VOB:
 
-      in_file = fdopen(ipipe->fd_in, "r");
-      out_file = fdopen(ipipe->fd_out, "w");
+      in_file = fdopen(dup(ipipe->fd_in), "r");
+      out_file = fdopen(dup(ipipe->fd_out), "w");
+      pthread_cleanup_push(close_streams, NULL);
 
       track_code = 0xA0 + ipipe->track;
-      pes_lpcm_loop();
+      pes_lpcm_loop(ipipe->verbose);
 
-      fclose(in_file);
-      fclose(out_file);
+      pthread_cleanup_pop(1);
 
     break;
 
@@ -32,6 +32,7 @@ static int capability_flag = TC_CAP_PCM | TC_CAP_AC3;
 
 #define MOD_PRE ac3
 #include "import_def.h"
+#include "tcpipeline.h"
 
 #include "ac3scan.h"
 
@@ -40,6 +41,11 @@ char import_cmd_buf[TC_BUF_MAX];
 
 static FILE *fd;
 
+/* pipeline stages run in-process instead of as tcextract/tcdecode */
+static const TCPipelineBuiltin * const builtins[] = {
+    &tc_pipeline_tcextract, &tc_pipeline_tcdecode, NULL
+};
+
 static int codec, syncf=0;
 static int pseudo_frame_size=0, real_frame_size=0, effective_frame_size=0;
 static int ac3_bytes_to_go=0;
@@ -108,9 +114,9 @@ MOD_open
     // set to NULL if we handle read
     param->fd = NULL;
 
-    // popen
-    if((fd = popen(import_cmd_buf, "r"))== NULL) {
-	tc_log_perror(MOD_NAME, "popen pcm stream");
+    // start pipeline
+    if((fd = tc_pipeline_open(import_cmd_buf, builtins))== NULL) {
+	tc_log_perror(MOD_NAME, "open pcm stream");
 	return(TC_IMPORT_ERROR);
     }
 
@@ -209,7 +215,7 @@ MOD_decode
 
 MOD_close
 {
-  if(param->fd != NULL) pclose(param->fd);
+  if(param->fd != NULL) tc_pipeline_close(param->fd);
 
   return(TC_IMPORT_OK);
 }
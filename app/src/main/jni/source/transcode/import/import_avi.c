@@ -33,6 +33,7 @@ static int capability_flag = TC_CAP_PCM | TC_CAP_RGB | TC_CAP_AUD |
 
 #define MOD_PRE avi
 #include "import_def.h"
+#include "tcpipeline.h"
 
 #include "libtc/xio.h"
 #include "libtc/tccodecs.h"
@@ -129,7 +130,7 @@ MOD_open
                 return TC_ERROR;
             if (verbose_flag)
                 tc_log_info(MOD_NAME, "%s", import_cmd_buf);
-            param->fd = popen(import_cmd_buf, "r");
+            param->fd = tc_pipeline_open(import_cmd_buf, NULL);
             if (param->fd == NULL) {
                 return TC_ERROR;
             }
@@ -350,7 +351,7 @@ MOD_decode
 MOD_close
 {
     if (param->fd != NULL)
-        pclose(param->fd);
+        tc_pipeline_close(param->fd);
 
     if (param->flag == TC_AUDIO) {
         CLOSE_AVIFILE(avifile_aud);
@@ -32,6 +32,7 @@ static int capability_flag = TC_CAP_PCM;
 
 #define MOD_PRE mp3
 #include "import_def.h"
+#include "tcpipeline.h"
 
 #include "libtc/xio.h"
 
@@ -39,6 +40,11 @@ char import_cmd_buf[TC_BUF_MAX];
 
 static FILE *fd;
 
+/* pipeline stages run in-process instead of as tcextract/tcdecode */
+static const TCPipelineBuiltin * const builtins[] = {
+    &tc_pipeline_tcextract, &tc_pipeline_tcdecode, NULL
+};
+
 static int codec;
 
 static int count=TC_PAD_AUD_FRAMES;
@@ -136,9 +142,9 @@ MOD_open
     // set to NULL if we handle read
     param->fd = NULL;
 
-    // popen
-    if((fd = popen(import_cmd_buf, "r"))== NULL) {
-	tc_log_perror(MOD_NAME, "popen pcm stream");
+    // start pipeline
+    if((fd = tc_pipeline_open(import_cmd_buf, builtins))== NULL) {
+	tc_log_perror(MOD_NAME, "open pcm stream");
 	return(TC_IMPORT_ERROR);
     }
 
@@ -212,8 +218,8 @@ MOD_close
 
   if(param->flag != TC_AUDIO) return(TC_IMPORT_ERROR);
 
-  if(fd != NULL) pclose(fd);
-  if(param->fd != NULL) pclose(param->fd);
+  if(fd != NULL) tc_pipeline_close(fd);
+  if(param->fd != NULL) tc_pipeline_close(param->fd);
 
   fd        = NULL;
   param->fd = NULL;
@@ -32,6 +32,7 @@ static int capability_flag = TC_CAP_RGB | TC_CAP_YUV | TC_CAP_VID;
 
 #define MOD_PRE mpeg2
 #include "import_def.h"
+#include "tcpipeline.h"
 
 
 char import_cmd_buf[TC_BUF_MAX];
@@ -48,6 +49,11 @@ static tbuf_t tbuf;
 static int m2v_passthru=0;
 static FILE *f; // video fd
 
+/* pipeline stages run in-process instead of as tcextract/tcdecode */
+static const TCPipelineBuiltin * const builtins[] = {
+    &tc_pipeline_tcextract, &tc_pipeline_tcdecode, NULL
+};
+
 
 /* ------------------------------------------------------------
  *
@@ -145,9 +151,9 @@ MOD_open
 
   param->fd = NULL;
 
-  // popen
-  if((param->fd = popen(import_cmd_buf, "r"))== NULL) {
-    tc_log_perror(MOD_NAME, "popen RGB stream");
+  // start pipeline
+  if((param->fd = tc_pipeline_open(import_cmd_buf, builtins))== NULL) {
+    tc_log_perror(MOD_NAME, "open RGB stream");
     return(TC_IMPORT_ERROR);
   }
 
@@ -336,8 +342,8 @@ MOD_decode{
 MOD_close
 {
 
-    if(param->fd != NULL) pclose(param->fd);
-    if(f != NULL) pclose(f);
+    if(param->fd != NULL) tc_pipeline_close(param->fd);
+    if(f != NULL) tc_pipeline_close(f);
     param->fd = f = NULL;
 
     return(TC_IMPORT_OK);
@@ -432,25 +432,34 @@ static int pvn_demultiplex(TCModuleInstance *self,
         return TC_ERROR;
     }
 
+    /* 8-bit RGB is already in our format: read it straight into the
+     * frame, without going through pd->buffer */
+    if (pd->imagetype == RGB && pd->datatype == UINT8) {
+        if (tc_pread(pd->fd, vframe->video_buf, pd->framesize)
+            != pd->framesize
+        ) {
+            if (verbose)
+                tc_log_info(MOD_NAME, "End of stream reached");
+            return TC_ERROR;
+        }
+        return pd->framesize;
+    }
+
     if (tc_pread(pd->fd, pd->buffer, pd->framesize) != pd->framesize) {
         if (verbose)
             tc_log_info(MOD_NAME, "End of stream reached");
         return TC_ERROR;
     }
 
-    /* Shortcuts for RGB->RGB */
-    if (pd->imagetype == RGB) {
-        if (pd->datatype == UINT8) {
-            ac_memcpy(vframe->video_buf, pd->buffer, pd->framesize);
-            return pd->framesize;
 #if USE_DECODE_PVN_SSE2
-        } else if ((tc_accel & AC_SSE2)
-                && decode_pvn_sse2(pd, vframe->video_buf)
-        ) {
-            return pd->framesize;
-#endif
-        }
+    /* Shortcut for other RGB formats */
+    if (pd->imagetype == RGB
+     && (tc_accel & AC_SSE2)
+     && decode_pvn_sse2(pd, vframe->video_buf)
+    ) {
+        return pd->framesize;
     }
+#endif
 
     {
         /* Local copies of PrivateData variables, for compiler optimization */
@@ -566,8 +575,8 @@ static int pvn_demultiplex(TCModuleInstance *self,
  *     pd->imagetype == RGB
  *     video_buf != NULL
  * Notes:
- *     UINT8 is not handled here, as pvn_demultiplex() just calls
- *     ac_memcpy() for that case.
+ *     UINT8 is not handled here, as pvn_demultiplex() reads that case
+ *     directly into the frame buffer.
  *     The wisdom of including an architecture-specific accelerated routine
  *     directly in an import module is debatable, but cross-platform
  *     handling of big-endian values, especially floats, is _slow_...
@@ -920,6 +929,10 @@ MOD_open
         pvn_fini(&mod);
         return TC_ERROR;
     }
+    if (pd->imagetype == RGB && pd->datatype == UINT8) {
+        /* read directly into the frame buffer, see pvn_demultiplex() */
+        return TC_OK;
+    }
     pd->buffer = tc_bufalloc(pd->framesize);
     if (!pd->buffer) {
         tc_log_error(MOD_NAME, "No memory for import frame buffer");
@@ -957,9 +970,9 @@ MOD_decode
     }
 
     vframe.video_buf = param->buffer;
-    if (pvn_demultiplex(&mod, &vframe, NULL) < 0)
+    param->size = pvn_demultiplex(&mod, &vframe, NULL);
+    if (param->size < 0)
         return TC_ERROR;
-    param->size = vframe.video_size;
     return TC_OK;
 }
 
@@ -33,9 +33,43 @@ static int capability_flag = TC_CAP_RGB|TC_CAP_YUV|TC_CAP_PCM|TC_CAP_YUV422;
 #define MOD_PRE raw
 #include "import_def.h"
 
+#include <fcntl.h>
+#include <sys/stat.h>
+
 #define MAX_BUF 1024
 static char import_cmd_buf[MAX_BUF];
 static int codec;
+static int vid_fd = -1;  /* raw video file read by MOD_decode, or -1 */
+
+/*
+ * open_raw_video:  Open the video source for reading frames straight into
+ * the frame buffers passed to MOD_decode, if it is a plain file holding
+ * raw frames.  Returns the file descriptor, or -1 if the source has to go
+ * through tcextract (directories, pipes, AVI and YUV4MPEG files).
+ */
+static int open_raw_video(const char *path)
+{
+    struct stat st;
+    uint8_t magic[9];
+    int fd;
+
+    if (stat(path, &st) != 0 || !S_ISREG(st.st_mode))
+        return -1;
+    fd = open(path, O_RDONLY);
+    if (fd < 0)
+        return -1;
+    if (tc_pread(fd, magic, sizeof(magic)) == sizeof(magic)
+     && (memcmp(magic, "RIFF", 4) == 0 || memcmp(magic, "YUV4MPEG2", 9) == 0)
+    ) {
+        close(fd);
+        return -1;
+    }
+    if (lseek(fd, 0, SEEK_SET) != 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
 
 /* ------------------------------------------------------------
  *
@@ -84,6 +118,17 @@ MOD_open
 
         codec = vob->im_v_codec;
 
+        if (!vob->im_v_string) {
+            vid_fd = open_raw_video(vob->video_in_file);
+            if (vid_fd >= 0) {
+                if (verbose_flag)
+                    tc_log_info(MOD_NAME, "reading raw frames from %s",
+                                vob->video_in_file);
+                param->fd = NULL;
+                return TC_OK;
+            }
+        }
+
         //directory mode?
         if (tc_file_check(vob->video_in_file) == 1) {
             tc_snprintf(cat_buf, sizeof(cat_buf), "tccat");
@@ -159,7 +204,11 @@ MOD_open
  * ------------------------------------------------------------*/
 
 MOD_decode
-{   
+{
+    if (param->flag == TC_VIDEO && vid_fd >= 0) {
+        if (tc_pread(vid_fd, param->buffer, param->size) != param->size)
+            return TC_ERROR;
+    }
     return TC_OK;
 }
 
@@ -172,6 +221,10 @@ MOD_decode
 
 MOD_close
 {
+    if (param->flag == TC_VIDEO && vid_fd >= 0) {
+        close(vid_fd);
+        vid_fd = -1;
+    }
     if (param->fd != NULL)
         pclose(param->fd);
 
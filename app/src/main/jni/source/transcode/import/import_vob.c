@@ -60,6 +60,7 @@ static int capability_flag = TC_CAP_VID | TC_CAP_RGB | TC_CAP_YUV | TC_CAP_PCM |
 
 #define MOD_PRE vob
 #include "import_def.h"
+#include "tcpipeline.h"
 
 #include "ac3scan.h"
 #include "demuxer.h"
@@ -84,6 +85,11 @@ static int pseudo_frame_size=0, real_frame_size=0, effective_frame_size=0;
 static int ac3_bytes_to_go=0;
 static FILE *fd;
 
+/* pipeline stages run in-process instead of as tcextract/tcdecode */
+static const TCPipelineBuiltin * const builtins[] = {
+    &tc_pipeline_tcextract, &tc_pipeline_tcdecode, NULL
+};
+
 /* ------------------------------------------------------------
  *
  * open stream
@@ -234,9 +240,9 @@ MOD_open
     // set to NULL if we handle read
     param->fd = NULL;
 
-    // popen
-    if((fd = popen(import_cmd_buf, "r"))== NULL) {
-      tc_log_perror(MOD_NAME, "popen PCM stream");
+    // start pipeline
+    if((fd = tc_pipeline_open(import_cmd_buf, builtins))== NULL) {
+      tc_log_perror(MOD_NAME, "open PCM stream");
       return(TC_IMPORT_ERROR);
     }
     return(TC_IMPORT_OK);
@@ -259,9 +265,9 @@ MOD_open
     // print out
     if(verbose_flag) tc_log_info(MOD_NAME, "%s", import_cmd_buf);
 
-    // popen
-    if((param->fd = popen(import_cmd_buf, "r"))== NULL) {
-      tc_log_perror(MOD_NAME, "popen subtitle stream");
+    // start pipeline
+    if((param->fd = tc_pipeline_open(import_cmd_buf, builtins))== NULL) {
+      tc_log_perror(MOD_NAME, "open subtitle stream");
       return(TC_IMPORT_ERROR);
     }
 
@@ -349,9 +355,9 @@ MOD_open
 
       param->fd = NULL;
 
-      // popen
-      if((param->fd = popen(import_cmd_buf, "r"))== NULL) {
-	tc_log_perror(MOD_NAME, "popen RGB stream");
+      // start pipeline
+      if((param->fd = tc_pipeline_open(import_cmd_buf, builtins))== NULL) {
+	tc_log_perror(MOD_NAME, "open RGB stream");
 	return(TC_IMPORT_ERROR);
       }
 
@@ -641,12 +647,12 @@ MOD_close
 {
 
     if(param->fd) {
-	pclose(param->fd);
+	tc_pipeline_close(param->fd);
     }
     param->fd = NULL;
 
     if (f) {
-      pclose (f);
+      tc_pipeline_close(f);
     }
     f = NULL;
 
@@ -664,7 +670,7 @@ MOD_close
 
     if(param->flag == TC_AUDIO) {
 
-      if(fd) pclose(fd);
+      if(fd) tc_pipeline_close(fd);
       fd=NULL;
 
       return(0);
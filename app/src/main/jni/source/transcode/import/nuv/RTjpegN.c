@@ -8,6 +8,8 @@
 
    Modified for transcode (warning cleanup) by Andrew Church
    <achurch@achurch.org>
+   Reentrant context, SSE2/AVX2 DCT kernels and banded decoding added
+   for transcode.
 
     This program is free software; you can redistribute it and/or modify
     it under the terms of the GNU General Public License as published by
@@ -26,16 +28,76 @@
 */
 
 #include "RTjpegN.h"
+#include "aclib/ac.h"
+#include "libtc/tcworkers.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
-#ifdef MMX
-#include "mmx.h"
+#if defined(__SSE2__)
+# define RTJPEG_SSE2
+# include <emmintrin.h>
+# if defined(__clang__) || (defined(__GNUC__) && __GNUC__ >= 5)
+#  define RTJPEG_AVX2
+#  include <immintrin.h>
+# endif
 #endif
 
+
 //#define SHOWBLOCK 1
-#define BETTERCOMPRESSION 1
+
+/* Maximum number of decoding threads per context. */
+#define RTJPEG_MAX_THREADS TC_WORKERS_MAX
+
+/* Coefficient block of one band; each band being decoded has its own. */
+struct RTjpegSlice {
+    int16_t block[64];
+};
+
+/* Decoding routine for one frame format, run on macroblock rows
+ * [row0,row1) starting at stream position `sp'. */
+typedef void (*RTjpegDecodeFunc)(RTjpegContext *ctx, int16_t *block,
+                                 int8_t *sp, uint8_t *bp,
+                                 int row0, int row1);
+
+struct RTjpegContext {
+    int16_t block[64];          /* Work block for compression */
+    int32_t lqt[64];            /* Forward quantisation tables */
+    int32_t cqt[64];
+    uint32_t liqt[64];          /* Inverse quantisation tables */
+    uint32_t ciqt[64];
+
+    unsigned char lb8;
+    unsigned char cb8;
+    int width, height;
+    int Ywidth, Cwidth;
+    int Ysize, Csize;
+
+    int16_t *old;               /* Previous blocks for mcompress*() */
+    int old_size;
+    uint16_t lmask;
+    uint16_t cmask;
+    int mtest;
+
+    /* Kernels selected by RTjpeg_new() */
+    void (*dctY)(uint8_t *idata, int16_t *odata, int rskip);
+    void (*idct)(uint8_t *odata, int16_t *data, int rskip);
+    void (*quant)(int16_t *block, int32_t *qtbl);
+
+    /* Stream position of each macroblock row, for banded decoding */
+    int8_t **rowpos;
+    int rowpos_size;
+
+    /* Decoding threads (see RTjpeg_set_threads()), NULL for just the
+     * caller, and one block per band.  A job is described by
+     * decode_func, decode_bp, decode_rows and job_count. */
+    TCWorkers *workers;
+    struct RTjpegSlice *slices;
+    RTjpegDecodeFunc decode_func;
+    uint8_t *decode_bp;
+    int decode_rows;
+    int job_count;
+};
 
 static const unsigned char RTjpeg_ZZ[64]={
 0,
@@ -65,35 +127,6 @@ static const uint64_t RTjpeg_aan_tab[64]={
 1184891264ULL, 1643641088ULL, 1548224000ULL, 1393296000ULL, 1184891264ULL, 931136000ULL, 641204288ULL, 326894240ULL,
 };
 
-#ifndef MMX
-static int32_t RTjpeg_ws[64+31];
-#endif
-uint8_t RTjpeg_alldata[2*64+4*64+4*64+4*64+4*64+32];
-
-int16_t *block; // rh
-int16_t *RTjpeg_block;
-int32_t *RTjpeg_lqt;
-int32_t *RTjpeg_cqt;
-uint32_t *RTjpeg_liqt;
-uint32_t *RTjpeg_ciqt;
-
-unsigned char RTjpeg_lb8;
-unsigned char RTjpeg_cb8;
-int RTjpeg_width, RTjpeg_height;
-int RTjpeg_Ywidth, RTjpeg_Cwidth;
-int RTjpeg_Ysize, RTjpeg_Csize;
-
-int16_t *RTjpeg_old=NULL;
-
-#ifdef MMX
-mmx_t RTjpeg_lmask;
-mmx_t RTjpeg_cmask;
-#else
-uint16_t RTjpeg_lmask;
-uint16_t RTjpeg_cmask;
-#endif
-int RTjpeg_mtest=0;
-
 static const unsigned char RTjpeg_lum_quant_tbl[64] = {
     16,  11,  10,  16,  24,  40,  51,  61,
     12,  12,  14,  19,  26,  58,  60,  55,
@@ -116,7 +149,7 @@ static const unsigned char RTjpeg_chrom_quant_tbl[64] = {
     99,  99,  99,  99,  99,  99,  99,  99
  };
 
-#ifdef BETTERCOMPRESSION
+
 
 /*--------------------------------------------------*/
 /*  better encoding, but needs a lot more cpu time  */
@@ -446,154 +479,61 @@ fprintf(stderr, "\n\n");
  return ci;
 }
 
-#else
-
-static int RTjpeg_b2s(int16_t *data, int8_t *strm, uint8_t bt8)
-{
- register int ci, co=1, tmp;
- register int16_t ZZvalue;
-
-#ifdef SHOWBLOCK
-
-  int ii;
-  for (ii=0; ii < 64; ii++) {
-    fprintf(stderr, "%d ", data[RTjpeg_ZZ[ii]]);
-  }
-  fprintf(stderr, "\n\n");
-
-#endif
-
- (uint8_t)strm[0]=(uint8_t)(data[RTjpeg_ZZ[0]]>254) ? 254:((data[RTjpeg_ZZ[0]]<0)?0:data[RTjpeg_ZZ[0]]);
-
- for(ci=1; ci<=bt8; ci++)
- {
-	ZZvalue = data[RTjpeg_ZZ[ci]];
-
-   if(ZZvalue>0)
-	{
-     strm[co++]=(int8_t)(ZZvalue>127)?127:ZZvalue;
-   }
-	else
-	{
-     strm[co++]=(int8_t)(ZZvalue<-128)?-128:ZZvalue;
-   }
- }
-
- for(; ci<64; ci++)
- {
-  ZZvalue = data[RTjpeg_ZZ[ci]];
-
-  if(ZZvalue>0)
-  {
-   strm[co++]=(int8_t)(ZZvalue>63)?63:ZZvalue;
-  }
-  else if(ZZvalue<0)
-  {
-   strm[co++]=(int8_t)(ZZvalue<-64)?-64:ZZvalue;
-  }
-  else /* compress zeros */
-  {
-   tmp=ci;
-   do
-   {
-    ci++;
-   }
-	while((ci<64)&&(data[RTjpeg_ZZ[ci]]==0));
-
-   strm[co++]=(int8_t)(63+(ci-tmp));
-   ci--;
-  }
- }
- return (int)co;
-}
-
-static int RTjpeg_s2b(int16_t *data, int8_t *strm, uint8_t bt8, uint32_t *qtbl)
-{
- int ci=1, co=1, tmp;
- register int i;
-
- i=RTjpeg_ZZ[0];
- data[i]=((uint8_t)strm[0])*qtbl[i];
-
- for(co=1; co<=bt8; co++)
- {
-  i=RTjpeg_ZZ[co];
-  data[i]=strm[ci++]*qtbl[i];
- }
-
- for(; co<64; co++)
- {
-  if(strm[ci]>63)
-  {
-   tmp=co+strm[ci]-63;
-   for(; co<tmp; co++)data[RTjpeg_ZZ[co]]=0;
-   co--;
-  } else
-  {
-   i=RTjpeg_ZZ[co];
-   data[i]=strm[ci]*qtbl[i];
-  }
-  ci++;
- }
- return (int)ci;
-}
-#endif
-
-#if defined(MMX)
-static void RTjpeg_quant_init(void)
-{
- int i;
- int16_t *qtbl;
-
- qtbl=(int16_t *)RTjpeg_lqt;
- for(i=0; i<64; i++)qtbl[i]=(int16_t)RTjpeg_lqt[i];
-
- qtbl=(int16_t *)RTjpeg_cqt;
- for(i=0; i<64; i++)qtbl[i]=(int16_t)RTjpeg_cqt[i];
-}
-
-static mmx_t RTjpeg_ones=(mmx_t)(long long)0x0001000100010001LL;
-static mmx_t RTjpeg_half=(mmx_t)(long long)0x7fff7fff7fff7fffLL;
+/**
+ * RTjpeg_skip_block:  Return the length of the coded block at `strm',
+ * parsing it like RTjpeg_s2b() without decoding it.  Used to find where
+ * each band of a frame starts before decoding the bands in parallel.
+ *
+ * Parameters: strm: Start of the coded block.
+ * Return value: Length of the block in bytes.
+ */
 
-static void RTjpeg_quant(int16_t *block, int32_t *qtbl)
+static int RTjpeg_skip_block(const int8_t *strm)
 {
- int i;
- mmx_t *bl, *ql;
-
- ql=(mmx_t *)qtbl;
- bl=(mmx_t *)block;
-
- movq_m2r(RTjpeg_ones, mm6);
- movq_m2r(RTjpeg_half, mm7);
-
- for(i=16; i; i--)
- {
-  movq_m2r(*(ql++), mm0); /* quant vals (4) */
-  movq_m2r(*bl, mm2); /* block vals (4) */
-  movq_r2r(mm0, mm1);
-  movq_r2r(mm2, mm3);
-
-  punpcklwd_r2r(mm6, mm0); /*           1 qb 1 qa */
-  punpckhwd_r2r(mm6, mm1); /* 1 qd 1 qc */
-
-  punpcklwd_r2r(mm7, mm2); /*                   32767 bb 32767 ba */
-  punpckhwd_r2r(mm7, mm3); /* 32767 bd 32767 bc */
-
-  pmaddwd_r2r(mm2, mm0); /*                         32767+bb*qb 32767+ba*qa */
-  pmaddwd_r2r(mm3, mm1); /* 32767+bd*qd 32767+bc*qc */
-
-  psrad_i2r(16, mm0);
-  psrad_i2r(16, mm1);
-
-  packssdw_r2r(mm1, mm0);
-
-  movq_r2m(mm0, *(bl++));
+    int co, ci, bitoff;
+
+    if (strm[0] == -1)
+        return 1;
+    co = (uint8_t)strm[1] >> 2;
+    if (co == 0)
+        return 2;
+
+    /* 2-bit codes, starting with the low bits of the second byte */
+    ci = 1;
+    bitoff = 0;
+    for (; co > 0; co--) {
+        if ((((uint8_t)strm[ci] >> bitoff) & 0x03) == 0x02)
+            break;
+        if (bitoff == 0) {
+            bitoff = 8;
+            ci++;
+        }
+        bitoff -= 2;
+    }
+    if (co == 0)
+        return (bitoff != 6) ? ci+1 : ci;
+
+    /* 4-bit codes, starting on a nibble boundary */
+    if (bitoff == 4 || bitoff == 6) {
+        bitoff = 0;
+    } else {
+        ci++;
+        bitoff = 4;
+    }
+    for (; co > 0; co--) {
+        if ((((uint8_t)strm[ci] >> bitoff) & 0x0f) == 0x08)
+            break;
+        if (bitoff == 0) {
+            bitoff = 8;
+            ci++;
+        }
+        bitoff -= 4;
+    }
+    if (co == 0)
+        return (bitoff != 4) ? ci+1 : ci;
 
- }
-}
-#else
-static void RTjpeg_quant_init(void)
-{
+    /* One byte per remaining coefficient */
+    return ci + 1 + co;
 }
 
 static void RTjpeg_quant(int16_t *block, int32_t *qtbl)
@@ -603,19 +543,10 @@ static void RTjpeg_quant(int16_t *block, int32_t *qtbl)
  for(i=0; i<64; i++)
    block[i]=(int16_t)((block[i]*qtbl[i]+32767)>>16);
 }
-#endif
 
 /*
  * Perform the forward DCT on one block of samples.
  */
-#ifdef MMX
-static mmx_t RTjpeg_C4   =(mmx_t)(long long)0x2D412D412D412D41LL;
-static mmx_t RTjpeg_C6   =(mmx_t)(long long)0x187E187E187E187ELL;
-static mmx_t RTjpeg_C2mC6=(mmx_t)(long long)0x22A322A322A322A3LL;
-static mmx_t RTjpeg_C2pC6=(mmx_t)(long long)0x539F539F539F539FLL;
-static mmx_t RTjpeg_zero =(mmx_t)(long long)0x0000000000000000LL;
-
-#else
 
 #define FIX_0_382683433  ((int32_t)   98)		/* FIX(0.382683433) */
 #define FIX_0_541196100  ((int32_t)  139)		/* FIX(0.541196100) */
@@ -625,22 +556,20 @@ static mmx_t RTjpeg_zero =(mmx_t)(long long)0x0000000000000000LL;
 #define DESCALE10(x) (int16_t)( ((x)+128) >> 8)
 #define DESCALE20(x)  (int16_t)(((x)+32768) >> 16)
 #define D_MULTIPLY(var,const)  ((int32_t) ((var) * (const)))
-#endif
 
-static void RTjpeg_dct_init(void)
+static void RTjpeg_dct_init(RTjpegContext *ctx)
 {
  int i;
 
  for(i=0; i<64; i++)
  {
-  RTjpeg_lqt[i]=(((uint64_t)RTjpeg_lqt[i]<<32)/RTjpeg_aan_tab[i]);
-  RTjpeg_cqt[i]=(((uint64_t)RTjpeg_cqt[i]<<32)/RTjpeg_aan_tab[i]);
+  ctx->lqt[i]=(((uint64_t)ctx->lqt[i]<<32)/RTjpeg_aan_tab[i]);
+  ctx->cqt[i]=(((uint64_t)ctx->cqt[i]<<32)/RTjpeg_aan_tab[i]);
  }
 }
 
 static void RTjpeg_dctY(uint8_t *idata, int16_t *odata, int rskip)
 {
-#ifndef MMX
   int32_t tmp0, tmp1, tmp2, tmp3, tmp4, tmp5, tmp6, tmp7;
   int32_t tmp10, tmp11, tmp12, tmp13;
   int32_t z1, z2, z3, z4, z5, z11, z13;
@@ -648,9 +577,10 @@ static void RTjpeg_dctY(uint8_t *idata, int16_t *odata, int rskip)
   int16_t *odataptr;
   int32_t *wsptr;
   int ctr;
+  int32_t ws[64];
 
   idataptr = idata;
-  wsptr = RTjpeg_ws;
+  wsptr = ws;
   for (ctr = 7; ctr >= 0; ctr--) {
     tmp0 = idataptr[0] + idataptr[7];
     tmp7 = idataptr[0] - idataptr[7];
@@ -694,7 +624,7 @@ static void RTjpeg_dctY(uint8_t *idata, int16_t *odata, int rskip)
     wsptr += 8;
   }
 
-  wsptr = RTjpeg_ws;
+  wsptr = ws;
   odataptr=odata;
   for (ctr = 7; ctr >= 0; ctr--) {
     tmp0 = wsptr[0] + wsptr[56];
@@ -738,1989 +668,782 @@ static void RTjpeg_dctY(uint8_t *idata, int16_t *odata, int rskip)
     odataptr++;			/* advance pointer to next column */
     wsptr++;
   }
-#else
-  volatile mmx_t tmp6, tmp7;
-  register mmx_t *dataptr = (mmx_t *)odata;
-  mmx_t *idata2 = (mmx_t *)idata;
+}
 
-   // first copy the input 8 bit to the destination 16 bits
+#define FIX_1_082392200  ((int32_t)  277)		/* FIX(1.082392200) */
+#define FIX_1_414213562  ((int32_t)  362)		/* FIX(1.414213562) */
+#define FIX_1_847759065  ((int32_t)  473)		/* FIX(1.847759065) */
+#define FIX_2_613125930  ((int32_t)  669)		/* FIX(2.613125930) */
 
-   movq_m2r(RTjpeg_zero, mm2);
+#define DESCALE(x) (int16_t)( ((x)+4) >> 3)
 
+/* clip yuv to 16..235 (should be 16..240 for cr/cb but ... */
 
-	movq_m2r(*idata2, mm0);
-	movq_r2r(mm0, mm1);
+#define RL(x) ((x)>235) ? 235 : (((x)<16) ? 16 : (x))
+#define MULTIPLY(var,const)  (((int32_t) ((var) * (const)) + 128)>>8)
 
-	punpcklbw_r2r(mm2, mm0);
-	movq_r2m(mm0, *(dataptr));
 
-	punpckhbw_r2r(mm2, mm1);
-	movq_r2m(mm1, *(dataptr+1));
+static void RTjpeg_idct_init(RTjpegContext *ctx)
+{
+ int i;
 
-	idata2 += rskip;
+ for(i=0; i<64; i++)
+ {
+  ctx->liqt[i]=((uint64_t)ctx->liqt[i]*RTjpeg_aan_tab[i])>>32;
+  ctx->ciqt[i]=((uint64_t)ctx->ciqt[i]*RTjpeg_aan_tab[i])>>32;
+ }
+}
 
-	movq_m2r(*idata2, mm0);
-	movq_r2r(mm0, mm1);
+static void RTjpeg_idct(uint8_t *odata, int16_t *data, int rskip)
+{
+  int32_t tmp0, tmp1, tmp2, tmp3, tmp4, tmp5, tmp6, tmp7;
+  int32_t tmp10, tmp11, tmp12, tmp13;
+  int32_t z5, z10, z11, z12, z13;
+  int16_t *inptr;
+  int32_t *wsptr;
+  uint8_t *outptr;
+  int ctr;
+  int32_t dcval;
+  int32_t workspace[64];
 
-	punpcklbw_r2r(mm2, mm0);
-	movq_r2m(mm0, *(dataptr+2));
+  inptr = data;
+  wsptr = workspace;
+  for (ctr = 8; ctr > 0; ctr--) {
 
-	punpckhbw_r2r(mm2, mm1);
-	movq_r2m(mm1, *(dataptr+3));
+    if ((inptr[8] | inptr[16] | inptr[24] |
+	 inptr[32] | inptr[40] | inptr[48] | inptr[56]) == 0) {
+      dcval = inptr[0];
+      wsptr[0] = dcval;
+      wsptr[8] = dcval;
+      wsptr[16] = dcval;
+      wsptr[24] = dcval;
+      wsptr[32] = dcval;
+      wsptr[40] = dcval;
+      wsptr[48] = dcval;
+      wsptr[56] = dcval;
 
-	idata2 += rskip;
+      inptr++;
+      wsptr++;
+      continue;
+    }
 
-	movq_m2r(*idata2, mm0);
-	movq_r2r(mm0, mm1);
+    tmp0 = inptr[0];
+    tmp1 = inptr[16];
+    tmp2 = inptr[32];
+    tmp3 = inptr[48];
 
-	punpcklbw_r2r(mm2, mm0);
-	movq_r2m(mm0, *(dataptr+4));
+    tmp10 = tmp0 + tmp2;
+    tmp11 = tmp0 - tmp2;
 
-	punpckhbw_r2r(mm2, mm1);
-	movq_r2m(mm1, *(dataptr+5));
+    tmp13 = tmp1 + tmp3;
+    tmp12 = MULTIPLY(tmp1 - tmp3, FIX_1_414213562) - tmp13;
 
-	idata2 += rskip;
+    tmp0 = tmp10 + tmp13;
+    tmp3 = tmp10 - tmp13;
+    tmp1 = tmp11 + tmp12;
+    tmp2 = tmp11 - tmp12;
 
-	movq_m2r(*idata2, mm0);
-	movq_r2r(mm0, mm1);
+    tmp4 = inptr[8];
+    tmp5 = inptr[24];
+    tmp6 = inptr[40];
+    tmp7 = inptr[56];
 
-	punpcklbw_r2r(mm2, mm0);
-	movq_r2m(mm0, *(dataptr+6));
+    z13 = tmp6 + tmp5;
+    z10 = tmp6 - tmp5;
+    z11 = tmp4 + tmp7;
+    z12 = tmp4 - tmp7;
 
-	punpckhbw_r2r(mm2, mm1);
-	movq_r2m(mm1, *(dataptr+7));
+    tmp7 = z11 + z13;
+    tmp11 = MULTIPLY(z11 - z13, FIX_1_414213562);
 
-	idata2 += rskip;
+    z5 = MULTIPLY(z10 + z12, FIX_1_847759065);
+    tmp10 = MULTIPLY(z12, FIX_1_082392200) - z5;
+    tmp12 = MULTIPLY(z10, - FIX_2_613125930) + z5;
 
-	movq_m2r(*idata2, mm0);
-	movq_r2r(mm0, mm1);
+    tmp6 = tmp12 - tmp7;
+    tmp5 = tmp11 - tmp6;
+    tmp4 = tmp10 + tmp5;
 
-	punpcklbw_r2r(mm2, mm0);
-	movq_r2m(mm0, *(dataptr+8));
+    wsptr[0] = (int32_t) (tmp0 + tmp7);
+    wsptr[56] = (int32_t) (tmp0 - tmp7);
+    wsptr[8] = (int32_t) (tmp1 + tmp6);
+    wsptr[48] = (int32_t) (tmp1 - tmp6);
+    wsptr[16] = (int32_t) (tmp2 + tmp5);
+    wsptr[40] = (int32_t) (tmp2 - tmp5);
+    wsptr[32] = (int32_t) (tmp3 + tmp4);
+    wsptr[24] = (int32_t) (tmp3 - tmp4);
 
-	punpckhbw_r2r(mm2, mm1);
-	movq_r2m(mm1, *(dataptr+9));
+    inptr++;
+    wsptr++;
+  }
 
-	idata2 += rskip;
+  wsptr = workspace;
+  for (ctr = 0; ctr < 8; ctr++) {
+    outptr = &(odata[ctr*rskip]);
 
-	movq_m2r(*idata2, mm0);
-	movq_r2r(mm0, mm1);
+    tmp10 = wsptr[0] + wsptr[4];
+    tmp11 = wsptr[0] - wsptr[4];
 
-	punpcklbw_r2r(mm2, mm0);
-	movq_r2m(mm0, *(dataptr+10));
+    tmp13 = wsptr[2] + wsptr[6];
+    tmp12 = MULTIPLY(wsptr[2] - wsptr[6], FIX_1_414213562) - tmp13;
 
-	punpckhbw_r2r(mm2, mm1);
-	movq_r2m(mm1, *(dataptr+11));
+    tmp0 = tmp10 + tmp13;
+    tmp3 = tmp10 - tmp13;
+    tmp1 = tmp11 + tmp12;
+    tmp2 = tmp11 - tmp12;
 
-	idata2 += rskip;
+    z13 = wsptr[5] + wsptr[3];
+    z10 = wsptr[5] - wsptr[3];
+    z11 = wsptr[1] + wsptr[7];
+    z12 = wsptr[1] - wsptr[7];
 
-	movq_m2r(*idata2, mm0);
-	movq_r2r(mm0, mm1);
+    tmp7 = z11 + z13;
+    tmp11 = MULTIPLY(z11 - z13, FIX_1_414213562);
 
-	punpcklbw_r2r(mm2, mm0);
-	movq_r2m(mm0, *(dataptr+12));
+    z5 = MULTIPLY(z10 + z12, FIX_1_847759065);
+    tmp10 = MULTIPLY(z12, FIX_1_082392200) - z5;
+    tmp12 = MULTIPLY(z10, - FIX_2_613125930) + z5;
 
-	punpckhbw_r2r(mm2, mm1);
-	movq_r2m(mm1, *(dataptr+13));
+    tmp6 = tmp12 - tmp7;
+    tmp5 = tmp11 - tmp6;
+    tmp4 = tmp10 + tmp5;
 
-	idata2 += rskip;
+    outptr[0] = RL(DESCALE(tmp0 + tmp7));
+    outptr[7] = RL(DESCALE(tmp0 - tmp7));
+    outptr[1] = RL(DESCALE(tmp1 + tmp6));
+    outptr[6] = RL(DESCALE(tmp1 - tmp6));
+    outptr[2] = RL(DESCALE(tmp2 + tmp5));
+    outptr[5] = RL(DESCALE(tmp2 - tmp5));
+    outptr[4] = RL(DESCALE(tmp3 + tmp4));
+    outptr[3] = RL(DESCALE(tmp3 - tmp4));
 
-	movq_m2r(*idata2, mm0);
-	movq_r2r(mm0, mm1);
+    wsptr += 8;
+  }
+}
 
-	punpcklbw_r2r(mm2, mm0);
-	movq_r2m(mm0, *(dataptr+14));
+/*************************************************************************/
+
+/* SSE2 and AVX2 versions of RTjpeg_dctY(), RTjpeg_idct() and
+ * RTjpeg_quant().  They do the same 32-bit arithmetic as the C routines,
+ * in the same order, and give exactly the same results.
+ *
+ * Each 1-D pass works on eight rows (or columns) at once, one per vector
+ * lane: the SSE2 routines split the eight lanes over two 4-lane vectors,
+ * the AVX2 routines use one 8-lane vector.  The passes themselves are
+ * written with the compiler's generic vector operators, so the same
+ * macros serve both widths; blocks are transposed between passes so that
+ * each pass always combines whole vectors.
+ *
+ * RDCT_1D() is the forward transform of one pass of RTjpeg_dctY(),
+ * leaving every output scaled up by 2^8 (the first pass stores them that
+ * way; the second pass descales them all by 2^16, which for outputs 0 and
+ * 4 is the same as DESCALE10() of the unscaled value).  RIDCT_1D() is one
+ * pass of RTjpeg_idct(). */
+
+#if defined(RTJPEG_SSE2) || defined(RTJPEG_AVX2)
+
+typedef int32_t v4si_t __attribute__((vector_size(16)));
+
+#define RDCT_1D(T,in,out,MUL) do {                                      \
+    T tmp0 = in[0] + in[7], tmp7 = in[0] - in[7];                       \
+    T tmp1 = in[1] + in[6], tmp6 = in[1] - in[6];                       \
+    T tmp2 = in[2] + in[5], tmp5 = in[2] - in[5];                       \
+    T tmp3 = in[3] + in[4], tmp4 = in[3] - in[4];                       \
+    T tmp10 = tmp0 + tmp3, tmp13 = tmp0 - tmp3;                         \
+    T tmp11 = tmp1 + tmp2, tmp12 = tmp1 - tmp2;                         \
+    T z1, z2, z3, z4, z5, z11, z13;                                     \
+    out[0] = (tmp10 + tmp11) << 8;                                      \
+    out[4] = (tmp10 - tmp11) << 8;                                      \
+    z1 = MUL(tmp12 + tmp13, FIX_0_707106781);                           \
+    out[2] = (tmp13 << 8) + z1;                                         \
+    out[6] = (tmp13 << 8) - z1;                                         \
+    tmp10 = tmp4 + tmp5;                                                \
+    tmp11 = tmp5 + tmp6;                                                \
+    tmp12 = tmp6 + tmp7;                                                \
+    z5 = MUL(tmp10 - tmp12, FIX_0_382683433);                           \
+    z2 = MUL(tmp10, FIX_0_541196100) + z5;                              \
+    z4 = MUL(tmp12, FIX_1_306562965) + z5;                              \
+    z3 = MUL(tmp11, FIX_0_707106781);                                   \
+    z11 = (tmp7 << 8) + z3;                                             \
+    z13 = (tmp7 << 8) - z3;                                             \
+    out[5] = z13 + z2;                                                  \
+    out[3] = z13 - z2;                                                  \
+    out[1] = z11 + z4;                                                  \
+    out[7] = z11 - z4;                                                  \
+} while (0)
+
+#define RMULTIPLY(MUL,v,c)  ((MUL(v, c) + 128) >> 8)
+
+/* Plain vector multiply, used when it is a single instruction. */
+#define VMUL(v,c)  ((v) * (c))
+
+/* The kernels are fully unrolled so the compiler can keep every vector
+ * in a register. */
+#define RTJPEG_REPEAT8(M)  M(0) M(1) M(2) M(3) M(4) M(5) M(6) M(7)
+
+#define RIDCT_1D(T,in,out,MUL) do {                                     \
+    T tmp0, tmp1, tmp2, tmp3, tmp4, tmp5, tmp6, tmp7;                   \
+    T tmp10, tmp11, tmp12, tmp13, z5, z10, z11, z12, z13;               \
+    tmp10 = in[0] + in[4];                                              \
+    tmp11 = in[0] - in[4];                                              \
+    tmp13 = in[2] + in[6];                                              \
+    tmp12 = RMULTIPLY(MUL, in[2] - in[6], FIX_1_414213562) - tmp13;     \
+    tmp0 = tmp10 + tmp13;                                               \
+    tmp3 = tmp10 - tmp13;                                               \
+    tmp1 = tmp11 + tmp12;                                               \
+    tmp2 = tmp11 - tmp12;                                               \
+    z13 = in[5] + in[3];                                                \
+    z10 = in[5] - in[3];                                                \
+    z11 = in[1] + in[7];                                                \
+    z12 = in[1] - in[7];                                                \
+    tmp7 = z11 + z13;                                                   \
+    tmp11 = RMULTIPLY(MUL, z11 - z13, FIX_1_414213562);                 \
+    z5 = RMULTIPLY(MUL, z10 + z12, FIX_1_847759065);                    \
+    tmp10 = RMULTIPLY(MUL, z12, FIX_1_082392200) - z5;                  \
+    tmp12 = RMULTIPLY(MUL, -z10, FIX_2_613125930) + z5;                 \
+    tmp6 = tmp12 - tmp7;                                                \
+    tmp5 = tmp11 - tmp6;                                                \
+    tmp4 = tmp10 + tmp5;                                                \
+    out[0] = tmp0 + tmp7;                                               \
+    out[7] = tmp0 - tmp7;                                               \
+    out[1] = tmp1 + tmp6;                                               \
+    out[6] = tmp1 - tmp6;                                               \
+    out[2] = tmp2 + tmp5;                                               \
+    out[5] = tmp2 - tmp5;                                               \
+    out[4] = tmp3 + tmp4;                                               \
+    out[3] = tmp3 - tmp4;                                               \
+} while (0)
+
+#endif  /* RTJPEG_SSE2 || RTJPEG_AVX2 */
+
+/*************************************************************************/
+
+#ifdef RTJPEG_SSE2
+
+/* Sign-extend the low 16 bits of each 32-bit lane, like an (int16_t)
+ * cast, so that _mm_packs_epi32() never saturates. */
+#define TRUNC16_SSE2(x) \
+    _mm_srai_epi32(_mm_slli_epi32((__m128i)(x), 16), 16)
+
+/* Multiply by a constant below 2^15 when v is known to fit in 16 bits. */
+#define MUL16_SSE2(v,c) \
+    ((v4si_t)_mm_madd_epi16((__m128i)(v), _mm_set1_epi32(c)))
+
+/* Multiply by a constant below 2^15.  SSE2 has no 32-bit multiply, so v
+ * is split into a signed low half and a high half (rounded to make up
+ * for the sign of the low half), each multiplied with PMADDWD. */
+static inline v4si_t RTjpeg_mul32_sse2(v4si_t v, int c)
+{
+    const __m128i k = _mm_set1_epi32(c);
+    __m128i hi = _mm_srai_epi32(_mm_add_epi32((__m128i)v,
+                                              _mm_set1_epi32(0x8000)), 16);
+    return (v4si_t)_mm_add_epi32(_mm_madd_epi16((__m128i)v, k),
+                                 _mm_slli_epi32(_mm_madd_epi16(hi, k), 16));
+}
+#define MUL32_SSE2(v,c)  RTjpeg_mul32_sse2((v), (c))
+
+/* Transpose the 4x4 block of 32-bit values in a0..a3 into b0..b3. */
+#define TRANSPOSE4_SSE2(a0,a1,a2,a3,b0,b1,b2,b3) do {                   \
+    __m128i t0 = _mm_unpacklo_epi32((__m128i)(a0), (__m128i)(a1));      \
+    __m128i t1 = _mm_unpacklo_epi32((__m128i)(a2), (__m128i)(a3));      \
+    __m128i t2 = _mm_unpackhi_epi32((__m128i)(a0), (__m128i)(a1));      \
+    __m128i t3 = _mm_unpackhi_epi32((__m128i)(a2), (__m128i)(a3));      \
+    b0 = (v4si_t)_mm_unpacklo_epi64(t0, t1);                            \
+    b1 = (v4si_t)_mm_unpackhi_epi64(t0, t1);                            \
+    b2 = (v4si_t)_mm_unpacklo_epi64(t2, t3);                            \
+    b3 = (v4si_t)_mm_unpackhi_epi64(t2, t3);                            \
+} while (0)
+
+/* Transpose an 8x8 block of 32-bit values held as in[h][i], where lane n
+ * of in[h][i] is element (i, 4h+n), into out[h][i] holding element
+ * (4h+n, i). */
+#define TRANSPOSE8_SSE2(in,out) do {                                    \
+    TRANSPOSE4_SSE2(in[0][0], in[0][1], in[0][2], in[0][3],             \
+                    out[0][0], out[0][1], out[0][2], out[0][3]);        \
+    TRANSPOSE4_SSE2(in[0][4], in[0][5], in[0][6], in[0][7],             \
+                    out[1][0], out[1][1], out[1][2], out[1][3]);        \
+    TRANSPOSE4_SSE2(in[1][0], in[1][1], in[1][2], in[1][3],             \
+                    out[0][4], out[0][5], out[0][6], out[0][7]);        \
+    TRANSPOSE4_SSE2(in[1][4], in[1][5], in[1][6], in[1][7],             \
+                    out[1][4], out[1][5], out[1][6], out[1][7]);        \
+} while (0)
+
+/* Transpose an 8x8 block of 16-bit values in place. */
+static inline void RTjpeg_transpose8_epi16(__m128i r[8])
+{
+    __m128i a = _mm_unpacklo_epi16(r[0], r[1]);
+    __m128i b = _mm_unpackhi_epi16(r[0], r[1]);
+    __m128i c = _mm_unpacklo_epi16(r[2], r[3]);
+    __m128i d = _mm_unpackhi_epi16(r[2], r[3]);
+    __m128i e = _mm_unpacklo_epi16(r[4], r[5]);
+    __m128i f = _mm_unpackhi_epi16(r[4], r[5]);
+    __m128i g = _mm_unpacklo_epi16(r[6], r[7]);
+    __m128i h = _mm_unpackhi_epi16(r[6], r[7]);
+    __m128i ac0 = _mm_unpacklo_epi32(a, c), ac1 = _mm_unpackhi_epi32(a, c);
+    __m128i bd0 = _mm_unpacklo_epi32(b, d), bd1 = _mm_unpackhi_epi32(b, d);
+    __m128i eg0 = _mm_unpacklo_epi32(e, g), eg1 = _mm_unpackhi_epi32(e, g);
+    __m128i fh0 = _mm_unpacklo_epi32(f, h), fh1 = _mm_unpackhi_epi32(f, h);
+    r[0] = _mm_unpacklo_epi64(ac0, eg0);
+    r[1] = _mm_unpackhi_epi64(ac0, eg0);
+    r[2] = _mm_unpacklo_epi64(ac1, eg1);
+    r[3] = _mm_unpackhi_epi64(ac1, eg1);
+    r[4] = _mm_unpacklo_epi64(bd0, fh0);
+    r[5] = _mm_unpackhi_epi64(bd0, fh0);
+    r[6] = _mm_unpacklo_epi64(bd1, fh1);
+    r[7] = _mm_unpackhi_epi64(bd1, fh1);
+}
 
-	punpckhbw_r2r(mm2, mm1);
-	movq_r2m(mm1, *(dataptr+15));
+static void RTjpeg_dctY_sse2(uint8_t *idata, int16_t *odata, int rskip)
+{
+    const __m128i zero = _mm_setzero_si128();
+    __m128i r[8];
+    v4si_t in[2][8], ws[2][8], cols[2][8], out[2][8];
+
+    /* Rows are loaded into lanes, so transpose first to get one row per
+     * lane for the row pass. */
+#define LOAD(i) \
+    r[i] = _mm_unpacklo_epi8(                                           \
+        _mm_loadl_epi64((const __m128i *)(idata + (i)*(rskip<<3))), zero);
+    RTJPEG_REPEAT8(LOAD)
+#undef LOAD
+    RTjpeg_transpose8_epi16(r);
+#define WIDEN(i) \
+    in[0][i] = (v4si_t)_mm_unpacklo_epi16(r[i], zero);                  \
+    in[1][i] = (v4si_t)_mm_unpackhi_epi16(r[i], zero);
+    RTJPEG_REPEAT8(WIDEN)
+#undef WIDEN
+    RDCT_1D(v4si_t, in[0], ws[0], MUL16_SSE2);
+    RDCT_1D(v4si_t, in[1], ws[1], MUL16_SSE2);
+    TRANSPOSE8_SSE2(ws, cols);
+    RDCT_1D(v4si_t, cols[0], out[0], MUL32_SSE2);
+    RDCT_1D(v4si_t, cols[1], out[1], MUL32_SSE2);
+#define STORE(i) \
+    _mm_storeu_si128((__m128i *)(odata + (i)*8), _mm_packs_epi32(       \
+        TRUNC16_SSE2((out[0][i] + 32768) >> 16),                        \
+        TRUNC16_SSE2((out[1][i] + 32768) >> 16)));
+    RTJPEG_REPEAT8(STORE)
+#undef STORE
+}
 
-/*  Start Transpose to do calculations on rows */
+static void RTjpeg_idct_sse2(uint8_t *odata, int16_t *data, int rskip)
+{
+    const __m128i lo = _mm_set1_epi16(16), hi = _mm_set1_epi16(235);
+    __m128i r[8];
+    v4si_t in[2][8], ws[2][8], rows[2][8], out[2][8];
+
+#define LOAD(i) {                                                       \
+    __m128i d = _mm_loadu_si128((const __m128i *)(data + (i)*8));       \
+    in[0][i] = (v4si_t)_mm_srai_epi32(_mm_unpacklo_epi16(d, d), 16);    \
+    in[1][i] = (v4si_t)_mm_srai_epi32(_mm_unpackhi_epi16(d, d), 16);    \
+}
+    RTJPEG_REPEAT8(LOAD)
+#undef LOAD
+    RIDCT_1D(v4si_t, in[0], ws[0], MUL32_SSE2);
+    RIDCT_1D(v4si_t, in[1], ws[1], MUL32_SSE2);
+    TRANSPOSE8_SSE2(ws, rows);
+    RIDCT_1D(v4si_t, rows[0], out[0], MUL32_SSE2);
+    RIDCT_1D(v4si_t, rows[1], out[1], MUL32_SSE2);
+    /* out[h][i] now holds column i of rows 4h..4h+3 */
+#define CLAMP(i) \
+    r[i] = _mm_min_epi16(_mm_max_epi16(_mm_packs_epi32(                 \
+        TRUNC16_SSE2((out[0][i] + 4) >> 3),                             \
+        TRUNC16_SSE2((out[1][i] + 4) >> 3)), lo), hi);
+    RTJPEG_REPEAT8(CLAMP)
+#undef CLAMP
+    RTjpeg_transpose8_epi16(r);
+#define STORE(i) {                                                      \
+    __m128i pix = _mm_packus_epi16(r[2*(i)], r[2*(i)+1]);               \
+    _mm_storel_epi64((__m128i *)(odata + 2*(i)*rskip), pix);            \
+    _mm_storel_epi64((__m128i *)(odata + (2*(i)+1)*rskip),              \
+                     _mm_srli_si128(pix, 8));                           \
+}
+    STORE(0) STORE(1) STORE(2) STORE(3)
+#undef STORE
+}
 
-	movq_m2r(*(dataptr+9), mm7);		 	// m03:m02|m01:m00 - first line (line 4)and copy into m5
+static void RTjpeg_quant_sse2(int16_t *block, int32_t *qtbl)
+{
+    int i;
+
+    for (i = 0; i < 64; i += 8) {
+        __m128i d = _mm_loadu_si128((const __m128i *)(block + i));
+        v4si_t lo = (v4si_t)_mm_srai_epi32(_mm_unpacklo_epi16(d, d), 16);
+        v4si_t hi = (v4si_t)_mm_srai_epi32(_mm_unpackhi_epi16(d, d), 16);
+        lo = (lo * (v4si_t)_mm_loadu_si128((const __m128i *)(qtbl + i))
+              + 32767) >> 16;
+        hi = (hi * (v4si_t)_mm_loadu_si128((const __m128i *)(qtbl + i+4))
+              + 32767) >> 16;
+        _mm_storeu_si128((__m128i *)(block + i),
+                         _mm_packs_epi32(TRUNC16_SSE2(lo), TRUNC16_SSE2(hi)));
+    }
+}
 
-	movq_m2r(*(dataptr+13), mm6);	    	// m23:m22|m21:m20 - third line (line 6)and copy into m2
-	movq_r2r(mm7, mm5);
+#endif  /* RTJPEG_SSE2 */
 
-	punpcklwd_m2r(*(dataptr+11), mm7); 	// m11:m01|m10:m00 - interleave first and second lines
-	movq_r2r(mm6, mm2);
+/*************************************************************************/
 
-	punpcklwd_m2r(*(dataptr+15), mm6);  // m31:m21|m30:m20 - interleave third and fourth lines
-	movq_r2r(mm7, mm1);
+#ifdef RTJPEG_AVX2
 
-	movq_m2r(*(dataptr+11), mm3);	      // m13:m13|m11:m10 - second line
-	punpckldq_r2r(mm6, mm7);				// m30:m20|m10:m00 - interleave to produce result 1
+#define AVX2 __attribute__((target("avx2")))
 
-	movq_m2r(*(dataptr+15), mm0);	      // m13:m13|m11:m10 - fourth line
-	punpckhdq_r2r(mm6, mm1);				// m31:m21|m11:m01 - interleave to produce result 2
+typedef int32_t v8si_t __attribute__((vector_size(32)));
 
-	movq_r2m(mm7,*(dataptr+9));			// write result 1
-	punpckhwd_r2r(mm3, mm5);				// m13:m03|m12:m02 - interleave first and second lines
+#define MUL16_AVX2(v,c) \
+    ((v8si_t)_mm256_madd_epi16((__m256i)(v), _mm256_set1_epi32(c)))
 
-	movq_r2m(mm1,*(dataptr+11));			// write result 2
-	punpckhwd_r2r(mm0, mm2);				// m33:m23|m32:m22 - interleave third and fourth lines
+#define TRUNC16_AVX2(x) \
+    _mm256_srai_epi32(_mm256_slli_epi32((__m256i)(x), 16), 16)
 
-	movq_r2r(mm5, mm1);
-	punpckldq_r2r(mm2, mm5);				// m32:m22|m12:m02 - interleave to produce result 3
+/* Transpose an 8x8 block of 32-bit values in place. */
+static inline AVX2 void RTjpeg_transpose8_avx2(__m256i r[8])
+{
+    __m256i t0 = _mm256_unpacklo_epi32(r[0], r[1]);
+    __m256i t1 = _mm256_unpackhi_epi32(r[0], r[1]);
+    __m256i t2 = _mm256_unpacklo_epi32(r[2], r[3]);
+    __m256i t3 = _mm256_unpackhi_epi32(r[2], r[3]);
+    __m256i t4 = _mm256_unpacklo_epi32(r[4], r[5]);
+    __m256i t5 = _mm256_unpackhi_epi32(r[4], r[5]);
+    __m256i t6 = _mm256_unpacklo_epi32(r[6], r[7]);
+    __m256i t7 = _mm256_unpackhi_epi32(r[6], r[7]);
+    __m256i u0 = _mm256_unpacklo_epi64(t0, t2);
+    __m256i u1 = _mm256_unpackhi_epi64(t0, t2);
+    __m256i u2 = _mm256_unpacklo_epi64(t1, t3);
+    __m256i u3 = _mm256_unpackhi_epi64(t1, t3);
+    __m256i u4 = _mm256_unpacklo_epi64(t4, t6);
+    __m256i u5 = _mm256_unpackhi_epi64(t4, t6);
+    __m256i u6 = _mm256_unpacklo_epi64(t5, t7);
+    __m256i u7 = _mm256_unpackhi_epi64(t5, t7);
+    r[0] = _mm256_permute2x128_si256(u0, u4, 0x20);
+    r[1] = _mm256_permute2x128_si256(u1, u5, 0x20);
+    r[2] = _mm256_permute2x128_si256(u2, u6, 0x20);
+    r[3] = _mm256_permute2x128_si256(u3, u7, 0x20);
+    r[4] = _mm256_permute2x128_si256(u0, u4, 0x31);
+    r[5] = _mm256_permute2x128_si256(u1, u5, 0x31);
+    r[6] = _mm256_permute2x128_si256(u2, u6, 0x31);
+    r[7] = _mm256_permute2x128_si256(u3, u7, 0x31);
+}
 
-	movq_m2r(*(dataptr+1), mm0);			// m03:m02|m01:m00 - first line, 4x4
-	punpckhdq_r2r(mm2, mm1);				// m33:m23|m13:m03 - interleave to produce result 4
+/* Pack the 32-bit values of a and b (each 16-bit clean) to 16 bits, a
+ * first. */
+static inline AVX2 __m256i RTjpeg_pack16_avx2(__m256i a, __m256i b)
+{
+    return _mm256_permute4x64_epi64(_mm256_packs_epi32(a, b), 0xD8);
+}
 
-	movq_r2m(mm5,*(dataptr+13));			// write result 3
+static AVX2 void RTjpeg_dctY_avx2(uint8_t *idata, int16_t *odata, int rskip)
+{
+    __m256i r[8];
+    v8si_t in[8], ws[8], out[8];
+
+#define LOAD(i) \
+    r[i] = _mm256_cvtepu8_epi32(                                        \
+        _mm_loadl_epi64((const __m128i *)(idata + (i)*(rskip<<3))));
+    RTJPEG_REPEAT8(LOAD)
+#undef LOAD
+    RTjpeg_transpose8_avx2(r);
+#define COPY(i)  in[i] = (v8si_t)r[i];
+    RTJPEG_REPEAT8(COPY)
+    RDCT_1D(v8si_t, in, ws, MUL16_AVX2);
+#define UNCOPY(i)  r[i] = (__m256i)ws[i];
+    RTJPEG_REPEAT8(UNCOPY)
+    RTjpeg_transpose8_avx2(r);
+    RTJPEG_REPEAT8(COPY)
+    RDCT_1D(v8si_t, in, out, VMUL);
+#define STORE(i) \
+    _mm256_storeu_si256((__m256i *)(odata + (i)*16), RTjpeg_pack16_avx2( \
+        TRUNC16_AVX2((out[2*(i)] + 32768) >> 16),                       \
+        TRUNC16_AVX2((out[2*(i)+1] + 32768) >> 16)));
+    STORE(0) STORE(1) STORE(2) STORE(3)
+#undef STORE
+}
 
-	// last 4x4 done
+static AVX2 void RTjpeg_idct_avx2(uint8_t *odata, int16_t *data, int rskip)
+{
+    const __m256i lo = _mm256_set1_epi32(16), hi = _mm256_set1_epi32(235);
+    const __m256i order = _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7);
+    __m256i r[8];
+    v8si_t in[8], ws[8], out[8];
+
+#define LOAD(i) \
+    in[i] = (v8si_t)_mm256_cvtepi16_epi32(                              \
+        _mm_loadu_si128((const __m128i *)(data + (i)*8)));
+    RTJPEG_REPEAT8(LOAD)
+#undef LOAD
+    RIDCT_1D(v8si_t, in, ws, VMUL);
+    RTJPEG_REPEAT8(UNCOPY)
+    RTjpeg_transpose8_avx2(r);
+    RTJPEG_REPEAT8(COPY)
+    RIDCT_1D(v8si_t, in, out, VMUL);
+#define CLAMP(i) \
+    r[i] = _mm256_min_epi32(_mm256_max_epi32(                           \
+        TRUNC16_AVX2((out[i] + 4) >> 3), lo), hi);
+    RTJPEG_REPEAT8(CLAMP)
+#undef CLAMP
+    RTjpeg_transpose8_avx2(r);
+    /* Four rows per register; the pack instructions work within 128-bit
+     * lanes, leaving the low and high halves of each row in different
+     * lanes, which the permute puts back together. */
+#define STORE(i) {                                                      \
+    __m256i pix = _mm256_permutevar8x32_epi32(_mm256_packus_epi16(      \
+        _mm256_packs_epi32(r[4*(i)], r[4*(i)+1]),                       \
+        _mm256_packs_epi32(r[4*(i)+2], r[4*(i)+3])), order);            \
+    __m128i pix01 = _mm256_castsi256_si128(pix);                        \
+    __m128i pix23 = _mm256_extracti128_si256(pix, 1);                   \
+    _mm_storel_epi64((__m128i *)(odata + 4*(i)*rskip), pix01);          \
+    _mm_storel_epi64((__m128i *)(odata + (4*(i)+1)*rskip),              \
+                     _mm_srli_si128(pix01, 8));                         \
+    _mm_storel_epi64((__m128i *)(odata + (4*(i)+2)*rskip), pix23);      \
+    _mm_storel_epi64((__m128i *)(odata + (4*(i)+3)*rskip),              \
+                     _mm_srli_si128(pix23, 8));                         \
+}
+    STORE(0) STORE(1)
+#undef STORE
+#undef COPY
+#undef UNCOPY
+}
 
-	movq_r2m(mm1, *(dataptr+15));			// write result 4, last 4x4
+static AVX2 void RTjpeg_quant_avx2(int16_t *block, int32_t *qtbl)
+{
+    int i;
+
+    for (i = 0; i < 64; i += 16) {
+        v8si_t a = (v8si_t)_mm256_cvtepi16_epi32(
+            _mm_loadu_si128((const __m128i *)(block + i)));
+        v8si_t b = (v8si_t)_mm256_cvtepi16_epi32(
+            _mm_loadu_si128((const __m128i *)(block + i+8)));
+        a = (a * (v8si_t)_mm256_loadu_si256((const __m256i *)(qtbl + i))
+             + 32767) >> 16;
+        b = (b * (v8si_t)_mm256_loadu_si256((const __m256i *)(qtbl + i+8))
+             + 32767) >> 16;
+        _mm256_storeu_si256((__m256i *)(block + i),
+                            RTjpeg_pack16_avx2(TRUNC16_AVX2(a),
+                                               TRUNC16_AVX2(b)));
+    }
+}
 
-	movq_m2r(*(dataptr+5), mm2);			// m23:m22|m21:m20 - third line
-	movq_r2r(mm0, mm6);
+#endif  /* RTJPEG_AVX2 */
 
-	punpcklwd_m2r(*(dataptr+3), mm0);  	// m11:m01|m10:m00 - interleave first and second lines
-	movq_r2r(mm2, mm7);
+/*************************************************************************/
 
-	punpcklwd_m2r(*(dataptr+7), mm2);  	// m31:m21|m30:m20 - interleave third and fourth lines
-	movq_r2r(mm0, mm4);
+/**
+ * RTjpeg_new:  Create a new codec context.  The kernels used are chosen
+ * here from `accel' (a set of AC_* flags), restricted to those the CPU
+ * supports.
+ *
+ * Parameters: accel: Acceleration flags (AC_NONE for plain C).
+ * Return value: New context, or NULL if out of memory.
+ */
 
-	//
-	movq_m2r(*(dataptr+8), mm1);			// n03:n02|n01:n00 - first line
-	punpckldq_r2r(mm2, mm0);				// m30:m20|m10:m00 - interleave to produce first result
+RTjpegContext *RTjpeg_new(int accel)
+{
+    RTjpegContext *ctx;
+
+    ctx = calloc(1, sizeof(*ctx));
+    if (!ctx)
+        return NULL;
+
+    ctx->dctY  = RTjpeg_dctY;
+    ctx->idct  = RTjpeg_idct;
+    ctx->quant = RTjpeg_quant;
+    accel &= ac_cpuinfo();
+#ifdef RTJPEG_SSE2
+    if (accel & AC_SSE2) {
+        ctx->dctY  = RTjpeg_dctY_sse2;
+        ctx->idct  = RTjpeg_idct_sse2;
+        ctx->quant = RTjpeg_quant_sse2;
+    }
+#endif
+#ifdef RTJPEG_AVX2
+    if (accel & AC_AVX2) {
+        ctx->dctY  = RTjpeg_dctY_avx2;
+        ctx->idct  = RTjpeg_idct_avx2;
+        ctx->quant = RTjpeg_quant_avx2;
+    }
+#endif
 
-	movq_m2r(*(dataptr+12), mm3);			// n23:n22|n21:n20 - third line
-	punpckhdq_r2r(mm2, mm4);				// m31:m21|m11:m01 - interleave to produce second result
+    return ctx;
+}
 
-	punpckhwd_m2r(*(dataptr+3), mm6);  	// m13:m03|m12:m02 - interleave first and second lines
-	movq_r2r(mm1, mm2);               	// copy first line
+/**
+ * RTjpeg_free:  Free a codec context.  Does nothing if ctx is NULL.
+ *
+ * Parameters: ctx: Context to free.
+ * Return value: None.
+ */
 
-	punpckhwd_m2r(*(dataptr+7), mm7);  	// m33:m23|m32:m22 - interleave third and fourth lines
-	movq_r2r(mm6, mm5);						// copy first intermediate result
+void RTjpeg_free(RTjpegContext *ctx)
+{
+    if (!ctx)
+        return;
+    tc_workers_del(ctx->workers);
+    free(ctx->slices);
+    free(ctx->old);
+    free(ctx->rowpos);
+    free(ctx);
+}
 
-	movq_r2m(mm0, *(dataptr+8));			// write result 1
-	punpckhdq_r2r(mm7, mm5);				// m33:m23|m13:m03 - produce third result
+/**
+ * RTjpeg_set_threads:  Set the number of threads used to decode a frame.
+ * The frame is split into bands of macroblock rows, decoded in parallel
+ * on a worker pool (see libtc/tcworkers.h) and the calling thread.
+ *
+ * Parameters:     ctx: Codec context.
+ *             threads: Number of threads (1 or more).
+ * Return value: Nonzero on success, zero on error (the context is then
+ *               left with the threads it could start).
+ */
 
-	punpcklwd_m2r(*(dataptr+10), mm1);  // n11:n01|n10:n00 - interleave first and second lines
-	movq_r2r(mm3, mm0);						// copy third line
+int RTjpeg_set_threads(RTjpegContext *ctx, int threads)
+{
+    if (threads < 1)
+        return 0;
+    if (threads > RTJPEG_MAX_THREADS)
+        threads = RTJPEG_MAX_THREADS;
+    if (threads == tc_workers_threads(ctx->workers))
+        return 1;
+
+    tc_workers_del(ctx->workers);
+    free(ctx->slices);
+    ctx->workers = NULL;
+    ctx->slices = NULL;
+    if (threads == 1)
+        return 1;
+
+    ctx->slices = calloc(threads, sizeof(*ctx->slices));
+    if (!ctx->slices)
+        return 0;
+    ctx->workers = tc_workers_new(threads);
+    return tc_workers_threads(ctx->workers) == threads;
+}
 
-	punpckhwd_m2r(*(dataptr+10), mm2);  // n13:n03|n12:n02 - interleave first and second lines
+/*************************************************************************/
 
-	movq_r2m(mm4, *(dataptr+10));			// write result 2 out
-	punpckldq_r2r(mm7, mm6);				// m32:m22|m12:m02 - produce fourth result
+/**
+ * RTjpeg_decode_slice:  Decode band `slice' of the current job.
+ *
+ * Parameters:     arg: Codec context.
+ *               slice: Band number, 0 to nslices-1.
+ *             nslices: Number of bands (ctx->job_count).
+ * Return value: None.
+ */
 
-	punpcklwd_m2r(*(dataptr+14), mm3);  // n31:n21|n30:n20 - interleave third and fourth lines
-	movq_r2r(mm1, mm4);
-
-	movq_r2m(mm6, *(dataptr+12));			// write result 3 out
-	punpckldq_r2r(mm3, mm1);				// n30:n20|n10:n00 - produce first result
-
-	punpckhwd_m2r(*(dataptr+14), mm0);  // n33:n23|n32:n22 - interleave third and fourth lines
-	movq_r2r(mm2, mm6);
-
-	movq_r2m(mm5, *(dataptr+14));			// write result 4 out
-	punpckhdq_r2r(mm3, mm4);				// n31:n21|n11:n01- produce second result
-
-	movq_r2m(mm1, *(dataptr+1));			// write result 5 out - (first result for other 4 x 4 block)
-	punpckldq_r2r(mm0, mm2);				// n32:n22|n12:n02- produce third result
-
-	movq_r2m(mm4, *(dataptr+3));			// write result 6 out
-	punpckhdq_r2r(mm0, mm6);				// n33:n23|n13:n03 - produce fourth result
-
-	movq_r2m(mm2, *(dataptr+5));			// write result 7 out
-
-	movq_m2r(*dataptr, mm0);				// m03:m02|m01:m00 - first line, first 4x4
-
-	movq_r2m(mm6, *(dataptr+7));			// write result 8 out
-
-
-// Do first 4x4 quadrant, which is used in the beginning of the DCT:
-
-	movq_m2r(*(dataptr+4), mm7);			// m23:m22|m21:m20 - third line
-	movq_r2r(mm0, mm2);
-
-	punpcklwd_m2r(*(dataptr+2), mm0);  	// m11:m01|m10:m00 - interleave first and second lines
-	movq_r2r(mm7, mm4);
-
-	punpcklwd_m2r(*(dataptr+6), mm7);  	// m31:m21|m30:m20 - interleave third and fourth lines
-	movq_r2r(mm0, mm1);
-
-	movq_m2r(*(dataptr+2), mm6);			// m13:m12|m11:m10 - second line
-	punpckldq_r2r(mm7, mm0);				// m30:m20|m10:m00 - interleave to produce result 1
-
-	movq_m2r(*(dataptr+6), mm5);			// m33:m32|m31:m30 - fourth line
-	punpckhdq_r2r(mm7, mm1);				// m31:m21|m11:m01 - interleave to produce result 2
-
-	movq_r2r(mm0, mm7);						// write result 1
-	punpckhwd_r2r(mm6, mm2);				// m13:m03|m12:m02 - interleave first and second lines
-
-	psubw_m2r(*(dataptr+14), mm7);		// tmp07=x0-x7	/* Stage 1 */
-	movq_r2r(mm1, mm6);						// write result 2
-
-	paddw_m2r(*(dataptr+14), mm0);		// tmp00=x0+x7	/* Stage 1 */
-	punpckhwd_r2r(mm5, mm4);   			// m33:m23|m32:m22 - interleave third and fourth lines
-
-	paddw_m2r(*(dataptr+12), mm1);		// tmp01=x1+x6	/* Stage 1 */
-	movq_r2r(mm2, mm3);						// copy first intermediate result
-
-	psubw_m2r(*(dataptr+12), mm6);		// tmp06=x1-x6	/* Stage 1 */
-	punpckldq_r2r(mm4, mm2);				// m32:m22|m12:m02 - interleave to produce result 3
-
-   movq_r2m(mm7, tmp7);
-	movq_r2r(mm2, mm5);						// write result 3
-
-   movq_r2m(mm6, tmp6);
-	punpckhdq_r2r(mm4, mm3);				// m33:m23|m13:m03 - interleave to produce result 4
-
-	paddw_m2r(*(dataptr+10), mm2);     	// tmp02=x2+5 /* Stage 1 */
-	movq_r2r(mm3, mm4);						// write result 4
-
-/************************************************************************************************
-					End of Transpose
-************************************************************************************************/
-
-
-   paddw_m2r(*(dataptr+8), mm3);    	// tmp03=x3+x4 /* stage 1*/
-   movq_r2r(mm0, mm7);
-
-   psubw_m2r(*(dataptr+8), mm4);    	// tmp04=x3-x4 /* stage 1*/
-   movq_r2r(mm1, mm6);
-
-	paddw_r2r(mm3, mm0);  					// tmp10 = tmp00 + tmp03 /* even 2 */
-	psubw_r2r(mm3, mm7);  					// tmp13 = tmp00 - tmp03 /* even 2 */
-
-	psubw_r2r(mm2, mm6);  					// tmp12 = tmp01 - tmp02 /* even 2 */
-	paddw_r2r(mm2, mm1);  					// tmp11 = tmp01 + tmp02 /* even 2 */
-
-   psubw_m2r(*(dataptr+10), mm5);    	// tmp05=x2-x5 /* stage 1*/
-	paddw_r2r(mm7, mm6);						// tmp12 + tmp13
-
-	/* stage 3 */
-
-   movq_m2r(tmp6, mm2);
-   movq_r2r(mm0, mm3);
-
-	psllw_i2r(2, mm6);			// m8 * 2^2
-	paddw_r2r(mm1, mm0);
-
-	pmulhw_m2r(RTjpeg_C4, mm6);			// z1
-	psubw_r2r(mm1, mm3);
-
-   movq_r2m(mm0, *dataptr);
-   movq_r2r(mm7, mm0);
-
-    /* Odd part */
-   movq_r2m(mm3, *(dataptr+8));
-	paddw_r2r(mm5, mm4);						// tmp10
-
-   movq_m2r(tmp7, mm3);
-	paddw_r2r(mm6, mm0);						// tmp32
-
-	paddw_r2r(mm2, mm5);						// tmp11
-	psubw_r2r(mm6, mm7);						// tmp33
-
-   movq_r2m(mm0, *(dataptr+4));
-	paddw_r2r(mm3, mm2);						// tmp12
-
-	/* stage 4 */
-
-   movq_r2m(mm7, *(dataptr+12));
-	movq_r2r(mm4, mm1);						// copy of tmp10
-
-	psubw_r2r(mm2, mm1);						// tmp10 - tmp12
-	psllw_i2r(2, mm4);			// m8 * 2^2
-
-	movq_m2r(RTjpeg_C2mC6, mm0);
-	psllw_i2r(2, mm1);
-
-	pmulhw_m2r(RTjpeg_C6, mm1);			// z5
-	psllw_i2r(2, mm2);
-
-	pmulhw_r2r(mm0, mm4);					// z5
-
-	/* stage 5 */
-
-	pmulhw_m2r(RTjpeg_C2pC6, mm2);
-	psllw_i2r(2, mm5);
-
-	pmulhw_m2r(RTjpeg_C4, mm5);			// z3
-	movq_r2r(mm3, mm0);						// copy tmp7
-
-   movq_m2r(*(dataptr+1), mm7);
-	paddw_r2r(mm1, mm4);						// z2
-
-	paddw_r2r(mm1, mm2);						// z4
-
-	paddw_r2r(mm5, mm0);						// z11
-	psubw_r2r(mm5, mm3);						// z13
-
-	/* stage 6 */
-
-	movq_r2r(mm3, mm5);						// copy z13
-	psubw_r2r(mm4, mm3);						// y3=z13 - z2
-
-	paddw_r2r(mm4, mm5);						// y5=z13 + z2
-	movq_r2r(mm0, mm6);						// copy z11
-
-   movq_r2m(mm3, *(dataptr+6)); 			//save y3
-	psubw_r2r(mm2, mm0);						// y7=z11 - z4
-
-   movq_r2m(mm5, *(dataptr+10)); 		//save y5
-	paddw_r2r(mm2, mm6);						// y1=z11 + z4
-
-   movq_r2m(mm0, *(dataptr+14)); 		//save y7
-
-	/************************************************
-	 *  End of 1st 4 rows
-	 ************************************************/
-
-   movq_m2r(*(dataptr+3), mm1); 			// load x1   /* stage 1 */
-	movq_r2r(mm7, mm0);						// copy x0
-
-   movq_r2m(mm6, *(dataptr+2)); 			//save y1
-
-   movq_m2r(*(dataptr+5), mm2); 			// load x2   /* stage 1 */
-	movq_r2r(mm1, mm6);						// copy x1
-
-   paddw_m2r(*(dataptr+15), mm0);  		// tmp00 = x0 + x7
-
-   movq_m2r(*(dataptr+7), mm3); 			// load x3   /* stage 1 */
-	movq_r2r(mm2, mm5);						// copy x2
-
-   psubw_m2r(*(dataptr+15), mm7);  		// tmp07 = x0 - x7
-	movq_r2r(mm3, mm4);						// copy x3
-
-   paddw_m2r(*(dataptr+13), mm1);  		// tmp01 = x1 + x6
-
-	movq_r2m(mm7, tmp7);						// save tmp07
-	movq_r2r(mm0, mm7);						// copy tmp00
-
-   psubw_m2r(*(dataptr+13), mm6);  		// tmp06 = x1 - x6
-
-   /* stage 2, Even Part */
-
-   paddw_m2r(*(dataptr+9), mm3);  		// tmp03 = x3 + x4
-
-	movq_r2m(mm6, tmp6);						// save tmp07
-	movq_r2r(mm1, mm6);						// copy tmp01
-
-   paddw_m2r(*(dataptr+11), mm2);  		// tmp02 = x2 + x5
-	paddw_r2r(mm3, mm0);              	// tmp10 = tmp00 + tmp03
-
-	psubw_r2r(mm3, mm7);              	// tmp13 = tmp00 - tmp03
-
-   psubw_m2r(*(dataptr+9), mm4);  		// tmp04 = x3 - x4
-	psubw_r2r(mm2, mm6);              	// tmp12 = tmp01 - tmp02
-
-	paddw_r2r(mm2, mm1);              	// tmp11 = tmp01 + tmp02
-
-   psubw_m2r(*(dataptr+11), mm5);  		// tmp05 = x2 - x5
-	paddw_r2r(mm7, mm6);              	//  tmp12 + tmp13
-
-   /* stage 3, Even and stage 4 & 5 even */
-
-	movq_m2r(tmp6, mm2);            		// load tmp6
-	movq_r2r(mm0, mm3);						// copy tmp10
-
-	psllw_i2r(2, mm6);			// shift z1
-	paddw_r2r(mm1, mm0);    				// y0=tmp10 + tmp11
-
-	pmulhw_m2r(RTjpeg_C4, mm6);    		// z1
-	psubw_r2r(mm1, mm3);    				// y4=tmp10 - tmp11
-
-   movq_r2m(mm0, *(dataptr+1)); 			//save y0
-	movq_r2r(mm7, mm0);						// copy tmp13
-
-	/* odd part */
-
-   movq_r2m(mm3, *(dataptr+9)); 			//save y4
-	paddw_r2r(mm5, mm4);              	// tmp10 = tmp4 + tmp5
-
-	movq_m2r(tmp7, mm3);            		// load tmp7
-	paddw_r2r(mm6, mm0);              	// tmp32 = tmp13 + z1
-
-	paddw_r2r(mm2, mm5);              	// tmp11 = tmp5 + tmp6
-	psubw_r2r(mm6, mm7);              	// tmp33 = tmp13 - z1
-
-   movq_r2m(mm0, *(dataptr+5)); 			//save y2
-	paddw_r2r(mm3, mm2);              	// tmp12 = tmp6 + tmp7
-
-	/* stage 4 */
-
-   movq_r2m(mm7, *(dataptr+13)); 		//save y6
-	movq_r2r(mm4, mm1);						// copy tmp10
-
-	psubw_r2r(mm2, mm1);    				// tmp10 - tmp12
-	psllw_i2r(2, mm4);			// shift tmp10
-
-	movq_m2r(RTjpeg_C2mC6, mm0);			// load C2mC6
-	psllw_i2r(2, mm1);			// shift (tmp10-tmp12)
-
-	pmulhw_m2r(RTjpeg_C6, mm1);    		// z5
-	psllw_i2r(2, mm5);			// prepare for multiply
-
-	pmulhw_r2r(mm0, mm4);					// multiply by converted real
-
-	/* stage 5 */
-
-	pmulhw_m2r(RTjpeg_C4, mm5);			// z3
-	psllw_i2r(2, mm2);			// prepare for multiply
-
-	pmulhw_m2r(RTjpeg_C2pC6, mm2);		// multiply
-	movq_r2r(mm3, mm0);						// copy tmp7
-
-	movq_m2r(*(dataptr+9), mm7);		 	// m03:m02|m01:m00 - first line (line 4)and copy into mm7
-	paddw_r2r(mm1, mm4);						// z2
-
-	paddw_r2r(mm5, mm0);						// z11
-	psubw_r2r(mm5, mm3);						// z13
-
-	/* stage 6 */
-
-	movq_r2r(mm3, mm5);						// copy z13
-	paddw_r2r(mm1, mm2);						// z4
-
-	movq_r2r(mm0, mm6);						// copy z11
-	psubw_r2r(mm4, mm5);						// y3
-
-	paddw_r2r(mm2, mm6);						// y1
-	paddw_r2r(mm4, mm3);						// y5
-
-   movq_r2m(mm5, *(dataptr+7)); 			//save y3
-
-   movq_r2m(mm6, *(dataptr+3)); 			//save y1
-	psubw_r2r(mm2, mm0);						// y7
-
-/************************************************************************************************
-					Start of Transpose
-************************************************************************************************/
-
- 	movq_m2r(*(dataptr+13), mm6);		 	// m23:m22|m21:m20 - third line (line 6)and copy into m2
-	movq_r2r(mm7, mm5);						// copy first line
-
-	punpcklwd_r2r(mm3, mm7); 				// m11:m01|m10:m00 - interleave first and second lines
-	movq_r2r(mm6, mm2);						// copy third line
-
-	punpcklwd_r2r(mm0, mm6);  				// m31:m21|m30:m20 - interleave third and fourth lines
-	movq_r2r(mm7, mm1);						// copy first intermediate result
-
-	punpckldq_r2r(mm6, mm7);				// m30:m20|m10:m00 - interleave to produce result 1
-
-	punpckhdq_r2r(mm6, mm1);				// m31:m21|m11:m01 - interleave to produce result 2
-
-	movq_r2m(mm7, *(dataptr+9));			// write result 1
-	punpckhwd_r2r(mm3, mm5);				// m13:m03|m12:m02 - interleave first and second lines
-
-	movq_r2m(mm1, *(dataptr+11));			// write result 2
-	punpckhwd_r2r(mm0, mm2);				// m33:m23|m32:m22 - interleave third and fourth lines
-
-	movq_r2r(mm5, mm1);						// copy first intermediate result
-	punpckldq_r2r(mm2, mm5);				// m32:m22|m12:m02 - interleave to produce result 3
-
-	movq_m2r(*(dataptr+1), mm0);			// m03:m02|m01:m00 - first line, 4x4
-	punpckhdq_r2r(mm2, mm1);				// m33:m23|m13:m03 - interleave to produce result 4
-
-	movq_r2m(mm5, *(dataptr+13));			// write result 3
-
-	/****** last 4x4 done */
-
-	movq_r2m(mm1, *(dataptr+15));			// write result 4, last 4x4
-
-	movq_m2r(*(dataptr+5), mm2);			// m23:m22|m21:m20 - third line
-	movq_r2r(mm0, mm6);						// copy first line
-
-	punpcklwd_m2r(*(dataptr+3), mm0);  	// m11:m01|m10:m00 - interleave first and second lines
-	movq_r2r(mm2, mm7);						// copy third line
-
-	punpcklwd_m2r(*(dataptr+7), mm2);  	// m31:m21|m30:m20 - interleave third and fourth lines
-	movq_r2r(mm0, mm4);						// copy first intermediate result
-
-
-
-	movq_m2r(*(dataptr+8), mm1);			// n03:n02|n01:n00 - first line
-	punpckldq_r2r(mm2, mm0);				// m30:m20|m10:m00 - interleave to produce first result
-
-	movq_m2r(*(dataptr+12), mm3);			// n23:n22|n21:n20 - third line
-	punpckhdq_r2r(mm2, mm4);				// m31:m21|m11:m01 - interleave to produce second result
-
-	punpckhwd_m2r(*(dataptr+3), mm6);  	// m13:m03|m12:m02 - interleave first and second lines
-	movq_r2r(mm1, mm2);						// copy first line
-
-	punpckhwd_m2r(*(dataptr+7), mm7);  	// m33:m23|m32:m22 - interleave third and fourth lines
-	movq_r2r(mm6, mm5);						// copy first intermediate result
-
-	movq_r2m(mm0, *(dataptr+8));			// write result 1
-	punpckhdq_r2r(mm7, mm5);				// m33:m23|m13:m03 - produce third result
-
-	punpcklwd_m2r(*(dataptr+10), mm1);  // n11:n01|n10:n00 - interleave first and second lines
-	movq_r2r(mm3, mm0);						// copy third line
-
-	punpckhwd_m2r(*(dataptr+10), mm2);  // n13:n03|n12:n02 - interleave first and second lines
-
-	movq_r2m(mm4, *(dataptr+10));			// write result 2 out
-	punpckldq_r2r(mm7, mm6);				// m32:m22|m12:m02 - produce fourth result
-
-	punpcklwd_m2r(*(dataptr+14), mm3);  // n33:n23|n32:n22 - interleave third and fourth lines
-	movq_r2r(mm1, mm4);						// copy second intermediate result
-
-	movq_r2m(mm6, *(dataptr+12));			// write result 3 out
-	punpckldq_r2r(mm3, mm1);				//
-
-	punpckhwd_m2r(*(dataptr+14), mm0);  // n33:n23|n32:n22 - interleave third and fourth lines
-	movq_r2r(mm2, mm6);						// copy second intermediate result
-
-	movq_r2m(mm5, *(dataptr+14));			// write result 4 out
-	punpckhdq_r2r(mm3, mm4);				// n31:n21|n11:n01- produce second result
-
-	movq_r2m(mm1, *(dataptr+1));			// write result 5 out - (first result for other 4 x 4 block)
-	punpckldq_r2r(mm0, mm2);				// n32:n22|n12:n02- produce third result
-
-	movq_r2m(mm4, *(dataptr+3));			// write result 6 out
-	punpckhdq_r2r(mm0, mm6);				// n33:n23|n13:n03 - produce fourth result
-
-	movq_r2m(mm2, *(dataptr+5));			// write result 7 out
-
-	movq_m2r(*dataptr, mm0);				// m03:m02|m01:m00 - first line, first 4x4
-
-	movq_r2m(mm6, *(dataptr+7));			// write result 8 out
-
-// Do first 4x4 quadrant, which is used in the beginning of the DCT:
-
-	movq_m2r(*(dataptr+4), mm7);			// m23:m22|m21:m20 - third line
-	movq_r2r(mm0, mm2);						// copy first line
-
-	punpcklwd_m2r(*(dataptr+2), mm0);  	// m11:m01|m10:m00 - interleave first and second lines
-	movq_r2r(mm7, mm4);						// copy third line
-
-	punpcklwd_m2r(*(dataptr+6), mm7);  	// m31:m21|m30:m20 - interleave third and fourth lines
-	movq_r2r(mm0, mm1);						// copy first intermediate result
-
-	movq_m2r(*(dataptr+2), mm6);			// m13:m12|m11:m10 - second line
-	punpckldq_r2r(mm7, mm0);				// m30:m20|m10:m00 - interleave to produce result 1
-
-	movq_m2r(*(dataptr+6), mm5);			// m33:m32|m31:m30 - fourth line
-	punpckhdq_r2r(mm7, mm1);				// m31:m21|m11:m01 - interleave to produce result 2
-
-	movq_r2r(mm0, mm7);						// write result 1
-	punpckhwd_r2r(mm6, mm2);				// m13:m03|m12:m02 - interleave first and second lines
-
-	psubw_m2r(*(dataptr+14), mm7);		// tmp07=x0-x7	/* Stage 1 */
-	movq_r2r(mm1, mm6);						// write result 2
-
-	paddw_m2r(*(dataptr+14), mm0);		// tmp00=x0+x7	/* Stage 1 */
-	punpckhwd_r2r(mm5, mm4);   			// m33:m23|m32:m22 - interleave third and fourth lines
-
-	paddw_m2r(*(dataptr+12), mm1);		// tmp01=x1+x6	/* Stage 1 */
-	movq_r2r(mm2, mm3);						// copy first intermediate result
-
-	psubw_m2r(*(dataptr+12), mm6);		// tmp06=x1-x6	/* Stage 1 */
-	punpckldq_r2r(mm4, mm2);				// m32:m22|m12:m02 - interleave to produce result 3
-
-	movq_r2m(mm7, tmp7);						// save tmp07
-	movq_r2r(mm2, mm5);						// write result 3
-
-	movq_r2m(mm6, tmp6);						// save tmp06
-
-	punpckhdq_r2r(mm4, mm3);				// m33:m23|m13:m03 - interleave to produce result 4
-
-	paddw_m2r(*(dataptr+10), mm2);   	// tmp02=x2+x5 /* stage 1 */
-	movq_r2r(mm3, mm4);						// write result 4
-
-/************************************************************************************************
-					End of Transpose 2
-************************************************************************************************/
-
-   paddw_m2r(*(dataptr+8), mm3);    	// tmp03=x3+x4 /* stage 1*/
-   movq_r2r(mm0, mm7);
-
-   psubw_m2r(*(dataptr+8), mm4);    	// tmp04=x3-x4 /* stage 1*/
-   movq_r2r(mm1, mm6);
-
-	paddw_r2r(mm3, mm0);  					// tmp10 = tmp00 + tmp03 /* even 2 */
-	psubw_r2r(mm3, mm7);  					// tmp13 = tmp00 - tmp03 /* even 2 */
-
-	psubw_r2r(mm2, mm6);  					// tmp12 = tmp01 - tmp02 /* even 2 */
-	paddw_r2r(mm2, mm1);  					// tmp11 = tmp01 + tmp02 /* even 2 */
-
-   psubw_m2r(*(dataptr+10), mm5);    	// tmp05=x2-x5 /* stage 1*/
-	paddw_r2r(mm7, mm6);						// tmp12 + tmp13
-
-	/* stage 3 */
-
-   movq_m2r(tmp6, mm2);
-   movq_r2r(mm0, mm3);
-
-	psllw_i2r(2, mm6);			// m8 * 2^2
-	paddw_r2r(mm1, mm0);
-
-	pmulhw_m2r(RTjpeg_C4, mm6);			// z1
-	psubw_r2r(mm1, mm3);
-
-   movq_r2m(mm0, *dataptr);
-   movq_r2r(mm7, mm0);
-
-    /* Odd part */
-   movq_r2m(mm3, *(dataptr+8));
-	paddw_r2r(mm5, mm4);						// tmp10
-
-   movq_m2r(tmp7, mm3);
-	paddw_r2r(mm6, mm0);						// tmp32
-
-	paddw_r2r(mm2, mm5);						// tmp11
-	psubw_r2r(mm6, mm7);						// tmp33
-
-   movq_r2m(mm0, *(dataptr+4));
-	paddw_r2r(mm3, mm2);						// tmp12
-
-	/* stage 4 */
-   movq_r2m(mm7, *(dataptr+12));
-	movq_r2r(mm4, mm1);						// copy of tmp10
-
-	psubw_r2r(mm2, mm1);						// tmp10 - tmp12
-	psllw_i2r(2, mm4);			// m8 * 2^2
-
-	movq_m2r(RTjpeg_C2mC6, mm0);
-	psllw_i2r(2, mm1);
-
-	pmulhw_m2r(RTjpeg_C6, mm1);			// z5
-	psllw_i2r(2, mm2);
-
-	pmulhw_r2r(mm0, mm4);					// z5
-
-	/* stage 5 */
-
-	pmulhw_m2r(RTjpeg_C2pC6, mm2);
-	psllw_i2r(2, mm5);
-
-	pmulhw_m2r(RTjpeg_C4, mm5);			// z3
-	movq_r2r(mm3, mm0);						// copy tmp7
-
-   movq_m2r(*(dataptr+1), mm7);
-	paddw_r2r(mm1, mm4);						// z2
-
-	paddw_r2r(mm1, mm2);						// z4
-
-	paddw_r2r(mm5, mm0);						// z11
-	psubw_r2r(mm5, mm3);						// z13
-
-	/* stage 6 */
-
-	movq_r2r(mm3, mm5);						// copy z13
-	psubw_r2r(mm4, mm3);						// y3=z13 - z2
-
-	paddw_r2r(mm4, mm5);						// y5=z13 + z2
-	movq_r2r(mm0, mm6);						// copy z11
-
-   movq_r2m(mm3, *(dataptr+6)); 			//save y3
-	psubw_r2r(mm2, mm0);						// y7=z11 - z4
-
-   movq_r2m(mm5, *(dataptr+10)); 		//save y5
-	paddw_r2r(mm2, mm6);						// y1=z11 + z4
-
-   movq_r2m(mm0, *(dataptr+14)); 		//save y7
-
-	/************************************************
-	 *  End of 1st 4 rows
-	 ************************************************/
-
-   movq_m2r(*(dataptr+3), mm1); 			// load x1   /* stage 1 */
-	movq_r2r(mm7, mm0);						// copy x0
-
-   movq_r2m(mm6, *(dataptr+2)); 			//save y1
-
-   movq_m2r(*(dataptr+5), mm2); 			// load x2   /* stage 1 */
-	movq_r2r(mm1, mm6);						// copy x1
-
-   paddw_m2r(*(dataptr+15), mm0);  		// tmp00 = x0 + x7
-
-   movq_m2r(*(dataptr+7), mm3); 			// load x3   /* stage 1 */
-	movq_r2r(mm2, mm5);						// copy x2
-
-   psubw_m2r(*(dataptr+15), mm7);  		// tmp07 = x0 - x7
-	movq_r2r(mm3, mm4);						// copy x3
-
-   paddw_m2r(*(dataptr+13), mm1);  		// tmp01 = x1 + x6
-
-	movq_r2m(mm7, tmp7);						// save tmp07
-	movq_r2r(mm0, mm7);						// copy tmp00
-
-   psubw_m2r(*(dataptr+13), mm6);  		// tmp06 = x1 - x6
-
-   /* stage 2, Even Part */
-
-   paddw_m2r(*(dataptr+9), mm3);  		// tmp03 = x3 + x4
-
-	movq_r2m(mm6, tmp6);						// save tmp07
-	movq_r2r(mm1, mm6);						// copy tmp01
-
-   paddw_m2r(*(dataptr+11), mm2);  		// tmp02 = x2 + x5
-	paddw_r2r(mm3, mm0);              	// tmp10 = tmp00 + tmp03
-
-	psubw_r2r(mm3, mm7);              	// tmp13 = tmp00 - tmp03
-
-   psubw_m2r(*(dataptr+9), mm4);  		// tmp04 = x3 - x4
-	psubw_r2r(mm2, mm6);              	// tmp12 = tmp01 - tmp02
-
-	paddw_r2r(mm2, mm1);              	// tmp11 = tmp01 + tmp02
-
-   psubw_m2r(*(dataptr+11), mm5);  		// tmp05 = x2 - x5
-	paddw_r2r(mm7, mm6);              	//  tmp12 + tmp13
-
-   /* stage 3, Even and stage 4 & 5 even */
-
-	movq_m2r(tmp6, mm2);            		// load tmp6
-	movq_r2r(mm0, mm3);						// copy tmp10
-
-	psllw_i2r(2, mm6);			// shift z1
-	paddw_r2r(mm1, mm0);    				// y0=tmp10 + tmp11
-
-	pmulhw_m2r(RTjpeg_C4, mm6);    		// z1
-	psubw_r2r(mm1, mm3);    				// y4=tmp10 - tmp11
-
-   movq_r2m(mm0, *(dataptr+1)); 			//save y0
-	movq_r2r(mm7, mm0);						// copy tmp13
-
-	/* odd part */
-
-   movq_r2m(mm3, *(dataptr+9)); 			//save y4
-	paddw_r2r(mm5, mm4);              	// tmp10 = tmp4 + tmp5
-
-	movq_m2r(tmp7, mm3);            		// load tmp7
-	paddw_r2r(mm6, mm0);              	// tmp32 = tmp13 + z1
-
-	paddw_r2r(mm2, mm5);              	// tmp11 = tmp5 + tmp6
-	psubw_r2r(mm6, mm7);              	// tmp33 = tmp13 - z1
-
-   movq_r2m(mm0, *(dataptr+5)); 			//save y2
-	paddw_r2r(mm3, mm2);              	// tmp12 = tmp6 + tmp7
-
-	/* stage 4 */
-
-   movq_r2m(mm7, *(dataptr+13)); 		//save y6
-	movq_r2r(mm4, mm1);						// copy tmp10
-
-	psubw_r2r(mm2, mm1);    				// tmp10 - tmp12
-	psllw_i2r(2, mm4);			// shift tmp10
-
-	movq_m2r(RTjpeg_C2mC6, mm0);			// load C2mC6
-	psllw_i2r(2, mm1);			// shift (tmp10-tmp12)
-
-	pmulhw_m2r(RTjpeg_C6, mm1);    		// z5
-	psllw_i2r(2, mm5);			// prepare for multiply
-
-	pmulhw_r2r(mm0, mm4);					// multiply by converted real
-
-	/* stage 5 */
-
-	pmulhw_m2r(RTjpeg_C4, mm5);			// z3
-	psllw_i2r(2, mm2);			// prepare for multiply
-
-	pmulhw_m2r(RTjpeg_C2pC6, mm2);		// multiply
-	movq_r2r(mm3, mm0);						// copy tmp7
-
-	movq_m2r(*(dataptr+9), mm7);		 	// m03:m02|m01:m00 - first line (line 4)and copy into mm7
-	paddw_r2r(mm1, mm4);						// z2
-
-	paddw_r2r(mm5, mm0);						// z11
-	psubw_r2r(mm5, mm3);						// z13
-
-	/* stage 6 */
-
-	movq_r2r(mm3, mm5);						// copy z13
-	paddw_r2r(mm1, mm2);						// z4
-
-	movq_r2r(mm0, mm6);						// copy z11
-	psubw_r2r(mm4, mm5);						// y3
-
-	paddw_r2r(mm2, mm6);						// y1
-	paddw_r2r(mm4, mm3);						// y5
-
-   movq_r2m(mm5, *(dataptr+7)); 			//save y3
-	psubw_r2r(mm2, mm0);						// y7=z11 - z4
-
-   movq_r2m(mm3, *(dataptr+11)); 		//save y5
-
-   movq_r2m(mm6, *(dataptr+3)); 			//save y1
-
-   movq_r2m(mm0, *(dataptr+15)); 		//save y7
-
-
-#endif
-}
-
-#define FIX_1_082392200  ((int32_t)  277)		/* FIX(1.082392200) */
-#define FIX_1_414213562  ((int32_t)  362)		/* FIX(1.414213562) */
-#define FIX_1_847759065  ((int32_t)  473)		/* FIX(1.847759065) */
-#define FIX_2_613125930  ((int32_t)  669)		/* FIX(2.613125930) */
-
-#define DESCALE(x) (int16_t)( ((x)+4) >> 3)
-
-/* clip yuv to 16..235 (should be 16..240 for cr/cb but ... */
-
-#define RL(x) ((x)>235) ? 235 : (((x)<16) ? 16 : (x))
-#define MULTIPLY(var,const)  (((int32_t) ((var) * (const)) + 128)>>8)
-
-static void RTjpeg_idct_init(void)
-{
- int i;
-
- for(i=0; i<64; i++)
- {
-  RTjpeg_liqt[i]=((uint64_t)RTjpeg_liqt[i]*RTjpeg_aan_tab[i])>>32;
-  RTjpeg_ciqt[i]=((uint64_t)RTjpeg_ciqt[i]*RTjpeg_aan_tab[i])>>32;
- }
-}
-
-static void RTjpeg_idct(uint8_t *odata, int16_t *data, int rskip)
-{
-#ifdef MMX
-
-static mmx_t fix_141			= (mmx_t)(long long)0x5a825a825a825a82LL;
-static mmx_t fix_184n261	= (mmx_t)(long long)0xcf04cf04cf04cf04LL;
-static mmx_t fix_184			= (mmx_t)(long long)0x7641764176417641LL;
-static mmx_t fix_n184		= (mmx_t)(long long)0x896f896f896f896fLL;
-static mmx_t fix_108n184	= (mmx_t)(long long)0xcf04cf04cf04cf04LL;
-
-  mmx_t workspace[64];
-  mmx_t *wsptr = workspace;
-  register mmx_t *dataptr = (mmx_t *)odata;
-  mmx_t *idata = (mmx_t *)data;
-
-  rskip = rskip>>3;
-/*
- * Perform inverse DCT on one block of coefficients.
- */
-
-    /* Odd part */
-
-	movq_m2r(*(idata+10), mm1);	// load idata[DCTSIZE*5]
-
-	movq_m2r(*(idata+6), mm0);		// load idata[DCTSIZE*3]
-
-	movq_m2r(*(idata+2), mm3);		// load idata[DCTSIZE*1]
-
-	movq_r2r(mm1, mm2);				// copy tmp6	/* phase 6 */
-
-	movq_m2r(*(idata+14), mm4);	// load idata[DCTSIZE*7]
-
-	paddw_r2r(mm0, mm1);				// z13 = tmp6 + tmp5;
-
-	psubw_r2r(mm0, mm2);				// z10 = tmp6 - tmp5
-
-	psllw_i2r(2, mm2);				// shift z10
-	movq_r2r(mm2, mm0); 				// copy z10
-
-	pmulhw_m2r(fix_184n261, mm2);	// MULTIPLY( z12, FIX_1_847759065); /* 2*c2 */
-	movq_r2r(mm3, mm5);				// copy tmp4
-
-	pmulhw_m2r(fix_n184, mm0);		// MULTIPLY(z10, -FIX_1_847759065); /* 2*c2 */
-	paddw_r2r(mm4, mm3);				// z11 = tmp4 + tmp7;
-
-	movq_r2r(mm3, mm6);				// copy z11			/* phase 5 */
-	psubw_r2r(mm4, mm5);				// z12 = tmp4 - tmp7;
-
-	psubw_r2r(mm1, mm6);				// z11-z13
-	psllw_i2r(2, mm5);				//	shift z12
-
-	movq_m2r(*(idata+12), mm4);	// load idata[DCTSIZE*6], even part
- 	movq_r2r(mm5, mm7);				//	copy z12
-
-	pmulhw_m2r(fix_108n184, mm5); //	MULT(z12, (FIX_1_08-FIX_1_84)) //- z5; /* 2*(c2-c6) */ even part
-	paddw_r2r(mm1, mm3);				// tmp7 = z11 + z13;
-
-	//ok
-
-    /* Even part */
-	pmulhw_m2r(fix_184, mm7);		// MULTIPLY(z10,(FIX_1_847759065 - FIX_2_613125930)) //+ z5; /* -2*(c2+c6) */
-	psllw_i2r(2, mm6);
-
-	movq_m2r(*(idata+4), mm1);		// load idata[DCTSIZE*2]
-
-	paddw_r2r(mm5, mm0);				//	tmp10
-
-	paddw_r2r(mm7, mm2);				// tmp12
-
-	pmulhw_m2r(fix_141, mm6);		// tmp11 = MULTIPLY(z11 - z13, FIX_1_414213562); /* 2*c4 */
-	psubw_r2r(mm3, mm2);				// tmp6 = tmp12 - tmp7
-
-	movq_r2r(mm1, mm5);				// copy tmp1
-	paddw_r2r(mm4, mm1);				// tmp13= tmp1 + tmp3;	/* phases 5-3 */
-
-	psubw_r2r(mm4, mm5);				// tmp1-tmp3
-	psubw_r2r(mm2, mm6);				// tmp5 = tmp11 - tmp6;
-
-	movq_r2m(mm1, *(wsptr));		// save tmp13 in workspace
-	psllw_i2r(2, mm5);	// shift tmp1-tmp3
-
-	movq_m2r(*(idata), mm7); 		// load idata[DCTSIZE*0]
-
-	pmulhw_m2r(fix_141, mm5);		// MULTIPLY(tmp1 - tmp3, FIX_1_414213562)
-	paddw_r2r(mm6, mm0);				// tmp4 = tmp10 + tmp5;
-
-	movq_m2r(*(idata+8), mm4); 	// load idata[DCTSIZE*4]
-
-	psubw_r2r(mm1, mm5);				// tmp12 = MULTIPLY(tmp1 - tmp3, FIX_1_414213562) - tmp13; /* 2*c4 */
-
-	movq_r2m(mm0, *(wsptr+4));		// save tmp4 in workspace
-	movq_r2r(mm7, mm1);			 	// copy tmp0	/* phase 3 */
-
-	movq_r2m(mm5, *(wsptr+2));		// save tmp12 in workspace
-	psubw_r2r(mm4, mm1);				// tmp11 = tmp0 - tmp2;
-
-	paddw_r2r(mm4, mm7);				// tmp10 = tmp0 + tmp2;
-   movq_r2r(mm1, mm5);				// copy tmp11
-
-	paddw_m2r(*(wsptr+2), mm1);	// tmp1 = tmp11 + tmp12;
-	movq_r2r(mm7, mm4);				// copy tmp10		/* phase 2 */
-
-	paddw_m2r(*(wsptr), mm7);		// tmp0 = tmp10 + tmp13;
-
-	psubw_m2r(*(wsptr), mm4);		// tmp3 = tmp10 - tmp13;
-	movq_r2r(mm7, mm0);				//	copy tmp0
-
-	psubw_m2r(*(wsptr+2), mm5);	// tmp2 = tmp11 - tmp12;
-	paddw_r2r(mm3, mm7);				//	wsptr[DCTSIZE*0] = (int) (tmp0 + tmp7);
-
-	psubw_r2r(mm3, mm0);				// wsptr[DCTSIZE*7] = (int) (tmp0 - tmp7);
-
-	movq_r2m(mm7, *(wsptr));		//	wsptr[DCTSIZE*0]
-	movq_r2r(mm1, mm3);				//	copy tmp1
-
-	movq_r2m(mm0, *(wsptr+14));		// wsptr[DCTSIZE*7]
-	paddw_r2r(mm2, mm1);				// wsptr[DCTSIZE*1] = (int) (tmp1 + tmp6);
-
-	psubw_r2r(mm2, mm3);				// wsptr[DCTSIZE*6] = (int) (tmp1 - tmp6);
-
-	movq_r2m(mm1, *(wsptr+2));		// wsptr[DCTSIZE*1]
-	movq_r2r(mm4, mm1);				//	copy tmp3
-
-	movq_r2m(mm3, *(wsptr+12));		// wsptr[DCTSIZE*6]
-
-	paddw_m2r(*(wsptr+4), mm4);	// wsptr[DCTSIZE*4] = (int) (tmp3 + tmp4);
-
-	psubw_m2r(*(wsptr+4), mm1); 	// wsptr[DCTSIZE*3] = (int) (tmp3 - tmp4);
-
-	movq_r2m(mm4, *(wsptr+8));
-	movq_r2r(mm5, mm7);				// copy tmp2
-
-	paddw_r2r(mm6, mm5);				// wsptr[DCTSIZE*2] = (int) (tmp2 + tmp5)
-
-	movq_r2m(mm1, *(wsptr+6));
-	psubw_r2r(mm6, mm7);				//	wsptr[DCTSIZE*5] = (int) (tmp2 - tmp5);
-
-	movq_r2m(mm5, *(wsptr+4));
-
-	movq_r2m(mm7, *(wsptr+10));
-
-	//ok
-
-
-/*****************************************************************/
-
-	idata++;
-	wsptr++;
-
-/*****************************************************************/
-
-	movq_m2r(*(idata+10), mm1);	// load idata[DCTSIZE*5]
-
-	movq_m2r(*(idata+6), mm0);		// load idata[DCTSIZE*3]
-
-	movq_m2r(*(idata+2),	mm3);		// load idata[DCTSIZE*1]
-	movq_r2r(mm1, mm2);				//	copy tmp6	/* phase 6 */
-
-	movq_m2r(*(idata+14),	mm4);		// load idata[DCTSIZE*7]
-	paddw_r2r(mm0, mm1);				//	z13 = tmp6 + tmp5;
-
-	psubw_r2r(mm0, mm2);				//	z10 = tmp6 - tmp5
-
-	psllw_i2r(2, mm2);				//	shift z10
-	movq_r2r(mm2, mm0);				//	copy z10
-
-	pmulhw_m2r(fix_184n261, mm2);	// MULTIPLY( z12, FIX_1_847759065); /* 2*c2 */
-	movq_r2r(mm3, mm5);				//	copy tmp4
-
-	pmulhw_m2r(fix_n184, mm0);		// MULTIPLY(z10, -FIX_1_847759065); /* 2*c2 */
-	paddw_r2r(mm4, mm3);				// z11 = tmp4 + tmp7;
-
-	movq_r2r(mm3, mm6);				// copy z11			/* phase 5 */
-	psubw_r2r(mm4, mm5);				//	z12 = tmp4 - tmp7;
-
-	psubw_r2r(mm1, mm6);				// z11-z13
-	psllw_i2r(2, mm5);				//	shift z12
-
-	movq_m2r(*(idata+12), mm4);	// load idata[DCTSIZE*6], even part
- 	movq_r2r(mm5, mm7);				// copy z12
-
-	pmulhw_m2r(fix_108n184, mm5);	// MULT(z12, (FIX_1_08-FIX_1_84)) //- z5; /* 2*(c2-c6) */ even part
-	paddw_r2r(mm1, mm3);				// tmp7 = z11 + z13;
-
-	//ok
-
-    /* Even part */
-	pmulhw_m2r(fix_184, mm7);		// MULTIPLY(z10,(FIX_1_847759065 - FIX_2_613125930)) //+ z5; /* -2*(c2+c6) */
-	psllw_i2r(2, mm6);
-
-	movq_m2r(*(idata+4), mm1);		// load idata[DCTSIZE*2]
-
-	paddw_r2r(mm5, mm0);				//	tmp10
-
-	paddw_r2r(mm7, mm2);				// tmp12
-
-	pmulhw_m2r(fix_141, mm6);		// tmp11 = MULTIPLY(z11 - z13, FIX_1_414213562); /* 2*c4 */
-	psubw_r2r(mm3, mm2);				// tmp6 = tmp12 - tmp7
-
-	movq_r2r(mm1, mm5);				// copy tmp1
-	paddw_r2r(mm4, mm1);				// tmp13= tmp1 + tmp3;	/* phases 5-3 */
-
-	psubw_r2r(mm4, mm5);				// tmp1-tmp3
-	psubw_r2r(mm2, mm6);				// tmp5 = tmp11 - tmp6;
-
-	movq_r2m(mm1, *(wsptr));		// save tmp13 in workspace
-	psllw_i2r(2, mm5); 				// shift tmp1-tmp3
-
-	movq_m2r(*(idata), mm7);		// load idata[DCTSIZE*0]
-	paddw_r2r(mm6, mm0);				// tmp4 = tmp10 + tmp5;
-
-	pmulhw_m2r(fix_141, mm5);		// MULTIPLY(tmp1 - tmp3, FIX_1_414213562)
-
-	movq_m2r(*(idata+8), mm4);    // load idata[DCTSIZE*4]
-
-	psubw_r2r(mm1, mm5);				// tmp12 = MULTIPLY(tmp1 - tmp3, FIX_1_414213562) - tmp13; /* 2*c4 */
-
-	movq_r2m(mm0, *(wsptr+4));		// save tmp4 in workspace
-	movq_r2r(mm7, mm1);				// copy tmp0	/* phase 3 */
-
-	movq_r2m(mm5, *(wsptr+2));		// save tmp12 in workspace
-	psubw_r2r(mm4, mm1);				// tmp11 = tmp0 - tmp2;
-
-	paddw_r2r(mm4, mm7);				// tmp10 = tmp0 + tmp2;
-   movq_r2r(mm1, mm5);				// copy tmp11
-
-	paddw_m2r(*(wsptr+2), mm1);	// tmp1 = tmp11 + tmp12;
-	movq_r2r(mm7, mm4);				// copy tmp10		/* phase 2 */
-
-	paddw_m2r(*(wsptr), mm7);		// tmp0 = tmp10 + tmp13;
-
-	psubw_m2r(*(wsptr), mm4);		// tmp3 = tmp10 - tmp13;
-	movq_r2r(mm7, mm0);				// copy tmp0
-
-	psubw_m2r(*(wsptr+2), mm5);	// tmp2 = tmp11 - tmp12;
-	paddw_r2r(mm3, mm7);				// wsptr[DCTSIZE*0] = (int) (tmp0 + tmp7);
-
-	psubw_r2r(mm3, mm0);				// wsptr[DCTSIZE*7] = (int) (tmp0 - tmp7);
-
-	movq_r2m(mm7, *(wsptr));		// wsptr[DCTSIZE*0]
-	movq_r2r(mm1, mm3);				// copy tmp1
-
-	movq_r2m(mm0, *(wsptr+14));		// wsptr[DCTSIZE*7]
-	paddw_r2r(mm2, mm1);				// wsptr[DCTSIZE*1] = (int) (tmp1 + tmp6);
-
-	psubw_r2r(mm2, mm3);				// wsptr[DCTSIZE*6] = (int) (tmp1 - tmp6);
-
-	movq_r2m(mm1, *(wsptr+2));		// wsptr[DCTSIZE*1]
-	movq_r2r(mm4, mm1);				// copy tmp3
-
-	movq_r2m(mm3, *(wsptr+12));		// wsptr[DCTSIZE*6]
-
-	paddw_m2r(*(wsptr+4), mm4);	// wsptr[DCTSIZE*4] = (int) (tmp3 + tmp4);
-
-	psubw_m2r(*(wsptr+4), mm1);	// wsptr[DCTSIZE*3] = (int) (tmp3 - tmp4);
-
-	movq_r2m(mm4, *(wsptr+8));
-	movq_r2r(mm5, mm7);				// copy tmp2
-
-	paddw_r2r(mm6, mm5);				// wsptr[DCTSIZE*2] = (int) (tmp2 + tmp5)
-
-	movq_r2m(mm1, *(wsptr+6));
-	psubw_r2r(mm6, mm7);				// wsptr[DCTSIZE*5] = (int) (tmp2 - tmp5);
-
-	movq_r2m(mm5, *(wsptr+4));
-
-	movq_r2m(mm7, *(wsptr+10));
-
-/*****************************************************************/
-
-  /* Pass 2: process rows from work array, store into output array. */
-  /* Note that we must descale the results by a factor of 8 == 2**3, */
-  /* and also undo the PASS1_BITS scaling. */
-
-/*****************************************************************/
-    /* Even part */
-
-	wsptr--;
-
-//    tmp10 = ((DCTELEM) wsptr[0] + (DCTELEM) wsptr[4]);
-//    tmp13 = ((DCTELEM) wsptr[2] + (DCTELEM) wsptr[6]);
-//    tmp11 = ((DCTELEM) wsptr[0] - (DCTELEM) wsptr[4]);
-//    tmp14 = ((DCTELEM) wsptr[2] - (DCTELEM) wsptr[6]);
-	movq_m2r(*(wsptr), mm0);		// wsptr[0,0],[0,1],[0,2],[0,3]
-
-	movq_m2r(*(wsptr+1),	mm1);		// wsptr[0,4],[0,5],[0,6],[0,7]
-	movq_r2r(mm0, mm2);
-
-	movq_m2r(*(wsptr+2), mm3);		// wsptr[1,0],[1,1],[1,2],[1,3]
-	paddw_r2r(mm1, mm0);				// wsptr[0,tmp10],[xxx],[0,tmp13],[xxx]
-
-	movq_m2r(*(wsptr+3), mm4);		// wsptr[1,4],[1,5],[1,6],[1,7]
-	psubw_r2r(mm1, mm2);				// wsptr[0,tmp11],[xxx],[0,tmp14],[xxx]
-
-	movq_r2r(mm0, mm6);
-	movq_r2r(mm3, mm5);
-
-	paddw_r2r(mm4, mm3);				// wsptr[1,tmp10],[xxx],[1,tmp13],[xxx]
-	movq_r2r(mm2, mm1);
-
-	psubw_r2r(mm4, mm5);				// wsptr[1,tmp11],[xxx],[1,tmp14],[xxx]
-	punpcklwd_r2r(mm3, mm0);		// wsptr[0,tmp10],[1,tmp10],[xxx],[xxx]
-
-	movq_m2r(*(wsptr+7), mm7);		// wsptr[3,4],[3,5],[3,6],[3,7]
-	punpckhwd_r2r(mm3, mm6);		// wsptr[0,tmp13],[1,tmp13],[xxx],[xxx]
-
-	movq_m2r(*(wsptr+4), mm3);		// wsptr[2,0],[2,1],[2,2],[2,3]
-	punpckldq_r2r(mm6, mm0);		// wsptr[0,tmp10],[1,tmp10],[0,tmp13],[1,tmp13]
-
-	punpcklwd_r2r(mm5, mm1);		// wsptr[0,tmp11],[1,tmp11],[xxx],[xxx]
-	movq_r2r(mm3, mm4);
-
-	movq_m2r(*(wsptr+6), mm6);		// wsptr[3,0],[3,1],[3,2],[3,3]
-	punpckhwd_r2r(mm5, mm2);		// wsptr[0,tmp14],[1,tmp14],[xxx],[xxx]
-
-	movq_m2r(*(wsptr+5), mm5);		// wsptr[2,4],[2,5],[2,6],[2,7]
-	punpckldq_r2r(mm2, mm1);		// wsptr[0,tmp11],[1,tmp11],[0,tmp14],[1,tmp14]
-
-
-	paddw_r2r(mm5, mm3);				// wsptr[2,tmp10],[xxx],[2,tmp13],[xxx]
-	movq_r2r(mm6, mm2);
-
-	psubw_r2r(mm5, mm4);				// wsptr[2,tmp11],[xxx],[2,tmp14],[xxx]
-	paddw_r2r(mm7, mm6);				// wsptr[3,tmp10],[xxx],[3,tmp13],[xxx]
-
-	movq_r2r(mm3, mm5);
-	punpcklwd_r2r(mm6, mm3);		// wsptr[2,tmp10],[3,tmp10],[xxx],[xxx]
-
-	psubw_r2r(mm7, mm2);				// wsptr[3,tmp11],[xxx],[3,tmp14],[xxx]
-	punpckhwd_r2r(mm6, mm5);		// wsptr[2,tmp13],[3,tmp13],[xxx],[xxx]
-
-	movq_r2r(mm4, mm7);
-	punpckldq_r2r(mm5, mm3);		// wsptr[2,tmp10],[3,tmp10],[2,tmp13],[3,tmp13]
-
-	punpcklwd_r2r(mm2, mm4);		// wsptr[2,tmp11],[3,tmp11],[xxx],[xxx]
-
-	punpckhwd_r2r(mm2, mm7);		// wsptr[2,tmp14],[3,tmp14],[xxx],[xxx]
-
-	punpckldq_r2r(mm7, mm4);		// wsptr[2,tmp11],[3,tmp11],[2,tmp14],[3,tmp14]
-	movq_r2r(mm1, mm6);
-
-	//ok
-
-//	mm0 = 	;wsptr[0,tmp10],[1,tmp10],[0,tmp13],[1,tmp13]
-//	mm1 =	;wsptr[0,tmp11],[1,tmp11],[0,tmp14],[1,tmp14]
-
-
-	movq_r2r(mm0, mm2);
-	punpckhdq_r2r(mm4, mm6);		// wsptr[0,tmp14],[1,tmp14],[2,tmp14],[3,tmp14]
-
-	punpckldq_r2r(mm4, mm1);		// wsptr[0,tmp11],[1,tmp11],[2,tmp11],[3,tmp11]
-	psllw_i2r(2, mm6);
-
-	pmulhw_m2r(fix_141, mm6);
-	punpckldq_r2r(mm3, mm0);		// wsptr[0,tmp10],[1,tmp10],[2,tmp10],[3,tmp10]
-
-	punpckhdq_r2r(mm3, mm2);		// wsptr[0,tmp13],[1,tmp13],[2,tmp13],[3,tmp13]
-	movq_r2r(mm0, mm7);
-
-//    tmp0 = tmp10 + tmp13;
-//    tmp3 = tmp10 - tmp13;
-	paddw_r2r(mm2, mm0);				// [0,tmp0],[1,tmp0],[2,tmp0],[3,tmp0]
-	psubw_r2r(mm2, mm7);				// [0,tmp3],[1,tmp3],[2,tmp3],[3,tmp3]
-
-//    tmp12 = MULTIPLY(tmp14, FIX_1_414213562) - tmp13;
-	psubw_r2r(mm2, mm6);				// wsptr[0,tmp12],[1,tmp12],[2,tmp12],[3,tmp12]
-//    tmp1 = tmp11 + tmp12;
-//    tmp2 = tmp11 - tmp12;
-	movq_r2r(mm1, mm5);
-
-	//OK
-
-    /* Odd part */
-
-//    z13 = (DCTELEM) wsptr[5] + (DCTELEM) wsptr[3];
-//    z10 = (DCTELEM) wsptr[5] - (DCTELEM) wsptr[3];
-//    z11 = (DCTELEM) wsptr[1] + (DCTELEM) wsptr[7];
-//    z12 = (DCTELEM) wsptr[1] - (DCTELEM) wsptr[7];
-	movq_m2r(*(wsptr), mm3);		// wsptr[0,0],[0,1],[0,2],[0,3]
-	paddw_r2r(mm6, mm1);				// [0,tmp1],[1,tmp1],[2,tmp1],[3,tmp1]
-
-	movq_m2r(*(wsptr+1), mm4);		// wsptr[0,4],[0,5],[0,6],[0,7]
-	psubw_r2r(mm6, mm5);				// [0,tmp2],[1,tmp2],[2,tmp2],[3,tmp2]
-
-	movq_r2r(mm3, mm6);
-	punpckldq_r2r(mm4, mm3);		// wsptr[0,0],[0,1],[0,4],[0,5]
-
-	punpckhdq_r2r(mm6, mm4);		// wsptr[0,6],[0,7],[0,2],[0,3]
-	movq_r2r(mm3, mm2);
-
-//Save tmp0 and tmp1 in wsptr
-	movq_r2m(mm0, *(wsptr));		// save tmp0
-	paddw_r2r(mm4, mm2);				// wsptr[xxx],[0,z11],[xxx],[0,z13]
-
-
-//Continue with z10 --- z13
-	movq_m2r(*(wsptr+2), mm6);		// wsptr[1,0],[1,1],[1,2],[1,3]
-	psubw_r2r(mm4, mm3);				// wsptr[xxx],[0,z12],[xxx],[0,z10]
-
-	movq_m2r(*(wsptr+3), mm0);		// wsptr[1,4],[1,5],[1,6],[1,7]
-	movq_r2r(mm6, mm4);
-
-	movq_r2m(mm1, *(wsptr+1));		// save tmp1
-	punpckldq_r2r(mm0, mm6);		// wsptr[1,0],[1,1],[1,4],[1,5]
-
-	punpckhdq_r2r(mm4, mm0);		// wsptr[1,6],[1,7],[1,2],[1,3]
-	movq_r2r(mm6, mm1);
-
-//Save tmp2 and tmp3 in wsptr
-	paddw_r2r(mm0, mm6);				// wsptr[xxx],[1,z11],[xxx],[1,z13]
-	movq_r2r(mm2, mm4);
-
-//Continue with z10 --- z13
-	movq_r2m(mm5, *(wsptr+2));		// save tmp2
-	punpcklwd_r2r(mm6, mm2);		// wsptr[xxx],[xxx],[0,z11],[1,z11]
-
-	psubw_r2r(mm0, mm1);				// wsptr[xxx],[1,z12],[xxx],[1,z10]
-	punpckhwd_r2r(mm6, mm4);		// wsptr[xxx],[xxx],[0,z13],[1,z13]
-
-	movq_r2r(mm3, mm0);
-	punpcklwd_r2r(mm1, mm3);		// wsptr[xxx],[xxx],[0,z12],[1,z12]
-
-	movq_r2m(mm7, *(wsptr+3));		// save tmp3
-	punpckhwd_r2r(mm1, mm0);		// wsptr[xxx],[xxx],[0,z10],[1,z10]
-
-	movq_m2r(*(wsptr+4), mm6);		// wsptr[2,0],[2,1],[2,2],[2,3]
-	punpckhdq_r2r(mm2, mm0);		// wsptr[0,z10],[1,z10],[0,z11],[1,z11]
-
-	movq_m2r(*(wsptr+5), mm7);	// wsptr[2,4],[2,5],[2,6],[2,7]
-	punpckhdq_r2r(mm4, mm3);		// wsptr[0,z12],[1,z12],[0,z13],[1,z13]
-
-	movq_m2r(*(wsptr+6), mm1);	// wsptr[3,0],[3,1],[3,2],[3,3]
-	movq_r2r(mm6, mm4);
-
-	punpckldq_r2r(mm7, mm6);		// wsptr[2,0],[2,1],[2,4],[2,5]
-	movq_r2r(mm1, mm5);
-
-	punpckhdq_r2r(mm4, mm7);		// wsptr[2,6],[2,7],[2,2],[2,3]
-	movq_r2r(mm6, mm2);
-
-	movq_m2r(*(wsptr+7), mm4);	// wsptr[3,4],[3,5],[3,6],[3,7]
-	paddw_r2r(mm7, mm6);				// wsptr[xxx],[2,z11],[xxx],[2,z13]
-
-	psubw_r2r(mm7, mm2);				// wsptr[xxx],[2,z12],[xxx],[2,z10]
-	punpckldq_r2r(mm4, mm1);		// wsptr[3,0],[3,1],[3,4],[3,5]
-
-	punpckhdq_r2r(mm5, mm4);		// wsptr[3,6],[3,7],[3,2],[3,3]
-	movq_r2r(mm1, mm7);
-
-	paddw_r2r(mm4, mm1);				// wsptr[xxx],[3,z11],[xxx],[3,z13]
-	psubw_r2r(mm4, mm7);				// wsptr[xxx],[3,z12],[xxx],[3,z10]
-
-	movq_r2r(mm6, mm5);
-	punpcklwd_r2r(mm1, mm6);		// wsptr[xxx],[xxx],[2,z11],[3,z11]
-
-	punpckhwd_r2r(mm1, mm5);		// wsptr[xxx],[xxx],[2,z13],[3,z13]
-	movq_r2r(mm2, mm4);
-
-	punpcklwd_r2r(mm7, mm2);		// wsptr[xxx],[xxx],[2,z12],[3,z12]
-
-	punpckhwd_r2r(mm7, mm4);		// wsptr[xxx],[xxx],[2,z10],[3,z10]
-
-	punpckhdq_r2r(mm6, mm4);		/// wsptr[2,z10],[3,z10],[2,z11],[3,z11]
-
-	punpckhdq_r2r(mm5, mm2);		// wsptr[2,z12],[3,z12],[2,z13],[3,z13]
-	movq_r2r(mm0, mm5);
-
-	punpckldq_r2r(mm4, mm0);		// wsptr[0,z10],[1,z10],[2,z10],[3,z10]
-
-	punpckhdq_r2r(mm4, mm5);		// wsptr[0,z11],[1,z11],[2,z11],[3,z11]
-	movq_r2r(mm3, mm4);
-
-	punpckhdq_r2r(mm2, mm4);		// wsptr[0,z13],[1,z13],[2,z13],[3,z13]
-	movq_r2r(mm5, mm1);
-
-	punpckldq_r2r(mm2, mm3);		// wsptr[0,z12],[1,z12],[2,z12],[3,z12]
-//    tmp7 = z11 + z13;		/* phase 5 */
-//    tmp8 = z11 - z13;		/* phase 5 */
-	psubw_r2r(mm4, mm1);				// tmp8
-
-	paddw_r2r(mm4, mm5);				// tmp7
-//    tmp21 = MULTIPLY(tmp8, FIX_1_414213562); /* 2*c4 */
-	psllw_i2r(2, mm1);
-
-	psllw_i2r(2, mm0);
-
-	pmulhw_m2r(fix_141, mm1);		// tmp21
-//    tmp20 = MULTIPLY(z12, (FIX_1_082392200- FIX_1_847759065))  /* 2*(c2-c6) */
-//			+ MULTIPLY(z10, - FIX_1_847759065); /* 2*c2 */
-	psllw_i2r(2, mm3);
-	movq_r2r(mm0, mm7);
-
-	pmulhw_m2r(fix_n184, mm7);
-	movq_r2r(mm3, mm6);
-
-	movq_m2r(*(wsptr), mm2);		// tmp0,final1
-
-	pmulhw_m2r(fix_108n184, mm6);
-//	 tmp22 = MULTIPLY(z10,(FIX_1_847759065 - FIX_2_613125930)) /* -2*(c2+c6) */
-//			+ MULTIPLY(z12, FIX_1_847759065); /* 2*c2 */
-	movq_r2r(mm2, mm4);				// final1
-
-	pmulhw_m2r(fix_184n261, mm0);
-	paddw_r2r(mm5, mm2);				// tmp0+tmp7,final1
-
-	pmulhw_m2r(fix_184, mm3);
-	psubw_r2r(mm5, mm4);				// tmp0-tmp7,final1
-
-//    tmp6 = tmp22 - tmp7;	/* phase 2 */
-	psraw_i2r(3, mm2);				// outptr[0,0],[1,0],[2,0],[3,0],final1
-
-	paddw_r2r(mm6, mm7);				// tmp20
-	psraw_i2r(3, mm4);				// outptr[0,7],[1,7],[2,7],[3,7],final1
-
-	paddw_r2r(mm0, mm3);				// tmp22
-
-//    tmp5 = tmp21 - tmp6;
-	psubw_r2r(mm5, mm3);				// tmp6
-
-//    tmp4 = tmp20 + tmp5;
-	movq_m2r(*(wsptr+1), mm0);		// tmp1,final2
-	psubw_r2r(mm3, mm1);				// tmp5
-
-	movq_r2r(mm0, mm6);				// final2
-	paddw_r2r(mm3, mm0);				// tmp1+tmp6,final2
-
-    /* Final output stage: scale down by a factor of 8 and range-limit */
-
-
-//    outptr[0] = range_limit[IDESCALE(tmp0 + tmp7, PASS1_BITS+3)
-//			    & RANGE_MASK];
-//    outptr[7] = range_limit[IDESCALE(tmp0 - tmp7, PASS1_BITS+3)
-//			    & RANGE_MASK];	final1
-
-
-//    outptr[1] = range_limit[IDESCALE(tmp1 + tmp6, PASS1_BITS+3)
-//			    & RANGE_MASK];
-//    outptr[6] = range_limit[IDESCALE(tmp1 - tmp6, PASS1_BITS+3)
-//			    & RANGE_MASK];	final2
-	psubw_r2r(mm3, mm6);				// tmp1-tmp6,final2
-	psraw_i2r(3, mm0);				// outptr[0,1],[1,1],[2,1],[3,1]
-
-	psraw_i2r(3, mm6);				// outptr[0,6],[1,6],[2,6],[3,6]
-
-	packuswb_r2r(mm4, mm0);			// out[0,1],[1,1],[2,1],[3,1],[0,7],[1,7],[2,7],[3,7]
-
-	movq_m2r(*(wsptr+2), mm5);		// tmp2,final3
-	packuswb_r2r(mm6, mm2);			// out[0,0],[1,0],[2,0],[3,0],[0,6],[1,6],[2,6],[3,6]
-
-//    outptr[2] = range_limit[IDESCALE(tmp2 + tmp5, PASS1_BITS+3)
-//			    & RANGE_MASK];
-//    outptr[5] = range_limit[IDESCALE(tmp2 - tmp5, PASS1_BITS+3)
-//			    & RANGE_MASK];	final3
-	paddw_r2r(mm1, mm7);				// tmp4
-	movq_r2r(mm5, mm3);
-
-	paddw_r2r(mm1, mm5);				// tmp2+tmp5
-	psubw_r2r(mm1, mm3);				// tmp2-tmp5
-
-	psraw_i2r(3, mm5);				// outptr[0,2],[1,2],[2,2],[3,2]
-
-	movq_m2r(*(wsptr+3), mm4);		// tmp3,final4
-	psraw_i2r(3, mm3);				// outptr[0,5],[1,5],[2,5],[3,5]
-
-
-
-//    outptr[4] = range_limit[IDESCALE(tmp3 + tmp4, PASS1_BITS+3)
-//			    & RANGE_MASK];
-//    outptr[3] = range_limit[IDESCALE(tmp3 - tmp4, PASS1_BITS+3)
-//			    & RANGE_MASK];	final4
-	movq_r2r(mm4, mm6);
-	paddw_r2r(mm7, mm4);				// tmp3+tmp4
-
-	psubw_r2r(mm7, mm6);				// tmp3-tmp4
-	psraw_i2r(3, mm4);				// outptr[0,4],[1,4],[2,4],[3,4]
-
-	// mov			ecx, [dataptr]
-
-	psraw_i2r(3, mm6);				// outptr[0,3],[1,3],[2,3],[3,3]
-
-	packuswb_r2r(mm4, mm5);			// out[0,2],[1,2],[2,2],[3,2],[0,4],[1,4],[2,4],[3,4]
-
-	packuswb_r2r(mm3, mm6);			// out[0,3],[1,3],[2,3],[3,3],[0,5],[1,5],[2,5],[3,5]
-	movq_r2r(mm2, mm4);
-
-	movq_r2r(mm5, mm7);
-	punpcklbw_r2r(mm0, mm2);		// out[0,0],[0,1],[1,0],[1,1],[2,0],[2,1],[3,0],[3,1]
-
-	punpckhbw_r2r(mm0, mm4);		// out[0,6],[0,7],[1,6],[1,7],[2,6],[2,7],[3,6],[3,7]
-	movq_r2r(mm2, mm1);
-
-	punpcklbw_r2r(mm6, mm5);		// out[0,2],[0,3],[1,2],[1,3],[2,2],[2,3],[3,2],[3,3]
-
-	// add		 	dataptr, 4
-
-	punpckhbw_r2r(mm6, mm7);		// out[0,4],[0,5],[1,4],[1,5],[2,4],[2,5],[3,4],[3,5]
-
-	punpcklwd_r2r(mm5, mm2);		// out[0,0],[0,1],[0,2],[0,3],[1,0],[1,1],[1,2],[1,3]
-
-	// add			ecx, output_col
-
-	movq_r2r(mm7, mm6);
-	punpckhwd_r2r(mm5, mm1);		// out[2,0],[2,1],[2,2],[2,3],[3,0],[3,1],[3,2],[3,3]
-
-	movq_r2r(mm2, mm0);
-	punpcklwd_r2r(mm4, mm6);		// out[0,4],[0,5],[0,6],[0,7],[1,4],[1,5],[1,6],[1,7]
-
-	// mov			idata, [dataptr]
-
-	punpckldq_r2r(mm6, mm2);		// out[0,0],[0,1],[0,2],[0,3],[0,4],[0,5],[0,6],[0,7]
-
-	// add		 	dataptr, 4
-
-	movq_r2r(mm1, mm3);
-
-	// add			idata, output_col
-
-	punpckhwd_r2r(mm4, mm7);		// out[2,4],[2,5],[2,6],[2,7],[3,4],[3,5],[3,6],[3,7]
-
-	movq_r2m(mm2, *(dataptr));
-
-	punpckhdq_r2r(mm6, mm0);		// out[1,0],[1,1],[1,2],[1,3],[1,4],[1,5],[1,6],[1,7]
-
-	dataptr += rskip;
-	movq_r2m(mm0, *(dataptr));
-
-	punpckldq_r2r(mm7, mm1);		// out[2,0],[2,1],[2,2],[2,3],[2,4],[2,5],[2,6],[2,7]
-	punpckhdq_r2r(mm7, mm3);		// out[3,0],[3,1],[3,2],[3,3],[3,4],[3,5],[3,6],[3,7]
-
-	dataptr += rskip;
-	movq_r2m(mm1, *(dataptr));
-
-	dataptr += rskip;
-	movq_r2m(mm3, *(dataptr));
-
-/*******************************************************************/
-
-	wsptr += 8;
-
-/*******************************************************************/
-
-//    tmp10 = ((DCTELEM) wsptr[0] + (DCTELEM) wsptr[4]);
-//    tmp13 = ((DCTELEM) wsptr[2] + (DCTELEM) wsptr[6]);
-//    tmp11 = ((DCTELEM) wsptr[0] - (DCTELEM) wsptr[4]);
-//    tmp14 = ((DCTELEM) wsptr[2] - (DCTELEM) wsptr[6]);
-	movq_m2r(*(wsptr), mm0);		// wsptr[0,0],[0,1],[0,2],[0,3]
-
-	movq_m2r(*(wsptr+1), mm1);		// wsptr[0,4],[0,5],[0,6],[0,7]
-	movq_r2r(mm0, mm2);
-
-	movq_m2r(*(wsptr+2), mm3);		// wsptr[1,0],[1,1],[1,2],[1,3]
-	paddw_r2r(mm1, mm0);				// wsptr[0,tmp10],[xxx],[0,tmp13],[xxx]
-
-	movq_m2r(*(wsptr+3), mm4);		// wsptr[1,4],[1,5],[1,6],[1,7]
-	psubw_r2r(mm1, mm2);				// wsptr[0,tmp11],[xxx],[0,tmp14],[xxx]
-
-	movq_r2r(mm0, mm6);
-	movq_r2r(mm3, mm5);
-
-	paddw_r2r(mm4, mm3);				// wsptr[1,tmp10],[xxx],[1,tmp13],[xxx]
-	movq_r2r(mm2, mm1);
-
-	psubw_r2r(mm4, mm5);				// wsptr[1,tmp11],[xxx],[1,tmp14],[xxx]
-	punpcklwd_r2r(mm3, mm0);		// wsptr[0,tmp10],[1,tmp10],[xxx],[xxx]
-
-	movq_m2r(*(wsptr+7), mm7);	// wsptr[3,4],[3,5],[3,6],[3,7]
-	punpckhwd_r2r(mm3, mm6);		// wsptr[0,tmp13],[1,tmp13],[xxx],[xxx]
-
-	movq_m2r(*(wsptr+4),	mm3);		// wsptr[2,0],[2,1],[2,2],[2,3]
-	punpckldq_r2r(mm6, mm0);		// wsptr[0,tmp10],[1,tmp10],[0,tmp13],[1,tmp13]
-
-	punpcklwd_r2r(mm5, mm1);		// wsptr[0,tmp11],[1,tmp11],[xxx],[xxx]
-	movq_r2r(mm3, mm4);
-
-	movq_m2r(*(wsptr+6), mm6);	// wsptr[3,0],[3,1],[3,2],[3,3]
-	punpckhwd_r2r(mm5, mm2);		// wsptr[0,tmp14],[1,tmp14],[xxx],[xxx]
-
-	movq_m2r(*(wsptr+5), mm5);	// wsptr[2,4],[2,5],[2,6],[2,7]
-	punpckldq_r2r(mm2, mm1);		// wsptr[0,tmp11],[1,tmp11],[0,tmp14],[1,tmp14]
-
-	paddw_r2r(mm5, mm3);				// wsptr[2,tmp10],[xxx],[2,tmp13],[xxx]
-	movq_r2r(mm6, mm2);
-
-	psubw_r2r(mm5, mm4);				// wsptr[2,tmp11],[xxx],[2,tmp14],[xxx]
-	paddw_r2r(mm7, mm6);				// wsptr[3,tmp10],[xxx],[3,tmp13],[xxx]
-
-	movq_r2r(mm3, mm5);
-	punpcklwd_r2r(mm6, mm3);		// wsptr[2,tmp10],[3,tmp10],[xxx],[xxx]
-
-	psubw_r2r(mm7, mm2);				// wsptr[3,tmp11],[xxx],[3,tmp14],[xxx]
-	punpckhwd_r2r(mm6, mm5);		// wsptr[2,tmp13],[3,tmp13],[xxx],[xxx]
-
-	movq_r2r(mm4, mm7);
-	punpckldq_r2r(mm5, mm3);		// wsptr[2,tmp10],[3,tmp10],[2,tmp13],[3,tmp13]
-
-	punpcklwd_r2r(mm2, mm4);		// wsptr[2,tmp11],[3,tmp11],[xxx],[xxx]
-
-	punpckhwd_r2r(mm2, mm7);		// wsptr[2,tmp14],[3,tmp14],[xxx],[xxx]
-
-	punpckldq_r2r(mm7, mm4);		// wsptr[2,tmp11],[3,tmp11],[2,tmp14],[3,tmp14]
-	movq_r2r(mm1, mm6);
-
-	//OK
-
-//	mm0 = 	;wsptr[0,tmp10],[1,tmp10],[0,tmp13],[1,tmp13]
-//	mm1 =	;wsptr[0,tmp11],[1,tmp11],[0,tmp14],[1,tmp14]
-
-	movq_r2r(mm0, mm2);
-	punpckhdq_r2r(mm4, mm6);		// wsptr[0,tmp14],[1,tmp14],[2,tmp14],[3,tmp14]
-
-	punpckldq_r2r(mm4, mm1);		// wsptr[0,tmp11],[1,tmp11],[2,tmp11],[3,tmp11]
-	psllw_i2r(2, mm6);
-
-	pmulhw_m2r(fix_141, mm6);
-	punpckldq_r2r(mm3, mm0);		// wsptr[0,tmp10],[1,tmp10],[2,tmp10],[3,tmp10]
-
-	punpckhdq_r2r(mm3, mm2);		// wsptr[0,tmp13],[1,tmp13],[2,tmp13],[3,tmp13]
-	movq_r2r(mm0, mm7);
-
-//    tmp0 = tmp10 + tmp13;
-//    tmp3 = tmp10 - tmp13;
-	paddw_r2r(mm2, mm0);				// [0,tmp0],[1,tmp0],[2,tmp0],[3,tmp0]
-	psubw_r2r(mm2, mm7);				// [0,tmp3],[1,tmp3],[2,tmp3],[3,tmp3]
-
-//    tmp12 = MULTIPLY(tmp14, FIX_1_414213562) - tmp13;
-	psubw_r2r(mm2, mm6);				// wsptr[0,tmp12],[1,tmp12],[2,tmp12],[3,tmp12]
-//    tmp1 = tmp11 + tmp12;
-//    tmp2 = tmp11 - tmp12;
-	movq_r2r(mm1, mm5);
-
-	 //OK
-
-
-    /* Odd part */
-
-//    z13 = (DCTELEM) wsptr[5] + (DCTELEM) wsptr[3];
-//    z10 = (DCTELEM) wsptr[5] - (DCTELEM) wsptr[3];
-//    z11 = (DCTELEM) wsptr[1] + (DCTELEM) wsptr[7];
-//    z12 = (DCTELEM) wsptr[1] - (DCTELEM) wsptr[7];
-	movq_m2r(*(wsptr), mm3);		// wsptr[0,0],[0,1],[0,2],[0,3]
-	paddw_r2r(mm6, mm1);				// [0,tmp1],[1,tmp1],[2,tmp1],[3,tmp1]
-
-	movq_m2r(*(wsptr+1),	mm4);		// wsptr[0,4],[0,5],[0,6],[0,7]
-	psubw_r2r(mm6, mm5);				// [0,tmp2],[1,tmp2],[2,tmp2],[3,tmp2]
-
-	movq_r2r(mm3, mm6);
-	punpckldq_r2r(mm4, mm3);		// wsptr[0,0],[0,1],[0,4],[0,5]
-
-	punpckhdq_r2r(mm6, mm4);		// wsptr[0,6],[0,7],[0,2],[0,3]
-	movq_r2r(mm3, mm2);
-
-//Save tmp0 and tmp1 in wsptr
-	movq_r2m(mm0, *(wsptr));		// save tmp0
-	paddw_r2r(mm4, mm2);				// wsptr[xxx],[0,z11],[xxx],[0,z13]
-
-
-//Continue with z10 --- z13
-	movq_m2r(*(wsptr+2), mm6);		// wsptr[1,0],[1,1],[1,2],[1,3]
-	psubw_r2r(mm4, mm3);				// wsptr[xxx],[0,z12],[xxx],[0,z10]
-
-	movq_m2r(*(wsptr+3), mm0);		// wsptr[1,4],[1,5],[1,6],[1,7]
-	movq_r2r(mm6, mm4);
-
-	movq_r2m(mm1, *(wsptr+1));		// save tmp1
-	punpckldq_r2r(mm0, mm6);		// wsptr[1,0],[1,1],[1,4],[1,5]
-
-	punpckhdq_r2r(mm4, mm0);		// wsptr[1,6],[1,7],[1,2],[1,3]
-	movq_r2r(mm6, mm1);
-
-//Save tmp2 and tmp3 in wsptr
-	paddw_r2r(mm0, mm6);				// wsptr[xxx],[1,z11],[xxx],[1,z13]
-	movq_r2r(mm2, mm4);
-
-//Continue with z10 --- z13
-	movq_r2m(mm5, *(wsptr+2));		// save tmp2
-	punpcklwd_r2r(mm6, mm2);		// wsptr[xxx],[xxx],[0,z11],[1,z11]
-
-	psubw_r2r(mm0, mm1);				// wsptr[xxx],[1,z12],[xxx],[1,z10]
-	punpckhwd_r2r(mm6, mm4);		// wsptr[xxx],[xxx],[0,z13],[1,z13]
-
-	movq_r2r(mm3, mm0);
-	punpcklwd_r2r(mm1, mm3);		// wsptr[xxx],[xxx],[0,z12],[1,z12]
-
-	movq_r2m(mm7, *(wsptr+3));		// save tmp3
-	punpckhwd_r2r(mm1, mm0);		// wsptr[xxx],[xxx],[0,z10],[1,z10]
-
-	movq_m2r(*(wsptr+4), mm6);		// wsptr[2,0],[2,1],[2,2],[2,3]
-	punpckhdq_r2r(mm2, mm0);		// wsptr[0,z10],[1,z10],[0,z11],[1,z11]
-
-	movq_m2r(*(wsptr+5), mm7);	// wsptr[2,4],[2,5],[2,6],[2,7]
-	punpckhdq_r2r(mm4, mm3);		// wsptr[0,z12],[1,z12],[0,z13],[1,z13]
-
-	movq_m2r(*(wsptr+6), mm1);	// wsptr[3,0],[3,1],[3,2],[3,3]
-	movq_r2r(mm6, mm4);
-
-	punpckldq_r2r(mm7, mm6);		// wsptr[2,0],[2,1],[2,4],[2,5]
-	movq_r2r(mm1, mm5);
-
-	punpckhdq_r2r(mm4, mm7);		// wsptr[2,6],[2,7],[2,2],[2,3]
-	movq_r2r(mm6, mm2);
-
-	movq_m2r(*(wsptr+7), mm4);	// wsptr[3,4],[3,5],[3,6],[3,7]
-	paddw_r2r(mm7, mm6);				// wsptr[xxx],[2,z11],[xxx],[2,z13]
-
-	psubw_r2r(mm7, mm2);				// wsptr[xxx],[2,z12],[xxx],[2,z10]
-	punpckldq_r2r(mm4, mm1);		// wsptr[3,0],[3,1],[3,4],[3,5]
-
-	punpckhdq_r2r(mm5, mm4);		// wsptr[3,6],[3,7],[3,2],[3,3]
-	movq_r2r(mm1, mm7);
-
-	paddw_r2r(mm4, mm1);				// wsptr[xxx],[3,z11],[xxx],[3,z13]
-	psubw_r2r(mm4, mm7);				// wsptr[xxx],[3,z12],[xxx],[3,z10]
-
-	movq_r2r(mm6, mm5);
-	punpcklwd_r2r(mm1, mm6);		// wsptr[xxx],[xxx],[2,z11],[3,z11]
-
-	punpckhwd_r2r(mm1, mm5);		// wsptr[xxx],[xxx],[2,z13],[3,z13]
-	movq_r2r(mm2, mm4);
-
-	punpcklwd_r2r(mm7, mm2);		// wsptr[xxx],[xxx],[2,z12],[3,z12]
-
-	punpckhwd_r2r(mm7, mm4);		// wsptr[xxx],[xxx],[2,z10],[3,z10]
-
-	punpckhdq_r2r(mm6, mm4);		// wsptr[2,z10],[3,z10],[2,z11],[3,z11]
-
-	punpckhdq_r2r(mm5, mm2);		// wsptr[2,z12],[3,z12],[2,z13],[3,z13]
-	movq_r2r(mm0, mm5);
-
-	punpckldq_r2r(mm4, mm0);		// wsptr[0,z10],[1,z10],[2,z10],[3,z10]
-
-	punpckhdq_r2r(mm4, mm5);		// wsptr[0,z11],[1,z11],[2,z11],[3,z11]
-	movq_r2r(mm3, mm4);
-
-	punpckhdq_r2r(mm2, mm4);		// wsptr[0,z13],[1,z13],[2,z13],[3,z13]
-	movq_r2r(mm5, mm1);
-
-	punpckldq_r2r(mm2, mm3);		// wsptr[0,z12],[1,z12],[2,z12],[3,z12]
-//    tmp7 = z11 + z13;		/* phase 5 */
-//    tmp8 = z11 - z13;		/* phase 5 */
-	psubw_r2r(mm4, mm1);				// tmp8
-
-	paddw_r2r(mm4, mm5);				// tmp7
-//    tmp21 = MULTIPLY(tmp8, FIX_1_414213562); /* 2*c4 */
-	psllw_i2r(2, mm1);
-
-	psllw_i2r(2, mm0);
-
-	pmulhw_m2r(fix_141, mm1);		// tmp21
-//    tmp20 = MULTIPLY(z12, (FIX_1_082392200- FIX_1_847759065))  /* 2*(c2-c6) */
-//			+ MULTIPLY(z10, - FIX_1_847759065); /* 2*c2 */
-	psllw_i2r(2, mm3);
-	movq_r2r(mm0, mm7);
-
-	pmulhw_m2r(fix_n184, mm7);
-	movq_r2r(mm3, mm6);
-
-	movq_m2r(*(wsptr), mm2);		// tmp0,final1
-
-	pmulhw_m2r(fix_108n184, mm6);
-//	 tmp22 = MULTIPLY(z10,(FIX_1_847759065 - FIX_2_613125930)) /* -2*(c2+c6) */
-//			+ MULTIPLY(z12, FIX_1_847759065); /* 2*c2 */
-	movq_r2r(mm2, mm4);				// final1
-
-	pmulhw_m2r(fix_184n261, mm0);
-	paddw_r2r(mm5, mm2);				// tmp0+tmp7,final1
-
-	pmulhw_m2r(fix_184, mm3);
-	psubw_r2r(mm5, mm4);				// tmp0-tmp7,final1
-
-//    tmp6 = tmp22 - tmp7;	/* phase 2 */
-	psraw_i2r(3, mm2);				// outptr[0,0],[1,0],[2,0],[3,0],final1
-
-	paddw_r2r(mm6, mm7);				// tmp20
-	psraw_i2r(3, mm4);				// outptr[0,7],[1,7],[2,7],[3,7],final1
-
-	paddw_r2r(mm0, mm3);				// tmp22
-
-//    tmp5 = tmp21 - tmp6;
-	psubw_r2r(mm5, mm3);				// tmp6
-
-//    tmp4 = tmp20 + tmp5;
-	movq_m2r(*(wsptr+1), mm0);		// tmp1,final2
-	psubw_r2r(mm3, mm1);				// tmp5
-
-	movq_r2r(mm0, mm6);				// final2
-	paddw_r2r(mm3, mm0);				// tmp1+tmp6,final2
-
-    /* Final output stage: scale down by a factor of 8 and range-limit */
-
-//    outptr[0] = range_limit[IDESCALE(tmp0 + tmp7, PASS1_BITS+3)
-//			    & RANGE_MASK];
-//    outptr[7] = range_limit[IDESCALE(tmp0 - tmp7, PASS1_BITS+3)
-//			    & RANGE_MASK];	final1
-
-
-//    outptr[1] = range_limit[IDESCALE(tmp1 + tmp6, PASS1_BITS+3)
-//			    & RANGE_MASK];
-//    outptr[6] = range_limit[IDESCALE(tmp1 - tmp6, PASS1_BITS+3)
-//			    & RANGE_MASK];	final2
-	psubw_r2r(mm3, mm6);				// tmp1-tmp6,final2
-	psraw_i2r(3, mm0);				// outptr[0,1],[1,1],[2,1],[3,1]
-
-	psraw_i2r(3, mm6);				// outptr[0,6],[1,6],[2,6],[3,6]
-
-	packuswb_r2r(mm4, mm0);			// out[0,1],[1,1],[2,1],[3,1],[0,7],[1,7],[2,7],[3,7]
-
-	movq_m2r(*(wsptr+2), mm5);		// tmp2,final3
-	packuswb_r2r(mm6, mm2);			// out[0,0],[1,0],[2,0],[3,0],[0,6],[1,6],[2,6],[3,6]
-
-//    outptr[2] = range_limit[IDESCALE(tmp2 + tmp5, PASS1_BITS+3)
-//			    & RANGE_MASK];
-//    outptr[5] = range_limit[IDESCALE(tmp2 - tmp5, PASS1_BITS+3)
-//			    & RANGE_MASK];	final3
-	paddw_r2r(mm1, mm7);				// tmp4
-	movq_r2r(mm5, mm3);
-
-	paddw_r2r(mm1, mm5);				// tmp2+tmp5
-	psubw_r2r(mm1, mm3);				// tmp2-tmp5
-
-	psraw_i2r(3, mm5);				// outptr[0,2],[1,2],[2,2],[3,2]
-
-	movq_m2r(*(wsptr+3), mm4);		// tmp3,final4
-	psraw_i2r(3, mm3);				// outptr[0,5],[1,5],[2,5],[3,5]
-
-
-
-//    outptr[4] = range_limit[IDESCALE(tmp3 + tmp4, PASS1_BITS+3)
-//			    & RANGE_MASK];
-//    outptr[3] = range_limit[IDESCALE(tmp3 - tmp4, PASS1_BITS+3)
-//			    & RANGE_MASK];	final4
-	movq_r2r(mm4, mm6);
-	paddw_r2r(mm7, mm4);				// tmp3+tmp4
-
-	psubw_r2r(mm7, mm6);				// tmp3-tmp4
-	psraw_i2r(3, mm4);				// outptr[0,4],[1,4],[2,4],[3,4]
-
-	psraw_i2r(3, mm6);				// outptr[0,3],[1,3],[2,3],[3,3]
-
-	/*
-   movq_r2m(mm4, *dummy);
-	fprintf(stderr, "3-4 %016llx\n", dummy);
-   movq_r2m(mm4, *dummy);
-	fprintf(stderr, "3+4 %016llx\n", dummy);
-	*/
-
-
-	packuswb_r2r(mm4, mm5);			// out[0,2],[1,2],[2,2],[3,2],[0,4],[1,4],[2,4],[3,4]
-
-	packuswb_r2r(mm3, mm6);			// out[0,3],[1,3],[2,3],[3,3],[0,5],[1,5],[2,5],[3,5]
-	movq_r2r(mm2, mm4);
-
-	movq_r2r(mm5, mm7);
-	punpcklbw_r2r(mm0, mm2);		// out[0,0],[0,1],[1,0],[1,1],[2,0],[2,1],[3,0],[3,1]
-
-	punpckhbw_r2r(mm0, mm4);		// out[0,6],[0,7],[1,6],[1,7],[2,6],[2,7],[3,6],[3,7]
-	movq_r2r(mm2, mm1);
-
-	punpcklbw_r2r(mm6, mm5);		// out[0,2],[0,3],[1,2],[1,3],[2,2],[2,3],[3,2],[3,3]
-
-	punpckhbw_r2r(mm6, mm7);		// out[0,4],[0,5],[1,4],[1,5],[2,4],[2,5],[3,4],[3,5]
-
-	punpcklwd_r2r(mm5, mm2);		// out[0,0],[0,1],[0,2],[0,3],[1,0],[1,1],[1,2],[1,3]
-
-	movq_r2r(mm7, mm6);
-	punpckhwd_r2r(mm5, mm1);		// out[2,0],[2,1],[2,2],[2,3],[3,0],[3,1],[3,2],[3,3]
-
-	movq_r2r(mm2, mm0);
-	punpcklwd_r2r(mm4, mm6);		// out[0,4],[0,5],[0,6],[0,7],[1,4],[1,5],[1,6],[1,7]
-
-	punpckldq_r2r(mm6, mm2);		// out[0,0],[0,1],[0,2],[0,3],[0,4],[0,5],[0,6],[0,7]
-
-	movq_r2r(mm1, mm3);
-
-	punpckhwd_r2r(mm4, mm7);		// out[2,4],[2,5],[2,6],[2,7],[3,4],[3,5],[3,6],[3,7]
-
-	dataptr += rskip;
-	movq_r2m(mm2, *(dataptr));
-
-	punpckhdq_r2r(mm6, mm0);		// out[1,0],[1,1],[1,2],[1,3],[1,4],[1,5],[1,6],[1,7]
-
-	dataptr += rskip;
-	movq_r2m(mm0, *(dataptr));
-
-	punpckldq_r2r(mm7, mm1);		// out[2,0],[2,1],[2,2],[2,3],[2,4],[2,5],[2,6],[2,7]
-
-	punpckhdq_r2r(mm7, mm3);		// out[3,0],[3,1],[3,2],[3,3],[3,4],[3,5],[3,6],[3,7]
-
-	dataptr += rskip;
-	movq_r2m(mm1, *(dataptr));
-
-	dataptr += rskip;
-	movq_r2m(mm3, *(dataptr));
-
-#else
-  int32_t tmp0, tmp1, tmp2, tmp3, tmp4, tmp5, tmp6, tmp7;
-  int32_t tmp10, tmp11, tmp12, tmp13;
-  int32_t z5, z10, z11, z12, z13;
-  int16_t *inptr;
-  int32_t *wsptr;
-  uint8_t *outptr;
-  int ctr;
-  int32_t dcval;
-  int32_t workspace[64];
-
-  inptr = data;
-  wsptr = workspace;
-  for (ctr = 8; ctr > 0; ctr--) {
-
-    if ((inptr[8] | inptr[16] | inptr[24] |
-	 inptr[32] | inptr[40] | inptr[48] | inptr[56]) == 0) {
-      dcval = inptr[0];
-      wsptr[0] = dcval;
-      wsptr[8] = dcval;
-      wsptr[16] = dcval;
-      wsptr[24] = dcval;
-      wsptr[32] = dcval;
-      wsptr[40] = dcval;
-      wsptr[48] = dcval;
-      wsptr[56] = dcval;
-
-      inptr++;
-      wsptr++;
-      continue;
-    }
-
-    tmp0 = inptr[0];
-    tmp1 = inptr[16];
-    tmp2 = inptr[32];
-    tmp3 = inptr[48];
-
-    tmp10 = tmp0 + tmp2;
-    tmp11 = tmp0 - tmp2;
-
-    tmp13 = tmp1 + tmp3;
-    tmp12 = MULTIPLY(tmp1 - tmp3, FIX_1_414213562) - tmp13;
-
-    tmp0 = tmp10 + tmp13;
-    tmp3 = tmp10 - tmp13;
-    tmp1 = tmp11 + tmp12;
-    tmp2 = tmp11 - tmp12;
-
-    tmp4 = inptr[8];
-    tmp5 = inptr[24];
-    tmp6 = inptr[40];
-    tmp7 = inptr[56];
-
-    z13 = tmp6 + tmp5;
-    z10 = tmp6 - tmp5;
-    z11 = tmp4 + tmp7;
-    z12 = tmp4 - tmp7;
+static void RTjpeg_decode_slice(void *arg, int slice, int nslices)
+{
+    RTjpegContext *ctx = arg;
+    int rows = ctx->decode_rows;
+    int row0 = (int)((long)rows * slice / nslices);
+    int row1 = (int)((long)rows * (slice+1) / nslices);
 
-    tmp7 = z11 + z13;
-    tmp11 = MULTIPLY(z11 - z13, FIX_1_414213562);
+    ctx->decode_func(ctx, ctx->slices[slice].block, ctx->rowpos[row0],
+                     ctx->decode_bp, row0, row1);
+}
 
-    z5 = MULTIPLY(z10 + z12, FIX_1_847759065);
-    tmp10 = MULTIPLY(z12, FIX_1_082392200) - z5;
-    tmp12 = MULTIPLY(z10, - FIX_2_613125930) + z5;
+/**
+ * RTjpeg_decode:  Decode a frame of `rows' macroblock rows of `blocks'
+ * coded blocks each with `func', splitting it into bands if more than
+ * one thread is available.  The start of each band is found by skipping
+ * over the blocks before it.
+ *
+ * Parameters:    ctx: Codec context.
+ *               func: Decoding routine for the frame format.
+ *                 sp: Coded frame.
+ *                 bp: Output frame buffer.
+ *               rows: Number of macroblock rows.
+ *             blocks: Number of coded blocks per macroblock row.
+ * Return value: None.
+ */
 
-    tmp6 = tmp12 - tmp7;
-    tmp5 = tmp11 - tmp6;
-    tmp4 = tmp10 + tmp5;
+static void RTjpeg_decode(RTjpegContext *ctx, RTjpegDecodeFunc func,
+                          int8_t *sp, uint8_t *bp, int rows, int blocks)
+{
+    int nthreads = tc_workers_threads(ctx->workers);
+    int nslices = (rows < nthreads) ? rows : nthreads;
+    int last, row, i;
 
-    wsptr[0] = (int32_t) (tmp0 + tmp7);
-    wsptr[56] = (int32_t) (tmp0 - tmp7);
-    wsptr[8] = (int32_t) (tmp1 + tmp6);
-    wsptr[48] = (int32_t) (tmp1 - tmp6);
-    wsptr[16] = (int32_t) (tmp2 + tmp5);
-    wsptr[40] = (int32_t) (tmp2 - tmp5);
-    wsptr[32] = (int32_t) (tmp3 + tmp4);
-    wsptr[24] = (int32_t) (tmp3 - tmp4);
+    if (nslices <= 1 || !ctx->slices || ctx->rowpos_size < rows) {
+        func(ctx, ctx->block, sp, bp, 0, rows);
+        return;
+    }
 
-    inptr++;
-    wsptr++;
-  }
+    /* Only the band starts are needed, so stop at the last one */
+    last = (int)((long)rows * (nslices-1) / nslices);
+    for (row = 0; row <= last; row++) {
+        ctx->rowpos[row] = sp;
+        if (row < last) {
+            for (i = 0; i < blocks; i++)
+                sp += RTjpeg_skip_block(sp);
+        }
+    }
 
-  wsptr = workspace;
-  for (ctr = 0; ctr < 8; ctr++) {
-    outptr = &(odata[ctr*rskip]);
+    ctx->decode_func = func;
+    ctx->decode_bp = bp;
+    ctx->decode_rows = rows;
+    ctx->job_count = nslices;
+    tc_workers_run(ctx->workers, RTjpeg_decode_slice, ctx, nslices);
+}
 
-    tmp10 = wsptr[0] + wsptr[4];
-    tmp11 = wsptr[0] - wsptr[4];
+/*************************************************************************/
+/*
 
-    tmp13 = wsptr[2] + wsptr[6];
-    tmp12 = MULTIPLY(wsptr[2] - wsptr[6], FIX_1_414213562) - tmp13;
+Main Routines
 
-    tmp0 = tmp10 + tmp13;
-    tmp3 = tmp10 - tmp13;
-    tmp1 = tmp11 + tmp12;
-    tmp2 = tmp11 - tmp12;
+This file contains most of the initialisation and control functions
 
-    z13 = wsptr[5] + wsptr[3];
-    z10 = wsptr[5] - wsptr[3];
-    z11 = wsptr[1] + wsptr[7];
-    z12 = wsptr[1] - wsptr[7];
+(C) Justin Schoeman 1998
 
-    tmp7 = z11 + z13;
-    tmp11 = MULTIPLY(z11 - z13, FIX_1_414213562);
+*/
 
-    z5 = MULTIPLY(z10 + z12, FIX_1_847759065);
-    tmp10 = MULTIPLY(z12, FIX_1_082392200) - z5;
-    tmp12 = MULTIPLY(z10, - FIX_2_613125930) + z5;
+/*
 
-    tmp6 = tmp12 - tmp7;
-    tmp5 = tmp11 - tmp6;
-    tmp4 = tmp10 + tmp5;
+Private function
 
-    outptr[0] = RL(DESCALE(tmp0 + tmp7));
-    outptr[7] = RL(DESCALE(tmp0 - tmp7));
-    outptr[1] = RL(DESCALE(tmp1 + tmp6));
-    outptr[6] = RL(DESCALE(tmp1 - tmp6));
-    outptr[2] = RL(DESCALE(tmp2 + tmp5));
-    outptr[5] = RL(DESCALE(tmp2 - tmp5));
-    outptr[4] = RL(DESCALE(tmp3 + tmp4));
-    outptr[3] = RL(DESCALE(tmp3 - tmp4));
+Compute the quantisation tables for quality factor Q
 
-    wsptr += 8;
-  }
-#endif
-}
-/*
+*/
 
-Main Routines
+static void RTjpeg_calc_tables(RTjpegContext *ctx, uint8_t Q)
+{
+ int i;
+ uint64_t qual;
 
-This file contains most of the initialisation and control functions
+ qual=(uint64_t)Q<<(32-7); /* 32 bit FP, 255=2, 0=0 */
 
-(C) Justin Schoeman 1998
+ for(i=0; i<64; i++)
+ {
+  ctx->lqt[i]=(int32_t)((qual/((uint64_t)RTjpeg_lum_quant_tbl[i]<<16))>>3);
+  if(ctx->lqt[i]==0)ctx->lqt[i]=1;
+  ctx->cqt[i]=(int32_t)((qual/((uint64_t)RTjpeg_chrom_quant_tbl[i]<<16))>>3);
+  if(ctx->cqt[i]==0)ctx->cqt[i]=1;
+  ctx->liqt[i]=(1<<16)/(ctx->lqt[i]<<3);
+  ctx->ciqt[i]=(1<<16)/(ctx->cqt[i]<<3);
+  ctx->lqt[i]=((1<<16)/ctx->liqt[i])>>3;
+  ctx->cqt[i]=((1<<16)/ctx->ciqt[i])>>3;
+ }
 
-*/
+ ctx->lb8=0;
+ while(ctx->liqt[RTjpeg_ZZ[++ctx->lb8]]<=8);
+ ctx->lb8--;
+ ctx->cb8=0;
+ while(ctx->ciqt[RTjpeg_ZZ[++ctx->cb8]]<=8);
+ ctx->cb8--;
+}
 
 /*
 
 Private function
 
-Initialise all the cache-aliged data blocks
+Set the frame dimensions
 
 */
 
-static void RTjpeg_init_data(void)
+static void RTjpeg_set_size(RTjpegContext *ctx, int width, int height)
 {
- unsigned long dptr;
-
- dptr=(unsigned long)&(RTjpeg_alldata[0]);
- dptr+=32;
- dptr=dptr>>5;
- dptr=dptr<<5; /* cache align data */
-
- RTjpeg_block=(int16_t *)dptr;
- dptr+=sizeof(int16_t)*64;
- RTjpeg_lqt=(int32_t *)dptr;
- dptr+=sizeof(int32_t)*64;
- RTjpeg_cqt=(int32_t *)dptr;
- dptr+=sizeof(int32_t)*64;
- RTjpeg_liqt=(uint32_t *)dptr;
- dptr+=sizeof(uint32_t)*64;
- RTjpeg_ciqt=(uint32_t *)dptr;
+ ctx->width=width;
+ ctx->height=height;
+ ctx->Ywidth = width>>3;
+ ctx->Ysize=width * height;
+ ctx->Cwidth = width>>4;
+ ctx->Csize= (width>>1) * height;
 }
 
 /*
@@ -2729,40 +1452,14 @@ External Function
 
 Re-set quality factor
 
-Input: buf -> pointer to 128 ints for quant values store to pass back to
-              init_decompress.
-       Q -> quality factor (192=best, 32=worst)
+Input: Q -> quality factor (192=best, 32=worst)
 */
 
-void RTjpeg_init_Q(uint8_t Q)
+void RTjpeg_init_Q(RTjpegContext *ctx, uint8_t Q)
 {
- int i;
- uint64_t qual;
-
- qual=(uint64_t)Q<<(32-7); /* 32 bit FP, 255=2, 0=0 */
-
- for(i=0; i<64; i++)
- {
-  RTjpeg_lqt[i]=(int32_t)((qual/((uint64_t)RTjpeg_lum_quant_tbl[i]<<16))>>3);
-  if(RTjpeg_lqt[i]==0)RTjpeg_lqt[i]=1;
-  RTjpeg_cqt[i]=(int32_t)((qual/((uint64_t)RTjpeg_chrom_quant_tbl[i]<<16))>>3);
-  if(RTjpeg_cqt[i]==0)RTjpeg_cqt[i]=1;
-  RTjpeg_liqt[i]=(1<<16)/(RTjpeg_lqt[i]<<3);
-  RTjpeg_ciqt[i]=(1<<16)/(RTjpeg_cqt[i]<<3);
-  RTjpeg_lqt[i]=((1<<16)/RTjpeg_liqt[i])>>3;
-  RTjpeg_cqt[i]=((1<<16)/RTjpeg_ciqt[i])>>3;
- }
-
- RTjpeg_lb8=0;
- while(RTjpeg_liqt[RTjpeg_ZZ[++RTjpeg_lb8]]<=8);
- RTjpeg_lb8--;
- RTjpeg_cb8=0;
- while(RTjpeg_ciqt[RTjpeg_ZZ[++RTjpeg_cb8]]<=8);
- RTjpeg_cb8--;
-
- RTjpeg_dct_init();
- RTjpeg_idct_init();
- RTjpeg_quant_init();
+ RTjpeg_calc_tables(ctx, Q);
+ RTjpeg_dct_init(ctx);
+ RTjpeg_idct_init(ctx);
 }
 
 /*
@@ -2779,642 +1476,409 @@ Input: buf -> pointer to 128 ints for quant values store to pass back to
 
 */
 
-void RTjpeg_init_compress(uint32_t *buf, int width, int height, uint8_t Q)
+void RTjpeg_init_compress(RTjpegContext *ctx, uint32_t *buf, int width, int height, uint8_t Q)
 {
  int i;
- uint64_t qual;
 
- RTjpeg_init_data();
+ RTjpeg_set_size(ctx, width, height);
+ RTjpeg_calc_tables(ctx, Q);
+ RTjpeg_dct_init(ctx);
 
- RTjpeg_width=width;
- RTjpeg_height=height;
- RTjpeg_Ywidth = RTjpeg_width>>3;
- RTjpeg_Ysize=width * height;
- RTjpeg_Cwidth = RTjpeg_width>>4;
- RTjpeg_Csize= (width>>1) * height;
+ for(i=0; i<64; i++)
+  buf[i]=ctx->liqt[i];
+ for(i=0; i<64; i++)
+  buf[64+i]=ctx->ciqt[i];
+}
 
- qual=(uint64_t)Q<<(32-7); /* 32 bit FP, 255=2, 0=0 */
+/*
 
- for(i=0; i<64; i++)
- {
-  RTjpeg_lqt[i]=(int32_t)((qual/((uint64_t)RTjpeg_lum_quant_tbl[i]<<16))>>3);
-  if(RTjpeg_lqt[i]==0)RTjpeg_lqt[i]=1;
-  RTjpeg_cqt[i]=(int32_t)((qual/((uint64_t)RTjpeg_chrom_quant_tbl[i]<<16))>>3);
-  if(RTjpeg_cqt[i]==0)RTjpeg_cqt[i]=1;
-  RTjpeg_liqt[i]=(1<<16)/(RTjpeg_lqt[i]<<3);
-  RTjpeg_ciqt[i]=(1<<16)/(RTjpeg_cqt[i]<<3);
-  RTjpeg_lqt[i]=((1<<16)/RTjpeg_liqt[i])>>3;
-  RTjpeg_cqt[i]=((1<<16)/RTjpeg_ciqt[i])>>3;
- }
+External Function
 
- RTjpeg_lb8=0;
- while(RTjpeg_liqt[RTjpeg_ZZ[++RTjpeg_lb8]]<=8);
- RTjpeg_lb8--;
- RTjpeg_cb8=0;
- while(RTjpeg_ciqt[RTjpeg_ZZ[++RTjpeg_cb8]]<=8);
- RTjpeg_cb8--;
+Initialise decompression.
 
- RTjpeg_dct_init();
- RTjpeg_quant_init();
+Input: buf -> the 128 quant values from init_compress
+       width -> width of image
+       height -> height of image
 
- for(i=0; i<64; i++)
-  buf[i]=RTjpeg_liqt[i];
- for(i=0; i<64; i++)
-  buf[64+i]=RTjpeg_ciqt[i];
-}
+*/
 
-void RTjpeg_init_decompress(uint32_t *buf, int width, int height)
+void RTjpeg_init_decompress(RTjpegContext *ctx, uint32_t *buf, int width, int height)
 {
  int i;
 
- RTjpeg_init_data();
-
- RTjpeg_width=width;
- RTjpeg_height=height;
- RTjpeg_Ywidth = RTjpeg_width>>3;
- RTjpeg_Ysize=width * height;
- RTjpeg_Cwidth = RTjpeg_width>>4;
- RTjpeg_Csize= (width>>1) * height;
+ RTjpeg_set_size(ctx, width, height);
 
  for(i=0; i<64; i++)
  {
-  RTjpeg_liqt[i]=buf[i];
-  RTjpeg_ciqt[i]=buf[i+64];
+  ctx->liqt[i]=buf[i];
+  ctx->ciqt[i]=buf[i+64];
  }
 
- RTjpeg_lb8=0;
- while(RTjpeg_liqt[RTjpeg_ZZ[++RTjpeg_lb8]]<=8);
- RTjpeg_lb8--;
- RTjpeg_cb8=0;
- while(RTjpeg_ciqt[RTjpeg_ZZ[++RTjpeg_cb8]]<=8);
- RTjpeg_cb8--;
+ ctx->lb8=0;
+ while(ctx->liqt[RTjpeg_ZZ[++ctx->lb8]]<=8);
+ ctx->lb8--;
+ ctx->cb8=0;
+ while(ctx->ciqt[RTjpeg_ZZ[++ctx->cb8]]<=8);
+ ctx->cb8--;
+
+ RTjpeg_idct_init(ctx);
+
+ /* One position per macroblock row for banded decoding; if this fails
+  * frames are simply decoded on one thread */
+ free(ctx->rowpos);
+ ctx->rowpos_size = (height>>3) + 1;
+ ctx->rowpos = malloc(ctx->rowpos_size * sizeof(*ctx->rowpos));
+ if (!ctx->rowpos)
+  ctx->rowpos_size = 0;
+}
+
+/*************************************************************************/
 
- RTjpeg_idct_init();
+/* Code one block: luminance if chroma==0, chrominance otherwise */
 
-// RTjpeg_color_init();
+static inline int RTjpeg_compress_block(RTjpegContext *ctx, int8_t *sp, uint8_t *bp, int rskip, int chroma)
+{
+ ctx->dctY(bp, ctx->block, rskip);
+ ctx->quant(ctx->block, chroma ? ctx->cqt : ctx->lqt);
+ return RTjpeg_b2s(ctx->block, sp, chroma ? ctx->cb8 : ctx->lb8);
 }
 
-int RTjpeg_compressYUV420(int8_t *sp, unsigned char *bp)
+int RTjpeg_compressYUV420(RTjpegContext *ctx, int8_t *sp, unsigned char *bp)
 {
  int8_t * sb;
- register int8_t * bp1 = bp + (RTjpeg_width<<3);
- register int8_t * bp2 = bp + RTjpeg_Ysize;
- register int8_t * bp3 = bp2 + (RTjpeg_Csize>>1);
- register int i, j, k;
+ uint8_t * bp1 = bp + (ctx->width<<3);
+ uint8_t * bp2 = bp + ctx->Ysize;
+ uint8_t * bp3 = bp2 + (ctx->Csize>>1);
+ int i, j, k;
 
-#ifdef MMX
- emms();
-#endif
  sb=sp;
 /* Y */
- for(i=RTjpeg_height>>1; i; i-=8)
+ for(i=ctx->height>>1; i; i-=8)
  {
-  for(j=0, k=0; j<RTjpeg_width; j+=16, k+=8)
+  for(j=0, k=0; j<ctx->width; j+=16, k+=8)
   {
-   RTjpeg_dctY(bp+j, RTjpeg_block, RTjpeg_Ywidth);
-   RTjpeg_quant(RTjpeg_block, RTjpeg_lqt);
-   sp+=RTjpeg_b2s(RTjpeg_block, sp, RTjpeg_lb8);
-
-   RTjpeg_dctY(bp+j+8, RTjpeg_block, RTjpeg_Ywidth);
-   RTjpeg_quant(RTjpeg_block, RTjpeg_lqt);
-   sp+=RTjpeg_b2s(RTjpeg_block, sp, RTjpeg_lb8);
-
-   RTjpeg_dctY(bp1+j, RTjpeg_block, RTjpeg_Ywidth);
-   RTjpeg_quant(RTjpeg_block, RTjpeg_lqt);
-   sp+=RTjpeg_b2s(RTjpeg_block, sp, RTjpeg_lb8);
-
-   RTjpeg_dctY(bp1+j+8, RTjpeg_block, RTjpeg_Ywidth);
-   RTjpeg_quant(RTjpeg_block, RTjpeg_lqt);
-   sp+=RTjpeg_b2s(RTjpeg_block, sp, RTjpeg_lb8);
-
-   RTjpeg_dctY(bp2+k, RTjpeg_block, RTjpeg_Cwidth);
-   RTjpeg_quant(RTjpeg_block, RTjpeg_cqt);
-   sp+=RTjpeg_b2s(RTjpeg_block, sp, RTjpeg_cb8);
-
-   RTjpeg_dctY(bp3+k, RTjpeg_block, RTjpeg_Cwidth);
-   RTjpeg_quant(RTjpeg_block, RTjpeg_cqt);
-   sp+=RTjpeg_b2s(RTjpeg_block, sp, RTjpeg_cb8);
-
+   sp+=RTjpeg_compress_block(ctx, sp, bp+j, ctx->Ywidth, 0);
+   sp+=RTjpeg_compress_block(ctx, sp, bp+j+8, ctx->Ywidth, 0);
+   sp+=RTjpeg_compress_block(ctx, sp, bp1+j, ctx->Ywidth, 0);
+   sp+=RTjpeg_compress_block(ctx, sp, bp1+j+8, ctx->Ywidth, 0);
+   sp+=RTjpeg_compress_block(ctx, sp, bp2+k, ctx->Cwidth, 1);
+   sp+=RTjpeg_compress_block(ctx, sp, bp3+k, ctx->Cwidth, 1);
   }
-  bp+=RTjpeg_width<<4;
-  bp1+=RTjpeg_width<<4;
-  bp2+=RTjpeg_width<<2;
-  bp3+=RTjpeg_width<<2;
+  bp+=ctx->width<<4;
+  bp1+=ctx->width<<4;
+  bp2+=ctx->width<<2;
+  bp3+=ctx->width<<2;
 
  }
-#ifdef MMX
- emms();
-#endif
  return (sp-sb);
 }
 
-int RTjpeg_compressYUV422(int8_t *sp, unsigned char *bp)
+int RTjpeg_compressYUV422(RTjpegContext *ctx, int8_t *sp, unsigned char *bp)
 {
  int8_t * sb;
- register int8_t * bp2 = bp + RTjpeg_Ysize;
- register int8_t * bp3 = bp2 + RTjpeg_Csize;
- register int i, j, k;
+ uint8_t * bp2 = bp + ctx->Ysize;
+ uint8_t * bp3 = bp2 + ctx->Csize;
+ int i, j, k;
 
-#ifdef MMX
- emms();
-#endif
  sb=sp;
 /* Y */
- for(i=RTjpeg_height; i; i-=8)
+ for(i=ctx->height; i; i-=8)
  {
-  for(j=0, k=0; j<RTjpeg_width; j+=16, k+=8)
+  for(j=0, k=0; j<ctx->width; j+=16, k+=8)
   {
-   RTjpeg_dctY(bp+j, RTjpeg_block, RTjpeg_Ywidth);
-   RTjpeg_quant(RTjpeg_block, RTjpeg_lqt);
-   sp+=RTjpeg_b2s(RTjpeg_block, sp, RTjpeg_lb8);
-
-   RTjpeg_dctY(bp+j+8, RTjpeg_block, RTjpeg_Ywidth);
-   RTjpeg_quant(RTjpeg_block, RTjpeg_lqt);
-   sp+=RTjpeg_b2s(RTjpeg_block, sp, RTjpeg_lb8);
-
-   RTjpeg_dctY(bp2+k, RTjpeg_block, RTjpeg_Cwidth);
-   RTjpeg_quant(RTjpeg_block, RTjpeg_cqt);
-   sp+=RTjpeg_b2s(RTjpeg_block, sp, RTjpeg_cb8);
-
-   RTjpeg_dctY(bp3+k, RTjpeg_block, RTjpeg_Cwidth);
-   RTjpeg_quant(RTjpeg_block, RTjpeg_cqt);
-   sp+=RTjpeg_b2s(RTjpeg_block, sp, RTjpeg_cb8);
-
+   sp+=RTjpeg_compress_block(ctx, sp, bp+j, ctx->Ywidth, 0);
+   sp+=RTjpeg_compress_block(ctx, sp, bp+j+8, ctx->Ywidth, 0);
+   sp+=RTjpeg_compress_block(ctx, sp, bp2+k, ctx->Cwidth, 1);
+   sp+=RTjpeg_compress_block(ctx, sp, bp3+k, ctx->Cwidth, 1);
   }
-  bp+=RTjpeg_width<<3;
-  bp2+=RTjpeg_width<<2;
-  bp3+=RTjpeg_width<<2;
+  bp+=ctx->width<<3;
+  bp2+=ctx->width<<2;
+  bp3+=ctx->width<<2;
 
  }
-#ifdef MMX
- emms();
-#endif
  return (sp-sb);
 }
 
-int RTjpeg_compress8(int8_t *sp, unsigned char *bp)
+int RTjpeg_compress8(RTjpegContext *ctx, int8_t *sp, unsigned char *bp)
 {
  int8_t * sb;
  int i, j;
 
-#ifdef MMX
- emms();
-#endif
 
  sb=sp;
 /* Y */
- for(i=0; i<RTjpeg_height; i+=8)
+ for(i=0; i<ctx->height; i+=8)
  {
-  for(j=0; j<RTjpeg_width; j+=8)
+  for(j=0; j<ctx->width; j+=8)
   {
-   RTjpeg_dctY(bp+j, RTjpeg_block, RTjpeg_width);
-   RTjpeg_quant(RTjpeg_block, RTjpeg_lqt);
-   sp+=RTjpeg_b2s(RTjpeg_block, sp, RTjpeg_lb8);
+   sp+=RTjpeg_compress_block(ctx, sp, bp+j, ctx->Ywidth, 0);
   }
-  bp+=RTjpeg_width;
+  bp+=ctx->width<<3;
  }
 
-#ifdef MMX
- emms();
-#endif
  return (sp-sb);
 }
 
-void RTjpeg_decompressYUV422(int8_t *sp, uint8_t *bp)
+/*************************************************************************/
+
+/* Decode one block, or skip it if it is marked unchanged (-1) */
+
+static inline int8_t *RTjpeg_decompress_block(RTjpegContext *ctx, int16_t *block, int8_t *sp, uint8_t *bp, int stride, int chroma)
 {
- register int8_t * bp2 = bp + RTjpeg_Ysize;
- register int8_t * bp3 = bp2 + (RTjpeg_Csize);
- int i, j,k;
+ if(*sp==-1)
+  return sp+1;
+ sp+=RTjpeg_s2b(block, sp, chroma ? ctx->cb8 : ctx->lb8, chroma ? ctx->ciqt : ctx->liqt);
+ ctx->idct(bp, block, stride);
+ return sp;
+}
 
-#ifdef MMX
- emms();
-#endif
+/* Decode macroblock rows row0..row1-1 (16 lines each) of a YUV420 frame */
 
-/* Y */
- for(i=RTjpeg_height; i; i-=8)
+static void RTjpeg_decode420(RTjpegContext *ctx, int16_t *block, int8_t *sp, uint8_t *bp, int row0, int row1)
+{
+ uint8_t * bp1;
+ uint8_t * bp2 = bp + ctx->Ysize + row0*(ctx->width<<2);
+ uint8_t * bp3 = bp2 + (ctx->Csize>>1);
+ int i, j, k;
+
+ bp+=row0*(ctx->width<<4);
+ bp1=bp + (ctx->width<<3);
+ for(i=row0; i<row1; i++)
  {
-  for(k=0, j=0; j<RTjpeg_width; j+=16, k+=8) {
-   if(*sp==-1)sp++;
-   else
-   {
-    sp+=RTjpeg_s2b(RTjpeg_block, sp, RTjpeg_lb8, RTjpeg_liqt);
-    RTjpeg_idct(bp+j, RTjpeg_block, RTjpeg_width);
-   }
-   if(*sp==-1)sp++;
-   else
-   {
-    sp+=RTjpeg_s2b(RTjpeg_block, sp, RTjpeg_lb8, RTjpeg_liqt);
-    RTjpeg_idct(bp+j+8, RTjpeg_block, RTjpeg_width);
-   }
-   if(*sp==-1)sp++;
-   else
-   {
-    sp+=RTjpeg_s2b(RTjpeg_block, sp, RTjpeg_cb8, RTjpeg_ciqt);
-    RTjpeg_idct(bp2+k, RTjpeg_block, RTjpeg_width>>1);
-   }
-   if(*sp==-1)sp++;
-   else
-   {
-    sp+=RTjpeg_s2b(RTjpeg_block, sp, RTjpeg_cb8, RTjpeg_ciqt);
-    RTjpeg_idct(bp3+k, RTjpeg_block, RTjpeg_width>>1);
-   }
+  for(k=0, j=0; j<ctx->width; j+=16, k+=8) {
+   sp=RTjpeg_decompress_block(ctx, block, sp, bp+j, ctx->width, 0);
+   sp=RTjpeg_decompress_block(ctx, block, sp, bp+j+8, ctx->width, 0);
+   sp=RTjpeg_decompress_block(ctx, block, sp, bp1+j, ctx->width, 0);
+   sp=RTjpeg_decompress_block(ctx, block, sp, bp1+j+8, ctx->width, 0);
+   sp=RTjpeg_decompress_block(ctx, block, sp, bp2+k, ctx->width>>1, 1);
+   sp=RTjpeg_decompress_block(ctx, block, sp, bp3+k, ctx->width>>1, 1);
   }
-  bp+=RTjpeg_width<<3;
-  bp2+=RTjpeg_width<<2;
-  bp3+=RTjpeg_width<<2;
+  bp+=ctx->width<<4;
+  bp1+=ctx->width<<4;
+  bp2+=ctx->width<<2;
+  bp3+=ctx->width<<2;
  }
-#ifdef MMX
- emms();
-#endif
 }
 
-void RTjpeg_decompressYUV420(int8_t *sp, uint8_t *bp)
-{
- register int8_t * bp1 = bp + (RTjpeg_width<<3);
- register int8_t * bp2 = bp + RTjpeg_Ysize;
- register int8_t * bp3 = bp2 + (RTjpeg_Csize>>1);
- int i, j,k;
+/* Decode macroblock rows row0..row1-1 (8 lines each) of a YUV422 frame */
 
-#ifdef MMX
- emms();
-#endif
+static void RTjpeg_decode422(RTjpegContext *ctx, int16_t *block, int8_t *sp, uint8_t *bp, int row0, int row1)
+{
+ uint8_t * bp2 = bp + ctx->Ysize + row0*(ctx->width<<2);
+ uint8_t * bp3 = bp2 + ctx->Csize;
+ int i, j, k;
 
-/* Y */
- for(i=RTjpeg_height>>1; i; i-=8)
+ bp+=row0*(ctx->width<<3);
+ for(i=row0; i<row1; i++)
  {
-  for(k=0, j=0; j<RTjpeg_width; j+=16, k+=8) {
-   if(*sp==-1)sp++;
-   else
-   {
-    sp+=RTjpeg_s2b(RTjpeg_block, sp, RTjpeg_lb8, RTjpeg_liqt);
-    RTjpeg_idct(bp+j, RTjpeg_block, RTjpeg_width);
-   }
-   if(*sp==-1)sp++;
-   else
-   {
-    sp+=RTjpeg_s2b(RTjpeg_block, sp, RTjpeg_lb8, RTjpeg_liqt);
-    RTjpeg_idct(bp+j+8, RTjpeg_block, RTjpeg_width);
-   }
-   if(*sp==-1)sp++;
-   else
-   {
-    sp+=RTjpeg_s2b(RTjpeg_block, sp, RTjpeg_lb8, RTjpeg_liqt);
-    RTjpeg_idct(bp1+j, RTjpeg_block, RTjpeg_width);
-   }
-   if(*sp==-1)sp++;
-   else
-   {
-    sp+=RTjpeg_s2b(RTjpeg_block, sp, RTjpeg_lb8, RTjpeg_liqt);
-    RTjpeg_idct(bp1+j+8, RTjpeg_block, RTjpeg_width);
-   }
-   if(*sp==-1)sp++;
-   else
-   {
-    sp+=RTjpeg_s2b(RTjpeg_block, sp, RTjpeg_cb8, RTjpeg_ciqt);
-    RTjpeg_idct(bp2+k, RTjpeg_block, RTjpeg_width>>1);
-   }
-   if(*sp==-1)sp++;
-   else
-   {
-    sp+=RTjpeg_s2b(RTjpeg_block, sp, RTjpeg_cb8, RTjpeg_ciqt);
-    RTjpeg_idct(bp3+k, RTjpeg_block, RTjpeg_width>>1);
-   }
+  for(k=0, j=0; j<ctx->width; j+=16, k+=8) {
+   sp=RTjpeg_decompress_block(ctx, block, sp, bp+j, ctx->width, 0);
+   sp=RTjpeg_decompress_block(ctx, block, sp, bp+j+8, ctx->width, 0);
+   sp=RTjpeg_decompress_block(ctx, block, sp, bp2+k, ctx->width>>1, 1);
+   sp=RTjpeg_decompress_block(ctx, block, sp, bp3+k, ctx->width>>1, 1);
   }
-  bp+=RTjpeg_width<<4;
-  bp1+=RTjpeg_width<<4;
-  bp2+=RTjpeg_width<<2;
-  bp3+=RTjpeg_width<<2;
+  bp+=ctx->width<<3;
+  bp2+=ctx->width<<2;
+  bp3+=ctx->width<<2;
  }
-#ifdef MMX
- emms();
-#endif
 }
 
-void RTjpeg_decompress8(int8_t *sp, uint8_t *bp)
+/* Decode block rows row0..row1-1 (8 lines each) of a grayscale frame */
+
+static void RTjpeg_decode8(RTjpegContext *ctx, int16_t *block, int8_t *sp, uint8_t *bp, int row0, int row1)
 {
  int i, j;
 
-#ifdef MMX
- emms();
-#endif
-
-/* Y */
- for(i=0; i<RTjpeg_height; i+=8)
+ bp+=row0*(ctx->width<<3);
+ for(i=row0; i<row1; i++)
  {
-  for(j=0; j<RTjpeg_width; j+=8)
-   if(*sp==-1)sp++;
-   else
-   {
-    sp+=RTjpeg_s2b(RTjpeg_block, sp, RTjpeg_lb8, RTjpeg_liqt);
-    RTjpeg_idct(bp+j, RTjpeg_block, RTjpeg_width);
-   }
-  bp+=RTjpeg_width<<3;
+  for(j=0; j<ctx->width; j+=8)
+   sp=RTjpeg_decompress_block(ctx, block, sp, bp+j, ctx->width, 0);
+  bp+=ctx->width<<3;
  }
 }
 
+void RTjpeg_decompressYUV420(RTjpegContext *ctx, int8_t *sp, uint8_t *bp)
+{
+ RTjpeg_decode(ctx, RTjpeg_decode420, sp, bp, ctx->height>>4, ((ctx->width+15)>>4)*6);
+}
+
+void RTjpeg_decompressYUV422(RTjpegContext *ctx, int8_t *sp, uint8_t *bp)
+{
+ RTjpeg_decode(ctx, RTjpeg_decode422, sp, bp, ctx->height>>3, ((ctx->width+15)>>4)*4);
+}
+
+void RTjpeg_decompress8(RTjpegContext *ctx, int8_t *sp, uint8_t *bp)
+{
+ RTjpeg_decode(ctx, RTjpeg_decode8, sp, bp, (ctx->height+7)>>3, (ctx->width+7)>>3);
+}
+
+/*************************************************************************/
+
 /*
 External Function
 
 Initialise additional data structures for motion compensation
 
-*/
-
-void RTjpeg_init_mcompress(void)
-{
- unsigned long tmp;
-
- if(!RTjpeg_old)
- {
-  RTjpeg_old=malloc((4*RTjpeg_width*RTjpeg_height)+32);
-  tmp=(unsigned long)RTjpeg_old;
-  tmp+=32;
-  tmp=tmp>>5;
-  RTjpeg_old=(int16_t *)(tmp<<5);
- }
- if (!RTjpeg_old)
- {
-  fprintf(stderr, "RTjpeg: Could not allocate memory\n");
-  exit(-1);
- }
- bzero(RTjpeg_old, ((4*RTjpeg_width*RTjpeg_height)));
-}
+Returns nonzero on success, zero if out of memory.
 
-#ifdef MMX
+*/
 
-static int RTjpeg_bcomp(int16_t *old, mmx_t *mask)
+int RTjpeg_init_mcompress(RTjpegContext *ctx)
 {
- int i;
- mmx_t *mold=(mmx_t *)old;
- mmx_t *mblock=(mmx_t *)RTjpeg_block;
- volatile mmx_t result;
- static mmx_t neg=(mmx_t)(unsigned long long)0xffffffffffffffffULL;
-
- movq_m2r(*mask, mm7);
- movq_m2r(neg, mm6);
- pxor_r2r(mm5, mm5);
+ int size=4*ctx->width*ctx->height;
 
- for(i=0; i<8; i++)
+ if(ctx->old && ctx->old_size!=size)
  {
-  movq_m2r(*(mblock++), mm0);
-  			movq_m2r(*(mblock++), mm2);
-  movq_m2r(*(mold++), mm1);
-  			movq_m2r(*(mold++), mm3);
-  psubsw_r2r(mm1, mm0);
-  			psubsw_r2r(mm3, mm2);
-  movq_r2r(mm0, mm1);
-  			movq_r2r(mm2, mm3);
-  pcmpgtw_r2r(mm7, mm0);
-  			pcmpgtw_r2r(mm7, mm2);
-  pxor_r2r(mm6, mm1);
-  			pxor_r2r(mm6, mm3);
-  pcmpgtw_r2r(mm7, mm1);
-  			pcmpgtw_r2r(mm7, mm3);
-  por_r2r(mm0, mm5);
-  			por_r2r(mm2, mm5);
-  por_r2r(mm1, mm5);
-  			por_r2r(mm3, mm5);
+  free(ctx->old);
+  ctx->old=NULL;
  }
- movq_r2m(mm5, result);
-
- if(result.q)
+ if(!ctx->old)
  {
-//  if(!RTjpeg_mtest)
-//   for(i=0; i<16; i++)((uint64_t *)old)[i]=((uint64_t *)RTjpeg_block)[i];
-  return 0;
+  ctx->old=malloc(size);
+  if(!ctx->old)
+   return 0;
+  ctx->old_size=size;
  }
+ memset(ctx->old, 0, size);
  return 1;
 }
 
-#else
-static int RTjpeg_bcomp(int16_t *old, uint16_t *mask)
+static int RTjpeg_bcomp(RTjpegContext *ctx, int16_t *old, uint16_t *mask)
 {
  int i;
 
  for(i=0; i<64; i++)
-  if(abs(old[i]-RTjpeg_block[i])>*mask)
+  if(abs(old[i]-ctx->block[i])>*mask)
   {
-   if(!RTjpeg_mtest)
-    for(i=0; i<16; i++)((uint64_t *)old)[i]=((uint64_t *)RTjpeg_block)[i];
+   if(!ctx->mtest)
+    memcpy(old, ctx->block, sizeof(ctx->block));
    return 0;
   }
  return 1;
 }
-#endif
 
-void RTjpeg_set_test(int i)
+void RTjpeg_set_test(RTjpegContext *ctx, int i)
+{
+ ctx->mtest=i;
+}
+
+/* Code one block, or mark it unchanged (255) if it is within the mask of
+   the block coded in its place last time */
+
+static inline int RTjpeg_mcompress_block(RTjpegContext *ctx, int8_t *sp, uint8_t *bp, int rskip, int16_t *old, int chroma)
 {
- RTjpeg_mtest=i;
+ ctx->dctY(bp, ctx->block, rskip);
+ ctx->quant(ctx->block, chroma ? ctx->cqt : ctx->lqt);
+ if(RTjpeg_bcomp(ctx, old, chroma ? &ctx->cmask : &ctx->lmask))
+ {
+  *((uint8_t *)sp)=255;
+  return 1;
+ }
+ return RTjpeg_b2s(ctx->block, sp, chroma ? ctx->cb8 : ctx->lb8);
 }
 
-int RTjpeg_mcompressYUV420(int8_t *sp, unsigned char *bp, uint16_t lmask, uint16_t cmask)
+int RTjpeg_mcompressYUV420(RTjpegContext *ctx, int8_t *sp, unsigned char *bp, uint16_t lmask, uint16_t cmask)
 {
  int8_t * sb;
-//rh int16_t *block;
- register int8_t * bp1 = bp + (RTjpeg_width<<3);
- register int8_t * bp2 = bp + RTjpeg_Ysize;
- register int8_t * bp3 = bp2 + (RTjpeg_Csize>>1);
- register int i, j, k;
-
-#ifdef MMX
- emms();
- RTjpeg_lmask=(mmx_t)(((uint64_t)lmask<<48)|((uint64_t)lmask<<32)|((uint64_t)lmask<<16)|lmask);
- RTjpeg_cmask=(mmx_t)(((uint64_t)cmask<<48)|((uint64_t)cmask<<32)|((uint64_t)cmask<<16)|cmask);
-#else
- RTjpeg_lmask=lmask;
- RTjpeg_cmask=cmask;
-#endif
+ int16_t *block;
+ uint8_t * bp1 = bp + (ctx->width<<3);
+ uint8_t * bp2 = bp + ctx->Ysize;
+ uint8_t * bp3 = bp2 + (ctx->Csize>>1);
+ int i, j, k;
+
+ ctx->lmask=lmask;
+ ctx->cmask=cmask;
 
  sb=sp;
- block=RTjpeg_old;
+ block=ctx->old;
 /* Y */
- for(i=RTjpeg_height>>1; i; i-=8)
+ for(i=ctx->height>>1; i; i-=8)
  {
-  for(j=0, k=0; j<RTjpeg_width; j+=16, k+=8)
+  for(j=0, k=0; j<ctx->width; j+=16, k+=8)
   {
-   RTjpeg_dctY(bp+j, RTjpeg_block, RTjpeg_Ywidth);
-   RTjpeg_quant(RTjpeg_block, RTjpeg_lqt);
-   if(RTjpeg_bcomp(block, &RTjpeg_lmask))
-   {
-    *((uint8_t *)sp++)=255;
-   }
-	else sp+=RTjpeg_b2s(RTjpeg_block, sp, RTjpeg_lb8);
+   sp+=RTjpeg_mcompress_block(ctx, sp, bp+j, ctx->Ywidth, block, 0);
    block+=64;
-
-   RTjpeg_dctY(bp+j+8, RTjpeg_block, RTjpeg_Ywidth);
-   RTjpeg_quant(RTjpeg_block, RTjpeg_lqt);
-   if(RTjpeg_bcomp(block, &RTjpeg_lmask))
-   {
-    *((uint8_t *)sp++)=255;
-   }
-	else sp+=RTjpeg_b2s(RTjpeg_block, sp, RTjpeg_lb8);
+   sp+=RTjpeg_mcompress_block(ctx, sp, bp+j+8, ctx->Ywidth, block, 0);
    block+=64;
-
-   RTjpeg_dctY(bp1+j, RTjpeg_block, RTjpeg_Ywidth);
-   RTjpeg_quant(RTjpeg_block, RTjpeg_lqt);
-   if(RTjpeg_bcomp(block, &RTjpeg_lmask))
-   {
-    *((uint8_t *)sp++)=255;
-   }
-	else sp+=RTjpeg_b2s(RTjpeg_block, sp, RTjpeg_lb8);
+   sp+=RTjpeg_mcompress_block(ctx, sp, bp1+j, ctx->Ywidth, block, 0);
    block+=64;
-
-   RTjpeg_dctY(bp1+j+8, RTjpeg_block, RTjpeg_Ywidth);
-   RTjpeg_quant(RTjpeg_block, RTjpeg_lqt);
-   if(RTjpeg_bcomp(block, &RTjpeg_lmask))
-   {
-    *((uint8_t *)sp++)=255;
-   }
-	else sp+=RTjpeg_b2s(RTjpeg_block, sp, RTjpeg_lb8);
+   sp+=RTjpeg_mcompress_block(ctx, sp, bp1+j+8, ctx->Ywidth, block, 0);
    block+=64;
-
-   RTjpeg_dctY(bp2+k, RTjpeg_block, RTjpeg_Cwidth);
-   RTjpeg_quant(RTjpeg_block, RTjpeg_cqt);
-   if(RTjpeg_bcomp(block, &RTjpeg_cmask))
-   {
-    *((uint8_t *)sp++)=255;
-   }
-	else sp+=RTjpeg_b2s(RTjpeg_block, sp, RTjpeg_cb8);
+   sp+=RTjpeg_mcompress_block(ctx, sp, bp2+k, ctx->Cwidth, block, 1);
    block+=64;
-
-   RTjpeg_dctY(bp3+k, RTjpeg_block, RTjpeg_Cwidth);
-   RTjpeg_quant(RTjpeg_block, RTjpeg_cqt);
-   if(RTjpeg_bcomp(block, &RTjpeg_cmask))
-   {
-    *((uint8_t *)sp++)=255;
-   }
-	else sp+=RTjpeg_b2s(RTjpeg_block, sp, RTjpeg_cb8);
+   sp+=RTjpeg_mcompress_block(ctx, sp, bp3+k, ctx->Cwidth, block, 1);
    block+=64;
   }
-  bp+=RTjpeg_width<<4;
-  bp1+=RTjpeg_width<<4;
-  bp2+=RTjpeg_width<<2;
-  bp3+=RTjpeg_width<<2;
+  bp+=ctx->width<<4;
+  bp1+=ctx->width<<4;
+  bp2+=ctx->width<<2;
+  bp3+=ctx->width<<2;
 
  }
-#ifdef MMX
- emms();
-#endif
  return (sp-sb);
 }
 
 
-int RTjpeg_mcompressYUV422(int8_t *sp, unsigned char *bp, uint16_t lmask, uint16_t cmask)
+int RTjpeg_mcompressYUV422(RTjpegContext *ctx, int8_t *sp, unsigned char *bp, uint16_t lmask, uint16_t cmask)
 {
  int8_t * sb;
  int16_t *block;
- register int8_t * bp2;
- register int8_t * bp3;
- register int i, j, k;
-
-#ifdef MMX
- emms();
- RTjpeg_lmask=(mmx_t)(((uint64_t)lmask<<48)|((uint64_t)lmask<<32)|((uint64_t)lmask<<16)|lmask);
- RTjpeg_cmask=(mmx_t)(((uint64_t)cmask<<48)|((uint64_t)cmask<<32)|((uint64_t)cmask<<16)|cmask);
-#else
- RTjpeg_lmask=lmask;
- RTjpeg_cmask=cmask;
-#endif
+ uint8_t * bp2 = bp + ctx->Ysize;
+ uint8_t * bp3 = bp2 + ctx->Csize;
+ int i, j, k;
 
- bp = bp - RTjpeg_width*0;
- bp2 = bp + RTjpeg_Ysize-RTjpeg_width*0;
- bp3 = bp2 + RTjpeg_Csize;
+ ctx->lmask=lmask;
+ ctx->cmask=cmask;
 
  sb=sp;
- block=RTjpeg_old;
+ block=ctx->old;
 /* Y */
- for(i=RTjpeg_height; i; i-=8)
+ for(i=ctx->height; i; i-=8)
  {
-  for(j=0, k=0; j<RTjpeg_width; j+=16, k+=8)
+  for(j=0, k=0; j<ctx->width; j+=16, k+=8)
   {
-   RTjpeg_dctY(bp+j, RTjpeg_block, RTjpeg_Ywidth);
-   RTjpeg_quant(RTjpeg_block, RTjpeg_lqt);
-   if(RTjpeg_bcomp(block, &RTjpeg_lmask))
-   {
-    *((uint8_t *)sp++)=255;
-   }
-	else sp+=RTjpeg_b2s(RTjpeg_block, sp, RTjpeg_lb8);
+   sp+=RTjpeg_mcompress_block(ctx, sp, bp+j, ctx->Ywidth, block, 0);
    block+=64;
-
-   RTjpeg_dctY(bp+j+8, RTjpeg_block, RTjpeg_Ywidth);
-   RTjpeg_quant(RTjpeg_block, RTjpeg_lqt);
-   if(RTjpeg_bcomp(block, &RTjpeg_lmask))
-   {
-    *((uint8_t *)sp++)=255;
-   }
-	else sp+=RTjpeg_b2s(RTjpeg_block, sp, RTjpeg_lb8);
+   sp+=RTjpeg_mcompress_block(ctx, sp, bp+j+8, ctx->Ywidth, block, 0);
    block+=64;
-
-   RTjpeg_dctY(bp2+k, RTjpeg_block, RTjpeg_Cwidth);
-   RTjpeg_quant(RTjpeg_block, RTjpeg_cqt);
-   if(RTjpeg_bcomp(block, &RTjpeg_cmask))
-   {
-    *((uint8_t *)sp++)=255;
-   }
-	else sp+=RTjpeg_b2s(RTjpeg_block, sp, RTjpeg_cb8);
+   sp+=RTjpeg_mcompress_block(ctx, sp, bp2+k, ctx->Cwidth, block, 1);
    block+=64;
-
-   RTjpeg_dctY(bp3+k, RTjpeg_block, RTjpeg_Cwidth);
-   RTjpeg_quant(RTjpeg_block, RTjpeg_cqt);
-   if(RTjpeg_bcomp(block, &RTjpeg_cmask))
-   {
-    *((uint8_t *)sp++)=255;
-   }
-	else sp+=RTjpeg_b2s(RTjpeg_block, sp, RTjpeg_cb8);
+   sp+=RTjpeg_mcompress_block(ctx, sp, bp3+k, ctx->Cwidth, block, 1);
    block+=64;
-
   }
-  bp+=RTjpeg_width<<3;
-  bp2+=RTjpeg_width<<2;
-  bp3+=RTjpeg_width<<2;
+  bp+=ctx->width<<3;
+  bp2+=ctx->width<<2;
+  bp3+=ctx->width<<2;
  }
-#ifdef MMX
- emms();
-#endif
  return (sp-sb);
 }
 
-int RTjpeg_mcompress8(int8_t *sp, unsigned char *bp, uint16_t lmask)
+int RTjpeg_mcompress8(RTjpegContext *ctx, int8_t *sp, unsigned char *bp, uint16_t lmask)
 {
  int8_t * sb;
  int16_t *block;
  int i, j;
 
-#ifdef MMX
- emms();
- RTjpeg_lmask=(mmx_t)(((uint64_t)lmask<<48)|((uint64_t)lmask<<32)|((uint64_t)lmask<<16)|lmask);
-#else
- RTjpeg_lmask=lmask;
-#endif
+ ctx->lmask=lmask;
 
 
  sb=sp;
- block=RTjpeg_old;
+ block=ctx->old;
 /* Y */
- for(i=0; i<RTjpeg_height; i+=8)
+ for(i=0; i<ctx->height; i+=8)
  {
-  for(j=0; j<RTjpeg_width; j+=8)
+  for(j=0; j<ctx->width; j+=8)
   {
-   RTjpeg_dctY(bp+j, RTjpeg_block, RTjpeg_width);
-   RTjpeg_quant(RTjpeg_block, RTjpeg_lqt);
-   if(RTjpeg_bcomp(block, &RTjpeg_lmask))
-   {
-    *((uint8_t *)sp++)=255;
-   } else sp+=RTjpeg_b2s(RTjpeg_block, sp, RTjpeg_lb8);
+   sp+=RTjpeg_mcompress_block(ctx, sp, bp+j, ctx->Ywidth, block, 0);
    block+=64;
   }
-  bp+=RTjpeg_width<<3;
+  bp+=ctx->width<<3;
  }
-#ifdef MMX
- emms();
-#endif
  return (sp-sb);
 }
 
-#if 0  /* unused --AC */
-static void RTjpeg_color_init(void)
-{
-}
-#endif
+/*************************************************************************/
 
 #define KcrR 76284
 #define KcrG 53281
@@ -3422,7 +1886,7 @@ static void RTjpeg_color_init(void)
 #define KcbB 132252
 #define Ky 76284
 
-void RTjpeg_yuv422rgb(uint8_t *buf, uint8_t *rgb, int stride)
+void RTjpeg_yuv422rgb(RTjpegContext *ctx, uint8_t *buf, uint8_t *rgb, int stride)
 {
  int tmp;
  int i, j;
@@ -3430,16 +1894,16 @@ void RTjpeg_yuv422rgb(uint8_t *buf, uint8_t *rgb, int stride)
  uint8_t *bufcr, *bufcb, *bufy, *bufoute;
  int yskip;
 
- yskip=RTjpeg_width;
+ yskip=ctx->width;
 
- bufcb=&buf[RTjpeg_width*RTjpeg_height];
- bufcr=&buf[RTjpeg_width*RTjpeg_height+(RTjpeg_width*RTjpeg_height)/2];
+ bufcb=&buf[ctx->width*ctx->height];
+ bufcr=&buf[ctx->width*ctx->height+(ctx->width*ctx->height)/2];
  bufy=&buf[0];
  bufoute=rgb;
 
- for(i=0; i<(RTjpeg_height); i++)
+ for(i=0; i<(ctx->height); i++)
  {
-  for(j=0; j<RTjpeg_width; j+=2)
+  for(j=0; j<ctx->width; j+=2)
   {
    crR=(*bufcr-128)*KcrR;
    crG=(*(bufcr++)-128)*KcrG;
@@ -3470,7 +1934,7 @@ void RTjpeg_yuv422rgb(uint8_t *buf, uint8_t *rgb, int stride)
 }
 
 
-void RTjpeg_yuv420rgb(uint8_t *buf, uint8_t *rgb, int stride)
+void RTjpeg_yuv420rgb(RTjpegContext *ctx, uint8_t *buf, uint8_t *rgb, int stride)
 {
  int tmp;
  int i, j;
@@ -3479,21 +1943,21 @@ void RTjpeg_yuv420rgb(uint8_t *buf, uint8_t *rgb, int stride)
  int oskip, yskip;
 
  if(stride==0)
- 	oskip=RTjpeg_width*3;
+ 	oskip=ctx->width*3;
  else
- 	oskip=2*stride-RTjpeg_width*3;
+ 	oskip=2*stride-ctx->width*3;
 
- yskip=RTjpeg_width;
+ yskip=ctx->width;
 
- bufcb=&buf[RTjpeg_width*RTjpeg_height];
- bufcr=&buf[RTjpeg_width*RTjpeg_height+(RTjpeg_width*RTjpeg_height)/4];
+ bufcb=&buf[ctx->width*ctx->height];
+ bufcr=&buf[ctx->width*ctx->height+(ctx->width*ctx->height)/4];
  bufy=&buf[0];
  bufoute=rgb;
- bufouto=rgb+RTjpeg_width*3;
+ bufouto=rgb+ctx->width*3;
 
- for(i=0; i<(RTjpeg_height>>1); i++)
+ for(i=0; i<(ctx->height>>1); i++)
  {
-  for(j=0; j<RTjpeg_width; j+=2)
+  for(j=0; j<ctx->width; j+=2)
   {
    crR=(*bufcr-128)*KcrR;
    crG=(*(bufcr++)-128)*KcrG;
@@ -3544,7 +2008,7 @@ void RTjpeg_yuv420rgb(uint8_t *buf, uint8_t *rgb, int stride)
 }
 
 
-void RTjpeg_yuvrgb32(uint8_t *buf, uint8_t *rgb, int stride)
+void RTjpeg_yuvrgb32(RTjpegContext *ctx, uint8_t *buf, uint8_t *rgb, int stride)
 {
  int tmp;
  int i, j;
@@ -3553,20 +2017,20 @@ void RTjpeg_yuvrgb32(uint8_t *buf, uint8_t *rgb, int stride)
  int oskip, yskip;
 
  if(stride==0)
- 	oskip=RTjpeg_width*4;
+ 	oskip=ctx->width*4;
  else
- 	oskip = 2*stride-RTjpeg_width*4;
- yskip=RTjpeg_width;
+ 	oskip = 2*stride-ctx->width*4;
+ yskip=ctx->width;
 
- bufcb=&buf[RTjpeg_width*RTjpeg_height];
- bufcr=&buf[RTjpeg_width*RTjpeg_height+(RTjpeg_width*RTjpeg_height)/2];
+ bufcb=&buf[ctx->width*ctx->height];
+ bufcr=&buf[ctx->width*ctx->height+(ctx->width*ctx->height)/2];
  bufy=&buf[0];
  bufoute=rgb;
- bufouto=rgb+RTjpeg_width*4;
+ bufouto=rgb+ctx->width*4;
 
- for(i=0; i<(RTjpeg_height>>1); i++)
+ for(i=0; i<(ctx->height>>1); i++)
  {
-  for(j=0; j<RTjpeg_width; j+=2)
+  for(j=0; j<ctx->width; j+=2)
   {
    crR=(*bufcr-128)*KcrR;
    crG=(*(bufcr++)-128)*KcrG;
@@ -3620,7 +2084,7 @@ void RTjpeg_yuvrgb32(uint8_t *buf, uint8_t *rgb, int stride)
  }
 }
 
-void RTjpeg_yuvrgb24(uint8_t *buf, uint8_t *rgb, int stride)
+void RTjpeg_yuvrgb24(RTjpegContext *ctx, uint8_t *buf, uint8_t *rgb, int stride)
 {
  int tmp;
  int i, j;
@@ -3629,21 +2093,21 @@ void RTjpeg_yuvrgb24(uint8_t *buf, uint8_t *rgb, int stride)
  int oskip, yskip;
 
  if(stride==0)
- 	oskip=RTjpeg_width*3;
+ 	oskip=ctx->width*3;
  else
- 	oskip=2*stride - RTjpeg_width*3;
+ 	oskip=2*stride - ctx->width*3;
 
- yskip=RTjpeg_width;
+ yskip=ctx->width;
 
- bufcb=&buf[RTjpeg_width*RTjpeg_height];
- bufcr=&buf[RTjpeg_width*RTjpeg_height+(RTjpeg_width*RTjpeg_height)/4];
+ bufcb=&buf[ctx->width*ctx->height];
+ bufcr=&buf[ctx->width*ctx->height+(ctx->width*ctx->height)/4];
  bufy=&buf[0];
  bufoute=rgb;
- bufouto=rgb+RTjpeg_width*3;
+ bufouto=rgb+ctx->width*3;
 
- for(i=0; i<(RTjpeg_height>>1); i++)
+ for(i=0; i<(ctx->height>>1); i++)
  {
-  for(j=0; j<RTjpeg_width; j+=2)
+  for(j=0; j<ctx->width; j+=2)
   {
    crR=(*bufcr-128)*KcrR;
    crG=(*(bufcr++)-128)*KcrG;
@@ -3693,7 +2157,7 @@ void RTjpeg_yuvrgb24(uint8_t *buf, uint8_t *rgb, int stride)
  }
 }
 
-void RTjpeg_yuvrgb16(uint8_t *buf, uint8_t *rgb, int stride)
+void RTjpeg_yuvrgb16(RTjpegContext *ctx, uint8_t *buf, uint8_t *rgb, int stride)
 {
  int tmp;
  int i, j;
@@ -3703,21 +2167,21 @@ void RTjpeg_yuvrgb16(uint8_t *buf, uint8_t *rgb, int stride)
  unsigned char r, g, b;
 
  if(stride==0)
- 	oskip=RTjpeg_width*2;
+ 	oskip=ctx->width*2;
  else
- 	oskip=2*stride-RTjpeg_width*2;
+ 	oskip=2*stride-ctx->width*2;
 
- yskip=RTjpeg_width;
+ yskip=ctx->width;
 
- bufcb=&buf[RTjpeg_width*RTjpeg_height];
- bufcr=&buf[RTjpeg_width*RTjpeg_height+(RTjpeg_width*RTjpeg_height)/4];
+ bufcb=&buf[ctx->width*ctx->height];
+ bufcr=&buf[ctx->width*ctx->height+(ctx->width*ctx->height)/4];
  bufy=&buf[0];
  bufoute=rgb;
- bufouto=rgb+RTjpeg_width*2;
+ bufouto=rgb+ctx->width*2;
 
- for(i=0; i<(RTjpeg_height>>1); i++)
+ for(i=0; i<(ctx->height>>1); i++)
  {
-  for(j=0; j<RTjpeg_width; j+=2)
+  for(j=0; j<ctx->width; j+=2)
   {
    crR=(*bufcr-128)*KcrR;
    crG=(*(bufcr++)-128)*KcrG;
@@ -3790,8 +2254,8 @@ void RTjpeg_yuvrgb16(uint8_t *buf, uint8_t *rgb, int stride)
 
 /* fix stride */
 
-void RTjpeg_yuvrgb8(uint8_t *buf, uint8_t *rgb, int stride)
+void RTjpeg_yuvrgb8(RTjpegContext *ctx, uint8_t *buf, uint8_t *rgb, int stride)
 {
- bcopy(buf, rgb, RTjpeg_width*RTjpeg_height);
+ memcpy(rgb, buf, ctx->width*ctx->height);
 }
 
@@ -28,27 +28,43 @@
 
 #include <stdint.h>
 
-extern void RTjpeg_init_Q(uint8_t Q);
-extern void RTjpeg_init_compress(uint32_t *buf, int width, int height, uint8_t Q);
-extern void RTjpeg_init_decompress(uint32_t *buf, int width, int height);
-extern int RTjpeg_compressYUV420(int8_t *sp, unsigned char *bp);
-extern int RTjpeg_compressYUV422(int8_t *sp, unsigned char *bp);
-extern void RTjpeg_decompressYUV420(int8_t *sp, uint8_t *bp);
-extern void RTjpeg_decompressYUV422(int8_t *sp, uint8_t *bp);
-extern int RTjpeg_compress8(int8_t *sp, unsigned char *bp);
-extern void RTjpeg_decompress8(int8_t *sp, uint8_t *bp);
-
-extern void RTjpeg_init_mcompress(void);
-extern int RTjpeg_mcompressYUV420(int8_t *sp, unsigned char *bp, uint16_t lmask, uint16_t cmask);
-extern int RTjpeg_mcompressYUV422(int8_t *sp, unsigned char *bp, uint16_t lmask, uint16_t cmask);
-extern int RTjpeg_mcompress8(int8_t *sp, unsigned char *bp, uint16_t lmask);
-extern void RTjpeg_set_test(int i);
-
-extern void RTjpeg_yuv420rgb(uint8_t *buf, uint8_t *rgb, int stride);
-extern void RTjpeg_yuv422rgb(uint8_t *buf, uint8_t *rgb, int stride);
-extern void RTjpeg_yuvrgb8(uint8_t *buf, uint8_t *rgb, int stride);
-extern void RTjpeg_yuvrgb16(uint8_t *buf, uint8_t *rgb, int stride);
-extern void RTjpeg_yuvrgb24(uint8_t *buf, uint8_t *rgb, int stride);
-extern void RTjpeg_yuvrgb32(uint8_t *buf, uint8_t *rgb, int stride);
+/* All codec state (quantisation tables, dimensions, work buffers) lives
+ * in an RTjpegContext, so separate streams can be coded concurrently as
+ * long as each uses its own context.  A context must not be used by more
+ * than one thread at a time. */
+typedef struct RTjpegContext RTjpegContext;
 
+/* Create a context; `accel' is a set of AC_* flags (see aclib/ac.h)
+ * selecting the DCT kernels to use, masked to what the CPU supports.
+ * Returns NULL if out of memory. */
+extern RTjpegContext *RTjpeg_new(int accel);
+extern void RTjpeg_free(RTjpegContext *ctx);
+/* Decode frames in row bands on `threads' threads (the caller's
+ * included); the output does not depend on the number of threads.
+ * Returns nonzero on success, zero if threads could not be started. */
+extern int RTjpeg_set_threads(RTjpegContext *ctx, int threads);
+
+extern void RTjpeg_init_Q(RTjpegContext *ctx, uint8_t Q);
+extern void RTjpeg_init_compress(RTjpegContext *ctx, uint32_t *buf, int width, int height, uint8_t Q);
+extern void RTjpeg_init_decompress(RTjpegContext *ctx, uint32_t *buf, int width, int height);
+extern int RTjpeg_compressYUV420(RTjpegContext *ctx, int8_t *sp, unsigned char *bp);
+extern int RTjpeg_compressYUV422(RTjpegContext *ctx, int8_t *sp, unsigned char *bp);
+extern void RTjpeg_decompressYUV420(RTjpegContext *ctx, int8_t *sp, uint8_t *bp);
+extern void RTjpeg_decompressYUV422(RTjpegContext *ctx, int8_t *sp, uint8_t *bp);
+extern int RTjpeg_compress8(RTjpegContext *ctx, int8_t *sp, unsigned char *bp);
+extern void RTjpeg_decompress8(RTjpegContext *ctx, int8_t *sp, uint8_t *bp);
+
+/* Returns nonzero on success, zero if out of memory. */
+extern int RTjpeg_init_mcompress(RTjpegContext *ctx);
+extern int RTjpeg_mcompressYUV420(RTjpegContext *ctx, int8_t *sp, unsigned char *bp, uint16_t lmask, uint16_t cmask);
+extern int RTjpeg_mcompressYUV422(RTjpegContext *ctx, int8_t *sp, unsigned char *bp, uint16_t lmask, uint16_t cmask);
+extern int RTjpeg_mcompress8(RTjpegContext *ctx, int8_t *sp, unsigned char *bp, uint16_t lmask);
+extern void RTjpeg_set_test(RTjpegContext *ctx, int i);
+
+extern void RTjpeg_yuv420rgb(RTjpegContext *ctx, uint8_t *buf, uint8_t *rgb, int stride);
+extern void RTjpeg_yuv422rgb(RTjpegContext *ctx, uint8_t *buf, uint8_t *rgb, int stride);
+extern void RTjpeg_yuvrgb8(RTjpegContext *ctx, uint8_t *buf, uint8_t *rgb, int stride);
+extern void RTjpeg_yuvrgb16(RTjpegContext *ctx, uint8_t *buf, uint8_t *rgb, int stride);
+extern void RTjpeg_yuvrgb24(RTjpegContext *ctx, uint8_t *buf, uint8_t *rgb, int stride);
+extern void RTjpeg_yuvrgb32(RTjpegContext *ctx, uint8_t *buf, uint8_t *rgb, int stride);
 
@@ -43,6 +43,7 @@ typedef struct {
     double audiofrac;    // Saved fractional position (for resampling)
     uint32_t cdata[128]; // Compressor data (from DR frame)
     int dec_initted;     // Decompressor initted?
+    RTjpegContext *rtjpeg;  // RTjpeg decoder state
 
     // Previous video frame, for frame cloning
     uint8_t saved_vframe[TC_MAX_V_FRAME_WIDTH*TC_MAX_V_FRAME_HEIGHT*3];
@@ -81,6 +82,20 @@ static int nuv_init(TCModuleInstance *self, uint32_t features)
     pd->fd = -1;
     pd->dec_initted = 0;
 
+    pd->rtjpeg = RTjpeg_new(tc_accel);
+    if (!pd->rtjpeg) {
+        tc_log_error(MOD_NAME, "init: out of memory!");
+        tc_free(pd);
+        self->userdata = NULL;
+        return TC_ERROR;
+    }
+    if (tc_slice_threads > 1
+     && !RTjpeg_set_threads(pd->rtjpeg, tc_slice_threads)
+    ) {
+        tc_log_warn(MOD_NAME, "init: unable to start decoding threads,"
+                    " decoding in a single thread");
+    }
+
     if (verbose) {
         tc_log_info(MOD_NAME, "%s %s", MOD_VERSION, MOD_CAP);
     }
@@ -108,6 +123,7 @@ static int nuv_fini(TCModuleInstance *self)
         pd->fd = -1;
     }
 
+    RTjpeg_free(pd->rtjpeg);
     tc_free(self->userdata);
     self->userdata = NULL;
     return TC_OK;
@@ -457,7 +473,8 @@ static int nuv_decode_video(TCModuleInstance *self,
     if (!pd->dec_initted) {
         pd->width  = inframe->video_buf[0]<<8 | inframe->video_buf[1];
         pd->height = inframe->video_buf[2]<<8 | inframe->video_buf[3];
-        RTjpeg_init_decompress((uint32_t *)(inframe->video_buf+5),
+        RTjpeg_init_decompress(pd->rtjpeg,
+                               (uint32_t *)(inframe->video_buf+5),
                                pd->width, pd->height);
         pd->dec_initted = 1;
     }
@@ -499,7 +516,8 @@ static int nuv_decode_video(TCModuleInstance *self,
         break;
 
       case '1':  // RTjpeg-compressed data
-        RTjpeg_decompressYUV420((int8_t *)encoded_frame, outframe->video_buf);
+        RTjpeg_decompressYUV420(pd->rtjpeg, (int8_t *)encoded_frame,
+                                outframe->video_buf);
         break;
 
       case 'N':  // Black frame
@@ -37,6 +37,12 @@
 
 #include "probe_stream.h"
 
+/*
+ * The routines also run as in-process pipeline stages (decode_a52,
+ * decode_mp2, decode_mp3, decode_mpeg2, extract_ac3, extract_mp3,
+ * extract_mpeg2 and extract_pcm; see tcpipeline_stages.c) must not close
+ * fd_in or fd_out, which belong to the caller.
+ */
 
 void decode_mpeg2(decode_t *decode);
 void decode_a52(decode_t *decode);
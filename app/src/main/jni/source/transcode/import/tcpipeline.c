@@ -0,0 +1,586 @@
+/*
+ * tcpipeline.c -- in-process replacement for popen()ed import pipelines
+ *                 ("tccat ... | tcextract ... | tcdecode ...").
+ *
+ * This file is part of transcode, a video stream processing tool.
+ *
+ * transcode is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * transcode is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "transcode.h"
+#include "libtc/libtc.h"
+#include "ioaux.h"
+#include "tcpipeline.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+
+#define MOD_NAME    "tcpipeline"
+
+/* Limits on the size of a command line handled in-process; anything
+ * larger goes to popen(). */
+#define PIPELINE_MAX_STAGES     16
+#define PIPELINE_MAX_ARGS       64
+
+/* tccat seeks in units of DVD sectors. */
+#define DVD_VIDEO_LB_LEN        2048
+
+/*************************************************************************/
+
+typedef struct tcpipelinestage_ TCPipelineStage;
+struct tcpipelinestage_ {
+    const TCPipelineBuiltin *builtin;  /* NULL if run as a program */
+    void *data;                        /* builtin's private data */
+    int fd_in, fd_out;                 /* -1 once closed */
+    int own_in;                        /* fd_in belongs to the pipeline? */
+    pthread_t thread;
+    pid_t pid;
+    int status;                        /* exit code */
+};
+
+typedef struct tcpipeline_ TCPipeline;
+struct tcpipeline_ {
+    TCPipeline *next;
+    FILE *stream;                      /* stream returned to the caller */
+    int popened;                       /* stream came from popen()? */
+    int nstages;
+    TCPipelineStage stages[PIPELINE_MAX_STAGES];
+};
+
+/* Open pipelines, for looking up streams in tc_pipeline_close(). */
+static TCPipeline *pipelines = NULL;
+static pthread_mutex_t pipelines_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/* Stage run by the current thread, for import_exit(). */
+static pthread_key_t stage_key;
+static pthread_once_t stage_key_once = PTHREAD_ONCE_INIT;
+
+/*************************************************************************/
+/*************************************************************************/
+
+/* Internal helper routines. */
+
+/*************************************************************************/
+
+static void create_stage_key(void)
+{
+    pthread_key_create(&stage_key, NULL);
+}
+
+/*************************************************************************/
+
+/**
+ * split_cmdline:  Split a pipeline command line in place into stages and
+ * arguments.  Only whitespace, double quotes and "|" are interpreted;
+ * any other character with a special meaning to the shell makes the
+ * command line unsuitable.
+ *
+ * Parameters:
+ *        buf: Command line (modified).
+ *       args: Receives the NULL-terminated argument vector of each stage.
+ *      nargs: Receives the argument count of each stage.
+ * Return value:
+ *     Number of stages, or zero if the command line needs the shell.
+ */
+
+static int split_cmdline(char *buf,
+                         char *args[PIPELINE_MAX_STAGES][PIPELINE_MAX_ARGS+1],
+                         int nargs[PIPELINE_MAX_STAGES])
+{
+    const char *s = buf;
+    char *d = buf;
+    int nstages = 0;
+    char c;
+
+    nargs[0] = 0;
+    for (;;) {
+        while (*s == ' ' || *s == '\t') {
+            s++;
+        }
+        c = *s;
+        if (c != '|' && c != 0) {
+            if (nargs[nstages] == PIPELINE_MAX_ARGS) {
+                return 0;
+            }
+            args[nstages][nargs[nstages]++] = d;
+            while (*s != 0 && *s != ' ' && *s != '\t' && *s != '|') {
+                if (*s == '"') {
+                    for (s++; *s != '"'; s++) {
+                        if (*s == 0 || strchr("$`\\", *s) != NULL) {
+                            return 0;
+                        }
+                        *d++ = *s;
+                    }
+                    s++;
+                } else if (strchr("\\'<>&;$`(){}[]*?~#!=\n", *s) != NULL) {
+                    return 0;
+                } else {
+                    *d++ = *s++;
+                }
+            }
+            /* The terminator may overwrite the separator, so look at it
+             * first. */
+            c = *s;
+            *d++ = 0;
+            if (c != '|' && c != 0) {
+                s++;
+                continue;
+            }
+        }
+
+        /* End of a stage */
+        if (nargs[nstages] == 0) {
+            return 0;
+        }
+        args[nstages][nargs[nstages]] = NULL;
+        nstages++;
+        if (c == 0) {
+            return nstages;
+        }
+        s++;
+        if (nstages == PIPELINE_MAX_STAGES) {
+            return 0;
+        }
+        nargs[nstages] = 0;
+    }
+}
+
+/*************************************************************************/
+
+/**
+ * open_tccat:  If a tccat stage only copies a plain file (optionally
+ * starting some number of DVD sectors in), open and position the file
+ * so the next stage can read it directly.
+ *
+ * Parameters:
+ *     argc, argv: The tccat stage's arguments.
+ * Return value:
+ *     File descriptor for the next stage to read from, or -1 if the
+ *     tccat program must be run.
+ */
+
+static int open_tccat(int argc, char **argv)
+{
+    const char *name = NULL;
+    int index = 1, offset = 0, opt, fd;
+    char *arg;
+    struct stat st;
+
+    while ((opt = tc_pipeline_getopt(argc, argv, "S:d:i:t:a",
+                                     &index, &arg)) != -1) {
+        switch (opt) {
+          case 'i':
+            name = arg;
+            break;
+          case 'S':
+            offset = atoi(arg);
+            break;
+          case 't':
+            if (strcmp(arg, "dvd") == 0) {
+                return -1;
+            }
+            break;
+          case 'd':  /* fall through */
+          case 'a':  /* only meaningful for directories */
+            break;
+          default:
+            return -1;
+        }
+    }
+    if (index < argc || name == NULL
+     || stat(name, &st) != 0 || !S_ISREG(st.st_mode)
+    ) {
+        return -1;
+    }
+
+    fd = open(name, O_RDONLY);
+    if (fd < 0) {
+        return -1;
+    }
+    fcntl(fd, F_SETFD, FD_CLOEXEC);
+    if (offset > 0
+     && lseek(fd, offset * (off_t)DVD_VIDEO_LB_LEN, SEEK_SET)
+            != offset * (off_t)DVD_VIDEO_LB_LEN
+    ) {
+        /* As tccat: warn and deliver nothing. */
+        tc_log_warn(MOD_NAME, "unable to seek to block %d", offset);
+        lseek(fd, 0, SEEK_END);
+    }
+    return fd;
+}
+
+/*************************************************************************/
+
+/**
+ * close_stage_fds:  Close a stage's descriptors, shutting down the
+ * sockets first so that its neighbours see end-of-stream (or a broken
+ * pipe) even if the stage leaked a duplicate of either descriptor.
+ *
+ * Parameters:
+ *     stage: Pipeline stage.
+ * Return value:
+ *     None.
+ */
+
+static void close_stage_fds(TCPipelineStage *stage)
+{
+    if (stage->fd_out >= 0) {
+        shutdown(stage->fd_out, SHUT_WR);
+        close(stage->fd_out);
+        stage->fd_out = -1;
+    }
+    if (stage->own_in && stage->fd_in >= 0) {
+        shutdown(stage->fd_in, SHUT_RD);  /* fails harmlessly on files */
+        close(stage->fd_in);
+    }
+    stage->fd_in = -1;
+}
+
+/*************************************************************************/
+
+/**
+ * stage_cleanup, stage_thread:  Thread routine for a builtin stage, and
+ * the cleanup handler run when it returns or calls import_exit().
+ */
+
+static void stage_cleanup(void *arg)
+{
+    TCPipelineStage *stage = arg;
+
+    close_stage_fds(stage);
+    stage->builtin->release(stage->data);
+    stage->data = NULL;
+}
+
+static void *stage_thread(void *arg)
+{
+    TCPipelineStage *stage = arg;
+
+    pthread_setspecific(stage_key, stage);
+    pthread_cleanup_push(stage_cleanup, stage);
+    stage->builtin->run(stage->data, stage->fd_in, stage->fd_out);
+    pthread_cleanup_pop(1);
+    return NULL;
+}
+
+/*************************************************************************/
+
+/**
+ * start_stage:  Start a pipeline stage, in-process if a builtin accepts
+ * it, otherwise as a program.  stage->fd_in, stage->own_in and
+ * stage->fd_out must be set.
+ *
+ * Parameters:
+ *        stage: Pipeline stage.
+ *   argc, argv: The stage's arguments.
+ *     builtins: Builtins that may be used (may be NULL).
+ * Return value:
+ *     Nonzero on success, zero on failure.
+ */
+
+static int start_stage(TCPipelineStage *stage, int argc, char **argv,
+                       const TCPipelineBuiltin * const *builtins)
+{
+    int i;
+
+    for (i = 0; builtins != NULL && builtins[i] != NULL; i++) {
+        if (strcmp(builtins[i]->name, argv[0]) == 0) {
+            stage->data = builtins[i]->prepare(argc, argv);
+            if (stage->data != NULL) {
+                stage->builtin = builtins[i];
+            }
+            break;
+        }
+    }
+
+    if (stage->builtin != NULL) {
+        sigset_t sigpipe, oldmask;
+        int err;
+
+        /* Writes to a closed pipeline must fail with EPIPE rather than
+         * signal the whole process; the mask is inherited by the new
+         * thread. */
+        sigemptyset(&sigpipe);
+        sigaddset(&sigpipe, SIGPIPE);
+        pthread_sigmask(SIG_BLOCK, &sigpipe, &oldmask);
+        err = pthread_create(&stage->thread, NULL, stage_thread, stage);
+        pthread_sigmask(SIG_SETMASK, &oldmask, NULL);
+        if (err == 0) {
+            return 1;
+        }
+        tc_log_warn(MOD_NAME, "unable to start %s thread (%s), running"
+                    " the program instead", argv[0], strerror(err));
+        stage->builtin->release(stage->data);
+        stage->builtin = NULL;
+        stage->data = NULL;
+    }
+
+    stage->pid = fork();
+    if (stage->pid < 0) {
+        tc_log_perror(MOD_NAME, "fork");
+        return 0;
+    }
+    if (stage->pid == 0) {
+        if (stage->fd_in != STDIN_FILENO) {
+            dup2(stage->fd_in, STDIN_FILENO);
+        }
+        dup2(stage->fd_out, STDOUT_FILENO);
+        execvp(argv[0], argv);
+        _exit(127);
+    }
+    /* The child has its own copies; these must not be shut down. */
+    close(stage->fd_out);
+    stage->fd_out = -1;
+    if (stage->own_in) {
+        close(stage->fd_in);
+    }
+    stage->fd_in = -1;
+    return 1;
+}
+
+/*************************************************************************/
+
+/**
+ * finish_pipeline:  Wait for all stages of a pipeline to finish and free
+ * it.  The caller's end of the pipeline must already be closed.
+ *
+ * Parameters:
+ *     pipeline: Pipeline to finish.
+ * Return value:
+ *     The exit code of the last stage.
+ */
+
+static int finish_pipeline(TCPipeline *pipeline)
+{
+    int i, status = 0;
+
+    for (i = 0; i < pipeline->nstages; i++) {
+        TCPipelineStage *stage = &pipeline->stages[i];
+
+        if (stage->builtin != NULL) {
+            pthread_join(stage->thread, NULL);
+        } else if (stage->pid > 0) {
+            int wstatus;
+            while (waitpid(stage->pid, &wstatus, 0) < 0 && errno == EINTR)
+                /* nothing */;
+            stage->status = WIFEXITED(wstatus) ? WEXITSTATUS(wstatus) : -1;
+        }
+        status = stage->status;
+    }
+    tc_free(pipeline);
+    return status;
+}
+
+/*************************************************************************/
+/*************************************************************************/
+
+/* External interface. */
+
+/*************************************************************************/
+
+FILE *tc_pipeline_open(const char *cmdline,
+                       const TCPipelineBuiltin * const *builtins)
+{
+    char *args[PIPELINE_MAX_STAGES][PIPELINE_MAX_ARGS+1];
+    int nargs[PIPELINE_MAX_STAGES];
+    TCPipeline *pipeline;
+    char *buf;
+    int nstages, first = 0, fd = STDIN_FILENO, own_fd = 0, i;
+
+    pthread_once(&stage_key_once, create_stage_key);
+
+    pipeline = tc_zalloc(sizeof(*pipeline));
+    buf = tc_strdup(cmdline);
+    if (pipeline == NULL || buf == NULL) {
+        tc_log_error(MOD_NAME, "out of memory");
+        goto fail;
+    }
+
+    nstages = split_cmdline(buf, args, nargs);
+    if (nstages == 0) {
+        pipeline->popened = 1;
+        pipeline->stream = popen(cmdline, "r");
+        if (pipeline->stream == NULL) {
+            goto fail;
+        }
+        goto done;
+    }
+
+    if (strcmp(args[0][0], "tccat") == 0) {
+        int filefd = open_tccat(nargs[0], args[0]);
+        if (filefd >= 0) {
+            fd = filefd;
+            own_fd = 1;
+            first = 1;
+        }
+    }
+
+    for (i = first; i < nstages; i++) {
+        TCPipelineStage *stage = &pipeline->stages[pipeline->nstages];
+        int sv[2];
+
+        if (socketpair(AF_UNIX, SOCK_STREAM, 0, sv) != 0) {
+            tc_log_perror(MOD_NAME, "socketpair");
+            break;
+        }
+        fcntl(sv[0], F_SETFD, FD_CLOEXEC);
+        fcntl(sv[1], F_SETFD, FD_CLOEXEC);
+        stage->fd_in = fd;
+        stage->own_in = own_fd;
+        stage->fd_out = sv[1];
+        fd = sv[0];
+        own_fd = 1;
+        if (!start_stage(stage, nargs[i], args[i], builtins)) {
+            close_stage_fds(stage);
+            break;
+        }
+        pipeline->nstages++;
+    }
+    if (i < nstages) {
+        if (own_fd) {
+            close(fd);
+        }
+        finish_pipeline(pipeline);
+        tc_free(buf);
+        return NULL;
+    }
+
+    pipeline->stream = fdopen(fd, "r");
+    if (pipeline->stream == NULL) {
+        tc_log_perror(MOD_NAME, "fdopen");
+        close(fd);
+        finish_pipeline(pipeline);
+        tc_free(buf);
+        return NULL;
+    }
+
+  done:
+    tc_free(buf);
+    pthread_mutex_lock(&pipelines_lock);
+    pipeline->next = pipelines;
+    pipelines = pipeline;
+    pthread_mutex_unlock(&pipelines_lock);
+    return pipeline->stream;
+
+  fail:
+    tc_free(buf);
+    tc_free(pipeline);
+    return NULL;
+}
+
+/*************************************************************************/
+
+int tc_pipeline_close(FILE *stream)
+{
+    TCPipeline **pptr, *pipeline = NULL;
+
+    if (stream == NULL) {
+        return -1;
+    }
+
+    pthread_mutex_lock(&pipelines_lock);
+    for (pptr = &pipelines; *pptr != NULL; pptr = &(*pptr)->next) {
+        if ((*pptr)->stream == stream) {
+            pipeline = *pptr;
+            *pptr = pipeline->next;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&pipelines_lock);
+
+    if (pipeline == NULL || pipeline->popened) {
+        tc_free(pipeline);
+        return pclose(stream);
+    }
+
+    /* Unblock a last stage still writing. */
+    shutdown(fileno(stream), SHUT_RD);
+    fclose(stream);
+    return finish_pipeline(pipeline);
+}
+
+/*************************************************************************/
+
+int tc_pipeline_getopt(int argc, char **argv, const char *optstring,
+                       int *index, char **arg)
+{
+    const char *opt;
+    char *s;
+
+    if (*index >= argc) {
+        return -1;
+    }
+    s = argv[*index];
+    if (s[0] != '-' || s[1] == 0) {
+        return -1;
+    }
+    (*index)++;
+    if (strcmp(s, "--") == 0) {
+        return -1;
+    }
+
+    opt = strchr(optstring, s[1]);
+    if (opt == NULL || *opt == ':') {
+        return '?';
+    }
+    if (opt[1] != ':') {
+        return s[2] == 0 ? s[1] : '?';
+    }
+    if (s[2] != 0) {
+        *arg = s+2;
+    } else if (*index < argc) {
+        *arg = argv[(*index)++];
+    } else {
+        return '?';
+    }
+    return s[1];
+}
+
+/*************************************************************************/
+
+/**
+ * import_exit:  Exit routine for the extract and decode code (see
+ * ioaux.h).  A builtin pipeline stage only ends its own thread;
+ * otherwise, the process exits as usual.
+ */
+
+void import_exit(int code)
+{
+    TCPipelineStage *stage;
+
+    pthread_once(&stage_key_once, create_stage_key);
+    stage = pthread_getspecific(stage_key);
+    if (stage != NULL) {
+        stage->status = code;
+        pthread_exit(NULL);
+    }
+    exit(code);
+}
+
+/*************************************************************************/
+
+/*
+ * Local variables:
+ *   c-file-style: "stroustrup"
+ *   c-file-offsets: ((case-label . *) (statement-case-intro . *))
+ *   indent-tabs-mode: nil
+ * End:
+ *
+ * vim: expandtab shiftwidth=4:
+ */
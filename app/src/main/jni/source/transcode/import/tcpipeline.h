@@ -0,0 +1,125 @@
+/*
+ * tcpipeline.h -- in-process replacement for popen()ed import pipelines
+ *                 ("tccat ... | tcextract ... | tcdecode ...").
+ *
+ * This file is part of transcode, a video stream processing tool.
+ *
+ * transcode is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * transcode is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef TCPIPELINE_H
+#define TCPIPELINE_H
+
+#include <stdio.h>
+
+/*************************************************************************/
+
+/*
+ * An import pipeline is described by the same command line that used to
+ * be handed to popen().  Each stage naming a program for which a builtin
+ * is available (and which the builtin accepts) runs as a thread inside
+ * the transcode process instead of as a child process; a leading
+ * "tccat -i FILE" on a plain file is dropped altogether, the next stage
+ * reading the file directly.  All other stages are still run as
+ * programs, but are started directly rather than through the shell.
+ * Command lines using any shell syntax besides "|" and double quotes
+ * are handed to popen() unchanged.
+ *
+ * Stages are connected by local sockets, so the number of stages in the
+ * pipeline no longer costs a process each, and a stage which exits early
+ * always delivers end-of-stream to its neighbours.
+ */
+
+typedef struct tcpipelinebuiltin_ TCPipelineBuiltin;
+struct tcpipelinebuiltin_ {
+    /* Name of the program this builtin stands in for. */
+    const char *name;
+    /* Parse the stage's command line (argv[0] is the program name) and
+     * return private data for run(), or NULL if this invocation must be
+     * left to the program itself (unsupported options, or the code that
+     * would run is already in use by another pipeline). */
+    void *(*prepare)(int argc, char **argv);
+    /* Run the stage, reading from fd_in and writing to fd_out; the
+     * descriptors belong to the pipeline and must not be closed.  The
+     * stage may end by calling import_exit(). */
+    void (*run)(void *data, int fd_in, int fd_out);
+    /* Release the data returned by prepare(). */
+    void (*release)(void *data);
+};
+
+/* Builtins for the tcextract and tcdecode programs (tcpipeline_stages.c). */
+extern const TCPipelineBuiltin tc_pipeline_tcextract;
+extern const TCPipelineBuiltin tc_pipeline_tcdecode;
+
+/*************************************************************************/
+
+/*
+ * tc_pipeline_open:  Start the pipeline described by `cmdline' and
+ * return a stream from which its output can be read, like
+ * popen(cmdline, "r").
+ *
+ * Parameters:
+ *      cmdline: Pipeline command line.
+ *     builtins: NULL-terminated array of builtins that may be used, or
+ *               NULL to run every stage as a program.
+ * Return value:
+ *     Stream for reading the pipeline's output, or NULL on error.
+ */
+FILE *tc_pipeline_open(const char *cmdline,
+                       const TCPipelineBuiltin * const *builtins);
+
+/*
+ * tc_pipeline_close:  Close a stream returned by tc_pipeline_open() and
+ * wait for all stages of the pipeline to finish.  Streams returned by
+ * popen() are passed to pclose().
+ *
+ * Parameters:
+ *     stream: Stream to close.
+ * Return value:
+ *     The exit code of the last stage (-1 if it was killed by a signal),
+ *     or the value returned by pclose() for streams from popen().
+ */
+int tc_pipeline_close(FILE *stream);
+
+/*
+ * tc_pipeline_getopt:  Option parser for builtins, since getopt() itself
+ * is not reentrant.  Options with arguments may be given as "-xARG" or
+ * "-x ARG"; options may not be grouped.  Parsing stops at the first
+ * non-option argument or at "--".
+ *
+ * Parameters:
+ *      argc, argv: Arguments to parse.
+ *       optstring: Options, as for getopt().
+ *           index: Index of the next argument (initially 1; updated).
+ *             arg: Receives the option's argument, if any.
+ * Return value:
+ *     The option character, '?' for an unknown option or a missing
+ *     argument, or -1 at the end of the options.
+ */
+int tc_pipeline_getopt(int argc, char **argv, const char *optstring,
+                       int *index, char **arg);
+
+/*************************************************************************/
+
+#endif  /* TCPIPELINE_H */
+
+/*
+ * Local variables:
+ *   c-file-style: "stroustrup"
+ *   c-file-offsets: ((case-label . *) (statement-case-intro . *))
+ *   indent-tabs-mode: nil
+ * End:
+ *
+ * vim: expandtab shiftwidth=4:
+ */
@@ -0,0 +1,453 @@
+/*
+ * tcpipeline_stages.c -- tcextract and tcdecode as in-process pipeline
+ *                        stages (see tcpipeline.h).
+ *
+ * This file is part of transcode, a video stream processing tool.
+ *
+ * transcode is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * transcode is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "transcode.h"
+#include "libtc/libtc.h"
+#include "ioaux.h"
+#include "tc.h"
+#include "tcpipeline.h"
+
+#include <fcntl.h>
+#include <limits.h>
+#include <pthread.h>
+#include <sys/stat.h>
+
+/*************************************************************************/
+
+/*
+ * The extract and decode routines keep their state in static variables,
+ * so each can serve only one pipeline at a time.  A stage whose routine
+ * is already busy is left to the program, as before.
+ */
+
+enum {
+    ROUTINE_EXTRACT_AC3,
+    ROUTINE_EXTRACT_MP3,
+    ROUTINE_EXTRACT_MPEG2,
+    ROUTINE_EXTRACT_PCM,
+    ROUTINE_DECODE_A52,
+    ROUTINE_DECODE_MP3,  /* also MP2: both use the same decoder state */
+    ROUTINE_DECODE_MPEG2,
+    NUM_ROUTINES
+};
+
+static int routine_busy[NUM_ROUTINES];
+static pthread_mutex_t routine_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static int claim_routine(int routine)
+{
+    int claimed;
+
+    pthread_mutex_lock(&routine_lock);
+    claimed = !routine_busy[routine];
+    routine_busy[routine] = 1;
+    pthread_mutex_unlock(&routine_lock);
+    return claimed;
+}
+
+static void release_routine(int routine)
+{
+    pthread_mutex_lock(&routine_lock);
+    routine_busy[routine] = 0;
+    pthread_mutex_unlock(&routine_lock);
+}
+
+/*************************************************************************/
+/*************************************************************************/
+
+/* tcextract */
+
+typedef struct {
+    int routine;
+    int fd;          /* file given with -i, or -1 */
+    info_t ipipe;
+} ExtractStage;
+
+/*************************************************************************/
+
+/**
+ * extract_prepare:  Accept a tcextract command line if it extracts one
+ * of the supported codecs from a stream the routine reads sequentially
+ * (the AVI, WAV and CDXA paths, and other codecs, are left to tcextract).
+ * Option handling follows tcextract.c.
+ */
+
+static void *extract_prepare(int argc, char **argv)
+{
+    const char *codec = NULL, *magic = "", *name = NULL;
+    ExtractStage *stage;
+    int index = 1, opt;
+    char *arg;
+
+    stage = tc_zalloc(sizeof(*stage));
+    if (stage == NULL) {
+        return NULL;
+    }
+    stage->fd = -1;
+    stage->ipipe.verbose = TC_INFO;
+    stage->ipipe.frame_limit[0] = 0;
+    stage->ipipe.frame_limit[1] = LONG_MAX;
+
+    while ((opt = tc_pipeline_getopt(argc, argv, "d:x:i:f:a:t:C:",
+                                     &index, &arg)) != -1) {
+        switch (opt) {
+          case 'i':
+            name = arg;
+            break;
+          case 'd':
+            stage->ipipe.verbose = atoi(arg);
+            break;
+          case 'x':
+            codec = arg;
+            break;
+          case 'f':
+            stage->ipipe.nav_seek_file = arg;
+            break;
+          case 't':
+            magic = arg;
+            break;
+          case 'a':
+            stage->ipipe.track = strtol(arg, NULL, 0);
+            break;
+          case 'C':
+            if (sscanf(arg, "%ld-%ld", &stage->ipipe.frame_limit[0],
+                       &stage->ipipe.frame_limit[1]) != 2
+             || stage->ipipe.frame_limit[0] > stage->ipipe.frame_limit[1]
+            ) {
+                goto reject;
+            }
+            break;
+          default:
+            goto reject;
+        }
+    }
+    if (index < argc || codec == NULL) {
+        goto reject;
+    }
+
+    stage->ipipe.magic = TC_MAGIC_UNKNOWN;
+    stage->ipipe.stype = TC_STYPE_STDIN;
+    stage->ipipe.select = TC_AUDIO;
+    if (name != NULL) {
+        struct stat st;
+        if (stat(name, &st) != 0 || !S_ISREG(st.st_mode)) {
+            goto reject;
+        }
+        stage->fd = open(name, O_RDONLY);
+        if (stage->fd < 0) {
+            goto reject;
+        }
+        fcntl(stage->fd, F_SETFD, FD_CLOEXEC);
+        stage->ipipe.magic = fileinfo(stage->fd, 0);
+        stage->ipipe.stype = TC_STYPE_UNKNOWN;
+        stage->ipipe.name = name;
+    }
+    if (stage->ipipe.magic == TC_MAGIC_OGG) {
+        goto reject;
+    }
+
+    if (strcmp(magic, "vob") == 0) {
+        stage->ipipe.magic = TC_MAGIC_VOB;
+    } else if (strcmp(magic, "raw") == 0) {
+        stage->ipipe.magic = TC_MAGIC_RAW;
+    } else if (strcmp(magic, "m2v") == 0 && strcmp(codec, "mpeg2") == 0) {
+        stage->ipipe.magic = TC_MAGIC_M2V;
+    } else if (strcmp(magic, "vdr") == 0 && strcmp(codec, "ps1") == 0) {
+        stage->ipipe.magic = TC_MAGIC_VDR;
+    } else if (*magic) {
+        goto reject;
+    }
+
+    if (strcmp(codec, "mpeg2") == 0) {
+        stage->routine = ROUTINE_EXTRACT_MPEG2;
+        stage->ipipe.codec = TC_CODEC_MPEG2;
+        stage->ipipe.select = TC_VIDEO;
+        if (stage->ipipe.magic == TC_MAGIC_CDXA) {
+            goto reject;
+        }
+    } else if (strcmp(codec, "ac3") == 0 || strcmp(codec, "dts") == 0
+            || strcmp(codec, "ps1") == 0) {
+        stage->routine = ROUTINE_EXTRACT_AC3;
+        stage->ipipe.codec = (codec[0] == 'a') ? TC_CODEC_AC3
+                           : (codec[0] == 'd') ? TC_CODEC_DTS
+                           :                     TC_CODEC_PS1;
+        if (stage->ipipe.magic == TC_MAGIC_AVI) {
+            goto reject;
+        }
+    } else if (strcmp(codec, "mp3") == 0 || strcmp(codec, "mp2") == 0) {
+        stage->routine = ROUTINE_EXTRACT_MP3;
+        stage->ipipe.codec = TC_CODEC_MP3;
+        if (stage->ipipe.magic == TC_MAGIC_AVI) {
+            goto reject;
+        }
+    } else if (strcmp(codec, "pcm") == 0) {
+        stage->routine = ROUTINE_EXTRACT_PCM;
+        stage->ipipe.codec = TC_CODEC_PCM;
+        if (stage->ipipe.magic == TC_MAGIC_AVI
+         || stage->ipipe.magic == TC_MAGIC_WAV
+        ) {
+            goto reject;
+        }
+    } else {
+        goto reject;
+    }
+
+    if (!claim_routine(stage->routine)) {
+        goto reject;
+    }
+    return stage;
+
+  reject:
+    if (stage->fd >= 0) {
+        close(stage->fd);
+    }
+    tc_free(stage);
+    return NULL;
+}
+
+/*************************************************************************/
+
+static void extract_run(void *data, int fd_in, int fd_out)
+{
+    ExtractStage *stage = data;
+
+    stage->ipipe.fd_in = (stage->fd >= 0) ? stage->fd : fd_in;
+    stage->ipipe.fd_out = fd_out;
+    switch (stage->routine) {
+      case ROUTINE_EXTRACT_AC3:   extract_ac3(&stage->ipipe);   break;
+      case ROUTINE_EXTRACT_MP3:   extract_mp3(&stage->ipipe);   break;
+      case ROUTINE_EXTRACT_MPEG2: extract_mpeg2(&stage->ipipe); break;
+      case ROUTINE_EXTRACT_PCM:   extract_pcm(&stage->ipipe);   break;
+    }
+}
+
+/*************************************************************************/
+
+static void extract_release(void *data)
+{
+    ExtractStage *stage = data;
+
+    if (stage->fd >= 0) {
+        close(stage->fd);
+    }
+    release_routine(stage->routine);
+    tc_free(stage);
+}
+
+/*************************************************************************/
+
+const TCPipelineBuiltin tc_pipeline_tcextract = {
+    .name    = "tcextract",
+    .prepare = extract_prepare,
+    .run     = extract_run,
+    .release = extract_release,
+};
+
+/*************************************************************************/
+/*************************************************************************/
+
+/* tcdecode */
+
+typedef struct {
+    int routine;
+    int mp2;         /* decode_mp2() rather than decode_mp3() */
+    decode_t decode;
+} DecodeStage;
+
+/*************************************************************************/
+
+/**
+ * decode_prepare:  Accept a tcdecode command line decoding MPEG-2 video,
+ * AC3 or MPEG audio from its standard input.  Option handling follows
+ * tcdecode.c.
+ */
+
+static void *decode_prepare(int argc, char **argv)
+{
+    const char *codec = NULL, *format = "rgb";
+    DecodeStage *stage;
+    int index = 1, opt;
+    char *arg;
+
+    stage = tc_zalloc(sizeof(*stage));
+    if (stage == NULL) {
+        return NULL;
+    }
+    stage->decode.magic = TC_MAGIC_UNKNOWN;
+    stage->decode.stype = TC_STYPE_STDIN;
+    stage->decode.codec = TC_CODEC_UNKNOWN;
+    stage->decode.verbose = TC_INFO;
+    stage->decode.quality = VQUALITY;
+    stage->decode.ac3_gain[0] = 1.0;
+    stage->decode.ac3_gain[1] = 1.0;
+    stage->decode.ac3_gain[2] = 1.0;
+    stage->decode.frame_limit[0] = 0;
+    stage->decode.frame_limit[1] = LONG_MAX;
+
+    while ((opt = tc_pipeline_getopt(argc, argv, "Q:d:x:g:y:s:YC:A:z:",
+                                     &index, &arg)) != -1) {
+        switch (opt) {
+          case 'd':
+            stage->decode.verbose = atoi(arg);
+            break;
+          case 'Q':
+            stage->decode.quality = atoi(arg);
+            break;
+          case 'A':
+            stage->decode.a52_mode = atoi(arg);
+            break;
+          case 'x':
+            codec = arg;
+            break;
+          case 'y':
+            format = arg;
+            break;
+          case 'g':
+            if (sscanf(arg, "%dx%d", &stage->decode.width,
+                       &stage->decode.height) != 2) {
+                goto reject;
+            }
+            break;
+          case 'Y':
+            stage->decode.dv_yuy2_mode = 1;
+            break;
+          case 's':
+            if (sscanf(arg, "%lf,%lf,%lf", &stage->decode.ac3_gain[0],
+                       &stage->decode.ac3_gain[1],
+                       &stage->decode.ac3_gain[2]) != 3) {
+                goto reject;
+            }
+            break;
+          case 'C':
+            if (sscanf(arg, "%ld,%ld", &stage->decode.frame_limit[0],
+                       &stage->decode.frame_limit[1]) != 2
+             || stage->decode.frame_limit[0] >= stage->decode.frame_limit[1]
+            ) {
+                goto reject;
+            }
+            break;
+          case 'z':
+            stage->decode.padrate = atoi(arg);
+            break;
+          default:
+            goto reject;
+        }
+    }
+    if (index < argc || codec == NULL) {
+        goto reject;
+    }
+    if (stage->decode.width < 0) {
+        stage->decode.width = 0;
+    }
+    if (stage->decode.height < 0) {
+        stage->decode.height = 0;
+    }
+
+    if (strcmp(format, "rgb") == 0) {
+        stage->decode.format = TC_CODEC_RGB;
+    } else if (strcmp(format, "yuv420p") == 0) {
+        stage->decode.format = TC_CODEC_YUV420P;
+    } else if (strcmp(format, "pcm") == 0) {
+        stage->decode.format = TC_CODEC_PCM;
+    } else if (strcmp(format, "raw") == 0) {
+        stage->decode.format = TC_CODEC_RAW;
+    } else {
+        goto reject;
+    }
+
+    if (strcmp(codec, "mpeg2") == 0) {
+        stage->routine = ROUTINE_DECODE_MPEG2;
+        stage->decode.codec = TC_CODEC_MPEG2;
+    } else if (strcmp(codec, "ac3") == 0) {
+        stage->routine = ROUTINE_DECODE_A52;
+        stage->decode.codec = TC_CODEC_AC3;
+    } else if (strcmp(codec, "mp3") == 0 || strcmp(codec, "mp2") == 0) {
+        stage->routine = ROUTINE_DECODE_MP3;
+        stage->decode.codec = TC_CODEC_MP3;
+        stage->mp2 = (codec[2] == '2');
+    } else {
+        goto reject;
+    }
+
+    if (!claim_routine(stage->routine)) {
+        goto reject;
+    }
+    return stage;
+
+  reject:
+    tc_free(stage);
+    return NULL;
+}
+
+/*************************************************************************/
+
+static void decode_run(void *data, int fd_in, int fd_out)
+{
+    DecodeStage *stage = data;
+
+    stage->decode.fd_in = fd_in;
+    stage->decode.fd_out = fd_out;
+    switch (stage->routine) {
+      case ROUTINE_DECODE_A52:
+        decode_a52(&stage->decode);
+        break;
+      case ROUTINE_DECODE_MP3:
+        if (stage->mp2) {
+            decode_mp2(&stage->decode);
+        } else {
+            decode_mp3(&stage->decode);
+        }
+        break;
+      case ROUTINE_DECODE_MPEG2:
+        decode_mpeg2(&stage->decode);
+        break;
+    }
+}
+
+/*************************************************************************/
+
+static void decode_release(void *data)
+{
+    DecodeStage *stage = data;
+
+    release_routine(stage->routine);
+    tc_free(stage);
+}
+
+/*************************************************************************/
+
+const TCPipelineBuiltin tc_pipeline_tcdecode = {
+    .name    = "tcdecode",
+    .prepare = decode_prepare,
+    .run     = decode_run,
+    .release = decode_release,
+};
+
+/*************************************************************************/
+
+/*
+ * Local variables:
+ *   c-file-style: "stroustrup"
+ *   c-file-offsets: ((case-label . *) (statement-case-intro . *))
+ *   indent-tabs-mode: nil
+ * End:
+ *
+ * vim: expandtab shiftwidth=4:
+ */
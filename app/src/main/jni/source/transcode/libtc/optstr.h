@@ -125,6 +125,11 @@ __attribute__((format(scanf,3,4)))
  *                   "M":  Can do Multiple Instances
  *                   "E":  Is a PRE filter
  *                   "O":  Is a POST filter
+ *                   "P":  Is stateless, can process frames concurrently
+ *                         and in any order
+ *                   "S":  Needs frames one at time, in any order
+ *                         (without "P" or "S", frames are given one at
+ *                         time and in order)
  *                   Valid examples:
  *                   "VR"  : Video and RGB
  *                   "VRY" : Video and YUV and RGB
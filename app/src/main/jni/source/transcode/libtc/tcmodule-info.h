@@ -56,6 +56,14 @@
 #define TC_MODULE_FLAG_CONVERSION       0x00000010
 /* module requires an unavoidable csp conversion)
  * (XXX: this flag will hopefully vanish soon) */
+#define TC_MODULE_FLAG_STATELESS        0x00000020
+/* module keeps no state across frames, so it can process
+ * them concurrently and in any order */
+#define TC_MODULE_FLAG_SERIAL           0x00000040
+/* module keeps state across frames, but doesn't care about
+ * their order; it needs just one frame at time.
+ * Modules flagged neither STATELESS nor SERIAL get the frames
+ * one at time and in order. */
 
 /*
  * this structure will hold all the interesting informations
@@ -27,6 +27,8 @@
 #endif
 
 #include <stdint.h>
+#include <string.h>
+#include <pthread.h>
 
 #include "tcmodule-info.h"
 #include "tcmodule-data.h"
@@ -223,35 +225,146 @@ const TCModuleClass *tc_plugin_setup(void);
 
 
 
+/*
+ * Old-fashioned interface for multi-instance filters.
+ *
+ * Every instance the core creates (one per tc_filter_add(), told apart
+ * by frame->filter_id) gets a TCModuleInstance of its own, so all the
+ * per-instance state lives in its private data block and none of it in
+ * static variables.  The core may call tc_filter() for one instance from
+ * several threads at once if the module declares TC_MODULE_FLAG_STATELESS
+ * (and from changing threads otherwise), so finding the instance for a
+ * frame must be, and is, thread safe.
+ */
+
+/* maximum number of instances of a module alive at the same time */
 #define TC_FILTER_OLDINTERFACE_INSTANCES	128
 
-/* FIXME:
- * this uses the filter ID as an index--the ID can grow
- * arbitrarily large, so this needs to be fixed
+typedef struct tcfilterinstances_ TCFilterInstances;
+struct tcfilterinstances_ {
+    pthread_mutex_t lock;
+    int ids[TC_FILTER_OLDINTERFACE_INSTANCES]; /* 0: slot free */
+    TCModuleInstance mods[TC_FILTER_OLDINTERFACE_INSTANCES];
+};
+
+#define TC_FILTER_INSTANCES_INITIALIZER { PTHREAD_MUTEX_INITIALIZER, }
+
+/*
+ * tc_filter_instance_get:
+ *      find the instance for the given filter ID, or make a new one.
+ *
+ * Parameters:
+ *      set: table of instances of the module.
+ *       id: filter ID (frame->filter_id).
+ *   create: if !0, make a new instance (unless there is one already).
+ * Return value:
+ *      pointer to the instance, or NULL if there is none (create==0)
+ *      or if all slots are in use (create!=0).
+ */
+#ifdef HAVE_GCC_ATTRIBUTES
+__attribute__((unused))
+#endif
+static TCModuleInstance *tc_filter_instance_get(TCFilterInstances *set,
+                                                int id, int create)
+{
+    TCModuleInstance *mod = NULL;
+    int i = 0, free_slot = -1;
+
+    pthread_mutex_lock(&set->lock);
+    for (i = 0; i < TC_FILTER_OLDINTERFACE_INSTANCES; i++) {
+        if (set->ids[i] == id) {
+            mod = &set->mods[i];
+            break;
+        }
+        if (set->ids[i] == 0 && free_slot < 0) {
+            free_slot = i;
+        }
+    }
+    if (mod == NULL && create && id > 0 && free_slot >= 0) {
+        memset(&set->mods[free_slot], 0, sizeof(TCModuleInstance));
+        set->mods[free_slot].id = id;
+        set->ids[free_slot] = id;
+        mod = &set->mods[free_slot];
+    }
+    pthread_mutex_unlock(&set->lock);
+    return mod;
+}
+
+/*
+ * tc_filter_instance_put:
+ *      release the slot of the instance for the given filter ID, once
+ *      the instance is finalized.
+ *
+ * Parameters:
+ *      set: table of instances of the module.
+ *       id: filter ID (frame->filter_id).
+ * Return value:
+ *      None.
  */
+#ifdef HAVE_GCC_ATTRIBUTES
+__attribute__((unused))
+#endif
+static void tc_filter_instance_put(TCFilterInstances *set, int id)
+{
+    int i = 0;
+
+    pthread_mutex_lock(&set->lock);
+    for (i = 0; i < TC_FILTER_OLDINTERFACE_INSTANCES; i++) {
+        if (set->ids[i] == id) {
+            set->ids[i] = 0;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&set->lock);
+}
+
 #define TC_FILTER_OLDINTERFACE_M(name) \
     /* Old-fashioned module interface. */ \
-    static TCModuleInstance mods[TC_FILTER_OLDINTERFACE_INSTANCES]; \
+    static TCFilterInstances name ## _instances = \
+        TC_FILTER_INSTANCES_INITIALIZER; \
     \
     int tc_filter(frame_list_t *frame, char *options) \
     { \
-	TCModuleInstance *mod = &mods[frame->filter_id]; \
-	\
+        TCModuleInstance *mod = NULL; \
+        \
         if (frame->tag & TC_FILTER_INIT) { \
+            mod = tc_filter_instance_get(&name ## _instances, \
+                                         frame->filter_id, TC_TRUE); \
+            if (mod == NULL) { \
+                tc_log_error(MOD_NAME, "too many instances"); \
+                return TC_ERROR; \
+            } \
             tc_log_info(MOD_NAME, "instance #%i", frame->filter_id); \
             if (name ## _init(mod, TC_MODULE_FEATURE_FILTER) < 0) { \
+                tc_filter_instance_put(&name ## _instances, \
+                                       frame->filter_id); \
                 return TC_ERROR; \
             } \
             return name ## _configure(mod, options, tc_get_vob()); \
+        } \
         \
-        } else if (frame->tag & TC_FILTER_GET_CONFIG) { \
+        mod = tc_filter_instance_get(&name ## _instances, \
+                                     frame->filter_id, TC_FALSE); \
+        if (frame->tag & TC_FILTER_GET_CONFIG) { \
+            /* description only, if not (yet) initialized */ \
+            TCModuleInstance blank; \
+            if (mod == NULL) { \
+                memset(&blank, 0, sizeof(blank)); \
+                mod = &blank; \
+            } \
             return name ## _get_config(mod, options); \
-        \
-        } else if (frame->tag & TC_FILTER_CLOSE) { \
-            if (name ## _stop(mod) < 0) { \
-                return TC_ERROR; \
+        } \
+        if (mod == NULL) { \
+            tc_log_error(MOD_NAME, "no instance #%i", frame->filter_id); \
+            return TC_ERROR; \
+        } \
+        if (frame->tag & TC_FILTER_CLOSE) { \
+            int ret = name ## _stop(mod); \
+            if (ret >= 0) { \
+                ret = name ## _fini(mod); \
             } \
-            return name ## _fini(mod); \
+            tc_filter_instance_put(&name ## _instances, frame->filter_id); \
+            return ret; \
         } \
         \
         return name ## _process(mod, frame); \
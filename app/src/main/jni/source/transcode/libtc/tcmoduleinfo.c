@@ -155,7 +155,7 @@ void tc_module_info_log(const TCModuleInfo *info, int verbose)
         if (info->flags == TC_MODULE_FLAG_NONE) {
             strlcpy(buffer, "none", sizeof(buffer));
         } else {
-            tc_snprintf(buffer, sizeof(buffer), "%s%s%s%s",
+            tc_snprintf(buffer, sizeof(buffer), "%s%s%s%s%s%s",
                         (info->flags & TC_MODULE_FLAG_RECONFIGURABLE)
                             ?"reconfigurable " :"",
                         (info->flags & TC_MODULE_FLAG_DELAY)
@@ -163,7 +163,11 @@ void tc_module_info_log(const TCModuleInfo *info, int verbose)
                         (info->flags & TC_MODULE_FLAG_BUFFERING)
                             ?"buffering " :"",
                         (info->flags & TC_MODULE_FLAG_CONVERSION)
-                            ?"conversion " :"");
+                            ?"conversion " :"",
+                        (info->flags & TC_MODULE_FLAG_STATELESS)
+                            ?"stateless " :"",
+                        (info->flags & TC_MODULE_FLAG_SERIAL)
+                            ?"serial " :"");
         }
         tc_log_info(info->name, "flags      : %s", buffer);
     }
@@ -0,0 +1,182 @@
+/*
+ * tcworkers.c -- pool of worker threads splitting a job into items
+ *                (implementation).
+ *
+ * This file is part of transcode, a video stream processing tool.
+ *
+ * transcode is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * transcode is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include <pthread.h>
+
+#include "libtc.h"
+#include "tcworkers.h"
+
+
+/*
+ * The current job is func/arg/count; it is started by bumping serial,
+ * every worker takes items (next) until none is left and then counts
+ * itself out of pending. run_lock keeps jobs of different callers apart.
+ */
+struct tcworkers_ {
+    pthread_mutex_t run_lock;
+    pthread_mutex_t lock;
+    pthread_cond_t start;
+    pthread_cond_t done;
+
+    TCWorkerFunc func;
+    void *arg;
+    int count;
+    int next;
+    unsigned long serial;
+    int pending;
+    int quit;
+
+    int nthreads;           /* calling thread included */
+    pthread_t *threads;
+};
+
+
+/* take items of the current job until none is left; lock held */
+static void run_items(TCWorkers *pool)
+{
+    while (pool->next < pool->count) {
+        int item = pool->next++;
+        pthread_mutex_unlock(&pool->lock);
+        pool->func(pool->arg, item, pool->count);
+        pthread_mutex_lock(&pool->lock);
+    }
+}
+
+static void *worker_thread(void *arg)
+{
+    TCWorkers *pool = arg;
+    unsigned long serial = 0; /* no job before the threads are started */
+
+    pthread_mutex_lock(&pool->lock);
+    for (;;) {
+        while (!pool->quit && pool->serial == serial)
+            pthread_cond_wait(&pool->start, &pool->lock);
+        if (pool->quit)
+            break;
+        serial = pool->serial;
+        run_items(pool);
+        if (--pool->pending == 0)
+            pthread_cond_signal(&pool->done);
+    }
+    pthread_mutex_unlock(&pool->lock);
+    return NULL;
+}
+
+TCWorkers *tc_workers_new(int threads)
+{
+    TCWorkers *pool = NULL;
+    int i;
+
+    if (threads > TC_WORKERS_MAX)
+        threads = TC_WORKERS_MAX;
+    if (threads < 2)
+        return NULL;
+
+    pool = tc_zalloc(sizeof(TCWorkers));
+    if (pool == NULL)
+        return NULL;
+    pool->threads = tc_zalloc(sizeof(pthread_t) * threads);
+    if (pool->threads == NULL) {
+        tc_free(pool);
+        return NULL;
+    }
+    pthread_mutex_init(&pool->run_lock, NULL);
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->start, NULL);
+    pthread_cond_init(&pool->done, NULL);
+
+    pool->nthreads = 1;
+    for (i = 1; i < threads; i++) {
+        if (pthread_create(&pool->threads[i], NULL, worker_thread, pool) != 0) {
+            tc_log_warn(__FILE__, "can't start worker thread %i", i);
+            break;
+        }
+        pool->nthreads++;
+    }
+    return pool;
+}
+
+int tc_workers_threads(const TCWorkers *pool)
+{
+    return (pool != NULL) ?pool->nthreads :1;
+}
+
+void tc_workers_run(TCWorkers *pool, TCWorkerFunc func, void *arg,
+                    int count)
+{
+    int i;
+
+    if (pool == NULL || pool->nthreads < 2 || count < 2) {
+        for (i = 0; i < count; i++)
+            func(arg, i, count);
+        return;
+    }
+
+    pthread_mutex_lock(&pool->run_lock);
+    pthread_mutex_lock(&pool->lock);
+    pool->func    = func;
+    pool->arg     = arg;
+    pool->count   = count;
+    pool->next    = 0;
+    pool->pending = pool->nthreads - 1;
+    pool->serial++;
+    pthread_cond_broadcast(&pool->start);
+
+    run_items(pool);
+    while (pool->pending > 0)
+        pthread_cond_wait(&pool->done, &pool->lock);
+    pthread_mutex_unlock(&pool->lock);
+    pthread_mutex_unlock(&pool->run_lock);
+}
+
+void tc_workers_del(TCWorkers *pool)
+{
+    int i;
+
+    if (pool == NULL)
+        return;
+
+    pthread_mutex_lock(&pool->lock);
+    pool->quit = 1;
+    pthread_cond_broadcast(&pool->start);
+    pthread_mutex_unlock(&pool->lock);
+    for (i = 1; i < pool->nthreads; i++)
+        pthread_join(pool->threads[i], NULL);
+
+    pthread_mutex_destroy(&pool->run_lock);
+    pthread_mutex_destroy(&pool->lock);
+    pthread_cond_destroy(&pool->start);
+    pthread_cond_destroy(&pool->done);
+    tc_free(pool->threads);
+    tc_free(pool);
+}
+
+/*************************************************************************/
+
+/*
+ * Local variables:
+ *   c-file-style: "stroustrup"
+ *   c-file-offsets: ((case-label . *) (statement-case-intro . *))
+ *   indent-tabs-mode: nil
+ * End:
+ *
+ * vim: expandtab shiftwidth=4:
+ */
@@ -0,0 +1,99 @@
+/*
+ * tcworkers.h -- pool of worker threads splitting a job into items.
+ *
+ * This file is part of transcode, a video stream processing tool.
+ *
+ * transcode is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * transcode is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef TCWORKERS_H
+#define TCWORKERS_H
+
+/*
+ * Quick Summary:
+ *   a TCWorkers pool keeps threads-1 threads waiting for jobs. A job is
+ *   a function run on the items 0..count-1; the items are taken in
+ *   order by whichever thread is free, the calling one included, so a
+ *   job with one item per thread runs each on its own thread and a job
+ *   with more items is balanced dynamically. Items of a job must not
+ *   depend on each other, nor on the thread running them.
+ *   A NULL pool is valid everywhere and means "calling thread only".
+ */
+
+/* opaque type */
+typedef struct tcworkers_ TCWorkers;
+
+/* function run on each item of a job */
+typedef void (*TCWorkerFunc)(void *arg, int item, int count);
+
+/* upper limit of threads in a pool */
+#define TC_WORKERS_MAX  64
+
+
+/*
+ * tc_workers_new:
+ *    create a pool of `threads' threads, the calling one included,
+ *    starting threads-1 new ones (at most TC_WORKERS_MAX in all).
+ *
+ * Parameters:
+ *    threads: number of threads (1 or more).
+ * Return Value:
+ *    a new pool (use tc_workers_del() to dispose it), possibly with
+ *    fewer threads than requested if some could not be started
+ *    (see tc_workers_threads); NULL if threads < 2 or out of memory.
+ */
+TCWorkers *tc_workers_new(int threads);
+
+/*
+ * tc_workers_threads:
+ *    number of threads of a pool, the calling one included.
+ *
+ * Parameters:
+ *    pool: pool to query, or NULL.
+ * Return Value:
+ *    1 or more (1 for NULL).
+ */
+int tc_workers_threads(const TCWorkers *pool);
+
+/*
+ * tc_workers_run:
+ *    run func(arg, item, count) for each item in 0..count-1 on the
+ *    pool and the calling thread, and wait for all of them to finish.
+ *    Jobs of one pool are run one at a time; `func' must not start a
+ *    job on the same pool.
+ *
+ * Parameters:
+ *     pool: pool to use, or NULL to run everything on this thread.
+ *     func: function to run.
+ *      arg: first argument of `func'.
+ *    count: number of items (nothing is done if < 1).
+ * Return Value:
+ *    None.
+ */
+void tc_workers_run(TCWorkers *pool, TCWorkerFunc func, void *arg,
+                    int count);
+
+/*
+ * tc_workers_del:
+ *    stop the threads of a pool and release it. Does nothing for NULL.
+ *
+ * Parameters:
+ *    pool: pool to dispose, not running a job.
+ * Return Value:
+ *    None.
+ */
+void tc_workers_del(TCWorkers *pool);
+
+#endif /* TCWORKERS_H */
@@ -16,6 +16,7 @@
 #define zoom zoom_  // temp to avoid name conflict
 #include "src/transcode.h"
 #undef zoom
+#include "libtc/tcworkers.h"
 #include <math.h>
 
 /*************************************************************************/
@@ -41,6 +42,16 @@ struct resize_table_elem {
 /* Maximum number of ZoomInfo structures to cache. */
 #define ZOOMINFO_CACHE_SIZE 10
 
+/* Maximum number of slice threads for a handle. */
+#define TCV_MAX_THREADS TC_WORKERS_MAX
+
+/* Minimum number of rows in a slice; smaller images use fewer slices. */
+#define TCV_MIN_SLICE_ROWS 16
+
+/* Function run on each slice of a sliced operation: `slice' goes from 0
+ * to `nslices'-1. */
+typedef TCWorkerFunc SliceFunc;
+
 
 /* Internal data structure to hold various state information.  The
  * TCVHandle returned by tcv_init() and passed by the caller to other
@@ -62,13 +73,19 @@ struct tcvhandle_ {
     double saved_weight, saved_bias;
     /* ZoomInfo cache */
     struct {
-        int old_w, old_h, new_w, new_h, Bpp, ilace;
+        int old_w, old_h, new_w, new_h, Bpp, old_stride, new_stride;
+        int out_x, out_w, mirror;
         TCVZoomFilter filter;
         ZoomInfo *zi;
     } zoominfo_cache[ZOOMINFO_CACHE_SIZE];
     /* Buffer and buffer size for tcv_convert() */
     uint8_t *convert_buffer;
     uint32_t convert_buffer_size;
+    /* Band buffers for tcv_zoom() on more than one thread */
+    uint8_t *zoom_buffer;
+    uint32_t zoom_buffer_size;
+    /* Slice threads (see tcv_set_threads()), NULL for just the caller */
+    TCWorkers *workers;
 };
 
 /*************************************************************************/
@@ -81,6 +98,11 @@ static void init_one_resize_table(struct resize_table_elem *table,
                                   int oldsize, int newsize);
 static void init_gamma_table(TCVHandle handle, double gamma);
 static void init_aa_table(TCVHandle handle, double aa_weight, double aa_bias);
+static int slice_count(TCVHandle handle, int rows);
+static void run_slices(TCVHandle handle, SliceFunc func, void *arg,
+                       int nslices);
+static void slice_rows(int rows, int slice, int nslices, int align,
+                       int *y0, int *y1);
 
 /*************************************************************************/
 /*************************************************************************/
@@ -132,16 +154,59 @@ void tcv_free(TCVHandle handle)
 {
     if (handle) {
         int i;
+        tc_workers_del(handle->workers);
         for (i = 0; i < ZOOMINFO_CACHE_SIZE; i++) {
             if (handle->zoominfo_cache[i].zi)
                 zoom_free(handle->zoominfo_cache[i].zi);
         }
+        free(handle->zoom_buffer);
         free(handle);
     }
 }
 
 /*************************************************************************/
 
+/**
+ * tcv_set_threads:  Set the number of threads used by the given handle.
+ * tcv_zoom(), tcv_antialias() and tcv_convert() split large images into
+ * horizontal bands and process them in parallel on that many threads
+ * (the calling one included).  The default is 1, meaning everything is
+ * done by the calling thread.  Results do not depend on the number of
+ * threads.
+ *
+ * Parameters: handle: tcvideo handle.
+ *            threads: Number of threads (1 or more).
+ * Return value: Nonzero on success, zero on error (invalid parameters or
+ *               thread creation failure; the handle is then left with
+ *               the threads it could start).
+ * Preconditions: handle != 0: handle was returned by tcv_init()
+ *                No other function is being called on this handle.
+ * Postconditions: None.
+ */
+
+int tcv_set_threads(TCVHandle handle, int threads)
+{
+    if (!handle || threads < 1) {
+        tc_log_error("libtcvideo", "tcv_set_threads: invalid parameters!");
+        return 0;
+    }
+    if (threads > TCV_MAX_THREADS)
+        threads = TCV_MAX_THREADS;
+    if (threads == tc_workers_threads(handle->workers))
+        return 1;
+
+    tc_workers_del(handle->workers);
+    handle->workers = tc_workers_new(threads);
+    if (tc_workers_threads(handle->workers) < threads) {
+        tc_log_error("libtcvideo", "tcv_set_threads: can't start"
+                     " %d threads", threads);
+        return 0;
+    }
+    return 1;
+}
+
+/*************************************************************************/
+
 /**
  * tcv_clip:  Clip the given image by removing the specified number of
  * pixels from each edge.  If a clip value is negative, instead expands the
@@ -550,6 +615,16 @@ static inline void rescale_pixel(const uint8_t *src1, const uint8_t *src2,
  * Postconditions: (on success) dest[0]..dest[new_w*new_h*Bpp-1] are set
  */
 
+static int check_zoom_filter(const char *func, TCVZoomFilter filter);
+static ZoomInfo *get_zoominfo(TCVHandle handle, int old_w, int old_h,
+                              int new_w, int new_h, int Bpp,
+                              int old_stride, int new_stride,
+                              int out_x, int out_w, int mirror,
+                              TCVZoomFilter filter, int *free_ret);
+static void zoom_sliced(TCVHandle handle, const ZoomInfo *zi,
+                        const uint8_t *src, uint8_t *dest, int new_stride,
+                        int y0, int y1);
+
 int tcv_zoom(TCVHandle handle,
              uint8_t *src, uint8_t *dest, int width, int height, int Bpp,
              int new_w, int new_h, TCVZoomFilter filter)
@@ -557,7 +632,6 @@ int tcv_zoom(TCVHandle handle,
     ZoomInfo *zi;
     int free_zi = 0;  // Should the ZoomInfo be freed after use?
     int interlace_mode = 0;
-    int i;
 
     if (!src || !dest || width <= 0 || height <= 0 || (Bpp != 1 && Bpp != 3)) {
         tc_log_error("libtcvideo", "tcv_zoom: invalid frame parameters!");
@@ -578,6 +652,126 @@ int tcv_zoom(TCVHandle handle,
                      new_w, new_h);
         return 0;
     }
+    if (!check_zoom_filter("tcv_zoom", filter))
+        return 0;
+
+    if (interlace_mode) {
+        zi = get_zoominfo(handle, width, height/2, new_w, new_h/2, Bpp,
+                          width*Bpp*2, new_w*Bpp*2, 0, new_w, 0, filter,
+                          &free_zi);
+    } else {
+        zi = get_zoominfo(handle, width, height, new_w, new_h, Bpp,
+                          width*Bpp, new_w*Bpp, 0, new_w, 0, filter,
+                          &free_zi);
+    }
+    if (!zi) {
+        tc_log_error("libtcvideo", "tcv_zoom: zoom_init() failed!");
+        return 0;
+    }
+    if (interlace_mode) {
+        zoom_sliced(handle, zi, src, dest, new_w*Bpp*2, 0, new_h/2);
+        zoom_sliced(handle, zi, src + width*Bpp, dest + new_w*Bpp,
+                    new_w*Bpp*2, 0, new_h/2);
+    } else {
+        zoom_sliced(handle, zi, src, dest, new_w*Bpp, 0, new_h);
+    }
+    if (free_zi)
+        zoom_free(zi);
+    return 1;
+}
+
+/*************************************************************************/
+
+/**
+ * tcv_zoom_rect:  Resize part of an image to an arbitrary size, with
+ * filtering, and store part of the result, all in one pass.  This is
+ * equivalent to clipping the source rectangle out of the original image,
+ * zooming it to new_w x new_h, clipping the output rectangle out of the
+ * result and flipping that as requested by `flags', but touches each
+ * pixel only once.  If new_w == width and new_h == height, the image is
+ * only copied (clipped and flipped), and the filter is not used.
+ *
+ * Parameters: handle: tcvideo handle.
+ *                src: First pixel of the source rectangle.
+ *         src_stride: Bytes per line of the source image.
+ *              width: Width of source rectangle.
+ *             height: Height of source rectangle.
+ *               dest: Destination data plane.
+ *        dest_stride: Bytes per line of the destination image.
+ *                Bpp: Bytes (not bits!) per pixel.
+ *              new_w: Width of resized source rectangle.
+ *              new_h: Height of resized source rectangle.
+ *              out_x: Left edge of output rectangle in the resized image.
+ *              out_y: Top edge of output rectangle in the resized image.
+ *              out_w: Width of output rectangle.
+ *              out_h: Height of output rectangle.
+ *              flags: Zero or more of TCV_ZOOM_RECT_*, or'd together.
+ *             filter: Filter type (TCV_ZOOM_*).
+ * Return value: Nonzero on success, zero on error (invalid parameters).
+ * Preconditions: handle != 0: handle was returned by tcv_init()
+ *                src != NULL: the source rectangle is readable
+ *                dest != NULL: dest[0]..dest[(out_h-1)*dest_stride
+ *                              + out_w*Bpp - 1] are writable
+ *                src != dest: source and destination do not overlap
+ * Postconditions: (on success) the output rectangle is stored at dest
+ */
+
+int tcv_zoom_rect(TCVHandle handle,
+                  const uint8_t *src, int src_stride, int width, int height,
+                  uint8_t *dest, int dest_stride, int Bpp,
+                  int new_w, int new_h,
+                  int out_x, int out_y, int out_w, int out_h,
+                  int flags, TCVZoomFilter filter)
+{
+    ZoomInfo *zi;
+    int free_zi = 0;
+
+    if (!src || !dest || width <= 0 || height <= 0 || (Bpp != 1 && Bpp != 3)
+     || src_stride < width*Bpp || dest_stride < out_w*Bpp
+    ) {
+        tc_log_error("libtcvideo", "tcv_zoom_rect: invalid frame"
+                     " parameters!");
+        return 0;
+    }
+    if (new_w <= 0 || new_h <= 0 || out_x < 0 || out_y < 0
+     || out_w <= 0 || out_h <= 0
+     || out_x + out_w > new_w || out_y + out_h > new_h
+    ) {
+        tc_log_error("libtcvideo", "tcv_zoom_rect: invalid target"
+                     " rectangle %dx%d+%d+%d of %dx%d!",
+                     out_w, out_h, out_x, out_y, new_w, new_h);
+        return 0;
+    }
+    if (new_w == width && new_h == height) {
+        filter = TCV_ZOOM_BOX;  /* not used, any valid one will do */
+    } else if (!check_zoom_filter("tcv_zoom_rect", filter)) {
+        return 0;
+    }
+
+    if (flags & TCV_ZOOM_RECT_FLIP_V) {
+        dest += (out_h-1) * dest_stride;
+        dest_stride = -dest_stride;
+    }
+    zi = get_zoominfo(handle, width, height, new_w, new_h, Bpp,
+                      src_stride, dest_stride, out_x, out_w,
+                      flags & TCV_ZOOM_RECT_FLIP_H, filter, &free_zi);
+    if (!zi) {
+        tc_log_error("libtcvideo", "tcv_zoom_rect: zoom_init() failed!");
+        return 0;
+    }
+    zoom_sliced(handle, zi, src, dest, dest_stride, out_y, out_y + out_h);
+    if (free_zi)
+        zoom_free(zi);
+    return 1;
+}
+
+
+/* Helper functions: */
+
+/* Check that the given filter is one tcv_zoom() accepts, logging an
+ * error (as from function `func') if not. */
+static int check_zoom_filter(const char *func, TCVZoomFilter filter)
+{
     switch (filter) {
       case TCV_ZOOM_BOX:
       case TCV_ZOOM_TRIANGLE:
@@ -586,64 +780,117 @@ int tcv_zoom(TCVHandle handle,
       case TCV_ZOOM_B_SPLINE:
       case TCV_ZOOM_MITCHELL:
       case TCV_ZOOM_LANCZOS3:
-        break;
+        return 1;
       default:
-        tc_log_error("libtcvideo", "tcv_zoom: invalid filter %d!", filter);
+        tc_log_error("libtcvideo", "%s: invalid filter %d!", func, filter);
         return 0;
     }
+}
+
+/* Look up a ZoomInfo for the given zoom_init() parameters in the cache,
+ * creating it (and caching it if there is room) if not found.
+ * *free_ret is set nonzero if the caller must free the result. */
+static ZoomInfo *get_zoominfo(TCVHandle handle, int old_w, int old_h,
+                              int new_w, int new_h, int Bpp,
+                              int old_stride, int new_stride,
+                              int out_x, int out_w, int mirror,
+                              TCVZoomFilter filter, int *free_ret)
+{
+    ZoomInfo *zi;
+    int i;
 
-    for (i = 0, zi = NULL; i < ZOOMINFO_CACHE_SIZE && zi == NULL; i++) {
-        if (handle->zoominfo_cache[i].zi     != NULL
-         && handle->zoominfo_cache[i].old_w  == width
-         && handle->zoominfo_cache[i].old_h  == height
-         && handle->zoominfo_cache[i].new_w  == new_w
-         && handle->zoominfo_cache[i].new_h  == new_h
-         && handle->zoominfo_cache[i].Bpp    == Bpp
-         && handle->zoominfo_cache[i].ilace  == interlace_mode
-         && handle->zoominfo_cache[i].filter == filter
+    mirror = (mirror != 0);
+    *free_ret = 0;
+    for (i = 0; i < ZOOMINFO_CACHE_SIZE; i++) {
+        if (handle->zoominfo_cache[i].zi         != NULL
+         && handle->zoominfo_cache[i].old_w      == old_w
+         && handle->zoominfo_cache[i].old_h      == old_h
+         && handle->zoominfo_cache[i].new_w      == new_w
+         && handle->zoominfo_cache[i].new_h      == new_h
+         && handle->zoominfo_cache[i].Bpp        == Bpp
+         && handle->zoominfo_cache[i].old_stride == old_stride
+         && handle->zoominfo_cache[i].new_stride == new_stride
+         && handle->zoominfo_cache[i].out_x      == out_x
+         && handle->zoominfo_cache[i].out_w      == out_w
+         && handle->zoominfo_cache[i].mirror     == mirror
+         && handle->zoominfo_cache[i].filter     == filter
         ) {
-            zi = handle->zoominfo_cache[i].zi;
+            return handle->zoominfo_cache[i].zi;
         }
     }
-    if (!zi) {
-        int ilace_height = height;
-        int ilace_new_h = new_h;
-        int old_stride = width * Bpp;
-        int new_stride = new_w * Bpp;
-        if (interlace_mode) {
-            ilace_height /= 2;
-            ilace_new_h /= 2;
-            old_stride *= 2;
-            new_stride *= 2;
-        }
-        zi = zoom_init(width, ilace_height, new_w, ilace_new_h, Bpp,
-                       old_stride, new_stride, filter);
-        if (!zi) {
-            tc_log_error("libtcvideo", "tcv_zoom: zoom_init() failed!");
-            return 0;
-        }
-        free_zi = 1;
-        for (i = 0; i < ZOOMINFO_CACHE_SIZE; i++) {
-            if (!handle->zoominfo_cache[i].zi) {
-                handle->zoominfo_cache[i].zi     = zi;
-                handle->zoominfo_cache[i].old_w  = width;
-                handle->zoominfo_cache[i].old_h  = height;
-                handle->zoominfo_cache[i].new_w  = new_w;
-                handle->zoominfo_cache[i].new_h  = new_h;
-                handle->zoominfo_cache[i].Bpp    = Bpp;
-                handle->zoominfo_cache[i].ilace  = interlace_mode;
-                handle->zoominfo_cache[i].filter = filter;
-                free_zi = 0;
-                break;
-            }
+
+    zi = zoom_init(old_w, old_h, new_w, new_h, Bpp, old_stride, new_stride,
+                   out_x, out_w, mirror, filter);
+    if (!zi)
+        return NULL;
+    *free_ret = 1;
+    for (i = 0; i < ZOOMINFO_CACHE_SIZE; i++) {
+        if (!handle->zoominfo_cache[i].zi) {
+            handle->zoominfo_cache[i].zi         = zi;
+            handle->zoominfo_cache[i].old_w      = old_w;
+            handle->zoominfo_cache[i].old_h      = old_h;
+            handle->zoominfo_cache[i].new_w      = new_w;
+            handle->zoominfo_cache[i].new_h      = new_h;
+            handle->zoominfo_cache[i].Bpp        = Bpp;
+            handle->zoominfo_cache[i].old_stride = old_stride;
+            handle->zoominfo_cache[i].new_stride = new_stride;
+            handle->zoominfo_cache[i].out_x      = out_x;
+            handle->zoominfo_cache[i].out_w      = out_w;
+            handle->zoominfo_cache[i].mirror     = mirror;
+            handle->zoominfo_cache[i].filter     = filter;
+            *free_ret = 0;
+            break;
         }
     }
-    zoom_process(zi, src, dest);
-    if (interlace_mode)
-        zoom_process(zi, src + width*Bpp, dest + new_w*Bpp);
-    if (free_zi)
-        zoom_free(zi);
-    return 1;
+    return zi;
+}
+
+struct zoom_job {
+    const ZoomInfo *zi;
+    const uint8_t *src;
+    uint8_t *dest;
+    int new_stride;
+    int y0, y1;
+    uint8_t *buffer;            /* One zoom_buffer_size() buffer per slice */
+    int bufsize;
+};
+
+static void zoom_slice(void *arg, int slice, int nslices)
+{
+    struct zoom_job *job = arg;
+    int y0, y1;
+
+    slice_rows(job->y1 - job->y0, slice, nslices, 1, &y0, &y1);
+    zoom_process_band(job->zi, job->src, job->dest + y0 * job->new_stride,
+                      job->y0 + y0, job->y0 + y1,
+                      job->buffer + slice * job->bufsize);
+}
+
+/* Each band of the resized image is made from its own band of the
+ * original one, so the bands are resized independently; each slice only
+ * needs a buffer of its own.  Rows [y0,y1) of the resized image are
+ * stored, starting at `dest'. */
+static void zoom_sliced(TCVHandle handle, const ZoomInfo *zi,
+                        const uint8_t *src, uint8_t *dest, int new_stride,
+                        int y0, int y1)
+{
+    int nslices = slice_count(handle, y1 - y0);
+    int bufsize = zoom_buffer_size(zi);
+    uint32_t size = (uint32_t)bufsize * nslices;
+
+    if (nslices > 1
+     && (!handle->zoom_buffer || handle->zoom_buffer_size < size)) {
+        free(handle->zoom_buffer);
+        handle->zoom_buffer = tc_malloc(size);
+        handle->zoom_buffer_size = handle->zoom_buffer ? size : 0;
+    }
+    if (nslices <= 1 || !handle->zoom_buffer) {
+        zoom_process_band(zi, src, dest, y0, y1, NULL);
+    } else {
+        struct zoom_job job = { zi, src, dest, new_stride, y0, y1,
+                                handle->zoom_buffer, bufsize };
+        run_slices(handle, zoom_slice, &job, nslices);
+    }
 }
 
 /*************************************************************************/
@@ -878,11 +1125,19 @@ int tcv_gamma_correct(TCVHandle handle,
 static void antialias_line(TCVHandle handle,
                            uint8_t *src, uint8_t *dest, int width, int Bpp);
 
+struct antialias_job {
+    TCVHandle handle;
+    uint8_t *src, *dest;
+    int width, height, Bpp;
+};
+
+static void antialias_slice(void *arg, int slice, int nslices);
+
 int tcv_antialias(TCVHandle handle,
                   uint8_t *src, uint8_t *dest, int width, int height,
                   int Bpp, double weight, double bias)
 {
-    int y;
+    int y, nslices;
 
     if (!src || !dest || width <= 0 || height <= 0 || (Bpp != 1 && Bpp != 3)) {
         tc_log_error("libtcvideo", "tcv_antialias: invalid frame parameters!");
@@ -896,9 +1151,15 @@ int tcv_antialias(TCVHandle handle,
 
     init_aa_table(handle, weight, bias);
     ac_memcpy(dest, src, width*Bpp);
-    for (y = 1; y < height-1; y++) {
-        antialias_line(handle, src + y*width*Bpp, dest + y*width*Bpp, width,
-                       Bpp);
+    nslices = slice_count(handle, height-2);
+    if (nslices <= 1) {
+        for (y = 1; y < height-1; y++) {
+            antialias_line(handle, src + y*width*Bpp, dest + y*width*Bpp,
+                           width, Bpp);
+        }
+    } else {
+        struct antialias_job job = { handle, src, dest, width, height, Bpp };
+        run_slices(handle, antialias_slice, &job, nslices);
     }
     ac_memcpy(dest + (height-1)*width*Bpp, src + (height-1)*width*Bpp,
               width*Bpp);
@@ -968,6 +1229,33 @@ static void antialias_line(TCVHandle handle,
         dest[(width-1)*Bpp+i] = src[(width-1)*Bpp+i];
 }
 
+#undef C
+#undef U
+#undef D
+#undef L
+#undef R
+#undef UL
+#undef UR
+#undef DL
+#undef DR
+#undef SAME
+#undef DIFF
+
+/* Each line only reads its neighbours from `src', so slices of lines
+ * are independent. */
+static void antialias_slice(void *arg, int slice, int nslices)
+{
+    struct antialias_job *job = arg;
+    int stride = job->width * job->Bpp;
+    int y0, y1, y;
+
+    slice_rows(job->height-2, slice, nslices, 1, &y0, &y1);
+    for (y = y0+1; y < y1+1; y++) {
+        antialias_line(job->handle, job->src + y*stride, job->dest + y*stride,
+                       job->width, job->Bpp);
+    }
+}
+
 /*************************************************************************/
 
 /**
@@ -988,12 +1276,22 @@ static void antialias_line(TCVHandle handle,
  * Postconditions: None.
  */
 
+struct convert_job {
+    uint8_t *src, *dest;
+    int width, height;
+    ImageFormat srcfmt, destfmt;
+    int ok[TCV_MAX_THREADS];    /* Result of each slice */
+};
+
+static void convert_slice(void *arg, int slice, int nslices);
+
 int tcv_convert(TCVHandle handle, uint8_t *src, uint8_t *dest, int width,
                 int height, ImageFormat srcfmt, ImageFormat destfmt)
 {
     uint8_t *realdest;  // either dest or the temporary buffer
     uint8_t *srcplanes[3], *destplanes[3];
     uint32_t size;
+    int nslices;
 
     if (!handle) {
         tc_log_error("libtcvideo", "tcv_convert(): No handle given!");
@@ -1045,10 +1343,23 @@ int tcv_convert(TCVHandle handle, uint8_t *src, uint8_t *dest, int width,
         realdest = dest;
     }
 
-    YUV_INIT_PLANES(srcplanes, src, srcfmt, width, height);
-    YUV_INIT_PLANES(destplanes, realdest, destfmt, width, height);
-    if (!ac_imgconvert(srcplanes, srcfmt, destplanes, destfmt, width, height))
-        return 0;
+    nslices = slice_count(handle, height);
+    if (nslices <= 1) {
+        YUV_INIT_PLANES(srcplanes, src, srcfmt, width, height);
+        YUV_INIT_PLANES(destplanes, realdest, destfmt, width, height);
+        if (!ac_imgconvert(srcplanes, srcfmt, destplanes, destfmt,
+                           width, height))
+            return 0;
+    } else {
+        struct convert_job job = { src, realdest, width, height,
+                                   srcfmt, destfmt, { 0 } };
+        int i;
+        run_slices(handle, convert_slice, &job, nslices);
+        for (i = 0; i < nslices; i++) {
+            if (!job.ok[i])
+                return 0;
+        }
+    }
 
     if (src == dest)
         ac_memcpy(src, handle->convert_buffer, size);
@@ -1056,6 +1367,54 @@ int tcv_convert(TCVHandle handle, uint8_t *src, uint8_t *dest, int width,
     return 1;
 }
 
+
+/* Helper functions: */
+
+/* Set up `planes' for the band of an image starting at row `y0'. */
+static void band_planes(uint8_t **planes, uint8_t *buffer, ImageFormat fmt,
+                        int width, int height, int y0)
+{
+    int luma = 0, chroma = 0;  // offsets in the Y (or only) and U/V planes
+
+    switch (fmt) {
+        case IMG_YUV420P:
+        case IMG_YV12   : luma = y0*width; chroma = (y0/2)*(width/2); break;
+        case IMG_YUV411P: luma = y0*width; chroma = y0*(width/4); break;
+        case IMG_YUV422P: luma = y0*width; chroma = y0*(width/2); break;
+        case IMG_YUV444P: luma = y0*width; chroma = y0*width; break;
+        case IMG_YUY2   :
+        case IMG_UYVY   :
+        case IMG_YVYU   : luma = y0*width*2; break;
+        case IMG_Y8     :
+        case IMG_GRAY8  : luma = y0*width; break;
+        case IMG_RGB24  :
+        case IMG_BGR24  : luma = y0*width*3; break;
+        default         : luma = y0*width*4; break;
+    }
+    YUV_INIT_PLANES(planes, buffer, fmt, width, height);
+    planes[0] += luma;
+    planes[1] += chroma;
+    planes[2] += chroma;
+}
+
+/* Conversions work on pairs of rows at most (4:2:0 chroma), so slices
+ * starting on even rows are independent. */
+static void convert_slice(void *arg, int slice, int nslices)
+{
+    struct convert_job *job = arg;
+    uint8_t *srcplanes[3], *destplanes[3];
+    int y0, y1;
+
+    slice_rows(job->height, slice, nslices, 2, &y0, &y1);
+    band_planes(srcplanes, job->src, job->srcfmt,
+                job->width, job->height, y0);
+    band_planes(destplanes, job->dest, job->destfmt,
+                job->width, job->height, y0);
+    job->ok[slice] = ac_imgconvert(srcplanes, job->srcfmt,
+                                   destplanes, job->destfmt,
+                                   job->width, y1 - y0);
+}
+
 /*************************************************************************/
 /*************************************************************************/
 
@@ -1212,6 +1571,68 @@ static void init_aa_table(TCVHandle handle, double aa_weight, double aa_bias)
     }
 }
 
+/*************************************************************************/
+
+/**
+ * slice_count:  Return the number of slices to split an operation on
+ * `rows' rows into.
+ *
+ * Parameters: handle: tcvideo handle.
+ *               rows: Number of rows to process.
+ * Return value: Number of slices, between 1 and the number of threads.
+ */
+
+static int slice_count(TCVHandle handle, int rows)
+{
+    int n = rows / TCV_MIN_SLICE_ROWS;
+    int nthreads = tc_workers_threads(handle->workers);
+    return (n < 1) ? 1 : (n > nthreads) ? nthreads : n;
+}
+
+/*************************************************************************/
+
+/**
+ * run_slices:  Run `func' on `nslices' slices on the slice threads and the
+ * calling thread, and wait for all of them to finish.
+ *
+ * Parameters: handle: tcvideo handle.
+ *               func: Function to run.
+ *                arg: Argument to pass to `func'.
+ *            nslices: Number of slices, as returned by slice_count().
+ * Return value: None.
+ */
+
+static void run_slices(TCVHandle handle, SliceFunc func, void *arg,
+                       int nslices)
+{
+    tc_workers_run(handle->workers, func, arg, nslices);
+}
+
+/*************************************************************************/
+
+/**
+ * slice_rows:  Compute the rows [*y0,*y1) of a slice.
+ *
+ * Parameters:   rows: Total number of rows.
+ *              slice: Slice number.
+ *            nslices: Number of slices.
+ *              align: Slices other than the first start on a multiple of
+ *                     this many rows.
+ *                 y0: Set to the first row of the slice.
+ *                 y1: Set to the row after the last row of the slice.
+ * Return value: None.
+ */
+
+static void slice_rows(int rows, int slice, int nslices, int align,
+                       int *y0, int *y1)
+{
+    *y0 = (int)((long)rows * slice / nslices) / align * align;
+    if (slice == nslices-1)
+        *y1 = rows;
+    else
+        *y1 = (int)((long)rows * (slice+1) / nslices) / align * align;
+}
+
 /*************************************************************************/
 /*************************************************************************/
 
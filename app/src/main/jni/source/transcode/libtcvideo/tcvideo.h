@@ -34,6 +34,10 @@ typedef enum {
     TCV_DEINTERLACE_LINEAR_BLEND,
 } TCVDeinterlaceMode;
 
+/* Flags for tcv_zoom_rect(): */
+#define TCV_ZOOM_RECT_FLIP_V    1       /* Store the rows bottom to top */
+#define TCV_ZOOM_RECT_FLIP_H    2       /* Store the columns right to left */
+
 /* Filter IDs for tcv_zoom(): */
 typedef enum {
     TCV_ZOOM_DEFAULT = 0, /* alias for an existing following id */
@@ -55,6 +59,8 @@ TCVHandle tcv_init(void);
 
 void tcv_free(TCVHandle handle);
 
+int tcv_set_threads(TCVHandle handle, int threads);
+
 int tcv_clip(TCVHandle handle,
              uint8_t *src, uint8_t *dest, int width, int height, int Bpp,
              int clip_left, int clip_right, int clip_top, int clip_bottom,
@@ -72,6 +78,13 @@ int tcv_zoom(TCVHandle handle,
              uint8_t *src, uint8_t *dest, int width, int height, int Bpp,
              int new_w, int new_h, TCVZoomFilter filter);
 
+int tcv_zoom_rect(TCVHandle handle,
+                  const uint8_t *src, int src_stride, int width, int height,
+                  uint8_t *dest, int dest_stride, int Bpp,
+                  int new_w, int new_h,
+                  int out_x, int out_y, int out_w, int out_h,
+                  int flags, TCVZoomFilter filter);
+
 int tcv_reduce(TCVHandle handle,
                uint8_t *src, uint8_t *dest, int width, int height, int Bpp,
                int reduce_w, int reduce_h);
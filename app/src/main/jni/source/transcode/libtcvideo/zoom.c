@@ -14,41 +14,62 @@
 #include "src/transcode.h"
 #include <math.h>
 
+#if defined(__SSE2__)
+# define ZOOM_SSE2
+# include <emmintrin.h>
+#elif defined(__GNUC__) \
+   && (defined(__ARM_NEON) || defined(__ARM_NEON__) || defined(__ALTIVEC__))
+# define ZOOM_VECTOR
+#endif
+
 /*************************************************************************/
 
 /* Data structures for holding resizing data (used internally). */
 
-/* A contributor to a single pixel */
-struct contrib {
-    int pixel;
-    double weight;
-};
-
-/* List of all contributors to a single pixel */
-struct clist {
-    int n;                      /* Number of contributors */
-    struct contrib *list;       /* Pointer to list of contributors */
+/* Filter weights are fixed-point values with WEIGHT_BITS fractional bits.
+ * Both they and the pixel values fit in 16 bits, so that the SIMD
+ * routines can use 16x16->32 bit multiplies. */
+#define WEIGHT_BITS     14
+#define WEIGHT_ONE      (1 << WEIGHT_BITS)
+
+/* Contributors to the pixels of one direction (horizontal or vertical),
+ * as a structure of arrays: resized pixel i is made from the `taps'
+ * consecutive original pixels starting at start[i], with the weights
+ * weight[i*taps] through weight[i*taps+taps-1].  Every pixel has the
+ * same number of taps; the ones beyond the filter support have weight 0.
+ * Pixel indices outside the original image are reflected back into it
+ * (see reflect()). */
+struct contribs {
+    int taps;                   /* Number of contributors per pixel */
+    int32_t *start;             /* First contributor of each pixel */
+    int16_t *weight;            /* Weights of all contributors */
 };
 
 /* Data for a resize operation */
 struct zoominfo {
     int old_w, old_h;           /* Original width and height */
     int new_w, new_h;           /* New width and height */
+    int out_x, out_w;           /* Columns of the resized image to store */
     int Bpp;                    /* Bytes per pixel */
     int old_stride;             /* Bytes per line (original image) */
     int new_stride;             /* Bytes per line (new image) */
     double (*filter)(double);   /* Filter function */
     double fwidth;              /* Filter width */
-    int32_t *x_contrib;         /* Contributors in the horizontal direction */
-    int32_t *y_contrib;         /* Contributors in the vertical direction */
-    uint8_t *tmpimage;          /* Temporary buffer */
+    struct contribs x;          /* Horizontal contributors of the stored
+                                 *    columns (taps==0: none, out_x is
+                                 *    then an offset into the original) */
+    struct contribs y;          /* Vertical contributors (taps==0: none) */
+    int x_pad;                  /* Pixels of reflected border before and */
+    int x_padded_w;             /*    width of a padded original row     */
+    int bufsize;                /* Size of a band buffer */
+    uint8_t *buffer;            /* Band buffer for zoom_process() */
 };
 
-/* Convert a double to a 16.16 fixed-point value */
-#define DOUBLE_TO_FIXED(v) ((int32_t)((v)*65536))
+/* Round a buffer offset up to a multiple of 16 bytes */
+#define ALIGN16(n)      (((n) + 15) & ~15)
 
-/* Convert a 16.16 fixed-point value to an integer */
-#define FIXED_TO_INT(v) ((v)>>16)
+/* clamp the input to the specified range */
+#define CLAMP(v,l,h)    ((v)<(l) ? (l) : (v) > (h) ? (h) : (v))
 
 /*************************************************************************/
 
@@ -321,38 +342,60 @@ static double sinc8_filter(double t)
 /*************************************************************************/
 
 /**
- * gen_contrib:  Helper function to generate the list of contributors to
- * each resized pixel in one direction (horizontal or vertical).
+ * reflect:  Map a pixel index outside the image back into it, the way
+ * the contributor lists always have.
+ *
+ * Parameters:
+ *     n: Pixel index.
+ *  size: Number of pixels in the direction concerned.
+ * Return value:
+ *     The pixel index to use.
+ */
+
+static int reflect(int n, int size)
+{
+    if (n < 0)
+        n = -n;
+    if (n >= size)
+        n = (size - n) + size - 1;
+    return CLAMP(n, 0, size-1);
+}
+
+/*************************************************************************/
+
+/**
+ * gen_contrib:  Helper function to generate the contributors to each
+ * resized pixel in one direction (horizontal or vertical).  The weights
+ * of each pixel are normalized so that they add up to exactly WEIGHT_ONE
+ * after rounding, so that flat areas stay flat.
  *
  * Parameters:
  *     oldsize: Size of original image in the direction for which
  *              contributors are being generated.
  *     newsize: Size of resized image in the direction for which
  *              contributors are being generated.
- *      stride: Number of bytes between adjacent pixels in the direction
- *              for which contributors are being generated.
  *      filter: As for zoom_process().
  *      fwidth: As for zoom_process().
+ *       align: The number of taps is rounded up to a multiple of this.
+ *     contrib: Structure to fill in.
  * Return value:
- *     A pointer to a `newsize'-element array of `struct clist' elements,
- *     or NULL on error (out of memory).
+ *     Nonzero on success, zero on error (out of memory).
  * Preconditions:
  *     oldsize > 0
  *     newsize > 0
- *     stride > 0
  *     filter != NULL
  *     fwidth > 0
+ *     align > 0
  */
 
-static struct clist *gen_contrib(int oldsize, int newsize, int stride,
-                                 double (*filter)(double), double fwidth)
+static int gen_contrib(int oldsize, int newsize,
+                       double (*filter)(double), double fwidth, int align,
+                       struct contribs *contrib)
 {
-    struct clist *contrib;
     double scale = (double)newsize / (double)oldsize;
     double new_fwidth, fscale;
-    int i, j;
-
-    contrib = tc_zalloc(newsize * sizeof(struct clist));
+    double *weights;
+    int taps, i, j;
 
     if (scale < 1.0) {
         fscale = 1.0 / scale;
@@ -360,30 +403,298 @@ static struct clist *gen_contrib(int oldsize, int newsize, int stride,
         fscale = 1.0;
     }
     new_fwidth = fwidth * fscale;
-    for (i = 0; i < newsize; ++i) {
+
+    taps = 1;
+    for (i = 0; i < newsize; i++) {
         double center = (double) i / scale;
         int left = ceil(center - new_fwidth);
         int right = floor(center + new_fwidth);
-        contrib[i].n = 0;
-        contrib[i].list = tc_zalloc((right-left+1) * sizeof(struct contrib));
-        for (j = left; j <= right; ++j) {
-            int k, n;
+        if (right - left + 1 > taps)
+            taps = right - left + 1;
+    }
+    taps = (taps + align-1) / align * align;
+
+    contrib->taps = taps;
+    contrib->start = tc_malloc(newsize * sizeof(*contrib->start));
+    contrib->weight = tc_zalloc(newsize * taps * sizeof(*contrib->weight));
+    weights = tc_malloc(taps * sizeof(*weights));
+    if (!contrib->start || !contrib->weight || !weights) {
+        free(weights);
+        return 0;
+    }
+
+    for (i = 0; i < newsize; i++) {
+        double center = (double) i / scale;
+        int left = ceil(center - new_fwidth);
+        int right = floor(center + new_fwidth);
+        int16_t *out = contrib->weight + i*taps;
+        double sum = 0;
+        int total = 0, biggest = 0;
+
+        for (j = left; j <= right; j++) {
             double weight = center - (double) j;
             weight = (*filter)(weight / fscale) / fscale;
-            if (j < 0) {
-                n = -j;
-            } else if (j >= oldsize) {
-                n = (oldsize - j) + oldsize - 1;
-            } else {
-                n = j;
+            weights[j-left] = weight;
+            sum += weight;
+        }
+        if (sum == 0)
+            sum = 1;
+        for (j = 0; j <= right - left; j++) {
+            int w = (int)floor(weights[j] / sum * WEIGHT_ONE + 0.5);
+            out[j] = CLAMP(w, -32768, 32767);
+            total += out[j];
+            if (abs(out[j]) > abs(out[biggest]))
+                biggest = j;
+        }
+        out[biggest] += WEIGHT_ONE - total;
+        contrib->start[i] = left;
+    }
+
+    free(weights);
+    return 1;
+}
+
+/*************************************************************************/
+
+/**
+ * window_contrib:  Helper function to reduce a list of contributors to
+ * those of the pixels actually stored, optionally in reverse order.
+ *
+ * Parameters:
+ *     contrib: Contributor list to modify.
+ *       first: Index of the first pixel to keep.
+ *       count: Number of pixels to keep.
+ *     reverse: Nonzero to store the pixels in reverse order.
+ * Return value:
+ *     None.
+ * Preconditions:
+ *     contrib was filled in by gen_contrib()
+ *     first >= 0
+ *     count > 0
+ *     first + count <= number of pixels in the list
+ */
+
+static void window_contrib(struct contribs *contrib, int first, int count,
+                           int reverse)
+{
+    const int taps = contrib->taps;
+    int i;
+
+    if (reverse) {
+        for (i = 0; i < count/2; i++) {
+            int a = first + i, b = first + count-1 - i, j;
+            int32_t tmp = contrib->start[a];
+            contrib->start[a] = contrib->start[b];
+            contrib->start[b] = tmp;
+            for (j = 0; j < taps; j++) {
+                int16_t w = contrib->weight[a*taps+j];
+                contrib->weight[a*taps+j] = contrib->weight[b*taps+j];
+                contrib->weight[b*taps+j] = w;
             }
-            k = contrib[i].n++;
-            contrib[i].list[k].pixel = n*stride;
-            contrib[i].list[k].weight = weight;
         }
     }
+    if (first > 0) {
+        memmove(contrib->start, contrib->start + first,
+                count * sizeof(*contrib->start));
+        memmove(contrib->weight, contrib->weight + first*taps,
+                count * taps * sizeof(*contrib->weight));
+    }
+}
 
-    return contrib;
+/*************************************************************************/
+/*************************************************************************/
+
+/* Filter kernels.  Each computes a row of the resized image from the
+ * original pixels; there is a plain C version of each and, where it
+ * pays, SIMD versions. */
+
+/*************************************************************************/
+
+/**
+ * zoom_row_x:  Resize one row horizontally.
+ *
+ * Parameters:
+ *       zi: ZoomInfo structure.
+ *      src: Original row.
+ *   padrow: Buffer for the row with its reflected borders.
+ *     dest: Resized row.
+ * Return value: None.
+ */
+
+static void zoom_row_x(const ZoomInfo *zi, const uint8_t *src,
+                       uint8_t *padrow, uint8_t *dest)
+{
+    const int Bpp = zi->Bpp, taps = zi->x.taps;
+    const int16_t *weight = zi->x.weight;
+    int x, i;
+
+    /* Copy the row, adding the reflected borders so that the
+     * contributors to each pixel are contiguous */
+    ac_memcpy(padrow + zi->x_pad*Bpp, src, zi->old_w*Bpp);
+    for (x = 0; x < zi->x_padded_w; x++) {
+        if (x == zi->x_pad)
+            x += zi->old_w;
+        if (x < zi->x_padded_w) {
+            ac_memcpy(padrow + x*Bpp,
+                      src + reflect(x - zi->x_pad, zi->old_w)*Bpp, Bpp);
+        }
+    }
+    padrow += zi->x_pad * Bpp;
+
+    if (Bpp == 1) {
+        for (x = 0; x < zi->out_w; x++, weight += taps) {
+            const uint8_t *from = padrow + zi->x.start[x];
+            int32_t sum;
+#ifdef ZOOM_SSE2
+            __m128i acc = _mm_setzero_si128();
+            for (i = 0; i < taps; i += 8) {
+                __m128i pixels = _mm_loadl_epi64((const __m128i *)(from+i));
+                pixels = _mm_unpacklo_epi8(pixels, _mm_setzero_si128());
+                acc = _mm_add_epi32(acc, _mm_madd_epi16(pixels,
+                          _mm_loadu_si128((const __m128i *)(weight+i))));
+            }
+            acc = _mm_add_epi32(acc, _mm_shuffle_epi32(acc, 0x4E));
+            acc = _mm_add_epi32(acc, _mm_shuffle_epi32(acc, 0xB1));
+            sum = _mm_cvtsi128_si32(acc) + WEIGHT_ONE/2;
+#else
+            sum = WEIGHT_ONE/2;
+            for (i = 0; i < taps; i++)
+                sum += from[i] * weight[i];
+#endif
+            sum >>= WEIGHT_BITS;
+            dest[x] = CLAMP(sum, 0, 255);
+        }
+    } else if (Bpp == 3) {
+        for (x = 0; x < zi->out_w; x++, weight += taps, dest += 3) {
+            const uint8_t *from = padrow + zi->x.start[x]*3;
+            int32_t sum0 = WEIGHT_ONE/2, sum1 = WEIGHT_ONE/2,
+                    sum2 = WEIGHT_ONE/2;
+            for (i = 0; i < taps; i++, from += 3) {
+                sum0 += from[0] * weight[i];
+                sum1 += from[1] * weight[i];
+                sum2 += from[2] * weight[i];
+            }
+            sum0 >>= WEIGHT_BITS;
+            sum1 >>= WEIGHT_BITS;
+            sum2 >>= WEIGHT_BITS;
+            dest[0] = CLAMP(sum0, 0, 255);
+            dest[1] = CLAMP(sum1, 0, 255);
+            dest[2] = CLAMP(sum2, 0, 255);
+        }
+    } else {
+        for (x = 0; x < zi->out_w; x++, weight += taps) {
+            int c;
+            for (c = 0; c < Bpp; c++, dest++) {
+                const uint8_t *from = padrow + zi->x.start[x]*Bpp + c;
+                int32_t sum = WEIGHT_ONE/2;
+                for (i = 0; i < taps; i++, from += Bpp)
+                    sum += *from * weight[i];
+                sum >>= WEIGHT_BITS;
+                *dest = CLAMP(sum, 0, 255);
+            }
+        }
+    }
+}
+
+/*************************************************************************/
+
+/**
+ * zoom_row_y:  Compute one resized row from the rows contributing to it.
+ *
+ * Parameters:
+ *     rows: Contributing rows.
+ *   weight: Weights of the contributing rows.
+ *     taps: Number of contributing rows (even).
+ *     dest: Resized row.
+ *      len: Number of bytes in a row.
+ * Return value: None.
+ */
+
+static void zoom_row_y(const uint8_t **rows, const int16_t *weight,
+                       int taps, uint8_t *dest, int len)
+{
+    int x = 0, i;
+
+#if defined(ZOOM_SSE2)
+
+    /* 16 bytes at a time, two rows per multiply: PMADDWD takes the
+     * interleaved pixels of rows i and i+1 and the weight pair, which is
+     * laid out the same way in weight[] */
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i round = _mm_set1_epi32(WEIGHT_ONE/2);
+    for (; x+16 <= len; x += 16) {
+        __m128i acc0 = round, acc1 = round, acc2 = round, acc3 = round;
+        for (i = 0; i < taps; i += 2) {
+            int32_t pair;
+            __m128i w, a, b, alo, ahi, blo, bhi;
+            memcpy(&pair, weight+i, 4);
+            w = _mm_set1_epi32(pair);
+            a = _mm_loadu_si128((const __m128i *)(rows[i]+x));
+            b = _mm_loadu_si128((const __m128i *)(rows[i+1]+x));
+            alo = _mm_unpacklo_epi8(a, zero);
+            ahi = _mm_unpackhi_epi8(a, zero);
+            blo = _mm_unpacklo_epi8(b, zero);
+            bhi = _mm_unpackhi_epi8(b, zero);
+            acc0 = _mm_add_epi32(acc0,
+                       _mm_madd_epi16(_mm_unpacklo_epi16(alo, blo), w));
+            acc1 = _mm_add_epi32(acc1,
+                       _mm_madd_epi16(_mm_unpackhi_epi16(alo, blo), w));
+            acc2 = _mm_add_epi32(acc2,
+                       _mm_madd_epi16(_mm_unpacklo_epi16(ahi, bhi), w));
+            acc3 = _mm_add_epi32(acc3,
+                       _mm_madd_epi16(_mm_unpackhi_epi16(ahi, bhi), w));
+        }
+        acc0 = _mm_srai_epi32(acc0, WEIGHT_BITS);
+        acc1 = _mm_srai_epi32(acc1, WEIGHT_BITS);
+        acc2 = _mm_srai_epi32(acc2, WEIGHT_BITS);
+        acc3 = _mm_srai_epi32(acc3, WEIGHT_BITS);
+        _mm_storeu_si128((__m128i *)(dest+x),
+                         _mm_packus_epi16(_mm_packs_epi32(acc0, acc1),
+                                          _mm_packs_epi32(acc2, acc3)));
+    }
+
+#elif defined(ZOOM_VECTOR)
+
+    /* 16 bytes at a time with generic vector operations; byte 4*k+j of
+     * the 16 goes to lane k of acc[j], which leaves them out of order
+     * but needs only shifts and masks to unpack and pack back */
+    typedef int32_t v4si __attribute__((vector_size(16)));
+    typedef uint32_t v4su __attribute__((vector_size(16)));
+    for (; x+16 <= len; x += 16) {
+        v4si acc[4];
+        v4su out;
+        int j;
+        for (j = 0; j < 4; j++)
+            acc[j] = (v4si){WEIGHT_ONE/2, WEIGHT_ONE/2,
+                            WEIGHT_ONE/2, WEIGHT_ONE/2};
+        for (i = 0; i < taps; i++) {
+            const v4si w = {weight[i], weight[i], weight[i], weight[i]};
+            v4su p;
+            memcpy(&p, rows[i]+x, 16);
+            acc[0] += (v4si)(p & 255) * w;
+            acc[1] += (v4si)((p >> 8) & 255) * w;
+            acc[2] += (v4si)((p >> 16) & 255) * w;
+            acc[3] += (v4si)(p >> 24) * w;
+        }
+        out = (v4su){0, 0, 0, 0};
+        for (j = 0; j < 4; j++) {
+            v4si v = acc[j] >> WEIGHT_BITS;
+            v &= ~(v >> 31);                    /* max(v, 0) */
+            v |= (255 - v) >> 31;               /* min(v, 255), in 8 bits */
+            out |= ((v4su)v & 255) << (8*j);
+        }
+        memcpy(dest+x, &out, 16);
+    }
+
+#endif
+
+    for (; x < len; x++) {
+        int32_t sum = WEIGHT_ONE/2;
+        for (i = 0; i < taps; i++)
+            sum += rows[i][x] * weight[i];
+        sum >>= WEIGHT_BITS;
+        dest[x] = CLAMP(sum, 0, 255);
+    }
 }
 
 /*************************************************************************/
@@ -406,6 +717,9 @@ static struct clist *gen_contrib(int oldsize, int newsize, int stride,
  *            Bpp: Bytes (not bits!) per pixel.
  *     old_stride: Bytes per line of original image.
  *     new_stride: Bytes per line of resized image.
+ *          out_x: First column of the resized image to store.
+ *          out_w: Number of columns of the resized image to store.
+ *         mirror: Nonzero to store the columns right to left.
  *         filter: Filter identifier (TCV_ZOOM_*).
  * Return value:
  *     A pointer to a newly allocated ZoomInfo structure, or NULL on error
@@ -413,18 +727,20 @@ static struct clist *gen_contrib(int oldsize, int newsize, int stride,
  */
 
 ZoomInfo *zoom_init(int old_w, int old_h, int new_w, int new_h, int Bpp,
-                    int old_stride, int new_stride, TCVZoomFilter filter)
+                    int old_stride, int new_stride,
+                    int out_x, int out_w, int mirror, TCVZoomFilter filter)
 {
     ZoomInfo *zi;
-    struct clist *x_contrib = NULL, *y_contrib = NULL;
+    int align = 1;
 
     /* Sanity check */
     if (old_w <= 0 || old_h <= 0 || new_w <= 0 || new_h <= 0 || Bpp <= 0
-     || old_stride <= 0 || new_stride <= 0)
+     || old_stride == 0 || new_stride == 0
+     || out_x < 0 || out_w <= 0 || out_x + out_w > new_w)
         return NULL;
 
     /* Allocate structure */
-    zi = tc_malloc(sizeof(*zi));
+    zi = tc_zalloc(sizeof(*zi));
     if (!zi)
         return NULL;
 
@@ -433,6 +749,8 @@ ZoomInfo *zoom_init(int old_w, int old_h, int new_w, int new_h, int Bpp,
     zi->old_h = old_h;
     zi->new_w = new_w;
     zi->new_h = new_h;
+    zi->out_x = out_x;
+    zi->out_w = out_w;
     zi->Bpp = Bpp;
     zi->old_stride = old_stride;
     zi->new_stride = new_stride;
@@ -478,100 +796,84 @@ ZoomInfo *zoom_init(int old_w, int old_h, int new_w, int new_h, int Bpp,
         return NULL;
     }
 
-    /* Generate contributor lists and allocate temporary image buffer */
-    zi->x_contrib = NULL;
-    zi->y_contrib = NULL;
-    zi->tmpimage = tc_malloc(new_w * old_h * Bpp);
-    if (!zi->tmpimage)
-        goto error_out;
+    /* Generate contributors.  The SIMD horizontal kernel (one byte per
+     * pixel only) handles 8 taps at a time; the vertical kernels take
+     * rows in pairs.  Mirroring without resizing uses a one-tap
+     * horizontal "resize". */
+#ifdef ZOOM_SSE2
+    if (Bpp == 1)
+        align = 8;
+#endif
     if (old_w != new_w) {
-        x_contrib = gen_contrib(old_w, new_w, Bpp, zi->filter, zi->fwidth);
-        if (!x_contrib)
+        if (!gen_contrib(old_w, new_w, zi->filter, zi->fwidth, align, &zi->x))
             goto error_out;
-    }
-    if (old_h != new_h) {
-        /* Calculate the correct stride--if the width isn't changing,
-         * this will just be old_stride */
-        int stride = (old_w==new_w) ? old_stride : Bpp*new_w;
-        y_contrib = gen_contrib(old_h, new_h, stride, zi->filter,
-                                zi->fwidth);
-        if (!y_contrib)
+    } else if (mirror) {
+        int i;
+        zi->x.taps = align;
+        zi->x.start = tc_malloc(new_w * sizeof(*zi->x.start));
+        zi->x.weight = tc_zalloc(new_w * align * sizeof(*zi->x.weight));
+        if (!zi->x.start || !zi->x.weight)
             goto error_out;
+        for (i = 0; i < new_w; i++) {
+            zi->x.start[i] = i;
+            zi->x.weight[i*align] = WEIGHT_ONE;
+        }
     }
-
-    /* Convert contributor lists into flat arrays and fixed-point values.
-     * The flat array consists of a contributor count plus two values per
-     * contributor (index and fixed-point weight) for each output pixel.
-     * Note that for the horizontal direction, we make `Bpp' copies of the
-     * contributors, adjusting the offset for each byte of the pixel. */
-
-    if (x_contrib) {
-        int count = 0, i;
-        int32_t *ptr;
-
-        for (i = 0; i < new_w; i++)
-            count += 1 + 2 * x_contrib[i].n;
-        zi->x_contrib = tc_malloc(sizeof(int32_t) * count * Bpp);
-        if (!zi->x_contrib)
-            goto error_out;
-        for (ptr = zi->x_contrib, i = 0; i < new_w * Bpp; i++) {
-            int j;
-            *ptr++ = x_contrib[i/Bpp].n;
-            for (j = 0; j < x_contrib[i/Bpp].n; j++) {
-                *ptr++ = x_contrib[i/Bpp].list[j].pixel + i%Bpp;
-                *ptr++ = DOUBLE_TO_FIXED(x_contrib[i/Bpp].list[j].weight);
-            }
+    if (zi->x.taps) {
+        int i;
+        window_contrib(&zi->x, out_x, out_w, mirror);
+        zi->out_x = 0;
+        /* Find how far the contributors extend past the edges */
+        for (i = 0; i < out_w; i++) {
+            int left = -zi->x.start[i];
+            int right = zi->x.start[i] + zi->x.taps - old_w;
+            if (left > zi->x_pad)
+                zi->x_pad = left;
+            if (right > zi->x_padded_w)
+                zi->x_padded_w = right;
         }
-        /* Free original contributor list */
-        for (i = 0; i < new_w; i++)
-            free(x_contrib[i].list);
-        free(x_contrib);
-        x_contrib = NULL;
+        zi->x_padded_w += zi->x_pad + old_w;
     }
-
-    if (y_contrib) {
-        int count = 0, i;
-        int32_t *ptr;
-
-        for (i = 0; i < new_h; i++)
-            count += 1 + 2 * y_contrib[i].n;
-        zi->y_contrib = tc_malloc(sizeof(int32_t) * count);
-        if (!zi->y_contrib)
+    if (old_h != new_h) {
+        if (!gen_contrib(old_h, new_h, zi->filter, zi->fwidth, 2, &zi->y))
             goto error_out;
-        for (ptr = zi->y_contrib, i = 0; i < new_h; i++) {
-            int j;
-            *ptr++ = y_contrib[i].n;
-            for (j = 0; j < y_contrib[i].n; j++) {
-                *ptr++ = y_contrib[i].list[j].pixel;
-                *ptr++ = DOUBLE_TO_FIXED(y_contrib[i].list[j].weight);
-            }
-        }
-        for (i = 0; i < new_h; i++)
-            free(y_contrib[i].list);
-        free(y_contrib);
-        y_contrib = NULL;
     }
 
+    /* A band buffer holds (see zoom_process_band()) the pointers to the
+     * rows contributing to a resized row, the horizontally resized rows
+     * (as a ring buffer of y.taps rows) and one padded original row */
+    zi->bufsize = ALIGN16(zi->y.taps * sizeof(const uint8_t *));
+    if (zi->x.taps && zi->y.taps)
+        zi->bufsize += ALIGN16(zi->y.taps * out_w * Bpp);
+    if (zi->x.taps)
+        zi->bufsize += ALIGN16(zi->x_padded_w * Bpp);
+    zi->buffer = tc_malloc(zi->bufsize);
+    if (!zi->buffer)
+        goto error_out;
+
     /* Done */
     return zi;
 
   error_out:
-    {
-        if (x_contrib) {
-            int i;
-            for (i = 0; i < new_w; i++)
-                free(x_contrib[i].list);
-            free(x_contrib);
-        }
-        if (y_contrib) {
-            int i;
-            for (i = 0; i < new_w; i++)
-                free(x_contrib[i].list);
-            free(x_contrib);
-        }
-        zoom_free(zi);
-        return NULL;
-    }
+    zoom_free(zi);
+    return NULL;
+}
+
+/*************************************************************************/
+
+/**
+ * zoom_buffer_size:  Return the size of the buffer zoom_process_band()
+ * needs.
+ *
+ * Parameters:
+ *     zi: ZoomInfo structure allocated by zoom_init().
+ * Return value:
+ *     Buffer size in bytes (a multiple of 16).
+ */
+
+int zoom_buffer_size(const ZoomInfo *zi)
+{
+    return zi->bufsize;
 }
 
 /*************************************************************************/
@@ -591,75 +893,94 @@ ZoomInfo *zoom_init(int old_w, int old_h, int new_w, int new_h, int Bpp,
  *     src and dest do not overlap
  */
 
-/* clamp the input to the specified range */
-#define CLAMP(v,l,h)    ((v)<(l) ? (l) : (v) > (h) ? (h) : (v))
-
 void zoom_process(const ZoomInfo *zi, const uint8_t *src, uint8_t *dest)
 {
-    int from_stride, to_stride;
-    const uint8_t *from;
-    uint8_t *to;
-
-    from = src;
-    from_stride = zi->old_stride;
-
-    /* Apply filter to zoom horizontally from src to tmp (if necessary) */
-    if (zi->x_contrib) {
-        int y;
-        to = zi->tmpimage;
-        to_stride = zi->new_w * zi->Bpp;
-        for (y = 0; y < zi->old_h; y++, from += from_stride, to += to_stride) {
-            int32_t *contrib = zi->x_contrib;
-            int x;
-            for (x = 0; x < zi->new_w * zi->Bpp; x++) {
-                int32_t weight = DOUBLE_TO_FIXED(0.5);
-                int n = *contrib++, i;
-                for (i = 0; i < n; i++) {
-                    int pixel = *contrib++;
-                    weight += from[pixel] * (*contrib++);
-                }
-                to[x] = CLAMP(FIXED_TO_INT(weight), 0, 255);
-            }
+    zoom_process_band(zi, src, dest, 0, zi->new_h, NULL);
+}
+
+/*************************************************************************/
+
+/**
+ * zoom_process_band:  Resize a band of rows of the resized image.  Both
+ * passes are done row by row: the original rows are resized horizontally
+ * as the vertical pass first needs them, into a ring buffer holding just
+ * the rows the current resized row is made from, so the intermediate
+ * data stays in the cache.  The bands are independent of each other
+ * (the few original rows shared by adjacent bands are resized by both)
+ * and can be processed in parallel, each with its own buffer.
+ *
+ * Parameters:
+ *       zi: ZoomInfo structure allocated by zoom_init().
+ *      src: Source data plane (the whole image).
+ *     dest: Destination for row y0 of the resized image.
+ *       y0: First row to produce.
+ *       y1: Row after the last one to produce.
+ *   buffer: Work buffer of zoom_buffer_size(zi) bytes, 16-byte aligned,
+ *           or NULL to use the one in the ZoomInfo structure.
+ * Return value: None.
+ * Preconditions:
+ *     zi was allocated by zoom_init()
+ *     src != NULL
+ *     dest != NULL
+ *     src and dest do not overlap
+ *     0 <= y0 <= y1 <= resized height
+ */
+
+void zoom_process_band(const ZoomInfo *zi, const uint8_t *src,
+                       uint8_t *dest, int y0, int y1, uint8_t *buffer)
+{
+    const int rowlen = zi->out_w * zi->Bpp;
+    const int taps = zi->y.taps;
+    const uint8_t **rows;
+    uint8_t *ring, *padrow;
+    int y, next;
+
+    if (!buffer)
+        buffer = zi->buffer;
+    rows = (const uint8_t **)buffer;
+    ring = buffer + ALIGN16(taps * sizeof(const uint8_t *));
+    padrow = ring;
+
+    if (zi->x.taps && taps)
+        padrow += ALIGN16(taps * rowlen);
+    if (!zi->x.taps)
+        src += zi->out_x * zi->Bpp;
+
+    if (!taps) {
+        /* Horizontal resizing only (or none at all) */
+        src += y0 * zi->old_stride;
+        for (y = y0; y < y1; y++) {
+            if (zi->x.taps)
+                zoom_row_x(zi, src, padrow, dest);
+            else
+                ac_memcpy(dest, src, rowlen);
+            src += zi->old_stride;
+            dest += zi->new_stride;
         }
-        from = zi->tmpimage;
-        from_stride = to_stride;
+        return;
     }
 
-    /* Apply filter to zoom vertically from tmp (or src) to dest */
-    /* Use Y as the outside loop to avoid cache thrashing on output buffer */
-    to = dest;
-    to_stride = zi->new_stride;
-    if (zi->y_contrib) {
-        int32_t *contrib = zi->y_contrib;
-        int y;
-        for (y = 0; y < zi->new_h; y++, to += to_stride) {
-            int n = *contrib++, x;
-            for (x = 0; x < zi->new_w * zi->Bpp; x++) {
-                int32_t weight = DOUBLE_TO_FIXED(0.5);
-                int i;
-                for (i = 0; i < n; i++) {
-                    int pixel = contrib[i*2];
-                    weight += from[x+pixel] * contrib[i*2+1];
-                }
-                to[x] = CLAMP(FIXED_TO_INT(weight), 0, 255);
-            }
-            contrib += 2*n;
-        }
-    } else {
-        /* No zooming necessary, just copy */
-        if (from_stride == zi->new_w*zi->Bpp
-         && to_stride == zi->new_w*zi->Bpp
-        ) {
-            /* We can copy the whole frame at once */
-            ac_memcpy(to, from, to_stride * zi->new_h);
-        } else {
-            /* Copy one row at a time */
-            int y;
-            for (y = 0; y < zi->new_h; y++) {
-                ac_memcpy(to + y*to_stride, from + y*from_stride,
-                          zi->new_w * zi->Bpp);
+    /* `next' is the first original row (before reflection) not yet in
+     * the ring buffer; the contributors to successive resized rows never
+     * move backwards, so the rows from y.start[y] up to `next' are still
+     * there */
+    next = (y0 < y1) ? zi->y.start[y0] : 0;
+    for (y = y0; y < y1; y++, dest += zi->new_stride) {
+        int start = zi->y.start[y], i;
+        for (i = 0; i < taps; i++) {
+            int row = start + i;
+            const uint8_t *from = src + reflect(row, zi->old_h)*zi->old_stride;
+            if (zi->x.taps) {
+                uint8_t *slot = ring + (((row % taps) + taps) % taps)*rowlen;
+                if (row >= next)
+                    zoom_row_x(zi, from, padrow, slot);
+                rows[i] = slot;
+            } else {
+                rows[i] = from;
             }
         }
+        next = start + taps;
+        zoom_row_y(rows, zi->y.weight + y*taps, taps, dest, rowlen);
     }
 }
 
@@ -679,9 +1000,11 @@ void zoom_process(const ZoomInfo *zi, const uint8_t *src, uint8_t *dest)
  */
 void zoom_free(ZoomInfo *zi)
 {
-    free(zi->x_contrib);
-    free(zi->y_contrib);
-    free(zi->tmpimage);
+    free(zi->x.start);
+    free(zi->x.weight);
+    free(zi->y.start);
+    free(zi->y.weight);
+    free(zi->buffer);
     free(zi);
 }
 
@@ -15,13 +15,25 @@
 /* Internal data used by zoom_process(). (opaque to caller) */
 typedef struct zoominfo ZoomInfo;
 
-/* Create a ZoomInfo structure for the given parameters. */
+/* Create a ZoomInfo structure for the given parameters.  Only the columns
+ * [out_x,out_x+out_w) of the resized image are stored, right to left if
+ * `mirror' is nonzero.  Strides may be negative. */
 ZoomInfo *zoom_init(int old_w, int old_h, int new_w, int new_h, int Bpp,
-                    int old_stride, int new_stride, TCVZoomFilter filter);
+                    int old_stride, int new_stride,
+                    int out_x, int out_w, int mirror, TCVZoomFilter filter);
 
 /* The resizing function itself. */
 void zoom_process(const ZoomInfo *zi, const uint8_t *src, uint8_t *dest);
 
+/* Resize the band of rows [y0,y1) of the resized image, storing row y0
+ * at `dest' and the others after it at the new stride, using a work
+ * buffer of zoom_buffer_size() bytes (16-byte aligned), or the one in the
+ * ZoomInfo structure if NULL.  Bands may be processed in parallel as
+ * long as each has its own buffer. */
+int zoom_buffer_size(const ZoomInfo *zi);
+void zoom_process_band(const ZoomInfo *zi, const uint8_t *src,
+                       uint8_t *dest, int y0, int y1, uint8_t *buffer);
+
 /* Free a ZoomInfo structure. */
 void zoom_free(ZoomInfo *zi);
 
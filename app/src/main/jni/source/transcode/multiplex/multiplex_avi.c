@@ -47,7 +47,8 @@ static const char avi_help[] = ""
     "    maximum of one audio and video track.\n"
     "    You can add more tracks with further processing.\n"
     "Options:\n"
-    "    help    produce module overview and options explanations\n";
+    "    nobuffer  don't write in the background\n"
+    "    help      produce module overview and options explanations\n";
 
 typedef struct {
     avi_t *avifile;
@@ -66,6 +67,21 @@ static int avi_inspect(TCModuleInstance *self,
     return TC_OK;
 }
 
+/* frames to be written, if all the ranges are bounded; 0 if unknown */
+static long avi_expected_frames(const vob_t *vob)
+{
+    const struct fc_time *t = NULL;
+    long frames = 0;
+
+    for (t = vob->ttime; t != NULL; t = t->next) {
+        if (t->etf == TC_FRAME_LAST || t->etf < t->stf) {
+            return 0;
+        }
+        frames += (t->etf - t->stf) / ((t->stepf > 0) ?t->stepf :1);
+    }
+    return frames;
+}
+
 static int avi_configure(TCModuleInstance *self,
                           const char *options, vob_t *vob)
 {
@@ -75,6 +91,7 @@ static int avi_configure(TCModuleInstance *self,
                     ?vob->mp3frequency :vob->a_rate;
     int abitrate = (vob->ex_a_codec == CODEC_PCM)
                     ?(vob->a_rate*4)/1000*8 :vob->mp3bitrate;
+    long frames = 0;
 
     TC_MODULE_SELF_CHECK(self, "configure");
     TC_MODULE_SELF_CHECK(vob, "configure"); /* hackish? */
@@ -111,6 +128,17 @@ static int avi_configure(TCModuleInstance *self,
                   vob->ex_a_codec, abitrate);
     AVI_set_audio_vbr(pd->avifile, vob->a_vbr);
 
+    /* let the encoder go on while the disk catches up */
+    if ((options == NULL || !optstr_lookup(options, "nobuffer"))
+     && AVI_enable_write_behind(pd->avifile, 0, 0) < 0) {
+        tc_log_warn(MOD_NAME, "can't write in the background: %s",
+                    AVI_strerror());
+    }
+    frames = avi_expected_frames(vob);
+    if (frames > 0) {
+        AVI_reserve_index(pd->avifile, frames);
+    }
+
     return TC_OK;
 }
 
@@ -123,8 +151,13 @@ static int avi_stop(TCModuleInstance *self)
     pd = self->userdata;
 
     if (pd->avifile != NULL) {
-        AVI_close(pd->avifile);
+        /* with write-behind, this is where late write errors show up */
+        int ret = AVI_close(pd->avifile);
         pd->avifile = NULL;
+        if (ret < 0) {
+            tc_log_error(MOD_NAME, "avilib error closing: %s", AVI_strerror());
+            return TC_ERROR;
+        }
     }
 
     return TC_OK;
@@ -10,6 +10,7 @@
 
 #include "transcode.h"
 #include "framebuffer.h"
+#include "frame_profile.h"
 #include "audio_trans.h"
 #include "libtcaudio/tcaudio.h"
 
@@ -126,6 +127,9 @@ static int do_process_audio(vob_t *vob, aframe_list_t *ptr)
 
 int process_aud_frame(vob_t *vob, aframe_list_t *ptr)
 {
+    TCProfMark mark;
+    int ret;
+
     /* Check parameter validity */
     if (!vob || !ptr)
         return -1;
@@ -160,7 +164,10 @@ int process_aud_frame(vob_t *vob, aframe_list_t *ptr)
     }
 
     /* Actually perform processing */
-    return do_process_audio(vob, ptr) ? 0 : -1;
+    tc_profile_begin(&mark);
+    ret = do_process_audio(vob, ptr) ? 0 : -1;
+    tc_profile_end(&mark, TC_PROF_PROCESS_AUDIO, ptr->id);
+    return ret;
 }
 
 /*************************************************************************/
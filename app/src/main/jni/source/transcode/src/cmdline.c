@@ -33,7 +33,7 @@ char *im_aud_mod = NULL, *im_vid_mod = NULL;
 char *ex_aud_mod = NULL, *ex_vid_mod = NULL, *ex_mplex_mod = NULL;
 char *plugins_string = NULL;
 char
-    *nav_seek_file=NULL, *socket_file=NULL,
+    *nav_seek_file=NULL, *socket_file=NULL, *profile_file=NULL,
     *chbase=NULL, //*dirbase=NULL,
     base[TC_BUF_MIN];
 int psu_frame_threshold=12; //psu with less/equal frames are skipped.
@@ -292,6 +292,12 @@ TC_OPTION(socket,             0,   "file",
                     goto short_usage;
                 socket_file = optarg;
 )
+TC_OPTION(profile,            0,   "file",
+                "time every processing stage, write report to \"file\" [off]",
+                if (*optarg == '-')
+                    goto short_usage;
+                profile_file = optarg;
+)
 TC_OPTION(write_pid,          0,   "file",
                 "write pid of transcode process to \"file\" [off]",
                 FILE *f;
@@ -1529,6 +1535,21 @@ TC_OPTION(threads,            0,   "N",
                     goto short_usage;
                 }
 )
+TC_OPTION(slice_threads,      0,   "N",
+                "use N threads per frame for zoom/conversion [1]",
+                tc_slice_threads = strtol(optarg, &optarg, 10);
+                if (*optarg
+                 || tc_slice_threads < 1
+                 || tc_slice_threads > TC_FRAME_THREADS_MAX
+                ) {
+                    tc_error("Invalid argument for --slice_threads");
+                    goto short_usage;
+                }
+)
+TC_OPTION(lockfree_buffers,   0,   0,
+                "use lock-free framebuffer rings [off]",
+                tc_framebuffer_set_lockfree(TC_TRUE);
+)
 TC_OPTION(progress_meter,     0,   "N",
                 "select type of progress meter [1]",
                 tc_progress_meter = strtol(optarg, &optarg, 0);
@@ -1555,18 +1576,12 @@ TC_OPTION(nice,               0,   "N",
 )
 TC_OPTION(accel,              0,   "type[,type...]",
                 "override CPU acceleration flags (for debugging)",
-#if defined(ARCH_X86) || defined(ARCH_X86_64)
                 int parsed = ac_parseflags(optarg, &tc_accel);
                 if (!parsed) {		
                     tc_error("bad --accel type, valid types: C %s",
                              ac_flagstotext(AC_ALL));			
                     goto short_usage;
                 }
-#else
-                /* Not supported--leave a statement in so the macro doesn't
-                 * complain about a missing argument */
-                break;
-#endif
 )
 #if 0
 TC_OPTION(debug,              0,   0,
@@ -31,6 +31,7 @@
 #include "audio_trans.h"
 #include "decoder.h"
 #include "encoder.h"
+#include "frame_profile.h"
 #include "frame_threads.h"
 #include "cmdline.h"
 #include "probe.h"
@@ -151,26 +152,27 @@ static int check_module_caps(const transfer_t *param, int codec,
 }
 
 /*************************************************************************/
-/*                  optimized block-wise fread                           */
+/*                  whole-frame fread                                    */
 /*************************************************************************/
 
-#ifdef PIPE_BUF
-#define BLOCKSIZE PIPE_BUF /* 4096 on linux-x86 */
-#else
-#define BLOCKSIZE 4096
-#endif
-
+/*
+ * Read a whole frame straight into the frame buffer.  Each read() asks
+ * for everything still missing, so a frame costs as many system calls as
+ * the producer needs writes (usually one per pipe or socket buffer), not
+ * one per PIPE_BUF bytes.
+ */
 static int mfread(uint8_t *buf, int size, int nelem, FILE *f)
 {
     int fd = fileno(f);
-    int n = 0, r1 = 0, r2 = 0;
-    while (n < size*nelem-BLOCKSIZE) {
-        if ( !(r1 = read (fd, &buf[n], BLOCKSIZE))) return 0;
-        n += r1;
-    }
-    while (size*nelem-n) {
-        if ( !(r2 = read (fd, &buf[n], size*nelem-n)))return 0;
-        n += r2;
+    int n = 0, total = size * nelem;
+
+    while (n < total) {
+        ssize_t r = read(fd, buf + n, total - n);
+        if (r < 0 && errno == EINTR)
+            continue;
+        if (r <= 0)
+            return 0;
+        n += r;
     }
     return nelem;
 }
@@ -426,6 +428,7 @@ static int video_import_loop(vob_t *vob)
     int ret = 0, vbytes = 0;
     vframe_list_t *ptr = NULL;
     transfer_t import_para;
+    TCProfMark mark;
     TCFrameStatus next = (tc_frame_threads_have_video_workers())
                             ?TC_FRAME_WAIT :TC_FRAME_READY;
     int im_ret = TC_IM_THREAD_UNKNOWN;
@@ -456,6 +459,7 @@ static int video_import_loop(vob_t *vob)
         if (verbose >= TC_THREADS)
             tc_log_msg(__FILE__, "(V) new frame registered and marked, now filling...");
 
+        tc_profile_begin(&mark);
         if (video_decdata.fd != NULL) {
             if (vbytes && (ret = mfread(ptr->video_buf, vbytes, 1, video_decdata.fd)) != 1)
                 ret = -1;
@@ -475,6 +479,7 @@ static int video_import_loop(vob_t *vob)
             ptr->video_size  = import_para.size;
             ptr->attributes |= import_para.attributes;
         }
+        tc_profile_end(&mark, TC_PROF_IMPORT_VIDEO, ptr->id);
 
         if (verbose >= TC_THREADS)
             tc_log_msg(__FILE__, "(V) new frame filled (%s)", (ret == -1) ?"FAILED" :"OK");
@@ -502,7 +507,9 @@ static int video_import_loop(vob_t *vob)
         /* stage 3: account filled frame and process it if needed */
         if (TC_FRAME_NEED_PROCESSING(ptr)) {
             //first stage pre-processing - (synchronous)
+            tc_profile_begin(&mark);
             preprocess_vid_frame(vob, ptr);
+            tc_profile_end(&mark, TC_PROF_PREPROCESS_VIDEO, ptr->id);
 
             //filter pre-processing - (synchronous)
             ptr->tag = TC_VIDEO|TC_PRE_S_PROCESS;
@@ -563,6 +570,7 @@ static int audio_import_loop(vob_t *vob)
     int ret = 0, abytes;
     aframe_list_t *ptr = NULL;
     transfer_t import_para;
+    TCProfMark mark;
     TCFrameStatus next = (tc_frame_threads_have_audio_workers())
                             ?TC_FRAME_WAIT :TC_FRAME_READY;
     int im_ret = TC_IM_THREAD_UNKNOWN;
@@ -600,6 +608,7 @@ static int audio_import_loop(vob_t *vob)
             tc_log_msg(__FILE__, "(A) new frame registered and marked, now syncing...");
 
         /* stage 3: fill the frame with data */
+        tc_profile_begin(&mark);
         /* stage 3.1: resync audio by discarding frames, if needed */
         if (vob->sync > 0) {
             // discard vob->sync frames
@@ -627,6 +636,7 @@ static int audio_import_loop(vob_t *vob)
             vob->sync++;
         }
         /* stage 3.x final note: all this stuff can be done in a cleaner way... */
+        tc_profile_end(&mark, TC_PROF_IMPORT_AUDIO, ptr->id);
 
         if (verbose >= TC_THREADS)
             tc_log_msg(__FILE__, "(A) syncing done, new frame ready to be filled...");
@@ -39,16 +39,20 @@
 #include "audio_trans.h"
 #include "decoder.h"
 #include "encoder.h"
+#include "frame_profile.h"
 #include "frame_threads.h"
 
 #include "libtc/tcframes.h"
 
 #include <stdint.h>
+#include <pthread.h>
 
 /*************************************************************************/
 /* Our data structure forward declaration                                */
 
 typedef struct tcrotatecontext_ TCRotateContext;
+typedef struct tcencoderslot_ TCEncoderSlot;
+typedef struct tcencoderpipe_ TCEncoderPipe;
 typedef struct tcencoderdata_ TCEncoderData;
 
 /*************************************************************************/
@@ -78,9 +82,20 @@ static int tc_rotate_if_needed_by_bytes(TCRotateContext *rotor,
 /* new-style encoder */
 
 static int encoder_export(TCEncoderData *data, vob_t *vob);
+static void encoder_settle_audio(TCEncoderData *data);
 static void encoder_skip(TCEncoderData *data);
 static int encoder_flush(TCEncoderData *data);
 
+/* new-style encoder pipeline */
+static int encoder_pipe_start(TCEncoderData *data);
+static void encoder_pipe_free(TCEncoderPipe *pipe);
+static void encoder_pipe_quit(TCEncoderPipe *pipe);
+static void encoder_pipe_drain(TCEncoderData *data);
+static void encoder_pipe_stop(TCEncoderData *data);
+static void *encoder_video_thread(void *arg);
+static void *encoder_audio_thread(void *arg);
+static void *encoder_mux_thread(void *arg);
+
 /* rest of API is already public */
 
 /* old-style encoder */
@@ -112,7 +127,9 @@ static void free_buffers(TCEncoderData *data);
  * new encoder module design principles
  * 1) keep it simple, stupid
  * 2) to have more than one encoder doesn't make sense in transcode, so
- * 3) new encoder will be monothread, like the old one
+ * 3) there is one global encoder, driven by one encoder loop thread;
+ *    the new-style encoder hands the frames over to a small pipeline
+ *    of stage threads (see below), the old one is monothread.
  */
 
 /*************************************************************************/
@@ -403,10 +420,90 @@ static int tc_rotate_if_needed_by_bytes(TCRotateContext *rotor,
 /* real encoder code                                                     */
 
 
+/*
+ * New-style encoding runs as a pipeline of three stages, each on its own
+ * thread: video encoder, audio encoder and multiplexor (which also
+ * handles output rotation and the frame counters).  The encoder loop
+ * thread still acquires the frames and runs the synchronous filters;
+ * encoder_export() copies the frames into one of TC_ENCODER_SLOTS slots
+ * and returns, so the loop can go on with the next frame while the
+ * previous ones are encoded and written.  Frames are numbered in export
+ * order and the multiplexor takes them strictly in that order, so the
+ * output is the same as with sequential encoding.
+ *
+ * The video stage holds at most one frame: whether the audio frame goes
+ * with the current video frame or has to be delayed (TC_FRAME_IS_DELAYED,
+ * see encoder_settle_audio) is known only once the video frame is
+ * encoded, and until then the raw audio frame must be kept in the
+ * ringbuffer.  The loop thread settles that after acquiring the next
+ * video frame, so that acquisition overlaps with video encoding; the
+ * audio encoder and the multiplexor may lag behind by up to
+ * TC_ENCODER_SLOTS frames.  Like the sequential encoder, the multiplexor
+ * sends the last encoded audio frame (kept in data->aenc_ptr) along
+ * with a delayed video frame.
+ *
+ * Output rotation closes and reopens the output and flushes the encoders
+ * right after the frame which triggered it, before any later frame is
+ * encoded: while a rotation limit is set, only one slot is used at a
+ * time.
+ */
+
+#define TC_ENCODER_SLOTS    4
+
+#define PIPE_SLOT(pipe, n)  (&(pipe)->slots[(n) % TC_ENCODER_SLOTS])
+
+typedef enum tcslotaudio_ TCSlotAudio;
+enum tcslotaudio_ {
+    TC_SLOT_AUDIO_PENDING = 0, /* waiting for the video result   */
+    TC_SLOT_AUDIO_DELAYED,     /* no audio goes with this frame  */
+    TC_SLOT_AUDIO_QUEUED,      /* raw audio copied, to be encoded */
+};
+
+struct tcencoderslot_ {
+    int frame_id;
+    /* range for progress meter */
+    int frame_first;
+    int frame_last;
+
+    int video_done;
+    int video_delayed;
+    TCSlotAudio audio;
+
+    aframe_list_t *araw;
+    vframe_list_t *venc;
+    aframe_list_t *aenc;
+};
+
+struct tcencoderpipe_ {
+    int running;
+    int stop;
+    int error;
+
+    pthread_mutex_t lock;
+    pthread_cond_t cond; /* broadcast on every change of the fields below */
+
+    pthread_t video_thread;
+    pthread_t audio_thread;
+    pthread_t mux_thread;
+
+    vframe_list_t *vraw; /* raw frame for the video stage */
+    vob_t *vob;
+
+    /* frame sequence numbers */
+    unsigned long queued;     /* frames handed to the pipeline        */
+    unsigned long video_next; /* next frame for the video encoder     */
+    unsigned long audio_next; /* next frame for the audio encoder     */
+    unsigned long mux_next;   /* next frame for the multiplexor       */
+
+    TCEncoderSlot slots[TC_ENCODER_SLOTS];
+};
+
 struct tcencoderdata_ {
     /* flags, used internally */
     int error_flag;
     int fill_flag;
+    /* raw audio frame held until the video result is known */
+    int audio_pending;
 
     /* frame boundaries */
     int frame_first; // XXX
@@ -430,6 +527,8 @@ struct tcencoderdata_ {
 
     TCRotateContext rotor_data;
 
+    TCEncoderPipe pipe;
+
 #ifdef SUPPORT_OLD_ENCODER
     transfer_t export_para;
 
@@ -441,6 +540,7 @@ struct tcencoderdata_ {
 static TCEncoderData encdata = {
     .error_flag = 0,
     .fill_flag = 0,
+    .audio_pending = 0,
     .frame_first = 0,
     .frame_last = 0,
     .saved_frame_last = 0,
@@ -453,7 +553,7 @@ static TCEncoderData encdata = {
     .vid_mod = NULL,
     .aud_mod = NULL,
     .mplex_mod = NULL,
-    /* rotor_data explicitely initialized later */
+    /* rotor_data and pipe explicitely initialized later */
 #ifdef SUPPORT_OLD_ENCODER
     .ex_a_handle = NULL,
     .ex_v_handle = NULL,
@@ -675,6 +775,12 @@ int tc_encoder_init(vob_t *vob)
         return TC_ERROR;
     }
 
+    ret = encoder_pipe_start(&encdata);
+    if (ret != TC_OK) {
+        tc_log_error(__FILE__, "can't start encoder threads");
+        return TC_ERROR;
+    }
+
     return TC_OK;
 }
 
@@ -724,6 +830,9 @@ int tc_encoder_close(void)
         return OLD_tc_encoder_close();
 #endif
 
+    /* the frames still in the pipeline belong to this output */
+    encoder_pipe_drain(&encdata);
+
     /* old style code handle flushing in modules, not here */
     ret = encoder_flush(&encdata);
     if (ret != TC_OK) {
@@ -759,6 +868,8 @@ int tc_encoder_stop(void)
         return OLD_tc_encoder_stop();
 #endif
 
+    encoder_pipe_stop(&encdata);
+
     ret = tc_module_stop(encdata.vid_mod);
     if (ret != TC_OK) {
         tc_log_warn(__FILE__, "video export module error: stop failed");
@@ -821,69 +932,377 @@ static void free_buffers(TCEncoderData *data)
 
 
 /*
- * dispatch the acquired frames to encoder modules, and adjust frame counters
+ * encoder pipeline setup and teardown
  */
-static int encoder_export(TCEncoderData *data, vob_t *vob)
+
+static void encoder_pipe_free(TCEncoderPipe *pipe)
 {
-    int video_delayed = 0;
+    int i = 0;
+
+    for (i = 0; i < TC_ENCODER_SLOTS; i++) {
+        if (pipe->slots[i].araw) {
+            tc_del_audio_frame(pipe->slots[i].araw);
+        }
+        if (pipe->slots[i].venc) {
+            tc_del_video_frame(pipe->slots[i].venc);
+        }
+        if (pipe->slots[i].aenc) {
+            tc_del_audio_frame(pipe->slots[i].aenc);
+        }
+    }
+    if (pipe->vraw) {
+        tc_del_video_frame(pipe->vraw);
+    }
+    pthread_cond_destroy(&pipe->cond);
+    pthread_mutex_destroy(&pipe->lock);
+    memset(pipe, 0, sizeof(TCEncoderPipe));
+}
+
+/* make the stage threads quit once they have nothing left to do */
+static void encoder_pipe_quit(TCEncoderPipe *pipe)
+{
+    pthread_mutex_lock(&pipe->lock);
+    pipe->stop = TC_TRUE;
+    pthread_cond_broadcast(&pipe->cond);
+    pthread_mutex_unlock(&pipe->lock);
+}
+
+static int encoder_pipe_start(TCEncoderData *data)
+{
+    TCEncoderPipe *pipe = &data->pipe;
+    TCEncoderSlot *slot = NULL;
+    int i = 0;
+
+    memset(pipe, 0, sizeof(TCEncoderPipe));
+    pthread_mutex_init(&pipe->lock, NULL);
+    pthread_cond_init(&pipe->cond, NULL);
+
+    pipe->vraw = vframe_alloc_single();
+    if (pipe->vraw == NULL) {
+        goto no_buffers;
+    }
+    for (i = 0; i < TC_ENCODER_SLOTS; i++) {
+        slot = &pipe->slots[i];
+        slot->araw = aframe_alloc_single();
+        slot->venc = vframe_alloc_single();
+        slot->aenc = aframe_alloc_single();
+        if (!slot->araw || !slot->venc || !slot->aenc) {
+            goto no_buffers;
+        }
+    }
+
+    if (pthread_create(&pipe->video_thread, NULL,
+                       encoder_video_thread, data) != 0) {
+        goto no_buffers;
+    }
+    if (pthread_create(&pipe->audio_thread, NULL,
+                       encoder_audio_thread, data) != 0) {
+        goto no_audio_thread;
+    }
+    if (pthread_create(&pipe->mux_thread, NULL,
+                       encoder_mux_thread, data) != 0) {
+        goto no_mux_thread;
+    }
+    pipe->running = TC_TRUE;
+    return TC_OK;
+
+no_mux_thread:
+    encoder_pipe_quit(pipe);
+    pthread_join(pipe->audio_thread, NULL);
+    pthread_join(pipe->video_thread, NULL);
+    goto no_buffers;
+no_audio_thread:
+    encoder_pipe_quit(pipe);
+    pthread_join(pipe->video_thread, NULL);
+no_buffers:
+    encoder_pipe_free(pipe);
+    return TC_ERROR;
+}
+
+/* wait until every frame handed to the pipeline is written */
+static void encoder_pipe_drain(TCEncoderData *data)
+{
+    TCEncoderPipe *pipe = &data->pipe;
+
+    /*
+     * rotation happens on the multiplexor thread, with the other
+     * stages idle (see above): nothing to wait for
+     */
+    if (!pipe->running || pthread_equal(pthread_self(), pipe->mux_thread)) {
+        return;
+    }
+
+    pthread_mutex_lock(&pipe->lock);
+    while (pipe->mux_next != pipe->queued) {
+        pthread_cond_wait(&pipe->cond, &pipe->lock);
+    }
+    if (pipe->error) {
+        data->error_flag = 1;
+    }
+    pthread_mutex_unlock(&pipe->lock);
+}
+
+static void encoder_pipe_stop(TCEncoderData *data)
+{
+    TCEncoderPipe *pipe = &data->pipe;
+
+    if (!pipe->running) {
+        return;
+    }
+
+    encoder_pipe_drain(data);
+    encoder_pipe_quit(pipe);
+
+    pthread_join(pipe->mux_thread, NULL);
+    pthread_join(pipe->audio_thread, NULL);
+    pthread_join(pipe->video_thread, NULL);
+
+    encoder_pipe_free(pipe);
+}
+
+/*
+ * encoder pipeline stages
+ */
+
+static void *encoder_video_thread(void *arg)
+{
+    TCEncoderData *data = arg;
+    TCEncoderPipe *pipe = &data->pipe;
+    TCEncoderSlot *slot = NULL;
     int ret;
+    TCProfMark mark;
+
+    pthread_mutex_lock(&pipe->lock);
+    while (TC_TRUE) {
+        while (!pipe->stop && pipe->video_next == pipe->queued) {
+            pthread_cond_wait(&pipe->cond, &pipe->lock);
+        }
+        if (pipe->video_next == pipe->queued) {
+            break; /* stopped and nothing left */
+        }
+        slot = PIPE_SLOT(pipe, pipe->video_next);
+        pthread_mutex_unlock(&pipe->lock);
+
+        RESET_ATTRIBUTES(slot->venc);
+        tc_profile_begin(&mark);
+        ret = tc_module_encode_video(data->vid_mod, pipe->vraw, slot->venc);
+        tc_profile_end(&mark, TC_PROF_ENCODE_VIDEO, slot->frame_id);
+        if (ret != TC_OK) {
+            tc_log_error(__FILE__, "error encoding video frame");
+        }
+
+        pthread_mutex_lock(&pipe->lock);
+        if (ret != TC_OK) {
+            pipe->error = 1;
+        }
+        if (slot->venc->attributes & TC_FRAME_IS_DELAYED) {
+            slot->venc->attributes &= ~TC_FRAME_IS_DELAYED;
+            slot->video_delayed = 1;
+        }
+        slot->video_done = 1;
+        pipe->video_next++;
+        pthread_cond_broadcast(&pipe->cond);
+    }
+    pthread_mutex_unlock(&pipe->lock);
+    return NULL;
+}
+
+static void *encoder_audio_thread(void *arg)
+{
+    TCEncoderData *data = arg;
+    TCEncoderPipe *pipe = &data->pipe;
+    TCEncoderSlot *slot = NULL;
+    int ret;
+    TCProfMark mark;
+
+    pthread_mutex_lock(&pipe->lock);
+    while (TC_TRUE) {
+        while (!pipe->stop
+          && (pipe->audio_next == pipe->queued
+           || PIPE_SLOT(pipe, pipe->audio_next)->audio
+                == TC_SLOT_AUDIO_PENDING)) {
+            pthread_cond_wait(&pipe->cond, &pipe->lock);
+        }
+        if (pipe->audio_next == pipe->queued
+         || PIPE_SLOT(pipe, pipe->audio_next)->audio
+                == TC_SLOT_AUDIO_PENDING) {
+            break; /* stopped and nothing left */
+        }
+        slot = PIPE_SLOT(pipe, pipe->audio_next);
+
+        if (slot->audio == TC_SLOT_AUDIO_QUEUED) {
+            pthread_mutex_unlock(&pipe->lock);
+
+            RESET_ATTRIBUTES(slot->aenc);
+            tc_profile_begin(&mark);
+            ret = tc_module_encode_audio(data->aud_mod,
+                                         slot->araw, slot->aenc);
+            tc_profile_end(&mark, TC_PROF_ENCODE_AUDIO, slot->frame_id);
+            if (ret != TC_OK) {
+                tc_log_error(__FILE__, "error encoding audio frame");
+            }
+
+            pthread_mutex_lock(&pipe->lock);
+            if (ret != TC_OK) {
+                pipe->error = 1;
+            }
+        }
+        pipe->audio_next++;
+        pthread_cond_broadcast(&pipe->cond);
+    }
+    pthread_mutex_unlock(&pipe->lock);
+    return NULL;
+}
+
+static void *encoder_mux_thread(void *arg)
+{
+    TCEncoderData *data = arg;
+    TCEncoderPipe *pipe = &data->pipe;
+    TCEncoderSlot *slot = NULL;
+    aframe_list_t *aenc = NULL;
+    int ret, error;
+    TCProfMark mark;
+
+    pthread_mutex_lock(&pipe->lock);
+    while (TC_TRUE) {
+        /* the audio stage is done with a frame only after the video one */
+        while (!pipe->stop && pipe->mux_next == pipe->audio_next) {
+            pthread_cond_wait(&pipe->cond, &pipe->lock);
+        }
+        if (pipe->mux_next == pipe->audio_next) {
+            break; /* stopped and nothing left */
+        }
+        slot = PIPE_SLOT(pipe, pipe->mux_next);
+        pthread_mutex_unlock(&pipe->lock);
+
+        error = 0;
+        aenc = slot->aenc;
+        if (slot->audio == TC_SLOT_AUDIO_DELAYED) {
+            aenc = data->aenc_ptr;
+            RESET_ATTRIBUTES(aenc);
+        }
+
+        // FIXME: Do we really need bytes-written returned from this, or can
+        //        we just return TC_OK/TC_ERROR like other functions? --AC
+        tc_profile_begin(&mark);
+        ret = tc_module_multiplex(data->mplex_mod, slot->venc, aenc);
+        tc_profile_end(&mark, TC_PROF_MULTIPLEX, slot->frame_id);
+        if (ret < 0) {
+            tc_log_error(__FILE__, "error multiplexing encoded frames");
+            error = 1;
+        }
+        if (aenc == slot->aenc) {
+            /* keep it for the next delayed frame, the slot isn't in use */
+            slot->aenc = data->aenc_ptr;
+            data->aenc_ptr = aenc;
+        }
+        if (TC_ROTATE_IF_NEEDED(&data->rotor_data, pipe->vob, ret) != TC_OK) {
+            error = 1;
+        }
+
+        /* show and update stats */
+        if (tc_progress_meter) {
+            counter_print(1, slot->frame_id,
+                          slot->frame_first, slot->frame_last);
+        }
+        tc_update_frames_encoded(1);
+
+        pthread_mutex_lock(&pipe->lock);
+        if (error) {
+            pipe->error = 1;
+        }
+        pipe->mux_next++;
+        pthread_cond_broadcast(&pipe->cond);
+    }
+    pthread_mutex_unlock(&pipe->lock);
+    return NULL;
+}
+
+
+/*
+ * hand the acquired frames over to the encoder pipeline. The audio frame
+ * is kept (data->audio_pending) until encoder_settle_audio().
+ */
+static int encoder_export(TCEncoderData *data, vob_t *vob)
+{
+    TCEncoderPipe *pipe = &data->pipe;
+    TCEncoderSlot *slot = NULL;
+    unsigned long depth = TC_ENCODER_SLOTS;
 
 #ifdef SUPPORT_OLD_ENCODER
     if (!encdata.factory)
         return OLD_encoder_export(data, vob);
 #endif
-    /* remove spurious attributes */
-    RESET_ATTRIBUTES(data->venc_ptr);
-    RESET_ATTRIBUTES(data->aenc_ptr);
+    if (data->rotor_data.rotate_if_needed != tc_rotate_if_needed_null) {
+        depth = 1;
+    }
 
-    /* step 1: encode video */
-    ret = tc_module_encode_video(data->vid_mod,
-                                 data->buffer->vptr, data->venc_ptr);
-    if (ret != TC_OK) {
-        tc_log_error(__FILE__, "error encoding video frame");
+    pthread_mutex_lock(&pipe->lock);
+    while (pipe->queued - pipe->mux_next >= depth) {
+        pthread_cond_wait(&pipe->cond, &pipe->lock);
+    }
+    if (pipe->error) {
         data->error_flag = 1;
     }
-    if (data->venc_ptr->attributes & TC_FRAME_IS_DELAYED) {
-        data->venc_ptr->attributes &= ~TC_FRAME_IS_DELAYED;
-        video_delayed = 1;
+    pthread_mutex_unlock(&pipe->lock);
+
+    /* slot is free, and the video stage idle (encoder_settle_audio) */
+    slot = PIPE_SLOT(pipe, pipe->queued);
+    slot->frame_id      = data->buffer->frame_id;
+    slot->frame_first   = data->frame_first;
+    slot->frame_last    = (data->frame_last == TC_FRAME_LAST)
+                                ?(-1) :data->frame_last;
+    slot->video_done    = 0;
+    slot->video_delayed = 0;
+    slot->audio         = TC_SLOT_AUDIO_PENDING;
+    vframe_copy(pipe->vraw, data->buffer->vptr, TC_TRUE);
+    pipe->vob = vob;
+
+    if (tc_progress_meter && !data->fill_flag) {
+        data->fill_flag = 1;
+    }
+
+    pthread_mutex_lock(&pipe->lock);
+    pipe->queued++;
+    pthread_cond_broadcast(&pipe->cond);
+    pthread_mutex_unlock(&pipe->lock);
+
+    data->audio_pending = TC_TRUE;
+    return (data->error_flag) ?TC_ERROR :TC_OK;
+}
+
+/*
+ * wait for the video result of the last exported frame, then hand the
+ * audio frame over to the audio stage, or, if the video encoder delayed
+ * its output, keep it (as clone) for the next frame. Release it anyway.
+ */
+static void encoder_settle_audio(TCEncoderData *data)
+{
+    TCEncoderPipe *pipe = &data->pipe;
+    TCEncoderSlot *slot = PIPE_SLOT(pipe, pipe->queued - 1);
+    int video_delayed = 0;
+
+    pthread_mutex_lock(&pipe->lock);
+    while (!slot->video_done) {
+        pthread_cond_wait(&pipe->cond, &pipe->lock);
     }
+    video_delayed = slot->video_delayed;
+    pthread_mutex_unlock(&pipe->lock);
 
-    /* step 2: encode audio */
     if (video_delayed) {
         data->buffer->aptr->attributes |= TC_FRAME_IS_CLONED;
         tc_log_info(__FILE__, "Delaying audio");
     } else {
-        ret = tc_module_encode_audio(data->aud_mod,
-                                     data->buffer->aptr, data->aenc_ptr);
-        if (ret != TC_OK) {
-            tc_log_error(__FILE__, "error encoding audio frame");
-            data->error_flag = 1;
-        }
+        aframe_copy(slot->araw, data->buffer->aptr, TC_TRUE);
     }
 
-    /* step 3: multiplex and rotate */
-    // FIXME: Do we really need bytes-written returned from this, or can
-    //        we just return TC_OK/TC_ERROR like other functions? --AC
-    ret = tc_module_multiplex(data->mplex_mod,
-                              data->venc_ptr, data->aenc_ptr);
-    if (ret < 0) {
-        tc_log_error(__FILE__, "error multiplexing encoded frames");
-        data->error_flag = 1;
-    }
-    data->error_flag = TC_ROTATE_IF_NEEDED(&encdata.rotor_data, vob, ret);
-
-    /* step 4: show and update stats */
-    if (tc_progress_meter) {
-        int last = (data->frame_last == TC_FRAME_LAST)
-                        ?(-1) :data->frame_last;
-        if (!data->fill_flag) {
-            data->fill_flag = 1;
-        }
-        counter_print(1, data->buffer->frame_id, data->frame_first, last);
-    }
+    pthread_mutex_lock(&pipe->lock);
+    slot->audio = (video_delayed) ?TC_SLOT_AUDIO_DELAYED :TC_SLOT_AUDIO_QUEUED;
+    pthread_cond_broadcast(&pipe->cond);
+    pthread_mutex_unlock(&pipe->lock);
 
-    tc_update_frames_encoded(1);
-    return (data->error_flag) ?TC_ERROR :TC_OK;
+    data->audio_pending = TC_FALSE;
+    data->buffer->dispose_audio_frame(data->buffer);
 }
 
 
@@ -1371,6 +1790,26 @@ void tc_encoder_loop(vob_t *vob, int frame_first, int frame_last)
             break; /* can't acquire video frame */
         }
 
+        /* 
+         * the previous video frame was encoded meanwhile; its audio
+         * frame can go now, making room for the next one.
+         */
+        if (encdata.audio_pending) {
+            encoder_settle_audio(&encdata);
+        }
+
+        /*
+         * the video import stops the audio one once it reaches the end
+         * of the stream, and since the audio frame above was held until
+         * now, the audio import may be one frame short: don't wait for
+         * an audio frame which is not going to come.
+         */
+        if (encdata.buffer->vptr->attributes & TC_FRAME_IS_END_OF_STREAM) {
+            encdata.buffer->vptr->attributes &= ~TC_FRAME_IS_END_OF_STREAM;
+            eos = 1;
+            break;
+        }
+
         err = encdata.buffer->acquire_audio_frame(encdata.buffer, vob);
         if (err) {
             if (verbose >= TC_DEBUG) {
@@ -1394,10 +1833,16 @@ void tc_encoder_loop(vob_t *vob, int frame_first, int frame_last)
 
         /* release frame buffer memory */
         encdata.buffer->dispose_video_frame(encdata.buffer);
-        encdata.buffer->dispose_audio_frame(encdata.buffer);
+        if (!encdata.audio_pending) {
+            encdata.buffer->dispose_audio_frame(encdata.buffer);
+        }
     }
     /* main frame decoding loop */
 
+    if (encdata.audio_pending) {
+        encoder_settle_audio(&encdata);
+    }
+
     if (verbose >= TC_CLEANUP) {
         if (eos) {
             tc_log_info(__FILE__, "encoder last frame finished (%i/%i)",
@@ -215,9 +215,13 @@ void tc_export_rotation_limit_megabytes(vob_t *vob, uint32_t megabytes);
  * have more than one encoder, so it's instance is global, hidden, implicit.
  *
  * PLEASE NOTE:
- * current encoder does not _explicitely_ use more than one thread.
- * This means that audio and video encoding, as well as multiplexing, happens
- * sequentially on the same (and unique) encoder thread.
+ * tc_encoder_loop() runs on the calling thread, but the new-style (NMS)
+ * encoder runs video encoding, audio encoding and multiplexing (including
+ * output rotation) on three threads of its own, connected by short queues;
+ * each encoder module is only ever used by one thread at a time.
+ * tc_encoder_close() waits for all frames exported so far to be written.
+ * The old-style encoder still does everything sequentially on the encoder
+ * thread.
  * It's definitively possible (and already happens) that real encoder code loaded
  * by modules uses internally more than one thread, but this is completely opaque
  * to encoder.
@@ -8,8 +8,12 @@
  * for details.
  */
 
+#include <pthread.h>
+
 #include "transcode.h"
 #include "filter.h"
+#include "frame_profile.h"
+#include "libtc/tcmodule-data.h"
 
 // temp defines during module system switchover
 //#define SUPPORT_NMS     // support NMS modules?
@@ -28,6 +32,16 @@
 
 /*************************************************************************/
 
+/* Ordering gate for one filter stage run by the frame worker threads.
+ * Frames are let through one at a time, in ID order (see gate_enter()). */
+
+typedef struct FilterGate_ {
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    long next;                  // Next frame ID due (-1: take the first one)
+    int open;                   // Nonzero: filter going away, don't order
+} FilterGate;
+
 /* Data for a single filter instance.  An ID value of 0 indicates that no
  * filter is present. */
 
@@ -35,6 +49,10 @@ typedef struct FilterInstance_ {
     char name[MAX_FILTER_NAME_LEN+1]; // Filter name
     int id;                     // Unique ID value for this filter instance
     int enabled;                // Nonzero if filter is inabled
+    uint32_t flags;             // TC_MODULE_FLAG_* (threading model)
+    int media;                  // TC_VIDEO|TC_AUDIO: frames it wants
+    FilterGate gates[2][2];     // [audio][post] gates for the M stages
+    int prof[2];                // [audio] profiling stages
 #ifdef SUPPORT_CLASSIC
     void *handle;               // DLL handle for old-style modules
     TCFilterOldEntryFunc entry; // Module entry point for old-style modules
@@ -44,13 +62,67 @@ typedef struct FilterInstance_ {
 #endif
 } FilterInstance;
 
+/* The filter chain, compiled into the list of filters each kind of frame
+ * goes through, so that tc_filter_process() does not have to search the
+ * filter table for every frame.  A chain is never modified once built;
+ * changes to the filter table just bump `chain_epoch', and the next frame
+ * to come along builds a new chain.  Frames hold a reference to the chain
+ * they are going through (see chain_get() and chain_put()); a replaced
+ * chain is freed once the last of them is done with it, and
+ * tc_filter_remove() waits for that before unloading the filter. */
+
+enum {
+    STAGE_PRE_S = 0,
+    STAGE_PRE_M,
+    STAGE_POST_M,
+    STAGE_POST_S,
+    STAGE_OTHER,                // preview and anything else
+    FILTER_STAGES
+};
+
+/* frame media types: video, audio, neither (tag without TC_VIDEO/TC_AUDIO) */
+#define FILTER_MEDIA    3
+
+typedef struct FilterLink_ {
+    int index;                  // filters[] index
+    int id;                     // Filter ID
+    int enabled;                // Zero: only cross the filter's gate
+    int prof;                   // Profiling stage, -1 if none
+#ifdef SUPPORT_CLASSIC
+    TCFilterOldEntryFunc entry;
+#endif
+} FilterLink;
+
+typedef struct FilterChain_ {
+    struct FilterChain_ *older; // Next chain in the `stale' list
+    int epoch;                  // Value of chain_epoch it was built for
+    int readers;                // Frames going through this chain
+    int count[FILTER_MEDIA][FILTER_STAGES];
+    FilterLink links[FILTER_MEDIA][FILTER_STAGES][MAX_FILTERS];
+} FilterChain;
+
 
 /* Flag: are we initialized? */
 static int initialized = 0;
 
+/* Flag: have frame worker threads started to go through the filters?
+ * Filters added after that point synchronize on the first frame they
+ * get, since frame IDs no longer start from zero. */
+static int started = 0;
+
 /* Filter instance table. */
 static FilterInstance filters[MAX_FILTERS];
 
+/* Compiled filter chain (see FilterChain), replaced chains which frames
+ * are still going through, and the number of changes made to the filter
+ * table so far.  All of them are protected by `chain_lock'; `chain_cond'
+ * is signalled whenever a stale chain is freed. */
+static FilterChain *chain = NULL;
+static FilterChain *stale = NULL;
+static int chain_epoch = 0;
+static pthread_mutex_t chain_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t chain_cond = PTHREAD_COND_INITIALIZER;
+
 
 /* Macro to check that tc_filter_init() has been called, and abort the
  * function otherwise.  Pass the appropriate return value (nothing for a
@@ -95,6 +167,382 @@ static int id_to_index(int id, const char *func)
     return i;
 }
 
+/*************************************************************************/
+
+/**
+ * filter_caps:  Local helper function to extract the capabilities field
+ * from a classic filter description (see optstr_filter_desc()).
+ *
+ * Parameters:
+ *     desc: Filter description, as returned by TC_FILTER_GET_CONFIG.
+ *     caps: Buffer for the capabilities string.
+ *      len: Size of `caps', in bytes.
+ * Return value:
+ *     Nonzero on success, zero if `desc' is malformed.
+ */
+
+static int filter_caps(const char *desc, char *caps, size_t len)
+{
+    const char *s = desc, *e = NULL;
+    int field;
+
+    for (field = 0; field < 4; field++) {  // skip name..author
+        s = strchr(s, '"');
+        if (!s || !(s = strchr(s+1, '"')))
+            return 0;
+        s++;
+    }
+    s = strchr(s, '"');
+    if (!s || !(e = strchr(s+1, '"')) || (size_t)(e-s) > len)
+        return 0;
+    strlcpy(caps, s+1, e-s);
+    return 1;
+}
+
+/**
+ * filter_flags:  Local helper function to find out the threading model
+ * of a freshly loaded filter, and which frames it wants: new-style
+ * modules tell it in their TCModuleInfo, classic ones with the "P"
+ * (stateless) and "S" (serial) capability letters, and "V" and "A" for
+ * video and audio.  Anything else is assumed to keep temporal state,
+ * i.e. needs frames one at a time and in order; filters which do not
+ * tell their media type get all frames.
+ *
+ * Parameters:
+ *         i: filters[] index of the filter.
+ *     media: Where to store the TC_VIDEO/TC_AUDIO bits for the filter.
+ * Return value:
+ *     TC_MODULE_FLAG_* bits describing the filter.
+ */
+
+static uint32_t filter_flags(int i, int *media)
+{
+    uint32_t flags = TC_MODULE_FLAG_NONE;
+
+    *media = 0;
+
+#ifdef SUPPORT_CLASSIC
+    const TCModuleClass *(*setup)(void) = NULL;
+    char desc[PATH_MAX], caps[32];
+    frame_list_t dummy_frame;
+
+    setup = dlsym(filters[i].handle, "tc_plugin_setup");
+    if (setup) {
+        const TCModuleClass *klass = setup();
+        if (klass && klass->info) {
+            flags = klass->info->flags;
+            if (klass->info->features & TC_MODULE_FEATURE_VIDEO)
+                *media |= TC_VIDEO;
+            if (klass->info->features & TC_MODULE_FEATURE_AUDIO)
+                *media |= TC_AUDIO;
+        }
+    } else {
+        memset(desc, 0, sizeof(desc));
+        dummy_frame.filter_id = filters[i].id;
+        dummy_frame.tag = TC_FILTER_GET_CONFIG;
+        if (filters[i].entry(&dummy_frame, desc) == 0
+         && filter_caps(desc, caps, sizeof(caps))) {
+            if (strchr(caps, 'P'))
+                flags |= TC_MODULE_FLAG_STATELESS;
+            if (strchr(caps, 'S'))
+                flags |= TC_MODULE_FLAG_SERIAL;
+            if (strchr(caps, 'V'))
+                *media |= TC_VIDEO;
+            if (strchr(caps, 'A'))
+                *media |= TC_AUDIO;
+        }
+    }
+#endif
+    if (!*media)
+        *media = TC_VIDEO | TC_AUDIO;
+    /* needing several frames is temporal state by definition */
+    if (flags & TC_MODULE_FLAG_DELAY)
+        flags &= ~(TC_MODULE_FLAG_STATELESS | TC_MODULE_FLAG_SERIAL);
+    return flags;
+}
+
+/*************************************************************************/
+
+/**
+ * gate_enter:  Local helper function to wait for the given frame's turn
+ * at a filter gate.  Frames go through one at a time; unless `ordered'
+ * is zero, each original frame also waits for all frames with a lower ID
+ * to pass.  Clones go right after their original, but are otherwise not
+ * ordered with respect to the following frames.  Must be paired with
+ * gate_leave().
+ *
+ * Parameters:
+ *        gate: Gate to go through.
+ *       frame: Frame going through.
+ *     ordered: Nonzero if frames must go through in ID order.
+ * Return value:
+ *     None.
+ */
+
+static void gate_enter(FilterGate *gate, const frame_list_t *frame,
+                       int ordered)
+{
+    pthread_mutex_lock(&gate->lock);
+    if (ordered) {
+        int clone = (frame->attributes & TC_FRAME_WAS_CLONED) ? 1 : 0;
+        while (!gate->open && gate->next >= 0
+               && frame->id + clone > gate->next)
+            pthread_cond_wait(&gate->cond, &gate->lock);
+    }
+}
+
+/**
+ * gate_leave:  Local helper function to leave a gate entered with
+ * gate_enter(), letting the next frame in.
+ *
+ * Parameters:
+ *      gate: Gate to leave.
+ *     frame: Frame going through.
+ * Return value:
+ *     None.
+ */
+
+static void gate_leave(FilterGate *gate, const frame_list_t *frame)
+{
+    if (!(frame->attributes & TC_FRAME_WAS_CLONED)
+     && frame->id >= gate->next) {
+        gate->next = frame->id + 1;
+        pthread_cond_broadcast(&gate->cond);
+    }
+    pthread_mutex_unlock(&gate->lock);
+}
+
+/**
+ * filter_gate:  Local helper function to select the gate a frame has to
+ * go through for the given filter, if any.
+ *
+ * Parameters:
+ *         i: filters[] index of the filter.
+ *     frame: Frame to process.
+ * Return value:
+ *     Pointer to the gate, or NULL if the frame can go straight through
+ *     (single threaded stage or stateless filter).
+ */
+
+static FilterGate *filter_gate(int i, const frame_list_t *frame)
+{
+    if (!(frame->tag & (TC_PRE_M_PROCESS | TC_POST_M_PROCESS))
+     || (filters[i].flags & TC_MODULE_FLAG_STATELESS))
+        return NULL;
+    return &filters[i].gates[(frame->tag & TC_AUDIO) ? 1 : 0]
+                            [(frame->tag & TC_POST_M_PROCESS) ? 1 : 0];
+}
+
+/*************************************************************************/
+
+/**
+ * chain_changed:  Local helper function to note that the filter table
+ * was changed, so that the filter chain gets rebuilt.
+ *
+ * Parameters:
+ *     None.
+ * Return value:
+ *     None.
+ */
+
+static void chain_changed(void)
+{
+    pthread_mutex_lock(&chain_lock);
+    chain_epoch++;
+    pthread_mutex_unlock(&chain_lock);
+}
+
+/**
+ * chain_build:  Local helper function to compile the filter chain from
+ * the filter table.  The caller must hold `chain_lock'.
+ *
+ * Parameters:
+ *     epoch: Value of chain_epoch to build the chain for.
+ * Return value:
+ *     The new chain, or NULL if out of memory.
+ */
+
+static FilterChain *chain_build(int epoch)
+{
+    static const int media_bits[FILTER_MEDIA] = {
+        TC_VIDEO, TC_AUDIO, TC_VIDEO | TC_AUDIO
+    };
+    FilterChain *new_chain;
+    int order[MAX_FILTERS], n = 0, i, j, m, st;
+
+    new_chain = tc_zalloc(sizeof(*new_chain));
+    if (!new_chain) {
+        tc_log_error(__FILE__, "out of memory building the filter chain");
+        return NULL;
+    }
+    new_chain->epoch = epoch;
+
+    /* Filters are applied in ID order */
+    for (i = 0; i < MAX_FILTERS; i++) {
+        if (filters[i].id <= 0)
+            continue;
+        for (j = n; j > 0 && filters[order[j-1]].id > filters[i].id; j--)
+            order[j] = order[j-1];
+        order[j] = i;
+        n++;
+    }
+
+    for (m = 0; m < FILTER_MEDIA; m++) {
+        for (st = 0; st < FILTER_STAGES; st++) {
+            /* Disabled filters must still let frames through their gates,
+             * or they would stall forever once enabled again. */
+            int gated = (st == STAGE_PRE_M || st == STAGE_POST_M);
+
+            for (j = 0; j < n; j++) {
+                FilterLink *link;
+
+                i = order[j];
+                if (!(filters[i].media & media_bits[m])
+                 || (!filters[i].enabled && !gated))
+                    continue;
+                link = &new_chain->links[m][st][new_chain->count[m][st]++];
+                link->index = i;
+                link->id = filters[i].id;
+                link->enabled = filters[i].enabled;
+                link->prof = (m < 2) ? filters[i].prof[m] : -1;
+#ifdef SUPPORT_CLASSIC
+                link->entry = filters[i].entry;
+#endif
+            }
+        }
+    }
+    return new_chain;
+}
+
+/**
+ * chain_update:  Local helper function to replace the filter chain if the
+ * filter table changed since it was built.  The replaced chain is freed
+ * right away if no frame is going through it, and put on the `stale' list
+ * otherwise.  If the new chain cannot be built, there is no chain until
+ * the next try.  The caller must hold `chain_lock'.
+ *
+ * Parameters:
+ *     None.
+ * Return value:
+ *     None.
+ */
+
+static void chain_update(void)
+{
+    if (chain && chain->epoch == chain_epoch)
+        return;
+    if (chain) {
+        if (chain->readers > 0) {
+            chain->older = stale;
+            stale = chain;
+        } else {
+            free(chain);
+        }
+    }
+    chain = chain_build(chain_epoch);
+}
+
+/**
+ * chain_get:  Local helper function to return the filter chain for the
+ * current filter table, building it if the table changed since the chain
+ * in use was built.  The chain stays valid until released with
+ * chain_put().
+ *
+ * Parameters:
+ *     None.
+ * Return value:
+ *     The filter chain, or NULL if out of memory.
+ */
+
+static const FilterChain *chain_get(void)
+{
+    FilterChain *cur;
+
+    pthread_mutex_lock(&chain_lock);
+    chain_update();
+    cur = chain;
+    if (cur)
+        cur->readers++;
+    pthread_mutex_unlock(&chain_lock);
+    return cur;
+}
+
+/**
+ * chain_put:  Local helper function to release a chain returned by
+ * chain_get().  The last frame going through a replaced chain frees it.
+ *
+ * Parameters:
+ *     cur: Chain to release.
+ * Return value:
+ *     None.
+ */
+
+static void chain_put(const FilterChain *cur)
+{
+    FilterChain **pp;
+
+    pthread_mutex_lock(&chain_lock);
+    for (pp = &stale; *pp; pp = &(*pp)->older) {
+        if (*pp == cur)
+            break;
+    }
+    if (--((FilterChain *)cur)->readers == 0 && *pp) {
+        *pp = cur->older;
+        free((FilterChain *)cur);
+        pthread_cond_broadcast(&chain_cond);
+    }
+    pthread_mutex_unlock(&chain_lock);
+}
+
+/**
+ * chain_drain:  Local helper function to publish a chain built from the
+ * current filter table, and wait until no frame is going through an older
+ * one any more.  Must not be called from a frame worker thread while it is
+ * going through the filters.
+ *
+ * Parameters:
+ *     None.
+ * Return value:
+ *     None.
+ */
+
+static void chain_drain(void)
+{
+    pthread_mutex_lock(&chain_lock);
+    chain_epoch++;
+    chain_update();
+    while (stale)
+        pthread_cond_wait(&chain_cond, &chain_lock);
+    pthread_mutex_unlock(&chain_lock);
+}
+
+/**
+ * chain_links:  Local helper function to select the list of filters the
+ * given frame goes through.
+ *
+ * Parameters:
+ *      chain: Filter chain to use.
+ *        tag: The frame's tag.
+ *      count: Where to store the number of filters in the list.
+ * Return value:
+ *     The list of filters, in order.
+ */
+
+static const FilterLink *chain_links(const FilterChain *chain, int tag,
+                                     int *count)
+{
+    int m, st;
+
+    m = (tag & TC_VIDEO) ? 0 : (tag & TC_AUDIO) ? 1 : 2;
+    st = (tag & TC_PRE_S_PROCESS)  ? STAGE_PRE_S
+       : (tag & TC_PRE_M_PROCESS)  ? STAGE_PRE_M
+       : (tag & TC_POST_M_PROCESS) ? STAGE_POST_M
+       : (tag & TC_POST_S_PROCESS) ? STAGE_POST_S
+       : STAGE_OTHER;
+    *count = chain->count[m][st];
+    return chain->links[m][st];
+}
+
 /*************************************************************************/
 /*************************************************************************/
 
@@ -115,8 +563,21 @@ int tc_filter_init(void)
         tc_log_warn(__FILE__, "tc_filter_init() called twice!");
         return 1;
     }
-    for (i = 0; i < MAX_FILTERS; i++)
+    for (i = 0; i < MAX_FILTERS; i++) {
+        int m, n;
+
         filters[i].id = 0;
+        for (m = 0; m < 2; m++) {
+            for (n = 0; n < 2; n++) {
+                pthread_mutex_init(&filters[i].gates[m][n].lock, NULL);
+                pthread_cond_init(&filters[i].gates[m][n].cond, NULL);
+            }
+        }
+    }
+    started = 0;
+    chain = NULL;
+    stale = NULL;
+    chain_epoch = 0;
     initialized = 1;
     return 1;
 }
@@ -141,8 +602,24 @@ void tc_filter_fini(void)
         return;
 
     for (i = 0; i < MAX_FILTERS; i++) {
+        int m, n;
+
         if (filters[i].id != 0)
             tc_filter_remove(filters[i].id);
+        for (m = 0; m < 2; m++) {
+            for (n = 0; n < 2; n++) {
+                pthread_cond_destroy(&filters[i].gates[m][n].cond);
+                pthread_mutex_destroy(&filters[i].gates[m][n].lock);
+            }
+        }
+    }
+    /* no frames are going through the filters any more */
+    free(chain);
+    chain = NULL;
+    while (stale) {
+        FilterChain *older = stale->older;
+        free(stale);
+        stale = older;
     }
 
     initialized = 0;
@@ -160,11 +637,18 @@ void tc_filter_fini(void)
  *     None.
  * Prerequisites:
  *     frame->tag is set to an appropriate value
+ * Notes:
+ *     In the multithreaded stages (TC_{PRE,POST}_M_PROCESS), frames are
+ *     handed to each filter according to its threading model: stateless
+ *     filters get them concurrently and in any order, serial ones one at
+ *     a time, all the others one at a time and in frame ID order.
  */
 
 void tc_filter_process(frame_list_t *frame)
 {
-    int last_id;
+    const FilterChain *cur;
+    const FilterLink *links;
+    int count, n;
 
     CHECK_INITIALIZED();
     if (!frame) {
@@ -172,43 +656,100 @@ void tc_filter_process(frame_list_t *frame)
         return;
     }
 
-    /* The order of the filters is given by their ID values--however, this
-     * does not necessarily match the order in the filters[] array.  We
-     * keep track of the last ID processed (starting at 0, lower than any
-     * valid ID), then each time through the loop, search for the lowest ID
-     * greater than that value, which will be the next filter to process.
-     * The loop ends when no enabled filter has an ID greater than the last
-     * ID processed. */
+    /* The filters are applied in the order of their ID values; the
+     * compiled chain lists them in that order for each kind of frame
+     * (see chain_build()). */
 
-    last_id = 0;
-    for (;;) {
-        int next_filter = -1, i;
+    if (frame->tag & (TC_PRE_M_PROCESS | TC_POST_M_PROCESS))
+        started = 1;
 
-        for (i = 0; i < MAX_FILTERS; i++) {
-            if (filters[i].id <= last_id || !filters[i].enabled)
-                continue;
-            if (next_filter < 0 || filters[i].id < filters[next_filter].id)
-                next_filter = i;
+    cur = chain_get();
+    if (!cur)
+        return;
+    links = chain_links(cur, frame->tag, &count);
+
+    for (n = 0; n < count; n++) {
+        const FilterLink *link = &links[n];
+        FilterGate *gate;
+
+        gate = filter_gate(link->index, frame);
+        if (gate) {
+            gate_enter(gate, frame,
+                       !(filters[link->index].flags & TC_MODULE_FLAG_SERIAL));
         }
-        if (next_filter < 0)
-            break;
-        last_id = filters[next_filter].id;
+        if (link->enabled) {
 
 #ifdef SUPPORT_NMS
 # error please write NMS support code
 #endif
 
 #ifdef SUPPORT_CLASSIC
-        if (!filters[next_filter].entry) {
-            tc_log_warn(__FILE__, "Filter %s (%d) missing entry function"
-                        " (bug?), disabling", filters[i].name, last_id);
-            filters[next_filter].enabled = 0;
-            continue;
-        }
-        frame->filter_id = last_id;
-        filters[next_filter].entry(frame, NULL);
+            if (!link->entry) {
+                tc_log_warn(__FILE__, "Filter %s (%d) missing entry function"
+                            " (bug?), disabling",
+                            filters[link->index].name, link->id);
+                filters[link->index].enabled = 0;
+                chain_changed();
+            } else {
+                TCProfMark mark;
+
+                frame->filter_id = link->id;
+                tc_profile_begin(&mark);
+                link->entry(frame, NULL);
+                tc_profile_end(&mark, link->prof, frame->id);
+            }
 #endif
-    }  // for (;;)
+        }
+        if (gate)
+            gate_leave(gate, frame);
+    }
+    chain_put(cur);
+}
+
+/*************************************************************************/
+
+/**
+ * tc_filter_pass:  Lets the given frame through the gates of all filters
+ * without processing it.  Frame worker threads must call this for every
+ * multithreaded stage a frame will not go through (e.g. because it was
+ * skipped), so that the following frames are not held back forever.
+ *
+ * Parameters:
+ *     frame: Frame to pass.
+ * Return value:
+ *     None.
+ * Prerequisites:
+ *     frame->tag is set to the stage being skipped
+ *     (TC_{AUDIO,VIDEO}|TC_{PRE,POST}_M_PROCESS).
+ */
+
+void tc_filter_pass(frame_list_t *frame)
+{
+    const FilterChain *cur;
+    const FilterLink *links;
+    int count, n;
+
+    CHECK_INITIALIZED();
+    if (!frame) {
+        tc_log_warn(__FILE__, "tc_filter_pass: frame is NULL!");
+        return;
+    }
+
+    /* Gates must be crossed in filter order, as in tc_filter_process() */
+    cur = chain_get();
+    if (!cur)
+        return;
+    links = chain_links(cur, frame->tag, &count);
+
+    for (n = 0; n < count; n++) {
+        FilterGate *gate = filter_gate(links[n].index, frame);
+        if (gate) {
+            gate_enter(gate, frame,
+                       !(filters[links[n].index].flags & TC_MODULE_FLAG_SERIAL));
+            gate_leave(gate, frame);
+        }
+    }
+    chain_put(cur);
 }
 
 /*************************************************************************/
@@ -267,6 +808,17 @@ int tc_filter_add(const char *name, const char *options)
     }
     strlcpy(filters[i].name, name, sizeof(filters[i].name));
     filters[i].enabled = 0;
+    filters[i].flags = TC_MODULE_FLAG_NONE;
+    filters[i].media = 0;       // no frames until initialized
+    {
+        int m, n;
+        for (m = 0; m < 2; m++) {
+            for (n = 0; n < 2; n++) {
+                filters[i].gates[m][n].next = started ? -1 : 0;
+                filters[i].gates[m][n].open = 0;
+            }
+        }
+    }
 
 #ifdef SUPPORT_NMS
 # error please write NMS support code
@@ -314,15 +866,29 @@ int tc_filter_add(const char *name, const char *options)
         if (filters[i].entry(&dummy_frame, (char *)options) < 0) {
             tc_warn("Initialization of filter %s failed, skipping.", name);
             tc_filter_remove(id);
+        } else {
+            filters[i].flags = filter_flags(i, &filters[i].media);
         }
         if (verbose & TC_DEBUG)
             tc_log_msg(__FILE__, "tc_filter_add: filter %s successfully"
-                       " initialized", name);
+                       " initialized (%s)", name,
+                       (filters[i].flags & TC_MODULE_FLAG_STATELESS)
+                            ? "stateless"
+                       : (filters[i].flags & TC_MODULE_FLAG_SERIAL)
+                            ? "serial" : "temporal");
     }
 #endif  // SUPPORT_CLASSIC
 
     /* Module was successfully loaded and initialized, so enable it */
+    {
+        char stage[MAX_FILTER_NAME_LEN+32];
+        tc_snprintf(stage, sizeof(stage), "filter/%s#%d/video", name, id);
+        filters[i].prof[0] = tc_profile_stage(stage);
+        tc_snprintf(stage, sizeof(stage), "filter/%s#%d/audio", name, id);
+        filters[i].prof[1] = tc_profile_stage(stage);
+    }
     filters[i].enabled = 1;
+    chain_changed();
     return 1;
 }
 
@@ -353,7 +919,9 @@ int tc_filter_find(const char *name)
 /*************************************************************************/
 
 /**
- * tc_filter_remove:  Remove the given filter.
+ * tc_filter_remove:  Remove the given filter.  Frames still going through
+ * the filter are let through first; the filter is closed and unloaded
+ * only after that.
  *
  * Parameters:
  *     id: ID of filter to remove.
@@ -363,12 +931,30 @@ int tc_filter_find(const char *name)
 
 void tc_filter_remove(int id)
 {
-    int i;
+    int i, m, n;
 
     CHECK_INITIALIZED();
     if ((i = id_to_index(id, __FUNCTION__)) < 0)
         return;
 
+    /* Take the filter out of the chain, keeping its table slot until it
+     * is unloaded.  Frames which picked up an older chain may be waiting
+     * at its gates for frames which will never come through them now, so
+     * the gates stop enforcing the frame order (they still let frames in
+     * one at a time). */
+    filters[i].enabled = 0;
+    filters[i].media = 0;
+    for (m = 0; m < 2; m++) {
+        for (n = 0; n < 2; n++) {
+            FilterGate *gate = &filters[i].gates[m][n];
+            pthread_mutex_lock(&gate->lock);
+            gate->open = 1;
+            pthread_cond_broadcast(&gate->cond);
+            pthread_mutex_unlock(&gate->lock);
+        }
+    }
+    chain_drain();
+
 #ifdef SUPPORT_NMS
 # error please write NMS support code
 #endif
@@ -392,7 +978,6 @@ void tc_filter_remove(int id)
 
     memset(filters[i].name, 0, sizeof(filters[i].name));
     filters[i].id = 0;
-    filters[i].enabled = 0;
 }
 
 /*************************************************************************/
@@ -415,6 +1000,7 @@ int tc_filter_enable(int id)
     if (i < 0)
         return 0;
     filters[i].enabled = 1;
+    chain_changed();
     return 1;
 }
 
@@ -438,6 +1024,7 @@ int tc_filter_disable(int id)
     if (i < 0)
         return 0;
     filters[i].enabled = 0;
+    chain_changed();
     return 1;
 }
 
@@ -474,6 +1061,7 @@ int tc_filter_configure(int id, const char *options)
             tc_log_warn(__FILE__, "Filter %s (%d) missing entry function"
                         " (bug?), disabling", filters[i].name, id);
             filters[i].enabled = 0;
+            chain_changed();
             return 0;
         }
         /* Old filter API does a close before reconfiguring */
@@ -488,8 +1076,10 @@ int tc_filter_configure(int id, const char *options)
             tc_log_warn(PACKAGE, "Reconfiguration of filter %s failed,"
                         " disabling.", filters[i].name);
             filters[i].enabled = 0;
+            chain_changed();
             return 0;
         }
+        chain_changed();
         return 1;
     }
 #endif
@@ -538,6 +1128,7 @@ const char *tc_filter_get_conf(int id, const char *option)
             tc_log_warn(__FILE__, "Filter %s (%d) missing entry function"
                         " (bug?), disabling", filters[i].name, id);
             filters[i].enabled = 0;
+            chain_changed();
         }
         return NULL;
     }
@@ -33,6 +33,7 @@ enum tc_filter_list_enum {
 extern int tc_filter_init(void);
 extern void tc_filter_fini(void);
 extern void tc_filter_process(frame_list_t *frame);
+extern void tc_filter_pass(frame_list_t *frame);
 extern int tc_filter_add(const char *name, const char *options);
 extern int tc_filter_find(const char *name);
 extern void tc_filter_remove(int id);
@@ -0,0 +1,572 @@
+/*
+ *  frame_profile.c -- per-frame, per-stage timing of the transcoding
+ *                     pipeline.
+ *
+ *  This file is part of transcode, a video stream processing tool
+ *
+ *  transcode is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2, or (at your option)
+ *  any later version.
+ *
+ *  transcode is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with GNU Make; see the file COPYING.  If not, write to
+ *  the Free Software Foundation, 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ */
+
+#include "transcode.h"
+#include "framebuffer.h"
+#include "frame_profile.h"
+#include "libtc/libtc.h"
+
+#include <pthread.h>
+#include <time.h>
+
+/*************************************************************************/
+
+/* histogram buckets: bucket 0 is below 1us, bucket N (N > 0) holds
+ * [2^(N-1), 2^N) us; the last one takes everything longer */
+#define PROF_BUCKETS        24
+/* per-frame events kept by each thread */
+#define PROF_RING           4096
+/* frame buffer fill level samples kept, and their interval */
+#define PROF_SAMPLES        4096
+#define PROF_SAMPLE_NS      100000000ULL
+
+typedef struct profstats_ ProfStats;
+struct profstats_ {
+    uint64_t count;
+    uint64_t wall;              /* ns */
+    uint64_t cpu;               /* ns */
+    uint64_t wall_max;          /* ns */
+    uint32_t hist[PROF_BUCKETS];
+};
+
+typedef struct profevent_ ProfEvent;
+struct profevent_ {
+    int frame_id;
+    int stage;
+    int thread;
+    uint32_t wall;              /* us */
+    uint32_t cpu;               /* us */
+    uint64_t start;             /* ns since the profile start */
+};
+
+/* what a thread records; written by that thread only */
+typedef struct profthread_ ProfThread;
+struct profthread_ {
+    ProfThread *next;
+    int serial;                 /* thread number, for the report */
+    int reset;                  /* value of prof_reset_count seen last */
+    ProfStats stats[TC_PROF_MAX_STAGES];
+    volatile unsigned int events; /* events recorded; ring index modulo */
+    ProfEvent ring[PROF_RING];
+};
+
+typedef struct profsample_ ProfSample;
+struct profsample_ {
+    uint64_t time;              /* ns since the profile start */
+    int im[2], fl[2], ex[2];    /* [video, audio] frames per layer */
+};
+
+volatile int tc_profiling = TC_FALSE;
+
+static const char *builtin_stages[TC_PROF_BUILTIN_STAGES] = {
+    "import/video",
+    "import/audio",
+    "preprocess/video",
+    "process/video",
+    "process/audio",
+    "encode/video",
+    "encode/audio",
+    "multiplex",
+};
+
+/* protects the stage names, the thread list and the samples */
+static pthread_mutex_t prof_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static char *stage_names[TC_PROF_MAX_STAGES];
+static int stage_count = 0;
+
+static pthread_key_t prof_key;
+static pthread_once_t prof_once = PTHREAD_ONCE_INIT;
+static ProfThread *prof_threads = NULL;
+static int prof_thread_count = 0;
+static volatile int prof_reset_count = 0;
+
+static uint64_t prof_start = 0;
+static ProfSample samples[PROF_SAMPLES];
+static unsigned int sample_count = 0;
+static uint64_t next_sample = 0;
+
+static char *report_path = NULL;
+
+/*************************************************************************/
+
+static uint64_t clock_ns(clockid_t clock)
+{
+    struct timespec ts;
+
+    if (clock_gettime(clock, &ts) != 0)
+        return 0;
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void create_prof_key(void)
+{
+    /* buffers outlive their threads, for the final report */
+    pthread_key_create(&prof_key, NULL);
+}
+
+/* the buffer of the calling thread, allocated on first use */
+static ProfThread *prof_thread(void)
+{
+    ProfThread *t = NULL;
+
+    pthread_once(&prof_once, create_prof_key);
+    t = pthread_getspecific(prof_key);
+    if (!t) {
+        t = tc_zalloc(sizeof(ProfThread));
+        if (!t)
+            return NULL;
+        pthread_mutex_lock(&prof_lock);
+        t->serial = prof_thread_count++;
+        t->reset = prof_reset_count;
+        t->next = prof_threads;
+        prof_threads = t;
+        pthread_mutex_unlock(&prof_lock);
+        pthread_setspecific(prof_key, t);
+    }
+    return t;
+}
+
+static int bucket_of(uint64_t ns)
+{
+    uint64_t us = ns / 1000;
+    int b = 0;
+
+    while (us && b < PROF_BUCKETS - 1) {
+        us >>= 1;
+        b++;
+    }
+    return b;
+}
+
+/* upper bound of a bucket, in us */
+static uint64_t bucket_limit(int b)
+{
+    return (uint64_t)1 << b;
+}
+
+/* take a fill level sample if it is time to; never waits */
+static void sample_queues(uint64_t now)
+{
+    ProfSample *s = NULL;
+
+    if (now < next_sample || pthread_mutex_trylock(&prof_lock) != 0)
+        return;
+    if (now >= next_sample) {
+        next_sample = now + PROF_SAMPLE_NS;
+        s = &samples[sample_count % PROF_SAMPLES];
+        s->time = now - prof_start;
+        vframe_get_counters(&s->im[0], &s->fl[0], &s->ex[0]);
+        aframe_get_counters(&s->im[1], &s->fl[1], &s->ex[1]);
+        sample_count++;
+    }
+    pthread_mutex_unlock(&prof_lock);
+}
+
+/*************************************************************************/
+
+int tc_profile_init(const char *report)
+{
+    int i;
+
+    pthread_mutex_lock(&prof_lock);
+    for (i = stage_count; i < TC_PROF_BUILTIN_STAGES; i++) {
+        stage_names[i] = tc_strdup(builtin_stages[i]);
+        if (!stage_names[i]) {
+            pthread_mutex_unlock(&prof_lock);
+            return TC_ERROR;
+        }
+    }
+    if (stage_count < TC_PROF_BUILTIN_STAGES)
+        stage_count = TC_PROF_BUILTIN_STAGES;
+    pthread_mutex_unlock(&prof_lock);
+
+    if (report) {
+        report_path = tc_strdup(report);
+        if (!report_path)
+            return TC_ERROR;
+        tc_profile_enable(TC_TRUE);
+    }
+    return TC_OK;
+}
+
+static void stage_stats(int stage, ProfStats *sum);
+
+static void print_file(void *data, const char *line)
+{
+    fputs(line, data);
+}
+
+void tc_profile_fini(void)
+{
+    ProfThread *t = NULL;
+    int i;
+
+    tc_profiling = TC_FALSE;
+
+    if (report_path) {
+        FILE *f = fopen(report_path, "w");
+        if (!f) {
+            tc_log_perror(__FILE__, "unable to write the profile report");
+        } else {
+            char what[TC_BUF_MIN];
+            ProfStats st;
+
+            tc_profile_report("stages", print_file, f);
+            for (i = 0; i < stage_count; i++) {
+                stage_stats(i, &st);    /* all threads are done by now */
+                if (!st.count)
+                    continue;
+                tc_snprintf(what, sizeof(what), "hist %s", stage_names[i]);
+                fputs("\n", f);
+                tc_profile_report(what, print_file, f);
+            }
+            fputs("\n", f);
+            tc_profile_report("queues 0", print_file, f);
+            fputs("\n", f);
+            tc_profile_report("frames 0", print_file, f);
+            fclose(f);
+            if (verbose & TC_INFO)
+                tc_log_info(__FILE__, "profile written to %s", report_path);
+        }
+        tc_free(report_path);
+        report_path = NULL;
+    }
+
+    pthread_mutex_lock(&prof_lock);
+    while (prof_threads) {
+        t = prof_threads;
+        prof_threads = t->next;
+        tc_free(t);
+    }
+    prof_thread_count = 0;
+    for (i = 0; i < stage_count; i++) {
+        tc_free(stage_names[i]);
+        stage_names[i] = NULL;
+    }
+    stage_count = 0;
+    pthread_mutex_unlock(&prof_lock);
+}
+
+void tc_profile_enable(int on)
+{
+    if (on && !tc_profiling) {
+        pthread_mutex_lock(&prof_lock);
+        if (!prof_start)
+            prof_start = clock_ns(CLOCK_MONOTONIC);
+        pthread_mutex_unlock(&prof_lock);
+    }
+    tc_profiling = (on) ?TC_TRUE :TC_FALSE;
+}
+
+void tc_profile_reset(void)
+{
+    pthread_mutex_lock(&prof_lock);
+    prof_start = clock_ns(CLOCK_MONOTONIC);
+    next_sample = 0;
+    sample_count = 0;
+    prof_reset_count++;
+    pthread_mutex_unlock(&prof_lock);
+}
+
+int tc_profile_stage(const char *name)
+{
+    int i, stage = -1;
+
+    pthread_mutex_lock(&prof_lock);
+    for (i = 0; i < stage_count; i++) {
+        if (strcmp(stage_names[i], name) == 0) {
+            stage = i;
+            break;
+        }
+    }
+    if (stage < 0 && stage_count < TC_PROF_MAX_STAGES) {
+        stage_names[stage_count] = tc_strdup(name);
+        if (stage_names[stage_count])
+            stage = stage_count++;
+    }
+    pthread_mutex_unlock(&prof_lock);
+    return stage;
+}
+
+void tc_profile_now(TCProfMark *mark)
+{
+    mark->wall = clock_ns(CLOCK_MONOTONIC);
+    mark->cpu  = clock_ns(CLOCK_THREAD_CPUTIME_ID);
+}
+
+void tc_profile_record(const TCProfMark *mark, int stage, int frame_id)
+{
+    ProfThread *t = NULL;
+    ProfStats *st = NULL;
+    ProfEvent *ev = NULL;
+    uint64_t wall, cpu, now;
+
+    if (stage >= TC_PROF_MAX_STAGES)
+        return;
+    t = prof_thread();
+    if (!t)
+        return;
+
+    now  = clock_ns(CLOCK_MONOTONIC);
+    wall = now - mark->wall;
+    cpu  = clock_ns(CLOCK_THREAD_CPUTIME_ID) - mark->cpu;
+
+    if (t->reset != prof_reset_count) {
+        t->reset = prof_reset_count;
+        memset(t->stats, 0, sizeof(t->stats));
+        t->events = 0;
+    }
+
+    st = &t->stats[stage];
+    st->count++;
+    st->wall += wall;
+    st->cpu  += cpu;
+    if (wall > st->wall_max)
+        st->wall_max = wall;
+    st->hist[bucket_of(wall)]++;
+
+    ev = &t->ring[t->events % PROF_RING];
+    ev->frame_id = frame_id;
+    ev->stage    = stage;
+    ev->thread   = t->serial;
+    ev->wall     = wall / 1000;
+    ev->cpu      = cpu / 1000;
+    ev->start    = (mark->wall > prof_start) ?mark->wall - prof_start :0;
+    t->events++;
+
+    sample_queues(now);
+}
+
+/*************************************************************************/
+
+/* sum of the stats of all threads for one stage */
+static void stage_stats(int stage, ProfStats *sum)
+{
+    ProfThread *t = NULL;
+    int b;
+
+    memset(sum, 0, sizeof(*sum));
+    for (t = prof_threads; t; t = t->next) {
+        const ProfStats *st = &t->stats[stage];
+
+        if (t->reset != prof_reset_count)
+            continue;           /* not yet cleared */
+        sum->count += st->count;
+        sum->wall  += st->wall;
+        sum->cpu   += st->cpu;
+        if (st->wall_max > sum->wall_max)
+            sum->wall_max = st->wall_max;
+        for (b = 0; b < PROF_BUCKETS; b++)
+            sum->hist[b] += st->hist[b];
+    }
+}
+
+/* estimated percentile of the wall time, in us (upper bucket limit) */
+static uint64_t percentile(const ProfStats *st, int pct)
+{
+    uint64_t want = (st->count * pct + 99) / 100, seen = 0;
+    int b;
+
+    for (b = 0; b < PROF_BUCKETS; b++) {
+        seen += st->hist[b];
+        if (seen >= want)
+            return bucket_limit(b);
+    }
+    return st->wall_max / 1000;
+}
+
+static void report_stages(void (*print)(void *, const char *), void *data)
+{
+    char line[TC_BUF_LINE];
+    ProfStats stats[TC_PROF_MAX_STAGES];
+    int order[TC_PROF_MAX_STAGES], n = 0, i, j;
+
+    for (i = 0; i < stage_count; i++) {
+        stage_stats(i, &stats[i]);
+        if (!stats[i].count)
+            continue;
+        /* busiest stages first */
+        for (j = n; j > 0 && stats[order[j-1]].wall < stats[i].wall; j--)
+            order[j] = order[j-1];
+        order[j] = i;
+        n++;
+    }
+
+    tc_snprintf(line, sizeof(line), "%-28s %8s %10s %9s %9s %8s %8s %8s %10s %5s\n",
+                "stage", "frames", "wall_ms", "avg_us", "max_us",
+                "p50_us", "p90_us", "p99_us", "cpu_ms", "cpu%");
+    print(data, line);
+    for (j = 0; j < n; j++) {
+        const ProfStats *st = &stats[order[j]];
+
+        tc_snprintf(line, sizeof(line),
+                    "%-28s %8llu %10.1f %9.1f %9.1f %8llu %8llu %8llu %10.1f %5.1f\n",
+                    stage_names[order[j]],
+                    (unsigned long long)st->count,
+                    st->wall / 1e6,
+                    st->wall / 1e3 / st->count,
+                    st->wall_max / 1e3,
+                    (unsigned long long)percentile(st, 50),
+                    (unsigned long long)percentile(st, 90),
+                    (unsigned long long)percentile(st, 99),
+                    st->cpu / 1e6,
+                    (st->wall) ?100.0 * st->cpu / st->wall :0.0);
+        print(data, line);
+    }
+}
+
+static int report_hist(const char *name,
+                       void (*print)(void *, const char *), void *data)
+{
+    char line[TC_BUF_LINE];
+    ProfStats st;
+    int stage, b;
+
+    for (stage = 0; stage < stage_count; stage++) {
+        if (strcmp(stage_names[stage], name) == 0)
+            break;
+    }
+    if (stage >= stage_count)
+        return TC_ERROR;
+    stage_stats(stage, &st);
+
+    tc_snprintf(line, sizeof(line), "histogram %s (%llu frames)\n",
+                name, (unsigned long long)st.count);
+    print(data, line);
+    for (b = 0; b < PROF_BUCKETS; b++) {
+        if (!st.hist[b])
+            continue;
+        tc_snprintf(line, sizeof(line), "%9llu us %c %10lu  %5.1f%%\n",
+                    (unsigned long long)bucket_limit(b),
+                    (b == PROF_BUCKETS - 1) ?'+' :'<',
+                    (unsigned long)st.hist[b],
+                    100.0 * st.hist[b] / st.count);
+        print(data, line);
+    }
+    return TC_OK;
+}
+
+static void report_queues(int last,
+                          void (*print)(void *, const char *), void *data)
+{
+    char line[TC_BUF_LINE];
+    unsigned int first = 0, i;
+
+    if (sample_count > PROF_SAMPLES)
+        first = sample_count - PROF_SAMPLES;
+    if (last > 0 && sample_count - first > (unsigned)last)
+        first = sample_count - last;
+
+    tc_snprintf(line, sizeof(line), "%10s %6s %6s %6s %6s %6s %6s\n",
+                "time_ms", "v_im", "v_fl", "v_ex", "a_im", "a_fl", "a_ex");
+    print(data, line);
+    for (i = first; i < sample_count; i++) {
+        const ProfSample *s = &samples[i % PROF_SAMPLES];
+
+        tc_snprintf(line, sizeof(line), "%10.1f %6i %6i %6i %6i %6i %6i\n",
+                    s->time / 1e6, s->im[0], s->fl[0], s->ex[0],
+                    s->im[1], s->fl[1], s->ex[1]);
+        print(data, line);
+    }
+}
+
+static int event_cmp(const void *a, const void *b)
+{
+    const ProfEvent *ea = a, *eb = b;
+
+    return (ea->start > eb->start) - (ea->start < eb->start);
+}
+
+static void report_frames(int last,
+                          void (*print)(void *, const char *), void *data)
+{
+    char line[TC_BUF_LINE];
+    ProfThread *t = NULL;
+    ProfEvent *events = NULL;
+    size_t n = 0, i;
+
+    events = tc_malloc(sizeof(ProfEvent) * PROF_RING * prof_thread_count);
+    if (!events)
+        return;
+    for (t = prof_threads; t; t = t->next) {
+        unsigned int count = t->events, first = 0, k;
+
+        if (t->reset != prof_reset_count)
+            continue;
+        if (count > PROF_RING)
+            first = count - PROF_RING;
+        for (k = first; k < count; k++)
+            events[n++] = t->ring[k % PROF_RING];
+    }
+    qsort(events, n, sizeof(ProfEvent), event_cmp);
+
+    tc_snprintf(line, sizeof(line), "%8s %-28s %6s %10s %9s %9s\n",
+                "frame", "stage", "thread", "start_ms", "wall_us", "cpu_us");
+    print(data, line);
+    for (i = (last > 0 && n > (size_t)last) ?n - last :0; i < n; i++) {
+        const ProfEvent *ev = &events[i];
+
+        tc_snprintf(line, sizeof(line), "%8i %-28s %6i %10.3f %9lu %9lu\n",
+                    ev->frame_id, stage_names[ev->stage], ev->thread,
+                    ev->start / 1e6,
+                    (unsigned long)ev->wall, (unsigned long)ev->cpu);
+        print(data, line);
+    }
+    tc_free(events);
+}
+
+int tc_profile_report(const char *what,
+                      void (*print)(void *data, const char *line),
+                      void *data)
+{
+    int ret = TC_OK;
+    size_t len = strcspn(what, " \t");
+    const char *arg = what + len + strspn(what + len, " \t");
+
+    pthread_mutex_lock(&prof_lock);
+    if (len == 0 || strncasecmp(what, "stages", len) == 0) {
+        report_stages(print, data);
+    } else if (strncasecmp(what, "hist", len) == 0) {
+        ret = report_hist(arg, print, data);
+    } else if (strncasecmp(what, "queues", len) == 0) {
+        report_queues((*arg) ?atoi(arg) :50, print, data);
+    } else if (strncasecmp(what, "frames", len) == 0) {
+        report_frames((*arg) ?atoi(arg) :50, print, data);
+    } else {
+        ret = TC_ERROR;
+    }
+    pthread_mutex_unlock(&prof_lock);
+    return ret;
+}
+
+/*************************************************************************/
+
+/*
+ * Local variables:
+ *   c-file-style: "stroustrup"
+ *   c-file-offsets: ((case-label . *) (statement-case-intro . *))
+ *   indent-tabs-mode: nil
+ * End:
+ *
+ * vim: expandtab shiftwidth=4:
+ */
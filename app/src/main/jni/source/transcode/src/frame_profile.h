@@ -0,0 +1,193 @@
+/*
+ *  frame_profile.h -- per-frame, per-stage timing of the transcoding
+ *                     pipeline.
+ *
+ *  This file is part of transcode, a video stream processing tool
+ *
+ *  transcode is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2, or (at your option)
+ *  any later version.
+ *
+ *  transcode is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with GNU Make; see the file COPYING.  If not, write to
+ *  the Free Software Foundation, 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ */
+
+#ifndef FRAME_PROFILE_H
+#define FRAME_PROFILE_H
+
+#include <stdint.h>
+
+/*
+ * SUMMARY:
+ *
+ * When profiling is on, every pipeline stage a frame goes through
+ * (import, pre-processing, each filter, internal processing, encoding,
+ * multiplexing) measures the wall clock and CPU time it spends on the
+ * frame.  Each thread records its measurements in a buffer of its own
+ * (per-stage totals and histograms, and a ring of the latest per-frame
+ * events), so recording takes no locks; readers just take a snapshot,
+ * which may be off by the frame being recorded.  The fill level of the
+ * frame buffer layers is sampled alongside, a few times per second.
+ *
+ * The results are available through the control socket ("profile"
+ * command) and are written to a report file at the end of the run if
+ * one was requested.
+ */
+
+/* builtin stages; filters register stages of their own */
+enum {
+    TC_PROF_IMPORT_VIDEO = 0,
+    TC_PROF_IMPORT_AUDIO,
+    TC_PROF_PREPROCESS_VIDEO,
+    TC_PROF_PROCESS_VIDEO,
+    TC_PROF_PROCESS_AUDIO,
+    TC_PROF_ENCODE_VIDEO,
+    TC_PROF_ENCODE_AUDIO,
+    TC_PROF_MULTIPLEX,
+    TC_PROF_BUILTIN_STAGES
+};
+
+/* maximum number of stages, builtin ones included */
+#define TC_PROF_MAX_STAGES      64
+
+/* start of a measurement */
+typedef struct tcprofmark_ TCProfMark;
+struct tcprofmark_ {
+    int on;                     /* profiling was on at the start */
+    uint64_t wall;              /* nanoseconds */
+    uint64_t cpu;               /* nanoseconds of thread CPU time */
+};
+
+/* nonzero while profiling is on; do not change directly */
+extern volatile int tc_profiling;
+
+/*
+ * tc_profile_init: set up the profiler.  Must be called before any
+ * frame is processed; profiling itself can be switched on and off at
+ * any time afterwards.
+ *
+ * Parameters:
+ *      report: if not NULL, turn profiling on now and write a report
+ *              to this file in tc_profile_fini().
+ * Return Value:
+ *      TC_OK on success, TC_ERROR on error.
+ */
+int tc_profile_init(const char *report);
+
+/*
+ * tc_profile_fini: write the report file, if one was requested, and
+ * release all profiling data.  No thread may be recording anymore.
+ *
+ * Parameters:
+ *      None.
+ * Return Value:
+ *      None.
+ */
+void tc_profile_fini(void);
+
+/*
+ * tc_profile_enable: switch profiling on or off.
+ *
+ * Parameters:
+ *      on: !0 to switch profiling on, 0 to switch it off.
+ * Return Value:
+ *      None.
+ */
+void tc_profile_enable(int on);
+
+/*
+ * tc_profile_reset: drop everything recorded so far.  Threads clear
+ * their buffers at their next measurement.
+ *
+ * Parameters:
+ *      None.
+ * Return Value:
+ *      None.
+ */
+void tc_profile_reset(void);
+
+/*
+ * tc_profile_stage (thread safe): get the stage number for the given
+ * stage name, registering it if needed.
+ *
+ * Parameters:
+ *      name: stage name.
+ * Return Value:
+ *      stage number, or -1 if there are too many stages already.
+ */
+int tc_profile_stage(const char *name);
+
+/*
+ * tc_profile_record (thread safe): account a measurement started with
+ * tc_profile_begin(); use tc_profile_end() instead.
+ */
+void tc_profile_record(const TCProfMark *mark, int stage, int frame_id);
+
+/*
+ * tc_profile_now: fill the mark with the current wall clock and thread
+ * CPU times; use tc_profile_begin() instead.
+ */
+void tc_profile_now(TCProfMark *mark);
+
+/*
+ * tc_profile_begin, tc_profile_end (thread safe): measure the time
+ * spent between the two calls on behalf of the given stage and frame.
+ * Cost nothing worth speaking of when profiling is off.
+ *
+ * Parameters:
+ *          mark: measurement to start/finish.
+ *         stage: stage number (TC_PROF_* or from tc_profile_stage()).
+ *      frame_id: frame the time was spent on.
+ * Return Value:
+ *      None.
+ */
+static inline void tc_profile_begin(TCProfMark *mark)
+{
+    mark->on = tc_profiling;
+    if (mark->on)
+        tc_profile_now(mark);
+}
+
+static inline void tc_profile_end(const TCProfMark *mark,
+                                  int stage, int frame_id)
+{
+    if (mark->on && stage >= 0)
+        tc_profile_record(mark, stage, frame_id);
+}
+
+/*
+ * tc_profile_report: print profiling results.
+ *
+ * Parameters:
+ *       what: "stages" for per-stage totals; "hist STAGE" for the
+ *             histogram of one stage; "queues" for the frame buffer
+ *             fill level timeline; "frames [N]" for the N (default 50)
+ *             latest per-frame events.
+ *      print: function printing one line of output (newline included).
+ *       data: opaque argument for `print'.
+ * Return Value:
+ *      TC_OK on success, TC_ERROR if `what' is not understood.
+ */
+int tc_profile_report(const char *what,
+                      void (*print)(void *data, const char *line),
+                      void *data);
+
+#endif /* FRAME_PROFILE_H */
+
+/*
+ * Local variables:
+ *   c-file-style: "stroustrup"
+ *   c-file-offsets: ((case-label . *) (statement-case-intro . *))
+ *   indent-tabs-mode: nil
+ * End:
+ *
+ * vim: expandtab shiftwidth=4:
+ */
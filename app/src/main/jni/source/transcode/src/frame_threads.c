@@ -166,6 +166,21 @@ static int stop_requested(TCFrameThreadData *data)
     tc_frame_threads_stop((DATAP)); \
 } while (0)
 
+/*
+ * a frame dropped by a worker must still go through the filter gates of
+ * the multithreaded stages it will miss, or the frames behind it would
+ * wait for it forever (see tc_filter_pass).
+ */
+static void pass_filters(frame_list_t *ptr, int media, int pre)
+{
+    if (pre) {
+        ptr->tag = media|TC_PRE_M_PROCESS;
+        tc_filter_pass(ptr);
+    }
+    ptr->tag = media|TC_POST_M_PROCESS;
+    tc_filter_pass(ptr);
+}
+
 static void *process_video_frame(void *_vob)
 {
     static int res = 0; // XXX
@@ -184,16 +199,20 @@ static void *process_video_frame(void *_vob)
         }
 
         if (ptr->attributes & TC_FRAME_IS_SKIPPED) {
+            pass_filters((frame_list_t *)ptr, TC_VIDEO, TC_TRUE);
             vframe_remove(ptr);  /* release frame buffer memory */
             continue;
         }
 
-        if (TC_FRAME_NEED_PROCESSING(ptr)) {
+        if (!TC_FRAME_NEED_PROCESSING(ptr)) {
+            pass_filters((frame_list_t *)ptr, TC_VIDEO, TC_TRUE);
+        } else {
             // external plugin pre-processing
             ptr->tag = TC_VIDEO|TC_PRE_M_PROCESS;
             tc_filter_process((frame_list_t *)ptr);
 
             if (ptr->attributes & TC_FRAME_IS_SKIPPED) {
+                pass_filters((frame_list_t *)ptr, TC_VIDEO, TC_FALSE);
                 vframe_remove(ptr);  /* release frame buffer memory */
                 continue;
             }
@@ -243,11 +262,14 @@ static void *process_audio_frame(void *_vob)
         }
 
         if (ptr->attributes & TC_FRAME_IS_SKIPPED) {
+            pass_filters((frame_list_t *)ptr, TC_AUDIO, TC_TRUE);
             aframe_remove(ptr);  /* release frame buffer memory */
             continue;
         }
 
-        if (TC_FRAME_NEED_PROCESSING(ptr)) {
+        if (!TC_FRAME_NEED_PROCESSING(ptr)) {
+            pass_filters((frame_list_t *)ptr, TC_AUDIO, TC_TRUE);
+        } else {
             // external plugin pre-processing
             ptr->tag = TC_AUDIO|TC_PRE_M_PROCESS;
             tc_filter_process((frame_list_t *)ptr);
@@ -255,6 +277,7 @@ static void *process_audio_frame(void *_vob)
             DUP_aptr_if_cloned(ptr);
 
             if (ptr->attributes & TC_FRAME_IS_SKIPPED) {
+                pass_filters((frame_list_t *)ptr, TC_AUDIO, TC_FALSE);
                 aframe_remove(ptr);  /* release frame buffer memory */
                 continue;
             }
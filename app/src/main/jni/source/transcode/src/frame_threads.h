@@ -36,6 +36,11 @@
  * It is important to note that each thread is equivalent to each
  * other, and each one will take care of one frame and applies to
  * it the whole filter chain.
+ * Frames are completed out of order, but they are handed to the encoder
+ * in decode order, since the export side of the frame ring only takes
+ * them back in the order they were registered. Filters which are not
+ * declared stateless see the frames one at a time, in id order (or just
+ * one at a time if they are declared serial); see tc_filter_process().
  */
 
 /*
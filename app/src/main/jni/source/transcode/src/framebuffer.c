@@ -50,6 +50,27 @@
  * piece of code most urgent todos for 1.1.0.      -- FR
  */
 
+/*
+ * Atomic helpers for the lock-free rings. Older compilers lacking the
+ * __atomic builtins get the (stronger, slower) __sync ones instead.
+ */
+#ifdef __ATOMIC_ACQUIRE
+#define TC_ATOMIC_LOAD(P)       __atomic_load_n((P), __ATOMIC_ACQUIRE)
+#define TC_ATOMIC_STORE(P, V)   __atomic_store_n((P), (V), __ATOMIC_RELEASE)
+#define TC_ATOMIC_ADD(P, N)     __atomic_add_fetch((P), (N), __ATOMIC_SEQ_CST)
+#else
+#define TC_ATOMIC_LOAD(P)       __sync_add_and_fetch((P), 0)
+#define TC_ATOMIC_STORE(P, V)   do { \
+    __sync_synchronize(); \
+    *(volatile __typeof__(*(P)) *)(P) = (V); \
+    __sync_synchronize(); \
+} while (0)
+#define TC_ATOMIC_ADD(P, N)     __sync_add_and_fetch((P), (N))
+#endif
+#define TC_ATOMIC_CAS(P, O, N)  __sync_bool_compare_and_swap((P), (O), (N))
+
+static int tc_lockfree_rings = TC_FALSE;
+
 static pthread_mutex_t aframe_list_lock = PTHREAD_MUTEX_INITIALIZER;
 static aframe_list_t *aframe_list_head = NULL;
 static aframe_list_t *aframe_list_tail = NULL;
@@ -64,6 +85,8 @@ static pthread_cond_t video_import_cond = PTHREAD_COND_INITIALIZER;
 static pthread_cond_t video_filter_cond = PTHREAD_COND_INITIALIZER;
 static pthread_cond_t video_export_cond = PTHREAD_COND_INITIALIZER;
 
+static void tc_lockfree_interrupt(int import_only);
+
 void tc_framebuffer_interrupt_import(void)
 {
     pthread_mutex_lock(&aframe_list_lock);
@@ -73,6 +96,8 @@ void tc_framebuffer_interrupt_import(void)
     pthread_mutex_lock(&vframe_list_lock);
     pthread_cond_signal(&video_import_cond);
     pthread_mutex_unlock(&vframe_list_lock);
+
+    tc_lockfree_interrupt(TC_TRUE);
 }
 
 void tc_framebuffer_interrupt(void)
@@ -90,6 +115,8 @@ void tc_framebuffer_interrupt(void)
     /* filter layer deserves special care */
     pthread_cond_signal(&video_export_cond);
     pthread_mutex_unlock(&vframe_list_lock);
+
+    tc_lockfree_interrupt(TC_FALSE);
 }
 
 /* ------------------------------------------------------------------ */
@@ -107,6 +134,18 @@ typedef void (*TCFrameFreeFn)(TCFramePtr);
 
 /* ------------------------------------------------------------------ */
 
+/*
+ * Parking spot for a lock-free ring stage (see tc_ring_park below).
+ * A stage only touches the mutex when it has really nothing to do.
+ */
+typedef struct tcringparker_ TCRingParker;
+struct tcringparker_ {
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    unsigned int seq;      /* bumped on every wakeup  */
+    int waiters;           /* threads parked (or about to) */
+};
+
 typedef struct tcringframebuffer_ TCRingFrameBuffer;
 struct tcringframebuffer_ {
     /* real ringbuffer */
@@ -128,6 +167,24 @@ struct tcringframebuffer_ {
     /* (de)allocation helpers */
     TCFrameAllocFn alloc;
     TCFrameFreeFn free;
+
+    /* lock-free mode only, see tc_framebuffer_set_lockfree() */
+    int lockfree;
+    unsigned long im_pos;       /* next slot to be registered (import) */
+    unsigned long fl_pos;       /* next slot to be reserved (filter)   */
+    unsigned long ex_pos;       /* next slot to be released (export)   */
+    frame_list_t *ex_cur;       /* export position inside ex_pos slot  */
+
+    TCRingParker import_park;
+    TCRingParker filter_park;
+    TCRingParker export_park;
+
+    /* clones are rare enough to live happily under a lock */
+    pthread_mutex_t clone_lock;
+    frame_list_t *clone_head;   /* clones waiting for the filter layer */
+    frame_list_t *clone_tail;
+    frame_list_t *spares;       /* released clones, ready for reuse    */
+    int clones;                 /* how many in clone_head queue?       */
 };
 
 static TCRingFrameBuffer tc_audio_ringbuffer;
@@ -139,7 +196,7 @@ static TCRingFrameBuffer tc_video_ringbuffer;
  */
 static TCFrameSpecs tc_specs = {
     /* Largest supported values, to ensure the buffer is always big enough
-     * (see FIXME in tc_framebuffer_set_specs()) */
+     * until the real ones are known (see tc_framebuffer_set_specs()) */
     .frc      = 3,  // PAL, why not
     .width    = TC_MAX_V_FRAME_WIDTH,
     .height   = TC_MAX_V_FRAME_HEIGHT,
@@ -207,13 +264,16 @@ aframe_list_t *aframe_alloc_single(void)
 
 /* ------------------------------------------------------------------ */
 
-static void tc_ring_framebuffer_dump_status(const TCRingFrameBuffer *rfb,
+static void tc_ring_framebuffer_dump_status(TCRingFrameBuffer *rfb,
                                             const char *id)
 {
     tc_log_msg(__FILE__, "%s: null=%i empty=%i wait=%i"
                          " locked=%i ready=%i",
-                         id, rfb->null, rfb->empty, rfb->wait,
-                         rfb->locked, rfb->ready);
+                         id, TC_ATOMIC_LOAD(&rfb->null),
+                         TC_ATOMIC_LOAD(&rfb->empty),
+                         TC_ATOMIC_LOAD(&rfb->wait),
+                         TC_ATOMIC_LOAD(&rfb->locked),
+                         TC_ATOMIC_LOAD(&rfb->ready));
 }
 
 
@@ -236,14 +296,16 @@ void tc_framebuffer_set_specs(const TCFrameSpecs *specs)
         /* raw copy first */
         ac_memcpy(&tc_specs, specs, sizeof(TCFrameSpecs));
 
-        /* restore width/height/bpp
-         * (FIXME: temp until we have a way to know the max size that will
-         *         be used through the decode/process/encode chain; without
-         *         this, -V yuv420p -y raw -F rgb (e.g.) crashes with a
-         *         buffer overrun)
+        /* 
+         * width/height are the largest ones through the whole
+         * decode/process/encode chain (the caller's job), but any
+         * stage may convert to RGB (e.g. -V yuv420p -y raw -F rgb),
+         * so always reserve room for the fattest format.
          */
-        tc_specs.width  = TC_MAX_V_FRAME_WIDTH;
-        tc_specs.height = TC_MAX_V_FRAME_HEIGHT;
+        if (tc_specs.width <= 0 || tc_specs.height <= 0) {
+            tc_specs.width  = TC_MAX_V_FRAME_WIDTH;
+            tc_specs.height = TC_MAX_V_FRAME_HEIGHT;
+        }
         tc_specs.format = TC_CODEC_RGB;
 
         /* then deduct missing parameters */
@@ -263,6 +325,513 @@ void tc_framebuffer_set_specs(const TCFrameSpecs *specs)
     }
 }
 
+/* ------------------------------------------------------------------ */
+/* Lock-free rings                                                    */
+/* ------------------------------------------------------------------ */
+
+/*
+ * In lock-free mode pool frames are used strictly in ring order:
+ * the N-th registered frame always lives in slot N % size, and each
+ * processing stage owns a monotonic cursor:
+ *
+ *   im_pos: moved only by the import thread ({a,v}frame_register).
+ *   fl_pos: moved by any filter thread. Frames are claimed by switching
+ *           their status from TC_FRAME_WAIT to TC_FRAME_LOCKED with a
+ *           compare-and-swap, so this cursor is just a hint.
+ *   ex_pos: moved only by the export thread. A slot goes back to the
+ *           import layer as soon as export walked past it.
+ *
+ * Frames removed by the filter layer (e.g. skipped) stay in their slot
+ * marked as TC_FRAME_NULL until export walks over them.
+ * Clones made by {a,v}frame_dup don't come from the pool: they hang
+ * after their original on the `next' chain, exactly as in the legacy
+ * frame list, and reach the filter layer through a small locked queue
+ * (linked through `prev', unused otherwise in this mode).
+ * The frame order seen by export is the same as in the locked code.
+ *
+ * Counters are updated atomically following the very same rules of
+ * the locked code, so {a,v}frame_get_counters report the same values.
+ * A stage parks on a condition variable only when it is starved.
+ */
+
+static void tc_ring_parker_init(TCRingParker *pk)
+{
+    pthread_mutex_init(&pk->lock, NULL);
+    pthread_cond_init(&pk->cond, NULL);
+    pk->seq     = 0;
+    pk->waiters = 0;
+}
+
+static void tc_ring_parker_fini(TCRingParker *pk)
+{
+    pthread_cond_destroy(&pk->cond);
+    pthread_mutex_destroy(&pk->lock);
+}
+
+/*
+ * tc_ring_park_key: (thread safe)
+ *     snapshot the wakeup count of a parking spot. Must be taken
+ *     *before* checking the condition which may lead to park.
+ */
+static unsigned int tc_ring_park_key(TCRingParker *pk)
+{
+    return TC_ATOMIC_LOAD(&pk->seq);
+}
+
+/*
+ * tc_ring_park: (thread safe)
+ *     sleep until tc_ring_unpark is called on this spot after `key'
+ *     was taken; return immediately if that already happened.
+ */
+static void tc_ring_park(TCRingParker *pk, unsigned int key)
+{
+    pthread_mutex_lock(&pk->lock);
+    TC_ATOMIC_ADD(&pk->waiters, 1);
+    while (TC_ATOMIC_ADD(&pk->seq, 0) == key) {
+        pthread_cond_wait(&pk->cond, &pk->lock);
+    }
+    TC_ATOMIC_ADD(&pk->waiters, -1);
+    pthread_mutex_unlock(&pk->lock);
+}
+
+/*
+ * tc_ring_unpark: (thread safe)
+ *     wake up every thread parked on this spot. Does not lock anything
+ *     if nobody is parked.
+ */
+static void tc_ring_unpark(TCRingParker *pk)
+{
+    TC_ATOMIC_ADD(&pk->seq, 1);
+    if (TC_ATOMIC_ADD(&pk->waiters, 0) > 0) {
+        pthread_mutex_lock(&pk->lock);
+        pthread_cond_broadcast(&pk->cond);
+        pthread_mutex_unlock(&pk->lock);
+    }
+}
+
+static void tc_ring_lockfree_init(TCRingFrameBuffer *rfb)
+{
+    rfb->im_pos = 0;
+    rfb->fl_pos = 0;
+    rfb->ex_pos = 0;
+    rfb->ex_cur = NULL;
+
+    tc_ring_parker_init(&rfb->import_park);
+    tc_ring_parker_init(&rfb->filter_park);
+    tc_ring_parker_init(&rfb->export_park);
+
+    pthread_mutex_init(&rfb->clone_lock, NULL);
+    rfb->clone_head = NULL;
+    rfb->clone_tail = NULL;
+    rfb->spares     = NULL;
+    rfb->clones     = 0;
+}
+
+static void tc_ring_lockfree_fini(TCRingFrameBuffer *rfb)
+{
+    while (rfb->spares != NULL) {
+        TCFramePtr frame;
+
+        frame.generic = rfb->spares;
+        rfb->spares = rfb->spares->next;
+        rfb->free(frame);
+    }
+
+    pthread_mutex_destroy(&rfb->clone_lock);
+    tc_ring_parker_fini(&rfb->export_park);
+    tc_ring_parker_fini(&rfb->filter_park);
+    tc_ring_parker_fini(&rfb->import_park);
+}
+
+/* update the counter matching `status' (if any) by `n' */
+static void tc_ring_lockfree_account(TCRingFrameBuffer *rfb,
+                                     int status, int n)
+{
+    switch (status) {
+      case TC_FRAME_EMPTY:
+        TC_ATOMIC_ADD(&rfb->empty, n);
+        break;
+      case TC_FRAME_WAIT:
+        TC_ATOMIC_ADD(&rfb->wait, n);
+        break;
+      case TC_FRAME_LOCKED:
+        TC_ATOMIC_ADD(&rfb->locked, n);
+        break;
+      case TC_FRAME_READY:
+        TC_ATOMIC_ADD(&rfb->ready, n);
+        break;
+      default: /* TC_FRAME_NULL isn't tracked here */
+        break;
+    }
+}
+
+/*
+ * tc_ring_lockfree_register: (import thread only)
+ *      lock-free flavour of {a,v}frame_register: wait for the next slot
+ *      to be released by the export layer and hand out its frame.
+ *
+ * Parameters:
+ *          rfb: ring framebuffer to use.
+ *           id: id to attach to registered framebuffer.
+ *      running: tells if the import layer of this ring is still active.
+ * Return Value:
+ *      Generic pointer to the registered frame; pointer to NULL if
+ *      the framebuffer was interrupted.
+ */
+static TCFramePtr tc_ring_lockfree_register(TCRingFrameBuffer *rfb, int id,
+                                            int (*running)(void))
+{
+    unsigned long size = rfb->last;
+    unsigned long pos = rfb->im_pos; /* we are the only writer */
+    int interrupted = TC_FALSE;
+    TCFramePtr ptr;
+
+    ptr.generic = NULL;
+
+    while ((!interrupted && running())
+      && pos - TC_ATOMIC_LOAD(&rfb->ex_pos) >= size) {
+        unsigned int key = tc_ring_park_key(&rfb->import_park);
+
+        if (pos - TC_ATOMIC_LOAD(&rfb->ex_pos) < size) {
+            break;
+        }
+        if (!tc_running()) {
+            /* interrupted after the check above, don't park for ever */
+            interrupted = TC_TRUE;
+            break;
+        }
+        tc_ring_park(&rfb->import_park, key);
+        interrupted = !tc_running();
+    }
+
+    if (!interrupted && pos - TC_ATOMIC_LOAD(&rfb->ex_pos) < size) {
+        ptr = rfb->frames[pos % size];
+
+        /* blank common attributes */
+        memset(ptr.generic, 0, sizeof(frame_list_t));
+        ptr.generic->id     = id;
+        ptr.generic->status = TC_FRAME_EMPTY;
+
+        TC_ATOMIC_ADD(&rfb->null, -1);
+        TC_ATOMIC_ADD(&rfb->empty, 1);
+        TC_ATOMIC_STORE(&rfb->im_pos, pos + 1);
+
+        if (verbose >= TC_FLIST) {
+            tc_ring_framebuffer_dump_status(rfb, "register_frame");
+        }
+    }
+    return ptr;
+}
+
+/*
+ * tc_ring_lockfree_push_next: (thread safe)
+ *      lock-free flavour of {a,v}frame_push_next.
+ */
+static void tc_ring_lockfree_push_next(TCRingFrameBuffer *rfb,
+                                       frame_list_t *ptr, int status)
+{
+    tc_ring_lockfree_account(rfb, TC_ATOMIC_LOAD(&ptr->status), -1);
+    tc_ring_lockfree_account(rfb, status, 1);
+    TC_ATOMIC_STORE(&ptr->status, status);
+
+    if (status == TC_FRAME_WAIT) {
+        tc_ring_unpark(&rfb->filter_park);
+    } else if (status == TC_FRAME_READY) {
+        tc_ring_unpark(&rfb->export_park);
+    }
+    if (verbose >= TC_FLIST) {
+        tc_ring_framebuffer_dump_status(rfb, "push_next");
+    }
+}
+
+/*
+ * tc_ring_lockfree_claim: (thread safe)
+ *      try to claim the next frame waiting for the filter layer,
+ *      pending clones first. Never blocks.
+ *
+ * Parameters:
+ *      rfb: ring framebuffer to use.
+ * Return Value:
+ *      Pointer to the claimed (now TC_FRAME_LOCKED) frame, or NULL
+ *      if there is nothing to claim right now.
+ */
+static frame_list_t *tc_ring_lockfree_claim(TCRingFrameBuffer *rfb)
+{
+    frame_list_t *ptr = NULL;
+
+    if (TC_ATOMIC_LOAD(&rfb->clones) > 0) {
+        pthread_mutex_lock(&rfb->clone_lock);
+        ptr = rfb->clone_head;
+        if (ptr != NULL
+         && TC_ATOMIC_CAS(&ptr->status, TC_FRAME_WAIT, TC_FRAME_LOCKED)) {
+            rfb->clone_head = ptr->prev;
+            if (rfb->clone_head == NULL) {
+                rfb->clone_tail = NULL;
+            }
+            TC_ATOMIC_ADD(&rfb->clones, -1);
+        } else {
+            ptr = NULL; /* not yet pushed by its creator */
+        }
+        pthread_mutex_unlock(&rfb->clone_lock);
+    }
+
+    while (ptr == NULL) {
+        unsigned long pos = TC_ATOMIC_LOAD(&rfb->fl_pos);
+        int status;
+
+        if (pos == TC_ATOMIC_LOAD(&rfb->im_pos)) {
+            break;
+        }
+        ptr = rfb->frames[pos % rfb->last].generic;
+        status = TC_ATOMIC_LOAD(&ptr->status);
+        if (status == TC_FRAME_EMPTY) {
+            ptr = NULL; /* still being filled by import */
+            break;
+        }
+        if (status != TC_FRAME_WAIT
+         || !TC_ATOMIC_CAS(&ptr->status, TC_FRAME_WAIT, TC_FRAME_LOCKED)) {
+            ptr = NULL; /* taken by someone else, or not for us */
+        }
+        /* in any case, this slot is done for the filter layer */
+        TC_ATOMIC_CAS(&rfb->fl_pos, pos, pos + 1);
+    }
+
+    if (ptr != NULL) {
+        TC_ATOMIC_ADD(&rfb->wait, -1);
+        TC_ATOMIC_ADD(&rfb->locked, 1);
+    }
+    return ptr;
+}
+
+/*
+ * tc_ring_lockfree_reserve: (thread safe)
+ *      lock-free flavour of {a,v}frame_reserve.
+ */
+static frame_list_t *tc_ring_lockfree_reserve(TCRingFrameBuffer *rfb)
+{
+    int interrupted = TC_FALSE;
+    frame_list_t *ptr = NULL;
+
+    while (!interrupted) {
+        unsigned int key = tc_ring_park_key(&rfb->filter_park);
+
+        ptr = tc_ring_lockfree_claim(rfb);
+        if (ptr != NULL) {
+            break;
+        }
+        if (!tc_running()) {
+            break;
+        }
+        if (verbose >= TC_FLIST) {
+            tc_log_msg(__FILE__, "(reserve) frame not ready, parking");
+        }
+        tc_ring_park(&rfb->filter_park, key);
+        interrupted = !tc_running();
+    }
+    return ptr;
+}
+
+/* give back a clone which went through the whole pipeline */
+static void tc_ring_lockfree_recycle(TCRingFrameBuffer *rfb,
+                                     frame_list_t *ptr)
+{
+    pthread_mutex_lock(&rfb->clone_lock);
+    ptr->next = rfb->spares;
+    rfb->spares = ptr;
+    pthread_mutex_unlock(&rfb->clone_lock);
+}
+
+/*
+ * tc_ring_lockfree_head: (export thread only)
+ *      walk over the frames already removed, giving fully consumed
+ *      slots back to the import layer.
+ *
+ * Parameters:
+ *      rfb: ring framebuffer to use.
+ * Return Value:
+ *      Pointer to the first frame not yet removed, whatever is its
+ *      status, or NULL if the ring is empty.
+ */
+static frame_list_t *tc_ring_lockfree_head(TCRingFrameBuffer *rfb)
+{
+    unsigned long pos = rfb->ex_pos; /* we are the only writer */
+    frame_list_t *cur = rfb->ex_cur;
+
+    while (pos != TC_ATOMIC_LOAD(&rfb->im_pos)) {
+        frame_list_t *slot = rfb->frames[pos % rfb->last].generic;
+        frame_list_t *next = NULL;
+
+        if (cur == NULL) {
+            cur = slot;
+        }
+        if (TC_ATOMIC_LOAD(&cur->status) != TC_FRAME_NULL) {
+            break;
+        }
+        next = cur->next;
+        if (cur != slot) {
+            tc_ring_lockfree_recycle(rfb, cur);
+        }
+        cur = next;
+        if (cur == NULL) {
+            pos++;
+            TC_ATOMIC_STORE(&rfb->ex_pos, pos);
+            tc_ring_unpark(&rfb->import_park);
+        }
+    }
+    rfb->ex_cur = cur;
+    return cur;
+}
+
+/*
+ * tc_ring_lockfree_retrieve: (export thread only)
+ *      lock-free flavour of {a,v}frame_retrieve. If `block' is false,
+ *      return NULL at once if the head frame isn't TC_FRAME_READY.
+ */
+static frame_list_t *tc_ring_lockfree_retrieve(TCRingFrameBuffer *rfb,
+                                               int block)
+{
+    int interrupted = TC_FALSE;
+    frame_list_t *ptr = NULL;
+
+    while (!interrupted) {
+        unsigned int key = tc_ring_park_key(&rfb->export_park);
+
+        ptr = tc_ring_lockfree_head(rfb);
+        if (ptr != NULL && TC_ATOMIC_LOAD(&ptr->status) == TC_FRAME_READY) {
+            break;
+        }
+        ptr = NULL;
+        if (!block || !tc_running()) {
+            break;
+        }
+        if (verbose >= TC_FLIST) {
+            tc_log_msg(__FILE__, "(retrieve) frame not ready, parking");
+            tc_ring_framebuffer_dump_status(rfb, "retrieve");
+        }
+        tc_ring_park(&rfb->export_park, key);
+        interrupted = !tc_running();
+    }
+    return ptr;
+}
+
+/*
+ * tc_ring_lockfree_remove: (thread safe)
+ *      lock-free flavour of {a,v}frame_remove. The export layer removes
+ *      TC_FRAME_READY frames, the filter layer TC_FRAME_LOCKED ones.
+ */
+static void tc_ring_lockfree_remove(TCRingFrameBuffer *rfb,
+                                    frame_list_t *ptr)
+{
+    int status = TC_ATOMIC_LOAD(&ptr->status);
+
+    if (status == TC_FRAME_READY) {
+        TC_ATOMIC_ADD(&rfb->ready, -1);
+    }
+    if (status == TC_FRAME_LOCKED) {
+        TC_ATOMIC_ADD(&rfb->locked, -1);
+    }
+    TC_ATOMIC_ADD(&rfb->null, 1);
+    TC_ATOMIC_STORE(&ptr->status, TC_FRAME_NULL);
+
+    if (status == TC_FRAME_READY) {
+        /* export layer: hand the slot back to import right now */
+        tc_ring_lockfree_head(rfb);
+    } else {
+        /* export may be waiting right for this frame */
+        tc_ring_unpark(&rfb->export_park);
+    }
+    if (verbose >= TC_FLIST) {
+        tc_ring_framebuffer_dump_status(rfb, "remove_frame");
+    }
+}
+
+/*
+ * tc_ring_lockfree_clone: (thread safe)
+ *      get a frame to be used as clone, reusing a spare one if possible.
+ *      The caller must fill it and then use tc_ring_lockfree_link.
+ */
+static TCFramePtr tc_ring_lockfree_clone(TCRingFrameBuffer *rfb)
+{
+    TCFramePtr ptr;
+
+    pthread_mutex_lock(&rfb->clone_lock);
+    ptr.generic = rfb->spares;
+    if (ptr.generic != NULL) {
+        rfb->spares = ptr.generic->next;
+    }
+    pthread_mutex_unlock(&rfb->clone_lock);
+
+    if (TCFRAMEPTR_IS_NULL(ptr)) {
+        ptr = rfb->alloc(rfb->specs);
+    }
+    if (!TCFRAMEPTR_IS_NULL(ptr)) {
+        /* same accounting as a frame registered as TC_FRAME_WAIT */
+        TC_ATOMIC_ADD(&rfb->null, -1);
+        TC_ATOMIC_ADD(&rfb->wait, 1);
+    }
+    return ptr;
+}
+
+/*
+ * tc_ring_lockfree_link: (thread safe)
+ *      link a filled clone right after its original frame `f' (which
+ *      must be held by the caller) and queue it for the filter layer.
+ */
+static void tc_ring_lockfree_link(TCRingFrameBuffer *rfb,
+                                  frame_list_t *ptr, frame_list_t *f)
+{
+    ptr->next = f->next;
+    f->next   = ptr;
+
+    pthread_mutex_lock(&rfb->clone_lock);
+    ptr->prev = NULL;
+    if (rfb->clone_tail != NULL) {
+        rfb->clone_tail->prev = ptr;
+    } else {
+        rfb->clone_head = ptr;
+    }
+    rfb->clone_tail = ptr;
+    TC_ATOMIC_ADD(&rfb->clones, 1);
+    pthread_mutex_unlock(&rfb->clone_lock);
+}
+
+static void tc_ring_lockfree_get_counters(TCRingFrameBuffer *rfb,
+                                          int *im, int *fl, int *ex)
+{
+    *im = TC_ATOMIC_LOAD(&rfb->null) + TC_ATOMIC_LOAD(&rfb->empty);
+    *fl = TC_ATOMIC_LOAD(&rfb->wait) + TC_ATOMIC_LOAD(&rfb->locked);
+    *ex = TC_ATOMIC_LOAD(&rfb->ready);
+}
+
+static void tc_lockfree_interrupt(int import_only)
+{
+    TCRingFrameBuffer *rings[2] = { &tc_audio_ringbuffer, &tc_video_ringbuffer };
+    int i = 0;
+
+    for (i = 0; i < 2; i++) {
+        if (rings[i]->lockfree) {
+            tc_ring_unpark(&rings[i]->import_park);
+            if (!import_only) {
+                tc_ring_unpark(&rings[i]->filter_park);
+                tc_ring_unpark(&rings[i]->export_park);
+            }
+        }
+    }
+}
+
+void tc_framebuffer_set_lockfree(int lockfree)
+{
+#ifndef STATBUFFER
+    if (lockfree) {
+        tc_log_warn(__FILE__, "lock-free rings need static framebuffers,"
+                              " option ignored");
+    }
+    tc_lockfree_rings = TC_FALSE;
+#else
+    tc_lockfree_rings = lockfree;
+#endif
+}
+
 /* ------------------------------------------------------------------ */
 /* NEW API, yet private                                               */
 /* ------------------------------------------------------------------ */
@@ -338,8 +907,14 @@ static int tc_init_ring_framebuffer(TCRingFrameBuffer *rfb,
     rfb->locked = 0;
     rfb->ready  = 0;
 
+    rfb->lockfree = tc_lockfree_rings;
+    if (rfb->lockfree) {
+        tc_ring_lockfree_init(rfb);
+    }
+
     if (verbose >= TC_STATS) {
-        tc_log_info(__FILE__, "allocated %i frames in ringbuffer", size);
+        tc_log_info(__FILE__, "allocated %i frames in %sringbuffer",
+                    size, (rfb->lockfree) ?"lock-free " :"");
     }
     return 0;
 }
@@ -359,6 +934,10 @@ static void tc_fini_ring_framebuffer(TCRingFrameBuffer *rfb)
     if (rfb != NULL && rfb->free != NULL) {
         int i = 0, n = rfb->last;
     
+        if (rfb->lockfree) {
+            tc_ring_lockfree_fini(rfb);
+            rfb->lockfree = TC_FALSE;
+        }
         for (i = 0; i < rfb->last; i++) {
             rfb->free(rfb->frames[i]);
         }
@@ -611,6 +1190,12 @@ aframe_list_t *aframe_register(int id)
     int interrupted = TC_FALSE;
     TCFramePtr frame;
 
+    if (tc_audio_ringbuffer.lockfree) {
+        frame = tc_ring_lockfree_register(&tc_audio_ringbuffer, id,
+                                          tc_import_audio_running);
+        return frame.audio;
+    }
+
     pthread_mutex_lock(&aframe_list_lock);
 
     if (verbose >= TC_FLIST)
@@ -652,7 +1237,13 @@ vframe_list_t *vframe_register(int id)
 {
     int interrupted = TC_FALSE;
     TCFramePtr frame;
-    
+
+    if (tc_video_ringbuffer.lockfree) {
+        frame = tc_ring_lockfree_register(&tc_video_ringbuffer, id,
+                                          tc_import_video_running);
+        return frame.video;
+    }
+
     pthread_mutex_lock(&vframe_list_lock);
 
     if (verbose >= TC_FLIST)
@@ -703,6 +1294,8 @@ vframe_list_t *vframe_register(int id)
     if ((ptr)->next == NULL) { \
         /* must be last ptr in the list */ \
         (tail) = (ptr); \
+    } else { \
+        ((ptr)->next)->prev = (ptr); \
     } \
 } while (0)
 
@@ -717,6 +1310,16 @@ aframe_list_t *aframe_dup(aframe_list_t *f)
         return NULL;
     }
 
+    if (tc_audio_ringbuffer.lockfree) {
+        frame = tc_ring_lockfree_clone(&tc_audio_ringbuffer);
+        if (!TCFRAMEPTR_IS_NULL(frame)) {
+            aframe_copy(frame.audio, f, 1);
+            tc_ring_lockfree_link(&tc_audio_ringbuffer, frame.generic,
+                                  (frame_list_t *)f);
+        }
+        return frame.audio;
+    }
+
     pthread_mutex_lock(&aframe_list_lock);
 
     while (!interrupted && tc_audio_ringbuffer.null == 0) {
@@ -749,6 +1352,16 @@ vframe_list_t *vframe_dup(vframe_list_t *f)
         return NULL;
     }
 
+    if (tc_video_ringbuffer.lockfree) {
+        frame = tc_ring_lockfree_clone(&tc_video_ringbuffer);
+        if (!TCFRAMEPTR_IS_NULL(frame)) {
+            vframe_copy(frame.video, f, 1);
+            tc_ring_lockfree_link(&tc_video_ringbuffer, frame.generic,
+                                  (frame_list_t *)f);
+        }
+        return frame.video;
+    }
+
     pthread_mutex_lock(&vframe_list_lock);
 
     while (!interrupted && tc_video_ringbuffer.null == 0) {
@@ -798,6 +1411,11 @@ void aframe_remove(aframe_list_t *ptr)
         TCFramePtr frame;
         frame.audio = ptr;
 
+        if (tc_audio_ringbuffer.lockfree) {
+            tc_ring_lockfree_remove(&tc_audio_ringbuffer, frame.generic);
+            return;
+        }
+
         pthread_mutex_lock(&aframe_list_lock);
 
         LIST_FRAME_REMOVE(ptr, aframe_list_head, aframe_list_tail);
@@ -817,6 +1435,11 @@ void vframe_remove(vframe_list_t *ptr)
         TCFramePtr frame;
         frame.video = ptr;
 
+        if (tc_video_ringbuffer.lockfree) {
+            tc_ring_lockfree_remove(&tc_video_ringbuffer, frame.generic);
+            return;
+        }
+
         pthread_mutex_lock(&vframe_list_lock);
         
         LIST_FRAME_REMOVE(ptr, vframe_list_head, vframe_list_tail);
@@ -834,6 +1457,12 @@ void vframe_remove(vframe_list_t *ptr)
 static aframe_list_t *aframe_retrieve_nowait(void)
 {
     aframe_list_t *ptr = NULL;
+
+    if (tc_audio_ringbuffer.lockfree) {
+        return (aframe_list_t *)tc_ring_lockfree_retrieve(&tc_audio_ringbuffer,
+                                                            TC_FALSE);
+    }
+
     pthread_mutex_lock(&aframe_list_lock);
 
     if (verbose >= TC_CLEANUP) {
@@ -853,6 +1482,12 @@ static aframe_list_t *aframe_retrieve_nowait(void)
 static vframe_list_t *vframe_retrieve_nowait(void)
 {
     vframe_list_t *ptr = NULL;
+
+    if (tc_video_ringbuffer.lockfree) {
+        return (vframe_list_t *)tc_ring_lockfree_retrieve(&tc_video_ringbuffer,
+                                                            TC_FALSE);
+    }
+
     pthread_mutex_lock(&vframe_list_lock);
 
     if (verbose >= TC_CLEANUP) {
@@ -875,6 +1510,12 @@ aframe_list_t *aframe_retrieve(void)
 {
     int interrupted = TC_FALSE;
     aframe_list_t *ptr = NULL;
+
+    if (tc_audio_ringbuffer.lockfree) {
+        return (aframe_list_t *)tc_ring_lockfree_retrieve(&tc_audio_ringbuffer,
+                                                            TC_TRUE);
+    }
+
     pthread_mutex_lock(&aframe_list_lock);
 
     if (verbose >= TC_FLIST)
@@ -906,6 +1547,12 @@ vframe_list_t *vframe_retrieve(void)
 {
     int interrupted = TC_FALSE;
     vframe_list_t *ptr = NULL;
+
+    if (tc_video_ringbuffer.lockfree) {
+        return (vframe_list_t *)tc_ring_lockfree_retrieve(&tc_video_ringbuffer,
+                                                            TC_TRUE);
+    }
+
     pthread_mutex_lock(&vframe_list_lock);
 
     if (verbose >= TC_FLIST)
@@ -1040,6 +1687,10 @@ aframe_list_t *aframe_reserve(void)
     int interrupted = TC_FALSE;
     aframe_list_t *ptr = NULL;
 
+    if (tc_audio_ringbuffer.lockfree) {
+        return (aframe_list_t *)tc_ring_lockfree_reserve(&tc_audio_ringbuffer);
+    }
+
     pthread_mutex_lock(&aframe_list_lock);
 
     while (!interrupted && tc_audio_ringbuffer.wait == 0) {
@@ -1065,6 +1716,10 @@ vframe_list_t *vframe_reserve(void)
     int interrupted = TC_FALSE;
     vframe_list_t *ptr = NULL;
 
+    if (tc_video_ringbuffer.lockfree) {
+        return (vframe_list_t *)tc_ring_lockfree_reserve(&tc_video_ringbuffer);
+    }
+
     pthread_mutex_lock(&vframe_list_lock);
 
     while (!interrupted && tc_video_ringbuffer.wait == 0) {
@@ -1106,6 +1761,8 @@ void aframe_push_next(aframe_list_t *ptr, int status)
     if (ptr == NULL) {
         /* a bit more of paranoia */
         tc_log_warn(__FILE__, "aframe_push_next: given NULL frame pointer");
+    } else if (tc_audio_ringbuffer.lockfree) {
+        tc_ring_lockfree_push_next(&tc_audio_ringbuffer, (frame_list_t *)ptr, status);
     } else {
         pthread_mutex_lock(&aframe_list_lock);
         FRAME_SET_EXT_STATUS(&tc_audio_ringbuffer, ptr, status);
@@ -1128,6 +1785,8 @@ void vframe_push_next(vframe_list_t *ptr, int status)
     if (ptr == NULL) {
         /* a bit more of paranoia */
         tc_log_warn(__FILE__, "vframe_push_next: given NULL frame pointer");
+    } else if (tc_video_ringbuffer.lockfree) {
+        tc_ring_lockfree_push_next(&tc_video_ringbuffer, (frame_list_t *)ptr, status);
     } else {
         pthread_mutex_lock(&vframe_list_lock);
         FRAME_SET_EXT_STATUS(&tc_video_ringbuffer, ptr, status);
@@ -1165,6 +1824,13 @@ void vframe_dump_status(void)
 int vframe_have_more(void)
 {
     int ret;
+
+    if (tc_video_ringbuffer.lockfree) {
+        /* frames out of the pool are still in some processing stage */
+        ret = TC_ATOMIC_LOAD(&tc_video_ringbuffer.null);
+        return (ret < tc_video_ringbuffer.last) ?1 :0;
+    }
+
     pthread_mutex_lock(&vframe_list_lock);
     ret = (vframe_list_tail == NULL) ?0 :1;
     pthread_mutex_unlock(&vframe_list_lock);
@@ -1174,6 +1840,13 @@ int vframe_have_more(void)
 int aframe_have_more(void)
 {
     int ret;
+
+    if (tc_audio_ringbuffer.lockfree) {
+        /* frames out of the pool are still in some processing stage */
+        ret = TC_ATOMIC_LOAD(&tc_audio_ringbuffer.null);
+        return (ret < tc_audio_ringbuffer.last) ?1 :0;
+    }
+
     pthread_mutex_lock(&aframe_list_lock);
     ret = (aframe_list_tail == NULL) ?0 :1;
     pthread_mutex_unlock(&aframe_list_lock);
@@ -1235,6 +1908,11 @@ void vframe_copy(vframe_list_t *dst, const vframe_list_t *src,
 
 void vframe_get_counters(int *im, int *fl, int *ex)
 {
+    if (tc_video_ringbuffer.lockfree) {
+        tc_ring_lockfree_get_counters(&tc_video_ringbuffer, im, fl, ex);
+        return;
+    }
+
     pthread_mutex_lock(&vframe_list_lock);
     *im = tc_video_ringbuffer.null + tc_video_ringbuffer.empty;
     *fl = tc_video_ringbuffer.wait + tc_video_ringbuffer.locked;
@@ -1244,6 +1922,11 @@ void vframe_get_counters(int *im, int *fl, int *ex)
 
 void aframe_get_counters(int *im, int *fl, int *ex)
 {
+    if (tc_audio_ringbuffer.lockfree) {
+        tc_ring_lockfree_get_counters(&tc_audio_ringbuffer, im, fl, ex);
+        return;
+    }
+
     pthread_mutex_lock(&aframe_list_lock);
     *im = tc_audio_ringbuffer.null + tc_audio_ringbuffer.empty;
     *fl = tc_audio_ringbuffer.wait + tc_audio_ringbuffer.locked;
@@ -137,6 +137,10 @@ const TCFrameSpecs *tc_framebuffer_get_specs(void);
  *     will use those parameters.
  *     PLEASE ALSO NOTE that is HIGHLY unsafe to mix allocation by changing
  *     TCFrameSpecs in between without freeing ringbuffers. Just DO NOT.
+ *     Video buffers are sized after width and height, which must be the
+ *     largest ones used anywhere through the processing chain; format is
+ *     ignored, since buffers are always large enough for RGB.
+ *     A zero width or height means the largest supported size.
  *
  * Parameters:
  *     Constant pointer to a TCFrameSpecs holding new framebuffer parameters.
@@ -145,6 +149,23 @@ const TCFrameSpecs *tc_framebuffer_get_specs(void);
  */
 void tc_framebuffer_set_specs(const TCFrameSpecs *specs);
 
+/*
+ * tc_framebuffer_set_lockfree: (NOT thread safe)
+ *     Select the ringbuffer implementation used by next {v,a}frame_alloc
+ *     calls. Lock-free rings hand frames from stage to stage through
+ *     atomic per-stage cursors, and threads sleep only when their stage
+ *     has nothing to do; the default rings serialize every operation on
+ *     a single mutex. Both flavours expose the same API and report the
+ *     same counters. Lock-free rings require static framebuffers
+ *     (STATBUFFER), the request is ignored otherwise.
+ *
+ * Parameters:
+ *     lockfree: boolean flag. If !0, use lock-free rings.
+ * Return Value:
+ *     None.
+ */
+void tc_framebuffer_set_lockfree(int lockfree);
+
 /*
  * tc_framebuffer_interrupt: (thread safe)
  *     Interrupt the framebuffer immediately (see below for specific meaning
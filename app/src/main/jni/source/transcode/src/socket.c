@@ -10,6 +10,7 @@
 #include "transcode.h"
 #include "encoder.h"
 #include "filter.h"
+#include "frame_profile.h"
 #include "socket.h"
 #include "libtc/libtc.h"
 
@@ -392,6 +393,8 @@ static int handle_help(char *params)
             "progress\n"
             "pause\n"
             "preview <command>\n"
+            "profile [ on | off | reset | stages |\n"
+            "          hist <stage> | queues [N] | frames [N] ]\n"
             "  [ draw | undo | pause | fastfw |\n"
             "    slowfw | slowbw | rotate |\n"
             "    rotate | display | slower |\n"
@@ -559,6 +562,41 @@ static int handle_preview(char *params)
 
 /*************************************************************************/
 
+/**
+ * send_line():  Output callback for tc_profile_report().
+ */
+
+static void send_line(void *data, const char *line)
+{
+    sendstr(*(int *)data, line);
+}
+
+/**
+ * handle_profile():  Process a "profile" command received on the socket.
+ *
+ * Parameters:
+ *     params: Command parameters.
+ * Return value:
+ *     Nonzero on success, zero on failure.
+ */
+
+static int handle_profile(char *params)
+{
+    if (strncasecmp(params, "on", 2) == 0) {
+        tc_profile_enable(TC_TRUE);
+        return 1;
+    } else if (strncasecmp(params, "off", 2) == 0) {
+        tc_profile_enable(TC_FALSE);
+        return 1;
+    } else if (strncasecmp(params, "reset", 2) == 0) {
+        tc_profile_reset();
+        return 1;
+    }
+    return tc_profile_report(params, send_line, &client_sock) == TC_OK;
+}
+
+/*************************************************************************/
+
 /**
  * handle:  Handle a single message from a socket.
  *
@@ -609,6 +647,8 @@ static int handle(char *buf)
         retval = 1;
     } else if (strncasecmp(cmd, "preview", 3) == 0) {
         retval = handle_preview(params);
+    } else if (strncasecmp(cmd, "profile", 4) == 0) {
+        retval = handle_profile(params);
     } else if (strncasecmp(cmd, "progress", 3) == 0) {
         tc_progress_meter = !tc_progress_meter;
         retval = 1;
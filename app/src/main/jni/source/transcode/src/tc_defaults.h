@@ -48,9 +48,11 @@
 #define NTSC_W                  720
 #define NTSC_H                  480
 
-//new max frame size:
-#define TC_MAX_V_FRAME_WIDTH     2500
-#define TC_MAX_V_FRAME_HEIGHT    2000
+//new max frame size (4K and DCI 4K fit): the core framebuffers are sized
+//after the real stream, this is the sanity limit for the geometry options
+//and the size of the modules' private buffers
+#define TC_MAX_V_FRAME_WIDTH     4096
+#define TC_MAX_V_FRAME_HEIGHT    4096
 
 // max bytes per pixel
 #define TC_MAX_V_BYTESPP        4
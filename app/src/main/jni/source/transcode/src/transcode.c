@@ -27,6 +27,7 @@
 #include "dl_loader.h"
 #include "framebuffer.h"
 #include "counter.h"
+#include "frame_profile.h"
 #include "frame_threads.h"
 #include "filter.h"
 #include "probe.h"
@@ -71,6 +72,9 @@ int fast_resize = TC_FALSE;
 
 // global information structure
 static vob_t *vob = NULL;
+// largest frame geometry seen along the processing chain
+static int chain_v_width  = 0;
+static int chain_v_height = 0;
 int verbose = TC_INFO;
 
 //-------------------------------------------------------------
@@ -89,6 +93,7 @@ int tc_niceness          = 0;
 
 int max_frame_buffer = TC_FRAME_BUFFER;
 int max_frame_threads = TC_FRAME_THREADS;
+int tc_slice_threads = 1;
 
 //-------------------------------------------------------------
 
@@ -1234,6 +1239,12 @@ static void teardown_input_sources(vob_t *vob)
 
 /* support macros */
 
+/* remember the largest intermediate frame (needed to size the buffers) */
+#define CHAIN_SIZE_MARK() do { \
+    chain_v_width  = TC_MAX(chain_v_width,  vob->ex_v_width); \
+    chain_v_height = TC_MAX(chain_v_height, vob->ex_v_height); \
+} while (0)
+
 #define CLIP_CHECK(MODE, NAME, OPTION) do { \
     /* force to even for YUV mode */ \
     if (vob->im_v_codec == CODEC_YUV || vob->im_v_codec == CODEC_YUV422) { \
@@ -1265,6 +1276,7 @@ static void teardown_input_sources(vob_t *vob)
     \
     vob->ex_v_height -= (vob->MODE ## _top + vob->MODE ## _bottom); \
     vob->ex_v_width  -= (vob->MODE ## _left + vob->MODE ## _right); \
+    CHAIN_SIZE_MARK(); /* negative clipping enlarges the frame */ \
 } while (0)
 
 
@@ -1596,6 +1608,7 @@ int main(int argc, char *argv[])
     // init frame size with cmd line frame size
     vob->ex_v_height = vob->im_v_height;
     vob->ex_v_width  = vob->im_v_width;
+    CHAIN_SIZE_MARK();
 
     // import bytes per frame (RGB 24bits)
     vob->im_v_size   = vob->im_v_height * vob->im_v_width * BPP/8;
@@ -1968,6 +1981,7 @@ int main(int argc, char *argv[])
 
         vob->ex_v_height += (vob->vert_resize2 * vob->resize2_mult);
         vob->ex_v_width += (vob->hori_resize2 * vob->resize2_mult);
+        CHAIN_SIZE_MARK();
 
         //check2:
 
@@ -2034,6 +2048,7 @@ int main(int argc, char *argv[])
 
         vob->ex_v_width  = vob->zoom_width;
         vob->ex_v_height = vob->zoom_height;
+        CHAIN_SIZE_MARK();
 
         if (verbose & TC_INFO && vob->ex_v_height > 0)
             tc_log_info(PACKAGE,
@@ -2676,8 +2691,13 @@ int main(int argc, char *argv[])
     } else {
         specs.frc = vob->ex_frc;
     }
-    specs.width = TC_MAX(vob->im_v_width, vob->ex_v_width);
-    specs.height = TC_MAX(vob->im_v_height, vob->ex_v_height);
+    /*
+     * frames are processed in place, so buffers must fit the largest
+     * geometry anywhere in the chain (-j/-X/-B/-Z/-Y...), not just the
+     * import or export one.
+     */
+    specs.width = TC_MAX(chain_v_width, TC_MAX(vob->im_v_width, vob->ex_v_width));
+    specs.height = TC_MAX(chain_v_height, TC_MAX(vob->im_v_height, vob->ex_v_height));
     specs.format = vob->im_v_codec;
 
     /* XXX: explain me up */
@@ -2711,6 +2731,10 @@ int main(int argc, char *argv[])
                    max_frame_buffer);
 #endif
 
+    // set up profiling before the filters register their stages
+    if (tc_profile_init(profile_file) != TC_OK)
+        tc_error("failed to initialize profiling");
+
     // load import/export modules and filters plugins
     if (transcode_init(vob, tc_get_ringbuffer(max_frame_threads, max_frame_threads)) < 0)
         tc_error("plug-in initialization failed");
@@ -2797,6 +2821,10 @@ int main(int argc, char *argv[])
 
     SHUTDOWN_MARK("internal threads");
 
+    // write the profile report, if requested
+    tc_profile_fini();
+    SHUTDOWN_MARK("profiling");
+
     // shut down control socket, if active
     tc_socket_fini();
     SHUTDOWN_MARK("control socket");
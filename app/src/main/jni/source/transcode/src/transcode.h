@@ -88,6 +88,14 @@ typedef enum {
  *
  * ----------------------------*/
 
+/*
+ * For TC_IMPORT_DECODE, `buffer' is the frame buffer itself, lent to the
+ * import module: `size' is the number of bytes expected on entry and the
+ * number delivered on return.  Modules should read or decode straight
+ * into it instead of staging data in a buffer of their own.  If a module
+ * returns a stream in `fd' from TC_IMPORT_OPEN instead, the core reads
+ * frames from it directly into the frame buffers.
+ */
 typedef struct _transfer_t {
     int flag;
     FILE *fd;
@@ -424,6 +432,7 @@ extern int tc_niceness;
 
 extern int max_frame_buffer;
 extern int max_frame_threads;
+extern int tc_slice_threads;
 
 // Various constants
 
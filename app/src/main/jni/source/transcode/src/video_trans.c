@@ -9,8 +9,11 @@
  * for details.
  */
 
+#include <pthread.h>
+
 #include "transcode.h"
 #include "framebuffer.h"
+#include "frame_profile.h"
 #include "video_trans.h"
 #include "libtcvideo/tcvideo.h"
 
@@ -51,13 +54,80 @@ typedef struct {
     swap_buffers(vtd);                                          \
 } while (0)
 
-/* Handle for calling tcvideo functions. */
-static TCVHandle handle = 0;
+/* Plan for the geometric transformations of a frame.  Clipping (-j, -Y),
+ * zooming (-Z), flipping (-z, -l) and, for YUV, U/V swapping and
+ * decoloring (-k, -K) can all be done by a single tcv_zoom_rect() call
+ * per plane, instead of one pass over the frame for each of them; the
+ * plan says whether that is possible for the current settings and frame
+ * format, and with which parameters.  It is worked out once, when the
+ * first frame of a given format is seen. */
+typedef struct {
+    int in_w, in_h, codec;   // frame format the plan was made for
+    int fused;               // nonzero if the fused path can be used
+    int src_x, src_y;        // -j: source rectangle
+    int src_w, src_h;
+    int zoom_w, zoom_h;      // -Z: size to zoom the source rectangle to
+    int out_x, out_y;        // -Y: part of the zoomed image to keep
+    int out_w, out_h;
+    int flags;               // TCV_ZOOM_RECT_* for -z/-l (0 if not fused)
+    int flip_done;           // nonzero if -z/-l are part of the plan
+    int swap_uv, gray_uv;    // nonzero if -k/-K are part of the plan
+} video_trans_plan_t;
+
+static video_trans_plan_t plan;
+static int plan_valid = 0;
+static pthread_mutex_t plan_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/* Handles for calling tcvideo functions.  A handle carries scratch
+ * buffers and lookup tables, so each frame thread gets its own. */
+static pthread_key_t handle_key;
+static pthread_once_t handle_once = PTHREAD_ONCE_INIT;
 
 /*************************************************************************/
 /*************************** Internal routines ***************************/
 /*************************************************************************/
 
+static void free_handle(void *handle)
+{
+    tcv_free(handle);
+}
+
+static void create_handle_key(void)
+{
+    pthread_key_create(&handle_key, free_handle);
+}
+
+/**
+ * get_handle:  Return the tcvideo handle of the calling thread, allocating
+ * it (with tc_slice_threads slice threads) if necessary.
+ *
+ * Parameters:
+ *     None.
+ * Return value:
+ *     The handle, or 0 on failure.
+ */
+
+static TCVHandle get_handle(void)
+{
+    TCVHandle handle;
+
+    pthread_once(&handle_once, create_handle_key);
+    handle = pthread_getspecific(handle_key);
+    if (!handle) {
+        handle = tcv_init();
+        if (!handle) {
+            tc_log_error(PACKAGE, "video_trans.c: tcv_init() failed!");
+            return 0;
+        }
+        pthread_setspecific(handle_key, handle);
+        if (tc_slice_threads > 1)
+            tcv_set_threads(handle, tc_slice_threads);
+    }
+    return handle;
+}
+
+/*************************************************************************/
+
 /**
  * set_vtd:  Initialize the given vtd structure from the given
  * vframe_list_t, and update ptr->video_size.
@@ -175,6 +245,187 @@ static void swap_buffers(video_trans_data_t *vtd)
     set_vtd(vtd, vtd->ptr);
 }
 
+/*************************************************************************/
+
+/**
+ * make_plan:  Work out how the geometric transformations requested by the
+ * user can be combined for a frame of the given format (see
+ * video_trans_plan_t).  The fused path is only used when it gives the
+ * same result as doing the transformations one by one: clip values must
+ * not be negative (padding is left to tcv_clip()) and must be multiples
+ * of the chroma subsampling, and nothing that has to be done in the middle
+ * (deinterlacing, -X/-B resizing, interlaced zoom) may be enabled.
+ *
+ * Parameters:
+ *      vob: Global data pointer.
+ *      vtd: Video frame data for a frame of the format concerned.
+ *     plan: Plan to fill in.
+ * Return value:
+ *     None.
+ */
+
+static void make_plan(const vob_t *vob, const video_trans_data_t *vtd,
+                      video_trans_plan_t *plan)
+{
+    const int wdiv = vtd->width_div[vtd->nplanes-1];
+    const int hdiv = vtd->height_div[vtd->nplanes-1];
+    int im_l = 0, im_r = 0, im_t = 0, im_b = 0;
+    int ex_l = 0, ex_r = 0, ex_t = 0, ex_b = 0;
+
+    memset(plan, 0, sizeof(*plan));
+    plan->in_w  = vtd->ptr->v_width;
+    plan->in_h  = vtd->ptr->v_height;
+    plan->codec = vtd->ptr->v_codec;
+
+    if (vob->deinterlace > 0 || resize1 || resize2
+     || (zoom && vob->zoom_interlaced)
+     || !(im_clip || zoom || ex_clip || (!rescale && (flip || mirror)))
+    ) {
+        return;
+    }
+    if (im_clip) {
+        im_l = vob->im_clip_left;
+        im_r = vob->im_clip_right;
+        im_t = vob->im_clip_top;
+        im_b = vob->im_clip_bottom;
+    }
+    if (ex_clip) {
+        ex_l = vob->ex_clip_left;
+        ex_r = vob->ex_clip_right;
+        ex_t = vob->ex_clip_top;
+        ex_b = vob->ex_clip_bottom;
+    }
+    if (im_l < 0 || im_r < 0 || im_t < 0 || im_b < 0
+     || ex_l < 0 || ex_r < 0 || ex_t < 0 || ex_b < 0
+     || im_l % wdiv || im_r % wdiv || im_t % hdiv || im_b % hdiv
+     || ex_l % wdiv || ex_r % wdiv || ex_t % hdiv || ex_b % hdiv
+    ) {
+        return;
+    }
+
+    plan->src_x  = im_l;
+    plan->src_y  = im_t;
+    plan->src_w  = plan->in_w - im_l - im_r;
+    plan->src_h  = plan->in_h - im_t - im_b;
+    plan->zoom_w = zoom ? vob->zoom_width  : plan->src_w;
+    plan->zoom_h = zoom ? vob->zoom_height : plan->src_h;
+    plan->out_x  = ex_l;
+    plan->out_y  = ex_t;
+    plan->out_w  = plan->zoom_w - ex_l - ex_r;
+    plan->out_h  = plan->zoom_h - ex_t - ex_b;
+    if (plan->src_w <= 0 || plan->src_h <= 0
+     || plan->out_w <= 0 || plan->out_h <= 0
+    ) {
+        return;
+    }
+    /* -r comes between -Y and -z/-l, and does not commute with flipping;
+     * U/V swapping and decoloring commute with everything */
+    if (!rescale) {
+        plan->flip_done = 1;
+        if (flip)
+            plan->flags |= TCV_ZOOM_RECT_FLIP_V;
+        if (mirror)
+            plan->flags |= TCV_ZOOM_RECT_FLIP_H;
+    }
+    if (vtd->nplanes == 3) {
+        plan->swap_uv = rgbswap;
+        plan->gray_uv = decolor;
+    }
+    plan->fused = 1;
+}
+
+/*************************************************************************/
+
+/**
+ * get_plan:  Return (in *plan_ret) the plan for frames of the format of the
+ * given one, making it if necessary.
+ *
+ * Parameters:
+ *          vob: Global data pointer.
+ *          vtd: Video frame data.
+ *     plan_ret: Where to store the plan.
+ * Return value:
+ *     None.
+ */
+
+static void get_plan(const vob_t *vob, const video_trans_data_t *vtd,
+                     video_trans_plan_t *plan_ret)
+{
+    pthread_mutex_lock(&plan_lock);
+    if (!plan_valid
+     || plan.in_w != vtd->ptr->v_width
+     || plan.in_h != vtd->ptr->v_height
+     || plan.codec != vtd->ptr->v_codec
+    ) {
+        make_plan(vob, vtd, &plan);
+        plan_valid = 1;
+        if (verbose & TC_DEBUG) {
+            if (plan.fused) {
+                tc_log_info(__FILE__, "fused frame transformation:"
+                            " %dx%d+%d+%d of %dx%d -> %dx%d,"
+                            " keep %dx%d+%d+%d, flags %d",
+                            plan.src_w, plan.src_h, plan.src_x, plan.src_y,
+                            plan.in_w, plan.in_h, plan.zoom_w, plan.zoom_h,
+                            plan.out_w, plan.out_h, plan.out_x, plan.out_y,
+                            plan.flags);
+            } else {
+                tc_log_info(__FILE__, "frame transformations done"
+                            " one at a time");
+            }
+        }
+    }
+    *plan_ret = plan;
+    pthread_mutex_unlock(&plan_lock);
+}
+
+/*************************************************************************/
+
+/**
+ * do_fused_transform:  Perform the transformations described by a plan on
+ * a frame, one tcv_zoom_rect() call per plane.
+ *
+ * Parameters:
+ *     handle: tcvideo handle.
+ *        vob: Global data pointer.
+ *        vtd: Video frame data.
+ *       plan: Plan for the frame.
+ * Return value:
+ *     0 on success, -1 on failure.
+ */
+
+static int do_fused_transform(TCVHandle handle, const vob_t *vob,
+                              video_trans_data_t *vtd,
+                              const video_trans_plan_t *plan)
+{
+    int i;
+
+    preadjust_frame_size(vtd, plan->out_w, plan->out_h);
+    for (i = 0; i < vtd->nplanes; i++) {
+        int wdiv = vtd->width_div[i], hdiv = vtd->height_div[i];
+        int stride = (vtd->ptr->v_width / wdiv) * vtd->Bpp;
+        int out_w = plan->out_w / wdiv, out_h = plan->out_h / hdiv;
+        uint8_t *dest = vtd->tmpplanes[(plan->swap_uv && i > 0) ? 3-i : i];
+
+        if (plan->gray_uv && i > 0) {
+            memset(dest, 128, out_w * out_h * vtd->Bpp);
+            continue;
+        }
+        if (!tcv_zoom_rect(handle, vtd->planes[i]
+                                   + (plan->src_y / hdiv) * stride
+                                   + (plan->src_x / wdiv) * vtd->Bpp,
+                           stride, plan->src_w / wdiv, plan->src_h / hdiv,
+                           dest, out_w * vtd->Bpp, vtd->Bpp,
+                           plan->zoom_w / wdiv, plan->zoom_h / hdiv,
+                           plan->out_x / wdiv, plan->out_y / hdiv,
+                           out_w, out_h, plan->flags, vob->zoom_filter)
+        ) {
+            return -1;
+        }
+    }
+    swap_buffers(vtd);
+    return 0;
+}
+
 /*************************************************************************/
 /*************************************************************************/
 
@@ -192,7 +443,12 @@ static void swap_buffers(video_trans_data_t *vtd)
 static int do_process_frame(vob_t *vob, vframe_list_t *ptr)
 {
     video_trans_data_t vtd;  /* for passing to subroutines */
+    video_trans_plan_t fplan;
+    int fused;
+    TCVHandle handle = get_handle();
 
+    if (!handle)
+        return -1;
 
     /**** Sanity check and initialization ****/
 
@@ -210,10 +466,21 @@ static int do_process_frame(vob_t *vob, vframe_list_t *ptr)
         ptr->free = !ptr->free;
     }
     set_vtd(&vtd, ptr);
+    get_plan(vob, &vtd, &fplan);
+    fused = fplan.fused
+         && !((ptr->attributes & TC_FRAME_IS_INTERLACED)
+              && ptr->deinter_flag > 0);
+
+    /**** -j -Z -Y (-z -l -k -K): all at once if possible ****/
+
+    if (fused) {
+        if (do_fused_transform(handle, vob, &vtd, &fplan) < 0)
+            return -1;
+    }
 
     /**** -j: clip frame (import) ****/
 
-    if (im_clip) {
+    if (im_clip && !fused) {
         preadjust_frame_size(&vtd,
                 ptr->v_width - vob->im_clip_left - vob->im_clip_right,
                 ptr->v_height - vob->im_clip_top - vob->im_clip_bottom);
@@ -227,8 +494,10 @@ static int do_process_frame(vob_t *vob, vframe_list_t *ptr)
 
     /**** -I: deinterlace video frame ****/
 
-    if (vob->deinterlace > 0
-     || ((ptr->attributes & TC_FRAME_IS_INTERLACED) && ptr->deinter_flag > 0)
+    if (!fused
+     && (vob->deinterlace > 0
+         || ((ptr->attributes & TC_FRAME_IS_INTERLACED)
+             && ptr->deinter_flag > 0))
     ) {
         int mode = (vob->deinterlace>0 ? vob->deinterlace : ptr->deinter_flag);
         if (mode == 1) {
@@ -279,7 +548,7 @@ static int do_process_frame(vob_t *vob, vframe_list_t *ptr)
     /**** -X: fast resize (up) ****/
     /**** -B: fast resize (down) ****/
 
-    if (resize1 || resize2) {
+    if ((resize1 || resize2) && !fused) {
         int width = ptr->v_width, height = ptr->v_height;
         int resize_w = vob->hori_resize2 - vob->hori_resize1;
         int resize_h = vob->vert_resize2 - vob->vert_resize1;
@@ -298,7 +567,7 @@ static int do_process_frame(vob_t *vob, vframe_list_t *ptr)
 
     /**** -Z: zoom frame (slow resize) ****/
 
-    if (zoom) {
+    if (zoom && !fused) {
         preadjust_frame_size(&vtd, vob->zoom_width, vob->zoom_height);
         if (vob->zoom_interlaced) {
             /* In YUV mode, only handle the first place as interlaced;
@@ -325,7 +594,7 @@ static int do_process_frame(vob_t *vob, vframe_list_t *ptr)
 
     /**** -Y: clip frame (export) ****/
 
-    if (ex_clip) {
+    if (ex_clip && !fused) {
         preadjust_frame_size(&vtd,
                 ptr->v_width - vob->ex_clip_left-vob->ex_clip_right,
                 ptr->v_height - vob->ex_clip_top - vob->ex_clip_bottom);
@@ -347,19 +616,19 @@ static int do_process_frame(vob_t *vob, vframe_list_t *ptr)
 
     /**** -z: flip frame vertically ****/
 
-    if (flip) {
+    if (flip && !(fused && fplan.flip_done)) {
         PROCESS_FRAME(tcv_flip_v, &vtd);
     }
 
     /**** -l: flip flame horizontally (mirror) ****/
 
-    if (mirror) {
+    if (mirror && !(fused && fplan.flip_done)) {
         PROCESS_FRAME(tcv_flip_h, &vtd);
     }
 
     /**** -k: red/blue swap ****/
 
-    if (rgbswap) {
+    if (rgbswap && !(fused && fplan.swap_uv)) {
         if (ptr->v_codec == CODEC_RGB) {
             int i;
             for (i = 0; i < ptr->v_width * ptr->v_height; i++) {
@@ -378,7 +647,7 @@ static int do_process_frame(vob_t *vob, vframe_list_t *ptr)
 
     /**** -K: grayscale ****/
 
-    if (decolor) {
+    if (decolor && !(fused && fplan.gray_uv)) {
         if (ptr->v_codec == CODEC_RGB) {
             /* Convert to 8-bit grayscale, then back to RGB24.  Just
              * averaging the values won't give us the right intensity. */
@@ -458,8 +727,14 @@ int process_vid_frame(vob_t *vob, vframe_list_t *ptr)
      || vob->im_v_codec == CODEC_YUV
      || vob->im_v_codec == CODEC_YUV422
     ) {
+        TCProfMark mark;
+        int ret;
+
         ptr->v_codec = vob->im_v_codec;
-        return do_process_frame(vob, ptr);
+        tc_profile_begin(&mark);
+        ret = do_process_frame(vob, ptr);
+        tc_profile_end(&mark, TC_PROF_PROCESS_VIDEO, ptr->id);
+        return ret;
     }
 
     /* Invalid colorspace, bail out */
@@ -482,18 +757,16 @@ int process_vid_frame(vob_t *vob, vframe_list_t *ptr)
 
 int preprocess_vid_frame(vob_t *vob, vframe_list_t *ptr)
 {
+    TCVHandle handle;
+
     /* Check parameter validity */
     if (!vob || !ptr)
         return -1;
 
     /* Allocate tcvideo handle if necessary */
-    if (!handle) {
-        handle = tcv_init();
-        if (!handle) {
-            tc_log_error(PACKAGE, "video_trans.c: tcv_init() failed!");
-            return -1;
-        }
-    }
+    handle = get_handle();
+    if (!handle)
+        return -1;
 
     /* Check for pass-through mode */
     if (vob->pass_flag & TC_VIDEO)
@@ -569,6 +842,9 @@ int postprocess_vid_frame(vob_t *vob, vframe_list_t *ptr)
     /* Perform final clipping, if this isn't a cloned frame */
     if (post_ex_clip && !(ptr->attributes & TC_FRAME_WAS_CLONED)) {
         video_trans_data_t vtd;
+        TCVHandle handle = get_handle();
+        if (!handle)
+            return -1;
         ptr->v_codec = vob->im_v_codec;
         set_vtd(&vtd, ptr);
         preadjust_frame_size(&vtd,
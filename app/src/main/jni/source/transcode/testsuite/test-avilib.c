@@ -0,0 +1,648 @@
+/*
+ * test-avilib.c -- testsuite for avilib read paths.
+ *                  everyone feel free to add more tests and improve
+ *                  existing ones.
+ *
+ * This file is part of transcode, a video stream processing tool.
+ *
+ * transcode is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * transcode is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <pthread.h>
+
+#include "config.h"
+#include "libtc/libtc.h"
+#include "avilib/avilib.h"
+#include "avilib/platform.h"
+
+#define TEST_FRAMES     64
+#define TEST_MAX_SIZE   (64 * 1024)
+#define TEST_AUDIO_SIZE 1764
+#define TEST_BATCH      13
+
+static char test_file[] = "/tmp/test-avilib-XXXXXX";
+
+/* frames have different sizes and recognizable content */
+static long frame_size(int n)
+{
+    return 1 + (n * 7919) % TEST_MAX_SIZE;
+}
+
+static void fill_frame(char *buf, int n)
+{
+    long i, size = frame_size(n);
+
+    for (i = 0; i < size; i++) {
+        buf[i] = (char)(n + i);
+    }
+}
+
+/* writes the test stream, through the write-behind buffers if asked to */
+static int write_avi(const char *name, long wb_size)
+{
+    static char vbuf[TEST_MAX_SIZE], abuf[TEST_AUDIO_SIZE];
+    avi_t *avi = NULL;
+    int n;
+
+    avi = AVI_open_output_file(name);
+    if (avi == NULL) {
+        tc_warn("AVI_open_output_file: %s", AVI_strerror());
+        return 0;
+    }
+    AVI_set_video(avi, 320, 240, 25.0, "TEST");
+    AVI_set_audio(avi, 2, 44100, 16, WAVE_FORMAT_PCM, 0);
+    if (wb_size > 0
+     && (AVI_enable_write_behind(avi, wb_size, 3) < 0
+      || AVI_reserve_index(avi, TEST_FRAMES) < 0)
+    ) {
+        tc_warn("can't set up write-behind: %s", AVI_strerror());
+        AVI_close(avi);
+        return 0;
+    }
+
+    for (n = 0; n < TEST_FRAMES; n++) {
+        fill_frame(vbuf, n);
+        memset(abuf, n, sizeof(abuf));
+        if (AVI_write_frame(avi, vbuf, frame_size(n), (n % 8) == 0) < 0
+         || AVI_write_audio(avi, abuf, sizeof(abuf)) < 0
+        ) {
+            tc_warn("write of frame %i failed: %s", n, AVI_strerror());
+            AVI_close(avi);
+            return 0;
+        }
+    }
+    return (AVI_close(avi) == 0);
+}
+
+static int write_test_file(void)
+{
+    int fd = mkstemp(test_file);
+
+    if (fd < 0) {
+        tc_warn("can't create temporary file");
+        return 0;
+    }
+    close(fd);
+    return write_avi(test_file, 0);
+}
+
+static char *read_file(const char *name, long *len)
+{
+    char *buf = NULL;
+    FILE *f = fopen(name, "rb");
+
+    if (f == NULL) {
+        return NULL;
+    }
+    fseek(f, 0, SEEK_END);
+    *len = ftell(f);
+    rewind(f);
+    buf = tc_malloc(*len + 1);
+    if (buf != NULL && fread(buf, 1, *len, f) != (size_t)*len) {
+        tc_free(buf);
+        buf = NULL;
+    }
+    fclose(f);
+    return buf;
+}
+
+static int check_frame(const char *data, long len, int key, int n)
+{
+    static char ref[TEST_MAX_SIZE];
+
+    fill_frame(ref, n);
+    if (len != frame_size(n)) {
+        tc_warn("frame %i: size %li, expected %li", n, len, frame_size(n));
+        return 0;
+    }
+    if (memcmp(data, ref, len) != 0) {
+        tc_warn("frame %i: content mismatch", n);
+        return 0;
+    }
+    if ((key != 0) != ((n % 8) == 0)) {
+        tc_warn("frame %i: wrong keyframe flag", n);
+        return 0;
+    }
+    return 1;
+}
+
+/* sequential AVI_read_frame must give the same data with and w/o mmap */
+static int test_read_frames(int use_mmap)
+{
+    static char buf[TEST_MAX_SIZE];
+    avi_t *avi = NULL;
+    int n, key, ret = 1;
+    long len;
+
+    avi = (use_mmap) ?AVI_open_input_file_mmap(test_file, 1)
+                     :AVI_open_input_file(test_file, 1);
+    if (avi == NULL) {
+        tc_warn("open failed: %s", AVI_strerror());
+        return 0;
+    }
+    for (n = 0; n < TEST_FRAMES && ret; n++) {
+        len = AVI_read_frame(avi, buf, &key);
+        ret = check_frame(buf, len, key, n);
+    }
+    if (AVI_read_frame(avi, buf, &key) != -1) {
+        tc_warn("read past the last frame succeeded");
+        ret = 0;
+    }
+    AVI_close(avi);
+
+    tc_info("testing sequential read (mmap=%s) -> %s",
+            (use_mmap) ?"yes" :"no", (ret) ?"OK" :"FAILED");
+    return ret;
+}
+
+/* AVI_peek_frame in random order, not touching the read position */
+static int test_peek_frames(int use_mmap)
+{
+    static char buf[TEST_MAX_SIZE];
+    const char *data = NULL;
+    avi_t *avi = NULL;
+    int i, n, key, ret = 1;
+    long len;
+
+    avi = (use_mmap) ?AVI_open_input_file_mmap(test_file, 1)
+                     :AVI_open_input_file(test_file, 1);
+    if (avi == NULL) {
+        tc_warn("open failed: %s", AVI_strerror());
+        return 0;
+    }
+    for (i = 0; i < TEST_FRAMES && ret; i++) {
+        n = (i * 37) % TEST_FRAMES;
+        if (AVI_peek_frame(avi, n, &data, &len, &key) < 0) {
+            tc_warn("peek of frame %i failed: %s", n, AVI_strerror());
+            ret = 0;
+        } else {
+            ret = check_frame(data, len, key, n);
+        }
+    }
+    if (ret && AVI_peek_frame(avi, TEST_FRAMES, &data, &len, &key) == 0) {
+        tc_warn("peek past the last frame succeeded");
+        ret = 0;
+    }
+    if (ret) {
+        len = AVI_read_frame(avi, buf, &key);
+        ret = check_frame(buf, len, key, 0);
+    }
+    AVI_close(avi);
+
+    tc_info("testing peek (mmap=%s) -> %s",
+            (use_mmap) ?"yes" :"no", (ret) ?"OK" :"FAILED");
+    return ret;
+}
+
+/* AVI_read_frames in odd sized batches, running over the end */
+static int test_batch_read(int use_mmap)
+{
+    static char bufs[TEST_BATCH][TEST_MAX_SIZE];
+    char *vidbufs[TEST_BATCH];
+    long sizes[TEST_BATCH];
+    int keys[TEST_BATCH];
+    avi_t *avi = NULL;
+    long first, got;
+    int i, ret = 1;
+
+    avi = (use_mmap) ?AVI_open_input_file_mmap(test_file, 1)
+                     :AVI_open_input_file(test_file, 1);
+    if (avi == NULL) {
+        tc_warn("open failed: %s", AVI_strerror());
+        return 0;
+    }
+    for (first = 0; first < TEST_FRAMES && ret; first += got) {
+        for (i = 0; i < TEST_BATCH; i++) {
+            vidbufs[i] = bufs[i];
+            sizes[i]   = TEST_MAX_SIZE;
+        }
+        vidbufs[1] = NULL; /* length only */
+        got = AVI_read_frames(avi, first, TEST_BATCH, vidbufs, sizes, keys);
+        if (got <= 0 || got > TEST_BATCH
+         || (got < TEST_BATCH && first + got != TEST_FRAMES)
+        ) {
+            tc_warn("batch at %li: got %li frames", first, got);
+            ret = 0;
+            break;
+        }
+        for (i = 0; i < got && ret; i++) {
+            if (vidbufs[i] == NULL) {
+                ret = (sizes[i] == frame_size(first + i));
+            } else {
+                ret = check_frame(vidbufs[i], sizes[i], keys[i], first + i);
+            }
+        }
+    }
+    if (ret && AVI_read_frames(avi, TEST_FRAMES, 1, vidbufs, sizes, keys) != 0) {
+        tc_warn("batch past the last frame returned frames");
+        ret = 0;
+    }
+    if (ret) {
+        long len = AVI_read_frame(avi, bufs[0], &i);
+        ret = check_frame(bufs[0], len, i, 0);
+    }
+    AVI_close(avi);
+
+    tc_info("testing batch read (mmap=%s) -> %s",
+            (use_mmap) ?"yes" :"no", (ret) ?"OK" :"FAILED");
+    return ret;
+}
+
+/* wait for the read-ahead to deliver the frame at the current position */
+static long try_read_frame(avi_t *avi, char *buf, int *key)
+{
+    long len = -1;
+    int tries;
+
+    for (tries = 0; tries < 5000; tries++) {
+        len = AVI_try_read_frame(avi, buf, key);
+        if (len >= 0 || AVI_get_error(avi) != AVI_ERR_NOT_READY) {
+            break;
+        }
+        usleep(1000);
+    }
+    return len;
+}
+
+/* read-ahead: forward, seek backwards and play in reverse, scrub */
+static int test_prefetch(int use_mmap)
+{
+    static char buf[TEST_MAX_SIZE];
+    avi_t *avi = NULL;
+    int n, key, ret = 1;
+    long len;
+
+    avi = (use_mmap) ?AVI_open_input_file_mmap(test_file, 1)
+                     :AVI_open_input_file(test_file, 1);
+    if (avi == NULL) {
+        tc_warn("open failed: %s", AVI_strerror());
+        return 0;
+    }
+    if (AVI_enable_prefetch(avi, 8) < 0) {
+        tc_warn("can't start read-ahead: %s", AVI_strerror());
+        AVI_close(avi);
+        return 0;
+    }
+    for (n = 0; n < 20 && ret; n++) {
+        len = try_read_frame(avi, buf, &key);
+        ret = check_frame(buf, len, key, n);
+    }
+    for (n = 40; n >= 30 && ret; n--) {
+        AVI_set_video_position(avi, n);
+        len = try_read_frame(avi, buf, &key);
+        ret = check_frame(buf, len, key, n);
+    }
+    for (n = 0; n < TEST_FRAMES && ret; n++) {
+        AVI_set_video_position(avi, (n * 37) % TEST_FRAMES);
+        len = try_read_frame(avi, buf, &key);
+        ret = check_frame(buf, len, key, (n * 37) % TEST_FRAMES);
+    }
+    AVI_set_video_position(avi, TEST_FRAMES);
+    if (ret && (AVI_try_read_frame(avi, buf, &key) != -1
+             || AVI_get_error(avi) == AVI_ERR_NOT_READY)
+    ) {
+        tc_warn("read past the last frame not reported as end");
+        ret = 0;
+    }
+    /* AVI_close must stop the thread */
+    AVI_close(avi);
+
+    tc_info("testing read-ahead (mmap=%s) -> %s",
+            (use_mmap) ?"yes" :"no", (ret) ?"OK" :"FAILED");
+    return ret;
+}
+
+/* one thread reads video, the other audio, from the same handle */
+static void *audio_reader(void *arg)
+{
+    static char buf[TEST_AUDIO_SIZE];
+    avi_t *avi = arg;
+    long n, len;
+    int i;
+
+    for (n = 0; n < TEST_FRAMES; n++) {
+        len = AVI_read_audio(avi, buf, TEST_AUDIO_SIZE);
+        if (len != TEST_AUDIO_SIZE) {
+            tc_warn("audio chunk %li: size %li", n, len);
+            return NULL;
+        }
+        for (i = 0; i < TEST_AUDIO_SIZE; i++) {
+            if (buf[i] != (char)n) {
+                tc_warn("audio chunk %li: content mismatch", n);
+                return NULL;
+            }
+        }
+    }
+    return avi;
+}
+
+static int test_concurrent_reads(int use_mmap)
+{
+    static char buf[TEST_MAX_SIZE];
+    pthread_t audio_thread;
+    void *audio_ret = NULL;
+    avi_t *avi = NULL;
+    int n, key, ret = 1;
+    long len;
+
+    avi = (use_mmap) ?AVI_open_input_file_mmap(test_file, 1)
+                     :AVI_open_input_file(test_file, 1);
+    if (avi == NULL) {
+        tc_warn("open failed: %s", AVI_strerror());
+        return 0;
+    }
+    if (pthread_create(&audio_thread, NULL, audio_reader, avi) != 0) {
+        tc_warn("can't start audio thread");
+        AVI_close(avi);
+        return 0;
+    }
+    for (n = 0; n < TEST_FRAMES && ret; n++) {
+        len = AVI_read_frame(avi, buf, &key);
+        ret = check_frame(buf, len, key, n);
+    }
+    pthread_join(audio_thread, &audio_ret);
+    if (audio_ret == NULL) {
+        ret = 0;
+    }
+    if (ret && AVI_read_video_at(avi, 3, buf, 1, &key) != -1) {
+        tc_warn("short buffer accepted");
+        ret = 0;
+    }
+    if (ret && AVI_get_error(avi) != AVI_ERR_NO_BUFSIZE) {
+        tc_warn("handle error not recorded (%i)", AVI_get_error(avi));
+        ret = 0;
+    }
+    AVI_close(avi);
+
+    tc_info("testing concurrent video/audio read (mmap=%s) -> %s",
+            (use_mmap) ?"yes" :"no", (ret) ?"OK" :"FAILED");
+    return ret;
+}
+
+/* write-behind must produce exactly the same file */
+static int test_write_behind(void)
+{
+    char name[] = "/tmp/test-avilib-wb-XXXXXX";
+    char *ref = NULL, *out = NULL;
+    long ref_len = 0, out_len = 0;
+    int fd, ret = 1;
+
+    fd = mkstemp(name);
+    if (fd < 0) {
+        tc_warn("can't create temporary file");
+        return 0;
+    }
+    close(fd);
+
+    /* small buffers: chunks span buffers, the writer falls behind */
+    ret = write_avi(name, 10000);
+    if (ret) {
+        ref = read_file(test_file, &ref_len);
+        out = read_file(name, &out_len);
+        if (ref == NULL || out == NULL || ref_len != out_len
+         || memcmp(ref, out, ref_len) != 0
+        ) {
+            tc_warn("files differ (%li / %li bytes)", ref_len, out_len);
+            ret = 0;
+        }
+    }
+    tc_free(ref);
+    tc_free(out);
+    unlink(name);
+
+    tc_info("testing write-behind -> %s", (ret) ?"OK" :"FAILED");
+    return ret;
+}
+
+/* remuxes the test file into `name' with the copy functions */
+static int copy_avi(const char *name)
+{
+    static char buf[TEST_MAX_SIZE];
+    avi_t *in = NULL, *out = NULL;
+    int n, key, ret = 1;
+    long len;
+
+    in  = AVI_open_input_file(test_file, 1);
+    out = (in != NULL) ?AVI_open_output_file(name) :NULL;
+    if (out == NULL) {
+        tc_warn("open failed: %s", AVI_strerror());
+        if (in != NULL)
+            AVI_close(in);
+        return 0;
+    }
+    AVI_set_video(out, AVI_video_width(in), AVI_video_height(in),
+                  AVI_frame_rate(in), AVI_video_compressor(in));
+    AVI_set_audio(out, AVI_audio_channels(in), AVI_audio_rate(in),
+                  AVI_audio_bits(in), AVI_audio_format(in),
+                  AVI_audio_mp3rate(in));
+    for (n = 0; n < TEST_FRAMES && ret; n++) {
+        if (AVI_copy_frame(out, in, n) < 0
+         || AVI_copy_audio_chunk(out, in) != TEST_AUDIO_SIZE
+        ) {
+            tc_warn("copy of frame %i failed: %s", n, AVI_strerror());
+            ret = 0;
+        }
+    }
+    AVI_close(in);
+    if (AVI_close(out) != 0) {
+        ret = 0;
+    }
+
+    in = (ret) ?AVI_open_input_file(name, 1) :NULL;
+    if (ret && in == NULL) {
+        tc_warn("can't reopen the copy: %s", AVI_strerror());
+        ret = 0;
+    }
+    for (n = 0; n < TEST_FRAMES && ret; n++) {
+        len = AVI_read_frame(in, buf, &key);
+        ret = check_frame(buf, len, key, n);
+        if (ret && (AVI_read_audio(in, buf, TEST_AUDIO_SIZE) != TEST_AUDIO_SIZE
+                 || buf[0] != (char)n || buf[TEST_AUDIO_SIZE - 1] != (char)n)
+        ) {
+            tc_warn("audio chunk %i: bad data in the copy", n);
+            ret = 0;
+        }
+    }
+    if (in != NULL) {
+        AVI_close(in);
+    }
+    return ret;
+}
+
+/* in-kernel and buffered copies must give the same, correct file */
+static int test_copy(void)
+{
+    char kname[] = "/tmp/test-avilib-kc-XXXXXX";
+    char bname[] = "/tmp/test-avilib-bc-XXXXXX";
+    char *kdata = NULL, *bdata = NULL;
+    long klen = 0, blen = 0;
+    int kfd, bfd, ret = 1;
+
+    kfd = mkstemp(kname);
+    bfd = mkstemp(bname);
+    if (kfd < 0 || bfd < 0) {
+        tc_warn("can't create temporary files");
+        return 0;
+    }
+    close(kfd);
+    close(bfd);
+
+    ret = copy_avi(kname);
+    if (ret) {
+        plat_copy_range_set_kernel(0);
+        ret = copy_avi(bname);
+        plat_copy_range_set_kernel(1);
+    }
+    if (ret) {
+        kdata = read_file(kname, &klen);
+        bdata = read_file(bname, &blen);
+        if (kdata == NULL || bdata == NULL || klen != blen
+         || memcmp(kdata, bdata, klen) != 0
+        ) {
+            tc_warn("copies differ (%li / %li bytes)", klen, blen);
+            ret = 0;
+        }
+    }
+    tc_free(kdata);
+    tc_free(bdata);
+    unlink(kname);
+    unlink(bname);
+
+    tc_info("testing copy round trip -> %s", (ret) ?"OK" :"FAILED");
+    return ret;
+}
+
+/* the binary index cache must give the same index, and only for its file */
+static int test_index_cache(void)
+{
+    static char buf[TEST_MAX_SIZE];
+    char cache_file[sizeof(test_file) + 8];
+    avi_t *avi = NULL;
+    int n, key, fd, ret = 1;
+    long len;
+
+    tc_snprintf(cache_file, sizeof(cache_file), "%s.idx", test_file);
+    unlink(cache_file);
+
+    /* no cache yet: normal open, writes it */
+    avi = AVI_open_input_file_cached(test_file, cache_file);
+    if (avi == NULL || access(cache_file, R_OK) != 0) {
+        tc_warn("cache not written: %s", AVI_strerror());
+        ret = 0;
+    }
+    if (avi != NULL) {
+        AVI_close(avi);
+    }
+
+    avi = (ret) ?AVI_open_input_indexfile(test_file, 0, cache_file) :NULL;
+    if (ret && avi == NULL) {
+        tc_warn("open with cache failed: %s", AVI_strerror());
+        ret = 0;
+    }
+    if (ret && AVI_video_frames(avi) != TEST_FRAMES) {
+        tc_warn("cache has %li frames", AVI_video_frames(avi));
+        ret = 0;
+    }
+    for (n = 0; n < TEST_FRAMES && ret; n++) {
+        len = AVI_read_frame(avi, buf, &key);
+        ret = check_frame(buf, len, key, n);
+        if (ret && (AVI_read_audio(avi, buf, TEST_AUDIO_SIZE) != TEST_AUDIO_SIZE
+                 || buf[TEST_AUDIO_SIZE - 1] != (char)n)
+        ) {
+            tc_warn("audio chunk %i: bad data from cached index", n);
+            ret = 0;
+        }
+    }
+    if (avi != NULL) {
+        AVI_close(avi);
+    }
+
+    /* a changed file must not use the old cache */
+    fd = open(test_file, O_WRONLY|O_APPEND);
+    if (ret && (fd < 0 || write(fd, "x", 1) != 1)) {
+        tc_warn("can't change the test file");
+        ret = 0;
+    }
+    if (fd >= 0) {
+        close(fd);
+    }
+    if (ret && AVI_open_input_indexfile(test_file, 0, cache_file) != NULL) {
+        tc_warn("stale cache accepted");
+        ret = 0;
+    }
+    unlink(cache_file);
+
+    tc_info("testing index cache -> %s", (ret) ?"OK" :"FAILED");
+    return ret;
+}
+
+int main(void)
+{
+    int errors = 0;
+
+    if (!write_test_file()) {
+        tc_error("can't create test file");
+    }
+
+    if (!test_read_frames(0))
+        errors++;
+    if (!test_read_frames(1))
+        errors++;
+    if (!test_peek_frames(0))
+        errors++;
+    if (!test_peek_frames(1))
+        errors++;
+    if (!test_batch_read(0))
+        errors++;
+    if (!test_batch_read(1))
+        errors++;
+    if (!test_prefetch(0))
+        errors++;
+    if (!test_prefetch(1))
+        errors++;
+    if (!test_concurrent_reads(0))
+        errors++;
+    if (!test_concurrent_reads(1))
+        errors++;
+
+    if (!test_write_behind())
+        errors++;
+    if (!test_copy())
+        errors++;
+    /* modifies the test file, keep last */
+    if (!test_index_cache())
+        errors++;
+
+    unlink(test_file);
+
+    return (errors) ?1 :0;
+}
+
+/*************************************************************************/
+
+/*
+ * Local variables:
+ *   c-file-style: "stroustrup"
+ *   c-file-offsets: ((case-label . *) (statement-case-intro . *))
+ *   indent-tabs-mode: nil
+ * End:
+ *
+ * vim: expandtab shiftwidth=4:
+ */
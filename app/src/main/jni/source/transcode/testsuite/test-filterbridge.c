@@ -0,0 +1,247 @@
+/*
+ * test-filterbridge.c -- testsuite for TC_FILTER_OLDINTERFACE_M, the
+ *                        classic tc_filter() bridge of multi-instance
+ *                        filters, using filter_unsharp (a STATELESS
+ *                        module) linked in directly: instances must not
+ *                        share state, concurrent calls on one instance
+ *                        must give the same result as sequential ones,
+ *                        and frames larger than configured are refused.
+ *
+ * This file is part of transcode, a video stream processing tool.
+ *
+ * transcode is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * transcode is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "config.h"
+#include "src/transcode.h"
+#include "src/filter.h"
+#include "libtc/libtc.h"
+#include "aclib/ac.h"
+
+#define WIDTH   176
+#define HEIGHT  144
+#define FRAMES  8       /* frames filtered concurrently */
+
+#define SHARPEN "luma=1.5:luma_matrix=5x5:chroma=0.8:chroma_matrix=3x3"
+#define BLUR    "luma=-1.0:luma_matrix=7x7:chroma=-0.5:chroma_matrix=5x5"
+
+int verbose = TC_QUIET;
+
+static vob_t *vob = NULL;
+
+/* dependencies */
+vob_t *tc_get_vob(void) { return vob; }
+
+/* filter_unsharp.c */
+extern int tc_filter(frame_list_t *frame, char *options);
+
+/*************************************************************************/
+
+static vframe_list_t *new_frame(int id, int width, int height,
+                                const uint8_t *src)
+{
+    vframe_list_t *frame = tc_zalloc(sizeof(vframe_list_t));
+    int size = tc_video_frame_size(width, height, TC_CODEC_YUV420P);
+
+    if (frame != NULL) {
+        frame->video_buf = tc_malloc(size);
+        if (frame->video_buf == NULL) {
+            free(frame);
+            return NULL;
+        }
+        ac_memcpy(frame->video_buf, src, size);
+        frame->filter_id  = id;
+        frame->tag        = TC_VIDEO | TC_POST_M_PROCESS;
+        frame->v_codec    = TC_CODEC_YUV420P;
+        frame->v_width    = width;
+        frame->v_height   = height;
+        frame->video_size = size;
+        frame->video_len  = size;
+    }
+    return frame;
+}
+
+static void del_frame(vframe_list_t *frame)
+{
+    if (frame != NULL) {
+        free(frame->video_buf);
+        free(frame);
+    }
+}
+
+static int control(int id, int tag, const char *options)
+{
+    frame_list_t frame;
+    char buf[TC_BUF_MAX];
+
+    memset(&frame, 0, sizeof(frame));
+    frame.filter_id = id;
+    frame.tag = tag;
+    strlcpy(buf, (options != NULL) ?options :"", sizeof(buf));
+    return tc_filter(&frame, buf);
+}
+
+/* filter a copy of `src' through instance `id' into `dest' */
+static int filter_frame(int id, const uint8_t *src, uint8_t *dest)
+{
+    vframe_list_t *frame = new_frame(id, WIDTH, HEIGHT, src);
+    int ret = TC_ERROR;
+
+    if (frame != NULL) {
+        ret = tc_filter((frame_list_t *)frame, NULL);
+        ac_memcpy(dest, frame->video_buf, frame->video_size);
+        del_frame(frame);
+    }
+    return ret;
+}
+
+static int check(const char *name, int ok)
+{
+    if (ok) {
+        tc_log_info(__FILE__, "%s: PASSED", name);
+        return 0;
+    }
+    tc_log_error(__FILE__, "%s: FAILED", name);
+    return 1;
+}
+
+/*************************************************************************/
+
+typedef struct worker_ Worker;
+struct worker_ {
+    pthread_t thread;
+    vframe_list_t *frame;
+    int ret;
+};
+
+static void *worker_thread(void *arg)
+{
+    Worker *w = arg;
+
+    w->ret = tc_filter((frame_list_t *)w->frame, NULL);
+    return NULL;
+}
+
+/*************************************************************************/
+
+int main(int argc, char *argv[])
+{
+    int size = tc_video_frame_size(WIDTH, HEIGHT, TC_CODEC_YUV420P);
+    uint8_t *src   = tc_malloc(size);
+    uint8_t *sharp = tc_malloc(size);
+    uint8_t *blur  = tc_malloc(size);
+    uint8_t *res   = tc_malloc(size);
+    Worker workers[FRAMES];
+    vframe_list_t *big = NULL;
+    uint8_t *zero = NULL;
+    int errors = 0, i = 0, ok = 0;
+
+    vob = tc_zalloc(sizeof(vob_t));
+    if (!src || !sharp || !blur || !res || !vob) {
+        tc_log_error(__FILE__, "initialization failed");
+        return 1;
+    }
+    ac_init(AC_ALL);
+
+    vob->im_v_codec  = CODEC_YUV;
+    vob->im_v_width  = vob->ex_v_width  = WIDTH;
+    vob->im_v_height = vob->ex_v_height = HEIGHT;
+
+    srand(1);
+    for (i = 0; i < size; i++) {
+        src[i] = ((i % WIDTH) / 4 + (i / WIDTH) / 4) * 8 + (rand() & 15);
+    }
+
+    if (control(1, TC_FILTER_INIT, SHARPEN) != TC_OK
+     || control(2, TC_FILTER_INIT, BLUR) != TC_OK) {
+        tc_log_error(__FILE__, "TC_FILTER_INIT failed");
+        return 1;
+    }
+
+    /* reference results, one instance after the other */
+    ok = (filter_frame(1, src, sharp) == TC_OK
+          && filter_frame(2, src, blur) == TC_OK);
+    errors += check("two instances", ok && memcmp(sharp, blur, size) != 0
+                                        && memcmp(sharp, src, size) != 0);
+
+    /* the second instance must not have changed the first one */
+    ok = (filter_frame(1, src, res) == TC_OK);
+    errors += check("instances keep their own options",
+                    ok && memcmp(res, sharp, size) == 0);
+
+    /* one STATELESS instance, frames filtered concurrently */
+    for (i = 0; i < FRAMES; i++) {
+        workers[i].frame = new_frame((i & 1) ?2 :1, WIDTH, HEIGHT, src);
+        if (workers[i].frame == NULL) {
+            tc_log_error(__FILE__, "out of memory");
+            return 1;
+        }
+    }
+    for (i = 0; i < FRAMES; i++) {
+        pthread_create(&workers[i].thread, NULL, worker_thread, &workers[i]);
+    }
+    ok = 1;
+    for (i = 0; i < FRAMES; i++) {
+        pthread_join(workers[i].thread, NULL);
+        ok = ok && workers[i].ret == TC_OK
+                && memcmp(workers[i].frame->video_buf,
+                          (i & 1) ?blur :sharp, size) == 0;
+        del_frame(workers[i].frame);
+    }
+    errors += check("concurrent frames", ok);
+
+    /* the scratch space is sized after the configured geometry */
+    zero = tc_zalloc(tc_video_frame_size(WIDTH * 2, HEIGHT * 2,
+                                         TC_CODEC_YUV420P));
+    big = (zero != NULL) ?new_frame(1, WIDTH * 2, HEIGHT * 2, zero) :NULL;
+    errors += check("oversized frame refused",
+                    big != NULL
+                    && tc_filter((frame_list_t *)big, NULL) == TC_ERROR);
+    del_frame(big);
+    free(zero);
+
+    errors += check("unknown instance refused",
+                    control(3, TC_POST_M_PROCESS | TC_VIDEO, NULL)
+                        == TC_ERROR);
+
+    if (control(1, TC_FILTER_CLOSE, NULL) != TC_OK
+     || control(2, TC_FILTER_CLOSE, NULL) != TC_OK) {
+        tc_log_error(__FILE__, "TC_FILTER_CLOSE failed");
+        errors++;
+    }
+
+    free(src);
+    free(sharp);
+    free(blur);
+    free(res);
+    free(vob);
+    return (errors > 0) ?1 :0;
+}
+
+/*************************************************************************/
+
+/*
+ * Local variables:
+ *   c-file-style: "stroustrup"
+ *   c-file-offsets: ((case-label . *) (statement-case-intro . *))
+ *   indent-tabs-mode: nil
+ * End:
+ *
+ * vim: expandtab shiftwidth=4:
+ */
@@ -0,0 +1,393 @@
+/*
+ * test-framebuffer.c -- testsuite for the frame ringbuffers (framebuffer.c)
+ *                       in both locked and lock-free flavours.
+ *
+ * This file is part of transcode, a video stream processing tool.
+ *
+ * transcode is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * transcode is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include <sched.h>
+
+#include "config.h"
+#include "transcode.h"
+#include "framebuffer.h"
+#include "decoder.h"
+#include "encoder-common.h"
+#include "libtc/libtc.h"
+
+#define RING_SIZE       6
+#define FRAMES          2000
+#define FILTER_THREADS  3
+
+/* every FRAME_SKIP-th frame is dropped by the filter layer... */
+#define FRAME_SKIP      7
+/* ...every FRAME_CLONE-th frame is cloned */
+#define FRAME_CLONE     5
+
+int verbose = TC_INFO;
+
+/*************************************************************************/
+/* core stubs                                                            */
+/*************************************************************************/
+
+static pthread_mutex_t state_lock = PTHREAD_MUTEX_INITIALIZER;
+static int running = TC_TRUE;
+static int stopped = 0;
+static int cloning = TC_FALSE;
+
+int tc_running(void)
+{
+    int ret = 0;
+    pthread_mutex_lock(&state_lock);
+    ret = running;
+    pthread_mutex_unlock(&state_lock);
+    return ret;
+}
+
+int tc_import_video_running(void)
+{
+    return TC_TRUE;
+}
+
+int tc_import_audio_running(void)
+{
+    return TC_TRUE;
+}
+
+/*************************************************************************/
+
+typedef struct counters_ Counters;
+struct counters_ {
+    int im, fl, ex;
+};
+
+#define COUNTERS_MAX    32
+
+static int record(Counters *c, int n)
+{
+    if (n < COUNTERS_MAX) {
+        aframe_get_counters(&c[n].im, &c[n].fl, &c[n].ex);
+    }
+    return n + 1;
+}
+
+/*
+ * run a fixed single threaded sequence through the audio ring,
+ * recording the counters after each step.
+ */
+static int counters_sequence(Counters *c)
+{
+    aframe_list_t *f[3], *clone = NULL, *ptr = NULL;
+    int i = 0, n = 0;
+
+    for (i = 0; i < 3; i++) {
+        f[i] = aframe_register(i);
+        n = record(c, n);
+    }
+    for (i = 0; i < 3; i++) {
+        aframe_push_next(f[i], TC_FRAME_WAIT);
+        n = record(c, n);
+    }
+
+    ptr = aframe_reserve();                     /* frame 0 */
+    n = record(c, n);
+    clone = aframe_dup(ptr);
+    n = record(c, n);
+    aframe_push_next(clone, TC_FRAME_WAIT);
+    n = record(c, n);
+    aframe_push_next(ptr, TC_FRAME_READY);
+    n = record(c, n);
+
+    ptr = aframe_reserve();                     /* clone of frame 0 */
+    n = record(c, n);
+    aframe_push_next(ptr, TC_FRAME_READY);
+    n = record(c, n);
+
+    ptr = aframe_reserve();                     /* frame 1, skipped */
+    n = record(c, n);
+    aframe_remove(ptr);
+    n = record(c, n);
+
+    ptr = aframe_reserve();                     /* frame 2 */
+    n = record(c, n);
+    aframe_push_next(ptr, TC_FRAME_READY);
+    n = record(c, n);
+
+    for (i = 0; i < 3; i++) {
+        ptr = aframe_retrieve();
+        n = record(c, n);
+        aframe_remove(ptr);
+        n = record(c, n);
+    }
+    return n;
+}
+
+static int test_counters(void)
+{
+    Counters locked[COUNTERS_MAX], lockfree[COUNTERS_MAX];
+    int i = 0, n = 0, m = 0, ret = 0;
+
+    tc_framebuffer_set_lockfree(TC_FALSE);
+    aframe_alloc(RING_SIZE);
+    n = counters_sequence(locked);
+    aframe_free();
+
+    tc_framebuffer_set_lockfree(TC_TRUE);
+    aframe_alloc(RING_SIZE);
+    m = counters_sequence(lockfree);
+    aframe_free();
+
+    if (n != m || n > COUNTERS_MAX) {
+        tc_log_error(__FILE__, "test_counters: FAILED (%i/%i steps)", n, m);
+        return 1;
+    }
+    for (i = 0; i < n; i++) {
+        if (locked[i].im != lockfree[i].im
+         || locked[i].fl != lockfree[i].fl
+         || locked[i].ex != lockfree[i].ex) {
+            tc_log_error(__FILE__, "test_counters: FAILED at step %i:"
+                                   " %i/%i/%i != %i/%i/%i", i,
+                         locked[i].im, locked[i].fl, locked[i].ex,
+                         lockfree[i].im, lockfree[i].fl, lockfree[i].ex);
+            ret = 1;
+        }
+    }
+    if (ret == 0) {
+        tc_log_info(__FILE__, "test_counters: PASSED (%i steps)", n);
+    }
+    return ret;
+}
+
+/*************************************************************************/
+
+/* video buffers must follow the stream geometry, always room for RGB */
+static int test_specs(const TCFrameSpecs *base)
+{
+    TCFrameSpecs specs = *base;
+    vframe_list_t *ptr = NULL;
+    int ret = 0;
+
+    specs.width  = 64;
+    specs.height = 48;
+    specs.format = TC_CODEC_YUV420P;
+    tc_framebuffer_set_specs(&specs);
+
+    ptr = vframe_alloc_single();
+    if (ptr == NULL || ptr->video_size != 64 * 48 * 3) {
+        tc_log_error(__FILE__, "test_specs: FAILED (size %i, expected %i)",
+                     (ptr != NULL) ?ptr->video_size :-1, 64 * 48 * 3);
+        ret = 1;
+    } else {
+        tc_log_info(__FILE__, "test_specs: PASSED");
+    }
+    tc_del_video_frame(ptr);
+
+    tc_framebuffer_set_specs(base);
+    return ret;
+}
+
+/*************************************************************************/
+
+static void *import_thread(void *arg)
+{
+    int id = 0;
+
+    for (id = 0; id < FRAMES; id++) {
+        aframe_list_t *ptr = aframe_register(id);
+        if (ptr == NULL) {
+            break;
+        }
+        ptr->audio_size = 16;
+        ptr->audio_len  = 16;
+        ptr->audio_buf[0] = id & 0xff;
+        if (id == FRAMES - 1) {
+            ptr->attributes |= TC_FRAME_IS_END_OF_STREAM;
+        }
+        aframe_push_next(ptr, TC_FRAME_WAIT);
+    }
+    return NULL;
+}
+
+static void *filter_thread(void *arg)
+{
+    aframe_list_t *ptr = NULL;
+
+    while ((ptr = aframe_reserve()) != NULL) {
+        if (ptr->attributes & TC_FRAME_WAS_CLONED) {
+            aframe_push_next(ptr, TC_FRAME_READY);
+            continue;
+        }
+        if (ptr->id % FRAME_SKIP == 3) {
+            aframe_remove(ptr);
+            continue;
+        }
+        if (ptr->id % 3 == 0) {
+            sched_yield(); /* stir things up */
+        }
+        if (cloning && ptr->id % FRAME_CLONE == 1) {
+            aframe_list_t *clone = aframe_dup(ptr);
+            clone->attributes |= TC_FRAME_WAS_CLONED;
+            aframe_push_next(clone, TC_FRAME_WAIT);
+        }
+        aframe_push_next(ptr, TC_FRAME_READY);
+    }
+    pthread_mutex_lock(&state_lock);
+    stopped++;
+    pthread_mutex_unlock(&state_lock);
+    return NULL;
+}
+
+static int filters_stopped(void)
+{
+    int ret = 0;
+    pthread_mutex_lock(&state_lock);
+    ret = stopped;
+    pthread_mutex_unlock(&state_lock);
+    return ret;
+}
+
+/*
+ * The locked rings take clones from the pool, and can deadlock when the
+ * pool is exhausted while a filter is cloning the export head; so they
+ * are exercised without clones.
+ */
+static int test_pipeline(int lockfree, int clones)
+{
+    pthread_t import, filters[FILTER_THREADS];
+    int id = 0, clone = 0, errors = 0, frames = 0, i = 0;
+    int im = 0, fl = 0, ex = 0;
+    aframe_list_t *ptr = NULL;
+
+    running = TC_TRUE;
+    stopped = 0;
+    cloning = clones;
+    tc_framebuffer_set_lockfree(lockfree);
+    aframe_alloc(RING_SIZE);
+
+    pthread_create(&import, NULL, import_thread, NULL);
+    for (i = 0; i < FILTER_THREADS; i++) {
+        pthread_create(&filters[i], NULL, filter_thread, NULL);
+    }
+
+    /* export: frames must come out in the import order, clones included */
+    while (id < FRAMES) {
+        if (id % FRAME_SKIP == 3) {
+            id++;
+            continue;
+        }
+        ptr = aframe_retrieve();
+        if (ptr == NULL) {
+            errors++;
+            break;
+        }
+        if (ptr->id != id || ptr->audio_buf[0] != (id & 0xff)
+         || !(ptr->attributes & TC_FRAME_WAS_CLONED) != !clone) {
+            if (errors++ < 5) {
+                tc_log_error(__FILE__, "got frame %i%s, expected %i%s",
+                             ptr->id,
+                             (ptr->attributes & TC_FRAME_WAS_CLONED)
+                                ?" (clone)" :"",
+                             id, (clone) ?" (clone)" :"");
+            }
+        }
+        aframe_remove(ptr);
+        frames++;
+
+        if (cloning && !clone && id % FRAME_CLONE == 1) {
+            clone = TC_TRUE;
+        } else {
+            clone = TC_FALSE;
+            id++;
+        }
+    }
+
+    aframe_get_counters(&im, &fl, &ex);
+    if (im != RING_SIZE || fl != 0 || ex != 0) {
+        tc_log_error(__FILE__, "bad counters at end: %i/%i/%i", im, fl, ex);
+        errors++;
+    }
+    if (aframe_have_more()) {
+        tc_log_error(__FILE__, "frames left over at end");
+        errors++;
+    }
+
+    /*
+     * a filter may go to sleep just after an interruption (the locked
+     * rings don't recheck before waiting), so keep knocking.
+     */
+    pthread_mutex_lock(&state_lock);
+    running = TC_FALSE;
+    pthread_mutex_unlock(&state_lock);
+    while (filters_stopped() < FILTER_THREADS) {
+        tc_framebuffer_interrupt();
+        sched_yield();
+    }
+    pthread_join(import, NULL);
+    for (i = 0; i < FILTER_THREADS; i++) {
+        pthread_join(filters[i], NULL);
+    }
+    aframe_flush();
+    aframe_free();
+
+    if (errors > 0) {
+        tc_log_error(__FILE__, "test_pipeline(%s): FAILED (%i errors)",
+                     (lockfree) ?"lockfree" :"locked", errors);
+        return 1;
+    }
+    tc_log_info(__FILE__, "test_pipeline(%s): PASSED (%i frames)",
+                (lockfree) ?"lockfree" :"locked", frames);
+    return 0;
+}
+
+/*************************************************************************/
+
+int main(int argc, char *argv[])
+{
+    TCFrameSpecs specs = {
+        .frc      = 3,
+        .width    = 16,
+        .height   = 16,
+        .format   = TC_CODEC_RGB,
+        .rate     = 8000,
+        .channels = 1,
+        .bits     = 8,
+    };
+    int errors = 0;
+
+    tc_framebuffer_set_specs(&specs);
+
+    errors += test_specs(&specs);
+    errors += test_counters();
+    errors += test_pipeline(TC_FALSE, TC_FALSE);
+    errors += test_pipeline(TC_TRUE, TC_FALSE);
+    errors += test_pipeline(TC_TRUE, TC_TRUE);
+
+    return (errors > 0) ?1 :0;
+}
+
+/*************************************************************************/
+
+/*
+ * Local variables:
+ *   c-file-style: "stroustrup"
+ *   c-file-offsets: ((case-label . *) (statement-case-intro . *))
+ *   indent-tabs-mode: nil
+ * End:
+ *
+ * vim: expandtab shiftwidth=4:
+ */
@@ -228,7 +228,7 @@ static int checkall(uint8_t *srcimage, int accel, const char *name)
 static const char *accel_flags(int accel)
 {
     static char buf[1000];
-    snprintf(buf, sizeof(buf), "%s%s%s%s%s%s%s%s%s%s",
+    snprintf(buf, sizeof(buf), "%s%s%s%s%s%s%s%s%s%s%s%s",
            !accel                ? " none"     : "",
            (accel & AC_IA32ASM ) ? " ia32asm"  : "",
            (accel & AC_AMD64ASM) ? " amd64asm" : "",
@@ -238,7 +238,9 @@ static const char *accel_flags(int accel)
            (accel & AC_3DNOW   ) ? " 3dnow"    : "",
            (accel & AC_SSE     ) ? " sse"      : "",
            (accel & AC_SSE2    ) ? " sse2"     : "",
-           (accel & AC_SSE3    ) ? " sse3"     : "");
+           (accel & AC_SSE3    ) ? " sse3"     : "",
+           (accel & AC_AVX2    ) ? " avx2"     : "",
+           (accel & AC_VECTOR  ) ? " vector"   : "");
     return buf;
 }
 
@@ -301,6 +303,10 @@ int main(int argc, char **argv)
             accel |= AC_SSE2;
         else if (strcmp(argv[argc],"sse3") == 0)
             accel |= AC_SSE3;
+        else if (strcmp(argv[argc],"avx2") == 0)
+            accel |= AC_AVX2;
+        else if (strcmp(argv[argc],"vector") == 0)
+            accel |= AC_VECTOR;
         else if (argv[argc][0] == '=') {
             char *s = argv[argc]+1;
             for (i = 0; fmtlist[i].fmt != IMG_NONE; i++) {
@@ -363,6 +369,7 @@ int main(int argc, char **argv)
         srcbuf[i] = random();
 
     if (check) {
+        int ok = 1;
         if (ac_cpuinfo() & (AC_IA32ASM | AC_AMD64ASM)) {
             if (!checkall(srcbuf, AC_IA32ASM | AC_AMD64ASM,
                           verbose ? "asm" : NULL))
@@ -373,13 +380,25 @@ int main(int argc, char **argv)
                           verbose ? "mmx" : NULL))
                 return 1;
         }
+        /* The vector and AVX2 routines are checked even if the SSE2 ones
+         * fail, since they replace some of them */
         if (ac_cpuinfo() & AC_SSE2) {
             if (!checkall(srcbuf, AC_IA32ASM | AC_AMD64ASM | AC_CMOVE
                                 | AC_MMX | AC_SSE | AC_SSE2,
                           verbose ? "sse2" : NULL))
-                return 1;
+                ok = 0;
         }
-        return 0;
+        if (ac_cpuinfo() & AC_AVX2) {
+            if (!checkall(srcbuf, AC_IA32ASM | AC_AMD64ASM | AC_CMOVE
+                                | AC_MMX | AC_SSE | AC_SSE2 | AC_AVX2,
+                          verbose ? "avx2" : NULL))
+                ok = 0;
+        }
+        if (ac_cpuinfo() & AC_VECTOR) {
+            if (!checkall(srcbuf, AC_VECTOR, verbose ? "vector" : NULL))
+                ok = 0;
+        }
+        return ok ? 0 : 1;
     }
 
     printf("Acceleration flags:%s\n", accel_flags(accel));
@@ -0,0 +1,201 @@
+/*
+ * test-rtjpeg.c -- testsuite for the banded (multithreaded) decoding of
+ *                  the RTjpeg codec of import_nuv: a frame decoded on
+ *                  several threads must be the same as one decoded on
+ *                  the calling thread alone, including frames where
+ *                  blocks are skipped as unchanged.
+ *
+ * This file is part of transcode, a video stream processing tool.
+ *
+ * transcode is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * transcode is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "config.h"
+#include "src/transcode.h"
+#include "libtc/libtc.h"
+#include "aclib/ac.h"
+#include "import/nuv/RTjpegN.h"
+
+#define THREADS 4
+#define QUALITY 200
+
+int verbose = TC_QUIET;
+
+/*************************************************************************/
+
+enum { YUV420, YUV422, GRAY8 };
+
+typedef struct {
+    const char *name;
+    int format;
+    int width, height;
+} RTjpegTest;
+
+static const RTjpegTest tests[] = {
+    { "YUV420 352x288",  YUV420, 352, 288 },
+    { "YUV420 48x32",    YUV420,  48,  32 },   /* fewer bands than threads */
+    { "YUV422 176x144",  YUV422, 176, 144 },
+    { "8 bit 184x136",   GRAY8,  184, 136 },
+    { NULL }
+};
+
+/*************************************************************************/
+
+static int frame_size(const RTjpegTest *test)
+{
+    int size = test->width * test->height;
+    return (test->format == YUV420) ?size * 3 / 2
+         : (test->format == YUV422) ?size * 2
+         : size;
+}
+
+/* code a frame, as a key frame or against the previous one */
+static int encode(RTjpegContext *enc, const RTjpegTest *test, int delta,
+                  uint8_t *frame, int8_t *buf)
+{
+    switch (test->format) {
+      case YUV420:
+        return delta ?RTjpeg_mcompressYUV420(enc, buf, frame, 2, 2)
+                     :RTjpeg_compressYUV420(enc, buf, frame);
+      case YUV422:
+        return delta ?RTjpeg_mcompressYUV422(enc, buf, frame, 2, 2)
+                     :RTjpeg_compressYUV422(enc, buf, frame);
+      default:
+        return delta ?RTjpeg_mcompress8(enc, buf, frame, 2)
+                     :RTjpeg_compress8(enc, buf, frame);
+    }
+}
+
+static void decode(RTjpegContext *dec, const RTjpegTest *test,
+                   int8_t *buf, uint8_t *frame)
+{
+    switch (test->format) {
+      case YUV420:
+        RTjpeg_decompressYUV420(dec, buf, frame);
+        break;
+      case YUV422:
+        RTjpeg_decompressYUV422(dec, buf, frame);
+        break;
+      default:
+        RTjpeg_decompress8(dec, buf, frame);
+        break;
+    }
+}
+
+static int run_test(const RTjpegTest *test, const uint8_t *src)
+{
+    int size = frame_size(test);
+    RTjpegContext *enc = RTjpeg_new(AC_ALL);
+    RTjpegContext *single = RTjpeg_new(AC_ALL);
+    RTjpegContext *multi = RTjpeg_new(AC_ALL);
+    uint8_t *frame = tc_malloc(size);
+    uint8_t *ref = tc_zalloc(size);
+    uint8_t *res = tc_zalloc(size);
+    int8_t *buf = tc_malloc(size * 4);
+    uint32_t tables[128];
+    int n = 0, i = 0, ret = 1;
+
+    if (!enc || !single || !multi || !frame || !ref || !res || !buf) {
+        tc_log_error(__FILE__, "%s: out of memory", test->name);
+        goto done;
+    }
+    if (!RTjpeg_set_threads(multi, THREADS)) {
+        tc_log_error(__FILE__, "%s: RTjpeg_set_threads() failed",
+                     test->name);
+        goto done;
+    }
+
+    RTjpeg_init_compress(enc, tables, test->width, test->height, QUALITY);
+    if (!RTjpeg_init_mcompress(enc)) {
+        tc_log_error(__FILE__, "%s: out of memory", test->name);
+        goto done;
+    }
+    RTjpeg_init_decompress(single, tables, test->width, test->height);
+    RTjpeg_init_decompress(multi, tables, test->width, test->height);
+
+    /* a key frame, then one where only the lower half changed */
+    memcpy(frame, src, size);
+    for (n = 0; n < 2; n++) {
+        if (n > 0) {
+            for (i = size / 2; i < size; i++)
+                frame[i] = 255 - frame[i];
+        }
+        encode(enc, test, n, frame, buf);
+        decode(single, test, buf, ref);
+        decode(multi, test, buf, res);
+        if (memcmp(ref, res, size) != 0) {
+            for (i = 0; ref[i] == res[i]; i++)
+                ;
+            tc_log_error(__FILE__, "%s: FAILED (frame %i, first difference"
+                         " at byte %i)", test->name, n, i);
+            goto done;
+        }
+    }
+    tc_log_info(__FILE__, "%s: PASSED", test->name);
+    ret = 0;
+
+  done:
+    RTjpeg_free(enc);
+    RTjpeg_free(single);
+    RTjpeg_free(multi);
+    free(frame);
+    free(ref);
+    free(res);
+    free(buf);
+    return ret;
+}
+
+/*************************************************************************/
+
+int main(int argc, char *argv[])
+{
+    int size = 352 * 288 * 2;
+    uint8_t *src = tc_malloc(size);
+    int errors = 0, i = 0;
+
+    if (src == NULL) {
+        tc_log_error(__FILE__, "initialization failed");
+        return 1;
+    }
+    ac_init(AC_ALL);
+
+    srand(1);
+    for (i = 0; i < size; i++) {
+        /* smooth gradients with some noise */
+        src[i] = ((i % 352) / 8 + (i / 352) / 8) * 4 + (rand() & 15);
+    }
+
+    for (i = 0; tests[i].name != NULL; i++) {
+        errors += run_test(&tests[i], src);
+    }
+
+    free(src);
+    return (errors > 0) ?1 :0;
+}
+
+/*************************************************************************/
+
+/*
+ * Local variables:
+ *   c-file-style: "stroustrup"
+ *   c-file-offsets: ((case-label . *) (statement-case-intro . *))
+ *   indent-tabs-mode: nil
+ * End:
+ *
+ * vim: expandtab shiftwidth=4:
+ */
@@ -0,0 +1,268 @@
+/*
+ * test-tcvideo.c -- testsuite for the sliced (multithreaded) operations
+ *                   of libtcvideo: the results must not depend on the
+ *                   number of threads.  Also checks that tcv_zoom_rect()
+ *                   gives the same result as the separate operations.
+ *
+ * This file is part of transcode, a video stream processing tool.
+ *
+ * transcode is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * transcode is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "config.h"
+#include "src/transcode.h"
+#include "libtc/libtc.h"
+#include "aclib/ac.h"
+#include "libtcvideo/tcvideo.h"
+
+#define WIDTH   720
+#define HEIGHT  576
+#define THREADS 4
+
+int verbose = TC_INFO;
+
+/*************************************************************************/
+
+typedef struct testcase_ TestCase;
+struct testcase_ {
+    const char *name;
+    /* run the operation on `src' (of WIDTH x HEIGHT pixels) to `dest' */
+    int (*run)(TCVHandle handle, uint8_t *src, uint8_t *dest);
+    int destsize;
+    /* if not NULL, used instead of `run' for the single-thread reference */
+    int (*ref)(TCVHandle handle, uint8_t *src, uint8_t *dest);
+};
+
+static int zoom_down(TCVHandle handle, uint8_t *src, uint8_t *dest)
+{
+    return tcv_zoom(handle, src, dest, WIDTH, HEIGHT, 1,
+                    352, 288, TCV_ZOOM_LANCZOS3);
+}
+
+static int zoom_up_rgb(TCVHandle handle, uint8_t *src, uint8_t *dest)
+{
+    return tcv_zoom(handle, src, dest, WIDTH, HEIGHT / 2, 3,
+                    1280, 720, TCV_ZOOM_B_SPLINE);
+}
+
+static int zoom_vertical(TCVHandle handle, uint8_t *src, uint8_t *dest)
+{
+    return tcv_zoom(handle, src, dest, WIDTH, HEIGHT, 1,
+                    WIDTH, 480, TCV_ZOOM_MITCHELL);
+}
+
+static int zoom_interlaced(TCVHandle handle, uint8_t *src, uint8_t *dest)
+{
+    return tcv_zoom(handle, src, dest, WIDTH, HEIGHT, 1,
+                    640, -480, TCV_ZOOM_TRIANGLE);
+}
+
+static int antialias(TCVHandle handle, uint8_t *src, uint8_t *dest)
+{
+    return tcv_antialias(handle, src, dest, WIDTH, HEIGHT / 3, 3,
+                         0.333, 0.5);
+}
+
+static int yuv_to_rgb(TCVHandle handle, uint8_t *src, uint8_t *dest)
+{
+    return tcv_convert(handle, src, dest, WIDTH, HEIGHT,
+                       IMG_YUV420P, IMG_RGB24);
+}
+
+static int rgb_to_yuv_in_place(TCVHandle handle, uint8_t *src, uint8_t *dest)
+{
+    ac_memcpy(dest, src, WIDTH * (HEIGHT / 3) * 3);
+    return tcv_convert(handle, dest, dest, WIDTH, HEIGHT / 3,
+                       IMG_RGB24, IMG_YUV420P);
+}
+
+static int yuy2_to_yuv422p(TCVHandle handle, uint8_t *src, uint8_t *dest)
+{
+    return tcv_convert(handle, src, dest, WIDTH, HEIGHT / 2,
+                       IMG_YUY2, IMG_YUV422P);
+}
+
+/* The reference for the tcv_zoom_rect() tests: clip, zoom, clip, flip,
+ * one operation at a time. */
+static int zoom_rect_steps(TCVHandle handle, uint8_t *src, uint8_t *dest,
+                           int Bpp, int l1, int r1, int t1, int b1,
+                           int new_w, int new_h, int l2, int r2, int t2, int b2,
+                           int flags, TCVZoomFilter filter)
+{
+    uint8_t *tmp1 = tc_malloc(WIDTH * HEIGHT * 3);
+    uint8_t *tmp2 = tc_malloc(1280 * 720 * 3);
+    int w = WIDTH - l1 - r1, h = HEIGHT - t1 - b1;
+    int out_w = new_w - l2 - r2, out_h = new_h - t2 - b2;
+    int ok = 0;
+
+    if (tmp1 != NULL && tmp2 != NULL
+     && tcv_clip(handle, src, tmp1, WIDTH, HEIGHT, Bpp, l1, r1, t1, b1, 0)
+     && tcv_zoom(handle, tmp1, tmp2, w, h, Bpp, new_w, new_h, filter)
+     && tcv_clip(handle, tmp2, tmp1, new_w, new_h, Bpp, l2, r2, t2, b2, 0)
+    ) {
+        ok = 1;
+        if (flags & TCV_ZOOM_RECT_FLIP_V) {
+            ok = ok && tcv_flip_v(handle, tmp1, tmp2, out_w, out_h, Bpp);
+            ac_memcpy(tmp1, tmp2, out_w * out_h * Bpp);
+        }
+        if (flags & TCV_ZOOM_RECT_FLIP_H) {
+            ok = ok && tcv_flip_h(handle, tmp1, tmp2, out_w, out_h, Bpp);
+            ac_memcpy(tmp1, tmp2, out_w * out_h * Bpp);
+        }
+        ac_memcpy(dest, tmp1, out_w * out_h * Bpp);
+    }
+    free(tmp1);
+    free(tmp2);
+    return ok;
+}
+
+static int zoom_rect(TCVHandle handle, uint8_t *src, uint8_t *dest)
+{
+    return tcv_zoom_rect(handle, src + (8*WIDTH + 16), WIDTH, 688, 560,
+                         dest, 600, 1, 640, 480, 20, 24, 600, 440,
+                         TCV_ZOOM_RECT_FLIP_V | TCV_ZOOM_RECT_FLIP_H,
+                         TCV_ZOOM_LANCZOS3);
+}
+
+static int zoom_rect_ref(TCVHandle handle, uint8_t *src, uint8_t *dest)
+{
+    return zoom_rect_steps(handle, src, dest, 1, 16, 16, 8, 8, 640, 480,
+                           20, 20, 24, 16,
+                           TCV_ZOOM_RECT_FLIP_V | TCV_ZOOM_RECT_FLIP_H,
+                           TCV_ZOOM_LANCZOS3);
+}
+
+static int zoom_rect_vertical_rgb(TCVHandle handle, uint8_t *src,
+                                  uint8_t *dest)
+{
+    return tcv_zoom_rect(handle, src + (2*WIDTH + 4) * 3, WIDTH*3, 712, 572,
+                         dest, 700*3, 3, 712, 400, 6, 0, 700, 400,
+                         TCV_ZOOM_RECT_FLIP_H, TCV_ZOOM_MITCHELL);
+}
+
+static int zoom_rect_vertical_rgb_ref(TCVHandle handle, uint8_t *src,
+                                      uint8_t *dest)
+{
+    return zoom_rect_steps(handle, src, dest, 3, 4, 4, 2, 2, 712, 400,
+                           6, 6, 0, 0, TCV_ZOOM_RECT_FLIP_H,
+                           TCV_ZOOM_MITCHELL);
+}
+
+static int clip_rect(TCVHandle handle, uint8_t *src, uint8_t *dest)
+{
+    return tcv_zoom_rect(handle, src + (10*WIDTH + 2), WIDTH, 708, 560,
+                         dest, 700, 1, 708, 560, 4, 6, 700, 550,
+                         TCV_ZOOM_RECT_FLIP_V, TCV_ZOOM_DEFAULT);
+}
+
+static int clip_rect_ref(TCVHandle handle, uint8_t *src, uint8_t *dest)
+{
+    return zoom_rect_steps(handle, src, dest, 1, 2, 10, 10, 6, 708, 560,
+                           4, 4, 6, 4, TCV_ZOOM_RECT_FLIP_V, TCV_ZOOM_BOX);
+}
+
+static const TestCase tests[] = {
+    { "zoom down",           zoom_down,           352 * 288 },
+    { "zoom up (RGB)",       zoom_up_rgb,         1280 * 720 * 3 },
+    { "zoom vertical",       zoom_vertical,       WIDTH * 480 },
+    { "zoom interlaced",     zoom_interlaced,     640 * 480 },
+    { "antialias",           antialias,           WIDTH * HEIGHT },
+    { "convert yuv->rgb",    yuv_to_rgb,          WIDTH * HEIGHT * 3 },
+    { "convert rgb->yuv",    rgb_to_yuv_in_place, WIDTH * HEIGHT },
+    { "convert yuy2->422p",  yuy2_to_yuv422p,     WIDTH * HEIGHT },
+    { "zoom rect",           zoom_rect,           600 * 440,
+                             zoom_rect_ref },
+    { "zoom rect vert (RGB)", zoom_rect_vertical_rgb, 700 * 400 * 3,
+                             zoom_rect_vertical_rgb_ref },
+    { "clip rect",           clip_rect,           700 * 550,
+                             clip_rect_ref },
+    { NULL, NULL, 0 }
+};
+
+/*************************************************************************/
+
+static int run_test(const TestCase *test, TCVHandle single, TCVHandle multi,
+                    uint8_t *src)
+{
+    uint8_t *ref = tc_zalloc(test->destsize);
+    uint8_t *res = tc_zalloc(test->destsize);
+    int ret = 1;
+
+    if (ref == NULL || res == NULL) {
+        tc_log_error(__FILE__, "%s: out of memory", test->name);
+    } else if (!(test->ref ? test->ref : test->run)(single, src, ref)
+            || !test->run(multi, src, res)) {
+        tc_log_error(__FILE__, "%s: FAILED (operation failed)", test->name);
+    } else if (memcmp(ref, res, test->destsize) != 0) {
+        int i;
+        for (i = 0; ref[i] == res[i]; i++)
+            ;
+        tc_log_error(__FILE__, "%s: FAILED (first difference at byte %i)",
+                     test->name, i);
+    } else {
+        tc_log_info(__FILE__, "%s: PASSED", test->name);
+        ret = 0;
+    }
+    free(ref);
+    free(res);
+    return ret;
+}
+
+int main(int argc, char *argv[])
+{
+    TCVHandle single = tcv_init(), multi = tcv_init();
+    uint8_t *src = tc_malloc(WIDTH * HEIGHT * 3);
+    int errors = 0, i = 0;
+
+    if (single == NULL || multi == NULL || src == NULL) {
+        tc_log_error(__FILE__, "initialization failed");
+        return 1;
+    }
+    ac_init(AC_ALL);
+    if (!tcv_set_threads(multi, THREADS)) {
+        tc_log_error(__FILE__, "tcv_set_threads() failed");
+        return 1;
+    }
+
+    srand(1);
+    for (i = 0; i < WIDTH * HEIGHT * 3; i++) {
+        /* smooth enough for antialiasing to kick in, with some noise */
+        src[i] = ((i % WIDTH) / 8 + (i / WIDTH) / 8) * 16 + (rand() & 3);
+    }
+
+    for (i = 0; tests[i].name != NULL; i++) {
+        errors += run_test(&tests[i], single, multi, src);
+    }
+
+    tcv_free(single);
+    tcv_free(multi);
+    free(src);
+    return (errors > 0) ?1 :0;
+}
+
+/*************************************************************************/
+
+/*
+ * Local variables:
+ *   c-file-style: "stroustrup"
+ *   c-file-offsets: ((case-label . *) (statement-case-intro . *))
+ *   indent-tabs-mode: nil
+ * End:
+ *
+ * vim: expandtab shiftwidth=4:
+ */
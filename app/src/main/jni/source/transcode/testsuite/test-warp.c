@@ -0,0 +1,216 @@
+/*
+ * test-warp.c -- testsuite for the warping of filter_transform: the
+ *                fixed-point kernels used for the inner part of each row
+ *                must agree with the floating point interpolate functions
+ *                (which are still used at the image border), and splitting
+ *                the rows over a worker pool must not change the result.
+ *
+ * This file is part of transcode, a video stream processing tool.
+ *
+ * transcode is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * transcode is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "config.h"
+
+/* Include filter_transform.c directly for access to the warp kernels */
+#include "../filter/stabilize/filter_transform.c"
+
+#define WIDTH   176
+#define HEIGHT  144
+#define THREADS 4
+
+int verbose = TC_QUIET;
+
+/* dependencies */
+vob_t *tc_get_vob(void) { return NULL; }
+int tc_filter_add(const char *name, const char *options) { return 0; }
+
+/*************************************************************************/
+
+typedef struct {
+    const char *name;
+    int interpoltype;
+    int bpp;
+    int tolerance;  /* maximum difference to the floating point result */
+} WarpTest;
+
+/* the float functions truncate where the kernels round, and the kernels
+ * use weights of WARP_WBITS bits, so they may be off by one or two */
+static const WarpTest tests[] = {
+    { "nearest neighbour", 0, 1, 0 },
+    { "bi-linear",         2, 1, 1 },
+    { "bi-cubic",          4, 1, 2 },
+    { "bi-linear RGB",     2, 3, 1 },
+    { NULL }
+};
+
+/* translation x,y, rotation and zoom (in percent) */
+static const Transform transforms[] = {
+    {  3.25, -2.5,  0.08,   0.0, 0 },
+    { -7.5,   4.75, -0.21,  6.0, 0 },
+    {  0.5,   0.5,  0.015, -9.0, 0 },
+    { 11.0,  -8.0,  0.5,   20.0, 0 },
+};
+#define NTRANSFORMS (sizeof(transforms) / sizeof(*transforms))
+
+/*************************************************************************/
+
+/* the plane transformYUV sets up for the luminance, with `bpp' channels */
+static void setup_plane(WarpPlane *p, Transform t, int bpp,
+                        const uint8_t *src, uint8_t *dst)
+{
+    float z = 1.0 - t.zoom / 100;
+    float zcos_a = z * cos(-t.alpha);
+    float zsin_a = z * sin(-t.alpha);
+
+    memset(p, 0, sizeof(*p));
+    p->src = src;
+    p->sw  = p->dw = WIDTH;
+    p->sh  = p->dh = HEIGHT;
+    p->dst = dst;
+    p->bpp = bpp;
+    p->x0  = -zcos_a * WIDTH/2 - zsin_a * HEIGHT/2 + WIDTH/2  - t.x;
+    p->y0  =  zsin_a * WIDTH/2 - zcos_a * HEIGHT/2 + HEIGHT/2 - t.y;
+    p->xx  =  zcos_a;
+    p->xy  =  zsin_a;
+    p->yx  = -zsin_a;
+    p->yy  =  zcos_a;
+    p->def = 16;
+}
+
+/* warpRows with the floating point functions for the whole row */
+static void warp_float(TransformData *td, const WarpPlane *p)
+{
+    int32_t dX = (int32_t)floor(p->xx * WARP_ONE + 0.5);
+    int32_t dY = (int32_t)floor(p->yx * WARP_ONE + 0.5);
+    int y;
+
+    for (y = 0; y < p->dh; y++) {
+        int64_t X = (int64_t)floor((p->x0 + y * p->xy) * WARP_ONE + 0.5);
+        int64_t Y = (int64_t)floor((p->y0 + y * p->yy) * WARP_ONE + 0.5);
+        warpBorder(td, p, p->dst + y * p->dw * p->bpp, X, Y, dX, dY,
+                   0, p->dw);
+    }
+}
+
+static int run_test(const WarpTest *test, TransformData *td,
+                    TCWorkers *workers, const uint8_t *src)
+{
+    int size = WIDTH * HEIGHT * test->bpp;
+    uint8_t *ref = tc_zalloc(size);
+    uint8_t *res = tc_zalloc(size);
+    uint8_t *thr = tc_zalloc(size);
+    int maxdiff = 0, i = 0, n = 0, ret = 1;
+    WarpPlane p;
+
+    if (ref == NULL || res == NULL || thr == NULL) {
+        tc_log_error(__FILE__, "%s: out of memory", test->name);
+        goto done;
+    }
+
+    td->interpoltype = test->interpoltype;
+    interpolate = (test->interpoltype == 0) ? interpolateZero
+                : (test->interpoltype == 2) ? interpolateBiLin
+                : interpolateBiCub;
+
+    for (n = 0; n < NTRANSFORMS; n++) {
+        setup_plane(&p, transforms[n], test->bpp, src, ref);
+        warp_float(td, &p);
+
+        p.dst = res;
+        td->workers = NULL;
+        runWarp(td, &p, 1);
+
+        p.dst = thr;
+        td->workers = workers;
+        runWarp(td, &p, 1);
+        td->workers = NULL;
+
+        for (i = 0; i < size; i++) {
+            maxdiff = TC_MAX(maxdiff, abs(ref[i] - res[i]));
+        }
+        if (maxdiff > test->tolerance) {
+            tc_log_error(__FILE__, "%s: FAILED (transform %i differs by %i"
+                         " from the floating point result)",
+                         test->name, n, maxdiff);
+            goto done;
+        }
+        if (memcmp(res, thr, size) != 0) {
+            for (i = 0; res[i] == thr[i]; i++)
+                ;
+            tc_log_error(__FILE__, "%s: FAILED (transform %i, threaded"
+                         " result differs at byte %i)", test->name, n, i);
+            goto done;
+        }
+    }
+    tc_log_info(__FILE__, "%s: PASSED (max difference %i)",
+                test->name, maxdiff);
+    ret = 0;
+
+  done:
+    free(ref);
+    free(res);
+    free(thr);
+    return ret;
+}
+
+/*************************************************************************/
+
+int main(int argc, char *argv[])
+{
+    TransformData *td = tc_zalloc(sizeof(TransformData));
+    TCWorkers *workers = tc_workers_new(THREADS);
+    uint8_t *src = tc_malloc(WIDTH * HEIGHT * 3);
+    int errors = 0, i = 0;
+
+    if (td == NULL || workers == NULL || src == NULL) {
+        tc_log_error(__FILE__, "initialization failed");
+        return 1;
+    }
+    td->crop = 1;
+    initBiCubWeights(td);
+
+    srand(1);
+    for (i = 0; i < WIDTH * HEIGHT * 3; i++) {
+        /* smooth, with some noise, and far enough from 0 and 255 for
+         * the bi-cubic overshoot not to wrap in the float functions */
+        src[i] = 128 + 80 * sin((i % WIDTH) / 7.0) * cos((i / WIDTH) / 5.0)
+                 + (rand() & 7);
+    }
+
+    for (i = 0; tests[i].name != NULL; i++) {
+        errors += run_test(&tests[i], td, workers, src);
+    }
+
+    tc_workers_del(workers);
+    free(src);
+    free(td);
+    return (errors > 0) ?1 :0;
+}
+
+/*************************************************************************/
+
+/*
+ * Local variables:
+ *   c-file-style: "stroustrup"
+ *   c-file-offsets: ((case-label . *) (statement-case-intro . *))
+ *   indent-tabs-mode: nil
+ * End:
+ *
+ * vim: expandtab shiftwidth=4:
+ */
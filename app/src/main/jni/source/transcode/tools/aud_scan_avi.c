@@ -65,15 +65,31 @@ int sync_audio_video_avi2avi (double vid_ms, double *aud_ms, avi_t *in, avi_t *o
     if (tc_format_ms_supported(format)) {
 
 	while (*aud_ms < vid_ms) {
+	    long chunk = AVI_get_audio_position_index(in);
 
-	    if( (bytes = AVI_read_audio_chunk(in, data)) < 0) {
+	    if( (bytes = AVI_read_audio_chunk(in, NULL)) < 0) {
 		AVI_print_error("AVI audio read frame");
 		//*aud_ms = vid_ms;
 		return(-2);
 	    }
 	    //fprintf(stderr, "len (%ld)\n", bytes);
 
-	    if(AVI_write_audio(out, data, bytes)<0) {
+	    // the data is copied file to file, only vbr needs to look at it.
+	    // The whole chunk is read, keep just the part not consumed yet.
+	    if (vbr && bytes > 0) {
+		long len = AVI_audio_size(in, chunk);
+
+		if (len < bytes
+		 || AVI_read_audio_chunk_at(in, AVI_get_audio_track(in), chunk,
+		                            data, 48000*16*4) != len) {
+		    AVI_print_error("AVI audio read frame");
+		    return(-2);
+		}
+		if (len > bytes)
+		    memmove(data, data + len - bytes, bytes);
+	    }
+
+	    if(AVI_copy_audio_chunk(out, in)<0) {
 		AVI_print_error("AVI write audio frame");
 		return(-1);
 	    }
@@ -102,12 +118,12 @@ int sync_audio_video_avi2avi (double vid_ms, double *aud_ms, avi_t *in, avi_t *o
     } else { // fallback for not supported audio format
 
 	do {
-	    if ( (bytes = AVI_read_audio_chunk(in, data) ) < 0) {
+	    if ( (bytes = AVI_read_audio_chunk(in, NULL) ) < 0) {
 		AVI_print_error("AVI audio read frame");
 		return -2;
 	    }
 
-	    if(AVI_write_audio(out, data, bytes)<0) {
+	    if(AVI_copy_audio_chunk(out, in)<0) {
 		AVI_print_error("AVI write audio frame");
 		return(-1);
 	    }
@@ -62,6 +62,9 @@ static void usage(int status)
   printf("    -n        read index in \"smart\" mode: don't use the existing index\n");
   printf("    -x        don't use the existing index to generate the keyframes\n");
   printf("              this flag forces -n\n");
+  printf("    -t n      scan with n threads when rebuilding the index [CPUs]\n");
+  printf("    -c file   write a binary index cache to file and exit\n");
+  printf("              (for AVI_open_input_file_cached)\n");
   printf("    -v        print version\n");
   exit(status);
 }
@@ -122,7 +125,7 @@ static int avi_stream_nr(int id)
     return 0;
 }
 
-const int LEN=10;
+#define LEN 10
 
 typedef enum {
     UNKNOWN = 0,
@@ -240,166 +243,6 @@ static int mpidx1_to_aviidx1(char *in_file, FILE *out_fd)
     return 0;
 }
 
-// data is only 8 bytes long
-static int AVI_read_data_fast(avi_t *AVI, char *buf, off_t *pos, off_t *len, off_t *key, char *data)
-{
-
-/*
- * Return codes:
- *
- *    0 = reached EOF
- *    1 = video data read
- *    2 = audio data read from track 0
- *    3 = audio data read from track 1
- *    4 = audio data read from track 2
- *    ....
- *   10 = traditional idx1 chunk
- */
-
-   off_t n;
-   int rlen;
-   *key=(off_t)0;
-
-   if(AVI->mode==AVI_MODE_WRITE) return 0;
-
-   while(1)
-   {
-      /* Read tag and length */
-
-      if( xio_read(AVI->fdes,data,8) != 8 ) return 0;
-
-      n = PAD_EVEN(str2ulong(data+4));
-
-      if(strncasecmp(data,"LIST",4) == 0 ||
-	 strncasecmp(data,"RIFF",4) == 0) { // prevents skipping extended RIFF chunks
-	  if( xio_read(AVI->fdes,data,4) != 4 ) return 0;
-	  n -= 4;
-	  // put here tags of lists that need to be looked into
-	  if(strncasecmp(data,"movi",4) == 0 ||
-	     strncasecmp(data,"rec ",4) == 0 ||
-	     strncasecmp(data,"AVI ",4) == 0 ||
-	     strncasecmp(data,"AVIX",4) == 0) {
-	    // xio_lseek(AVI->fdes,-4,SEEK_CUR);
-	    continue; // proceed to look into it
-	  } // otherwise seek over it later on
-      }
-
-      // the following list of comparisons should not include list tags;
-      // these should all go in the list above
-      if(strncasecmp(data,"IDX1",4) == 0)
-      {
-	 // deal with it to extract keyframe info
-         *len = str2ulong(data+4);
-	 *pos = xio_lseek(AVI->fdes, 0, SEEK_CUR)-(off_t)8;
-	 //fprintf (stderr, "Found an index chunk at %lld len %lld\n", *pos, *len);
-         if(xio_lseek(AVI->fdes,n,SEEK_CUR)==(off_t)-1)  return 0;
-	 return 10;
-      }
-
-      if(strncasecmp(data,AVI->video_tag,3) == 0)
-      {
-         *len = str2ulong(data+4);
-	 *pos = xio_lseek(AVI->fdes, 0, SEEK_CUR)-(off_t)8;
-         AVI->video_pos++;
-	 rlen = n;
-	 xio_read(AVI->fdes, buf, rlen);
-         if(xio_lseek(AVI->fdes,n-rlen,SEEK_CUR)==(off_t)-1)  return 0;
-         return 1;
-      }
-      else if(AVI->anum>=1 && strncasecmp(data,AVI->track[0].audio_tag,4) == 0)
-      {
-         *len = str2ulong(data+4);
-	 *pos = xio_lseek(AVI->fdes, 0, SEEK_CUR)-(off_t)8;
-	 AVI->track[0].audio_posc++;
-	 rlen = (n<LEN)?n:LEN;
-	 xio_read(AVI->fdes, buf, rlen);
-         if(xio_lseek(AVI->fdes,n-rlen,SEEK_CUR)==(off_t)-1)  return 0;
-         return 2;
-         break;
-      }
-      else if(AVI->anum>=2 && strncasecmp(data,AVI->track[1].audio_tag,4) == 0)
-      {
-         *len = str2ulong(data+4);
-	 *pos = xio_lseek(AVI->fdes, 0, SEEK_CUR)-(off_t)8;
-	 AVI->track[1].audio_posc++;
-	 rlen = (n<LEN)?n:LEN;
-	 xio_read(AVI->fdes, buf, rlen);
-         if(xio_lseek(AVI->fdes,n-rlen,SEEK_CUR)==(off_t)-1)  return 0;
-         return 3;
-         break;
-      }
-      else if(AVI->anum>=3 && strncasecmp(data,AVI->track[2].audio_tag,4) == 0)
-      {
-         *len = str2ulong(data+4);
-	 *pos = xio_lseek(AVI->fdes, 0, SEEK_CUR)-(off_t)8;
-	 AVI->track[2].audio_posc++;
-	 rlen = (n<LEN)?n:LEN;
-	 xio_read(AVI->fdes, buf, rlen);
-         if(xio_lseek(AVI->fdes,n-rlen,SEEK_CUR)==(off_t)-1)  return 0;
-         return 4;
-         break;
-      }
-      else if(AVI->anum>=4 && strncasecmp(data,AVI->track[3].audio_tag,4) == 0)
-      {
-         *len = str2ulong(data+4);
-	 *pos = xio_lseek(AVI->fdes, 0, SEEK_CUR)-(off_t)8;
-	 AVI->track[3].audio_posc++;
-	 rlen = (n<LEN)?n:LEN;
-	 xio_read(AVI->fdes, buf, rlen);
-         if(xio_lseek(AVI->fdes,n-rlen,SEEK_CUR)==(off_t)-1)  return 0;
-         return 5;
-         break;
-      }
-      else if(AVI->anum>=5 && strncasecmp(data,AVI->track[4].audio_tag,4) == 0)
-      {
-         *len = str2ulong(data+4);
-	 *pos = xio_lseek(AVI->fdes, 0, SEEK_CUR)-(off_t)8;
-	 AVI->track[4].audio_posc++;
-	 rlen = (n<LEN)?n:LEN;
-	 xio_read(AVI->fdes, buf, rlen);
-         if(xio_lseek(AVI->fdes,n-rlen,SEEK_CUR)==(off_t)-1)  return 0;
-         return 6;
-         break;
-      }
-      else if(AVI->anum>=6 && strncasecmp(data,AVI->track[5].audio_tag,4) == 0)
-      {
-         *len = str2ulong(data+4);
-	 *pos = xio_lseek(AVI->fdes, 0, SEEK_CUR)-(off_t)8;
-	 AVI->track[5].audio_posc++;
-	 rlen = (n<LEN)?n:LEN;
-	 xio_read(AVI->fdes, buf, rlen);
-         if(xio_lseek(AVI->fdes,n-rlen,SEEK_CUR)==(off_t)-1)  return 0;
-         return 7;
-         break;
-      }
-      else if(AVI->anum>=7 && strncasecmp(data,AVI->track[6].audio_tag,4) == 0)
-      {
-         *len = str2ulong(data+4);
-	 *pos = xio_lseek(AVI->fdes, 0, SEEK_CUR)-(off_t)8;
-	 AVI->track[6].audio_posc++;
-	 rlen = (n<LEN)?n:LEN;
-	 xio_read(AVI->fdes, buf, rlen);
-         if(xio_lseek(AVI->fdes,n-rlen,SEEK_CUR)==(off_t)-1)  return 0;
-         return 8;
-         break;
-      }
-      else if(AVI->anum>=8 && strncasecmp(data,AVI->track[7].audio_tag,4) == 0)
-      {
-         *len = str2ulong(data+4);
-	 *pos = xio_lseek(AVI->fdes, 0, SEEK_CUR)-(off_t)8;
-	 AVI->track[7].audio_posc++;
-	 rlen = (n<LEN)?n:LEN;
-	 xio_read(AVI->fdes, buf, rlen);
-         if(xio_lseek(AVI->fdes,n-rlen,SEEK_CUR)==(off_t)-1)  return 0;
-         return 9;
-         break;
-      } else {
-	  if(xio_lseek(AVI->fdes,n,SEEK_CUR)==(off_t)-1)  return 0;
-      }
-      // else if(xio_lseek(AVI->fdes,n,SEEK_CUR)==(off_t)-1)  return 0;
-   }
-}
-
 static int is_key(unsigned char *data, long size, char *codec)
 {
     if (strncasecmp(codec, "div3", 4) == 0) {
@@ -434,6 +277,463 @@ static int is_key(unsigned char *data, long size, char *codec)
 }
 
 
+/*************************************************************************/
+
+/*
+ * Index rebuild. The file, from the start of the movi list on, is cut
+ * into byte ranges scanned by one thread each. A scanner walks the chunk
+ * chain the way a sequential reader would: into RIFF AVI/AVIX and LIST
+ * movi/rec lists, over everything else. Scanners but the first don't
+ * start on a chunk header, so they first look for a stream chunk header
+ * followed by a few plausible ones (resynchronisation), as the walk does
+ * after a damaged header. A scanner goes on a little past the end of its
+ * range, up to the first stream chunk there: the handoff position.
+ * Since the walk from a given header is always the same, the chunks of
+ * the next range are taken from that position on; if the next scanner
+ * never got there (it synchronised on payload data), that range is
+ * walked again from the handoff position.
+ */
+
+#define SCAN_RANGE_MIN  (16*1024*1024)  /* don't cut ranges smaller */
+#define SCAN_BUFSIZE    (4*1024*1024)   /* read window of a scanner */
+#define SCAN_SYNC       3               /* headers in a row to resync */
+
+enum {
+    SCAN_SKIP = 0,          /* chunk to step over */
+    SCAN_LIST = -1,         /* RIFF or LIST */
+};
+
+typedef struct {
+    off_t   pos;            /* of the chunk header */
+    off_t   len;            /* payload length */
+    int     type;           /* 1 video, 2.. audio track 0.., 10 idx1 */
+    int     key;
+    char    tag[4];
+    char    head[LEN];      /* audio: first payload bytes */
+} scan_entry_t;
+
+typedef struct {
+    scan_entry_t *ents;
+    long    n;
+    long    size;
+} scan_list_t;
+
+typedef struct scan_ctx_ scan_ctx_t;
+
+typedef struct {
+    scan_ctx_t *ctx;
+    pthread_t thread;
+    int     fd;
+    off_t   start, end;     /* the range */
+    int     resync;         /* start isn't known to be a chunk header */
+
+    char   *buf;            /* read window */
+    off_t   buf_pos;
+    long    buf_len;
+    long    buf_size;
+
+    scan_list_t list;
+    off_t   handoff;        /* first stream chunk past end, -1 if none */
+    int     failed;
+} scan_range_t;
+
+struct scan_ctx_ {
+    avi_t  *avi;            /* tags, read only */
+    char   *codec;
+    const char *file;
+    off_t   file_size;
+
+    pthread_mutex_t lock;   /* the progress below */
+    off_t   scanned;
+    int     progress;
+};
+
+static int scan_list_add(scan_list_t *list, const scan_entry_t *ent)
+{
+    if (list->n == list->size) {
+        long size = (list->size) ?list->size * 2 :4096;
+        scan_entry_t *ents = realloc(list->ents, size * sizeof(scan_entry_t));
+        if (ents == NULL)
+            return -1;
+        list->ents = ents;
+        list->size = size;
+    }
+    list->ents[list->n++] = *ent;
+    return 0;
+}
+
+static void scan_progress(scan_range_t *sc, long bytes)
+{
+    scan_ctx_t *ctx = sc->ctx;
+    int progress;
+
+    pthread_mutex_lock(&ctx->lock);
+    ctx->scanned += bytes;
+    progress = (int)(ctx->scanned * 100 / ctx->file_size);
+    if (progress > 100)
+        progress = 100;
+    if (progress != ctx->progress) {
+        fprintf(stderr, "[%s] Scanning ... %d%%\r", EXE, progress);
+        ctx->progress = progress;
+    }
+    pthread_mutex_unlock(&ctx->lock);
+}
+
+/*
+ * `len' bytes at file offset `pos' out of the read window, moving the
+ * window if needed; *got tells how many there are (less at the end of
+ * the file). Returns NULL if there is nothing at all.
+ */
+static const char *scan_data(scan_range_t *sc, off_t pos, long len,
+                             long *got)
+{
+    off_t end = pos + len;
+    ssize_t n;
+
+    if (end > sc->ctx->file_size)
+        end = sc->ctx->file_size;
+    if (pos >= end)
+        return NULL;
+    len = (long)(end - pos);
+
+    if (pos < sc->buf_pos || end > sc->buf_pos + sc->buf_len) {
+        if (len > sc->buf_size) {
+            char *buf = realloc(sc->buf, len);
+            if (buf == NULL) {
+                sc->failed = 1;
+                return NULL;
+            }
+            sc->buf = buf;
+            sc->buf_size = len;
+        }
+        sc->buf_pos = pos;
+        sc->buf_len = 0;
+        if (xio_lseek(sc->fd, pos, SEEK_SET) != pos)
+            return NULL;
+        n = xio_read(sc->fd, sc->buf, sc->buf_size);
+        if (n <= 0)
+            return NULL;
+        sc->buf_len = n;
+        if (pos >= sc->start && pos < sc->end)
+            scan_progress(sc, n);
+        if (end > pos + n)
+            end = pos + n;
+    }
+    *got = (long)(end - pos);
+    return sc->buf + (pos - sc->buf_pos);
+}
+
+/* what to do with the chunk with header `hdr', as AVI_read_data_fast did */
+static int scan_chunk_type(avi_t *avi, const char *hdr)
+{
+    int j;
+
+    if (strncasecmp(hdr, "LIST", 4) == 0 || strncasecmp(hdr, "RIFF", 4) == 0)
+        return SCAN_LIST;
+    if (strncasecmp(hdr, "IDX1", 4) == 0)
+        return 10;
+    if (strncasecmp(hdr, avi->video_tag, 3) == 0)
+        return 1;
+    for (j = 0; j < avi->anum && j < 8; j++) {
+        if (strncasecmp(hdr, avi->track[j].audio_tag, 4) == 0)
+            return j + 2;
+    }
+    return SCAN_SKIP;
+}
+
+static int scan_fourcc_ok(const char *hdr)
+{
+    int i;
+
+    for (i = 0; i < 4; i++) {
+        if (hdr[i] < 0x20 || hdr[i] > 0x7e)
+            return 0;
+    }
+    return 1;
+}
+
+/* position of the chunk following the one at `pos', -1 if there is none */
+static off_t scan_next(scan_range_t *sc, off_t pos, const char *hdr)
+{
+    off_t n = PAD_EVEN(str2ulong((unsigned char *)hdr + 4));
+    const char *type = NULL;
+    long got = 0;
+
+    if (scan_chunk_type(sc->ctx->avi, hdr) == SCAN_LIST) {
+        type = scan_data(sc, pos + 8, 4, &got);
+        if (type == NULL || got < 4)
+            return -1;
+        // put here tags of lists that need to be looked into
+        if (strncasecmp(type, "movi", 4) == 0
+         || strncasecmp(type, "rec ", 4) == 0
+         || strncasecmp(type, "AVI ", 4) == 0
+         || strncasecmp(type, "AVIX", 4) == 0)
+            return pos + 12;
+    }
+    return pos + 8 + n;
+}
+
+/*
+ * first position at or after `pos' that looks like a stream chunk
+ * followed by plausible chunks, -1 if there is none.
+ */
+static off_t scan_resync(scan_range_t *sc, off_t pos)
+{
+    const char *hdr = NULL;
+    off_t p, next;
+    long got = 0;
+    int i;
+
+    for (pos = PAD_EVEN(pos); pos < sc->ctx->file_size; pos += 2) {
+        hdr = scan_data(sc, pos, 8, &got);
+        if (hdr == NULL || got < 8)
+            return -1;
+        if (scan_chunk_type(sc->ctx->avi, hdr) <= SCAN_SKIP)
+            continue;
+
+        p = pos;
+        for (i = 1; i < SCAN_SYNC; i++) {
+            next = scan_next(sc, p, hdr);
+            if (next == sc->ctx->file_size)
+                break;              /* the chain ends right at the end */
+            if (next < 0 || next + 8 > sc->ctx->file_size)
+                break;
+            hdr = scan_data(sc, next, 8, &got);
+            if (hdr == NULL || got < 8 || !scan_fourcc_ok(hdr))
+                break;
+            p = next;
+        }
+        if (i == SCAN_SYNC || next == sc->ctx->file_size)
+            return pos;
+    }
+    return -1;
+}
+
+/* walk the chunks from `pos' on, see the comment above */
+static void scan_walk(scan_range_t *sc, off_t pos)
+{
+    scan_ctx_t *ctx = sc->ctx;
+    scan_entry_t ent;
+    const char *hdr = NULL, *data = NULL;
+    long got = 0;
+
+    sc->handoff = -1;
+
+    while (pos >= 0) {
+        hdr = scan_data(sc, pos, 8, &got);
+        if (hdr == NULL || got < 8)
+            return;
+        if (!scan_fourcc_ok(hdr)) {
+            /* damaged, look for the next good chunk */
+            pos = scan_resync(sc, pos + 2);
+            continue;
+        }
+
+        memset(&ent, 0, sizeof(ent));
+        ent.type = scan_chunk_type(ctx->avi, hdr);
+        if (ent.type <= SCAN_SKIP) {
+            pos = scan_next(sc, pos, hdr);
+            continue;
+        }
+        ent.len = str2ulong((unsigned char *)hdr + 4);
+        if (ent.type != 10 && pos + 8 + ent.len > ctx->file_size) {
+            /* cut short or a bogus length: skip it, like a damaged one */
+            pos = scan_resync(sc, pos + 2);
+            continue;
+        }
+        if (pos >= sc->end) {
+            sc->handoff = pos;
+            return;
+        }
+
+        memcpy(ent.tag, hdr, 4);
+        ent.pos = pos;
+        if (ent.type == 1) {
+            unsigned char none[4] = { 0 };
+            /* the keyframe check only needs the start of the frame */
+            data = scan_data(sc, pos + 8,
+                             (ent.len < SCAN_BUFSIZE) ?ent.len :SCAN_BUFSIZE,
+                             &got);
+            if (data != NULL)
+                ent.key = is_key((unsigned char *)data, got, ctx->codec);
+            else
+                ent.key = is_key(none, 0, ctx->codec);
+        } else if (ent.type != 10) {
+            data = scan_data(sc, pos + 8, (ent.len < LEN) ?ent.len :LEN, &got);
+            if (data != NULL)
+                memcpy(ent.head, data, got);
+        }
+        if (scan_list_add(&sc->list, &ent) < 0) {
+            sc->failed = 1;
+            return;
+        }
+        pos += 8 + PAD_EVEN(ent.len);
+    }
+}
+
+static void *scan_thread(void *arg)
+{
+    scan_range_t *sc = arg;
+    off_t pos = sc->start;
+
+    if (sc->resync)
+        pos = scan_resync(sc, pos);
+    if (pos >= 0 && pos < sc->end)
+        scan_walk(sc, pos);
+    else
+        sc->handoff = pos;
+    return NULL;
+}
+
+static int scan_range_init(scan_range_t *sc, scan_ctx_t *ctx,
+                           off_t start, off_t end, int resync)
+{
+    memset(sc, 0, sizeof(*sc));
+    sc->ctx    = ctx;
+    sc->start  = start;
+    sc->end    = end;
+    sc->resync = resync;
+    sc->buf_size = SCAN_BUFSIZE;
+    sc->buf    = malloc(sc->buf_size);
+    sc->fd     = xio_open(ctx->file, O_RDONLY);
+    if (sc->buf == NULL || sc->fd < 0) {
+        free(sc->buf);
+        if (sc->fd >= 0)
+            xio_close(sc->fd);
+        return -1;
+    }
+    return 0;
+}
+
+static void scan_range_fini(scan_range_t *sc)
+{
+    free(sc->buf);
+    free(sc->list.ents);
+    xio_close(sc->fd);
+}
+
+/* index of the entry at `pos' in `list', -1 if there is none */
+static long scan_list_find(const scan_list_t *list, off_t pos)
+{
+    long lo = 0, hi = list->n - 1, mid;
+
+    while (lo <= hi) {
+        mid = (lo + hi) / 2;
+        if (list->ents[mid].pos == pos)
+            return mid;
+        if (list->ents[mid].pos < pos)
+            lo = mid + 1;
+        else
+            hi = mid - 1;
+    }
+    return -1;
+}
+
+static int scan_list_append(scan_list_t *list, const scan_list_t *from,
+                            long first)
+{
+    long i;
+
+    for (i = first; i < from->n; i++) {
+        if (scan_list_add(list, &from->ents[i]) < 0)
+            return -1;
+    }
+    return 0;
+}
+
+/*
+ * find the chunks of `avi' (opened without index) with `threads'
+ * threads, in file order, into `list'. Returns 0 on success.
+ */
+static int scan_file(avi_t *avi, const char *file, off_t size, int threads,
+                     scan_list_t *list)
+{
+    scan_ctx_t ctx;
+    scan_range_t *ranges = NULL, walk;
+    off_t start = avi->movi_start, step, cur = 0;
+    int n, k, ret = -1;
+    long i;
+
+    memset(&ctx, 0, sizeof(ctx));
+    ctx.avi       = avi;
+    ctx.codec     = AVI_video_compressor(avi);
+    ctx.file      = file;
+    ctx.file_size = size;
+    ctx.progress  = -1;
+    pthread_mutex_init(&ctx.lock, NULL);
+
+    if (threads < 1)
+        threads = 1;
+    step = (size - start) / threads;
+    if (step < SCAN_RANGE_MIN)
+        step = SCAN_RANGE_MIN;
+    step = PAD_EVEN(step);
+    n = (int)((size - start + step - 1) / step);
+    if (n < 1)
+        n = 1;
+
+    ranges = calloc(n, sizeof(scan_range_t));
+    if (ranges == NULL)
+        goto done;
+    for (k = 0; k < n; k++) {
+        off_t from = start + k * step;
+        off_t to   = (k == n - 1) ?size :from + step;
+        if (scan_range_init(&ranges[k], &ctx, from, to, k > 0) < 0) {
+            while (k-- > 0)
+                scan_range_fini(&ranges[k]);
+            goto done;
+        }
+    }
+
+    for (k = 0; k < n; k++) {
+        if (pthread_create(&ranges[k].thread, NULL, scan_thread, &ranges[k]) != 0) {
+            ranges[k].failed = 1;
+            scan_thread(&ranges[k]);
+        }
+    }
+    for (k = 0; k < n; k++) {
+        if (!ranges[k].failed)
+            pthread_join(ranges[k].thread, NULL);
+    }
+
+    /* stitch the ranges together at the handoff positions */
+    for (k = 0; k < n; k++) {
+        if (ranges[k].failed)
+            goto fini;
+    }
+    cur = -1;
+    for (k = 0; k < n; k++) {
+        if (k > 0 && cur < 0)
+            break;
+        i = (k == 0) ?0 :scan_list_find(&ranges[k].list, cur);
+        if (i >= 0) {
+            if (scan_list_append(list, &ranges[k].list, i) < 0)
+                goto fini;
+            cur = ranges[k].handoff;
+            continue;
+        }
+        /* range k lost the thread, walk it again */
+        if (scan_range_init(&walk, &ctx, ranges[k].start, ranges[k].end, 0) < 0)
+            goto fini;
+        scan_walk(&walk, cur);
+        if (walk.failed || scan_list_append(list, &walk.list, 0) < 0) {
+            scan_range_fini(&walk);
+            goto fini;
+        }
+        cur = walk.handoff;
+        scan_range_fini(&walk);
+    }
+    ret = 0;
+
+  fini:
+    for (k = 0; k < n; k++)
+        scan_range_fini(&ranges[k]);
+  done:
+    free(ranges);
+    pthread_mutex_destroy(&ctx.lock);
+    return ret;
+}
+
 int main(int argc, char *argv[])
 {
 
@@ -451,7 +751,7 @@ int main(int argc, char *argv[])
   long i=0, chunk=0;
 
   int ch;
-  int progress=0, old_progress=0;
+  int threads=0;
 
   long rate;
   int format, chan, bits;
@@ -460,6 +760,7 @@ int main(int argc, char *argv[])
   FILE *out_fd    = NULL;
   int open_without_index=0,index_keyframes=0;
   int force_with_index=0;
+  const char *cache_file = NULL;
 
   double vid_ms = 0.0, print_ms = 0.0;
   double aud_ms [ AVI_MAX_TRACKS ];
@@ -468,7 +769,7 @@ int main(int argc, char *argv[])
   int vid_chunks=0, aud_chunks[AVI_MAX_TRACKS];
   off_t pos, len, key=0, index_pos=0, index_len=0,size=0;
   struct stat st;
-  char *codec;
+  scan_list_t chunks = { NULL, 0, 0 };
   int idx_type=0;
   off_t ioff;
   char fcclen[8]; // FOURCC + len
@@ -485,7 +786,7 @@ int main(int argc, char *argv[])
     aud_ms[i] = 0;
   }
 
-  while ((ch = getopt(argc, argv, "a:vi:o:nxf?h")) != -1)
+  while ((ch = getopt(argc, argv, "a:c:vi:o:nxft:?h")) != -1)
     {
 
 	switch (ch) {
@@ -530,6 +831,20 @@ int main(int argc, char *argv[])
 	    force_with_index=1;
 	    break;
 
+	case 't':
+
+	    if(optarg[0]=='-') usage(EXIT_FAILURE);
+	    threads = atoi(optarg);
+
+	    break;
+
+	case 'c':
+
+	    if(optarg[0]=='-') usage(EXIT_FAILURE);
+	    cache_file=optarg;
+
+	    break;
+
 	case 'v':
 	    version();
 	    exit(0);
@@ -543,6 +858,7 @@ int main(int argc, char *argv[])
 
   // check
   if(in_file==NULL) usage(EXIT_FAILURE);
+  if (threads <= 0) threads = sysconf(_SC_NPROCESSORS_ONLN);
   if (!out_file) out_fd = stdout;
   else out_fd = fopen(out_file, "w+r");
 
@@ -569,6 +885,18 @@ int main(int argc, char *argv[])
       default:      fprintf(stderr, "[%s] Unrecognized format\n", EXE); return (1);
   }
 
+  if (cache_file) {
+      fprintf(stderr, "[%s] Writing index cache \"%s\"\n", EXE, cache_file);
+      if(NULL == (avifile1 = AVI_open_input_file(in_file,1))) {
+	  AVI_print_error("AVI open input file");
+	  return 1;
+      }
+      ret = AVI_write_index_cache(avifile1, cache_file);
+      if (ret < 0) AVI_print_error("AVI write index cache");
+      AVI_close(avifile1);
+      return (ret < 0) ?1 :0;
+  }
+
 
   // if file is larger than 2GB, regen index
 
@@ -604,16 +932,24 @@ int main(int argc, char *argv[])
     aud_tracks = frames = 0;
     frames = AVI_video_frames(avifile1);
     fps    = AVI_frame_rate  (avifile1);
-    codec  = AVI_video_compressor(avifile1);
 
     aud_tracks = AVI_audio_tracks(avifile1);
     //printf("frames (%ld), aud_tracks (%d)\n", frames, aud_tracks);
 
-    pos = key = len = (off_t)0;
-    i = 0;
+    if (scan_file(avifile1, in_file, size, threads, &chunks) < 0) {
+      fprintf(stderr, "[%s] Scanning \"%s\" failed\n", EXE, in_file);
+      exit(1);
+    }
 
-    while ( (ret = AVI_read_data_fast (avifile1, data, &pos, &len, &key, fcclen)) != 0) {
-      int audtr = ret-2;
+    for (i = 0; i < chunks.n; i++) {
+      scan_entry_t *ent = &chunks.ents[i];
+      int audtr;
+
+      ret = ent->type;
+      pos = ent->pos;
+      len = ent->len;
+      key = ent->key;
+      audtr = ret-2;
 
       /* don't need this and it saves time
        * */
@@ -628,7 +964,7 @@ int main(int argc, char *argv[])
 
 	  aud_bitrate = format==0x1?1:0;
 
-	  if (!aud_bitrate && tc_get_audio_header(data, LEN, format, NULL, NULL, &aud_bitrate)<0) {
+	  if (!aud_bitrate && tc_get_audio_header((unsigned char *)ent->head, LEN, format, NULL, NULL, &aud_bitrate)<0) {
 	    aud_ms[audtr] = vid_ms;
 	  } else
 	    aud_ms[audtr] += (len*8.0)/(format==0x1?((double)(rate*chan*bits)/1000.0):aud_bitrate);
@@ -636,16 +972,17 @@ int main(int argc, char *argv[])
       }
 
       switch (ret) {
-	case 1: ac_memcpy(tag, fcclen, 4);
+	case 1: ac_memcpy(tag, ent->tag, 4);
+		avifile1->video_pos++;
 		print_ms = vid_ms = (avifile1->video_pos)*1000.0/fps;
 		chunk = avifile1->video_pos;
-		key = is_key(data, len, codec);
 		break;
 	case 2: case 3:
 	case 4: case 5:
 	case 6: case 7:
 	case 8:
-	case 9: ac_memcpy(tag, fcclen, 4);
+	case 9: ac_memcpy(tag, ent->tag, 4);
+		avifile1->track[audtr].audio_posc++;
 		print_ms = aud_ms[audtr];
 		chunk = avifile1->track[audtr].audio_posc;
 		break;
@@ -669,17 +1006,9 @@ int main(int argc, char *argv[])
               tag, ret, i, chunk-1,
               (long long)pos, (long long)len, (long long)key,
               print_ms);
-      i++;
-
-      // don't update the counter every chunk
-      progress = (int)(pos*100/size)+1;
-      if (old_progress != progress) {
-	  fprintf(stderr, "[%s] Scanning ... %d%%\r", EXE, progress);
-	  old_progress = progress;
-      }
-
     }
     fprintf(stderr, "\n");
+    free(chunks.ents);
 
     // check if we have found an index chunk to restore keyframe info
     if (!index_pos || !index_len || index_keyframes)
@@ -60,7 +60,8 @@ static void usage(int status)
     exit(status);
 }
 
-static char data[SIZE_RGB_FRAME];
+/* one MP3/AC3 frame (< 4k) at a time, video never passes through memory */
+static char data[8192];
 static char *comfile = NULL;
 static char *indexfile = NULL;
 long sum_frames = 0;
@@ -71,8 +72,8 @@ int drop_video=0;
 static int merger(avi_t *out, char *file)
 {
     avi_t *in;
-    long frames, n, bytes;
-    int key, j, aud_tracks;
+    long frames, n;
+    int j, aud_tracks;
     static int init = 0;
     static int vid_chunks = 0;
 
@@ -95,8 +96,9 @@ static int merger(avi_t *out, char *file)
 	    AVI_print_error("AVI open with indexfile");
 	    return(-1);
 	}
+	AVI_enable_mmap(in);
     }
-    else if(NULL == (in = AVI_open_input_file(file,1))) {
+    else if(NULL == (in = AVI_open_input_file_mmap(file,1))) {
 	AVI_print_error("AVI open");
 	return(-1);
     }
@@ -144,16 +146,9 @@ static int merger(avi_t *out, char *file)
 	  goto out;
       }
 
-      // video
-      bytes = AVI_read_frame(in, data, &key);
-
-      if(bytes < 0) {
-	AVI_print_error("AVI read video frame");
-	return(-1);
-      }
-
-      if(AVI_write_frame(out, data, bytes, key)<0) {
-	AVI_print_error("AVI write video frame");
+      // video, copied without passing through memory
+      if(AVI_copy_frame(out, in, n)<0) {
+	AVI_print_error("AVI copy video frame");
 	return(-1);
       }
 
@@ -186,9 +181,7 @@ int main(int argc, char *argv[])
 
   char *codec;
 
-  long offset, frames, n, bytes, aud_offset=0;
-
-  int key;
+  long offset, frames, n, aud_offset=0;
 
   int aud_tracks;
 
@@ -471,16 +464,9 @@ int main(int argc, char *argv[])
 
   for (n=0; n<frames; ++n) {
 
-    // video
-    bytes = AVI_read_frame(avifile1, data, &key);
-
-    if(bytes < 0) {
-      AVI_print_error("AVI read video frame");
-      return(-1);
-    }
-
-    if(AVI_write_frame(avifile, data, bytes, key)<0) {
-      AVI_print_error("AVI write video frame");
+    // video, copied without passing through memory
+    if(AVI_copy_frame(avifile, avifile1, n)<0) {
+      AVI_print_error("AVI copy video frame");
       return(-1);
     }
     ++vid_chunks;
@@ -538,16 +524,9 @@ int main(int argc, char *argv[])
 
     for (n=0; n<frames; ++n) {
 
-      // video
-      bytes = AVI_read_frame(avifile1, data, &key);
-
-      if(bytes < 0) {
-	AVI_print_error("AVI read video frame");
-	return(-1);
-      }
-
-      if(AVI_write_frame(avifile, data, bytes, key)<0) {
-	AVI_print_error("AVI write video frame");
+      // video, copied without passing through memory
+      if(AVI_copy_frame(avifile, avifile1, n)<0) {
+	AVI_print_error("AVI copy video frame");
 	return(-1);
       }
 
@@ -630,16 +609,9 @@ merge_mp3:
 
   for (n=0; n<frames; ++n) {
 
-    // video
-    bytes = AVI_read_frame(avifile1, data, &key);
-
-    if(bytes < 0) {
-      AVI_print_error("AVI read video frame");
-      return(-1);
-    }
-
-    if(AVI_write_frame(avifile, data, bytes, key)<0) {
-      AVI_print_error("AVI write video frame");
+    // video, copied without passing through memory
+    if(AVI_copy_frame(avifile, avifile1, n)<0) {
+      AVI_print_error("AVI copy video frame");
       return(-1);
     }
 
@@ -673,10 +645,12 @@ merge_mp3:
 	  break;
 	}
 
-	if ( (headlen = tc_get_audio_header(head, len, format_add, NULL, NULL, &mp3rate_i))<0) {
+	if ( (headlen = tc_get_audio_header(head, len, format_add, NULL, NULL, &mp3rate_i))<0
+	     || headlen > (int)sizeof(data)) {
 	  fprintf(stderr, "Broken %s track #(%d)? skipping\n", (format_add==0x55?"MP3":"AC3"), aud_tracks);
 	  aud_ms = vid_ms;
 	  aud_error=1;
+	  break;
 	} else { // look in import/tcscan.c for explanation
 	  aud_ms += (headlen*8.0)/(mp3rate_i);
 	}
@@ -723,16 +697,9 @@ merge_mp3:
 
     for (n=0; n<frames; ++n) {
 
-      // video
-      bytes = AVI_read_frame(avifile1, data, &key);
-
-      if(bytes < 0) {
-	AVI_print_error("AVI read video frame");
-	return(-1);
-      }
-
-      if(AVI_write_frame(avifile, data, bytes, key)<0) {
-	AVI_print_error("AVI write video frame");
+      // video, copied without passing through memory
+      if(AVI_copy_frame(avifile, avifile1, n)<0) {
+	AVI_print_error("AVI copy video frame");
 	return(-1);
       }
 
@@ -765,10 +732,12 @@ merge_mp3:
 	    aud_error=1; break;
 	  }
 
-	  if ( (headlen = tc_get_audio_header(head, len, format_add, NULL, NULL, &mp3rate_i))<0) {
+	  if ( (headlen = tc_get_audio_header(head, len, format_add, NULL, NULL, &mp3rate_i))<0
+	       || headlen > (int)sizeof(data)) {
 	    fprintf(stderr, "Broken %s track #(%d)?\n", (format_add==0x55?"MP3":"AC3"), aud_tracks);
 	    aud_ms = vid_ms;
 	    aud_error=1;
+	    break;
 	  } else { // look in import/tcscan.c for explanation
 	    aud_ms += (headlen*8.0)/(mp3rate_i);
 	  }
@@ -63,8 +63,6 @@ static void usage(int status)
     exit(status);
 }
 
-// buffer
-static char data[SIZE_RGB_FRAME];
 static char out_file[1024];
 static char *comfile = NULL;
 int is_vbr = 1;
@@ -83,7 +81,7 @@ int main(int argc, char *argv[])
 
   char *in_file=NULL;
 
-  long i, frames, bytes, bytes_to_key, tmpreturn;
+  long i, frames, bytes, bytes_to_key, tmpreturn, cur, vpos;
 
   uint64_t size=0;
 
@@ -230,7 +228,7 @@ int main(int argc, char *argv[])
 
 
   // open file
-  if(NULL == (in = AVI_open_input_file(in_file,1))) {
+  if(NULL == (in = AVI_open_input_file_mmap(in_file,1))) {
     AVI_print_error("AVI open");
     exit(1);
   }
@@ -266,14 +264,17 @@ int main(int argc, char *argv[])
     j=0;
     // start frame
     i=0;
+    // next frame to be read
+    vpos=0;
 
     //some header may be broken
     if(frames<=0) frames=INT_MAX;
 
     for (n=0; n<frames; ++n) {
 
-      // read video frame
-      bytes = AVI_read_frame(in, data, &key);
+      // size and type of the next video frame, it is copied later
+      cur = vpos++;
+      bytes = AVI_read_frame(in, NULL, &key);
 
       if(bytes < 0) {
         fprintf(stderr, "%d (%ld)\n", n, bytes);
@@ -302,6 +303,7 @@ int main(int argc, char *argv[])
         }
         //rewind to correct position, the last keyframe.
         AVI_set_video_position(in, n);
+        vpos = n;
 
         size = AVI_bytes_written(out);
         fsize = ((double) size)/MBYTE;
@@ -381,7 +383,7 @@ int main(int argc, char *argv[])
 
       //write frame
 
-      if(AVI_write_frame(out, data, bytes, key)<0) {
+      if(AVI_copy_frame(out, in, cur)<0) {
         AVI_print_error("AVI write video frame");
         return(-1);
       }
@@ -476,6 +478,7 @@ int main(int argc, char *argv[])
        * reset input file
        */
       AVI_seek_start( in );
+      vpos = 0;
       for( k = 0; k < AVI_audio_tracks( in ); k++ ) {
         byte_count_audio[ k ] = 0;
         start_audio_keyframe[ k ] = 0;
@@ -546,9 +549,10 @@ int main(int argc, char *argv[])
        */
       for( n = 0; n < frames; n++) {
         /*
-         * read video frame
+         * look at the video frame, it is copied only if written
          */
-        bytes = AVI_read_frame( in, data, &key );
+        cur = vpos++;
+        bytes = AVI_read_frame( in, NULL, &key );
         if( bytes < 0 ) {
           fprintf( stderr, "%d (%ld)\n", n, bytes );
           AVI_print_error( "AVI read video frame" );
@@ -606,6 +610,7 @@ int main(int argc, char *argv[])
              * first the video
              */
             AVI_set_video_position( in, start_keyframe );
+            vpos = start_keyframe;
             /*
              * then the audio
              */
@@ -619,7 +624,8 @@ int main(int argc, char *argv[])
             /*
              * re-read video and audio from rewound position
              */
-            bytes = AVI_read_frame( in, data, &key );
+            cur = vpos++;
+            bytes = AVI_read_frame( in, NULL, &key );
 
 	    // count the frame which will be written also this, too
 	    vid_ms = vid_ms_w+1000.0/fps;
@@ -631,7 +637,7 @@ int main(int argc, char *argv[])
           /*
            * do the write
            */
-          if( AVI_write_frame( out, data, bytes, key ) < 0 ) {
+          if( AVI_copy_frame( out, in, cur ) < 0 ) {
             AVI_print_error( "AVI write video frame" );
             return( -1 );
           }
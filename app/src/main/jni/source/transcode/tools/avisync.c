@@ -64,13 +64,25 @@ static void usage(int status)
   exit(status);
 }
 
-// buffer
-static  char data[SIZE_RGB_FRAME];
-static  char ptrdata[SIZE_RGB_FRAME];
+// buffer (audio only, video is copied without passing through memory)
+static  char *data = NULL;
+static  char *ptrdata = NULL;
 static int   ptrlen=0;
 static char *comfile = NULL;
 int is_vbr = 1;
 
+/* AVI_read_audio_chunk, refusing chunks too large for the buffers */
+static long read_audio_chunk(avi_t *avifile, char *buf)
+{
+  long bytes = AVI_read_audio_chunk(avifile, NULL);
+
+  if (bytes > MAX_PCM_BUFFER) {
+    fprintf(stderr, "invalid audio chunk size (%ld)\n", bytes);
+    return(-1);
+  }
+  return(AVI_read_audio_chunk(avifile, buf));
+}
+
 int main(int argc, char *argv[])
 {
 
@@ -89,7 +101,7 @@ int main(int argc, char *argv[])
   int track_num=0, aud_tracks;
   int encode_null=0;
 
-  int i, j, n, key, shift=0;
+  int i, j, n, shift=0;
 
   int ch, preload=0;
 
@@ -116,6 +128,13 @@ int main(int argc, char *argv[])
 
   if(argc==1) usage(EXIT_FAILURE);
 
+  data    = tc_malloc(MAX_PCM_BUFFER);
+  ptrdata = tc_malloc(MAX_PCM_BUFFER);
+  if (data == NULL || ptrdata == NULL) {
+    fprintf(stderr, "buffer allocation failed\n");
+    exit(1);
+  }
+
   while ((ch = getopt(argc, argv, "a:b:vi:o:n:Nq?h")) != -1)
     {
 
@@ -331,16 +350,9 @@ int main(int argc, char *argv[])
 
   for (n=0; n<frames; ++n) {
 
-    // video unchanged
-    bytes = AVI_read_frame(avifile1, data, &key);
-
-    if(bytes < 0) {
-      AVI_print_error("AVI read video frame");
-      return(-1);
-    }
-
-    if(AVI_write_frame(avifile2, data, bytes, key)<0) {
-      AVI_print_error("AVI write video frame");
+    // video unchanged, copied without passing through memory
+    if(AVI_copy_frame(avifile2, avifile1, n)<0) {
+      AVI_print_error("AVI copy video frame");
       return(-1);
     }
 
@@ -387,7 +399,7 @@ int main(int argc, char *argv[])
 
 		aud_bitrate = (format==0x1||format==0x2000)?1:0;
 		aud_chunks++;
-		if( (bytes = AVI_read_audio_chunk(avifile1, data)) <= 0) {
+		if( (bytes = read_audio_chunk(avifile1, data)) <= 0) {
 		    aud_ms[track_num] = vid_ms + one_vid_ms*i;
 		    if (bytes == 0) continue;
 		    AVI_print_error("AVI 2 audio read frame");
@@ -408,7 +420,7 @@ int main(int argc, char *argv[])
 	    bytes=0;
 	    for(i=0;i<shift;++i) {
 		do {
-		    if( (bytes = AVI_read_audio_chunk(avifile1, data)) < 0) {
+		    if( (bytes = read_audio_chunk(avifile1, data)) < 0) {
 			AVI_print_error("AVI audio read frame");
 			return(-1);
 		    }
@@ -428,7 +440,7 @@ int main(int argc, char *argv[])
 		aud_chunks++;
 		aud_bitrate = (format==0x1||format==0x2000)?1:0;
 
-		if( (bytes = AVI_read_audio_chunk(avifile1, data)) < 0) {
+		if( (bytes = read_audio_chunk(avifile1, data)) < 0) {
 		    aud_ms[track_num] = vid_ms + shift_ms;
 		    AVI_print_error("AVI 3 audio read frame");
 		    break;
@@ -474,7 +486,7 @@ int main(int argc, char *argv[])
 	bytes = AVI_audio_size(avifile1, n+shift-1);
 
 	do {
-	    if( (bytes = AVI_read_audio_chunk(avifile1, data)) < 0) {
+	    if( (bytes = read_audio_chunk(avifile1, data)) < 0) {
 		AVI_print_error("AVI audio read frame");
 		return(-1);
 	    }
@@ -528,7 +540,7 @@ int main(int argc, char *argv[])
 		    return(-1);
 		}
 
-		fprintf(status_fd, " V [%05d][%08.2f] | A [%05d][%08.2f] [%05ld]\r", n, vid_ms, n+shift, aud_ms[track_num], bytes);
+		fprintf(status_fd, " V [%05d][%08.2f] | A [%05d][%08.2f] [%05d]\r", n, vid_ms, n+shift, aud_ms[track_num], ptrlen);
 
 		if ( !aud_bitrate && tc_get_audio_header(ptrdata, ptrlen, format, NULL, NULL, &aud_bitrate)<0) {
 		    //if (n == frames-1) continue;
@@ -600,7 +612,7 @@ int main(int argc, char *argv[])
 
 	  aud_bitrate = (format==0x1||format==0x2000)?1:0;
 
-	  if( (bytes = AVI_read_audio_chunk(avifile1, data)) < 0) {
+	  if( (bytes = read_audio_chunk(avifile1, data)) < 0) {
 	    AVI_print_error("AVI 2 audio read frame");
 	    aud_ms[track_num] = vid_ms;
 	    break;
@@ -683,7 +695,7 @@ int main(int argc, char *argv[])
       bytes = AVI_audio_size(avifile1, n);
 
 
-      if(bytes > SIZE_RGB_FRAME) {
+      if(bytes > MAX_PCM_BUFFER) {
 	fprintf(stderr, "invalid frame size\n");
 	return(-1);
       }
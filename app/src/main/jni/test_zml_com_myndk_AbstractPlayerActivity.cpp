@@ -19,7 +19,8 @@ JNIEXPORT jlong JNICALL Java_test_zml_com_myndk_AbstractPlayerActivity_open
     {
         goto exit;
     }
-    avi = AVI_open_input_file(cFileName,1);
+    /*映射文件, 渲染时直接从映射内存取帧*/
+    avi = AVI_open_input_file_mmap(cFileName,1);
     env->ReleaseStringUTFChars(fileName,cFileName);
 
     if (0 == avi)
@@ -12,13 +12,19 @@ extern "C"{
 #include "Common.h"
 #include "test_zml_com_myndk_OpenGLPlayerActivity.h"
 
+/*预读的帧数*/
+#define PREFETCH_FRAMES 16
+
 struct Instance
 {
     char* buffer;
     GLuint texture;
+    /*纹理是否已经上传过一帧*/
+    bool uploaded;
     Instance():
             buffer(0),
-            texture(0)
+            texture(0),
+            uploaded(false)
     {
 
     }
@@ -51,6 +57,17 @@ JNIEXPORT jlong JNICALL Java_test_zml_com_myndk_OpenGLPlayerActivity_init
     {
         ThrowException(env,"java/io/RuntimeException","Unable to allocate buffer.");
         delete instance;
+        instance = 0;
+        goto exit;
+    }
+
+    /*后台线程预读帧, 渲染时不再等待磁盘*/
+    if (0 > AVI_enable_prefetch((avi_t*) avi,PREFETCH_FRAMES))
+    {
+        ThrowException(env,"java/io/RuntimeException",AVI_strerror());
+        free(instance->buffer);
+        delete instance;
+        instance = 0;
         goto exit;
     }
 
@@ -106,8 +123,20 @@ JNIEXPORT jboolean JNICALL Java_test_zml_com_myndk_OpenGLPlayerActivity_render
     jboolean isFrameRead = JNI_FALSE;
     int keyFrame = 0;
 
-    /*将AVI帧字节读到bitmap*/
-    long frameSize = AVI_read_frame((avi_t*) avi,instance->buffer,&keyFrame);
+    /*从预读窗口取帧, 不会阻塞*/
+    long frameSize = AVI_try_read_frame((avi_t*) avi,instance->buffer,&keyFrame);
+    if (0 > frameSize && AVI_ERR_NOT_READY == AVI_get_error((avi_t*) avi))
+    {
+        /*帧还没读到, 重绘上一帧而不是卡住渲染线程*/
+        isFrameRead = JNI_TRUE;
+        if (instance->uploaded)
+        {
+            goto draw;
+        }
+        /*第一帧之前纹理内容未初始化, 只清屏*/
+        glClear(GL_COLOR_BUFFER_BIT);
+        goto exit;
+    }
     if (0 >= frameSize)
     {
         goto exit;
@@ -124,6 +153,9 @@ JNIEXPORT jboolean JNICALL Java_test_zml_com_myndk_OpenGLPlayerActivity_render
                     GL_RGB,
                     GL_UNSIGNED_SHORT_5_6_5,
                     instance->buffer);
+    instance->uploaded = true;
+
+    draw:
 
     /*绘制纹理*/ //使用该函数，需要 启用GL ext原库.
     glDrawTexiOES(0,0,0,